@@ -0,0 +1,413 @@
+/*
+ * pakcheck.c
+ *
+ * PAKTOOL library: structural validation of printer (device) entries.
+ *
+ * The formatting functions trust the offsets and counts stored in a device
+ * segment; a damaged or mis-compiled entry makes them read outside the
+ * segment or print garbage.  PakCheckDevice() verifies everything they rely
+ * on against the size of the segment (from the directory) and the size of its
+ * information segment (desItems.iSizeBuffer), and reports each problem as a
+ * single line of the form
+ *
+ *    <printer>: <field>: <description>
+ *
+ * It only reads the segment, and keeps no state of its own, so any number of
+ * entries may be checked concurrently (each with its own arena and output).
+ */
+
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+
+// How CheckString() should treat a string offset (as in the field tables)
+#define CHK_ZERO_OK     PF_ZERO_OK      // offset 0 is a real offset, not "none"
+#define CHK_REQUIRED    PF_REQUIRED     // the formatters use the offset unconditionally
+#define CHK_EXPAND      PF_COMMAND      // compressed command string
+
+// Paper index records: dimension (idx, x, y); imageable (idx, x1, y1, x2, y2)
+#define DIM_RECORD_SIZE ( 3 * sizeof( SHORT ))
+#define IMG_RECORD_SIZE ( 5 * sizeof( SHORT ))
+
+
+// State for checking one device segment
+typedef struct _CHECKCTX
+{
+    PPAK_DEV_DIRENTRY pEntry;   // directory entry of the segment
+    PBYTE     pInfoSeg;         // information segment
+    ULONG     cbInfo;           // usable size of the information segment
+    PPAKDICT  pDict;            // keyword dictionary (NULL for built-in)
+    POUTBUF   pOut;             // where problems are reported
+    ULONG     cProblems;        // number of problems reported
+} CHECKCTX, *PCHECKCTX;
+
+/* ------------------------------------------------------------------------- *
+ * Problem                                                                   *
+ *                                                                           *
+ * Report one problem with the segment being checked.                        *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PCHECKCTX pCtx     : Check state                                        *
+ *   PSZ       pszWhere : Name of the field or structure concerned           *
+ *   PSZ       pszFormat: printf()-style description, followed by arguments  *
+ *                                                                           *
+ * RETURNS: N/A                                                              *
+ * ------------------------------------------------------------------------- */
+static void Problem( PCHECKCTX pCtx, PSZ pszWhere, PSZ pszFormat, ... )
+{
+    CHAR    szText[ 256 ];
+    va_list args;
+
+    va_start( args, pszFormat );
+    vsnprintf( szText, sizeof( szText ), pszFormat, args );
+    va_end( args );
+    OutPrintf( pCtx->pOut, "%.40s: %s: %s\n", pCtx->pEntry->szDeviceName, pszWhere, szText );
+    pCtx->cProblems++;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CheckString                                                               *
+ *                                                                           *
+ * Check a string offset into the information segment: the string must lie   *
+ * within the segment and be null-terminated there, and a compressed command *
+ * must decompress (with the current dictionary) to something that fits the  *
+ * formatters' scratch buffer, which is the size of the information segment. *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PCHECKCTX pCtx    : Check state                                         *
+ *   PSZ       pszWhere: Name of the field                                   *
+ *   LONG      lOff    : Offset value                                        *
+ *   USHORT    fsCheck : CHK_* flags                                         *
+ *                                                                           *
+ * RETURNS: BOOL                                                             *
+ *   TRUE if the offset refers to a valid string; FALSE if it does not, or   *
+ *   if it means "none"                                                      *
+ * ------------------------------------------------------------------------- */
+static BOOL CheckString( PCHECKCTX pCtx, PSZ pszWhere, LONG lOff, USHORT fsCheck )
+{
+    PSZ  psz;
+    LONG lLen;
+
+    if (( lOff < 0 ) || ( lOff == 0 && !( fsCheck & CHK_ZERO_OK ))) {
+        if ( fsCheck & CHK_REQUIRED )
+            Problem( pCtx, pszWhere, "required string is missing (offset %ld)", lOff );
+        return FALSE;
+    }
+    if ( (ULONG) lOff >= pCtx->cbInfo ) {
+        Problem( pCtx, pszWhere, "offset 0x%lX is outside the information segment (%lu bytes)",
+                 lOff, pCtx->cbInfo );
+        return FALSE;
+    }
+    psz = (PSZ)( pCtx->pInfoSeg + lOff );
+    if ( !memchr( psz, 0, pCtx->cbInfo - lOff )) {
+        Problem( pCtx, pszWhere, "string at offset 0x%lX is not terminated", lOff );
+        return FALSE;
+    }
+    if ( fsCheck & CHK_EXPAND ) {
+        lLen = DecompressedLength( pCtx->pDict, psz );
+        if ( lLen < 0 ) {
+            Problem( pCtx, pszWhere, "string at offset 0x%lX cannot be decompressed", lOff );
+            return FALSE;
+        }
+        // OffsetToCommand() adds quotes and a null
+        if ( lLen + 3 > (LONG) pCtx->cbInfo ) {
+            Problem( pCtx, pszWhere, "string at offset 0x%lX expands to %ld bytes, too long for "
+                     "an information segment of %lu bytes", lOff, lLen, pCtx->cbInfo );
+            return FALSE;
+        }
+    }
+    return TRUE;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CheckTable                                                                *
+ *                                                                           *
+ * Check that a table of fixed-size records lies within the information      *
+ * segment.                                                                  *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PCHECKCTX pCtx    : Check state                                         *
+ *   PSZ       pszWhere: Name of the offset field                            *
+ *   LONG      lOff    : Offset of the table                                 *
+ *   LONG      lCount  : Number of records                                   *
+ *   ULONG     cbRecord: Size of each record                                 *
+ *                                                                           *
+ * RETURNS: BOOL                                                             *
+ *   TRUE if the table is valid (or empty)                                   *
+ * ------------------------------------------------------------------------- */
+static BOOL CheckTable( PCHECKCTX pCtx, PSZ pszWhere, LONG lOff, LONG lCount, ULONG cbRecord )
+{
+    if ( lCount < 0 ) {
+        Problem( pCtx, pszWhere, "negative record count %ld", lCount );
+        return FALSE;
+    }
+    if ( lCount == 0 ) return TRUE;
+    if (( lOff < 0 ) || ( (ULONG) lOff > pCtx->cbInfo ) ||
+        ( (ULONG) lCount > ( pCtx->cbInfo - lOff ) / cbRecord ))
+    {
+        Problem( pCtx, pszWhere, "table of %ld %lu-byte records at offset 0x%lX does not fit "
+                 "the information segment (%lu bytes)", lCount, cbRecord, lOff, pCtx->cbInfo );
+        return FALSE;
+    }
+    return TRUE;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CheckPaperIndex                                                           *
+ *                                                                           *
+ * Check a paper table's reference to an entry of the PageSize UI block.     *
+ * ------------------------------------------------------------------------- */
+static void CheckPaperIndex( PCHECKCTX pCtx, PSZ pszWhere, PUI_BLOCK puiPaper, SHORT sIdx )
+{
+    if ( !puiPaper )
+        Problem( pCtx, pszWhere, "paper index %d, but there is no PageSize UI block", sIdx );
+    else if (( sIdx < 0 ) || ( sIdx >= (SHORT) puiPaper->usNumOfEntries ))
+        Problem( pCtx, pszWhere, "paper index %d is outside the %u PageSize entries",
+                 sIdx, puiPaper->usNumOfEntries );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakCheckDevice                                                            *
+ *                                                                           *
+ * Validate the structure of a device segment: the descriptor and UI lists   *
+ * against the segment size, every string offset, the chain of UI blocks,    *
+ * the UI constraints, the paper tables, the resolution list, the font list  *
+ * and the forms index.  Each problem found is written to the output as one  *
+ * line.  Where a problem makes later structures unreachable (e.g. a broken  *
+ * block chain), checking of those is skipped.                               *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAK_DEV_DIRENTRY pEntry: Directory entry (for the name and size)       *
+ *   PBYTE     pBuf  : Device segment (pEntry->ulSize bytes)                 *
+ *   PPAKARENA pArena: Scratch memory; its dictionary is used to check       *
+ *                     compressed strings (may be NULL)                      *
+ *   POUTBUF   pOut  : Output buffer, or NULL for STDOUT                     *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   Number of problems found                                                *
+ * ------------------------------------------------------------------------- */
+ULONG PakCheckDevice( PPAK_DEV_DIRENTRY pEntry, PBYTE pBuf, PPAKARENA pArena, POUTBUF pOut )
+{
+    CHECKCTX   ctx;
+    DESPPD     desPPD;
+    PAKARENA   arLocal = {0};
+    ULONG      ulMark = 0,
+               cbDS,
+               cbLeft,
+               cb;
+    PBYTE      pb;
+    PUI_BLOCK  puib,
+               puiPaper = NULL;
+    PUI_BLOCK *apBlocks = NULL;
+    PUIC_BLOCK puicb;
+    PUIC_ENTRY puice;
+    PPAKFIELD  pField;
+    USHORT     cBlocks = 0,
+               i, j;
+    PSHORT     psVal;
+    PLONG      plVal;
+    PSZ        psz;
+    CHAR       szWhere[ 80 ];
+
+    memset( &ctx, 0, sizeof( ctx ));
+    ctx.pEntry = pEntry;
+    ctx.pOut   = pOut;
+    if ( pArena ) {
+        ctx.pDict = pArena->pDict;
+        ulMark = ArenaMark( pArena );
+    }
+    else pArena = &arLocal;
+
+    // The descriptor segment
+    if ( pEntry->ulSize < sizeof( DESPPD )) {
+        Problem( &ctx, "ulSize", "segment of %lu bytes is too small for a descriptor (%lu bytes)",
+                 pEntry->ulSize, (ULONG) sizeof( DESPPD ));
+        goto cleanup;
+    }
+    memcpy( &desPPD, pBuf, sizeof( DESPPD ));
+    cbDS = sizeof( DESPPD ) + desPPD.stUIList.usBlockListSize +
+           desPPD.stUICList.usNumOfUICs * sizeof( UIC_BLOCK );
+    if ( cbDS > pEntry->ulSize ) {
+        Problem( &ctx, "stUIList.usBlockListSize",
+                 "UI lists (%u + %u * %lu bytes) run %lu bytes past the end of the segment",
+                 desPPD.stUIList.usBlockListSize, desPPD.stUICList.usNumOfUICs,
+                 (ULONG) sizeof( UIC_BLOCK ), cbDS - pEntry->ulSize );
+        goto cleanup;
+    }
+
+    // The information segment
+    ctx.pInfoSeg = pBuf + cbDS;
+    ctx.cbInfo   = pEntry->ulSize - cbDS;
+    if ( desPPD.desItems.iSizeBuffer < 0 ) {
+        Problem( &ctx, "desItems.iSizeBuffer", "negative size %d", desPPD.desItems.iSizeBuffer );
+        ctx.cbInfo = 0;
+    }
+    else if ( (ULONG) desPPD.desItems.iSizeBuffer > ctx.cbInfo )
+        Problem( &ctx, "desItems.iSizeBuffer", "%d bytes, but only %lu remain in the segment",
+                 desPPD.desItems.iSizeBuffer, ctx.cbInfo );
+    else
+        ctx.cbInfo = desPPD.desItems.iSizeBuffer;
+
+    for ( pField = PakFieldTable( PAKFT_DESPPD ); pField->pszName; pField++ ) {
+        if ( pField->fs & PF_STRING )
+            CheckString( &ctx, pField->pszName, (SHORT) PakFieldValue( pField, &desPPD ), pField->fs );
+    }
+
+    // Walk the UI block chain, keeping a pointer to each valid block
+    if ( desPPD.stUIList.usNumOfBlocks ) {
+        apBlocks = (PUI_BLOCK *) ArenaAlloc( pArena, desPPD.stUIList.usNumOfBlocks * sizeof( PUI_BLOCK ));
+        if ( !apBlocks ) {
+            Problem( &ctx, "stUIList", "out of memory" );
+            goto cleanup;
+        }
+    }
+    pb     = pBuf + sizeof( DESPPD );
+    cbLeft = desPPD.stUIList.usBlockListSize;
+    for ( i = 0; i < desPPD.stUIList.usNumOfBlocks; i++ ) {
+        sprintf( szWhere, "stUIList.pBlockList[%u]", i );
+        puib = (PUI_BLOCK) pb;
+        if (( cbLeft < UI_BLOCK_FIXED ) ||
+            (( cb = UI_BLOCK_FIXED + puib->usNumOfEntries * sizeof( UI_ENTRY )) > cbLeft ))
+        {
+            Problem( &ctx, szWhere, "block at segment offset 0x%lX runs past the end of the "
+                     "block list (usBlockListSize %u, usNumOfBlocks %u)", (ULONG)( pb - pBuf ),
+                     desPPD.stUIList.usBlockListSize, desPPD.stUIList.usNumOfBlocks );
+            break;
+        }
+        apBlocks[ cBlocks++ ] = puib;
+
+        strcat( szWhere, ".ofsUIName");
+        if ( CheckString( &ctx, szWhere, puib->ofsUIName, CHK_REQUIRED ) &&
+             !strcmp( (PSZ)( ctx.pInfoSeg + puib->ofsUIName ), "PageSize"))
+            puiPaper = puib;
+        sprintf( szWhere, "stUIList.pBlockList[%u].ofsUITransString", i );
+        CheckString( &ctx, szWhere, puib->ofsUITransString, 0 );
+        if ( puib->usNumOfEntries && puib->usDefaultEntry >= puib->usNumOfEntries ) {
+            sprintf( szWhere, "stUIList.pBlockList[%u].usDefaultEntry", i );
+            Problem( &ctx, szWhere, "default entry %u is outside the %u entries",
+                     puib->usDefaultEntry, puib->usNumOfEntries );
+        }
+        for ( j = 0; j < puib->usNumOfEntries; j++ ) {
+            sprintf( szWhere, "stUIList.pBlockList[%u].uiEntry[%u].ofsOption", i, j );
+            CheckString( &ctx, szWhere, puib->uiEntry[ j ].ofsOption, 0 );
+            sprintf( szWhere, "stUIList.pBlockList[%u].uiEntry[%u].ofsTransString", i, j );
+            CheckString( &ctx, szWhere, puib->uiEntry[ j ].ofsTransString, 0 );
+            sprintf( szWhere, "stUIList.pBlockList[%u].uiEntry[%u].ofsValue", i, j );
+            CheckString( &ctx, szWhere, puib->uiEntry[ j ].ofsValue, CHK_EXPAND );
+        }
+        pb     += cb;
+        cbLeft -= cb;
+    }
+    if ( cBlocks == desPPD.stUIList.usNumOfBlocks && cbLeft )
+        Problem( &ctx, "stUIList.usBlockListSize", "%lu bytes are left over after the last of "
+                 "the %u UI blocks", cbLeft, desPPD.stUIList.usNumOfBlocks );
+
+    // UI constraints: block indices and option bits
+    puicb = (PUIC_BLOCK)( pBuf + sizeof( DESPPD ) + desPPD.stUIList.usBlockListSize );
+    for ( i = 0; i < desPPD.stUICList.usNumOfUICs; i++, puicb++ ) {
+        for ( j = 1; j <= 2; j++ ) {
+            puice = ( j == 1 ) ? &(puicb->uicEntry1) : &(puicb->uicEntry2);
+            sprintf( szWhere, "stUICList.puicBlockList[%u].uicEntry%u", i, j );
+            if ( puice->ofsUIBlock >= desPPD.stUIList.usNumOfBlocks )
+                Problem( &ctx, szWhere, "refers to UI block %u, but there are only %u",
+                         puice->ofsUIBlock, desPPD.stUIList.usNumOfBlocks );
+            else if ( puice->ofsUIBlock < cBlocks ) {
+                puib = apBlocks[ puice->ofsUIBlock ];
+                if ( puib->usNumOfEntries < 32 && ( puice->bOption >> puib->usNumOfEntries ))
+                    Problem( &ctx, szWhere, "option bits 0x%08lX exceed the %u entries of UI block %u",
+                             puice->bOption, puib->usNumOfEntries, puice->ofsUIBlock );
+            }
+        }
+    }
+
+    // Paper tables, which index the entries of the PageSize block
+    if ( CheckTable( &ctx, "desPage.ofsDimxyPgsz", desPPD.desPage.ofsDimxyPgsz,
+                     desPPD.desPage.iDmpgpairs, DIM_RECORD_SIZE ))
+    {
+        psVal = (PSHORT)( ctx.pInfoSeg + desPPD.desPage.ofsDimxyPgsz );
+        for ( i = 0; i < desPPD.desPage.iDmpgpairs; i++, psVal += 3 ) {
+            sprintf( szWhere, "desPage.ofsDimxyPgsz[%u]", i );
+            CheckPaperIndex( &ctx, szWhere, puiPaper, *psVal );
+        }
+    }
+    if ( desPPD.desPage.iImgpgpairs < 0 )
+        Problem( &ctx, "desPage.iImgpgpairs", "negative record count %d", desPPD.desPage.iImgpgpairs );
+    else if ( desPPD.desPage.iImgpgpairs > 0 ) {
+        cb = desPPD.desPage.ofsImgblPgsz;
+        if ( desPPD.desPage.ofsImgblPgsz < 0 )
+            Problem( &ctx, "desPage.ofsImgblPgsz", "negative offset %d for %d records",
+                     desPPD.desPage.ofsImgblPgsz, desPPD.desPage.iImgpgpairs );
+        else for ( i = 0; i < desPPD.desPage.iImgpgpairs; i++ ) {
+            sprintf( szWhere, "desPage.ofsImgblPgsz[%u]", i );
+            if (( cb >= ctx.cbInfo ) || ( ctx.cbInfo - cb < IMG_RECORD_SIZE + 1 ) ||
+                !memchr( ctx.pInfoSeg + cb + IMG_RECORD_SIZE, 0, ctx.cbInfo - cb - IMG_RECORD_SIZE ))
+            {
+                Problem( &ctx, szWhere, "record at offset 0x%lX runs past the end of the "
+                         "information segment (%u records expected)", cb, desPPD.desPage.iImgpgpairs );
+                break;
+            }
+            CheckPaperIndex( &ctx, szWhere, puiPaper, *((PSHORT)( ctx.pInfoSeg + cb )));
+            cb += IMG_RECORD_SIZE + strlen( (PSZ)( ctx.pInfoSeg + cb + IMG_RECORD_SIZE )) + 1;
+        }
+    }
+
+    // Resolution list (read as an array of SHORT values)
+    if ( desPPD.desItems.ResList.uNumOfRes < 0 )
+        Problem( &ctx, "desItems.ResList.uNumOfRes", "negative count %d",
+                 desPPD.desItems.ResList.uNumOfRes );
+    else if ( desPPD.desItems.ResList.uResOffset > 0 )
+        CheckTable( &ctx, "desItems.ResList.uResOffset", desPPD.desItems.ResList.uResOffset,
+                    desPPD.desItems.ResList.uNumOfRes, sizeof( SHORT ));
+
+    // Font list: iFonts consecutive strings
+    if ( desPPD.desFonts.iFonts < 0 )
+        Problem( &ctx, "desFonts.iFonts", "negative count %d", desPPD.desFonts.iFonts );
+    else if ( desPPD.desFonts.iFonts > 0 &&
+              CheckString( &ctx, "desFonts.ofsFontnames", desPPD.desFonts.ofsFontnames, CHK_REQUIRED ))
+    {
+        cb = desPPD.desFonts.ofsFontnames;
+        for ( i = 0; i < desPPD.desFonts.iFonts; i++ ) {
+            sprintf( szWhere, "desFonts.ofsFontnames[%u]", i );
+            if ( !CheckString( &ctx, szWhere, cb, CHK_ZERO_OK )) break;
+            psz = (PSZ)( ctx.pInfoSeg + cb );
+            if ( !*psz ) {
+                Problem( &ctx, szWhere, "font list ends after %u of %d names", i,
+                         desPPD.desFonts.iFonts );
+                break;
+            }
+            cb += strlen( psz ) + 1;
+        }
+    }
+
+    // Forms: an index of command string offsets
+    if ( desPPD.desForms.usFormCount ) {
+        CheckString( &ctx, "desForms.ofsFormTable", desPPD.desForms.ofsFormTable, 0 );
+        if ( CheckTable( &ctx, "desForms.ofsFormIndex", desPPD.desForms.ofsFormIndex,
+                         desPPD.desForms.usFormCount, sizeof( LONG )))
+        {
+            plVal = (PLONG)( ctx.pInfoSeg + desPPD.desForms.ofsFormIndex );
+            for ( i = 0; i < desPPD.desForms.usFormCount; i++, plVal++ ) {
+                sprintf( szWhere, "desForms.ofsFormIndex[%u]", i );
+                CheckString( &ctx, szWhere, (SHORT) *plVal, CHK_EXPAND );
+            }
+        }
+    }
+
+cleanup:
+    if ( pArena == &arLocal )
+        ArenaFree( &arLocal );
+    else
+        ArenaRelease( pArena, ulMark );
+    return ctx.cProblems;
+}
@@ -0,0 +1,582 @@
+/*
+ * pakcmp.c
+ *
+ * PAKTOOL library: semantic comparison of two device segments, such as a PAK
+ * file entry and the segment compiled from the PPD which GeneratePPD() wrote
+ * for it.  Offsets and the layout of the information segment are ignored;
+ * what is compared is what the driver would see: numbers, strings (commands
+ * after decompression), UI blocks and their options, UI constraints (as the
+ * set of conflicting option pairs), the paper tables and the font list.
+ * Each difference is reported as a single line of the form
+ *
+ *    <printer>: <field>: <first value> became <second value>
+ *
+ * A missing string and an empty one are taken to be the same, as are a
+ * missing translation string and one equal to the name it translates, since
+ * the driver (and GeneratePPD()) treat them alike.  Fields which a PPD file
+ * has no way to carry are not compared; PakCompareDevices() instead notes
+ * which of them the first segment uses (see PakCompareDropped()).
+ *
+ * Both segments must be valid (see PakCheckDevice()).
+ */
+
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+
+// Paper index records: dimension (idx, x, y); imageable (idx, x1, y1, x2, y2)
+#define DIM_RECORD_SIZE     ( 3 * sizeof( SHORT ))
+#define IMG_RECORD_SIZE     ( 5 * sizeof( SHORT ))
+
+// How a DESPPD field is compared
+#define CMP_NUMBER          1       // value
+#define CMP_TEXT            2       // string, as stored
+#define CMP_COMMAND         3       // string, decompressed
+#define CMP_ZERO_OK         0x10    // offset 0 is a string; negative is none
+
+#define CMP_EXCERPT         24      // characters of a string shown in a report
+#define CMP_MAX_DROPPED     32      // bits in PakCompareDevices' flags
+
+// The tables of fields which may not be carried by a PPD file
+static ULONG aulDropTables[] = { PAKFT_DESPPD, PAKFT_UI_BLOCK };
+
+
+// One of the two segments being compared
+typedef struct _CMPSIDE
+{
+    DESPPD     des;                 // descriptor
+    PUI_BLOCK *apBlocks;            // each UI block
+    PUIC_BLOCK puicBlocks;          // UI constraints
+    PBYTE      pInfoSeg;            // information segment
+    PUI_BLOCK  puiPaper;            // PageSize block, or NULL
+} CMPSIDE, *PCMPSIDE;
+
+// State for comparing two segments
+typedef struct _CMPCTX
+{
+    PPAK_DEV_DIRENTRY pEntry;       // directory entry (for the name)
+    CMPSIDE   a[ 2 ];               // the two segments
+    PPAKARENA pArena;               // scratch arena
+    POUTBUF   pOut;                 // where differences are reported
+    ULONG     cDiffs;               // number of differences reported
+} CMPCTX, *PCMPCTX;
+
+// A conflicting pair of options, as block and entry numbers
+typedef struct _CMPPAIR
+{
+    USHORT usBlock1, usEntry1,
+           usBlock2, usEntry2;
+} CMPPAIR, *PCMPPAIR;
+
+
+/* ------------------------------------------------------------------------- *
+ * Difference                                                                *
+ *                                                                           *
+ * Report one difference between the segments.                               *
+ * ------------------------------------------------------------------------- */
+static void Difference( PCMPCTX pCtx, PSZ pszWhere, PSZ pszFormat, ... )
+{
+    CHAR    szText[ 256 ];
+    va_list args;
+
+    va_start( args, pszFormat );
+    vsnprintf( szText, sizeof( szText ), pszFormat, args );
+    va_end( args );
+    OutPrintf( pCtx->pOut, "%.40s: %s: %s\n", pCtx->pEntry->szDeviceName, pszWhere, szText );
+    pCtx->cDiffs++;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * GetNumber                                                                 *
+ *                                                                           *
+ * Read a (signed) field of 1, 2 or 4 bytes.                                 *
+ * ------------------------------------------------------------------------- */
+static LONG GetNumber( PBYTE pb, ULONG cb )
+{
+    if ( cb == sizeof( LONG )) return *((PLONG) pb );
+    if ( cb == sizeof( SHORT )) return *((PSHORT) pb );
+    return *pb;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * GetString                                                                 *
+ *                                                                           *
+ * Return the string at an offset into one segment's information segment,    *
+ * decompressed (into the arena) if it is a command.  A missing string is    *
+ * returned as NULL if fsCompare includes CMP_ZERO_OK, otherwise as "".      *
+ * ------------------------------------------------------------------------- */
+static PSZ GetString( PCMPCTX pCtx, ULONG ulSide, LONG lOff, USHORT fsCompare )
+{
+    PSZ  psz,
+         pszOut;
+    LONG lLen;
+
+    if ( lOff < 0 || ( lOff == 0 && !( fsCompare & CMP_ZERO_OK )))
+        return ( fsCompare & CMP_ZERO_OK ) ? NULL : "";
+    psz = (PSZ)( pCtx->a[ ulSide ].pInfoSeg + lOff );
+    if (( fsCompare & 0x0F ) != CMP_COMMAND ) return psz;
+    lLen = DecompressedLength( pCtx->pArena ? pCtx->pArena->pDict : NULL, psz );
+    if ( lLen < 0 || ( pszOut = (PSZ) ArenaAlloc( pCtx->pArena, lLen + 1 )) == NULL )
+        return psz;
+    ExpandString( pCtx->pArena, psz, pszOut );
+    return pszOut;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * Excerpt                                                                   *
+ *                                                                           *
+ * Format part of a string for a report, starting a little before a given    *
+ * position, with unprintable characters shown in hex.                       *
+ * ------------------------------------------------------------------------- */
+static PSZ Excerpt( PSZ psz, ULONG ulPos, PSZ pszOut )
+{
+    PSZ   p = pszOut;
+    ULONG i;
+
+    if ( !psz ) return strcpy( pszOut, "(none)");
+    i = ( ulPos > CMP_EXCERPT / 2 ) ? ulPos - CMP_EXCERPT / 2 : 0;
+    *p++ = '"';
+    if ( i ) p += sprintf( p, "...");
+    for ( ; psz[ i ] && p - pszOut < CMP_EXCERPT * 2; i++ ) {
+        if ( (UCHAR) psz[ i ] < 32 ) p += sprintf( p, "<%02X>", (UCHAR) psz[ i ] );
+        else *p++ = psz[ i ];
+    }
+    if ( psz[ i ] ) p += sprintf( p, "...");
+    *p++ = '"';
+    *p = 0;
+    return pszOut;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CompareStrings                                                            *
+ *                                                                           *
+ * Compare two strings (either of which may be NULL for "none"), and report  *
+ * them, from near the first difference, if they differ.                     *
+ * ------------------------------------------------------------------------- */
+static void CompareStrings( PCMPCTX pCtx, PSZ pszWhere, PSZ psz1, PSZ psz2 )
+{
+    CHAR  sz1[ CMP_EXCERPT * 4 ],
+          sz2[ CMP_EXCERPT * 4 ];
+    ULONG i;
+
+    if ( psz1 && psz2 ) {
+        for ( i = 0; psz1[ i ] && psz1[ i ] == psz2[ i ]; i++ );
+        if ( psz1[ i ] == psz2[ i ] ) return;
+    }
+    else if ( !psz1 && !psz2 ) return;
+    else i = 0;
+    Difference( pCtx, pszWhere, "%s became %s", Excerpt( psz1, i, sz1 ), Excerpt( psz2, i, sz2 ));
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CompareNumbers                                                            *
+ * ------------------------------------------------------------------------- */
+static void CompareNumbers( PCMPCTX pCtx, PSZ pszWhere, LONG l1, LONG l2 )
+{
+    if ( l1 != l2 ) Difference( pCtx, pszWhere, "%ld became %ld", l1, l2 );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * Xlate                                                                     *
+ *                                                                           *
+ * Return a translation string, or the name it translates if there is none.  *
+ * ------------------------------------------------------------------------- */
+static PSZ Xlate( PCMPCTX pCtx, ULONG ulSide, USHORT ofsXlate, PSZ pszName )
+{
+    PSZ psz = GetString( pCtx, ulSide, (SHORT) ofsXlate, CMP_TEXT );
+
+    return *psz ? psz : pszName;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * LoadSide                                                                  *
+ *                                                                           *
+ * Locate the parts of a segment, and the start of each of its UI blocks.    *
+ * ------------------------------------------------------------------------- */
+static BOOL LoadSide( PCMPCTX pCtx, ULONG ulSide, PBYTE pBuf )
+{
+    PCMPSIDE  pSide = pCtx->a + ulSide;
+    PUI_BLOCK puib;
+    ULONG     i;
+
+    memcpy( &(pSide->des), pBuf, sizeof( DESPPD ));
+    puib = (PUI_BLOCK)( pBuf + sizeof( DESPPD ));
+    pSide->puicBlocks = (PUIC_BLOCK)( (PBYTE) puib + pSide->des.stUIList.usBlockListSize );
+    pSide->pInfoSeg   = (PBYTE)( pSide->puicBlocks + pSide->des.stUICList.usNumOfUICs );
+    pSide->apBlocks   = (PUI_BLOCK *) ArenaAlloc( pCtx->pArena,
+                            ( pSide->des.stUIList.usNumOfBlocks + 1 ) * sizeof( PUI_BLOCK ));
+    if ( !pSide->apBlocks ) return FALSE;
+    pSide->puiPaper = NULL;
+    for ( i = 0; i < pSide->des.stUIList.usNumOfBlocks; i++ ) {
+        pSide->apBlocks[ i ] = puib;
+        if ( !pSide->puiPaper && !strcmp( GetString( pCtx, ulSide, puib->ofsUIName, CMP_TEXT ), "PageSize"))
+            pSide->puiPaper = puib;
+        puib = (PUI_BLOCK)( (PBYTE) puib + UI_BLOCK_FIXED + puib->usNumOfEntries * sizeof( UI_ENTRY ));
+    }
+    return TRUE;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CompareBlocks                                                             *
+ *                                                                           *
+ * Compare the UI blocks, and their entries, in order.                       *
+ * ------------------------------------------------------------------------- */
+static void CompareBlocks( PCMPCTX pCtx, ULONG ulGroup, PULONG pflDropped )
+{
+    PUI_BLOCK pb1, pb2;
+    PPAKFIELD pField;
+    PSZ       pszName1, pszName2;
+    CHAR      szWhere[ 128 ];
+    ULONG     cBlocks, cEntries,
+              b, e;
+
+    CompareNumbers( pCtx, "stUIList.usNumOfBlocks", pCtx->a[ 0 ].des.stUIList.usNumOfBlocks,
+                    pCtx->a[ 1 ].des.stUIList.usNumOfBlocks );
+    cBlocks = pCtx->a[ 0 ].des.stUIList.usNumOfBlocks;
+    if ( cBlocks > pCtx->a[ 1 ].des.stUIList.usNumOfBlocks ) cBlocks = pCtx->a[ 1 ].des.stUIList.usNumOfBlocks;
+    for ( pField = PakFieldTable( PAKFT_UI_BLOCK ); pField->pszName; pField++ ) {
+        if ( !( pField->fs & PF_NO_PPD )) continue;
+        for ( b = 0; b < pCtx->a[ 0 ].des.stUIList.usNumOfBlocks; b++ ) {
+            if ( PakFieldValue( pField, pCtx->a[ 0 ].apBlocks[ b ] ) > 0 && ulGroup < CMP_MAX_DROPPED ) {
+                *pflDropped |= 1UL << ulGroup;
+                break;
+            }
+        }
+        ulGroup++;
+    }
+
+    for ( b = 0; b < cBlocks; b++ ) {
+        pb1 = pCtx->a[ 0 ].apBlocks[ b ];
+        pb2 = pCtx->a[ 1 ].apBlocks[ b ];
+        pszName1 = GetString( pCtx, 0, pb1->ofsUIName, CMP_TEXT );
+        pszName2 = GetString( pCtx, 1, pb2->ofsUIName, CMP_TEXT );
+
+#define BLOCK_WHERE( f )    ( sprintf( szWhere, "stUIList.pBlockList[%lu].%s (*%.40s)", b, f, pszName1 ), szWhere )
+        CompareStrings( pCtx, BLOCK_WHERE("ofsUIName"), pszName1, pszName2 );
+        CompareStrings( pCtx, BLOCK_WHERE("ofsUITransString"),
+                        Xlate( pCtx, 0, pb1->ofsUITransString, pszName1 ),
+                        Xlate( pCtx, 1, pb2->ofsUITransString, pszName2 ));
+        CompareNumbers( pCtx, BLOCK_WHERE("usOrderDep"),     pb1->usOrderDep,     pb2->usOrderDep );
+        CompareNumbers( pCtx, BLOCK_WHERE("usUILocation"),   pb1->usUILocation,   pb2->usUILocation );
+        CompareNumbers( pCtx, BLOCK_WHERE("usSelectType"),   pb1->usSelectType,   pb2->usSelectType );
+        CompareNumbers( pCtx, BLOCK_WHERE("ucGroupType"),    pb1->ucGroupType,    pb2->ucGroupType );
+        CompareNumbers( pCtx, BLOCK_WHERE("usDefaultEntry"), pb1->usDefaultEntry, pb2->usDefaultEntry );
+        CompareNumbers( pCtx, BLOCK_WHERE("usNumOfEntries"), pb1->usNumOfEntries, pb2->usNumOfEntries );
+
+        cEntries = ( pb1->usNumOfEntries < pb2->usNumOfEntries ) ? pb1->usNumOfEntries : pb2->usNumOfEntries;
+        for ( e = 0; e < cEntries; e++ ) {
+            PSZ    pszOpt1 = GetString( pCtx, 0, pb1->uiEntry[ e ].ofsOption, CMP_TEXT ),
+                   pszOpt2 = GetString( pCtx, 1, pb2->uiEntry[ e ].ofsOption, CMP_TEXT );
+            CHAR   szEntry[ 40 ];
+            ULONG  ulMark = ArenaMark( pCtx->pArena );
+
+#define ENTRY_WHERE( f )    ( sprintf( szEntry, "uiEntry[%lu].%s", e, f ), BLOCK_WHERE( szEntry ))
+            CompareStrings( pCtx, ENTRY_WHERE("ofsOption"), pszOpt1, pszOpt2 );
+            CompareStrings( pCtx, ENTRY_WHERE("ofsTransString"),
+                            Xlate( pCtx, 0, pb1->uiEntry[ e ].ofsTransString, pszOpt1 ),
+                            Xlate( pCtx, 1, pb2->uiEntry[ e ].ofsTransString, pszOpt2 ));
+            CompareStrings( pCtx, ENTRY_WHERE("ofsValue"),
+                            GetString( pCtx, 0, (SHORT) pb1->uiEntry[ e ].ofsValue, CMP_COMMAND ),
+                            GetString( pCtx, 1, (SHORT) pb2->uiEntry[ e ].ofsValue, CMP_COMMAND ));
+            ArenaRelease( pCtx->pArena, ulMark );
+        }
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ComparePairs                                                              *
+ *                                                                           *
+ * qsort() comparison of two conflicting pairs.                              *
+ * ------------------------------------------------------------------------- */
+static int ComparePairs( const void *p1, const void *p2 )
+{
+    return memcmp( p1, p2, sizeof( CMPPAIR ));
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ListPairs                                                                 *
+ *                                                                           *
+ * Expand one segment's UI constraints into a sorted list of distinct        *
+ * conflicting pairs, as GeneratePPD() writes them (only the first 32        *
+ * entries of a block can be constrained).                                   *
+ * ------------------------------------------------------------------------- */
+static PCMPPAIR ListPairs( PCMPCTX pCtx, ULONG ulSide, PULONG pcPairs )
+{
+    PCMPSIDE   pSide = pCtx->a + ulSide;
+    PUIC_BLOCK puicb;
+    PCMPPAIR   pPairs;
+    UI_SEL     m1, m2;
+    ULONG      cPairs = 0,
+               c, i, j, k;
+
+    for ( i = 0, puicb = pSide->puicBlocks; i < pSide->des.stUICList.usNumOfUICs; i++, puicb++ ) {
+        for ( c = 0, m1 = puicb->uicEntry1.bOption; m1; m1 &= m1 - 1 ) c++;
+        for ( m2 = puicb->uicEntry2.bOption; m2; m2 &= m2 - 1 ) cPairs += c;
+    }
+    *pcPairs = 0;
+    if (( pPairs = (PCMPPAIR) ArenaAlloc( pCtx->pArena, ( cPairs + 1 ) * sizeof( CMPPAIR ))) == NULL )
+        return NULL;
+
+    for ( i = 0, puicb = pSide->puicBlocks; i < pSide->des.stUICList.usNumOfUICs; i++, puicb++ ) {
+        if ( puicb->uicEntry1.ofsUIBlock >= pSide->des.stUIList.usNumOfBlocks ||
+             puicb->uicEntry2.ofsUIBlock >= pSide->des.stUIList.usNumOfBlocks )
+            continue;
+        m1 = puicb->uicEntry1.bOption;
+        m2 = puicb->uicEntry2.bOption;
+        for ( j = 0; j < 32 && j < pSide->apBlocks[ puicb->uicEntry1.ofsUIBlock ]->usNumOfEntries; j++ ) {
+            if ( !( m1 & ( 1UL << j ))) continue;
+            for ( k = 0; k < 32 && k < pSide->apBlocks[ puicb->uicEntry2.ofsUIBlock ]->usNumOfEntries; k++ ) {
+                if ( !( m2 & ( 1UL << k ))) continue;
+                pPairs[ *pcPairs ].usBlock1 = puicb->uicEntry1.ofsUIBlock;
+                pPairs[ *pcPairs ].usEntry1 = (USHORT) j;
+                pPairs[ *pcPairs ].usBlock2 = puicb->uicEntry2.ofsUIBlock;
+                pPairs[ *pcPairs ].usEntry2 = (USHORT) k;
+                (*pcPairs)++;
+            }
+        }
+    }
+    qsort( pPairs, *pcPairs, sizeof( CMPPAIR ), ComparePairs );
+    for ( i = j = 0; i < *pcPairs; i++ )
+        if ( !j || ComparePairs( pPairs + i, pPairs + j - 1 )) pPairs[ j++ ] = pPairs[ i ];
+    *pcPairs = j;
+    return pPairs;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ReportPair                                                                *
+ * ------------------------------------------------------------------------- */
+static void ReportPair( PCMPCTX pCtx, ULONG ulSide, PCMPPAIR pPair )
+{
+    PCMPSIDE  pSide = pCtx->a + ulSide;
+    PUI_BLOCK pb1 = pSide->apBlocks[ pPair->usBlock1 ],
+              pb2 = pSide->apBlocks[ pPair->usBlock2 ];
+
+    Difference( pCtx, "stUICList", "*%s %s *%s %s %s",
+                GetString( pCtx, ulSide, pb1->ofsUIName, CMP_TEXT ),
+                GetString( pCtx, ulSide, pb1->uiEntry[ pPair->usEntry1 ].ofsOption, CMP_TEXT ),
+                GetString( pCtx, ulSide, pb2->ofsUIName, CMP_TEXT ),
+                GetString( pCtx, ulSide, pb2->uiEntry[ pPair->usEntry2 ].ofsOption, CMP_TEXT ),
+                ulSide ? "was added" : "was lost");
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CompareConstraints                                                        *
+ *                                                                           *
+ * Compare the sets of conflicting pairs which the UI constraints define.    *
+ * ------------------------------------------------------------------------- */
+static void CompareConstraints( PCMPCTX pCtx )
+{
+    PCMPPAIR p1, p2;
+    ULONG    c1, c2,
+             i = 0, j = 0;
+    int      iCmp;
+
+    p1 = ListPairs( pCtx, 0, &c1 );
+    p2 = ListPairs( pCtx, 1, &c2 );
+    if ( !p1 || !p2 ) return;
+    while ( i < c1 || j < c2 ) {
+        iCmp = ( i >= c1 ) ? 1 : ( j >= c2 ) ? -1 : ComparePairs( p1 + i, p2 + j );
+        if ( iCmp < 0 ) ReportPair( pCtx, 0, p1 + i++ );
+        else if ( iCmp > 0 ) ReportPair( pCtx, 1, p2 + j++ );
+        else i++, j++;
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CountFonts                                                                *
+ *                                                                           *
+ * Count a segment's font names as GeneratePPD() writes them: up to iFonts,  *
+ * stopping at the first empty name.                                         *
+ * ------------------------------------------------------------------------- */
+static ULONG CountFonts( PCMPCTX pCtx, ULONG ulSide )
+{
+    PSZ   psz = GetString( pCtx, ulSide, pCtx->a[ ulSide ].des.desFonts.ofsFontnames, CMP_TEXT );
+    ULONG c;
+
+    for ( c = 0; (LONG) c < pCtx->a[ ulSide ].des.desFonts.iFonts && *psz; c++ )
+        psz += strlen( psz ) + 1;
+    return c;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ComparePapers                                                             *
+ *                                                                           *
+ * Compare the ImageableArea and PaperDimension records, which GeneratePPD() *
+ * writes only when there is a PageSize block, and the font lists.           *
+ * ------------------------------------------------------------------------- */
+static void ComparePapers( PCMPCTX pCtx )
+{
+    PSHORT ps1, ps2;
+    PSZ    psz1, psz2;
+    CHAR   szWhere[ 64 ];
+    ULONG  c1, c2,
+           i, k;
+
+    // ImageableArea: index, four coordinates and translation string
+    c1 = pCtx->a[ 0 ].puiPaper ? pCtx->a[ 0 ].des.desPage.iImgpgpairs : 0;
+    c2 = pCtx->a[ 1 ].puiPaper ? pCtx->a[ 1 ].des.desPage.iImgpgpairs : 0;
+    CompareNumbers( pCtx, "desPage.iImgpgpairs", c1, c2 );
+    ps1 = (PSHORT)( pCtx->a[ 0 ].pInfoSeg + pCtx->a[ 0 ].des.desPage.ofsImgblPgsz );
+    ps2 = (PSHORT)( pCtx->a[ 1 ].pInfoSeg + pCtx->a[ 1 ].des.desPage.ofsImgblPgsz );
+    for ( i = 0; i < c1 && i < c2; i++ ) {
+        sprintf( szWhere, "desPage.ofsImgblPgsz[%lu]", i );
+        for ( k = 0; k < 5; k++ )
+            if ( ps1[ k ] != ps2[ k ] ) break;
+        if ( k < 5 )
+            Difference( pCtx, szWhere, "%d: %d %d %d %d became %d: %d %d %d %d",
+                        ps1[ 0 ], ps1[ 1 ], ps1[ 2 ], ps1[ 3 ], ps1[ 4 ],
+                        ps2[ 0 ], ps2[ 1 ], ps2[ 2 ], ps2[ 3 ], ps2[ 4 ] );
+        psz1 = (PSZ)( ps1 + 5 );
+        psz2 = (PSZ)( ps2 + 5 );
+        CompareStrings( pCtx, szWhere,
+            *psz1 ? psz1 : GetString( pCtx, 0, pCtx->a[ 0 ].puiPaper->uiEntry[ ps1[ 0 ]].ofsOption, CMP_TEXT ),
+            *psz2 ? psz2 : GetString( pCtx, 1, pCtx->a[ 1 ].puiPaper->uiEntry[ ps2[ 0 ]].ofsOption, CMP_TEXT ));
+        ps1 = (PSHORT)( psz1 + strlen( psz1 ) + 1 );
+        ps2 = (PSHORT)( psz2 + strlen( psz2 ) + 1 );
+    }
+
+    // PaperDimension: index, width and height
+    c1 = pCtx->a[ 0 ].puiPaper ? pCtx->a[ 0 ].des.desPage.iDmpgpairs : 0;
+    c2 = pCtx->a[ 1 ].puiPaper ? pCtx->a[ 1 ].des.desPage.iDmpgpairs : 0;
+    CompareNumbers( pCtx, "desPage.iDmpgpairs", c1, c2 );
+    ps1 = (PSHORT)( pCtx->a[ 0 ].pInfoSeg + pCtx->a[ 0 ].des.desPage.ofsDimxyPgsz );
+    ps2 = (PSHORT)( pCtx->a[ 1 ].pInfoSeg + pCtx->a[ 1 ].des.desPage.ofsDimxyPgsz );
+    for ( i = 0; i < c1 && i < c2; i++, ps1 += 3, ps2 += 3 ) {
+        if ( memcmp( ps1, ps2, DIM_RECORD_SIZE )) {
+            sprintf( szWhere, "desPage.ofsDimxyPgsz[%lu]", i );
+            Difference( pCtx, szWhere, "%d: %d %d became %d: %d %d",
+                        ps1[ 0 ], ps1[ 1 ], ps1[ 2 ], ps2[ 0 ], ps2[ 1 ], ps2[ 2 ] );
+        }
+    }
+
+    // Font names, up to the first empty one
+    c1 = CountFonts( pCtx, 0 );
+    c2 = CountFonts( pCtx, 1 );
+    CompareNumbers( pCtx, "desFonts.iFonts", c1, c2 );
+    psz1 = GetString( pCtx, 0, pCtx->a[ 0 ].des.desFonts.ofsFontnames, CMP_TEXT );
+    psz2 = GetString( pCtx, 1, pCtx->a[ 1 ].des.desFonts.ofsFontnames, CMP_TEXT );
+    for ( i = 0; i < c1 && i < c2; i++ ) {
+        sprintf( szWhere, "desFonts.ofsFontnames[%lu]", i );
+        CompareStrings( pCtx, szWhere, psz1, psz2 );
+        psz1 += strlen( psz1 ) + 1;
+        psz2 += strlen( psz2 ) + 1;
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakCompareDevices                                                         *
+ *                                                                           *
+ * Compare two device segments field by field, reporting each difference in  *
+ * the data which a PPD file can carry.                                      *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAK_DEV_DIRENTRY pEntry    : Directory entry (for the printer name)    *
+ *   PBYTE             pBuf1     : First segment (e.g. from the PAK file)    *
+ *   PBYTE             pBuf2     : Second segment (e.g. recompiled)          *
+ *   PPAKARENA         pArena    : Scratch arena (or NULL)                   *
+ *   POUTBUF           pOut      : Output buffer, or NULL for STDOUT         *
+ *   PULONG            pflDropped: Receives a bit for each field (see        *
+ *                                 PakCompareDropped) which the first        *
+ *                                 segment uses but a PPD cannot carry       *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   Number of differences reported                                          *
+ * ------------------------------------------------------------------------- */
+ULONG PakCompareDevices( PPAK_DEV_DIRENTRY pEntry, PBYTE pBuf1, PBYTE pBuf2, PPAKARENA pArena,
+                         POUTBUF pOut, PULONG pflDropped )
+{
+    CMPCTX    ctx;
+    PPAKFIELD pField;
+    PAKARENA  arLocal = {0};
+    USHORT    fsCompare;
+    ULONG     ulMark,
+              ulGroup;
+    LONG      l1, l2;
+
+    memset( &ctx, 0, sizeof( ctx ));
+    ctx.pEntry = pEntry;
+    ctx.pArena = pArena ? pArena : &arLocal;
+    ctx.pOut   = pOut;
+    *pflDropped = 0;
+    ulMark = ArenaMark( ctx.pArena );
+    if ( !LoadSide( &ctx, 0, pBuf1 ) || !LoadSide( &ctx, 1, pBuf2 )) {
+        Difference( &ctx, "(all)", "out of memory; not compared");
+        goto cleanup;
+    }
+
+    // Each DESPPD field a PPD file can carry is compared as its PF_* flags say,
+    // except sizes and tables, which are compared through what they describe
+    for ( pField = PakFieldTable( PAKFT_DESPPD ), ulGroup = 0; pField->pszName; pField++ ) {
+        l1 = PakFieldValue( pField, &(ctx.a[ 0 ].des ));
+        l2 = PakFieldValue( pField, &(ctx.a[ 1 ].des ));
+        if ( pField->fs & PF_NO_PPD ) {
+            if ( l1 > 0 && ulGroup < CMP_MAX_DROPPED ) *pflDropped |= 1UL << ulGroup;
+            ulGroup++;
+        }
+        else if ( pField->fs & ( PF_COUNT | PF_TABLE | PF_POINTER )) continue;
+        else if ( pField->fs & PF_STRING ) {
+            fsCompare = (( pField->fs & PF_COMMAND ) ? CMP_COMMAND : CMP_TEXT ) |
+                        (( pField->fs & PF_ZERO_OK ) ? CMP_ZERO_OK : 0 );
+            CompareStrings( &ctx, pField->pszName, GetString( &ctx, 0, l1, fsCompare ),
+                            GetString( &ctx, 1, l2, fsCompare ));
+        }
+        else CompareNumbers( &ctx, pField->pszName, l1, l2 );
+    }
+    CompareBlocks( &ctx, ulGroup, pflDropped );
+    CompareConstraints( &ctx );
+    ComparePapers( &ctx );
+
+cleanup:
+    ArenaRelease( ctx.pArena, ulMark );
+    if ( ctx.pArena == &arLocal ) ArenaFree( &arLocal );
+    return ctx.cDiffs;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakCompareDropped                                                         *
+ *                                                                           *
+ * Name a field which a PPD file cannot carry.  These are numbered in the    *
+ * order of the DESPPD field table, followed by those of UI_BLOCK.           *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   ULONG ulGroup: Field number (bit number in PakCompareDevices' flags)    *
+ *                                                                           *
+ * RETURNS: PSZ                                                              *
+ *   Name of the field, or NULL if ulGroup is past the last one              *
+ * ------------------------------------------------------------------------- */
+PSZ PakCompareDropped( ULONG ulGroup )
+{
+    PPAKFIELD pField;
+    ULONG     i;
+
+    for ( i = 0; i < sizeof( aulDropTables ) / sizeof( ULONG ); i++ ) {
+        for ( pField = PakFieldTable( aulDropTables[ i ] ); pField->pszName; pField++ ) {
+            if ( !( pField->fs & PF_NO_PPD )) continue;
+            if ( !ulGroup-- ) return pField->pszName;
+        }
+    }
+    return NULL;
+}
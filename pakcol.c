@@ -0,0 +1,480 @@
+/*
+ * pakcol.c
+ *
+ * PAKTOOL library: columnar printer fields and filter expressions.  See
+ * paklib.h for an overview.
+ *
+ * The fixed-size scalar fields of every printer's DESPPD (those of PPD1,
+ * PPD2, PPD4, PPD5 and PPD6 which are counts, flags or measurements rather
+ * than string offsets) are copied into one column of LONGs per field.  A
+ * filter expression is compiled into a short postfix program, which is then
+ * run a column at a time: each operation is a single loop over all the
+ * printers, so that selecting from thousands of printers costs only a few
+ * passes over a few small arrays.
+ */
+
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+
+// Field types
+#define FLD_SHORT       1
+#define FLD_USHORT      2
+#define FLD_LONG        3
+
+// A scalar field of DESPPD
+typedef struct _COLFIELD
+{
+    PSZ    pszName;             // name used in expressions
+    PSZ    pszDesc;             // description
+    ULONG  ulOffset;            // offset of field within DESPPD
+    USHORT usType;              // FLD_* type
+} COLFIELD;
+
+#define COLFIELD( n, f, t, d )  { n, d, offsetof( DESPPD, f ), t }
+
+static COLFIELD aColFields[] = {
+    COLFIELD( "ppm",        desItems.iPpm,                     FLD_SHORT,  "pages per minute"),
+    COLFIELD( "freevm",     desItems.lFreeVM,                  FLD_LONG,   "free virtual memory (bytes)"),
+    COLFIELD( "dpi",        desItems.iResDpi,                  FLD_SHORT,  "resolution (dpi)"),
+    COLFIELD( "screenfreq", desItems.lScrFreq,                 FLD_LONG,   "halftone screen frequency (x 100)"),
+    COLFIELD( "screenangle",desItems.iScreenAngle,             FLD_LONG,   "halftone screen angle"),
+    COLFIELD( "color",      desItems.fIsColorDevice,           FLD_SHORT,  "colour device"),
+    COLFIELD( "filesystem", desItems.fIsFileSystem,            FLD_SHORT,  "has a file system"),
+    COLFIELD( "level",      desItems.usLanguageLevel,          FLD_USHORT, "PostScript language level"),
+    COLFIELD( "duplex",     desItems.sDefaultDuplex,           FLD_SHORT,  "default duplex mode (-1 to 2)"),
+    COLFIELD( "varpaper",   desPage.fIsVariablePaper,          FLD_SHORT,  "supports custom page sizes"),
+    COLFIELD( "minwidth",   desPage.iCustomPageSizeMinWidth,   FLD_SHORT,  "custom page minimum width"),
+    COLFIELD( "maxwidth",   desPage.iCustomPageSizeMaxWidth,   FLD_SHORT,  "custom page maximum width"),
+    COLFIELD( "minheight",  desPage.iCustomPageSizeMinHeight,  FLD_SHORT,  "custom page minimum height"),
+    COLFIELD( "maxheight",  desPage.iCustomPageSizeMaxHeight,  FLD_SHORT,  "custom page maximum height"),
+    COLFIELD( "papers",     desPage.iDmpgpairs,                FLD_SHORT,  "number of paper dimensions"),
+    COLFIELD( "reverse",    desOutbins.fIsDefoutorder,         FLD_SHORT,  "default output order is reverse"),
+    COLFIELD( "outbins",    desOutbins.iOutbinpairs,           FLD_SHORT,  "number of output bins"),
+    COLFIELD( "fonts",      desFonts.iFonts,                   FLD_SHORT,  "number of resident fonts"),
+    COLFIELD( "forms",      desForms.usFormCount,              FLD_USHORT, "number of forms"),
+    COLFIELD( "uiblocks",   stUIList.usNumOfBlocks,            FLD_USHORT, "number of UI blocks"),
+    COLFIELD( "constraints",stUICList.usNumOfUICs,             FLD_USHORT, "number of UI constraints"),
+    { NULL, NULL, 0, 0 }
+};
+
+#define COL_FIELDS      ( sizeof( aColFields ) / sizeof( COLFIELD ) - 1 )
+
+// Operations of a compiled expression
+#define COP_COLUMN      1       // push a column (lArg = field number)
+#define COP_CONST       2       // push a constant (lArg)
+#define COP_NOT         3       // logical operators
+#define COP_AND         4
+#define COP_OR          5
+#define COP_LT          6       // comparisons
+#define COP_LE          7
+#define COP_GT          8
+#define COP_GE          9
+#define COP_EQ          10
+#define COP_NE          11
+
+// Compiler state
+typedef struct _COLPARSE
+{
+    PSZ         pszExpr;        // the expression
+    PSZ         psz;            // current position
+    PPAKCOLEXPR pExpr;          // program being compiled
+    ULONG       cDepth;         // stack depth at this point
+    BOOL        fError;         // TRUE once an error is found
+} COLPARSE, *PCOLPARSE;
+
+static VOID ParseOr( PCOLPARSE pCtx );
+
+
+/* ------------------------------------------------------------------------- *
+ * PakColsField                                                              *
+ *                                                                           *
+ * Describe one of the fields which may be used in expressions.              *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   ULONG ulField : Field number                                            *
+ *   PSZ  *ppszDesc: Receives the description of the field (or NULL)         *
+ *                                                                           *
+ * RETURNS: PSZ                                                              *
+ *   The name of the field, or NULL if ulField is past the last one          *
+ * ------------------------------------------------------------------------- */
+PSZ PakColsField( ULONG ulField, PSZ *ppszDesc )
+{
+    if ( ulField >= COL_FIELDS ) return NULL;
+    if ( ppszDesc ) *ppszDesc = aColFields[ ulField ].pszDesc;
+    return aColFields[ ulField ].pszName;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakColsBuild                                                              *
+ *                                                                           *
+ * Copy the scalar fields of every printer in a PAK file into columns.       *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID              pHeap    : Heap to allocate from (or NULL)           *
+ *   PBYTE              pbFile   : PAK file image                            *
+ *   ULONG              cbFile   : Size of the image                         *
+ *   PPAK_DEV_DIRENTRY  pEntries : Directory, in V1 form (must stay in       *
+ *                                 memory while the columns are used)        *
+ *   ULONG              cEntries : Number of directory entries               *
+ *   PPAKCOLS          *ppCols   : Receives the columns (free with           *
+ *                                 PakColsFree)                              *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success or ERROR_NOT_ENOUGH_MEMORY.  A printer whose segment lies  *
+ *   outside the file, or is too small to hold a DESPPD, is never selected.  *
+ * ------------------------------------------------------------------------- */
+ULONG PakColsBuild( PVOID pHeap, PBYTE pbFile, ULONG cbFile, PPAK_DEV_DIRENTRY pEntries,
+                    ULONG cEntries, PPAKCOLS *ppCols )
+{
+    PPAKCOLS pCols;
+    PBYTE    pb;
+    PLONG    plCol;
+    ULONG    cWords,
+             cb, i, f;
+
+    *ppCols = NULL;
+    cWords = ( cEntries + 31 ) / 32;
+    cb = sizeof( PAKCOLS ) + ( COL_FIELDS * cEntries + cWords ) * sizeof( LONG );
+    if (( pCols = (PPAKCOLS) PakAlloc( pHeap, cb )) == NULL )
+        return ERROR_NOT_ENOUGH_MEMORY;
+    memset( pCols, 0, cb );
+    pCols->cRows     = cEntries;
+    pCols->pEntries  = pEntries;
+    pCols->cFields   = COL_FIELDS;
+    pCols->plColumns = (PLONG)( pCols + 1 );
+    pCols->pulValid  = (PULONG)( pCols->plColumns + COL_FIELDS * cEntries );
+
+    // Each field is gathered into its own column, so that the expression
+    // engine reads only the columns it uses
+    for ( i = 0; i < cEntries; i++ ) {
+        if (( pEntries[ i ].ulOffset > cbFile ) ||
+            ( pEntries[ i ].ulSize > cbFile - pEntries[ i ].ulOffset ) ||
+            ( pEntries[ i ].ulSize < sizeof( DESPPD )))
+            continue;
+        pCols->pulValid[ i / 32 ] |= 1UL << ( i % 32 );
+        pb = pbFile + pEntries[ i ].ulOffset;
+        for ( f = 0, plCol = pCols->plColumns + i; f < COL_FIELDS; f++, plCol += cEntries ) {
+            switch ( aColFields[ f ].usType ) {
+                case FLD_SHORT:  *plCol = *((PSHORT)( pb + aColFields[ f ].ulOffset ));  break;
+                case FLD_USHORT: *plCol = *((PUSHORT)( pb + aColFields[ f ].ulOffset )); break;
+                case FLD_LONG:   *plCol = *((PLONG)( pb + aColFields[ f ].ulOffset ));   break;
+            }
+        }
+    }
+    *ppCols = pCols;
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakColsFree                                                               *
+ * ------------------------------------------------------------------------- */
+VOID PakColsFree( PVOID pHeap, PPAKCOLS pCols )
+{
+    PakFree( pHeap, pCols );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * Accept                                                                    *
+ *                                                                           *
+ * Skip white space, then the given token if it comes next.  A word token    *
+ * (such as "and") must not be followed by another letter or digit.          *
+ *                                                                           *
+ * RETURNS: BOOL                                                             *
+ *   TRUE if the token was found (and skipped)                               *
+ * ------------------------------------------------------------------------- */
+static BOOL Accept( PCOLPARSE pCtx, PSZ pszToken )
+{
+    ULONG cch = strlen( pszToken );
+
+    while ( isspace( (UCHAR) *pCtx->psz )) pCtx->psz++;
+    if ( strnicmp( pCtx->psz, pszToken, cch ) != 0 ) return FALSE;
+    if ( isalpha( (UCHAR) *pszToken ) && ( isalnum( (UCHAR) pCtx->psz[ cch ] ) || pCtx->psz[ cch ] == '_'))
+        return FALSE;
+    pCtx->psz += cch;
+    return TRUE;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * Emit                                                                      *
+ *                                                                           *
+ * Add an operation to the program, keeping track of the stack depth.        *
+ * ------------------------------------------------------------------------- */
+static VOID Emit( PCOLPARSE pCtx, USHORT usOp, LONG lArg )
+{
+    PPAKCOLEXPR pExpr = pCtx->pExpr;
+
+    if ( pCtx->fError ) return;
+    pExpr->aOps[ pExpr->cOps ].usOp = usOp;
+    pExpr->aOps[ pExpr->cOps ].lArg = lArg;
+    pExpr->cOps++;
+    if ( usOp == COP_COLUMN || usOp == COP_CONST ) {
+        if ( ++pCtx->cDepth > pExpr->cDepth ) pExpr->cDepth = pCtx->cDepth;
+    }
+    else if ( usOp != COP_NOT )
+        pCtx->cDepth--;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ParseTerm                                                                 *
+ *                                                                           *
+ * term := '(' or-expression ')' | [-] number [K|M] | field                  *
+ * ------------------------------------------------------------------------- */
+static VOID ParseTerm( PCOLPARSE pCtx )
+{
+    PSZ   psz;
+    LONG  l;
+    ULONG cch, f;
+
+    if ( pCtx->fError ) return;
+    if ( Accept( pCtx, "(")) {
+        ParseOr( pCtx );
+        if ( !Accept( pCtx, ")")) pCtx->fError = TRUE;
+        return;
+    }
+
+    psz = pCtx->psz;
+    if ( isdigit( (UCHAR) *psz ) || ( *psz == '-' && isdigit( (UCHAR) psz[ 1 ] ))) {
+        l = strtol( psz, (char **) &pCtx->psz, 0 );
+        if ( toupper( *pCtx->psz ) == 'K' )      { l *= 1024L;        pCtx->psz++; }
+        else if ( toupper( *pCtx->psz ) == 'M' ) { l *= 1024L * 1024; pCtx->psz++; }
+        if ( isalnum( (UCHAR) *pCtx->psz )) pCtx->fError = TRUE;
+        Emit( pCtx, COP_CONST, l );
+        return;
+    }
+
+    for ( cch = 0; isalnum( (UCHAR) psz[ cch ] ) || psz[ cch ] == '_'; cch++ );
+    for ( f = 0; f < COL_FIELDS; f++ ) {
+        if (( strlen( aColFields[ f ].pszName ) == cch ) &&
+            ( strnicmp( aColFields[ f ].pszName, psz, cch ) == 0 ))
+            break;
+    }
+    if ( !cch || f == COL_FIELDS ) {
+        pCtx->fError = TRUE;
+        return;
+    }
+    pCtx->psz += cch;
+    Emit( pCtx, COP_COLUMN, f );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ParseCompare                                                              *
+ *                                                                           *
+ * comparison := term [ ( < | <= | > | >= | == | = | != ) term ]             *
+ * ------------------------------------------------------------------------- */
+static VOID ParseCompare( PCOLPARSE pCtx )
+{
+    USHORT usOp;
+
+    ParseTerm( pCtx );
+    if      ( Accept( pCtx, "<=")) usOp = COP_LE;
+    else if ( Accept( pCtx, ">=")) usOp = COP_GE;
+    else if ( Accept( pCtx, "==")) usOp = COP_EQ;
+    else if ( Accept( pCtx, "!=")) usOp = COP_NE;
+    else if ( Accept( pCtx, "<"))  usOp = COP_LT;
+    else if ( Accept( pCtx, ">"))  usOp = COP_GT;
+    else if ( Accept( pCtx, "="))  usOp = COP_EQ;
+    else return;
+    ParseTerm( pCtx );
+    Emit( pCtx, usOp, 0 );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ParseNot                                                                  *
+ *                                                                           *
+ * not-expression := ( ! | not ) not-expression | comparison                 *
+ * ------------------------------------------------------------------------- */
+static VOID ParseNot( PCOLPARSE pCtx )
+{
+    while ( isspace( (UCHAR) *pCtx->psz )) pCtx->psz++;
+    if (( pCtx->psz[ 0 ] == '!' && pCtx->psz[ 1 ] != '=' && Accept( pCtx, "!")) ||
+        Accept( pCtx, "not"))
+    {
+        ParseNot( pCtx );
+        Emit( pCtx, COP_NOT, 0 );
+    }
+    else
+        ParseCompare( pCtx );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ParseAnd                                                                  *
+ *                                                                           *
+ * and-expression := not-expression { ( && | and ) not-expression }          *
+ * ------------------------------------------------------------------------- */
+static VOID ParseAnd( PCOLPARSE pCtx )
+{
+    ParseNot( pCtx );
+    while ( !pCtx->fError && ( Accept( pCtx, "&&") || Accept( pCtx, "and"))) {
+        ParseNot( pCtx );
+        Emit( pCtx, COP_AND, 0 );
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ParseOr                                                                   *
+ *                                                                           *
+ * or-expression := and-expression { ( || | or ) and-expression }            *
+ * ------------------------------------------------------------------------- */
+static VOID ParseOr( PCOLPARSE pCtx )
+{
+    ParseAnd( pCtx );
+    while ( !pCtx->fError && ( Accept( pCtx, "||") || Accept( pCtx, "or"))) {
+        ParseAnd( pCtx );
+        Emit( pCtx, COP_OR, 0 );
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakColsCompile                                                            *
+ *                                                                           *
+ * Compile a filter expression.  Expressions combine fields (by the names    *
+ * given by PakColsField) and integer constants, which may have a suffix of  *
+ * K or M (x 1024 or x 1048576), with the comparisons < <= > >= == (or =)    *
+ * and !=, and the logical operators ! (or not), && (or and) and || (or or). *
+ * A field or constant on its own is true if it is non-zero.  For example:   *
+ *   color && level >= 3 && dpi >= 600                                       *
+ *   varpaper and maxwidth >= 842 or freevm > 4M                             *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID        pHeap    : Heap to allocate from (or NULL)                 *
+ *   PSZ          pszExpr  : The expression                                  *
+ *   PPAKCOLEXPR *ppExpr   : Receives the program (free with PakFree)        *
+ *   PULONG       pulErrPos: Receives the position of a syntax error         *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_INVALID_PARAMETER if the expression is not valid,   *
+ *   or ERROR_NOT_ENOUGH_MEMORY                                              *
+ * ------------------------------------------------------------------------- */
+ULONG PakColsCompile( PVOID pHeap, PSZ pszExpr, PPAKCOLEXPR *ppExpr, PULONG pulErrPos )
+{
+    COLPARSE ctx;
+    ULONG    cb;
+
+    *ppExpr    = NULL;
+    *pulErrPos = 0;
+
+    // No token produces more than one operation
+    cb = sizeof( PAKCOLEXPR ) + strlen( pszExpr ) * sizeof( PAKCOLOP );
+    if (( ctx.pExpr = (PPAKCOLEXPR) PakAlloc( pHeap, cb )) == NULL )
+        return ERROR_NOT_ENOUGH_MEMORY;
+    memset( ctx.pExpr, 0, cb );
+    ctx.pszExpr = pszExpr;
+    ctx.psz     = pszExpr;
+    ctx.cDepth  = 0;
+    ctx.fError  = FALSE;
+
+    ParseOr( &ctx );
+    while ( isspace( (UCHAR) *ctx.psz )) ctx.psz++;
+    if ( ctx.fError || *ctx.psz ) {
+        *pulErrPos = ctx.psz - pszExpr;
+        PakFree( pHeap, ctx.pExpr );
+        return ERROR_INVALID_PARAMETER;
+    }
+    *ppExpr = ctx.pExpr;
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakColsSelect                                                             *
+ *                                                                           *
+ * Find the printers for which a compiled expression is true.                *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID       pHeap   : Heap for temporary memory (or NULL)               *
+ *   PPAKCOLS    pCols   : Printer fields                                    *
+ *   PPAKCOLEXPR pExpr   : Compiled expression                               *
+ *   PULONG      pulMatch: Receives a bitset of the printers selected        *
+ *                         (( pCols->cRows + 31 ) / 32 ULONGs)               *
+ *   PULONG      pcMatch : Receives the number of printers selected          *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success or ERROR_NOT_ENOUGH_MEMORY                                 *
+ * ------------------------------------------------------------------------- */
+ULONG PakColsSelect( PVOID pHeap, PPAKCOLS pCols, PPAKCOLEXPR pExpr, PULONG pulMatch, PULONG pcMatch )
+{
+    PLONG    plScratch,
+            *aplStack,
+             plA, plB, plOut;
+    ULONG    cRows = pCols->cRows,
+             sp = 0,
+             op, i;
+    LONG     l;
+
+    memset( pulMatch, 0, (( cRows + 31 ) / 32 ) * sizeof( ULONG ));
+    *pcMatch = 0;
+    if ( !cRows ) return NO_ERROR;
+
+    // Each stack slot has a vector of its own for results; a column is
+    // pushed by pointing its slot at the column itself
+    plScratch = (PLONG) PakAlloc( pHeap, pExpr->cDepth * cRows * sizeof( LONG ) +
+                                         pExpr->cDepth * sizeof( PLONG ));
+    if ( !plScratch ) return ERROR_NOT_ENOUGH_MEMORY;
+    aplStack = (PLONG *)( plScratch + pExpr->cDepth * cRows );
+
+#define VECTOR_OP( e )  for ( i = 0; i < cRows; i++ ) plOut[ i ] = ( e )
+
+    for ( op = 0; op < pExpr->cOps; op++ ) {
+        switch ( pExpr->aOps[ op ].usOp ) {
+            case COP_COLUMN:
+                aplStack[ sp++ ] = pCols->plColumns + pExpr->aOps[ op ].lArg * cRows;
+                continue;
+            case COP_CONST:
+                plOut = plScratch + sp * cRows;
+                l = pExpr->aOps[ op ].lArg;
+                VECTOR_OP( l );
+                aplStack[ sp++ ] = plOut;
+                continue;
+            case COP_NOT:
+                plA   = aplStack[ sp - 1 ];
+                plOut = plScratch + ( sp - 1 ) * cRows;
+                VECTOR_OP( !plA[ i ] );
+                aplStack[ sp - 1 ] = plOut;
+                continue;
+        }
+        plA   = aplStack[ sp - 2 ];
+        plB   = aplStack[ sp - 1 ];
+        plOut = plScratch + ( sp - 2 ) * cRows;
+        switch ( pExpr->aOps[ op ].usOp ) {
+            case COP_AND: VECTOR_OP( plA[ i ] && plB[ i ] ); break;
+            case COP_OR:  VECTOR_OP( plA[ i ] || plB[ i ] ); break;
+            case COP_LT:  VECTOR_OP( plA[ i ] <  plB[ i ] ); break;
+            case COP_LE:  VECTOR_OP( plA[ i ] <= plB[ i ] ); break;
+            case COP_GT:  VECTOR_OP( plA[ i ] >  plB[ i ] ); break;
+            case COP_GE:  VECTOR_OP( plA[ i ] >= plB[ i ] ); break;
+            case COP_EQ:  VECTOR_OP( plA[ i ] == plB[ i ] ); break;
+            case COP_NE:  VECTOR_OP( plA[ i ] != plB[ i ] ); break;
+        }
+        aplStack[ --sp - 1 ] = plOut;
+    }
+
+#undef VECTOR_OP
+
+    plA = aplStack[ 0 ];
+    for ( i = 0; i < cRows; i++ ) {
+        if ( plA[ i ] && ( pCols->pulValid[ i / 32 ] & ( 1UL << ( i % 32 )))) {
+            pulMatch[ i / 32 ] |= 1UL << ( i % 32 );
+            (*pcMatch)++;
+        }
+    }
+    PakFree( pHeap, plScratch );
+    return NO_ERROR;
+}
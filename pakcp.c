@@ -0,0 +1,224 @@
+/*
+ * pakcp.c
+ *
+ * PAKTOOL library: code page conversion.  The strings in a PAK file are in
+ * code page 850, the PPD compiler having stored the bytes of the PPD file as
+ * they were, but the programs which read PAKTOOL's output now expect UTF-8.
+ * Cp850ToUtf8() converts one to the other through a table of the upper 128
+ * characters.  Runs of ASCII, which make up nearly all of any PAK file, are
+ * found four bytes at a time and copied as they are, so that converting a
+ * string with no accented letters costs little more than finding its end.
+ * Utf8ToCp850() converts back, so that a PPD file written in UTF-8 can be
+ * compiled again.
+ */
+
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+
+// Unicode values of code page 850 characters 0x80 to 0xFF
+static USHORT ausCp850[ 128 ] = {
+    0x00C7, 0x00FC, 0x00E9, 0x00E2, 0x00E4, 0x00E0, 0x00E5, 0x00E7,   // 80
+    0x00EA, 0x00EB, 0x00E8, 0x00EF, 0x00EE, 0x00EC, 0x00C4, 0x00C5,   // 88
+    0x00C9, 0x00E6, 0x00C6, 0x00F4, 0x00F6, 0x00F2, 0x00FB, 0x00F9,   // 90
+    0x00FF, 0x00D6, 0x00DC, 0x00F8, 0x00A3, 0x00D8, 0x00D7, 0x0192,   // 98
+    0x00E1, 0x00ED, 0x00F3, 0x00FA, 0x00F1, 0x00D1, 0x00AA, 0x00BA,   // A0
+    0x00BF, 0x00AE, 0x00AC, 0x00BD, 0x00BC, 0x00A1, 0x00AB, 0x00BB,   // A8
+    0x2591, 0x2592, 0x2593, 0x2502, 0x2524, 0x00C1, 0x00C2, 0x00C0,   // B0
+    0x00A9, 0x2563, 0x2551, 0x2557, 0x255D, 0x00A2, 0x00A5, 0x2510,   // B8
+    0x2514, 0x2534, 0x252C, 0x251C, 0x2500, 0x253C, 0x00E3, 0x00C3,   // C0
+    0x255A, 0x2554, 0x2569, 0x2566, 0x2560, 0x2550, 0x256C, 0x00A4,   // C8
+    0x00F0, 0x00D0, 0x00CA, 0x00CB, 0x00C8, 0x0131, 0x00CD, 0x00CE,   // D0
+    0x00CF, 0x2518, 0x250C, 0x2588, 0x2584, 0x00A6, 0x00CC, 0x2580,   // D8
+    0x00D3, 0x00DF, 0x00D4, 0x00D2, 0x00F5, 0x00D5, 0x00B5, 0x00FE,   // E0
+    0x00DE, 0x00DA, 0x00DB, 0x00D9, 0x00FD, 0x00DD, 0x00AF, 0x00B4,   // E8
+    0x00AD, 0x00B1, 0x2017, 0x00BE, 0x00B6, 0x00A7, 0x00F7, 0x00B8,   // F0
+    0x00B0, 0x00A8, 0x00B7, 0x00B9, 0x00B3, 0x00B2, 0x25A0, 0x00A0    // F8
+};
+
+
+/* ------------------------------------------------------------------------- *
+ * AsciiRun                                                                  *
+ *                                                                           *
+ * Get the number of bytes at the start of a buffer which are below 128.     *
+ * ------------------------------------------------------------------------- */
+static ULONG AsciiRun( PBYTE pb, ULONG cb )
+{
+    ULONG ul,
+          i = 0;
+
+    // Four bytes at a time, while none of them has its top bit set
+    for ( ; i + sizeof( ULONG ) <= cb; i += sizeof( ULONG )) {
+        memcpy( &ul, pb + i, sizeof( ULONG ));
+        if ( ul & 0x80808080UL ) break;
+    }
+    while ( i < cb && pb[ i ] < 0x80 ) i++;
+    return i;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * Cp850ToUtf8                                                               *
+ *                                                                           *
+ * Convert text from code page 850 to UTF-8.  Each byte above 127 becomes    *
+ * two or three bytes (the box-drawing characters need three), so the output *
+ * may be up to three times the size of the input.                           *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PBYTE pb   : Text to convert                                            *
+ *   ULONG cb   : Length of the text                                         *
+ *   PBYTE pbOut: Receives the UTF-8 text (not null-terminated), or NULL to  *
+ *                measure it only                                            *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   Length of the UTF-8 text                                                *
+ * ------------------------------------------------------------------------- */
+ULONG Cp850ToUtf8( PBYTE pb, ULONG cb, PBYTE pbOut )
+{
+    USHORT us;
+    ULONG  cbRun,
+           cbOut = 0;
+
+    while ( cb ) {
+        cbRun = AsciiRun( pb, cb );
+        if ( pbOut ) memcpy( pbOut + cbOut, pb, cbRun );
+        cbOut += cbRun;
+        pb    += cbRun;
+        cb    -= cbRun;
+        for ( ; cb && *pb >= 0x80; pb++, cb-- ) {
+            us = ausCp850[ *pb - 0x80 ];
+            if ( us < 0x800 ) {
+                if ( pbOut ) {
+                    pbOut[ cbOut ]     = (BYTE)( 0xC0 | ( us >> 6 ));
+                    pbOut[ cbOut + 1 ] = (BYTE)( 0x80 | ( us & 0x3F ));
+                }
+                cbOut += 2;
+            }
+            else {
+                if ( pbOut ) {
+                    pbOut[ cbOut ]     = (BYTE)( 0xE0 | ( us >> 12 ));
+                    pbOut[ cbOut + 1 ] = (BYTE)( 0x80 | (( us >> 6 ) & 0x3F ));
+                    pbOut[ cbOut + 2 ] = (BYTE)( 0x80 | ( us & 0x3F ));
+                }
+                cbOut += 3;
+            }
+        }
+    }
+    return cbOut;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * Cp850String                                                               *
+ *                                                                           *
+ * Get a UTF-8 copy of a code page 850 string, for formatting.               *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAKARENA pArena: Arena to allocate the copy from                       *
+ *   PSZ       psz   : String to convert                                     *
+ *                                                                           *
+ * RETURNS: PSZ                                                              *
+ *   The copy; or psz itself if it is all ASCII (or no memory is left)       *
+ * ------------------------------------------------------------------------- */
+PSZ Cp850String( PPAKARENA pArena, PSZ psz )
+{
+    PSZ   pszOut;
+    ULONG cb = strlen( psz );
+
+    if ( AsciiRun( psz, cb ) == cb ) return psz;
+    if (( pszOut = (PSZ) ArenaAlloc( pArena, Cp850ToUtf8( psz, cb, NULL ) + 1 )) == NULL )
+        return psz;
+    pszOut[ Cp850ToUtf8( psz, cb, pszOut ) ] = 0;
+    return pszOut;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * OutCp850                                                                  *
+ *                                                                           *
+ * Write code page 850 text to an output buffer as UTF-8.                    *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   POUTBUF pOut: Output buffer, or NULL for STDOUT                         *
+ *   PBYTE   pb  : Text to write                                             *
+ *   ULONG   cb  : Length of the text                                        *
+ * ------------------------------------------------------------------------- */
+void OutCp850( POUTBUF pOut, PBYTE pb, ULONG cb )
+{
+    BYTE  abUtf8[ 3 * 32 ];
+    ULONG cbRun;
+
+    while ( cb ) {
+        cbRun = AsciiRun( pb, cb );
+        if ( cbRun ) OutWrite( pOut, pb, cbRun );
+        pb += cbRun;
+        cb -= cbRun;
+        for ( cbRun = 0; cbRun < cb && cbRun < 32 && pb[ cbRun ] >= 0x80; cbRun++ );
+        if ( cbRun ) OutWrite( pOut, abUtf8, Cp850ToUtf8( pb, cbRun, abUtf8 ));
+        pb += cbRun;
+        cb -= cbRun;
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * Utf8ToCp850                                                               *
+ *                                                                           *
+ * Convert a UTF-8 string to code page 850, in place.  Characters which code *
+ * page 850 lacks become '?'; bytes which do not form UTF-8 characters are   *
+ * taken to be in code page 850 already, and are left alone.                 *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ psz: String to convert                                              *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   The number of characters replaced by '?'                                *
+ * ------------------------------------------------------------------------- */
+ULONG Utf8ToCp850( PSZ psz )
+{
+    PBYTE  pbIn = (PBYTE) psz,
+           pbOut = (PBYTE) psz;
+    ULONG  ulChar,
+           cbChar,
+           cMissing = 0,
+           i;
+
+    while ( *pbIn ) {
+        if ( *pbIn < 0x80 ) {
+            *pbOut++ = *pbIn++;
+            continue;
+        }
+
+        // Decode one character of two, three or four bytes
+        if (( *pbIn & 0xE0 ) == 0xC0 )      { ulChar = *pbIn & 0x1F; cbChar = 2; }
+        else if (( *pbIn & 0xF0 ) == 0xE0 ) { ulChar = *pbIn & 0x0F; cbChar = 3; }
+        else if (( *pbIn & 0xF8 ) == 0xF0 ) { ulChar = *pbIn & 0x07; cbChar = 4; }
+        else cbChar = 0;
+        for ( i = 1; i < cbChar; i++ ) {
+            if (( pbIn[ i ] & 0xC0 ) != 0x80 ) break;
+            ulChar = ( ulChar << 6 ) | ( pbIn[ i ] & 0x3F );
+        }
+        if ( !cbChar || i < cbChar ) {
+            *pbOut++ = *pbIn++;
+            continue;
+        }
+        pbIn += cbChar;
+
+        for ( i = 0; i < 128 && ausCp850[ i ] != ulChar; i++ );
+        if ( i < 128 )
+            *pbOut++ = (BYTE)( 0x80 + i );
+        else if ( ulChar < 0x80 )
+            *pbOut++ = (BYTE) ulChar;       // over-long form of an ASCII character
+        else {
+            *pbOut++ = '?';
+            cMissing++;
+        }
+    }
+    *pbOut = 0;
+    return cMissing;
+}
@@ -0,0 +1,813 @@
+/*
+ * pakdelta.c
+ *
+ * PAKTOOL library: binary patches between two versions of a device PAK file.
+ * PakMakePatch() describes the new file as a sequence of regions - the
+ * header and directory, each segment (in file order, shared segments once)
+ * and any bytes between or after them - and encodes each region as
+ * operations which either copy a run of bytes from the old file or carry
+ * new bytes in the patch.  A segment whose printer is also in the old file
+ * is matched first against the old copy of that segment, so an unchanged
+ * printer costs a few bytes and a changed one little more than its changes;
+ * anything else is matched through an index of 16-byte blocks of the old
+ * file, found at any alignment by a rolling checksum.  PakApplyPatch()
+ * rebuilds the new file from the old one and the patch, and checks both
+ * files against the sizes and checksums recorded in the patch.
+ *
+ * A patch is a PAKPATCHHDR followed by its regions.  Each region is a kind
+ * byte (PATCH_*), a name (length byte and text; the printer name of the
+ * first segment), the number of segments it holds (a run of unchanged
+ * segments, which follow one another in both files, is one region), the
+ * number of bytes it produces and the number of bytes of operations which
+ * follow, all as variable-length numbers of 7 bits per byte, low bits
+ * first.  Each operation is a number giving the length of its run times
+ * two, plus one if the bytes follow in the patch; a copy is followed instead
+ * by the distance of its source from where the previous copy ended
+ * (initially the offset of the region in the new file), with its sign in
+ * the lowest bit.  Removed printers are listed as regions which produce no
+ * bytes.
+ */
+
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+#include "pakv2.h"
+
+#define BLOCK_SIZE          16      // bytes of the old file indexed together
+#define MAX_PROBES          16      // blocks compared for each hash lookup
+#define MIN_EXPECTED        8       // shortest match taken where the last one ended
+
+// A printer's entry in a name-sorted index of a directory
+typedef struct _NAMEREF
+{
+    PPAK_DEV_DIRENTRY pEntry;
+} NAMEREF, *PNAMEREF;
+
+// Index of the blocks of the old file, by weak checksum
+typedef struct _BLOCKINDEX
+{
+    PBYTE  pbOld;                   // the old file
+    ULONG  cbOld;                   // its size
+    ULONG  ulMask;                  // size of pulHead, less one
+    PULONG pulHead;                 // last block (plus one) with each hash, or 0
+    PULONG pulNext;                 // previous block (plus one) with the same hash
+} BLOCKINDEX, *PBLOCKINDEX;
+
+
+/* ------------------------------------------------------------------------- *
+ * PatchChecksum                                                             *
+ *                                                                           *
+ * Adler-32 checksum of a buffer.                                            *
+ * ------------------------------------------------------------------------- */
+static ULONG PatchChecksum( PBYTE pb, ULONG cb )
+{
+    ULONG ulSum1 = 1,
+          ulSum2 = 0,
+          cbRun;
+
+    while ( cb ) {
+        // 5552 bytes is the most which cannot overflow ulSum2 before reducing it
+        cbRun = ( cb < 5552 ) ? cb : 5552;
+        cb -= cbRun;
+        while ( cbRun-- ) {
+            ulSum1 += *pb++;
+            ulSum2 += ulSum1;
+        }
+        ulSum1 %= 65521;
+        ulSum2 %= 65521;
+    }
+    return ( ulSum2 << 16 ) | ulSum1;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PutNumber                                                                 *
+ *                                                                           *
+ * Write a variable-length number.                                           *
+ * ------------------------------------------------------------------------- */
+static void PutNumber( POUTBUF pOut, ULONG ul )
+{
+    BYTE ab[ 5 ];
+    ULONG cb = 0;
+
+    while ( ul >= 0x80 ) {
+        ab[ cb++ ] = (BYTE)( ul | 0x80 );
+        ul >>= 7;
+    }
+    ab[ cb++ ] = (BYTE) ul;
+    OutWrite( pOut, ab, cb );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * GetNumber                                                                 *
+ *                                                                           *
+ * Read a variable-length number, advancing *ppb.  FALSE if it runs past     *
+ * pbEnd or is longer than 32 bits.                                          *
+ * ------------------------------------------------------------------------- */
+static BOOL GetNumber( PBYTE *ppb, PBYTE pbEnd, PULONG pul )
+{
+    PBYTE pb = *ppb;
+    ULONG ul = 0,
+          ulShift;
+
+    for ( ulShift = 0; ulShift < 35; ulShift += 7 ) {
+        if ( pb >= pbEnd ) return FALSE;
+        if (( ulShift == 28 ) && ( *pb > 0x0F )) return FALSE;
+        ul |= (ULONG)( *pb & 0x7F ) << ulShift;
+        if ( !( *pb++ & 0x80 )) {
+            *ppb = pb;
+            *pul = ul;
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CompareNameRefs                                                           *
+ *                                                                           *
+ * qsort()/bsearch() comparison of two NAMEREFs by printer name.             *
+ * ------------------------------------------------------------------------- */
+static int CompareNameRefs( const void *p1, const void *p2 )
+{
+    return strncmp( ((PNAMEREF) p1)->pEntry->szDeviceName, ((PNAMEREF) p2)->pEntry->szDeviceName,
+                    sizeof( ((PNAMEREF) p1)->pEntry->szDeviceName ));
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * FindPrinter                                                               *
+ *                                                                           *
+ * Look up a printer name in a name-sorted index; NULL if it is not there.   *
+ * ------------------------------------------------------------------------- */
+static PPAK_DEV_DIRENTRY FindPrinter( PNAMEREF pRefs, ULONG cRefs, PPAK_DEV_DIRENTRY pEntry )
+{
+    NAMEREF  ref;
+    PNAMEREF pFound;
+
+    ref.pEntry = pEntry;
+    pFound = (PNAMEREF) bsearch( &ref, pRefs, cRefs, sizeof( NAMEREF ), CompareNameRefs );
+    return pFound ? pFound->pEntry : NULL;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * SegmentBytes                                                              *
+ *                                                                           *
+ * Whether a directory entry's segment lies within a file of cbFile bytes.   *
+ * ------------------------------------------------------------------------- */
+static BOOL SegmentBytes( PPAK_DEV_DIRENTRY pEntry, ULONG cbFile )
+{
+    return ( pEntry->ulOffset <= cbFile ) && ( pEntry->ulSize <= cbFile - pEntry->ulOffset );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * BlockHash                                                                 *
+ *                                                                           *
+ * Combine the two sums of the rolling checksum into a table index.          *
+ * ------------------------------------------------------------------------- */
+static ULONG BlockHash( ULONG ulA, ULONG ulB, ULONG ulMask )
+{
+    return ((( ulB << 16 ) ^ ulA ) * 0x9E3779B1UL >> 8 ) & ulMask;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * StartHash                                                                 *
+ *                                                                           *
+ * Compute both sums of the rolling checksum over BLOCK_SIZE bytes.          *
+ * ------------------------------------------------------------------------- */
+static void StartHash( PBYTE pb, PULONG pulA, PULONG pulB )
+{
+    ULONG i;
+
+    *pulA = *pulB = 0;
+    for ( i = 0; i < BLOCK_SIZE; i++ ) {
+        *pulA += pb[ i ];
+        *pulB += ( BLOCK_SIZE - i ) * pb[ i ];
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * BuildBlockIndex                                                           *
+ *                                                                           *
+ * Index every whole BLOCK_SIZE block of the old file by its checksum.       *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID       pHeap : Heap to allocate from (or NULL)                     *
+ *   PBYTE       pbOld : The old file                                        *
+ *   ULONG       cbOld : Its size                                            *
+ *   PBLOCKINDEX pIndex: Receives the index                                  *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, or ERROR_NOT_ENOUGH_MEMORY                                *
+ * ------------------------------------------------------------------------- */
+static ULONG BuildBlockIndex( PVOID pHeap, PBYTE pbOld, ULONG cbOld, PBLOCKINDEX pIndex )
+{
+    ULONG cBlocks = cbOld / BLOCK_SIZE,
+          cHeads,
+          ulA, ulB,
+          ulHash,
+          i;
+
+    for ( cHeads = 256; cHeads < cBlocks; cHeads <<= 1 ) ;
+    pIndex->pbOld   = pbOld;
+    pIndex->cbOld   = cbOld;
+    pIndex->ulMask  = cHeads - 1;
+    pIndex->pulHead = (PULONG) PakAlloc( pHeap, cHeads * sizeof( ULONG ));
+    pIndex->pulNext = (PULONG) PakAlloc( pHeap, cBlocks * sizeof( ULONG ) + 1 );
+    if ( !pIndex->pulHead || !pIndex->pulNext ) {
+        PakFree( pHeap, pIndex->pulHead );
+        PakFree( pHeap, pIndex->pulNext );
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+    memset( pIndex->pulHead, 0, cHeads * sizeof( ULONG ));
+
+    for ( i = 0; i < cBlocks; i++ ) {
+        StartHash( pbOld + i * BLOCK_SIZE, &ulA, &ulB );
+        ulHash = BlockHash( ulA, ulB, pIndex->ulMask );
+        pIndex->pulNext[ i ]      = pIndex->pulHead[ ulHash ];
+        pIndex->pulHead[ ulHash ] = i + 1;
+    }
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * MatchLength                                                               *
+ *                                                                           *
+ * Count the bytes which are the same in two buffers, up to cbMax.           *
+ * ------------------------------------------------------------------------- */
+static ULONG MatchLength( PBYTE pb1, PBYTE pb2, ULONG cbMax )
+{
+    ULONG cb = 0;
+
+    while (( cb < cbMax ) && ( pb1[ cb ] == pb2[ cb ] )) cb++;
+    return cb;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PutLiteral                                                                *
+ *                                                                           *
+ * Write an operation carrying cb new bytes, if there are any.               *
+ * ------------------------------------------------------------------------- */
+static void PutLiteral( POUTBUF pOps, PBYTE pb, ULONG cb, PPAKPATCHSTATS pStats )
+{
+    if ( !cb ) return;
+    PutNumber( pOps, ( cb << 1 ) | 1 );
+    OutWrite( pOps, pb, cb );
+    pStats->cbLiteral += cb;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * EncodeRegion                                                              *
+ *                                                                           *
+ * Encode one region of the new file as operations.  At each position, the   *
+ * old file is first compared where the last copy ended (as if bytes had     *
+ * been inserted since) and as far beyond that as the bytes not yet written  *
+ * (as if they had been replaced); failing both, the block index is searched *
+ * for the checksum of the next BLOCK_SIZE bytes, and the longest match      *
+ * found is extended backwards over any bytes not yet written.  Bytes        *
+ * matching nothing are carried in the patch.                                *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PBLOCKINDEX    pIndex    : Index of the old file                        *
+ *   PBYTE          pb        : Start of the region in the new file          *
+ *   ULONG          cb        : Size of the region                           *
+ *   ULONG          ulBase    : Offset of the region in the new file, from   *
+ *                              which the first copy is measured             *
+ *   ULONG          ulLook    : Where in the old file to look first          *
+ *   POUTBUF        pOps      : Receives the operations                      *
+ *   PPAKPATCHSTATS pStats    : Byte counts to update                        *
+ *                                                                           *
+ * RETURNS: N/A                                                              *
+ * ------------------------------------------------------------------------- */
+static void EncodeRegion( PBLOCKINDEX pIndex, PBYTE pb, ULONG cb, ULONG ulBase, ULONG ulLook,
+                          POUTBUF pOps, PPAKPATCHSTATS pStats )
+{
+    PBYTE pbOld = pIndex->pbOld;
+    ULONG cbOld = pIndex->cbOld,
+          ulPos = 0,                // next byte of the region to match
+          ulLit = 0,                // first byte of the region not yet written
+          ulExpected = ulBase,      // where the last copy ended
+          aulTry[ 2 ],
+          ulSource,
+          cbMatch,
+          ulBlock,
+          ulA = 0, ulB = 0,
+          cProbes,
+          ulBest,
+          cbBest,
+          cbBack,
+          ulDist,
+          cbMax,
+          i;
+    BOOL  fHash = FALSE;            // ulA and ulB are those of pb + ulPos
+
+    while ( ulPos < cb ) {
+        cbBest = 0;
+        ulBest = 0;
+
+        // Where the last copy ended, allowing for insertions or replacements
+        aulTry[ 0 ] = ulLook;
+        aulTry[ 1 ] = ulLook + ( ulPos - ulLit );
+        for ( i = 0; i < 2; i++ ) {
+            if (( aulTry[ i ] >= cbOld ) || ( i && aulTry[ 1 ] == aulTry[ 0 ] )) continue;
+            cbMax   = cb - ulPos;
+            if ( cbMax > cbOld - aulTry[ i ] ) cbMax = cbOld - aulTry[ i ];
+            cbMatch = MatchLength( pb + ulPos, pbOld + aulTry[ i ], cbMax );
+            if (( cbMatch >= MIN_EXPECTED ) && ( cbMatch > cbBest )) {
+                cbBest = cbMatch;
+                ulBest = aulTry[ i ];
+            }
+        }
+
+        // Anywhere else
+        if ( !cbBest && ( cb - ulPos >= BLOCK_SIZE )) {
+            if ( !fHash ) StartHash( pb + ulPos, &ulA, &ulB );
+            fHash = TRUE;
+            ulBlock = pIndex->pulHead[ BlockHash( ulA, ulB, pIndex->ulMask ) ];
+            for ( cProbes = 0; ulBlock && ( cProbes < MAX_PROBES ); cProbes++ ) {
+                ulSource = ( ulBlock - 1 ) * BLOCK_SIZE;
+                cbMax    = cb - ulPos;
+                if ( cbMax > cbOld - ulSource ) cbMax = cbOld - ulSource;
+                cbMatch  = MatchLength( pb + ulPos, pbOld + ulSource, cbMax );
+                if (( cbMatch >= BLOCK_SIZE ) && ( cbMatch > cbBest )) {
+                    cbBest = cbMatch;
+                    ulBest = ulSource;
+                }
+                ulBlock = pIndex->pulNext[ ulBlock - 1 ];
+            }
+        }
+
+        if ( !cbBest ) {
+            // Move on one byte, rolling the checksum along if it can be
+            if ( fHash && ( ulPos + BLOCK_SIZE < cb )) {
+                ulA += pb[ ulPos + BLOCK_SIZE ] - pb[ ulPos ];
+                ulB += ulA - BLOCK_SIZE * pb[ ulPos ];
+            }
+            else fHash = FALSE;
+            ulPos++;
+            continue;
+        }
+
+        // Take back any bytes before the match which also match
+        for ( cbBack = 0; ( cbBack < ulPos - ulLit ) && ( cbBack < ulBest ) &&
+                          ( pb[ ulPos - cbBack - 1 ] == pbOld[ ulBest - cbBack - 1 ] ); cbBack++ ) ;
+        ulPos  -= cbBack;
+        ulBest -= cbBack;
+        cbBest += cbBack;
+
+        PutLiteral( pOps, pb + ulLit, ulPos - ulLit, pStats );
+        PutNumber( pOps, cbBest << 1 );
+        if ( ulBest >= ulExpected ) ulDist = ( ulBest - ulExpected ) << 1;
+        else                        ulDist = (( ulExpected - ulBest ) << 1 ) - 1;
+        PutNumber( pOps, ulDist );
+        pStats->cbCopied += cbBest;
+
+        ulPos     += cbBest;
+        ulLit      = ulPos;
+        ulExpected = ulLook = ulBest + cbBest;
+        fHash      = FALSE;
+    }
+    PutLiteral( pOps, pb + ulLit, cb - ulLit, pStats );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PutRegion                                                                 *
+ *                                                                           *
+ * Write one region to the patch: its kind, name, segment count and sizes,   *
+ * then the operations which have been collected for it.                     *
+ * ------------------------------------------------------------------------- */
+static void PutRegion( POUTBUF pPatch, BYTE bKind, PSZ pszName, ULONG cSegments, ULONG cbTarget,
+                       POUTBUF pOps )
+{
+    BYTE bLen = 0;
+
+    if ( pszName )
+        while (( bLen < sizeof( ((PPAK_DEV_DIRENTRY) 0)->szDeviceName )) && pszName[ bLen ]) bLen++;
+    OutWrite( pPatch, &bKind, 1 );
+    OutWrite( pPatch, &bLen, 1 );
+    if ( bLen ) OutWrite( pPatch, (PBYTE) pszName, bLen );
+    PutNumber( pPatch, cSegments );
+    PutNumber( pPatch, cbTarget );
+    PutNumber( pPatch, pOps->cbData );
+    if ( pOps->cbData ) OutWrite( pPatch, pOps->pbData, pOps->cbData );
+    pOps->cbData = 0;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakMakePatch                                                              *
+ *                                                                           *
+ * Create a patch which turns one device PAK file (V1 or V2) into another.   *
+ * The directories are those of the two files in V1 form, with the file      *
+ * offset of each segment; they are used only to divide the new file into    *
+ * regions and to find each printer in the old file, so the patch rebuilds   *
+ * the new file exactly whatever they hold.  Printers are matched by name;   *
+ * the figures returned count directory entries, so a shared segment counts  *
+ * once for each printer using it.                                           *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID             pHeap : Heap to allocate from (or NULL)               *
+ *   PBYTE             pbOld : The old file                                  *
+ *   ULONG             cbOld : Its size                                      *
+ *   PPAK_DEV_DIRENTRY pOldDir: Its directory                                *
+ *   ULONG             cOld  : Number of entries in pOldDir                  *
+ *   PBYTE             pbNew : The new file                                  *
+ *   ULONG             cbNew : Its size                                      *
+ *   PPAK_DEV_DIRENTRY pNewDir: Its directory                                *
+ *   ULONG             cNew  : Number of entries in pNewDir                  *
+ *   POUTBUF           pPatch: Receives the patch (may not be NULL)          *
+ *   PPAKPATCHSTATS    pStats: Receives the figures for the patch            *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_INVALID_PARAMETER if pPatch is NULL, or             *
+ *   ERROR_NOT_ENOUGH_MEMORY                                                 *
+ * ------------------------------------------------------------------------- */
+ULONG PakMakePatch( PVOID pHeap, PBYTE pbOld, ULONG cbOld, PPAK_DEV_DIRENTRY pOldDir, ULONG cOld,
+                    PBYTE pbNew, ULONG cbNew, PPAK_DEV_DIRENTRY pNewDir, ULONG cNew,
+                    POUTBUF pPatch, PPAKPATCHSTATS pStats )
+{
+    PAKPATCHHDR       hdr;
+    BLOCKINDEX        index;
+    OUTBUF            ops;
+    PNAMEREF          pOldRefs = NULL,
+                      pNewRefs = NULL;
+    PULONG            pulOrder = NULL;
+    PPAK_DEV_DIRENTRY pEntry,
+                      pOld,
+                      pRun = NULL;
+    ULONG             ulHeader,
+                      ulRunStart = 0,
+                      ulRunOld = 0,
+                      cRun,
+                      ulPos,
+                      ulEnd = 0,
+                      ulStart = 0,
+                      cbHeader,
+                      i, j;
+    BYTE              bKind;
+    APIRET            rc = NO_ERROR;
+
+    memset( pStats, 0, sizeof( PAKPATCHSTATS ));
+    if ( !pPatch ) return ERROR_INVALID_PARAMETER;
+    memset( &ops, 0, sizeof( OUTBUF ));
+    ops.pHeap = pHeap;
+    memset( &index, 0, sizeof( BLOCKINDEX ));
+
+    if (( rc = BuildBlockIndex( pHeap, pbOld, cbOld, &index )) != NO_ERROR ) return rc;
+    pOldRefs = (PNAMEREF) PakAlloc( pHeap, cOld * sizeof( NAMEREF ) + 1 );
+    pNewRefs = (PNAMEREF) PakAlloc( pHeap, cNew * sizeof( NAMEREF ) + 1 );
+    pulOrder = (PULONG) PakAlloc( pHeap, cNew * sizeof( ULONG ) + 1 );
+    if ( !pOldRefs || !pNewRefs || !pulOrder ) {
+        rc = ERROR_NOT_ENOUGH_MEMORY;
+        goto cleanup;
+    }
+    for ( i = 0; i < cOld; i++ ) pOldRefs[ i ].pEntry = pOldDir + i;
+    for ( i = 0; i < cNew; i++ ) pNewRefs[ i ].pEntry = pNewDir + i;
+    qsort( pOldRefs, cOld, sizeof( NAMEREF ), CompareNameRefs );
+    qsort( pNewRefs, cNew, sizeof( NAMEREF ), CompareNameRefs );
+
+    // Count the printers added, removed, changed and unchanged
+    for ( i = 0; i < cNew; i++ ) {
+        pEntry = pNewDir + i;
+        pOld   = FindPrinter( pOldRefs, cOld, pEntry );
+        if ( !pOld ) pStats->cAdded++;
+        else if (( pOld->ulSize == pEntry->ulSize ) && SegmentBytes( pOld, cbOld ) &&
+                 SegmentBytes( pEntry, cbNew ) &&
+                 !memcmp( pbOld + pOld->ulOffset, pbNew + pEntry->ulOffset, pEntry->ulSize ))
+            pStats->cSame++;
+        else pStats->cChanged++;
+    }
+    for ( i = 0; i < cOld; i++ )
+        if ( !FindPrinter( pNewRefs, cNew, pOldDir + i )) pStats->cRemoved++;
+
+    // Segments in file order (the header runs up to the first of them)
+    ulHeader = cbNew;
+    for ( i = 0; i < cNew; i++ ) {
+        for ( j = i; j > 0 && pNewDir[ pulOrder[ j - 1 ]].ulOffset > pNewDir[ i ].ulOffset; j-- )
+            pulOrder[ j ] = pulOrder[ j - 1 ];
+        pulOrder[ j ] = i;
+        if ( pNewDir[ i ].ulOffset < ulHeader ) ulHeader = pNewDir[ i ].ulOffset;
+    }
+
+    memset( &hdr, 0, sizeof( PAKPATCHHDR ));
+    strcpy( hdr.szName, PAKPATCH_SIGNATURE );
+    hdr.ulVersion     = PAKPATCH_VERSION;
+    hdr.cbSource      = cbOld;
+    hdr.ulSourceHash  = Pak2HashData( pbOld, cbOld );
+    hdr.ulSourceCheck = PatchChecksum( pbOld, cbOld );
+    hdr.cbTarget      = cbNew;
+    hdr.ulTargetHash  = Pak2HashData( pbNew, cbNew );
+    hdr.ulTargetCheck = PatchChecksum( pbNew, cbNew );
+    OutWrite( pPatch, (PBYTE) &hdr, sizeof( PAKPATCHHDR ));
+    cbHeader = pPatch->cbData;
+
+    EncodeRegion( &index, pbNew, ulHeader, 0, 0, &ops, pStats );
+    PutRegion( pPatch, PATCH_HEADER, NULL, 0, ulHeader, &ops );
+    hdr.cRegions++;
+
+    for ( i = 0; i < cOld; i++ ) {
+        if ( FindPrinter( pNewRefs, cNew, pOldDir + i )) continue;
+        PutRegion( pPatch, PATCH_REMOVED, pOldDir[ i ].szDeviceName, 1, 0, &ops );
+        hdr.cRegions++;
+    }
+
+    // Unchanged segments which follow one another in both files form one region
+    for ( ulPos = ulHeader, cRun = 0, j = 0; j <= cNew; j++ ) {
+        pEntry = ( j < cNew ) ? pNewDir + pulOrder[ j ] : NULL;
+        if ( pEntry ) {
+            if ( pEntry->ulOffset < ulPos ) continue;  // shared, or overlapping the last one
+            ulStart = ( pEntry->ulOffset < cbNew ) ? pEntry->ulOffset : cbNew;
+            ulEnd   = ( pEntry->ulSize < cbNew - ulStart ) ? ulStart + pEntry->ulSize : cbNew;
+            pOld    = FindPrinter( pOldRefs, cOld, pEntry );
+            if ( !pOld ) bKind = PATCH_ADDED;
+            else if (( pOld->ulSize == ulEnd - ulStart ) && SegmentBytes( pOld, cbOld ) &&
+                     !memcmp( pbOld + pOld->ulOffset, pbNew + ulStart, ulEnd - ulStart ))
+                bKind = PATCH_SAME;
+            else bKind = PATCH_CHANGED;
+            if (( bKind == PATCH_SAME ) && cRun && ( ulStart == ulPos ) &&
+                ( pOld->ulOffset == ulRunOld + ( ulPos - ulRunStart )))
+            {
+                cRun++;
+                ulPos = ulEnd;
+                continue;
+            }
+        }
+        if ( cRun ) {
+            EncodeRegion( &index, pbNew + ulRunStart, ulPos - ulRunStart, ulRunStart, ulRunOld,
+                          &ops, pStats );
+            PutRegion( pPatch, PATCH_SAME, pRun->szDeviceName, cRun, ulPos - ulRunStart, &ops );
+            hdr.cRegions++;
+            cRun = 0;
+        }
+        if ( !pEntry ) break;
+
+        if ( ulStart > ulPos ) {
+            EncodeRegion( &index, pbNew + ulPos, ulStart - ulPos, ulPos, ulPos, &ops, pStats );
+            PutRegion( pPatch, PATCH_OTHER, NULL, 0, ulStart - ulPos, &ops );
+            hdr.cRegions++;
+        }
+        ulPos = ulEnd;
+        if ( bKind == PATCH_SAME ) {
+            pRun       = pEntry;
+            ulRunStart = ulStart;
+            ulRunOld   = pOld->ulOffset;
+            cRun       = 1;
+            continue;
+        }
+        EncodeRegion( &index, pbNew + ulStart, ulEnd - ulStart, ulStart,
+                      pOld ? pOld->ulOffset : ulStart, &ops, pStats );
+        PutRegion( pPatch, bKind, pEntry->szDeviceName, 1, ulEnd - ulStart, &ops );
+        hdr.cRegions++;
+    }
+    if ( ulPos < cbNew ) {
+        EncodeRegion( &index, pbNew + ulPos, cbNew - ulPos, ulPos, ulPos, &ops, pStats );
+        PutRegion( pPatch, PATCH_OTHER, NULL, 0, cbNew - ulPos, &ops );
+        hdr.cRegions++;
+    }
+
+    if ( ops.fError || pPatch->fError ) {
+        rc = ERROR_NOT_ENOUGH_MEMORY;
+        goto cleanup;
+    }
+    memcpy( pPatch->pbData + cbHeader - sizeof( PAKPATCHHDR ), &hdr, sizeof( PAKPATCHHDR ));
+    pStats->cRegions = hdr.cRegions;
+    pStats->cbPatch  = pPatch->cbData - cbHeader + sizeof( PAKPATCHHDR );
+    pStats->cbTarget = cbNew;
+
+cleanup:
+    OutFree( &ops );
+    PakFree( pHeap, index.pulHead );
+    PakFree( pHeap, index.pulNext );
+    PakFree( pHeap, pOldRefs );
+    PakFree( pHeap, pNewRefs );
+    PakFree( pHeap, pulOrder );
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CheckPatchHeader                                                          *
+ *                                                                           *
+ * Check the signature and version of a patch.                               *
+ * ------------------------------------------------------------------------- */
+static BOOL CheckPatchHeader( PBYTE pbPatch, ULONG cbPatch, PPAKPATCHHDR pHdr )
+{
+    if ( cbPatch < sizeof( PAKPATCHHDR )) return FALSE;
+    memcpy( pHdr, pbPatch, sizeof( PAKPATCHHDR ));
+    return ( strncmp( pHdr->szName, PAKPATCH_SIGNATURE, sizeof( pHdr->szName )) == 0 ) &&
+           ( pHdr->ulVersion == PAKPATCH_VERSION );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * GetRegion                                                                 *
+ *                                                                           *
+ * Read the heading of one region of a patch, advancing *ppb to the start of *
+ * its operations.  FALSE if the heading, or the operations it gives the     *
+ * length of, run past pbEnd.                                                *
+ * ------------------------------------------------------------------------- */
+static BOOL GetRegion( PBYTE *ppb, PBYTE pbEnd, PBYTE pbKind, PCHAR achName, PULONG pcSegments,
+                       PULONG pcbTarget, PULONG pcbOps )
+{
+    PBYTE pb = *ppb;
+    ULONG cbName;
+
+    if ( pbEnd - pb < 2 ) return FALSE;
+    *pbKind = *pb++;
+    cbName  = *pb++;
+    if (( cbName > sizeof( ((PPAK_DEV_DIRENTRY) 0)->szDeviceName )) ||
+        ( (ULONG)( pbEnd - pb ) < cbName ))
+        return FALSE;
+    memcpy( achName, pb, cbName );
+    achName[ cbName ] = 0;
+    pb += cbName;
+    if ( !GetNumber( &pb, pbEnd, pcSegments ) || !GetNumber( &pb, pbEnd, pcbTarget ) ||
+         !GetNumber( &pb, pbEnd, pcbOps ) ||
+         ( *pcbOps > (ULONG)( pbEnd - pb )))
+        return FALSE;
+    *ppb = pb;
+    return TRUE;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakApplyPatch                                                             *
+ *                                                                           *
+ * Rebuild a new PAK file from the old one and a patch made by               *
+ * PakMakePatch().  The old file must be the one the patch was made from,    *
+ * and the file rebuilt must be the one it was made to; every operation is   *
+ * checked against the bounds of both files, so a damaged patch gives an     *
+ * error and never a damaged file.                                           *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID          pHeap  : Heap to allocate from (or NULL)                 *
+ *   PBYTE          pbOld  : The old file                                    *
+ *   ULONG          cbOld  : Its size                                        *
+ *   PBYTE          pbPatch: The patch                                       *
+ *   ULONG          cbPatch: Its size                                        *
+ *   PBYTE         *ppbNew : Receives the new file (free with PakFree)       *
+ *   PULONG         pcbNew : Receives its size                               *
+ *   PPAKPATCHSTATS pStats : Receives the figures for the patch (or NULL)    *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_INVALID_DATA if the patch is not valid or does not  *
+ *   give the file it was made to, ERROR_PAK_WRONG_SOURCE if the old file is *
+ *   not the one it was made from, or ERROR_NOT_ENOUGH_MEMORY                *
+ * ------------------------------------------------------------------------- */
+ULONG PakApplyPatch( PVOID pHeap, PBYTE pbOld, ULONG cbOld, PBYTE pbPatch, ULONG cbPatch,
+                     PBYTE *ppbNew, PULONG pcbNew, PPAKPATCHSTATS pStats )
+{
+    PAKPATCHHDR hdr;
+    PAKPATCHSTATS stats;
+    CHAR        achName[ sizeof( ((PPAK_DEV_DIRENTRY) 0)->szDeviceName ) + 1 ];
+    PBYTE       pbNew,
+                pb,
+                pbEnd,
+                pbOps,
+                pbOpsEnd;
+    ULONG       ulPos,
+                ulRegionEnd,
+                ulExpected,
+                ulSource,
+                ulOp,
+                ulDist,
+                cSegments,
+                cbTarget,
+                cbOps,
+                cb,
+                i;
+    BYTE        bKind;
+    APIRET      rc = ERROR_INVALID_DATA;
+
+    *ppbNew = NULL;
+    *pcbNew = 0;
+    memset( &stats, 0, sizeof( PAKPATCHSTATS ));
+    if ( !CheckPatchHeader( pbPatch, cbPatch, &hdr ) || ( hdr.cbTarget == (ULONG) -1 ))
+        return ERROR_INVALID_DATA;
+    if (( cbOld != hdr.cbSource ) || ( Pak2HashData( pbOld, cbOld ) != hdr.ulSourceHash ) ||
+        ( PatchChecksum( pbOld, cbOld ) != hdr.ulSourceCheck ))
+        return ERROR_PAK_WRONG_SOURCE;
+    if (( pbNew = (PBYTE) PakAlloc( pHeap, hdr.cbTarget + 1 )) == NULL )
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    pb    = pbPatch + sizeof( PAKPATCHHDR );
+    pbEnd = pbPatch + cbPatch;
+    ulPos = 0;
+    for ( i = 0; i < hdr.cRegions; i++ ) {
+        if ( !GetRegion( &pb, pbEnd, &bKind, achName, &cSegments, &cbTarget, &cbOps ) ||
+             ( cbTarget > hdr.cbTarget - ulPos ))
+            goto cleanup;
+        switch ( bKind ) {
+            case PATCH_SAME:    stats.cSame    += cSegments; break;
+            case PATCH_CHANGED: stats.cChanged += cSegments; break;
+            case PATCH_ADDED:   stats.cAdded   += cSegments; break;
+            case PATCH_REMOVED: stats.cRemoved += cSegments; break;
+        }
+        pbOps       = pb;
+        pbOpsEnd    = pb + cbOps;
+        pb          = pbOpsEnd;
+        ulRegionEnd = ulPos + cbTarget;
+        ulExpected  = ulPos;
+
+        while ( pbOps < pbOpsEnd ) {
+            if ( !GetNumber( &pbOps, pbOpsEnd, &ulOp )) goto cleanup;
+            cb = ulOp >> 1;
+            if ( !cb || ( cb > ulRegionEnd - ulPos )) goto cleanup;
+            if ( ulOp & 1 ) {
+                if ( cb > (ULONG)( pbOpsEnd - pbOps )) goto cleanup;
+                memcpy( pbNew + ulPos, pbOps, cb );
+                pbOps += cb;
+                stats.cbLiteral += cb;
+            }
+            else {
+                if ( !GetNumber( &pbOps, pbOpsEnd, &ulDist )) goto cleanup;
+                ulSource = ( ulDist & 1 ) ? ulExpected - ( ulDist >> 1 ) - 1
+                                          : ulExpected + ( ulDist >> 1 );
+                if (( ulSource > cbOld ) || ( cb > cbOld - ulSource )) goto cleanup;
+                memcpy( pbNew + ulPos, pbOld + ulSource, cb );
+                ulExpected = ulSource + cb;
+                stats.cbCopied += cb;
+            }
+            ulPos += cb;
+        }
+        if ( ulPos != ulRegionEnd ) goto cleanup;
+    }
+    if (( pb != pbEnd ) || ( ulPos != hdr.cbTarget ) ||
+        ( Pak2HashData( pbNew, ulPos ) != hdr.ulTargetHash ) ||
+        ( PatchChecksum( pbNew, ulPos ) != hdr.ulTargetCheck ))
+        goto cleanup;
+
+    stats.cRegions = hdr.cRegions;
+    stats.cbPatch  = cbPatch;
+    stats.cbTarget = hdr.cbTarget;
+    if ( pStats ) memcpy( pStats, &stats, sizeof( PAKPATCHSTATS ));
+    *ppbNew = pbNew;
+    *pcbNew = hdr.cbTarget;
+    return NO_ERROR;
+
+cleanup:
+    PakFree( pHeap, pbNew );
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakPatchList                                                              *
+ *                                                                           *
+ * List the regions of a patch other than unchanged segments: for each,      *
+ * what it is, the printer name of a segment, the bytes it produces and the  *
+ * bytes of the patch it takes.  The patch is only read, not applied, so no  *
+ * old file is needed.                                                       *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PBYTE   pbPatch: The patch                                              *
+ *   ULONG   cbPatch: Its size                                               *
+ *   POUTBUF pOut   : Output buffer (NULL for STDOUT)                        *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, or ERROR_INVALID_DATA if the patch is not valid           *
+ * ------------------------------------------------------------------------- */
+ULONG PakPatchList( PBYTE pbPatch, ULONG cbPatch, POUTBUF pOut )
+{
+    static PSZ apszKinds[] = { "Header", "Same", "Changed", "Added", "Removed", "Other" };
+    PAKPATCHHDR hdr;
+    CHAR        achName[ sizeof( ((PPAK_DEV_DIRENTRY) 0)->szDeviceName ) + 1 ];
+    PBYTE       pb,
+                pbEnd,
+                pbRegion;
+    ULONG       cSegments,
+                cbTarget,
+                cbOps,
+                i;
+    BYTE        bKind;
+
+    if ( !CheckPatchHeader( pbPatch, cbPatch, &hdr )) return ERROR_INVALID_DATA;
+    pb    = pbPatch + sizeof( PAKPATCHHDR );
+    pbEnd = pbPatch + cbPatch;
+    for ( i = 0; i < hdr.cRegions; i++ ) {
+        pbRegion = pb;
+        if ( !GetRegion( &pb, pbEnd, &bKind, achName, &cSegments, &cbTarget, &cbOps ))
+            return ERROR_INVALID_DATA;
+        pb += cbOps;
+        if ( bKind == PATCH_SAME ) continue;
+        OutPrintf( pOut, "%-8s %-40s %8lu %8lu\n",
+                   ( bKind <= PATCH_OTHER ) ? apszKinds[ bKind ] : "?", achName, cbTarget,
+                   (ULONG)( pb - pbRegion ));
+    }
+    return ( pb == pbEnd ) ? NO_ERROR : ERROR_INVALID_DATA;
+}
@@ -0,0 +1,428 @@
+/*
+ * pakdump.c
+ *
+ * PAKTOOL library: annotated dump of a region of a device segment.
+ *
+ * PrettyBytes() shows a whole segment as anonymous bytes.  PakDumpRegion()
+ * instead reads only the part of the segment asked for (a named region, one
+ * UI block, or a range of offsets) and prints each 16-byte row alongside the
+ * names of the fields it overlaps: the members of the DESPPD and of each
+ * UI_BLOCK, UI_ENTRY and UIC_BLOCK at their positions in the lists (from the
+ * field tables in pakfld.c, which follow the PSDRIVER layout), and, in the
+ * information segment, the string offsets which point into the row.
+ *
+ * Besides the region itself, only the DESPPD and (when the region needs it)
+ * the UI list and information segment are read, to locate the blocks and
+ * the strings they point to.
+ */
+
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+
+#define DUMP_ROW            16      // bytes shown on each row
+#define DUMP_NOTE_MAX       240     // longest annotation shown on a row
+
+
+// Layout of one device segment (all offsets relative to the segment)
+typedef struct _DUMPMAP
+{
+    ULONG  cbSegment;           // size of the segment
+    PDESPPD pDes;               // its DESPPD (NULL if the segment is smaller)
+    ULONG  ulUIList;            // start of the UI list
+    ULONG  ulUICList;           // start of the UIC list
+    ULONG  ulInfo;              // start of the information segment
+    ULONG  ulEnd;               // end of the information segment
+    PBYTE  pbUIList;            // UI list (NULL if not read)
+    PBYTE  pbInfo;              // information segment (NULL if not read)
+    ULONG  cBlocks;             // number of UI blocks located
+    PULONG pulBlocks;           // offset of each block in the UI list, plus
+                                //   the end of the last
+    PSZ    pszNote;             // annotation being built for a row
+    ULONG  cchNote;             // its length
+} DUMPMAP, *PDUMPMAP;
+
+
+/* ------------------------------------------------------------------------- *
+ * AddNote                                                                   *
+ *                                                                           *
+ * Append a field name (with an optional prefix) to the annotation for the   *
+ * current row, ending it with "..." once it is full.                        *
+ * ------------------------------------------------------------------------- */
+static void AddNote( PDUMPMAP pMap, PSZ pszPrefix, PSZ pszName )
+{
+    CHAR  szItem[ 128 ];
+    ULONG cch;
+
+    if ( pMap->cchNote >= DUMP_NOTE_MAX ) return;
+    cch = sprintf( szItem, "%s%s%s", pMap->cchNote ? ", " : "", pszPrefix, pszName );
+    if ( pMap->cchNote + cch > DUMP_NOTE_MAX - 4 ) {
+        strcpy( pMap->pszNote + pMap->cchNote, pMap->cchNote ? ", ..." : "...");
+        pMap->cchNote = DUMP_NOTE_MAX;
+        return;
+    }
+    strcpy( pMap->pszNote + pMap->cchNote, szItem );
+    pMap->cchNote += cch;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * NoteFields                                                                *
+ *                                                                           *
+ * Annotate the fields of a structure at ulBase which overlap a row.  Only   *
+ * fields lying wholly within ulLimit are considered.                        *
+ * ------------------------------------------------------------------------- */
+static void NoteFields( PDUMPMAP pMap, PPAKFIELD pFields, PSZ pszPrefix, ULONG ulBase,
+                        ULONG ulLimit, ULONG ulRow, ULONG ulRowEnd )
+{
+    ULONG ulField;
+
+    for ( ; pFields->pszName; pFields++ ) {
+        ulField = ulBase + pFields->usOffset;
+        if ( ulField + pFields->cb > ulLimit ) break;
+        if ( ulField < ulRowEnd && ulField + pFields->cb > ulRow )
+            AddNote( pMap, pszPrefix, pFields->pszName );
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * NotePointers                                                              *
+ *                                                                           *
+ * Annotate the string offset fields of a structure which point into a row   *
+ * of the information segment (given as an offset within it).                *
+ * ------------------------------------------------------------------------- */
+static void NotePointers( PDUMPMAP pMap, PPAKFIELD pFields, PSZ pszPrefix, PBYTE pbStruct,
+                          ULONG cbStruct, ULONG ulRow, ULONG ulRowEnd )
+{
+    CHAR  szPrefix[ 48 ];
+    LONG  lOff;
+
+    for ( ; pFields->pszName; pFields++ ) {
+        if ( pFields->usOffset + pFields->cb > cbStruct ) break;
+        if ( !( pFields->fs & PF_STRING )) continue;
+        lOff = PakFieldValue( pFields, pbStruct );
+        if ( lOff < 0 || ( !lOff && !( pFields->fs & PF_ZERO_OK ))) continue;
+        if ( (ULONG) lOff < ulRow || (ULONG) lOff >= ulRowEnd ) continue;
+        sprintf( szPrefix, "@%lX<-%s", pMap->ulInfo + lOff, pszPrefix );
+        AddNote( pMap, szPrefix, pFields->pszName );
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * AnnotateRow                                                               *
+ *                                                                           *
+ * Build the annotation for the row of the segment starting at ulRow.        *
+ * ------------------------------------------------------------------------- */
+static void AnnotateRow( PDUMPMAP pMap, ULONG ulRow, ULONG ulRowEnd )
+{
+    PUI_BLOCK pBlock;
+    CHAR      szPrefix[ 48 ];
+    ULONG     b, e, ulBlock, ulEntries, cb;
+
+    pMap->cchNote = 0;
+    pMap->pszNote[ 0 ] = 0;
+
+    if ( pMap->pDes && ulRow < sizeof( DESPPD ))
+        NoteFields( pMap, PakFieldTable( PAKFT_DESPPD ), "", 0, sizeof( DESPPD ), ulRow, ulRowEnd );
+
+    // UI blocks and their entries
+    if ( pMap->pbUIList && ulRow < pMap->ulUICList && ulRowEnd > pMap->ulUIList ) {
+        for ( b = 0; b < pMap->cBlocks; b++ ) {
+            ulBlock = pMap->ulUIList + pMap->pulBlocks[ b ];
+            cb      = pMap->pulBlocks[ b + 1 ] - pMap->pulBlocks[ b ];
+            if ( ulBlock >= ulRowEnd ) break;
+            if ( ulBlock + cb <= ulRow ) continue;
+            sprintf( szPrefix, "UI_BLOCK[%lu].", b );
+            NoteFields( pMap, PakFieldTable( PAKFT_UI_BLOCK ), szPrefix, ulBlock, ulBlock + cb, ulRow, ulRowEnd );
+            pBlock    = (PUI_BLOCK)( pMap->pbUIList + pMap->pulBlocks[ b ] );
+            ulEntries = ulBlock + UI_BLOCK_FIXED;
+            e = ( ulRow > ulEntries ) ? ( ulRow - ulEntries ) / sizeof( UI_ENTRY ) : 0;
+            for ( ; e < pBlock->usNumOfEntries; e++ ) {
+                if ( ulEntries + e * sizeof( UI_ENTRY ) >= ulRowEnd ) break;
+                sprintf( szPrefix, "UI_BLOCK[%lu].uiEntry[%lu].", b, e );
+                NoteFields( pMap, PakFieldTable( PAKFT_UI_ENTRY ), szPrefix, ulEntries + e * sizeof( UI_ENTRY ),
+                            ulBlock + cb, ulRow, ulRowEnd );
+            }
+        }
+    }
+
+    // UI constraints, which are fixed-size records
+    if ( ulRow < pMap->ulInfo && ulRowEnd > pMap->ulUICList ) {
+        b = ( ulRow > pMap->ulUICList ) ? ( ulRow - pMap->ulUICList ) / sizeof( UIC_BLOCK ) : 0;
+        for ( ; pMap->ulUICList + b * sizeof( UIC_BLOCK ) < ulRowEnd; b++ ) {
+            sprintf( szPrefix, "UIC_BLOCK[%lu].", b );
+            NoteFields( pMap, PakFieldTable( PAKFT_UIC_BLOCK ), szPrefix, pMap->ulUICList + b * sizeof( UIC_BLOCK ),
+                        pMap->ulInfo, ulRow, ulRowEnd );
+        }
+    }
+
+    // Strings in the information segment, by the fields which point to them
+    if ( ulRow < pMap->ulEnd && ulRowEnd > pMap->ulInfo ) {
+        ulRow    = ( ulRow > pMap->ulInfo ) ? ulRow - pMap->ulInfo : 0;
+        ulRowEnd = ulRowEnd - pMap->ulInfo;
+        if ( pMap->pDes )
+            NotePointers( pMap, PakFieldTable( PAKFT_DESPPD ), "", (PBYTE) pMap->pDes, sizeof( DESPPD ),
+                          ulRow, ulRowEnd );
+        for ( b = 0; pMap->pbUIList && b < pMap->cBlocks; b++ ) {
+            pBlock = (PUI_BLOCK)( pMap->pbUIList + pMap->pulBlocks[ b ] );
+            cb     = pMap->pulBlocks[ b + 1 ] - pMap->pulBlocks[ b ];
+            sprintf( szPrefix, "UI_BLOCK[%lu].", b );
+            NotePointers( pMap, PakFieldTable( PAKFT_UI_BLOCK ), szPrefix, (PBYTE) pBlock, cb, ulRow, ulRowEnd );
+            for ( e = 0; e < pBlock->usNumOfEntries; e++ ) {
+                if ( UI_BLOCK_FIXED + ( e + 1 ) * sizeof( UI_ENTRY ) > cb ) break;
+                sprintf( szPrefix, "UI_BLOCK[%lu].uiEntry[%lu].", b, e );
+                NotePointers( pMap, PakFieldTable( PAKFT_UI_ENTRY ), szPrefix, (PBYTE) &( pBlock->uiEntry[ e ] ),
+                              sizeof( UI_ENTRY ), ulRow, ulRowEnd );
+            }
+        }
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * LocateBlocks                                                              *
+ *                                                                           *
+ * Read the UI list of a segment and find the start of each of its blocks,   *
+ * stopping at the first which does not fit within the list.                 *
+ * ------------------------------------------------------------------------- */
+static ULONG LocateBlocks( PVOID pHeap, PSZ pszPakFile, PPAK_DEV_DIRENTRY pEntry, PDUMPMAP pMap )
+{
+    PUI_BLOCK pBlock;
+    ULONG     cbList = pMap->ulUICList - pMap->ulUIList,
+              ulPos, cb, b;
+    APIRET    rc;
+
+    if ( pMap->pbUIList || !pMap->pDes || !cbList ) return NO_ERROR;
+    rc = PakLoadSegment( pHeap, pszPakFile, pEntry->ulOffset + pMap->ulUIList, cbList,
+                         &( pMap->pbUIList ));
+    if ( rc ) return rc;
+    pMap->pulBlocks = (PULONG) PakAlloc( pHeap, ( pMap->pDes->stUIList.usNumOfBlocks + 1 ) *
+                                                sizeof( ULONG ));
+    if ( !pMap->pulBlocks ) return ERROR_NOT_ENOUGH_MEMORY;
+
+    for ( b = 0, ulPos = 0; b < pMap->pDes->stUIList.usNumOfBlocks; b++ ) {
+        if ( ulPos + UI_BLOCK_FIXED > cbList ) break;
+        pBlock = (PUI_BLOCK)( pMap->pbUIList + ulPos );
+        cb = UI_BLOCK_FIXED + pBlock->usNumOfEntries * sizeof( UI_ENTRY );
+        pMap->pulBlocks[ b ] = ulPos;
+        ulPos += ( ulPos + cb > cbList ) ? cbList - ulPos : cb;
+    }
+    pMap->pulBlocks[ b ] = ulPos;
+    pMap->cBlocks = b;
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * FindBlock                                                                 *
+ *                                                                           *
+ * Find a UI block by its keyword (e.g. "*PageSize", the asterisk being      *
+ * optional) or by its number ("#3").                                        *
+ * ------------------------------------------------------------------------- */
+static ULONG FindBlock( PDUMPMAP pMap, PSZ pszBlock, PULONG pulBlock )
+{
+    PUI_BLOCK pBlock;
+    PSZ       pszEnd;
+    ULONG     cbInfo = pMap->ulEnd - pMap->ulInfo,
+              b;
+
+    if ( *pszBlock == '#') {
+        b = strtoul( pszBlock + 1, (char **) &pszEnd, 0 );
+        if ( *pszEnd || pszEnd == pszBlock + 1 ) return ERROR_INVALID_PARAMETER;
+        *pulBlock = b;
+        return ( b < pMap->cBlocks ) ? NO_ERROR : ERROR_PAK_NO_KEYWORD;
+    }
+    if ( *pszBlock == '*') pszBlock++;
+    for ( b = 0; pMap->pbInfo && b < pMap->cBlocks; b++ ) {
+        pBlock = (PUI_BLOCK)( pMap->pbUIList + pMap->pulBlocks[ b ] );
+        if ( pBlock->ofsUIName >= cbInfo ) continue;
+        if ( !memchr( pMap->pbInfo + pBlock->ofsUIName, 0, cbInfo - pBlock->ofsUIName )) continue;
+        if ( stricmp( pMap->pbInfo + pBlock->ofsUIName, pszBlock ) == 0 ) {
+            *pulBlock = b;
+            return NO_ERROR;
+        }
+    }
+    return ERROR_PAK_NO_KEYWORD;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ParseRegion                                                               *
+ *                                                                           *
+ * Work out which bytes of the segment a region names, reading the UI list   *
+ * and information segment if it names a block.                              *
+ * ------------------------------------------------------------------------- */
+static ULONG ParseRegion( PVOID pHeap, PSZ pszPakFile, PPAK_DEV_DIRENTRY pEntry, PDUMPMAP pMap,
+                          PSZ pszRegion, PULONG pulStart, PULONG pulEnd )
+{
+    PSZ    pszEnd;
+    ULONG  ulBlock;
+    APIRET rc;
+
+    *pulStart = 0;
+    *pulEnd   = pMap->cbSegment;
+    if ( !pszRegion || !*pszRegion || stricmp( pszRegion, "ALL") == 0 )
+        return NO_ERROR;
+
+    if ( stricmp( pszRegion, "DESPPD") == 0 )
+        *pulEnd = pMap->ulUIList;
+    else if ( stricmp( pszRegion, "UILIST") == 0 ) {
+        *pulStart = pMap->ulUIList;
+        *pulEnd   = pMap->ulUICList;
+    }
+    else if ( stricmp( pszRegion, "UICLIST") == 0 ) {
+        *pulStart = pMap->ulUICList;
+        *pulEnd   = pMap->ulInfo;
+    }
+    else if ( stricmp( pszRegion, "INFO") == 0 ) {
+        *pulStart = pMap->ulInfo;
+        *pulEnd   = pMap->ulEnd;
+    }
+    else if ( isdigit( *pszRegion )) {
+        // <start>-<end> (not including <end>) or <start>+<length>
+        *pulStart = strtoul( pszRegion, (char **) &pszEnd, 0 );
+        if ( *pszEnd != '-' && *pszEnd != '+') return ERROR_INVALID_PARAMETER;
+        pszRegion = pszEnd;
+        *pulEnd = strtoul( pszRegion + 1, (char **) &pszEnd, 0 );
+        if ( *pszEnd || !isdigit( pszRegion[ 1 ] )) return ERROR_INVALID_PARAMETER;
+        if ( *pszRegion == '+') *pulEnd += *pulStart;
+        if ( *pulEnd > pMap->cbSegment ) *pulEnd = pMap->cbSegment;
+        if ( *pulStart >= *pulEnd ) return ERROR_INVALID_PARAMETER;
+    }
+    else {
+        // A single UI block, which needs the information segment for its name
+        if (( rc = LocateBlocks( pHeap, pszPakFile, pEntry, pMap )) != NO_ERROR ) return rc;
+        if ( *pszRegion != '#' && !pMap->pbInfo && pMap->ulEnd > pMap->ulInfo ) {
+            rc = PakLoadSegment( pHeap, pszPakFile, pEntry->ulOffset + pMap->ulInfo,
+                                 pMap->ulEnd - pMap->ulInfo, &( pMap->pbInfo ));
+            if ( rc ) return rc;
+        }
+        if (( rc = FindBlock( pMap, pszRegion, &ulBlock )) != NO_ERROR ) return rc;
+        *pulStart = pMap->ulUIList + pMap->pulBlocks[ ulBlock ];
+        *pulEnd   = pMap->ulUIList + pMap->pulBlocks[ ulBlock + 1 ];
+    }
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakDumpRegion                                                             *
+ *                                                                           *
+ * Dump part of a printer's segment as hexadecimal and characters, with the  *
+ * names of the fields overlapping each row.  Offsets are relative to the    *
+ * start of the segment, and rows are aligned to multiples of 16 so that     *
+ * fields appear in the same place whichever region is shown.                *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID   pHeap        : Heap to allocate from (or NULL)                  *
+ *   PSZ     pszPakFile   : Name of the PAK file (V1 or V2)                  *
+ *   PSZ     pszDeviceName: Printer name, or NULL for the first              *
+ *   PSZ     pszRegion    : Region to dump, or NULL for the whole segment:   *
+ *                            DESPPD, UILIST, UICLIST or INFO;               *
+ *                            *<keyword> or #<n> for one UI block;           *
+ *                            <start>-<end> or <start>+<length> (decimal,    *
+ *                            or hexadecimal with a 0x prefix)               *
+ *   POUTBUF pOut         : Where to write the dump                          *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success; ERROR_PAK_NO_DEVICE if the printer was not found;         *
+ *   ERROR_PAK_NO_KEYWORD if the UI block was not found;                     *
+ *   ERROR_INVALID_PARAMETER if the region is not valid; otherwise an OS/2   *
+ *   error code                                                              *
+ * ------------------------------------------------------------------------- */
+ULONG PakDumpRegion( PVOID pHeap, PSZ pszPakFile, PSZ pszDeviceName, PSZ pszRegion,
+                     POUTBUF pOut )
+{
+    PAK_DEV_DIRENTRY entry;
+    DUMPMAP          map = {0};
+    CHAR             szNote[ DUMP_NOTE_MAX + 1 ];
+    PBYTE            pbHead = NULL,
+                     pbData = NULL;
+    ULONG            ulStart, ulEnd, ulRow, ulRowEnd, i;
+    APIRET           rc;
+
+    if (( rc = PakFindDevice( pHeap, pszPakFile, pszDeviceName, &entry )) != NO_ERROR )
+        return rc;
+
+    // Lay out the segment from its DESPPD, keeping every region within it
+    map.cbSegment = entry.ulSize;
+    map.pszNote   = szNote;
+    map.ulUIList  = map.ulUICList = map.ulInfo = map.ulEnd = map.cbSegment;
+    if ( map.cbSegment >= sizeof( DESPPD )) {
+        rc = PakLoadSegment( pHeap, pszPakFile, entry.ulOffset, sizeof( DESPPD ), &pbHead );
+        if ( rc ) goto cleanup;
+        map.pDes      = (PDESPPD) pbHead;
+        map.ulUIList  = sizeof( DESPPD );
+        map.ulUICList = map.ulUIList + map.pDes->stUIList.usBlockListSize;
+        if ( map.ulUICList > map.cbSegment ) map.ulUICList = map.cbSegment;
+        map.ulInfo    = map.ulUICList + map.pDes->stUICList.usNumOfUICs * sizeof( UIC_BLOCK );
+        if ( map.ulInfo > map.cbSegment ) map.ulInfo = map.cbSegment;
+        map.ulEnd     = map.ulInfo + (( map.pDes->desItems.iSizeBuffer > 0 ) ?
+                                      map.pDes->desItems.iSizeBuffer : 0 );
+        if ( map.ulEnd > map.cbSegment ) map.ulEnd = map.cbSegment;
+    }
+
+    if (( rc = ParseRegion( pHeap, pszPakFile, &entry, &map, pszRegion, &ulStart, &ulEnd )) != NO_ERROR )
+        goto cleanup;
+
+    // The UI blocks are needed to annotate the UI list, and the strings they point to
+    if ( ulStart < map.ulEnd && ulEnd > map.ulUIList &&
+         ( rc = LocateBlocks( pHeap, pszPakFile, &entry, &map )) != NO_ERROR )
+        goto cleanup;
+
+    OutPrintf( pOut, "%.40s: segment of %lu bytes at offset 0x%lX\n",
+               entry.szDeviceName, map.cbSegment, entry.ulOffset );
+    OutPrintf( pOut, "  DESPPD 0x0-0x%lX, UI list 0x%lX-0x%lX (%lu blocks), "
+                     "UIC list 0x%lX-0x%lX, information 0x%lX-0x%lX\n",
+               map.ulUIList, map.ulUIList, map.ulUICList,
+               map.pDes ? map.pDes->stUIList.usNumOfBlocks : 0,
+               map.ulUICList, map.ulInfo, map.ulInfo, map.ulEnd );
+    if ( ulStart >= ulEnd ) {
+        OutPrintf( pOut, "The region is empty.\n");
+        goto cleanup;
+    }
+    OutPrintf( pOut, "Region 0x%lX-0x%lX (%lu bytes):\n", ulStart, ulEnd, ulEnd - ulStart );
+
+    if (( rc = PakLoadSegment( pHeap, pszPakFile, entry.ulOffset + ulStart, ulEnd - ulStart,
+                               &pbData )) != NO_ERROR )
+        goto cleanup;
+
+    OutPrintf( pOut, "+------+------------------------------------------------+----------------+\n");
+    OutPrintf( pOut, "|      |+0 +1 +2 +3 +4 +5 +6 +7 +8 +9 +A +B +C +D +E +F |0123456789ABCDEF|\n");
+    OutPrintf( pOut, "+------+------------------------------------------------+----------------+\n");
+    for ( ulRow = ulStart - ( ulStart % DUMP_ROW ); ulRow < ulEnd; ulRow += DUMP_ROW ) {
+        ulRowEnd = ulRow + DUMP_ROW;
+        OutPrintf( pOut, "|%06lX|", ulRow );
+        for ( i = ulRow; i < ulRowEnd; i++ ) {
+            if ( i < ulStart || i >= ulEnd ) OutPrintf( pOut, "   ");
+            else OutPrintf( pOut, "%02X ", pbData[ i - ulStart ] );
+        }
+        OutPrintf( pOut, "|");
+        for ( i = ulRow; i < ulRowEnd; i++ ) {
+            if ( i < ulStart || i >= ulEnd ) OutPrintf( pOut, " ");
+            else OutPrintf( pOut, "%c", pbData[ i - ulStart ] == 0 ? ' ' :
+                                        ( pbData[ i - ulStart ] < 32 ? 127 : pbData[ i - ulStart ] ));
+        }
+        AnnotateRow( &map, ( ulRow < ulStart ) ? ulStart : ulRow,
+                     ( ulRowEnd > ulEnd ) ? ulEnd : ulRowEnd );
+        OutPrintf( pOut, "| %s\n", szNote );
+    }
+    OutPrintf( pOut, "+------+------------------------------------------------+----------------+\n");
+
+cleanup:
+    PakFree( pHeap, pbData );
+    PakFree( pHeap, map.pulBlocks );
+    PakFree( pHeap, map.pbInfo );
+    PakFree( pHeap, map.pbUIList );
+    PakFree( pHeap, pbHead );
+    return rc;
+}
@@ -0,0 +1,400 @@
+/*
+ * pakdup.c
+ *
+ * PAKTOOL library: near-duplicate printers.  See paklib.h for an overview.
+ *
+ * Each printer is reduced to a set of tokens: the name of each UI block, each
+ * block/option pair, and each block/option/value triple (the value hashed in
+ * its compressed form, which is the same for the same string throughout a
+ * PAK file).  A MinHash signature of PAKDUP_HASHES values is computed over
+ * the tokens; the fraction of signature values two printers share estimates
+ * the Jaccard similarity of their token sets.  The signatures are cut into
+ * PAKDUP_BANDS bands, and printers whose values agree over a whole band
+ * become candidates (locality-sensitive hashing); only candidates are
+ * compared, and those similar enough joined into clusters.  This takes time
+ * roughly linear in the number of printers, rather than comparing every
+ * pair.
+ */
+
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+#include "pakv2.h"
+
+#define DUP_ROWS            ( PAKDUP_HASHES / PAKDUP_BANDS )   // values per band
+#define DUP_SEED            0x9E3779B9UL                        // golden ratio
+
+
+// A band of one printer's signature, for finding candidates
+typedef struct _DUPBAND
+{
+    ULONG ulKey;                // hash of the band's values (and number)
+    ULONG ulRow;                // printer
+} DUPBAND, *PDUPBAND;
+
+
+/* ------------------------------------------------------------------------- *
+ * Mix                                                                       *
+ *                                                                           *
+ * Scramble a 32-bit value (the MurmurHash3 finaliser).                      *
+ * ------------------------------------------------------------------------- */
+static ULONG Mix( ULONG ul )
+{
+    ul ^= ul >> 16;
+    ul *= 0x85EBCA6BUL;
+    ul ^= ul >> 13;
+    ul *= 0xC2B2AE35UL;
+    ul ^= ul >> 16;
+    return ul;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * InfoHash                                                                  *
+ *                                                                           *
+ * Hash the string at an offset into the information segment, continuing     *
+ * from a previous hash.  An invalid offset hashes as an empty string.       *
+ * ------------------------------------------------------------------------- */
+static ULONG InfoHash( ULONG ulHash, PBYTE pInfoSeg, ULONG cbInfo, LONG lOff, PSZ *ppsz )
+{
+    PBYTE pbEnd;
+
+    if ( ppsz ) *ppsz = NULL;
+    if (( lOff <= 0 ) || ( (ULONG) lOff >= cbInfo ) ||
+        (( pbEnd = (PBYTE) memchr( pInfoSeg + lOff, 0, cbInfo - lOff )) == NULL ))
+        return Mix( ulHash );
+    if ( ppsz ) *ppsz = (PSZ)( pInfoSeg + lOff );
+    return Mix( ulHash ^ Pak2HashData( pInfoSeg + lOff, pbEnd - ( pInfoSeg + lOff )));
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CompareBands                                                              *
+ * ------------------------------------------------------------------------- */
+static int CompareBands( const void *p1, const void *p2 )
+{
+    PDUPBAND pb1 = (PDUPBAND) p1,
+             pb2 = (PDUPBAND) p2;
+
+    if ( pb1->ulKey != pb2->ulKey ) return ( pb1->ulKey < pb2->ulKey ) ? -1 : 1;
+    return ( pb1->ulRow < pb2->ulRow ) ? -1 : ( pb1->ulRow > pb2->ulRow );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CompareBlocks                                                             *
+ * ------------------------------------------------------------------------- */
+static int CompareBlocks( const void *p1, const void *p2 )
+{
+    PPAKDUPBLOCK pb1 = (PPAKDUPBLOCK) p1,
+                 pb2 = (PPAKDUPBLOCK) p2;
+
+    if ( pb1->ulName != pb2->ulName ) return ( pb1->ulName < pb2->ulName ) ? -1 : 1;
+    return 0;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * Root                                                                      *
+ *                                                                           *
+ * Find the cluster a printer belongs to (union-find, halving the path).     *
+ * ------------------------------------------------------------------------- */
+static ULONG Root( PULONG pulParent, ULONG ul )
+{
+    while ( pulParent[ ul ] != ul ) {
+        pulParent[ ul ] = pulParent[ pulParent[ ul ]];
+        ul = pulParent[ ul ];
+    }
+    return ul;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * AddToken                                                                  *
+ *                                                                           *
+ * Add a token to a MinHash signature (if one is being computed).            *
+ * ------------------------------------------------------------------------- */
+static VOID AddToken( PULONG pulSig, ULONG ulToken )
+{
+    ULONG ul, k;
+
+    if ( !pulSig ) return;
+    for ( k = 0; k < PAKDUP_HASHES; k++ ) {
+        ul = Mix( ulToken ^ ( DUP_SEED * ( k + 1 )));
+        if ( ul < pulSig[ k ] ) pulSig[ k ] = ul;
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * Signature                                                                 *
+ *                                                                           *
+ * Compute the MinHash signature of one printer, and record a name hash and  *
+ * content hash for each of its UI blocks.                                   *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PBYTE        pBuf    : Device segment                                   *
+ *   ULONG        cbBuf   : Size of the segment                              *
+ *   PULONG       pulSig  : Receives the signature (all 0xFFFFFFFF if the    *
+ *                          printer has no UI blocks)                        *
+ *   PPAKDUPBLOCK pBlocks : Receives the blocks (or NULL just to count them) *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   The number of UI blocks                                                 *
+ * ------------------------------------------------------------------------- */
+static ULONG Signature( PBYTE pBuf, ULONG cbBuf, PULONG pulSig, PPAKDUPBLOCK pBlocks )
+{
+    DESPPD    desPPD;
+    PUI_BLOCK puib;
+    PBYTE     pb,
+              pInfoSeg;
+    ULONG     cbLists,
+              cbInfo,
+              cbLeft,
+              cb,
+              cBlocks = 0,
+              ulName,
+              ulOption,
+              ulValue,
+              ulContent,
+              i, e;
+    PSZ       pszName;
+
+    if ( pulSig ) memset( pulSig, 0xFF, PAKDUP_HASHES * sizeof( ULONG ));
+    if ( cbBuf < sizeof( DESPPD )) return 0;
+    memcpy( &desPPD, pBuf, sizeof( DESPPD ));
+    cbLists = desPPD.stUIList.usBlockListSize + desPPD.stUICList.usNumOfUICs * sizeof( UIC_BLOCK );
+    if ( cbLists > cbBuf - sizeof( DESPPD )) return 0;
+    pInfoSeg = pBuf + sizeof( DESPPD ) + cbLists;
+    cbInfo   = cbBuf - sizeof( DESPPD ) - cbLists;
+    if (( desPPD.desItems.iSizeBuffer >= 0 ) && ( (ULONG) desPPD.desItems.iSizeBuffer < cbInfo ))
+        cbInfo = desPPD.desItems.iSizeBuffer;
+
+    pb     = pBuf + sizeof( DESPPD );
+    cbLeft = desPPD.stUIList.usBlockListSize;
+    for ( i = 0; i < desPPD.stUIList.usNumOfBlocks; i++, pb += cb, cbLeft -= cb ) {
+        puib = (PUI_BLOCK) pb;
+        if (( cbLeft < UI_BLOCK_FIXED ) ||
+            (( cb = UI_BLOCK_FIXED + puib->usNumOfEntries * sizeof( UI_ENTRY )) > cbLeft ))
+            break;
+
+        // The tokens of the block: its name, then each option and value
+        ulName    = InfoHash( 0, pInfoSeg, cbInfo, puib->ofsUIName, &pszName );
+        ulContent = Mix( ulName ^ ( puib->usSelectType << 16 ) ^ puib->usDefaultEntry );
+        AddToken( pulSig, ulName );
+        for ( e = 0; e < puib->usNumOfEntries; e++ ) {
+            ulOption = InfoHash( ulName, pInfoSeg, cbInfo, puib->uiEntry[ e ].ofsOption, NULL );
+            ulValue  = InfoHash( ulOption, pInfoSeg, cbInfo, puib->uiEntry[ e ].ofsValue, NULL );
+            AddToken( pulSig, ulOption );
+            AddToken( pulSig, ulValue );
+            ulContent += Mix( ulValue );
+        }
+        if ( pBlocks ) {
+            pBlocks[ cBlocks ].pszName   = pszName ? pszName : "(none)";
+            pBlocks[ cBlocks ].ulName    = ulName;
+            pBlocks[ cBlocks ].ulContent = ulContent;
+        }
+        cBlocks++;
+    }
+    if ( pBlocks ) qsort( pBlocks, cBlocks, sizeof( PAKDUPBLOCK ), CompareBlocks );
+    return cBlocks;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakDupSimilarity                                                          *
+ *                                                                           *
+ * Estimate the similarity of two printers from their signatures.            *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   Estimated Jaccard similarity of their token sets, in percent            *
+ * ------------------------------------------------------------------------- */
+ULONG PakDupSimilarity( PPAKDUPS pDups, ULONG ulRow1, ULONG ulRow2 )
+{
+    PULONG pulSig1 = pDups->pulSigs + ulRow1 * PAKDUP_HASHES,
+           pulSig2 = pDups->pulSigs + ulRow2 * PAKDUP_HASHES;
+    ULONG  c, k;
+
+    for ( k = 0, c = 0; k < PAKDUP_HASHES; k++ )
+        if ( pulSig1[ k ] == pulSig2[ k ] ) c++;
+    return c * 100 / PAKDUP_HASHES;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakDupBuild                                                               *
+ *                                                                           *
+ * Find the clusters of near-duplicate printers in a PAK file.               *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID              pHeap    : Heap to allocate from (or NULL)           *
+ *   PBYTE              pbFile   : PAK file image (must stay in memory while *
+ *                                 the results are used)                     *
+ *   ULONG              cbFile   : Size of the image                         *
+ *   PPAK_DEV_DIRENTRY  pEntries : Directory, in V1 form (must also stay in  *
+ *                                 memory)                                   *
+ *   ULONG              cEntries : Number of directory entries               *
+ *   ULONG              ulPercent: Least similarity for printers to be       *
+ *                                 joined (1 - 100)                          *
+ *   PPAKDUPS          *ppDups   : Receives the results (free with           *
+ *                                 PakDupFree)                               *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success or ERROR_NOT_ENOUGH_MEMORY.  Printers without UI blocks    *
+ *   (or whose segment lies outside the file) are never joined.              *
+ * ------------------------------------------------------------------------- */
+ULONG PakDupBuild( PVOID pHeap, PBYTE pbFile, ULONG cbFile, PPAK_DEV_DIRENTRY pEntries,
+                   ULONG cEntries, ULONG ulPercent, PPAKDUPS *ppDups )
+{
+    PPAKDUPS pDups;
+    PDUPBAND pBands,
+             pRun;
+    PULONG   pulSig,
+             pulCount;
+    ULONG    cBlocks,
+             cBands,
+             cb, i, j, b, k, r1, r2, ulKey;
+
+    *ppDups = NULL;
+
+    // Signatures first, counting the blocks; the blocks are recorded once
+    // there is room for them.  The clusters start out as single printers.
+    cb = sizeof( PAKDUPS ) + ( cEntries * PAKDUP_HASHES + 2 * cEntries + 1 ) * sizeof( ULONG );
+    if (( pDups = (PPAKDUPS) PakAlloc( pHeap, cb )) == NULL ) return ERROR_NOT_ENOUGH_MEMORY;
+    memset( pDups, 0, cb );
+    pDups->cRows      = cEntries;
+    pDups->pEntries   = pEntries;
+    pDups->pulSigs    = (PULONG)( pDups + 1 );
+    pDups->pulCluster = pDups->pulSigs + cEntries * PAKDUP_HASHES;
+    pDups->pulFirst   = pDups->pulCluster + cEntries;
+    for ( i = 0, cBlocks = 0; i < cEntries; i++ ) {
+        pDups->pulCluster[ i ] = i;
+        pDups->pulFirst[ i ]   = cBlocks;
+        if (( pEntries[ i ].ulOffset > cbFile ) || ( pEntries[ i ].ulSize > cbFile - pEntries[ i ].ulOffset ))
+            memset( pDups->pulSigs + i * PAKDUP_HASHES, 0xFF, PAKDUP_HASHES * sizeof( ULONG ));
+        else
+            cBlocks += Signature( pbFile + pEntries[ i ].ulOffset, pEntries[ i ].ulSize,
+                                  pDups->pulSigs + i * PAKDUP_HASHES, NULL );
+    }
+    pDups->pulFirst[ cEntries ] = cBlocks;
+    if (( pDups->pBlocks = (PPAKDUPBLOCK) PakAlloc( pHeap, cBlocks * sizeof( PAKDUPBLOCK ) + 1 )) == NULL ) {
+        PakFree( pHeap, pDups );
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+    for ( i = 0; i < cEntries; i++ ) {
+        if ( pDups->pulFirst[ i + 1 ] > pDups->pulFirst[ i ] )
+            Signature( pbFile + pEntries[ i ].ulOffset, pEntries[ i ].ulSize, NULL,
+                       pDups->pBlocks + pDups->pulFirst[ i ] );
+    }
+
+    // Hash each band of each signature, and sort to bring together the
+    // printers which agree over a whole band
+    if (( pBands = (PDUPBAND) PakAlloc( pHeap, cEntries * PAKDUP_BANDS * sizeof( DUPBAND ) + 1 )) == NULL ) {
+        PakDupFree( pHeap, pDups );
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+    for ( i = 0, cBands = 0; i < cEntries; i++ ) {
+        if ( pDups->pulFirst[ i + 1 ] == pDups->pulFirst[ i ] ) continue;
+        pulSig = pDups->pulSigs + i * PAKDUP_HASHES;
+        for ( b = 0; b < PAKDUP_BANDS; b++ ) {
+            ulKey = Mix( b );
+            for ( k = 0; k < DUP_ROWS; k++ )
+                ulKey = Mix( ulKey ^ pulSig[ b * DUP_ROWS + k ] );
+            pBands[ cBands ].ulKey = ulKey;
+            pBands[ cBands ].ulRow = i;
+            cBands++;
+        }
+    }
+    qsort( pBands, cBands, sizeof( DUPBAND ), CompareBands );
+
+    // Within each run of equal keys, join each printer to the first of the
+    // run, or failing that to the one before it, if similar enough
+    for ( pRun = pBands, j = 0; j < cBands; j++ ) {
+        if ( pBands[ j ].ulKey != pRun->ulKey ) pRun = pBands + j;
+        if ( pBands + j == pRun ) continue;
+        r1 = Root( pDups->pulCluster, pBands[ j ].ulRow );
+        if ( PakDupSimilarity( pDups, pRun->ulRow, pBands[ j ].ulRow ) >= ulPercent )
+            r2 = Root( pDups->pulCluster, pRun->ulRow );
+        else if ( PakDupSimilarity( pDups, pBands[ j - 1 ].ulRow, pBands[ j ].ulRow ) >= ulPercent )
+            r2 = Root( pDups->pulCluster, pBands[ j - 1 ].ulRow );
+        else
+            continue;
+        // The first printer in the file represents the cluster
+        if ( r1 < r2 ) pDups->pulCluster[ r2 ] = r1;
+        else           pDups->pulCluster[ r1 ] = r2;
+    }
+
+    // Flatten the clusters, and count those with more than one member
+    pulCount = (PULONG) pBands;
+    memset( pulCount, 0, cEntries * sizeof( ULONG ));
+    for ( i = 0; i < cEntries; i++ ) {
+        pDups->pulCluster[ i ] = Root( pDups->pulCluster, i );
+        if ( pulCount[ pDups->pulCluster[ i ]]++ == 1 ) pDups->cClusters++;
+        if ( pDups->pulCluster[ i ] != i ) pDups->cDuplicates++;
+    }
+    PakFree( pHeap, pBands );
+
+    *ppDups = pDups;
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakDupFree                                                                *
+ * ------------------------------------------------------------------------- */
+VOID PakDupFree( PVOID pHeap, PPAKDUPS pDups )
+{
+    if ( !pDups ) return;
+    PakFree( pHeap, pDups->pBlocks );
+    PakFree( pHeap, pDups );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakDupDiffer                                                              *
+ *                                                                           *
+ * List the UI blocks in which two printers differ, as "*Keyword" for a      *
+ * block whose options, values or defaults differ, "*Keyword (-)" for one    *
+ * which only the first printer has, and "*Keyword (+)" for one which only   *
+ * the second has, separated by commas.                                      *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAKDUPS pDups  : Results of PakDupBuild                                *
+ *   ULONG    ulRow1 : First printer                                         *
+ *   ULONG    ulRow2 : Second printer                                        *
+ *   POUTBUF  pOut   : Output buffer (or NULL for STDOUT)                    *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   The number of blocks listed                                             *
+ * ------------------------------------------------------------------------- */
+ULONG PakDupDiffer( PPAKDUPS pDups, ULONG ulRow1, ULONG ulRow2, POUTBUF pOut )
+{
+    PPAKDUPBLOCK p1    = pDups->pBlocks + pDups->pulFirst[ ulRow1 ],
+                 pEnd1 = pDups->pBlocks + pDups->pulFirst[ ulRow1 + 1 ],
+                 p2    = pDups->pBlocks + pDups->pulFirst[ ulRow2 ],
+                 pEnd2 = pDups->pBlocks + pDups->pulFirst[ ulRow2 + 1 ];
+    ULONG        c = 0;
+
+    while ( p1 < pEnd1 || p2 < pEnd2 ) {
+        if ( p2 == pEnd2 || ( p1 < pEnd1 && p1->ulName < p2->ulName )) {
+            OutPrintf( pOut, "%s*%s (-)", c++ ? ", " : "", p1->pszName );
+            p1++;
+        }
+        else if ( p1 == pEnd1 || p2->ulName < p1->ulName ) {
+            OutPrintf( pOut, "%s*%s (+)", c++ ? ", " : "", p2->pszName );
+            p2++;
+        }
+        else {
+            if ( p1->ulContent != p2->ulContent )
+                OutPrintf( pOut, "%s*%s", c++ ? ", " : "", p1->pszName );
+            p1++;
+            p2++;
+        }
+    }
+    return c;
+}
@@ -0,0 +1,287 @@
+/*
+ * pakfidx.c
+ *
+ * PAKTOOL library: cross-printer font index.  See paklib.h for an overview.
+ *
+ * Each device segment lists its resident fonts (desFonts) as iFonts
+ * consecutive strings in the information segment.  The names of all the
+ * printers in a PAK file are interned in one hash table, numbered in sorted
+ * order, and each printer's fonts recorded as a bitset over those numbers, so
+ * that membership, intersection and union queries need only test or combine
+ * bits.  The font names point into the PAK file image, which must stay in
+ * memory while the index is used.
+ */
+
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+#include "pakv2.h"
+
+
+/* ------------------------------------------------------------------------- *
+ * FontList                                                                  *
+ *                                                                           *
+ * Locate the font list of a device segment, counting the names which lie    *
+ * wholly within its information segment.                                    *
+ *                                                                           *
+ * RETURNS: PSZ                                                              *
+ *   The first font name, or NULL if the segment has none (or is damaged)    *
+ * ------------------------------------------------------------------------- */
+static PSZ FontList( PBYTE pBuf, ULONG cbBuf, PULONG pcFonts )
+{
+    DESPPD desPPD;
+    PBYTE  pInfoSeg;
+    PSZ    pszFirst, psz, pszEnd;
+    ULONG  cbLists,
+           cbInfo,
+           c;
+
+    *pcFonts = 0;
+    if ( cbBuf < sizeof( DESPPD )) return NULL;
+    memcpy( &desPPD, pBuf, sizeof( DESPPD ));
+    cbLists = desPPD.stUIList.usBlockListSize + desPPD.stUICList.usNumOfUICs * sizeof( UIC_BLOCK );
+    if ( cbLists > cbBuf - sizeof( DESPPD )) return NULL;
+    pInfoSeg = pBuf + sizeof( DESPPD ) + cbLists;
+    cbInfo   = cbBuf - sizeof( DESPPD ) - cbLists;
+    if (( desPPD.desItems.iSizeBuffer >= 0 ) && ( (ULONG) desPPD.desItems.iSizeBuffer < cbInfo ))
+        cbInfo = desPPD.desItems.iSizeBuffer;
+    if (( desPPD.desFonts.iFonts <= 0 ) || ( desPPD.desFonts.ofsFontnames <= 0 ) ||
+        ( (ULONG) desPPD.desFonts.ofsFontnames >= cbInfo ))
+        return NULL;
+
+    // As in GeneratePPD(), the list also ends at the first empty name
+    pszFirst = (PSZ)( pInfoSeg + desPPD.desFonts.ofsFontnames );
+    pszEnd   = (PSZ)( pInfoSeg + cbInfo );
+    for ( psz = pszFirst, c = 0; c < (ULONG) desPPD.desFonts.iFonts; c++ ) {
+        if (( psz >= pszEnd ) || !*psz || !memchr( psz, 0, pszEnd - psz )) break;
+        psz += strlen( psz ) + 1;
+    }
+    *pcFonts = c;
+    return c ? pszFirst : NULL;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CompareNames                                                              *
+ * ------------------------------------------------------------------------- */
+static int CompareNames( const void *p1, const void *p2 )
+{
+    return strcmp( *((PSZ *) p1 ), *((PSZ *) p2 ));
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakFontIndexBuild                                                         *
+ *                                                                           *
+ * Build the font index of a PAK file.                                       *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID              pHeap    : Heap to allocate from (or NULL)           *
+ *   PBYTE              pbFile   : PAK file image (must stay in memory while *
+ *                                 the index is used)                        *
+ *   ULONG              cbFile   : Size of the image                         *
+ *   PPAK_DEV_DIRENTRY  pEntries : Directory, in V1 form (must also stay in  *
+ *                                 memory)                                   *
+ *   ULONG              cEntries : Number of directory entries               *
+ *   PPAKFONTIDX       *ppIndex  : Receives the index (free with             *
+ *                                 PakFontIndexFree)                         *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success or ERROR_NOT_ENOUGH_MEMORY.  Printers whose segment lies   *
+ *   outside the file, or has no valid font list, have no fonts.             *
+ * ------------------------------------------------------------------------- */
+ULONG PakFontIndexBuild( PVOID pHeap, PBYTE pbFile, ULONG cbFile, PPAK_DEV_DIRENTRY pEntries,
+                         ULONG cEntries, PPAKFONTIDX *ppIndex )
+{
+    PPAKFONTIDX pIndex;
+    PSZ        *apszNames = NULL,
+                psz;
+    PULONG      pulSlots  = NULL,
+                pulIds    = NULL,
+                pulFirst  = NULL,
+                pulRank   = NULL,
+                pulRow;
+    ULONG       cNames,
+                cSlots,
+                cFonts,
+                cWords,
+                cList,
+                ulSlot,
+                ulHash,
+                cb, i, j;
+    APIRET      rc = ERROR_NOT_ENOUGH_MEMORY;
+
+    *ppIndex = NULL;
+
+    // Count every name listed, which bounds the number of distinct fonts
+    for ( i = 0, cNames = 0; i < cEntries; i++ ) {
+        if (( pEntries[ i ].ulOffset > cbFile ) || ( pEntries[ i ].ulSize > cbFile - pEntries[ i ].ulOffset ))
+            continue;
+        FontList( pbFile + pEntries[ i ].ulOffset, pEntries[ i ].ulSize, &cList );
+        cNames += cList;
+    }
+    for ( cSlots = 16; cSlots < 2 * cNames; cSlots <<= 1 );
+
+    // Scratch: the hash table, the interned names, and each printer's list
+    // of font numbers, and the sorted rank of each number
+    pulSlots  = (PULONG) PakAlloc( pHeap, cSlots * sizeof( ULONG ));
+    apszNames = (PSZ *) PakAlloc( pHeap, ( cNames + 1 ) * sizeof( PSZ ));
+    pulIds    = (PULONG) PakAlloc( pHeap, ( cNames + 1 ) * sizeof( ULONG ));
+    pulRank   = (PULONG) PakAlloc( pHeap, ( cNames + 1 ) * sizeof( ULONG ));
+    pulFirst  = (PULONG) PakAlloc( pHeap, ( cEntries + 1 ) * sizeof( ULONG ));
+    if ( !pulSlots || !apszNames || !pulIds || !pulRank || !pulFirst ) goto cleanup;
+    memset( pulSlots, 0, cSlots * sizeof( ULONG ));
+
+    for ( i = 0, cFonts = 0, cNames = 0; i < cEntries; i++ ) {
+        pulFirst[ i ] = cNames;
+        if (( pEntries[ i ].ulOffset > cbFile ) || ( pEntries[ i ].ulSize > cbFile - pEntries[ i ].ulOffset ))
+            continue;
+        psz = FontList( pbFile + pEntries[ i ].ulOffset, pEntries[ i ].ulSize, &cList );
+        for ( j = 0; j < cList; j++, psz += cb + 1 ) {
+            cb     = strlen( psz );
+            ulHash = Pak2HashData( (PBYTE) psz, cb );
+            for ( ulSlot = ulHash & ( cSlots - 1 ); pulSlots[ ulSlot ];
+                  ulSlot = ( ulSlot + 1 ) & ( cSlots - 1 ))
+            {
+                if ( strcmp( apszNames[ pulSlots[ ulSlot ] - 1 ], psz ) == 0 ) break;
+            }
+            if ( !pulSlots[ ulSlot ] ) {
+                apszNames[ cFonts++ ] = psz;
+                pulSlots[ ulSlot ] = cFonts;
+            }
+            pulIds[ cNames++ ] = pulSlots[ ulSlot ] - 1;
+        }
+    }
+    pulFirst[ cEntries ] = cNames;
+
+    // The index proper: names in sorted order, then one bitset per printer
+    cWords = ( cFonts + 31 ) / 32;
+    cb = sizeof( PAKFONTIDX ) + cFonts * sizeof( PSZ ) + cEntries * cWords * sizeof( ULONG );
+    if (( pIndex = (PPAKFONTIDX) PakAlloc( pHeap, cb )) == NULL ) goto cleanup;
+    memset( pIndex, 0, cb );
+    pIndex->cPrinters = cEntries;
+    pIndex->pEntries  = pEntries;
+    pIndex->cFonts    = cFonts;
+    pIndex->cWords    = cWords;
+    pIndex->apszFonts = (PSZ *)( pIndex + 1 );
+    pIndex->pulBits   = (PULONG)( pIndex->apszFonts + cFonts );
+    memcpy( pIndex->apszFonts, apszNames, cFonts * sizeof( PSZ ));
+    qsort( pIndex->apszFonts, cFonts, sizeof( PSZ ), CompareNames );
+
+    // Map each interned number to its sorted rank, finding it through the
+    // hash table, which still holds (number + 1) for every name
+    for ( i = 0; i < cFonts; i++ ) {
+        psz = pIndex->apszFonts[ i ];
+        for ( ulSlot = Pak2HashData( (PBYTE) psz, strlen( psz )) & ( cSlots - 1 );
+              apszNames[ pulSlots[ ulSlot ] - 1 ] != psz;
+              ulSlot = ( ulSlot + 1 ) & ( cSlots - 1 ));
+        pulRank[ pulSlots[ ulSlot ] - 1 ] = i;
+    }
+    for ( i = 0; i < cEntries; i++ ) {
+        pulRow = pIndex->pulBits + i * cWords;
+        for ( j = pulFirst[ i ]; j < pulFirst[ i + 1 ]; j++ )
+            pulRow[ pulRank[ pulIds[ j ]] / 32 ] |= 1UL << ( pulRank[ pulIds[ j ]] % 32 );
+    }
+
+    *ppIndex = pIndex;
+    rc = NO_ERROR;
+
+cleanup:
+    PakFree( pHeap, pulSlots );
+    PakFree( pHeap, apszNames );
+    PakFree( pHeap, pulIds );
+    PakFree( pHeap, pulRank );
+    PakFree( pHeap, pulFirst );
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakFontIndexFree                                                          *
+ * ------------------------------------------------------------------------- */
+VOID PakFontIndexFree( PVOID pHeap, PPAKFONTIDX pIndex )
+{
+    PakFree( pHeap, pIndex );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakFontIndexFind                                                          *
+ *                                                                           *
+ * Find the number of a font by name (case-sensitive, as in the PPD file).   *
+ *                                                                           *
+ * RETURNS: LONG                                                             *
+ *   The font number, or -1 if no printer has the font                       *
+ * ------------------------------------------------------------------------- */
+LONG PakFontIndexFind( PPAKFONTIDX pIndex, PSZ pszFont )
+{
+    PSZ *ppsz;
+
+    ppsz = (PSZ *) bsearch( &pszFont, pIndex->apszFonts, pIndex->cFonts, sizeof( PSZ ), CompareNames );
+    return ppsz ? ppsz - pIndex->apszFonts : -1;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakFontIndexPrinter                                                       *
+ *                                                                           *
+ * Find the number of a printer by name (case-insensitive).                  *
+ *                                                                           *
+ * RETURNS: LONG                                                             *
+ *   The printer number (its directory entry), or -1 if not found            *
+ * ------------------------------------------------------------------------- */
+LONG PakFontIndexPrinter( PPAKFONTIDX pIndex, PSZ pszPrinter )
+{
+    ULONG i;
+
+    for ( i = 0; i < pIndex->cPrinters; i++ ) {
+        if ( strnicmp( pIndex->pEntries[ i ].szDeviceName, pszPrinter,
+                       sizeof( pIndex->pEntries[ i ].szDeviceName )) == 0 )
+            return i;
+    }
+    return -1;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakFontIndexCombine                                                       *
+ *                                                                           *
+ * Combine the font sets of several printers.                                *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAKFONTIDX pIndex     : Font index                                     *
+ *   PULONG      pulPrinters: Printer numbers                                *
+ *   ULONG       cPrinters  : Number of printers (0 gives an empty set)      *
+ *   BOOL        fUnion     : TRUE for the fonts any of them has, FALSE for  *
+ *                            the fonts all of them have                     *
+ *   PULONG      pulSet     : Receives the set (pIndex->cWords ULONGs)       *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   The number of fonts in the set                                          *
+ * ------------------------------------------------------------------------- */
+ULONG PakFontIndexCombine( PPAKFONTIDX pIndex, PULONG pulPrinters, ULONG cPrinters,
+                           BOOL fUnion, PULONG pulSet )
+{
+    PULONG pulRow;
+    ULONG  ul, c, i, w;
+
+    memset( pulSet, 0, pIndex->cWords * sizeof( ULONG ));
+    if ( !cPrinters ) return 0;
+    memcpy( pulSet, PAKFONTIDX_ROW( pIndex, pulPrinters[ 0 ] ), pIndex->cWords * sizeof( ULONG ));
+    for ( i = 1; i < cPrinters; i++ ) {
+        pulRow = PAKFONTIDX_ROW( pIndex, pulPrinters[ i ] );
+        for ( w = 0; w < pIndex->cWords; w++ ) {
+            if ( fUnion ) pulSet[ w ] |= pulRow[ w ];
+            else          pulSet[ w ] &= pulRow[ w ];
+        }
+    }
+    for ( w = 0, c = 0; w < pIndex->cWords; w++ ) {
+        for ( ul = pulSet[ w ]; ul; ul &= ul - 1 ) c++;
+    }
+    return c;
+}
@@ -0,0 +1,360 @@
+/*
+ * pakfld.c
+ *
+ * PAKTOOL library: field tables.  Each structure stored in a device segment
+ * (DESPPD, UI_BLOCK, UI_ENTRY and UIC_BLOCK) is described once here, as a
+ * table of its fields in storage order giving each one's name, offset, size,
+ * signedness and what it refers to.  The tables are built at compile time
+ * for the PSDRIVER layout being compiled, so that a field missing from one
+ * layout is simply absent from its table.
+ *
+ * The structured (V) and JSON formatters, the annotated dump, CHECK, SLACK
+ * and VERIFY all walk these tables instead of naming the fields themselves.
+ */
+
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+
+#define MEMBER_SIZE( t, f ) sizeof( ((t *) 0)->f )
+
+#define DESFIELD( f, fs )   { #f, offsetof( DESPPD, f ), MEMBER_SIZE( DESPPD, f ), fs }
+#define UIBFIELD( f, fs )   { #f, offsetof( UI_BLOCK, f ), MEMBER_SIZE( UI_BLOCK, f ), fs }
+#define UIEFIELD( f, fs )   { #f, offsetof( UI_ENTRY, f ), MEMBER_SIZE( UI_ENTRY, f ), fs }
+#define UICFIELD( f, fs )   { #f, offsetof( UIC_BLOCK, f ), MEMBER_SIZE( UIC_BLOCK, f ), fs }
+
+// Shorthands for the common kinds of field
+#define NUM                 PF_SIGNED
+#define STR                 ( PF_SIGNED | PF_STRING )
+#define CMD                 ( PF_SIGNED | PF_STRING | PF_COMMAND )
+#define TBL                 ( PF_SIGNED | PF_TABLE )
+#define OLD                 ( PF_SIGNED | PF_TABLE | PF_UNKNOWN )
+
+static PAKFIELD aDesFields[] = {
+    DESFIELD( desItems.iSizeBuffer,              NUM | PF_COUNT ),
+    DESFIELD( desItems.ofsPswrd,                 STR ),
+    DESFIELD( desItems.iPpm,                     NUM ),
+    DESFIELD( desItems.lFreeVM,                  NUM ),
+    DESFIELD( desItems.ofsPrType,                STR | PF_NO_PPD ),
+    DESFIELD( desItems.ofsPrName,                STR | PF_ZERO_OK | PF_REQUIRED ),
+    DESFIELD( desItems.iResDpi,                  NUM ),
+    DESFIELD( desItems.ResList.uNumOfRes,        NUM | PF_NO_PPD ),
+    DESFIELD( desItems.ResList.uResOffset,       NUM | PF_NO_PPD ),
+    DESFIELD( desItems.ResList.bIsJCLResolution, PF_NO_PPD ),
+    DESFIELD( desItems.lScrFreq,                 NUM ),
+    DESFIELD( desItems.fIsColorDevice,           NUM ),
+    DESFIELD( desItems.fIsFileSystem,            NUM ),
+    DESFIELD( desItems.ofsReset,                 CMD ),
+    DESFIELD( desItems.ofsExitserver,            CMD ),
+    DESFIELD( desItems.iScreenAngle,             NUM ),
+    DESFIELD( desItems.usLanguageLevel,          0 ),
+    DESFIELD( desItems.ofsTransferNor,           CMD ),
+    DESFIELD( desItems.ofsTransferInv,           CMD ),
+    DESFIELD( desItems.ofsInitString,            CMD | PF_ZERO_OK ),
+    DESFIELD( desItems.ofsJCLToPS,               CMD | PF_ZERO_OK ),
+    DESFIELD( desItems.ofsTermString,            CMD | PF_ZERO_OK ),
+    DESFIELD( desItems.sDefaultDuplex,           NUM | PF_NO_PPD ),
+    DESFIELD( desItems.ofsDuplexFalse,           STR | PF_NO_PPD ),
+    DESFIELD( desItems.ofsDuplexNoTumble,        STR | PF_NO_PPD ),
+    DESFIELD( desItems.ofsDuplexTumble,          STR | PF_NO_PPD ),
+    DESFIELD( desItems.ofsPCFileName,            STR | PF_ZERO_OK ),
+#if PSDRIVER == 1
+    DESFIELD( desItems.fTTSupport,               NUM ),
+#endif
+#if PSDRIVER < 3
+    DESFIELD( desPage.ofsDfpgsz,                 STR | PF_NO_PPD ),
+#endif
+    DESFIELD( desPage.fIsVariablePaper,          NUM ),
+#if PSDRIVER < 3
+    DESFIELD( desPage.ofsDefimagearea,           STR | PF_NO_PPD ),
+    DESFIELD( desPage.ofsDefpaperdim,            STR | PF_NO_PPD ),
+    DESFIELD( desPage.iCmpgpairs,                NUM | PF_NO_PPD ),
+    DESFIELD( desPage.ofsLspgCmnds,              OLD | PF_NO_PPD ),
+#endif
+    DESFIELD( desPage.iDmpgpairs,                NUM | PF_COUNT ),
+    DESFIELD( desPage.ofsDimxyPgsz,              TBL ),
+    DESFIELD( desPage.iImgpgpairs,               NUM | PF_COUNT ),
+    DESFIELD( desPage.ofsImgblPgsz,              TBL ),
+    DESFIELD( desPage.ofsCustomPageSize,         CMD ),
+    DESFIELD( desPage.iCustomPageSizeMinWidth,   NUM ),
+    DESFIELD( desPage.iCustomPageSizeMaxWidth,   NUM ),
+    DESFIELD( desPage.iCustomPageSizeMinHeight,  NUM ),
+    DESFIELD( desPage.iCustomPageSizeMaxHeight,  NUM ),
+#if PSDRIVER > 2
+    DESFIELD( desPage.sReserved1,                NUM | PF_NO_PPD ),
+    DESFIELD( desPage.sReserved2,                NUM | PF_NO_PPD ),
+#endif
+    DESFIELD( desInpbins.iManualfeed,            NUM | PF_NO_PPD ),
+    DESFIELD( desInpbins.ofsManualtrue,          CMD | PF_NO_PPD ),
+    DESFIELD( desInpbins.ofsManualfalse,         CMD | PF_NO_PPD ),
+    DESFIELD( desInpbins.ofsDefinputslot,        STR | PF_NO_PPD ),
+    DESFIELD( desInpbins.iInpbinpairs,           NUM | PF_NO_PPD ),
+    DESFIELD( desInpbins.ofsCmInpbins,           OLD | PF_NO_PPD ),
+    DESFIELD( desInpbins.iNumOfPageSizes,        NUM | PF_NO_PPD ),
+    DESFIELD( desInpbins.ofsPageSizes,           OLD | PF_NO_PPD ),
+    DESFIELD( desOutbins.fIsDefoutorder,         NUM ),
+    DESFIELD( desOutbins.ofsOrdernormal,         CMD ),
+    DESFIELD( desOutbins.ofsOrderreverse,        CMD ),
+    DESFIELD( desOutbins.ofsDefoutputbin,        STR | PF_NO_PPD ),
+    DESFIELD( desOutbins.iOutbinpairs,           NUM | PF_NO_PPD ),
+    DESFIELD( desOutbins.ofsCmOutbins,           OLD | PF_NO_PPD ),
+    DESFIELD( desFonts.ofsDeffont,               STR ),
+    DESFIELD( desFonts.iFonts,                   NUM | PF_COUNT ),
+    DESFIELD( desFonts.ofsFontnames,             TBL ),
+    DESFIELD( desForms.usFormCount,              PF_NO_PPD ),
+    DESFIELD( desForms.ofsFormTable,             TBL | PF_NO_PPD ),
+    DESFIELD( desForms.ofsFormIndex,             TBL | PF_NO_PPD ),
+    DESFIELD( stUIList.usNumOfBlocks,            PF_COUNT ),
+    DESFIELD( stUIList.usBlockListSize,          PF_COUNT ),
+    DESFIELD( stUIList.pBlockList,               PF_POINTER ),
+    DESFIELD( stUICList.usNumOfUICs,             PF_COUNT ),
+    DESFIELD( stUICList.puicBlockList,           PF_POINTER ),
+    DESFIELD( pPSStringBuff,                     PF_POINTER ),
+    { NULL, 0, 0, 0 }
+};
+
+// The offsets in UI blocks and entries are stored unsigned, but -1 is "none";
+// a name or value may be the empty string at offset 0
+static PAKFIELD aBlockFields[] = {
+    UIBFIELD( ofsUIName,        STR | PF_ZERO_OK | PF_REQUIRED ),
+    UIBFIELD( ofsUITransString, STR ),
+    UIBFIELD( usOrderDep,       0 ),
+    UIBFIELD( usDisplayOrder,   PF_NO_PPD ),
+    UIBFIELD( usUILocation,     0 ),
+    UIBFIELD( usSelectType,     0 ),
+    UIBFIELD( ucGroupType,      0 ),
+    UIBFIELD( ucPanelID,        PF_NO_PPD ),
+    UIBFIELD( usDefaultEntry,   0 ),
+    UIBFIELD( usNumOfEntries,   PF_COUNT ),
+    { NULL, 0, 0, 0 }
+};
+
+static PAKFIELD aEntryFields[] = {
+    UIEFIELD( ofsOption,      STR | PF_ZERO_OK ),
+    UIEFIELD( ofsTransString, STR ),
+    UIEFIELD( ofsValue,       CMD | PF_ZERO_OK ),
+    { NULL, 0, 0, 0 }
+};
+
+static PAKFIELD aUicFields[] = {
+    UICFIELD( uicEntry1.ofsUIBlock, 0 ),
+    UICFIELD( uicEntry1.bOption,    PF_HEX ),
+    UICFIELD( uicEntry2.ofsUIBlock, 0 ),
+    UICFIELD( uicEntry2.bOption,    PF_HEX ),
+    { NULL, 0, 0, 0 }
+};
+
+static PPAKFIELD apTables[] = { aDesFields, aBlockFields, aEntryFields, aUicFields };
+
+
+/* ------------------------------------------------------------------------- *
+ * PakFieldTable                                                             *
+ *                                                                           *
+ * Return the field table of one of the structures in a device segment.      *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   ULONG ulTable: PAKFT_DESPPD, PAKFT_UI_BLOCK, PAKFT_UI_ENTRY or          *
+ *                  PAKFT_UIC_BLOCK                                          *
+ *                                                                           *
+ * RETURNS: PPAKFIELD                                                        *
+ *   The fields in storage order, ending with one whose pszName is NULL; or  *
+ *   NULL if ulTable is not valid                                            *
+ * ------------------------------------------------------------------------- */
+PPAKFIELD PakFieldTable( ULONG ulTable )
+{
+    return ( ulTable < sizeof( apTables ) / sizeof( PPAKFIELD )) ? apTables[ ulTable ] : NULL;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakFieldValue                                                             *
+ *                                                                           *
+ * Read a field from a structure, sign-extending it if it is signed.         *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAKFIELD pField : Field, from one of the PakFieldTable() tables        *
+ *   PVOID     pStruct: Structure containing the field                       *
+ *                                                                           *
+ * RETURNS: LONG                                                             *
+ *   Value of the field (4-byte unsigned fields are returned as their bits)  *
+ * ------------------------------------------------------------------------- */
+LONG PakFieldValue( PPAKFIELD pField, PVOID pStruct )
+{
+    PBYTE pb = (PBYTE) pStruct + pField->usOffset;
+
+    switch ( pField->cb ) {
+        case 1:
+            return ( pField->fs & PF_SIGNED ) ? (LONG) *((PCHAR) pb ) : (LONG) *pb;
+        case 2:
+            return ( pField->fs & PF_SIGNED ) ? (LONG) *((PSHORT) pb ) : (LONG) *((PUSHORT) pb );
+        case 4:
+            return *((PLONG) pb );
+    }
+    return 0;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * JsonString                                                                *
+ *                                                                           *
+ * Write a string as a JSON string literal, converting it from code page 850 *
+ * to UTF-8.  Control characters are written as escapes.                     *
+ * ------------------------------------------------------------------------- */
+static void JsonString( PSZ psz, POUTBUF pOut )
+{
+    PSZ pszRun;
+
+    OutWrite( pOut, "\"", 1 );
+    while ( *psz ) {
+        for ( pszRun = psz; *psz && *psz != '"' && *psz != '\\' && (UCHAR) *psz >= 32; psz++ );
+        if ( psz > pszRun ) OutCp850( pOut, pszRun, psz - pszRun );
+        if ( !*psz ) break;
+        if ( *psz == '"' || *psz == '\\') OutPrintf( pOut, "\\%c", *psz );
+        else if ( *psz == '\n') OutPrintf( pOut, "\\n");
+        else if ( *psz == '\r') OutPrintf( pOut, "\\r");
+        else if ( *psz == '\t') OutPrintf( pOut, "\\t");
+        else OutPrintf( pOut, "\\u%04X", (UCHAR) *psz );
+        psz++;
+    }
+    OutWrite( pOut, "\"", 1 );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * JsonFields                                                                *
+ *                                                                           *
+ * Write the fields of a structure as members of a JSON object.  Each string *
+ * offset which refers to a string within the information segment is also    *
+ * written as "<field>.text", decompressed if it is a command.               *
+ * ------------------------------------------------------------------------- */
+static void JsonFields( PPAKFIELD pField, PVOID pStruct, PBYTE pInfoSeg, ULONG cbInfo,
+                        PPAKARENA pArena, PSZ pszIndent, POUTBUF pOut )
+{
+    PSZ   psz,
+          pszText;
+    LONG  lValue,
+          lLen;
+    ULONG ulMark;
+    BOOL  fFirst = TRUE;
+
+    for ( ; pField->pszName; pField++ ) {
+        if ( pField->fs & PF_POINTER ) continue;
+        lValue = PakFieldValue( pField, pStruct );
+        OutPrintf( pOut, "%s\n%s\"%s\": ", fFirst ? "" : ",", pszIndent, pField->pszName );
+        // JSON has no hex literals, so bit masks are written as unsigned numbers
+        if ( pField->fs & PF_SIGNED ) OutPrintf( pOut, "%ld", lValue );
+        else OutPrintf( pOut, "%lu", (ULONG) lValue );
+        fFirst = FALSE;
+
+        if ( !( pField->fs & PF_STRING ) || lValue < 0 || (ULONG) lValue >= cbInfo ||
+             ( lValue == 0 && !( pField->fs & PF_ZERO_OK )))
+            continue;
+        psz = (PSZ)( pInfoSeg + lValue );
+        if ( !memchr( psz, 0, cbInfo - lValue )) continue;
+        ulMark  = ArenaMark( pArena );
+        pszText = psz;
+        if (( pField->fs & PF_COMMAND ) &&
+            ( lLen = DecompressedLength( pArena->pDict, psz )) >= 0 &&
+            ( pszText = (PSZ) ArenaAlloc( pArena, lLen + 1 )) != NULL )
+            ExpandString( pArena, psz, pszText );
+        else if ( !pszText ) pszText = psz;
+        OutPrintf( pOut, ",\n%s\"%s.text\": ", pszIndent, pField->pszName );
+        JsonString( pszText, pOut );
+        ArenaRelease( pArena, ulMark );
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ShowJsonData                                                              *
+ *                                                                           *
+ * Write a device segment as a JSON object, with a member for every field of *
+ * its DESPPD (by its name in the field table) and arrays of its UI blocks,  *
+ * each with its entries, and of its UI constraints.  The UI list is walked  *
+ * only as far as it lies within the segment, so that a damaged segment      *
+ * gives incomplete rather than undefined output.                            *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PAK_DEV_DIRENTRY pdd   : Directory entry of the segment                 *
+ *   PBYTE            pBuf  : The segment                                    *
+ *   PPAKARENA        pArena: Scratch arena (or NULL)                        *
+ *   POUTBUF          pOut  : Output buffer, or NULL for STDOUT              *
+ *                                                                           *
+ * RETURNS: N/A                                                              *
+ * ------------------------------------------------------------------------- */
+void ShowJsonData( PAK_DEV_DIRENTRY pdd, PBYTE pBuf, PPAKARENA pArena, POUTBUF pOut )
+{
+    DESPPD     desPPD = {0};
+    PUI_BLOCK  puib;
+    PUIC_BLOCK puicb;
+    PBYTE      pb,
+               pInfoSeg;
+    PAKARENA   arLocal = {0};
+    ULONG      cbList,
+               cbUICs,
+               cbInfo,
+               cb,
+               i, j;
+
+    if ( !pArena ) pArena = &arLocal;
+    OutPrintf( pOut, "{\n  \"name\": ");
+    JsonString( pdd.szDeviceName, pOut );
+    OutPrintf( pOut, ",\n  \"size\": %lu", pdd.ulSize );
+    if ( pdd.ulSize < sizeof( DESPPD )) {
+        OutPrintf( pOut, "\n}\n");
+        return;
+    }
+
+    // Locate the lists and the information segment, within the segment
+    memcpy( &desPPD, pBuf, sizeof( DESPPD ));
+    cb     = pdd.ulSize - sizeof( DESPPD );
+    cbList = ( desPPD.stUIList.usBlockListSize <= cb ) ? desPPD.stUIList.usBlockListSize : cb;
+    cb    -= cbList;
+    cbUICs = desPPD.stUICList.usNumOfUICs * sizeof( UIC_BLOCK );
+    if ( cbUICs > cb ) cbUICs = cb - cb % sizeof( UIC_BLOCK );
+    cbInfo   = cb - cbUICs;
+    if (( desPPD.desItems.iSizeBuffer >= 0 ) && ( (ULONG) desPPD.desItems.iSizeBuffer < cbInfo ))
+        cbInfo = desPPD.desItems.iSizeBuffer;
+    pInfoSeg = pBuf + sizeof( DESPPD ) + cbList + cbUICs;
+
+    OutPrintf( pOut, ",\n  \"DESPPD\": {");
+    JsonFields( PakFieldTable( PAKFT_DESPPD ), &desPPD, pInfoSeg, cbInfo, pArena, "    ", pOut );
+    OutPrintf( pOut, "\n  },\n  \"UI_BLOCK\": [");
+
+    pb = pBuf + sizeof( DESPPD );
+    for ( i = 0; i < desPPD.stUIList.usNumOfBlocks; i++ ) {
+        puib = (PUI_BLOCK) pb;
+        if (( cbList < UI_BLOCK_FIXED ) ||
+            (( cb = UI_BLOCK_FIXED + puib->usNumOfEntries * sizeof( UI_ENTRY )) > cbList ))
+            break;
+        OutPrintf( pOut, "%s\n    {", i ? "," : "");
+        JsonFields( PakFieldTable( PAKFT_UI_BLOCK ), puib, pInfoSeg, cbInfo, pArena, "      ", pOut );
+        OutPrintf( pOut, ",\n      \"uiEntry\": [");
+        for ( j = 0; j < puib->usNumOfEntries; j++ ) {
+            OutPrintf( pOut, "%s\n        {", j ? "," : "");
+            JsonFields( PakFieldTable( PAKFT_UI_ENTRY ), puib->uiEntry + j, pInfoSeg, cbInfo,
+                        pArena, "          ", pOut );
+            OutPrintf( pOut, "\n        }");
+        }
+        OutPrintf( pOut, "%s]\n    }", j ? "\n      " : "");
+        pb     += cb;
+        cbList -= cb;
+    }
+    OutPrintf( pOut, "%s],\n  \"UIC_BLOCK\": [", i ? "\n  " : "");
+
+    puicb = (PUIC_BLOCK)( pBuf + sizeof( DESPPD ) + desPPD.stUIList.usBlockListSize );
+    for ( i = 0; i < cbUICs / sizeof( UIC_BLOCK ); i++, puicb++ ) {
+        OutPrintf( pOut, "%s\n    {", i ? "," : "");
+        JsonFields( PakFieldTable( PAKFT_UIC_BLOCK ), puicb, pInfoSeg, cbInfo, pArena, "      ", pOut );
+        OutPrintf( pOut, "\n    }");
+    }
+    OutPrintf( pOut, "%s]\n}\n", i ? "\n  " : "");
+    if ( pArena == &arLocal ) ArenaFree( &arLocal );
+}
@@ -0,0 +1,195 @@
+/*
+ * pakfont.c
+ *
+ * PAKTOOL library: font PAK files.  See paklib.h for an overview.
+ *
+ * A font PAK (font1.pak, auxfont.pak) has the same layout as a V1 device PAK,
+ * but its directory holds PAK_FONT_DIRENTRY records, each naming a font by
+ * both its PostScript name and its full name.  The whole file is read into
+ * memory once, and a hash table built on each of the two names, so that
+ * fonts can be found without scanning the directory (as GetFontDirEntry()
+ * and GetFontDirEntryByFullName() do), and their data used in place.
+ */
+
+#define INCL_DOSFILEMGR
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+#include "pakv2.h"
+
+
+/* ------------------------------------------------------------------------- *
+ * NameLength                                                                *
+ *                                                                           *
+ * Length of a directory name field, which need not be null-terminated.      *
+ * ------------------------------------------------------------------------- */
+static ULONG NameLength( PCHAR pch, ULONG cchMax )
+{
+    PCHAR pchEnd = (PCHAR) memchr( pch, 0, cchMax );
+
+    return pchEnd ? pchEnd - pch : cchMax;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * FindSlot                                                                  *
+ *                                                                           *
+ * Find a name in one of the hash tables.  Each slot holds an entry number   *
+ * plus one, or 0 if empty; the name field compared is at offset ofsName of  *
+ * each directory entry.                                                     *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   The slot holding the name, or the empty slot where it would be added    *
+ * ------------------------------------------------------------------------- */
+static ULONG FindSlot( PPAKFONTPAK pPak, PULONG pulSlots, ULONG ofsName, PCHAR pchName, ULONG cch )
+{
+    PCHAR pchEntry;
+    ULONG ulSlot;
+
+    for ( ulSlot = Pak2HashData( (PBYTE) pchName, cch ) & ( pPak->cSlots - 1 );
+          pulSlots[ ulSlot ];
+          ulSlot = ( ulSlot + 1 ) & ( pPak->cSlots - 1 ))
+    {
+        pchEntry = (PCHAR)( pPak->pEntries + pulSlots[ ulSlot ] - 1 ) + ofsName;
+        if (( NameLength( pchEntry, PAKFONT_NAME_SIZE ) == cch ) && ( memcmp( pchEntry, pchName, cch ) == 0 ))
+            break;
+    }
+    return ulSlot;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakFontPakOpen                                                            *
+ *                                                                           *
+ * Read a font PAK file into memory and index its directory.                 *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID        pHeap     : Heap to allocate from (or NULL)                *
+ *   PSZ          pszPakFile: Name of the font PAK file                      *
+ *   PPAKFONTPAK *ppPak     : Receives the font PAK (free with               *
+ *                            PakFontPakClose)                               *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_INVALID_DATA if the file is not a font PAK (or its  *
+ *   directory is incomplete), otherwise an OS/2 error code                  *
+ * ------------------------------------------------------------------------- */
+ULONG PakFontPakOpen( PVOID pHeap, PSZ pszPakFile, PPAKFONTPAK *ppPak )
+{
+    FILESTATUS3   fs3;
+    PPAKFONTPAK   pPak;
+    PPAKSIGNATURE pSig;
+    PBYTE         pbFile;
+    ULONG         cSlots,
+                  cb, i, s;
+    APIRET        rc;
+
+    *ppPak = NULL;
+    if (( rc = DosQueryPathInfo( pszPakFile, FIL_STANDARD, &fs3, sizeof( fs3 ))) != NO_ERROR )
+        return rc;
+    if ( fs3.cbFile < sizeof( PAKSIGNATURE )) return ERROR_INVALID_DATA;
+    if (( rc = PakLoadSegment( pHeap, pszPakFile, 0, fs3.cbFile, &pbFile )) != NO_ERROR )
+        return rc;
+
+    pSig = (PPAKSIGNATURE) pbFile;
+    if (( strncmp( pSig->szName, PAKSIGNATURE_FONTPACK_V1, sizeof( pSig->szName )) != 0 ) ||
+        ( pSig->iEntries < 0 ) ||
+        ( sizeof( PAKSIGNATURE ) + pSig->iEntries * sizeof( PAK_FONT_DIRENTRY ) > fs3.cbFile ))
+    {
+        PakFree( pHeap, pbFile );
+        return ERROR_INVALID_DATA;
+    }
+
+    for ( cSlots = 16; cSlots < 2 * (ULONG) pSig->iEntries; cSlots <<= 1 );
+    cb = sizeof( PAKFONTPAK ) + 2 * cSlots * sizeof( ULONG );
+    if (( pPak = (PPAKFONTPAK) PakAlloc( pHeap, cb )) == NULL ) {
+        PakFree( pHeap, pbFile );
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+    memset( pPak, 0, cb );
+    pPak->pbFile      = pbFile;
+    pPak->cbFile      = fs3.cbFile;
+    pPak->cEntries    = pSig->iEntries;
+    pPak->pEntries    = (PPAK_FONT_DIRENTRY)( pbFile + sizeof( PAKSIGNATURE ));
+    pPak->cSlots      = cSlots;
+    pPak->pulByName   = (PULONG)( pPak + 1 );
+    pPak->pulByFull   = pPak->pulByName + cSlots;
+
+    // Where a name occurs twice, the first entry is kept, as a directory
+    // scan would find
+    for ( i = 0; i < pPak->cEntries; i++ ) {
+        s = FindSlot( pPak, pPak->pulByName, offsetof( PAK_FONT_DIRENTRY, szFontName ),
+                      pPak->pEntries[ i ].szFontName,
+                      NameLength( pPak->pEntries[ i ].szFontName, PAKFONT_NAME_SIZE ));
+        if ( !pPak->pulByName[ s ] ) pPak->pulByName[ s ] = i + 1;
+        s = FindSlot( pPak, pPak->pulByFull, offsetof( PAK_FONT_DIRENTRY, szFontFullName ),
+                      pPak->pEntries[ i ].szFontFullName,
+                      NameLength( pPak->pEntries[ i ].szFontFullName, PAKFONT_NAME_SIZE ));
+        if ( !pPak->pulByFull[ s ] ) pPak->pulByFull[ s ] = i + 1;
+    }
+
+    *ppPak = pPak;
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakFontPakClose                                                           *
+ * ------------------------------------------------------------------------- */
+VOID PakFontPakClose( PVOID pHeap, PPAKFONTPAK pPak )
+{
+    if ( !pPak ) return;
+    PakFree( pHeap, pPak->pbFile );
+    PakFree( pHeap, pPak );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakFontPakFind                                                            *
+ *                                                                           *
+ * Find a font by its PostScript name or its full name.  Names are compared  *
+ * exactly (and only up to the size of the directory fields), as in          *
+ * GetFontDirEntry() and GetFontDirEntryByFullName().                        *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAKFONTPAK pPak     : Font PAK                                         *
+ *   PSZ         pszName  : Name to find                                     *
+ *   BOOL        fFullName: TRUE to find a full name, FALSE a PostScript     *
+ *                          name                                             *
+ *                                                                           *
+ * RETURNS: PPAK_FONT_DIRENTRY                                               *
+ *   The directory entry, or NULL if not found                               *
+ * ------------------------------------------------------------------------- */
+PPAK_FONT_DIRENTRY PakFontPakFind( PPAKFONTPAK pPak, PSZ pszName, BOOL fFullName )
+{
+    PULONG pulSlots = fFullName ? pPak->pulByFull : pPak->pulByName;
+    ULONG  cch, s;
+
+    if (( cch = strlen( pszName )) > PAKFONT_NAME_SIZE ) cch = PAKFONT_NAME_SIZE;
+    s = FindSlot( pPak, pulSlots, fFullName ? offsetof( PAK_FONT_DIRENTRY, szFontFullName ) :
+                                              offsetof( PAK_FONT_DIRENTRY, szFontName ),
+                  pszName, cch );
+    return pulSlots[ s ] ? pPak->pEntries + pulSlots[ s ] - 1 : NULL;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakFontPakData                                                            *
+ *                                                                           *
+ * Return the data of a font, in place within the file image.                *
+ *                                                                           *
+ * RETURNS: PBYTE                                                            *
+ *   The font data (pEntry->ulSize bytes), or NULL if it lies outside the    *
+ *   file                                                                    *
+ * ------------------------------------------------------------------------- */
+PBYTE PakFontPakData( PPAKFONTPAK pPak, PPAK_FONT_DIRENTRY pEntry )
+{
+    if (( pEntry->ulOffset > pPak->cbFile ) || ( pEntry->ulSize > pPak->cbFile - pEntry->ulOffset ))
+        return NULL;
+    return pPak->pbFile + pEntry->ulOffset;
+}
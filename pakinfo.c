@@ -0,0 +1,623 @@
+/*
+ * pakinfo.c
+ *
+ * PAKTOOL library: use of the information segment.  See paklib.h for an
+ * overview.
+ *
+ * Nothing in the information segment says what it holds; it is reached only
+ * through the offsets in the DESPPD, the UI blocks and the forms index.  The
+ * references are collected here by following those offsets as the formatting
+ * functions do (see PakCheckDevice() for the same walk with diagnostics):
+ * single strings, the resolution and paper tables, the ImageableArea records
+ * (each ending in a string), the font list (consecutive strings) and the
+ * forms index (LONG string offsets).  From them, PakInfoMap() marks every
+ * byte referenced, and PakInfoCompact() rebuilds the segment from just those
+ * bytes, storing each distinct string once.
+ *
+ * Offsets of 0 are left as they are: for most fields 0 means "none", and for
+ * the rest it is the string at the start of the segment, which is always
+ * copied to the start of the new one.  The deprecated tables (input and
+ * output bin commands, page size list and paper commands) have no known
+ * length, so an entry which sets any of them is not compacted.
+ */
+
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+#include "pakv2.h"
+
+// Paper index records: dimension (idx, x, y); imageable (idx, x1, y1, x2, y2)
+#define DIM_RECORD_SIZE     ( 3 * sizeof( SHORT ))
+#define IMG_RECORD_SIZE     ( 5 * sizeof( SHORT ))
+
+#define INFO_MAX_SIZE       0x7FFF  // largest segment a SHORT offset can reach
+
+// Kinds of reference
+#define REF_STRING          1       // one null-terminated string
+#define REF_TABLE           2       // a block of cb bytes without offsets
+#define REF_INDEX           3       // a block of LONG string offsets
+
+// Bitmap of referenced bytes
+#define MAP_WORDS( cb )     ((( cb ) + 31 ) / 32 )
+#define MAP_SET( p, i )     ( (p)[ (i) / 32 ] |= 1UL << ( (i) % 32 ))
+#define MAP_TEST( p, i )    ( (p)[ (i) / 32 ] & ( 1UL << ( (i) % 32 )))
+
+
+// A reference to the information segment
+typedef struct _INFOREF
+{
+    USHORT usType;              // REF_* value
+    USHORT usField;             // segment offset of the (SHORT) offset field
+    ULONG  ulOff;               // offset within the information segment
+    ULONG  cb;                  // bytes referenced (with a string's null)
+} INFOREF, *PINFOREF;
+
+// The references of one segment
+typedef struct _INFOWALK
+{
+    PBYTE    pBuf;              // the segment
+    ULONG    cbDS;              // size of the descriptor segment
+    PBYTE    pInfoSeg;          // the information segment
+    ULONG    cbInfo;            // its size
+    PINFOREF pRefs;             // references found
+    ULONG    cRefs;             // number found
+    ULONG    cMax;              // number allocated
+    ULONG    cUnknown;          // references which could not be followed
+} INFOWALK, *PINFOWALK;
+
+// Strings already placed, by content (a hash table of offsets + 1)
+typedef struct _STRTABLE
+{
+    PBYTE  pbBase;              // buffer the offsets are relative to
+    PULONG pulSlots;            // offset + 1 of each string, or 0
+    PULONG pulLengths;          // length of each (with its null)
+    ULONG  cSlots;              // a power of 2
+} STRTABLE, *PSTRTABLE;
+
+
+#define DES_SHORT( p, o )   ( *(PSHORT)( (PBYTE)(p) + (o) ))
+
+
+/* ------------------------------------------------------------------------- *
+ * AddRef                                                                    *
+ *                                                                           *
+ * Record a reference, checking that it lies within the information segment  *
+ * (for a string, that it is terminated there; cb is then ignored).  Offsets *
+ * of 0 (and negative offsets) are not recorded.                             *
+ * ------------------------------------------------------------------------- */
+static void AddRef( PINFOWALK pWalk, USHORT usType, ULONG ulField, LONG lOff, ULONG cb )
+{
+    PINFOREF pRef;
+    PBYTE    pbEnd;
+
+    if ( lOff <= 0 ) {
+        // A table has no "none" value: the formatters would read it at 0
+        if (( usType != REF_STRING ) && cb ) pWalk->cUnknown++;
+        return;
+    }
+    if ( (ULONG) lOff >= pWalk->cbInfo ) {
+        pWalk->cUnknown++;
+        return;
+    }
+    if ( usType == REF_STRING ) {
+        pbEnd = (PBYTE) memchr( pWalk->pInfoSeg + lOff, 0, pWalk->cbInfo - lOff );
+        if ( !pbEnd ) {
+            pWalk->cUnknown++;
+            return;
+        }
+        cb = pbEnd - ( pWalk->pInfoSeg + lOff ) + 1;
+    }
+    else if ( !cb ) return;
+    else if ( cb > pWalk->cbInfo - lOff ) {
+        pWalk->cUnknown++;
+        return;
+    }
+    if ( pWalk->cRefs >= pWalk->cMax ) {
+        pWalk->cUnknown++;
+        return;
+    }
+    pRef = pWalk->pRefs + pWalk->cRefs++;
+    pRef->usType  = usType;
+    pRef->usField = (USHORT) ulField;
+    pRef->ulOff   = lOff;
+    pRef->cb      = cb;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ListLength                                                                *
+ *                                                                           *
+ * Return the length of a list of records in the information segment, each   *
+ * of cbFixed bytes followed by a string (or, with cbFixed 0, of strings     *
+ * ending early at an empty one), or 0 if the list runs past its end.        *
+ * ------------------------------------------------------------------------- */
+static ULONG ListLength( PINFOWALK pWalk, LONG lOff, ULONG cRecords, ULONG cbFixed, BOOL fStopEmpty )
+{
+    PBYTE pbEnd;
+    ULONG ulPos = lOff,
+          i;
+
+    if ( lOff <= 0 ) return 0;
+    for ( i = 0; i < cRecords; i++ ) {
+        if (( ulPos >= pWalk->cbInfo ) || ( pWalk->cbInfo - ulPos <= cbFixed )) return 0;
+        pbEnd = (PBYTE) memchr( pWalk->pInfoSeg + ulPos + cbFixed, 0, pWalk->cbInfo - ulPos - cbFixed );
+        if ( !pbEnd ) return 0;
+        if ( fStopEmpty && pbEnd == pWalk->pInfoSeg + ulPos ) {
+            ulPos++;
+            break;
+        }
+        ulPos = pbEnd - pWalk->pInfoSeg + 1;
+    }
+    return ulPos - lOff;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * WalkSegment                                                               *
+ *                                                                           *
+ * Collect the references of a device segment to its information segment.    *
+ * The caller frees pWalk->pRefs with PakFree().                             *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_INVALID_DATA if the descriptor segment does not fit *
+ *   the segment, or ERROR_NOT_ENOUGH_MEMORY                                 *
+ * ------------------------------------------------------------------------- */
+static ULONG WalkSegment( PVOID pHeap, PPAK_DEV_DIRENTRY pEntry, PBYTE pBuf, PINFOWALK pWalk )
+{
+    DESPPD    desPPD;
+    PUI_BLOCK puib;
+    PPAKFIELD pField;
+    PLONG     plVal;
+    ULONG     ulBlock,
+              cbLeft,
+              cb, i, j;
+
+    memset( pWalk, 0, sizeof( INFOWALK ));
+    pWalk->pBuf = pBuf;
+    if ( pEntry->ulSize < sizeof( DESPPD )) return ERROR_INVALID_DATA;
+    memcpy( &desPPD, pBuf, sizeof( DESPPD ));
+    pWalk->cbDS = sizeof( DESPPD ) + desPPD.stUIList.usBlockListSize +
+                  desPPD.stUICList.usNumOfUICs * sizeof( UIC_BLOCK );
+    if (( pWalk->cbDS > pEntry->ulSize ) || ( desPPD.desItems.iSizeBuffer < 0 ) ||
+        ( (ULONG) desPPD.desItems.iSizeBuffer > pEntry->ulSize - pWalk->cbDS ))
+        return ERROR_INVALID_DATA;
+    pWalk->pInfoSeg = pBuf + pWalk->cbDS;
+    pWalk->cbInfo   = desPPD.desItems.iSizeBuffer;
+
+    // Each UI block of n entries (at least UI_BLOCK_FIXED bytes) has 2 + 3n
+    // string offsets; the rest are in the DESPPD and the forms index
+    for ( pField = PakFieldTable( PAKFT_DESPPD ), cb = 0; pField->pszName; pField++ )
+        if ( pField->fs & PF_STRING ) cb++;
+    pWalk->cMax = desPPD.stUIList.usBlockListSize / 2 + desPPD.desForms.usFormCount + cb + 8;
+    pWalk->pRefs = (PINFOREF) PakAlloc( pHeap, pWalk->cMax * sizeof( INFOREF ));
+    if ( !pWalk->pRefs ) return ERROR_NOT_ENOUGH_MEMORY;
+
+    // String offsets, and deprecated tables of unknown length, in the DESPPD
+    for ( pField = PakFieldTable( PAKFT_DESPPD ); pField->pszName; pField++ ) {
+        if ( pField->fs & PF_STRING )
+            AddRef( pWalk, REF_STRING, pField->usOffset, (SHORT) PakFieldValue( pField, &desPPD ), 0 );
+        else if (( pField->fs & PF_UNKNOWN ) && PakFieldValue( pField, &desPPD ) > 0 )
+            pWalk->cUnknown++;
+    }
+
+    // UI blocks
+    ulBlock = sizeof( DESPPD );
+    cbLeft  = desPPD.stUIList.usBlockListSize;
+    for ( i = 0; i < desPPD.stUIList.usNumOfBlocks; i++ ) {
+        puib = (PUI_BLOCK)( pBuf + ulBlock );
+        if (( cbLeft < UI_BLOCK_FIXED ) ||
+            (( cb = UI_BLOCK_FIXED + puib->usNumOfEntries * sizeof( UI_ENTRY )) > cbLeft ))
+        {
+            pWalk->cUnknown++;
+            break;
+        }
+        for ( pField = PakFieldTable( PAKFT_UI_BLOCK ); pField->pszName; pField++ )
+            if ( pField->fs & PF_STRING )
+                AddRef( pWalk, REF_STRING, ulBlock + pField->usOffset, PakFieldValue( pField, puib ), 0 );
+        for ( j = 0; j < puib->usNumOfEntries; j++ ) {
+            cb = ulBlock + UI_BLOCK_FIXED + j * sizeof( UI_ENTRY );
+            for ( pField = PakFieldTable( PAKFT_UI_ENTRY ); pField->pszName; pField++ )
+                if ( pField->fs & PF_STRING )
+                    AddRef( pWalk, REF_STRING, cb + pField->usOffset,
+                            PakFieldValue( pField, puib->uiEntry + j ), 0 );
+        }
+        cb = UI_BLOCK_FIXED + puib->usNumOfEntries * sizeof( UI_ENTRY );
+        ulBlock += cb;
+        cbLeft  -= cb;
+    }
+
+    // Tables
+    if ( desPPD.desItems.ResList.uNumOfRes > 0 && desPPD.desItems.ResList.uResOffset > 0 )
+        AddRef( pWalk, REF_TABLE, offsetof( DESPPD, desItems.ResList.uResOffset ),
+                desPPD.desItems.ResList.uResOffset, desPPD.desItems.ResList.uNumOfRes * sizeof( SHORT ));
+    if ( desPPD.desPage.iDmpgpairs > 0 )
+        AddRef( pWalk, REF_TABLE, offsetof( DESPPD, desPage.ofsDimxyPgsz ),
+                desPPD.desPage.ofsDimxyPgsz, desPPD.desPage.iDmpgpairs * DIM_RECORD_SIZE );
+    if ( desPPD.desPage.iImgpgpairs > 0 ) {
+        cb = ListLength( pWalk, desPPD.desPage.ofsImgblPgsz, desPPD.desPage.iImgpgpairs,
+                         IMG_RECORD_SIZE, FALSE );
+        if ( cb ) AddRef( pWalk, REF_TABLE, offsetof( DESPPD, desPage.ofsImgblPgsz ),
+                          desPPD.desPage.ofsImgblPgsz, cb );
+        else pWalk->cUnknown++;
+    }
+    if ( desPPD.desFonts.iFonts > 0 ) {
+        cb = ListLength( pWalk, desPPD.desFonts.ofsFontnames, desPPD.desFonts.iFonts, 0, TRUE );
+        if ( cb ) AddRef( pWalk, REF_TABLE, offsetof( DESPPD, desFonts.ofsFontnames ),
+                          desPPD.desFonts.ofsFontnames, cb );
+        else pWalk->cUnknown++;
+    }
+
+    // Forms: a command string, and an index of command string offsets
+    if ( desPPD.desForms.usFormCount ) {
+        AddRef( pWalk, REF_STRING, offsetof( DESPPD, desForms.ofsFormTable ),
+                desPPD.desForms.ofsFormTable, 0 );
+        cb = pWalk->cRefs;
+        AddRef( pWalk, REF_INDEX, offsetof( DESPPD, desForms.ofsFormIndex ),
+                desPPD.desForms.ofsFormIndex, desPPD.desForms.usFormCount * sizeof( LONG ));
+        if ( pWalk->cRefs > cb ) {
+            plVal = (PLONG)( pWalk->pInfoSeg + desPPD.desForms.ofsFormIndex );
+            for ( i = 0; i < desPPD.desForms.usFormCount; i++ )
+                AddRef( pWalk, REF_STRING, 0, (SHORT) plVal[ i ], 0 );
+        }
+    }
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * StrTableInit                                                              *
+ * ------------------------------------------------------------------------- */
+static BOOL StrTableInit( PVOID pHeap, PSTRTABLE pTable, PBYTE pbBase, ULONG cStrings )
+{
+    pTable->pbBase = pbBase;
+    for ( pTable->cSlots = 16; pTable->cSlots < 2 * cStrings; pTable->cSlots <<= 1 );
+    pTable->pulSlots   = (PULONG) PakAlloc( pHeap, 2 * pTable->cSlots * sizeof( ULONG ));
+    pTable->pulLengths = pTable->pulSlots + pTable->cSlots;
+    if ( !pTable->pulSlots ) return FALSE;
+    memset( pTable->pulSlots, 0, pTable->cSlots * sizeof( ULONG ));
+    return TRUE;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * StrTableFind                                                              *
+ *                                                                           *
+ * Look for a string (of cb bytes, with its null) in the table; if it is not *
+ * there, add it as being at ulNew.                                          *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   Offset of the string in the table, or ulNew if it was added             *
+ * ------------------------------------------------------------------------- */
+static ULONG StrTableFind( PSTRTABLE pTable, PBYTE pbString, ULONG cb, ULONG ulNew )
+{
+    ULONG ulSlot = Pak2HashData( pbString, cb ) & ( pTable->cSlots - 1 );
+
+    while ( pTable->pulSlots[ ulSlot ] ) {
+        if (( pTable->pulLengths[ ulSlot ] == cb ) &&
+            !memcmp( pTable->pbBase + pTable->pulSlots[ ulSlot ] - 1, pbString, cb ))
+            return pTable->pulSlots[ ulSlot ] - 1;
+        ulSlot = ( ulSlot + 1 ) & ( pTable->cSlots - 1 );
+    }
+    pTable->pulSlots[ ulSlot ]   = ulNew + 1;
+    pTable->pulLengths[ ulSlot ] = cb;
+    return ulNew;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakInfoMap                                                                *
+ *                                                                           *
+ * Find which bytes of a printer's information segment are referenced.       *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID             pHeap : Heap to allocate from (or NULL)               *
+ *   PPAK_DEV_DIRENTRY pEntry: Directory entry (for the segment size)        *
+ *   PBYTE             pBuf  : Device segment                                *
+ *   PPAKINFOMAP       pMap  : Receives the map (free with PakInfoMapFree)   *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_INVALID_DATA if the segment is too damaged to find  *
+ *   its information segment, or ERROR_NOT_ENOUGH_MEMORY                     *
+ * ------------------------------------------------------------------------- */
+ULONG PakInfoMap( PVOID pHeap, PPAK_DEV_DIRENTRY pEntry, PBYTE pBuf, PPAKINFOMAP pMap )
+{
+    INFOWALK walk;
+    STRTABLE strings = {0};
+    PINFOREF pRef;
+    ULONG    i, j;
+    APIRET   rc;
+
+    memset( pMap, 0, sizeof( PAKINFOMAP ));
+    if (( rc = WalkSegment( pHeap, pEntry, pBuf, &walk )) != NO_ERROR ) goto cleanup;
+
+    pMap->cbInfo   = walk.cbInfo;
+    pMap->cbTail   = pEntry->ulSize - walk.cbDS - walk.cbInfo;
+    pMap->cUnknown = walk.cUnknown;
+    pMap->pulUsed  = (PULONG) PakAlloc( pHeap, MAP_WORDS( walk.cbInfo ) * sizeof( ULONG ) + 1 );
+    if ( !pMap->pulUsed || !StrTableInit( pHeap, &strings, walk.pInfoSeg, walk.cRefs )) {
+        rc = ERROR_NOT_ENOUGH_MEMORY;
+        goto cleanup;
+    }
+    memset( pMap->pulUsed, 0, MAP_WORDS( walk.cbInfo ) * sizeof( ULONG ));
+
+    // The string at offset 0 is always kept (see above)
+    if ( walk.cbInfo ) {
+        for ( j = 0; j < walk.cbInfo; j++ ) {
+            MAP_SET( pMap->pulUsed, j );
+            if ( !walk.pInfoSeg[ j ] ) break;
+        }
+    }
+
+    // A string is a duplicate if the same text was referenced at another offset
+    for ( i = 0, pRef = walk.pRefs; i < walk.cRefs; i++, pRef++ ) {
+        if (( pRef->usType == REF_STRING ) && !MAP_TEST( pMap->pulUsed, pRef->ulOff ) &&
+            ( StrTableFind( &strings, walk.pInfoSeg + pRef->ulOff, pRef->cb, pRef->ulOff ) != pRef->ulOff ))
+            pMap->cbDuplicate += pRef->cb;
+        for ( j = pRef->ulOff; j < pRef->ulOff + pRef->cb; j++ )
+            MAP_SET( pMap->pulUsed, j );
+    }
+    for ( j = 0; j < walk.cbInfo; j++ )
+        if ( MAP_TEST( pMap->pulUsed, j )) pMap->cbUsed++;
+
+cleanup:
+    PakFree( pHeap, strings.pulSlots );
+    PakFree( pHeap, walk.pRefs );
+    if ( rc ) PakInfoMapFree( pHeap, pMap );
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakInfoMapFree                                                            *
+ * ------------------------------------------------------------------------- */
+VOID PakInfoMapFree( PVOID pHeap, PPAKINFOMAP pMap )
+{
+    PakFree( pHeap, pMap->pulUsed );
+    pMap->pulUsed = NULL;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakInfoCompact                                                            *
+ *                                                                           *
+ * Rebuild a device segment with an information segment holding only the     *
+ * bytes referenced, each distinct string once, updating every offset.  The  *
+ * descriptor segment keeps its layout; anything after the information       *
+ * segment is dropped.                                                       *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID             pHeap : Heap to allocate from (or NULL)               *
+ *   PPAK_DEV_DIRENTRY pEntry: Directory entry (for the segment size)        *
+ *   PBYTE             pBuf  : Device segment                                *
+ *   PBYTE            *ppNew : Receives the new segment (free with PakFree)  *
+ *   PULONG            pcbNew: Receives its size                             *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success; ERROR_INVALID_DATA if the segment has references which    *
+ *   cannot be followed (and so cannot safely be compacted); or              *
+ *   ERROR_NOT_ENOUGH_MEMORY                                                 *
+ * ------------------------------------------------------------------------- */
+ULONG PakInfoCompact( PVOID pHeap, PPAK_DEV_DIRENTRY pEntry, PBYTE pBuf, PBYTE *ppNew,
+                      PULONG pcbNew )
+{
+    INFOWALK walk;
+    STRTABLE strings = {0};
+    PINFOREF pRef,
+             pPrev;
+    PBYTE    pbNew = NULL,
+             pbInfo;
+    PLONG    plOld,
+             plNew;
+    PBYTE    pbEnd;
+    ULONG    cbMax,
+             cbNew = 0,
+             ulNew,
+             cb, i, j;
+    APIRET   rc;
+
+    *ppNew = NULL;
+    if (( rc = WalkSegment( pHeap, pEntry, pBuf, &walk )) != NO_ERROR ) goto cleanup;
+    if ( walk.cUnknown ) {
+        rc = ERROR_INVALID_DATA;
+        goto cleanup;
+    }
+
+    // The new segment can be no larger than the string at 0 plus every reference
+    cbMax = 1;
+    if ( walk.cbInfo ) {
+        if (( pbEnd = (PBYTE) memchr( walk.pInfoSeg, 0, walk.cbInfo )) == NULL ) {
+            rc = ERROR_INVALID_DATA;
+            goto cleanup;
+        }
+        cbMax = pbEnd - walk.pInfoSeg + 1;
+    }
+    for ( i = 0; i < walk.cRefs; i++ ) cbMax += walk.pRefs[ i ].cb;
+    if (( pbNew = (PBYTE) PakAlloc( pHeap, walk.cbDS + cbMax )) == NULL ||
+        !StrTableInit( pHeap, &strings, pbNew + walk.cbDS, walk.cRefs ))
+    {
+        rc = ERROR_NOT_ENOUGH_MEMORY;
+        goto cleanup;
+    }
+    memcpy( pbNew, pBuf, walk.cbDS );
+    pbInfo = pbNew + walk.cbDS;
+
+    if ( walk.cbInfo ) {
+        cbNew = pbEnd - walk.pInfoSeg + 1;
+        memcpy( pbInfo, walk.pInfoSeg, cbNew );
+    }
+
+    // Tables first (in their original order), each copied once even if
+    // referenced twice, then the strings
+    for ( i = 0, pRef = walk.pRefs; i < walk.cRefs; i++, pRef++ ) {
+        if ( pRef->usType == REF_STRING ) continue;
+        for ( j = 0, pPrev = walk.pRefs; j < i; j++, pPrev++ )
+            if (( pPrev->usType == pRef->usType ) && ( pPrev->ulOff == pRef->ulOff ) &&
+                ( pPrev->cb == pRef->cb )) break;
+        if ( j < i )
+            ulNew = DES_SHORT( pbNew, pPrev->usField );
+        else {
+            ulNew = cbNew;
+            memcpy( pbInfo + cbNew, walk.pInfoSeg + pRef->ulOff, pRef->cb );
+            cbNew += pRef->cb;
+        }
+        DES_SHORT( pbNew, pRef->usField ) = (SHORT) ulNew;
+    }
+    for ( i = 0, pRef = walk.pRefs; i < walk.cRefs; i++, pRef++ ) {
+        if ( pRef->usType != REF_STRING ) continue;
+        ulNew = StrTableFind( &strings, walk.pInfoSeg + pRef->ulOff, pRef->cb, cbNew );
+        if ( ulNew == cbNew ) {
+            memcpy( pbInfo + cbNew, walk.pInfoSeg + pRef->ulOff, pRef->cb );
+            cbNew += pRef->cb;
+        }
+        if ( pRef->usField ) DES_SHORT( pbNew, pRef->usField ) = (SHORT) ulNew;
+    }
+
+    // The forms index holds the offsets of its strings, which have moved
+    for ( i = 0, pRef = walk.pRefs; i < walk.cRefs; i++, pRef++ ) {
+        if ( pRef->usType != REF_INDEX ) continue;
+        plOld = (PLONG)( walk.pInfoSeg + pRef->ulOff );
+        plNew = (PLONG)( pbInfo + DES_SHORT( pbNew, pRef->usField ));
+        for ( j = 0; j < pRef->cb / sizeof( LONG ); j++ ) {
+            if ( (SHORT) plOld[ j ] <= 0 ) continue;
+            cb = strlen( (PSZ)( walk.pInfoSeg + (SHORT) plOld[ j ] )) + 1;
+            plNew[ j ] = StrTableFind( &strings, walk.pInfoSeg + (SHORT) plOld[ j ], cb, cbNew );
+        }
+        break;
+    }
+
+    if ( cbNew > INFO_MAX_SIZE ) {
+        rc = ERROR_INVALID_DATA;
+        goto cleanup;
+    }
+    ((PDESPPD) pbNew)->desItems.iSizeBuffer = (SHORT) cbNew;
+    *ppNew  = pbNew;
+    *pcbNew = walk.cbDS + cbNew;
+    pbNew   = NULL;
+
+cleanup:
+    PakFree( pHeap, pbNew );
+    PakFree( pHeap, strings.pulSlots );
+    PakFree( pHeap, walk.pRefs );
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakCompactImage                                                           *
+ *                                                                           *
+ * Compact every printer of a V1 device PAK file held in memory, producing   *
+ * a new image.  Everything before the first segment (the signature and      *
+ * directory) is kept; the segments follow it in their original order, each  *
+ * compacted unless that is not safe or would not make it smaller.  Entries  *
+ * which share a segment continue to share it.  Bytes between or after the   *
+ * segments are dropped.                                                     *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID  pHeap       : Heap to allocate from (or NULL)                    *
+ *   PBYTE  pbFile      : The PAK file                                       *
+ *   ULONG  cbFile      : Its size                                           *
+ *   PBYTE *ppbOut      : Receives the new file (free with PakFree)          *
+ *   PULONG pcbOut      : Receives its size                                  *
+ *   PULONG pcCompacted : Receives the number of entries compacted           *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_INVALID_DATA if the image is not a valid V1 device  *
+ *   PAK file, or ERROR_NOT_ENOUGH_MEMORY                                    *
+ * ------------------------------------------------------------------------- */
+ULONG PakCompactImage( PVOID pHeap, PBYTE pbFile, ULONG cbFile, PBYTE *ppbOut, PULONG pcbOut,
+                       PULONG pcCompacted )
+{
+    PPAKSIGNATURE     pSig = (PPAKSIGNATURE) pbFile;
+    PPAK_DEV_DIRENTRY pDir,
+                      pOutDir;
+    PULONG            pulOrder = NULL;
+    PBYTE             pbOut = NULL,
+                      pbSeg;
+    ULONG             cEntries,
+                      ulHeader,
+                      ulPos,
+                      cbSeg,
+                      i, j, k;
+    APIRET            rc = NO_ERROR;
+
+    *ppbOut = NULL;
+    *pcCompacted = 0;
+    if (( cbFile < sizeof( PAKSIGNATURE )) ||
+        ( strncmp( pSig->szName, PAKSIGNATURE_DEVPACK_V1, sizeof( pSig->szName )) != 0 ) ||
+        ( pSig->iEntries < 0 ) ||
+        ( sizeof( PAKSIGNATURE ) + pSig->iEntries * sizeof( PAK_DEV_DIRENTRY ) > cbFile ))
+        return ERROR_INVALID_DATA;
+    cEntries = pSig->iEntries;
+    pDir     = (PPAK_DEV_DIRENTRY)( pbFile + sizeof( PAKSIGNATURE ));
+
+    // The header runs up to the first segment
+    ulHeader = cbFile;
+    for ( i = 0; i < cEntries; i++ ) {
+        if (( pDir[ i ].ulOffset > cbFile ) || ( pDir[ i ].ulSize > cbFile - pDir[ i ].ulOffset ) ||
+            ( pDir[ i ].ulOffset < sizeof( PAKSIGNATURE ) + cEntries * sizeof( PAK_DEV_DIRENTRY )))
+            return ERROR_INVALID_DATA;
+        if ( pDir[ i ].ulOffset < ulHeader ) ulHeader = pDir[ i ].ulOffset;
+    }
+    if ( !cEntries ) ulHeader = sizeof( PAKSIGNATURE );
+
+    // Segments are written in file order; no output can exceed the input
+    if (( pulOrder = (PULONG) PakAlloc( pHeap, cEntries * sizeof( ULONG ) + 1 )) == NULL ||
+        ( pbOut = (PBYTE) PakAlloc( pHeap, cbFile )) == NULL )
+    {
+        rc = ERROR_NOT_ENOUGH_MEMORY;
+        goto cleanup;
+    }
+    for ( i = 0; i < cEntries; i++ ) {
+        for ( j = i; j > 0 && pDir[ pulOrder[ j - 1 ]].ulOffset > pDir[ i ].ulOffset; j-- )
+            pulOrder[ j ] = pulOrder[ j - 1 ];
+        pulOrder[ j ] = i;
+    }
+    memcpy( pbOut, pbFile, ulHeader );
+    pOutDir = (PPAK_DEV_DIRENTRY)( pbOut + sizeof( PAKSIGNATURE ));
+
+    ulPos = ulHeader;
+    for ( k = 0; k < cEntries; k++ ) {
+        i = pulOrder[ k ];
+        if (( k > 0 ) && ( pDir[ pulOrder[ k - 1 ]].ulOffset == pDir[ i ].ulOffset ) &&
+                         ( pDir[ pulOrder[ k - 1 ]].ulSize == pDir[ i ].ulSize ))
+        {
+            pOutDir[ i ].ulOffset = pOutDir[ pulOrder[ k - 1 ]].ulOffset;
+            pOutDir[ i ].ulSize   = pOutDir[ pulOrder[ k - 1 ]].ulSize;
+            continue;
+        }
+        rc = PakInfoCompact( pHeap, pDir + i, pbFile + pDir[ i ].ulOffset, &pbSeg, &cbSeg );
+        if ( rc == ERROR_NOT_ENOUGH_MEMORY ) goto cleanup;
+        rc = NO_ERROR;
+        if ( !pbSeg || cbSeg >= pDir[ i ].ulSize ) cbSeg = pDir[ i ].ulSize;
+        if ( cbSeg > cbFile - ulPos ) {
+            // Only segments which overlap in the input can get here
+            PakFree( pHeap, pbSeg );
+            rc = ERROR_INVALID_DATA;
+            goto cleanup;
+        }
+        if ( pbSeg && cbSeg < pDir[ i ].ulSize ) {
+            memcpy( pbOut + ulPos, pbSeg, cbSeg );
+            (*pcCompacted)++;
+        }
+        else
+            memcpy( pbOut + ulPos, pbFile + pDir[ i ].ulOffset, cbSeg );
+        PakFree( pHeap, pbSeg );
+        pOutDir[ i ].ulOffset = ulPos;
+        pOutDir[ i ].ulSize   = cbSeg;
+        ulPos += cbSeg;
+    }
+    *ppbOut = pbOut;
+    *pcbOut = ulPos;
+    pbOut   = NULL;
+
+cleanup:
+    PakFree( pHeap, pbOut );
+    PakFree( pHeap, pulOrder );
+    return rc;
+}
@@ -0,0 +1,272 @@
+/*
+ * pakjob.c
+ *
+ * PAKTOOL library: job ticket templates.  See paklib.h for an overview.
+ *
+ * The code of each option is stored in the pool in matrix row order (see
+ * pakuic.c), followed by the three JCL strings, so that the length of each
+ * string is simply the difference between its offset and the next one.
+ */
+
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+
+// Indexes of the location groups, in the order they are sent
+#define GROUP_JCL           0       // JCLSetup
+#define GROUP_EXITSERVER    1       // ExitServer
+#define GROUP_PROLOG        2       // Prolog
+#define GROUP_DOCSETUP      3       // DocumentSetup and AnySetup
+#define GROUP_PAGESETUP     4       // PageSetup
+
+// Indexes of the JCL strings after the option code in pulCode
+#define JCL_BEGIN           0
+#define JCL_TOPS            1
+#define JCL_END             2
+
+
+/* ------------------------------------------------------------------------- *
+ * JobGroup                                                                  *
+ *                                                                           *
+ * Return the location group of a UI block.  Like GeneratePPD(), this treats *
+ * unknown locations as AnySetup.                                            *
+ * ------------------------------------------------------------------------- */
+static ULONG JobGroup( PUI_BLOCK puib )
+{
+    switch ( puib->usUILocation ) {
+        case UI_ORDER_JCLSETUP   : return GROUP_JCL;
+        case UI_ORDER_EXITSERVER : return GROUP_EXITSERVER;
+        case UI_ORDER_PROLOGSETUP: return GROUP_PROLOG;
+        case UI_ORDER_PAGESETUP  : return GROUP_PAGESETUP;
+        default                  : return GROUP_DOCSETUP;
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * AddString                                                                 *
+ *                                                                           *
+ * Decompress a string from the information segment and append it to the     *
+ * pool.  Nothing is added if the offset is not that of a valid string, or   *
+ * if the string would not fit the scratch buffer.                           *
+ * ------------------------------------------------------------------------- */
+static VOID AddString( PPAKJOB pJob, PPAKARENA pArena, LONG lOff, BOOL fZeroOk,
+                       PBYTE pScratch, ULONG cbScratch )
+{
+    PPAKUIC pUic = pJob->pUic;
+    USHORT  cb;
+
+    if (( lOff < 0 ) || ( !lOff && !fZeroOk ) || ( (ULONG) lOff >= pUic->cbInfo ) ||
+        !memchr( pUic->pInfoSeg + lOff, 0, pUic->cbInfo - lOff ) ||
+        ( DecompressedLength( pArena ? pArena->pDict : NULL,
+                              (PSZ)( pUic->pInfoSeg + lOff )) >= (LONG) cbScratch ))
+        return;
+    cb = ExpandString( pArena, (PSZ)( pUic->pInfoSeg + lOff ), pScratch );
+    OutWrite( &pJob->pool, pScratch, cb );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakJobBuild                                                               *
+ *                                                                           *
+ * Build the job ticket template for a device segment.                       *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID     pHeap : Heap to allocate from (or NULL)                       *
+ *   PPAKARENA pArena: Arena giving the dictionary and string map to use for *
+ *                     decompression (or NULL for the built-in dictionary)   *
+ *   PBYTE     pBuf  : Device segment (must stay in memory while the         *
+ *                     template is used)                                     *
+ *   ULONG     cbBuf : Size of the segment                                   *
+ *   PPAKJOB  *ppJob : Receives the template (free with PakJobFree)          *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_INVALID_DATA if the UI lists do not fit the         *
+ *   segment, or ERROR_NOT_ENOUGH_MEMORY                                     *
+ * ------------------------------------------------------------------------- */
+ULONG PakJobBuild( PVOID pHeap, PPAKARENA pArena, PBYTE pBuf, ULONG cbBuf, PPAKJOB *ppJob )
+{
+    DESPPD    desPPD;
+    PPAKJOB   pJob;
+    PPAKUIC   pUic;
+    PUI_BLOCK puib;
+    PBYTE     pScratch;
+    ULONG     cbScratch,
+              cb,
+              b, e, g, i, j, n;
+    APIRET    rc;
+
+    *ppJob = NULL;
+    if (( rc = PakUicBuild( pHeap, pBuf, cbBuf, &pUic )) != NO_ERROR )
+        return rc;
+    memcpy( &desPPD, pBuf, sizeof( DESPPD ));
+
+    cb = sizeof( PAKJOB ) + pUic->cBlocks * ( sizeof( UI_SEL ) + sizeof( ULONG )) +
+         ( pUic->cOptions + JCL_END + 2 ) * sizeof( ULONG );
+    cbScratch = ( desPPD.desItems.iSizeBuffer > 0 ) ? desPPD.desItems.iSizeBuffer : 0;
+    pJob      = (PPAKJOB) PakAlloc( pHeap, cb );
+    pScratch  = (PBYTE) PakAlloc( pHeap, cbScratch + 1 );
+    if ( !pJob || !pScratch ) {
+        PakFree( pHeap, pScratch );
+        PakFree( pHeap, pJob );
+        PakUicFree( pHeap, pUic );
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+    memset( pJob, 0, cb );
+    pJob->pUic       = pUic;
+    pJob->pDefaults  = (PUI_SEL)( pJob + 1 );
+    pJob->pulOrder   = (PULONG)( pJob->pDefaults + pUic->cBlocks );
+    pJob->pulCode    = pJob->pulOrder + pUic->cBlocks;
+    pJob->pool.pHeap = pHeap;
+    PakUicDefaults( pUic, pJob->pDefaults );
+
+    // Sort the blocks into groups, each ordered (stably) by OrderDependency
+    for ( g = 0, i = 0; g < PAKJOB_GROUPS; g++ ) {
+        pJob->aulGroup[ g ] = i;
+        for ( b = 0; b < pUic->cBlocks; b++ ) {
+            puib = pUic->apBlocks[ b ];
+            if ( JobGroup( puib ) != g ) continue;
+            for ( j = i; ( j > pJob->aulGroup[ g ] ) &&
+                         ( pUic->apBlocks[ pJob->pulOrder[ j - 1 ]]->usOrderDep > puib->usOrderDep ); j-- )
+                pJob->pulOrder[ j ] = pJob->pulOrder[ j - 1 ];
+            pJob->pulOrder[ j ] = b;
+            i++;
+        }
+    }
+    pJob->aulGroup[ PAKJOB_GROUPS ] = i;
+
+    // Decompress the code of every option, then the JCL strings
+    for ( b = 0, i = 0; b < pUic->cBlocks; b++ ) {
+        puib = pUic->apBlocks[ b ];
+        n = ( puib->usNumOfEntries < 32 ) ? puib->usNumOfEntries : 32;
+        for ( e = 0; e < n; e++ ) {
+            pJob->pulCode[ i++ ] = pJob->pool.cbData;
+            AddString( pJob, pArena, puib->uiEntry[ e ].ofsValue, FALSE, pScratch, cbScratch );
+        }
+    }
+    pJob->pulCode[ i++ ] = pJob->pool.cbData;
+    AddString( pJob, pArena, desPPD.desItems.ofsInitString, TRUE, pScratch, cbScratch );
+    pJob->pulCode[ i++ ] = pJob->pool.cbData;
+    AddString( pJob, pArena, desPPD.desItems.ofsJCLToPS, TRUE, pScratch, cbScratch );
+    pJob->pulCode[ i++ ] = pJob->pool.cbData;
+    AddString( pJob, pArena, desPPD.desItems.ofsTermString, TRUE, pScratch, cbScratch );
+    pJob->pulCode[ i ] = pJob->pool.cbData;
+    PakFree( pHeap, pScratch );
+
+    if ( pJob->pool.fError ) {
+        PakJobFree( pHeap, pJob );
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+    *ppJob = pJob;
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- */
+VOID PakJobFree( PVOID pHeap, PPAKJOB pJob )
+{
+    if ( !pJob ) return;
+    OutFree( &pJob->pool );
+    PakUicFree( pHeap, pJob->pUic );
+    PakFree( pHeap, pJob );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * WriteCode                                                                 *
+ *                                                                           *
+ * Write one string from the pool, optionally followed by a newline if it    *
+ * does not already end with one.                                            *
+ * ------------------------------------------------------------------------- */
+static VOID WriteCode( PPAKJOB pJob, ULONG ulIndex, BOOL fNewLine, POUTBUF pOut )
+{
+    PBYTE pb = pJob->pool.pbData + pJob->pulCode[ ulIndex ];
+    ULONG cb = pJob->pulCode[ ulIndex + 1 ] - pJob->pulCode[ ulIndex ];
+
+    if ( !cb ) return;
+    OutWrite( pOut, pb, cb );
+    if ( fNewLine && pb[ cb - 1 ] != '\n' && pb[ cb - 1 ] != '\r')
+        OutWrite( pOut, "\n", 1 );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * WriteGroup                                                                *
+ *                                                                           *
+ * Write the code of the selected options of every block in a group.  Except *
+ * in the JCL group, each option is enclosed in DSC feature comments.        *
+ * ------------------------------------------------------------------------- */
+static VOID WriteGroup( PPAKJOB pJob, ULONG ulGroup, PUI_SEL pSel, POUTBUF pOut )
+{
+    PPAKUIC   pUic = pJob->pUic;
+    PUI_BLOCK puib;
+    ULONG     i, b, e, n, ulRow;
+
+    for ( i = pJob->aulGroup[ ulGroup ]; i < pJob->aulGroup[ ulGroup + 1 ]; i++ ) {
+        b    = pJob->pulOrder[ i ];
+        puib = pUic->apBlocks[ b ];
+        n    = ( puib->usNumOfEntries < 32 ) ? puib->usNumOfEntries : 32;
+        for ( e = 0; e < n; e++ ) {
+            if ( !( pSel[ b ] & ( 1UL << e ))) continue;
+            ulRow = pUic->pulFirstRow[ b ] + e;
+            if ( pJob->pulCode[ ulRow + 1 ] == pJob->pulCode[ ulRow ] ) continue;
+            if ( ulGroup == GROUP_JCL )
+                WriteCode( pJob, ulRow, TRUE, pOut );
+            else {
+                OutPrintf( pOut, "%%%%BeginFeature: *%s %s\n",
+                           PakUicKeyword( pUic, b ), PakUicOption( pUic, b, e ));
+                WriteCode( pJob, ulRow, TRUE, pOut );
+                OutPrintf( pOut, "%%%%EndFeature\n");
+            }
+        }
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakJobRender                                                              *
+ *                                                                           *
+ * Write the setup code for a selection of options, as the driver sends it:  *
+ * JCLBegin, the JCLSetup code and JCLToPSInterpreter (if the printer has    *
+ * JCL); then the PostScript header, with the ExitServer and Prolog code in  *
+ * the prolog, the DocumentSetup and AnySetup code in the document setup,    *
+ * and the PageSetup code in the page setup; and lastly JCLEnd.  The page    *
+ * contents would go between the page setup and JCLEnd.                      *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAKJOB pJob: Job ticket template                                       *
+ *   PUI_SEL pSel: Selection vector (or NULL for the printer's defaults)     *
+ *   POUTBUF pOut: Output buffer (NULL for STDOUT)                           *
+ *                                                                           *
+ * RETURNS: N/A                                                              *
+ * ------------------------------------------------------------------------- */
+VOID PakJobRender( PPAKJOB pJob, PUI_SEL pSel, POUTBUF pOut )
+{
+    ULONG ulJCL = pJob->pUic->cOptions;
+    BOOL  fJCL  = ( pJob->pulCode[ ulJCL + JCL_BEGIN + 1 ] > pJob->pulCode[ ulJCL + JCL_BEGIN ] );
+
+    if ( !pSel ) pSel = pJob->pDefaults;
+    if ( fJCL ) {
+        WriteCode( pJob, ulJCL + JCL_BEGIN, FALSE, pOut );
+        WriteGroup( pJob, GROUP_JCL, pSel, pOut );
+        WriteCode( pJob, ulJCL + JCL_TOPS, FALSE, pOut );
+    }
+    OutPrintf( pOut, "%%!PS-Adobe-3.0\n");
+    OutPrintf( pOut, "%%%%BeginProlog\n");
+    WriteGroup( pJob, GROUP_EXITSERVER, pSel, pOut );
+    WriteGroup( pJob, GROUP_PROLOG, pSel, pOut );
+    OutPrintf( pOut, "%%%%EndProlog\n");
+    OutPrintf( pOut, "%%%%BeginSetup\n");
+    WriteGroup( pJob, GROUP_DOCSETUP, pSel, pOut );
+    OutPrintf( pOut, "%%%%EndSetup\n");
+    OutPrintf( pOut, "%%%%BeginPageSetup\n");
+    WriteGroup( pJob, GROUP_PAGESETUP, pSel, pOut );
+    OutPrintf( pOut, "%%%%EndPageSetup\n");
+    if ( fJCL )
+        WriteCode( pJob, ulJCL + JCL_END, FALSE, pOut );
+}
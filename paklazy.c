@@ -0,0 +1,434 @@
+/*
+ * paklazy.c
+ *
+ * PAKTOOL library: field queries which read only what they need.
+ *
+ * Formatting a printer loads its whole segment, although most questions
+ * about it ("what is its ModelName?") need only the DESPPD and a string or
+ * two.  PakLazyOpen() reads just the DESPPD; the UI list is read only when
+ * a UI keyword is asked for, and the information segment a page at a time
+ * as the strings in it are needed.  All reads are positioned reads on a
+ * handle which the caller keeps open, so that a query over every printer in
+ * a PAK file touches the directory, each DESPPD and a page or two of each
+ * information segment, instead of the whole file.
+ */
+
+#define INCL_DOSFILEMGR
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+
+#define PAGE_TEST( p, i )   ( (p)[ (i) / 32 ] &  ( 1UL << ( (i) % 32 )))
+#define PAGE_SET( p, i )    ( (p)[ (i) / 32 ] |= ( 1UL << ( (i) % 32 )))
+
+// PPD main keywords answered from the DESPPD alone (cf. GeneratePPD)
+#define LK_PRODUCT          1
+#define LK_MODELNAME        2
+#define LK_PCFILENAME       3
+#define LK_PSVERSION        4
+#define LK_LANGUAGELEVEL    5
+#define LK_COLORDEVICE      6
+#define LK_FILESYSTEM       7
+#define LK_THROUGHPUT       8
+#define LK_FREEVM           9
+#define LK_PASSWORD         10
+#define LK_SCREENANGLE      11
+#define LK_SCREENFREQ       12
+#define LK_VARIABLEPAPER    13
+#define LK_OUTPUTORDER      14
+#define LK_DEFAULTFONT      15
+
+typedef struct _LAZYKEY
+{
+    PSZ    pszKeyword;
+    USHORT usKey;
+} LAZYKEY;
+
+static LAZYKEY aLazyKeys[] = {
+    { "Product",            LK_PRODUCT },
+    { "ModelName",          LK_MODELNAME },
+    { "ShortNickName",      LK_MODELNAME },
+    { "NickName",           LK_MODELNAME },
+    { "PCFileName",         LK_PCFILENAME },
+    { "PSVersion",          LK_PSVERSION },
+    { "LanguageLevel",      LK_LANGUAGELEVEL },
+    { "ColorDevice",        LK_COLORDEVICE },
+    { "FileSystem",         LK_FILESYSTEM },
+    { "Throughput",         LK_THROUGHPUT },
+    { "FreeVM",             LK_FREEVM },
+    { "Password",           LK_PASSWORD },
+    { "ScreenAngle",        LK_SCREENANGLE },
+    { "ScreenFreq",         LK_SCREENFREQ },
+    { "VariablePaperSize",  LK_VARIABLEPAPER },
+    { "DefaultOutputOrder", LK_OUTPUTORDER },
+    { "DefaultFont",        LK_DEFAULTFONT },
+    { NULL,                 0 }
+};
+
+
+/* ------------------------------------------------------------------------- *
+ * ReadAt                                                                    *
+ *                                                                           *
+ * Read part of the segment, counting the bytes read.                        *
+ * ------------------------------------------------------------------------- */
+static ULONG ReadAt( PPAKLAZY pLazy, ULONG ulPos, PVOID pb, ULONG cb )
+{
+    ULONG  ulResult;
+    APIRET rc;
+
+    rc = DosSetFilePtr( pLazy->hf, pLazy->ulOffset + ulPos, FILE_BEGIN, &ulResult );
+    if ( !rc ) rc = DosRead( pLazy->hf, pb, cb, &ulResult );
+    if ( !rc && ulResult < cb ) rc = ERROR_HANDLE_EOF;
+    if ( !rc ) pLazy->cbRead += cb;
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakLazyOpenFile                                                           *
+ *                                                                           *
+ * Open a PAK file for the positioned reads of PakLazyOpen() and the other   *
+ * PakLazy*() functions.                                                     *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ    pszPakFile: Name of the PAK file (V1 or V2)                      *
+ *   PHFILE phf       : Receives the file handle; close it with DosClose()   *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, otherwise an OS/2 error code                              *
+ * ------------------------------------------------------------------------- */
+ULONG PakLazyOpenFile( PSZ pszPakFile, PHFILE phf )
+{
+    ULONG ulAction;
+
+    return DosOpen( pszPakFile, phf, &ulAction, 0, 0,
+                    OPEN_ACTION_FAIL_IF_NEW | OPEN_ACTION_OPEN_IF_EXISTS,
+                    OPEN_FLAGS_FAIL_ON_ERROR | OPEN_FLAGS_RANDOM |
+                    OPEN_SHARE_DENYNONE | OPEN_ACCESS_READONLY, NULL );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakLazyOpen                                                               *
+ *                                                                           *
+ * Start a query on one printer by reading its DESPPD, and locate its lists  *
+ * and information segment (without reading them).                           *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID             pHeap : Heap for the pages read later (or NULL)       *
+ *   HFILE             hf    : PAK file, from PakLazyOpenFile()              *
+ *   PPAK_DEV_DIRENTRY pEntry: Directory entry of the printer (with the file *
+ *                             offset of its segment)                        *
+ *   PPAKLAZY          pLazy : Receives the query state; free it with        *
+ *                             PakLazyClose() even if this fails             *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_INVALID_DATA if the DESPPD does not fit the         *
+ *   segment, otherwise an OS/2 error code                                   *
+ * ------------------------------------------------------------------------- */
+ULONG PakLazyOpen( PVOID pHeap, HFILE hf, PPAK_DEV_DIRENTRY pEntry, PPAKLAZY pLazy )
+{
+    APIRET rc;
+
+    memset( pLazy, 0, sizeof( PAKLAZY ));
+    pLazy->pHeap    = pHeap;
+    pLazy->hf       = hf;
+    pLazy->ulOffset = pEntry->ulOffset;
+    pLazy->ulSize   = pEntry->ulSize;
+    if ( pEntry->ulSize < sizeof( DESPPD )) return ERROR_INVALID_DATA;
+    if (( rc = ReadAt( pLazy, 0, &(pLazy->desPPD), sizeof( DESPPD ))) != NO_ERROR )
+        return rc;
+
+    pLazy->ulInfo = sizeof( DESPPD ) + pLazy->desPPD.stUIList.usBlockListSize +
+                    pLazy->desPPD.stUICList.usNumOfUICs * sizeof( UIC_BLOCK );
+    if (( pLazy->ulInfo > pEntry->ulSize ) || ( pLazy->desPPD.desItems.iSizeBuffer < 0 ))
+        return ERROR_INVALID_DATA;
+    pLazy->cbInfo = pEntry->ulSize - pLazy->ulInfo;
+    if ( (ULONG) pLazy->desPPD.desItems.iSizeBuffer < pLazy->cbInfo )
+        pLazy->cbInfo = pLazy->desPPD.desItems.iSizeBuffer;
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakLazyString                                                             *
+ *                                                                           *
+ * Get a string from the information segment, reading the pages it lies in   *
+ * if they have not been read already.                                       *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAKLAZY pLazy: Query state                                             *
+ *   LONG     lOff : Offset of the string in the information segment         *
+ *                                                                           *
+ * RETURNS: PSZ                                                              *
+ *   The string (valid until PakLazyClose()), or NULL if the offset is       *
+ *   negative, the string is not terminated within the information segment,  *
+ *   or it could not be read                                                 *
+ * ------------------------------------------------------------------------- */
+PSZ PakLazyString( PPAKLAZY pLazy, LONG lOff )
+{
+    ULONG ulPage,
+          ulStart,
+          ulFrom,
+          cb;
+
+    if (( lOff < 0 ) || ( (ULONG) lOff >= pLazy->cbInfo )) return NULL;
+    if ( !pLazy->pbInfo &&
+         ( pLazy->pbInfo = (PBYTE) PakAlloc( pLazy->pHeap, pLazy->cbInfo )) == NULL )
+        return NULL;
+
+    for ( ulPage = lOff / PAKLAZY_PAGE; ; ulPage++ ) {
+        ulStart = ulPage * PAKLAZY_PAGE;
+        if ( ulStart >= pLazy->cbInfo ) return NULL;
+        cb = ( pLazy->cbInfo - ulStart > PAKLAZY_PAGE ) ? PAKLAZY_PAGE : pLazy->cbInfo - ulStart;
+        if ( !PAGE_TEST( pLazy->aulPages, ulPage )) {
+            if ( ReadAt( pLazy, pLazy->ulInfo + ulStart, pLazy->pbInfo + ulStart, cb ))
+                return NULL;
+            PAGE_SET( pLazy->aulPages, ulPage );
+        }
+        ulFrom = ( (ULONG) lOff > ulStart ) ? lOff : ulStart;
+        if ( memchr( pLazy->pbInfo + ulFrom, 0, ulStart + cb - ulFrom ))
+            return (PSZ)( pLazy->pbInfo + lOff );
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * FindBlock                                                                 *
+ *                                                                           *
+ * Find a UI block by name, reading the UI list if need be.  Returns NULL if *
+ * there is no such block (or the list could not be read).                   *
+ * ------------------------------------------------------------------------- */
+static PUI_BLOCK FindBlock( PPAKLAZY pLazy, PSZ pszName )
+{
+    PUI_BLOCK puib;
+    PSZ       psz;
+    ULONG     cbList = pLazy->desPPD.stUIList.usBlockListSize,
+              cb,
+              i;
+
+    if ( !pLazy->pbUIList ) {
+        if ( !cbList ) return NULL;
+        if (( pLazy->pbUIList = (PBYTE) PakAlloc( pLazy->pHeap, cbList )) == NULL )
+            return NULL;
+        if ( ReadAt( pLazy, sizeof( DESPPD ), pLazy->pbUIList, cbList )) {
+            PakFree( pLazy->pHeap, pLazy->pbUIList );
+            pLazy->pbUIList = NULL;
+            return NULL;
+        }
+    }
+
+    puib = (PUI_BLOCK) pLazy->pbUIList;
+    for ( i = 0; i < pLazy->desPPD.stUIList.usNumOfBlocks; i++ ) {
+        if (( cbList < UI_BLOCK_FIXED ) ||
+            (( cb = UI_BLOCK_FIXED + puib->usNumOfEntries * sizeof( UI_ENTRY )) > cbList ))
+            break;
+        if ((( psz = PakLazyString( pLazy, (SHORT) puib->ofsUIName )) != NULL ) &&
+            ( strcmp( psz, pszName ) == 0 ))
+            return puib;
+        puib    = (PUI_BLOCK)((PBYTE) puib + cb );
+        cbList -= cb;
+    }
+    return NULL;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * OptionName                                                                *
+ *                                                                           *
+ * Get the name of one of a UI block's options, or "(none)" if it has none   *
+ * (cf. OFFSET_TO_PSZ).  Returns NULL if the name cannot be read.            *
+ * ------------------------------------------------------------------------- */
+static PSZ OptionName( PPAKLAZY pLazy, PUI_BLOCK puib, USHORT usEntry )
+{
+    SHORT sOff = (SHORT) puib->uiEntry[ usEntry ].ofsOption;
+
+    return ( sOff > 0 ) ? PakLazyString( pLazy, sOff ) : "(none)";
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakLazyField                                                              *
+ *                                                                           *
+ * Write the value of one field of a printer, reading no more of its segment *
+ * than that needs.  The field may be:                                       *
+ *   - a PPD main keyword which the DESPPD determines (e.g. ModelName or     *
+ *     LanguageLevel), written as GeneratePPD() writes it;                   *
+ *   - Default<keyword> for a UI keyword (e.g. DefaultResolution), giving    *
+ *     the default option as GeneratePPD() does;                             *
+ *   - the name of a DESPPD field in the PakFieldTable() form (e.g.          *
+ *     desItems.iResDpi), giving its value, or the string it refers to.      *
+ * A leading '*' is ignored.                                                 *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAKLAZY pLazy     : Query state, from PakLazyOpen()                    *
+ *   PSZ      pszKeyword: Field to write                                     *
+ *   PPAKDICT pDict     : Keyword dictionary for commands (NULL for built-in)*
+ *   POUTBUF  pOut      : Output buffer, or NULL for STDOUT                  *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success (nothing else is written - not even a newline);            *
+ *   ERROR_PAK_NO_KEYWORD if the printer has no such field (as in its PPD    *
+ *   file); ERROR_INVALID_DATA if the field's data is damaged; otherwise an  *
+ *   OS/2 error code                                                         *
+ * ------------------------------------------------------------------------- */
+ULONG PakLazyField( PPAKLAZY pLazy, PSZ pszKeyword, PPAKDICT pDict, POUTBUF pOut )
+{
+    PDESPPD   pdes = &(pLazy->desPPD);
+    PPAKFIELD pField;
+    PUI_BLOCK puib;
+    PSZ       psz = NULL,
+              pszText;
+    LONG      lValue,
+              lLen;
+    ULONG     i;
+
+    if ( *pszKeyword == '*') pszKeyword++;
+    for ( i = 0; aLazyKeys[ i ].pszKeyword && strcmp( aLazyKeys[ i ].pszKeyword, pszKeyword ); i++ );
+
+    switch ( aLazyKeys[ i ].usKey ) {
+        case LK_PRODUCT:
+        case LK_MODELNAME:
+            if (( psz = PakLazyString( pLazy, pdes->desItems.ofsPrName )) == NULL )
+                return ERROR_INVALID_DATA;
+            OutPrintf( pOut, ( aLazyKeys[ i ].usKey == LK_PRODUCT ) ? "(%s)" : "%s", psz );
+            return NO_ERROR;
+
+        case LK_PCFILENAME:
+            if ( pdes->desItems.ofsPCFileName < 0 ) psz = "PRINTER.PPD";
+            else if (( psz = PakLazyString( pLazy, pdes->desItems.ofsPCFileName )) == NULL )
+                return ERROR_INVALID_DATA;
+            OutPrintf( pOut, "%s", psz );
+            return NO_ERROR;
+
+        case LK_PSVERSION:
+            OutPrintf( pOut, "(%d) 001", (( pdes->desItems.usLanguageLevel < 2 ) ? 0 :
+                                          ( pdes->desItems.usLanguageLevel * 1000 )) + 10 );
+            return NO_ERROR;
+
+        case LK_LANGUAGELEVEL:
+            OutPrintf( pOut, "%d", pdes->desItems.usLanguageLevel );
+            return NO_ERROR;
+
+        case LK_COLORDEVICE:
+            OutPrintf( pOut, ( pdes->desItems.fIsColorDevice == 1 ) ? "True" : "False");
+            return NO_ERROR;
+
+        case LK_FILESYSTEM:
+            OutPrintf( pOut, ( pdes->desItems.fIsFileSystem == 1 ) ? "True" : "False");
+            return NO_ERROR;
+
+        case LK_THROUGHPUT:
+            if ( pdes->desItems.iPpm <= 0 ) return ERROR_PAK_NO_KEYWORD;
+            OutPrintf( pOut, "%d", pdes->desItems.iPpm );
+            return NO_ERROR;
+
+        case LK_FREEVM:
+            if ( pdes->desItems.lFreeVM == 0 ) return ERROR_PAK_NO_KEYWORD;
+            OutPrintf( pOut, "%lu", (ULONG) pdes->desItems.lFreeVM );
+            return NO_ERROR;
+
+        case LK_PASSWORD:
+            if ( pdes->desItems.ofsPswrd < 1 ) return ERROR_PAK_NO_KEYWORD;
+            if (( psz = PakLazyString( pLazy, pdes->desItems.ofsPswrd )) == NULL )
+                return ERROR_INVALID_DATA;
+            OutPrintf( pOut, "%s", psz );
+            return NO_ERROR;
+
+        case LK_SCREENANGLE:
+            if ( pdes->desItems.iScreenAngle <= 0 ) return ERROR_PAK_NO_KEYWORD;
+            OutPrintf( pOut, "%.2f", pdes->desItems.iScreenAngle / 100.0 );
+            return NO_ERROR;
+
+        case LK_SCREENFREQ:
+            if ( pdes->desItems.lScrFreq <= 0 ) return ERROR_PAK_NO_KEYWORD;
+            OutPrintf( pOut, "%.2f", pdes->desItems.lScrFreq / 100.0 );
+            return NO_ERROR;
+
+        case LK_VARIABLEPAPER:
+            OutPrintf( pOut, ( pdes->desPage.fIsVariablePaper == 1 ) ? "True" : "False");
+            return NO_ERROR;
+
+        case LK_OUTPUTORDER:
+            OutPrintf( pOut, ( pdes->desOutbins.fIsDefoutorder == REVERSE ) ? "Reverse" : "Normal");
+            return NO_ERROR;
+
+        case LK_DEFAULTFONT:
+            if ( pdes->desFonts.ofsDeffont <= 0 ) return ERROR_PAK_NO_KEYWORD;
+            if (( psz = PakLazyString( pLazy, pdes->desFonts.ofsDeffont )) == NULL )
+                return ERROR_INVALID_DATA;
+            OutPrintf( pOut, "%s", psz );
+            return NO_ERROR;
+    }
+
+    // The default option of a UI block, chosen as GeneratePPD() chooses it
+    if (( strncmp( pszKeyword, "Default", 7 ) == 0 ) &&
+        (( puib = FindBlock( pLazy, pszKeyword + 7 )) != NULL ))
+    {
+        if ( puib->usNumOfEntries > puib->usDefaultEntry )
+            psz = OptionName( pLazy, puib, puib->usDefaultEntry );
+        else if ( strcmp( pszKeyword + 7, "PageSize") == 0 )
+            psz = "Letter";
+        else if (( strcmp( pszKeyword + 7, "Resolution") == 0 ) && ( pdes->desItems.iResDpi > 0 )) {
+            OutPrintf( pOut, "%ddpi", pdes->desItems.iResDpi );
+            return NO_ERROR;
+        }
+        else if ( puib->usNumOfEntries )
+            psz = OptionName( pLazy, puib, 0 );
+        else
+            psz = ( strcmp( pszKeyword + 7, "Resolution") == 0 ) ? "300dpi" : "Unknown";
+        if ( !psz ) return ERROR_INVALID_DATA;
+        OutPrintf( pOut, "%s", psz );
+        return NO_ERROR;
+    }
+
+    // A DESPPD field by name
+    for ( pField = PakFieldTable( PAKFT_DESPPD ); pField->pszName; pField++ )
+        if ( strcmp( pField->pszName, pszKeyword ) == 0 ) break;
+    if ( !pField->pszName || ( pField->fs & PF_POINTER )) return ERROR_PAK_NO_KEYWORD;
+
+    lValue = PakFieldValue( pField, pdes );
+    if ( !( pField->fs & PF_STRING ))
+        OutPrintf( pOut, ( pField->fs & PF_SIGNED ) ? "%ld" : "%lu", lValue );
+    else if (( lValue < 0 ) || ( lValue == 0 && !( pField->fs & PF_ZERO_OK )))
+        return ERROR_PAK_NO_KEYWORD;
+    else if (( psz = PakLazyString( pLazy, lValue )) == NULL )
+        return ERROR_INVALID_DATA;
+    else if ( !( pField->fs & PF_COMMAND ))
+        OutPrintf( pOut, "%s", psz );
+    else {
+        if (( lLen = DecompressedLength( pDict, psz )) < 0 ) return ERROR_INVALID_DATA;
+        if (( pszText = (PSZ) PakAlloc( pLazy->pHeap, lLen + 1 )) == NULL )
+            return ERROR_NOT_ENOUGH_MEMORY;
+        DecompressStringDict( pDict, psz, pszText );
+        OutPrintf( pOut, "%s", pszText );
+        PakFree( pLazy->pHeap, pszText );
+    }
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakLazyClose                                                              *
+ *                                                                           *
+ * Free what a query read (but not the file handle, which may be used for    *
+ * further queries).                                                         *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAKLAZY pLazy: Query state, from PakLazyOpen()                         *
+ *                                                                           *
+ * RETURNS: N/A                                                              *
+ * ------------------------------------------------------------------------- */
+VOID PakLazyClose( PPAKLAZY pLazy )
+{
+    PakFree( pLazy->pHeap, pLazy->pbUIList );
+    PakFree( pLazy->pHeap, pLazy->pbInfo );
+    pLazy->pbUIList = NULL;
+    pLazy->pbInfo   = NULL;
+}
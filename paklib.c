@@ -0,0 +1,2739 @@
+/*
+ * paklib.c
+ *
+ * PAKTOOL library: reading of PostScript driver PAK files, and formatting
+ * of printer (device) entries as structured data, readable text, PPD files
+ * or binary dumps.  See paklib.h for an overview.
+ */
+
+#define INCL_DOSFILEMGR
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "ppdtable.h"
+#include "paklib.h"
+#include "pakv2.h"
+
+// Some useful macros for formatted output of offset values
+#define OFFSET_FORMAT( i )     ((i <= 0)? "  %7d": "%#9x")
+
+// Replace certain undisplayable raw-byte values
+#define DISPLAYABLE_CHAR( c )  ( c == 0 ? ' ' : ( c < 32 ? 127: c ))
+
+// Initial allocation (and growth increment) for OUTBUF memory buffers
+#define OUTBUF_CHUNK 4096
+
+
+/* ------------------------------------------------------------------------- *
+ * PakAlloc                                                                  *
+ *                                                                           *
+ * Allocate memory from a caller-supplied heap (or the C runtime heap).      *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID pHeap: Pointer to a PAKHEAP, or NULL for the C runtime heap       *
+ *   ULONG cb   : Number of bytes to allocate                                *
+ *                                                                           *
+ * RETURNS: PVOID                                                            *
+ *   Pointer to the allocated memory, or NULL on failure                     *
+ * ------------------------------------------------------------------------- */
+PVOID PakAlloc( PVOID pHeap, ULONG cb )
+{
+    PPAKHEAP pph = (PPAKHEAP) pHeap;
+
+    return pph ? pph->pfnAlloc( pph->pUser, cb ) : malloc( cb );
+}
+
+
+/* ------------------------------------------------------------------------- */
+VOID PakFree( PVOID pHeap, PVOID p )
+{
+    PPAKHEAP pph = (PPAKHEAP) pHeap;
+
+    if ( !p ) return;
+    if ( pph )
+        pph->pfnFree( pph->pUser, p );
+    else
+        free( p );
+}
+
+
+// Round up arena allocations so that the memory is suitably aligned
+#define ARENA_ALIGN( cb )      ((( cb ) + 7 ) & ~7UL )
+
+// Size of the header at the start of each arena overflow block
+#define ARENA_LINK_SIZE        ARENA_ALIGN( sizeof( PVOID ))
+
+
+/* ------------------------------------------------------------------------- *
+ * ArenaAlloc                                                                *
+ *                                                                           *
+ * Allocate zero-filled memory from an arena.  The memory remains valid      *
+ * until the arena is released back past it (ArenaRelease), reset or freed.  *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAKARENA pArena: Arena to allocate from                                *
+ *   ULONG     cb    : Number of bytes required                              *
+ *                                                                           *
+ * RETURNS: PVOID                                                            *
+ *   Pointer to the memory, or NULL on failure                               *
+ * ------------------------------------------------------------------------- */
+PVOID ArenaAlloc( PPAKARENA pArena, ULONG cb )
+{
+    PBYTE pb;
+
+    cb = ARENA_ALIGN( cb ? cb : 1 );
+    if ( pArena->cbUsed + cb <= pArena->cbBlock ) {
+        pb = pArena->pbBlock + pArena->cbUsed;
+        pArena->cbUsed += cb;
+    }
+    else {
+        // No room in the main block: chain on an overflow block instead
+        if (( pb = (PBYTE) PakAlloc( pArena->pHeap, ARENA_LINK_SIZE + cb )) == NULL )
+            return NULL;
+        *((PVOID *) pb ) = pArena->pOverflow;
+        pArena->pOverflow   = pb;
+        pArena->cbOverflow += cb;
+        pb += ARENA_LINK_SIZE;
+    }
+    memset( pb, 0, cb );
+    return pb;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ArenaMark                                                                 *
+ *                                                                           *
+ * Get the current allocation level of an arena, for ArenaRelease().         *
+ * ------------------------------------------------------------------------- */
+ULONG ArenaMark( PPAKARENA pArena )
+{
+    return pArena->cbUsed;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ArenaRelease                                                              *
+ *                                                                           *
+ * Release all main-block memory allocated from an arena since ArenaMark()   *
+ * returned ulMark.  (Overflow blocks are kept until the next reset.)        *
+ * ------------------------------------------------------------------------- */
+VOID ArenaRelease( PPAKARENA pArena, ULONG ulMark )
+{
+    if ( ulMark < pArena->cbUsed ) pArena->cbUsed = ulMark;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ArenaReset                                                                *
+ *                                                                           *
+ * Release everything allocated from an arena.  If overflow blocks were      *
+ * needed since the last reset, the main block is enlarged to hold their     *
+ * contents as well; it is also enlarged to cbHint bytes if it is smaller.   *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAKARENA pArena: Arena to reset                                        *
+ *   ULONG     cbHint: Minimum size for the main block (may be 0)            *
+ *                                                                           *
+ * RETURNS: BOOL                                                             *
+ *   FALSE if the main block could not be (re)allocated                      *
+ * ------------------------------------------------------------------------- */
+BOOL ArenaReset( PPAKARENA pArena, ULONG cbHint )
+{
+    PVOID pNext;
+    ULONG cbNeed;
+
+    cbNeed = pArena->cbBlock + pArena->cbOverflow;
+    if ( cbNeed < cbHint ) cbNeed = cbHint;
+    while ( pArena->pOverflow ) {
+        pNext = *((PVOID *) pArena->pOverflow );
+        PakFree( pArena->pHeap, pArena->pOverflow );
+        pArena->pOverflow = pNext;
+    }
+    pArena->cbOverflow = 0;
+    pArena->cbUsed     = 0;
+
+    if ( cbNeed > pArena->cbBlock ) {
+        cbNeed = ARENA_ALIGN( cbNeed );
+        PakFree( pArena->pHeap, pArena->pbBlock );
+        if (( pArena->pbBlock = (PBYTE) PakAlloc( pArena->pHeap, cbNeed )) == NULL ) {
+            pArena->cbBlock = 0;
+            return FALSE;
+        }
+        pArena->cbBlock = cbNeed;
+    }
+    return TRUE;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ArenaFree                                                                 *
+ *                                                                           *
+ * Free all memory belonging to an arena.  The arena may be used again.      *
+ * ------------------------------------------------------------------------- */
+VOID ArenaFree( PPAKARENA pArena )
+{
+    ArenaReset( pArena, 0 );
+    PakFree( pArena->pHeap, pArena->pbBlock );
+    pArena->pbBlock = NULL;
+    pArena->cbBlock = 0;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ArenaForSegment                                                           *
+ *                                                                           *
+ * Prepare an arena for parsing one device segment (whose DESPPD is given),  *
+ * sizing it so that one block should cover all of the scratch memory.  If   *
+ * no arena is supplied, the local one is initialized and used instead.      *
+ *                                                                           *
+ * RETURNS: PPAKARENA                                                        *
+ *   The arena to use (pArena or pLocal)                                     *
+ * ------------------------------------------------------------------------- */
+static PPAKARENA ArenaForSegment( PPAKARENA pArena, PPAKARENA pLocal, PDESPPD pdes )
+{
+    ULONG cbHint;
+
+    // UI and UIC lists, string scratch buffer, plus OffsetTo*Command() work space
+    cbHint = pdes->stUIList.usBlockListSize +
+             pdes->stUICList.usNumOfUICs * sizeof( UIC_BLOCK ) +
+             ARENA_ALIGN( pdes->desItems.iSizeBuffer ) * 6;
+    if ( !pArena ) {
+        memset( pLocal, 0, sizeof( PAKARENA ));
+        pArena = pLocal;
+    }
+    // Size the main block only if nothing has been allocated from it yet
+    if ( !pArena->cbUsed && !pArena->pOverflow )
+        ArenaReset( pArena, cbHint );
+    return pArena;
+}
+
+
+/* ------------------------------------------------------------------------- */
+static APIRET OpenPakFile( PSZ pszPakFile, PHFILE phf )
+{
+    ULONG ulAction;
+
+    return DosOpen( pszPakFile, phf, &ulAction, 0, 0,
+                    OPEN_ACTION_FAIL_IF_NEW | OPEN_ACTION_OPEN_IF_EXISTS,
+                    OPEN_FLAGS_FAIL_ON_ERROR | OPEN_FLAGS_SEQUENTIAL |
+                    OPEN_SHARE_DENYNONE | OPEN_ACCESS_READONLY, NULL );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakReadSignature                                                          *
+ *                                                                           *
+ * Read the header (signature) of a PAK file, without checking it.           *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ           pszPakFile: Name of the PAK file                          *
+ *   PPAKSIGNATURE pSig      : Receives the file header                      *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, otherwise an OS/2 error code                              *
+ * ------------------------------------------------------------------------- */
+ULONG PakReadSignature( PSZ pszPakFile, PPAKSIGNATURE pSig )
+{
+    HFILE  hf;
+    ULONG  ulResult;
+    APIRET rc;
+
+    if (( rc = OpenPakFile( pszPakFile, &hf )) != NO_ERROR ) return rc;
+    rc = DosRead( hf, pSig, sizeof( PAKSIGNATURE ), &ulResult );
+    if ( !rc && ulResult < sizeof( PAKSIGNATURE )) rc = ERROR_INVALID_DATA;
+    DosClose( hf );
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakLoadDirectory                                                          *
+ *                                                                           *
+ * Load the header and directory of a PAK file into memory.  The resulting   *
+ * directory memory consists of the PAKSIGNATURE followed by iEntries        *
+ * directory entries, and can be passed to GetDeviceDirEntry() (or the font  *
+ * equivalents).  A V2 device PAK file (see pakv2.h) is accepted in place of *
+ * a V1 one; the directory returned is then in the V1 format, but gives the  *
+ * segment offsets within the V2 file.                                       *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID  pHeap               : Heap for the directory memory (or NULL)    *
+ *   PSZ    pszPakFile          : Name of the PAK file                       *
+ *   PSZ    pszExpectedSignature: Required signature, or NULL for any        *
+ *   ULONG  ulSegmentSize       : Size of one directory entry                *
+ *                                (i.e. sizeof( PAK_DEV_DIRENTRY ) or        *
+ *                                sizeof( PAK_FONT_DIRENTRY ))               *
+ *   PBYTE *ppDirectoryMem      : Receives the directory memory; free it     *
+ *                                with PakFree()                             *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, otherwise an OS/2 error code (ERROR_INVALID_DATA if the   *
+ *   signature does not match)                                               *
+ * ------------------------------------------------------------------------- */
+ULONG PakLoadDirectory( PVOID pHeap, PSZ pszPakFile, PSZ pszExpectedSignature,
+                        ULONG ulSegmentSize, PBYTE *ppDirectoryMem )
+{
+    HFILE        hf;
+    ULONG        ulResult,
+                 cb;
+    PAKSIGNATURE pak_sig;
+    PBYTE        pMem;
+    APIRET       rc;
+
+    *ppDirectoryMem = NULL;
+    if (( rc = OpenPakFile( pszPakFile, &hf )) != NO_ERROR ) return rc;
+
+    rc = DosRead( hf, &pak_sig, sizeof( PAKSIGNATURE ), &ulResult );
+    if ( rc ) goto cleanup;
+
+    // A V2 device PAK is presented with a V1-style directory
+    if (( ulResult == sizeof( PAKSIGNATURE )) &&
+        ( strcmp( pak_sig.szName, PAK2SIGNATURE_DEVPACK ) == 0 ) &&
+        pszExpectedSignature && ( strcmp( pszExpectedSignature, PAKSIGNATURE_DEVPACK_V1 ) == 0 ) &&
+        ( ulSegmentSize == sizeof( PAK_DEV_DIRENTRY )))
+    {
+        DosClose( hf );
+        return Pak2LoadV1Directory( pHeap, pszPakFile, ppDirectoryMem );
+    }
+    if (( ulResult < sizeof( PAKSIGNATURE )) || ( pak_sig.iEntries < 0 ) ||
+        ( pszExpectedSignature && strcmp( pak_sig.szName, pszExpectedSignature ) != 0 ))
+    {
+        rc = ERROR_INVALID_DATA;
+        goto cleanup;
+    }
+
+    cb = sizeof( PAKSIGNATURE ) + pak_sig.iEntries * ulSegmentSize;
+    if (( pMem = (PBYTE) PakAlloc( pHeap, cb )) == NULL ) {
+        rc = ERROR_NOT_ENOUGH_MEMORY;
+        goto cleanup;
+    }
+    memcpy( pMem, &pak_sig, sizeof( PAKSIGNATURE ));
+    cb -= sizeof( PAKSIGNATURE );
+    rc = DosRead( hf, pMem + sizeof( PAKSIGNATURE ), cb, &ulResult );
+    if ( !rc && ulResult < cb ) rc = ERROR_HANDLE_EOF;
+    if ( rc )
+        PakFree( pHeap, pMem );
+    else
+        *ppDirectoryMem = pMem;
+
+cleanup:
+    DosClose( hf );
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakLoadSegment                                                            *
+ *                                                                           *
+ * Read one segment (directory entry's data) of a PAK file into memory.      *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID  pHeap     : Heap for the segment memory (or NULL)                *
+ *   PSZ    pszPakFile: Name of the PAK file                                 *
+ *   ULONG  ulOffset  : File offset of the segment                           *
+ *   ULONG  ulSize    : Size of the segment                                  *
+ *   PBYTE *ppSegment : Receives the segment; free it with PakFree()         *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, otherwise an OS/2 error code                              *
+ * ------------------------------------------------------------------------- */
+ULONG PakLoadSegment( PVOID pHeap, PSZ pszPakFile, ULONG ulOffset, ULONG ulSize,
+                      PBYTE *ppSegment )
+{
+    HFILE  hf;
+    ULONG  ulResult;
+    PBYTE  pBuf;
+    APIRET rc;
+
+    *ppSegment = NULL;
+    if (( rc = OpenPakFile( pszPakFile, &hf )) != NO_ERROR ) return rc;
+
+    // Seek to the indicated offset for this entry's data
+    rc = DosSetFilePtr( hf, ulOffset, FILE_BEGIN, &ulResult );
+    if ( !rc && ulResult != ulOffset ) rc = ERROR_HANDLE_EOF;
+    if ( rc ) goto cleanup;
+
+    // Read the data into a simple buffer
+    if (( pBuf = (PBYTE) PakAlloc( pHeap, ulSize )) == NULL ) {
+        rc = ERROR_NOT_ENOUGH_MEMORY;
+        goto cleanup;
+    }
+    rc = DosRead( hf, pBuf, ulSize, &ulResult );
+    if ( !rc && ulResult < ulSize ) rc = ERROR_HANDLE_EOF;
+    if ( rc )
+        PakFree( pHeap, pBuf );
+    else
+        *ppSegment = pBuf;
+
+cleanup:
+    DosClose( hf );
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * LoadPakDirectory                                                          *
+ *                                                                           *
+ * package.h interface to PakLoadDirectory().                                *
+ *                                                                           *
+ * RETURNS: PBYTE                                                            *
+ *   Directory memory, or NULL on any error                                  *
+ * ------------------------------------------------------------------------- */
+PBYTE LoadPakDirectory( PVOID pHeap, PSZ pszPakFile, PSZ pszExpectedSignature, ULONG ulSegmentSize )
+{
+    PBYTE pMem;
+
+    PakLoadDirectory( pHeap, pszPakFile, pszExpectedSignature, ulSegmentSize, &pMem );
+    return pMem;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * GetDeviceDirEntry                                                         *
+ *                                                                           *
+ * Find a printer's entry in a device PAK directory (as returned by          *
+ * LoadPakDirectory) by its name, which is not case-sensitive.  If no name   *
+ * is given, the first entry is returned.                                    *
+ *                                                                           *
+ * RETURNS: PPAK_DEV_DIRENTRY                                                *
+ *   Pointer to the entry within pDirectoryMem, or NULL if not found         *
+ * ------------------------------------------------------------------------- */
+PPAK_DEV_DIRENTRY GetDeviceDirEntry( PSZ pszDeviceName, PBYTE pDirectoryMem )
+{
+    PPAKSIGNATURE     pSig = (PPAKSIGNATURE) pDirectoryMem;
+    PPAK_DEV_DIRENTRY pEntry;
+    SHORT             i;
+
+    if ( !pDirectoryMem || pSig->iEntries < 1 ) return NULL;
+    pEntry = (PPAK_DEV_DIRENTRY)( pDirectoryMem + sizeof( PAKSIGNATURE ));
+    if ( !pszDeviceName ) return pEntry;
+    for ( i = 0; i < pSig->iEntries; i++, pEntry++ ) {
+        if ( strnicmp( pEntry->szDeviceName, pszDeviceName, sizeof( pEntry->szDeviceName )) == 0 )
+            return pEntry;
+    }
+    return NULL;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * GetFontDirEntry                                                           *
+ *                                                                           *
+ * Find a font's entry in a font PAK directory by its (PostScript) name.     *
+ *                                                                           *
+ * RETURNS: PPAK_FONT_DIRENTRY                                               *
+ *   Pointer to the entry within pDirectoryMem, or NULL if not found         *
+ * ------------------------------------------------------------------------- */
+PPAK_FONT_DIRENTRY GetFontDirEntry( PSZ pszFontName, PBYTE pDirectoryMem )
+{
+    PPAKSIGNATURE      pSig = (PPAKSIGNATURE) pDirectoryMem;
+    PPAK_FONT_DIRENTRY pEntry;
+    SHORT              i;
+
+    if ( !pDirectoryMem || !pszFontName ) return NULL;
+    pEntry = (PPAK_FONT_DIRENTRY)( pDirectoryMem + sizeof( PAKSIGNATURE ));
+    for ( i = 0; i < pSig->iEntries; i++, pEntry++ ) {
+        if ( strncmp( pEntry->szFontName, pszFontName, sizeof( pEntry->szFontName )) == 0 )
+            return pEntry;
+    }
+    return NULL;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * GetFontDirEntryByFullName                                                 *
+ *                                                                           *
+ * Find a font's entry in a font PAK directory by its full name.             *
+ *                                                                           *
+ * RETURNS: PPAK_FONT_DIRENTRY                                               *
+ *   Pointer to the entry within pDirectoryMem, or NULL if not found         *
+ * ------------------------------------------------------------------------- */
+PPAK_FONT_DIRENTRY GetFontDirEntryByFullName( PSZ pszFontFullName, PBYTE pDirectoryMem )
+{
+    PPAKSIGNATURE      pSig = (PPAKSIGNATURE) pDirectoryMem;
+    PPAK_FONT_DIRENTRY pEntry;
+    SHORT              i;
+
+    if ( !pDirectoryMem || !pszFontFullName ) return NULL;
+    pEntry = (PPAK_FONT_DIRENTRY)( pDirectoryMem + sizeof( PAKSIGNATURE ));
+    for ( i = 0; i < pSig->iEntries; i++, pEntry++ ) {
+        if ( strncmp( pEntry->szFontFullName, pszFontFullName, sizeof( pEntry->szFontFullName )) == 0 )
+            return pEntry;
+    }
+    return NULL;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * LoadPakDeviceSegment                                                      *
+ *                                                                           *
+ * Load the data (device segment) of the named printer into memory.          *
+ *                                                                           *
+ * RETURNS: PBYTE                                                            *
+ *   Segment memory (free with PakFree), or NULL on any error                *
+ * ------------------------------------------------------------------------- */
+PBYTE LoadPakDeviceSegment( PVOID pHeap, PSZ pszPakFile, PBYTE pDirectoryMem, PSZ pszDeviceName )
+{
+    PPAK_DEV_DIRENTRY pEntry;
+    PBYTE             pSeg = NULL;
+
+    if (( pEntry = GetDeviceDirEntry( pszDeviceName, pDirectoryMem )) != NULL )
+        PakLoadSegment( pHeap, pszPakFile, pEntry->ulOffset, pEntry->ulSize, &pSeg );
+    return pSeg;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * LoadPakFontSegment                                                        *
+ *                                                                           *
+ * Load the data of the named font into memory.                              *
+ *                                                                           *
+ * RETURNS: PBYTE                                                            *
+ *   Segment memory (free with PakFree), or NULL on any error                *
+ * ------------------------------------------------------------------------- */
+PBYTE LoadPakFontSegment( PVOID pHeap, PSZ pszPakFile, PBYTE pDirectoryMem, PSZ pszFontName )
+{
+    PPAK_FONT_DIRENTRY pEntry;
+    PBYTE              pSeg = NULL;
+
+    if (( pEntry = GetFontDirEntry( pszFontName, pDirectoryMem )) != NULL )
+        PakLoadSegment( pHeap, pszPakFile, pEntry->ulOffset, pEntry->ulSize, &pSeg );
+    return pSeg;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * StreamRead                                                                *
+ *                                                                           *
+ * Read exactly cb bytes from a (possibly non-seekable) file, or discard     *
+ * them if pb is NULL (using pbWork, of cbWork bytes, as the buffer).  Pipes *
+ * may return less than requested, so this keeps reading until done.         *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_HANDLE_EOF if the data ended early, otherwise an    *
+ *   OS/2 error code                                                         *
+ * ------------------------------------------------------------------------- */
+static ULONG StreamRead( HFILE hf, PBYTE pb, ULONG cb, PBYTE pbWork, ULONG cbWork )
+{
+    ULONG  ulChunk,
+           ulResult;
+    APIRET rc;
+
+    while ( cb ) {
+        ulChunk = pb ? cb : (( cb < cbWork ) ? cb : cbWork );
+        rc = DosRead( hf, pb ? pb : pbWork, ulChunk, &ulResult );
+        if ( rc == ERROR_BROKEN_PIPE ) return ERROR_HANDLE_EOF;
+        if ( rc ) return rc;
+        if ( !ulResult ) return ERROR_HANDLE_EOF;
+        if ( pb ) pb += ulResult;
+        cb -= ulResult;
+    }
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- */
+static int CompareOffsets( const void *p1, const void *p2 )
+{
+    ULONG ul1 = ((PPAK_DEV_DIRENTRY) p1 )->ulOffset,
+          ul2 = ((PPAK_DEV_DIRENTRY) p2 )->ulOffset;
+
+    return ( ul1 < ul2 ) ? -1 : (( ul1 > ul2 ) ? 1 : 0 );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * StreamSignature                                                           *
+ *                                                                           *
+ * Read the signature of the next PAK in a stream.  If fScan is set, bytes   *
+ * which do not begin a signature are skipped (and counted) until one is     *
+ * found or the input ends; otherwise the signature must come first.         *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   HFILE         hf        : File to read from                             *
+ *   PPAKSIGNATURE pSig      : Receives the signature                        *
+ *   BOOL          fScan     : Whether to skip over other data               *
+ *   PULONG        pcbSkipped: Receives the number of bytes skipped          *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_HANDLE_EOF if the input ended first (*pcbSkipped    *
+ *   being the number of bytes before the end), ERROR_INVALID_DATA if fScan  *
+ *   is not set and there is no signature, otherwise an OS/2 error code      *
+ * ------------------------------------------------------------------------- */
+static ULONG StreamSignature( HFILE hf, PPAKSIGNATURE pSig, BOOL fScan, PULONG pcbSkipped )
+{
+    PBYTE  pb = (PBYTE) pSig;
+    ULONG  cbHave = 0,
+           cbName = strlen( PAKSIGNATURE_DEVPACK_V1 ),
+           ulResult,
+           i;
+    APIRET rc;
+
+    *pcbSkipped = 0;
+    for ( ;; ) {
+        while ( cbHave < sizeof( PAKSIGNATURE )) {
+            rc = DosRead( hf, pb + cbHave, sizeof( PAKSIGNATURE ) - cbHave, &ulResult );
+            if (( rc == ERROR_BROKEN_PIPE ) || ( !rc && !ulResult )) {
+                *pcbSkipped += cbHave;
+                return ERROR_HANDLE_EOF;
+            }
+            if ( rc ) return rc;
+            cbHave += ulResult;
+        }
+        if ( strncmp( pSig->szName, PAKSIGNATURE_DEVPACK_V1, sizeof( pSig->szName )) == 0 )
+            return NO_ERROR;
+        if ( !fScan ) return ERROR_INVALID_DATA;
+
+        // Keep only what could be the start of a signature
+        for ( i = 1; i < cbHave; i++ )
+            if ( memcmp( pb + i, PAKSIGNATURE_DEVPACK_V1,
+                         ( cbHave - i < cbName ) ? cbHave - i : cbName ) == 0 ) break;
+        memmove( pb, pb + i, cbHave - i );
+        cbHave      -= i;
+        *pcbSkipped += i;
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakStreamDevices                                                          *
+ *                                                                           *
+ * Read one or more device PAK files from an open file or pipe, passing      *
+ * every segment to a callback a window at a time (see paklib.h).  After the *
+ * first PAK, any bytes which do not begin another are skipped up to the     *
+ * next signature (or the end of the input), and their number passed to the  *
+ * callback.  Entries sharing a segment (having the same offset) are each    *
+ * passed its pieces from the one window, so the segment must fit in it;     *
+ * otherwise segments must not overlap, as the input is only read forwards.  *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID         pHeap   : Heap for the window and directory (or NULL)     *
+ *   HFILE         hf      : File to read from (e.g. HF_STDIN)               *
+ *   ULONG         cbWindow: Window size, or 0 for PAKSTREAM_WINDOW          *
+ *   PPFNPAKSTREAM pfnVisit: Callback for each piece of each segment         *
+ *   PVOID         pUser   : Passed to the callback                          *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_INVALID_DATA if the input does not start with a     *
+ *   PAK signature or a PAK's directory is not valid, ERROR_NEGATIVE_SEEK if *
+ *   segments overlap, ERROR_PAK_SHARED_SEGMENT if a shared segment is       *
+ *   larger than the window, a callback's return code, or an OS/2 error code *
+ * ------------------------------------------------------------------------- */
+ULONG PakStreamDevices( PVOID pHeap, HFILE hf, ULONG cbWindow,
+                        PPFNPAKSTREAM pfnVisit, PVOID pUser )
+{
+    PAKSIGNATURE      pak_sig;
+    PPAK_DEV_DIRENTRY pDir = NULL,
+                      pEntry;
+    PBYTE             pbWindow;
+    ULONG             ulPos,            // current position within this PAK
+                      ulDone,           // bytes of current segment read
+                      ulPiece,          // bytes of current entry passed on
+                      cbSegment,        // size of the largest entry in a segment
+                      cbSkipped,        // bytes skipped before a signature
+                      cPaks = 0,
+                      cb;
+    SHORT             i, j, k;
+    APIRET            rc;
+
+    if ( !cbWindow ) cbWindow = PAKSTREAM_WINDOW;
+    if (( pbWindow = (PBYTE) PakAlloc( pHeap, cbWindow )) == NULL )
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    for ( ;; ) {
+        // The input may end cleanly at the start of a PAK; after the first, any
+        // other data up to the next signature (or the end) is skipped
+        rc = StreamSignature( hf, &pak_sig, ( cPaks != 0 ), &cbSkipped );
+        if ( cPaks && cbSkipped && ( !rc || ( rc == ERROR_HANDLE_EOF )) &&
+             (( cb = pfnVisit( pUser, NULL, NULL, 0, NULL, cbSkipped )) != NO_ERROR ))
+        {
+            rc = cb;
+            break;
+        }
+        if ( rc == ERROR_HANDLE_EOF ) {
+            // Part of a signature at the very start is not a PAK file
+            rc = ( cbSkipped && !cPaks ) ? ERROR_INVALID_DATA : NO_ERROR;
+            break;
+        }
+        if ( rc ) break;
+        if ( pak_sig.iEntries < 0 ) {
+            rc = ERROR_INVALID_DATA;
+            break;
+        }
+        cPaks++;
+
+        // Read the directory, and sort it into file order
+        cb = pak_sig.iEntries * sizeof( PAK_DEV_DIRENTRY );
+        if (( pDir = (PPAK_DEV_DIRENTRY) PakAlloc( pHeap, cb ? cb : 1 )) == NULL ) {
+            rc = ERROR_NOT_ENOUGH_MEMORY;
+            break;
+        }
+        if (( rc = StreamRead( hf, (PBYTE) pDir, cb, NULL, 0 )) != NO_ERROR ) break;
+        qsort( pDir, pak_sig.iEntries, sizeof( PAK_DEV_DIRENTRY ), CompareOffsets );
+        ulPos = sizeof( PAKSIGNATURE ) + cb;
+
+        for ( i = 0; !rc && i < pak_sig.iEntries; i = j ) {
+            // Entries with the same offset share one segment, as long as the largest
+            pEntry    = pDir + i;
+            cbSegment = pEntry->ulSize;
+            for ( j = i + 1; ( j < pak_sig.iEntries ) && ( pDir[ j ].ulOffset == pEntry->ulOffset ); j++ )
+                if ( pDir[ j ].ulSize > cbSegment ) cbSegment = pDir[ j ].ulSize;
+            if ( pEntry->ulOffset < ulPos ) {
+                rc = ERROR_NEGATIVE_SEEK;
+                break;
+            }
+            // Skip any gap before the segment, then pass it on a window at a time
+            if (( rc = StreamRead( hf, NULL, pEntry->ulOffset - ulPos, pbWindow, cbWindow )) != NO_ERROR )
+                break;
+            ulPos = pEntry->ulOffset;
+
+            // A shared segment must fit in the window, so that it can be passed to
+            // each entry in turn with the entries' pieces still kept together
+            if (( j - i > 1 ) && ( cbSegment > cbWindow )) {
+                rc = ERROR_PAK_SHARED_SEGMENT;
+                break;
+            }
+            ulDone = 0;
+            do {
+                cb = cbSegment - ulDone;
+                if ( cb > cbWindow ) cb = cbWindow;
+                if (( rc = StreamRead( hf, pbWindow, cb, NULL, 0 )) != NO_ERROR ) break;
+                for ( k = i; !rc && k < j; k++ ) {
+                    if ( ulDone && ( ulDone >= pDir[ k ].ulSize )) continue;
+                    ulPiece = ( pDir[ k ].ulSize < ulDone + cb ) ? pDir[ k ].ulSize - ulDone : cb;
+                    rc = pfnVisit( pUser, &pak_sig, pDir + k, ulDone, pbWindow, ulPiece );
+                }
+                ulDone += cb;
+            } while ( !rc && ulDone < cbSegment );
+            ulPos += ulDone;
+        }
+
+        PakFree( pHeap, pDir );
+        pDir = NULL;
+        if ( rc ) break;
+    }
+
+    PakFree( pHeap, pDir );
+    PakFree( pHeap, pbWindow );
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * FormatPakDevice                                                           *
+ *                                                                           *
+ * Format a device segment which has been loaded into memory.                *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAK_DEV_DIRENTRY pEntry: Directory entry of the device                 *
+ *   PBYTE             pBuf  : Device segment                                *
+ *   USHORT            fsMode: Output format (one of the DEV_*_DATA values)  *
+ *   PPAKARENA         pArena: Scratch arena (or NULL)                       *
+ *   POUTBUF           pOut  : Output buffer, or NULL for STDOUT             *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, or ERROR_NOT_ENOUGH_MEMORY                                *
+ * ------------------------------------------------------------------------- */
+ULONG FormatPakDevice( PPAK_DEV_DIRENTRY pEntry, PBYTE pBuf, USHORT fsMode,
+                       PPAKARENA pArena, POUTBUF pOut )
+{
+    switch ( fsMode ) {
+        case DEV_FMT_DATA: ShowDeviceData( *pEntry, pBuf, pArena, pOut );     break;
+        case DEV_TXT_DATA: ShowReadableData( *pEntry, pBuf, pArena, pOut );   break;
+        case DEV_PPD_DATA: GeneratePPD( pBuf, pArena, pOut );                 break;
+        case DEV_JSON_DATA: ShowJsonData( *pEntry, pBuf, pArena, pOut );      break;
+        case DEV_RAW_DATA: DumpBytes( pBuf, pEntry->ulSize, FALSE, pOut );    break;
+        case DEV_HEX_DATA: DumpBytes( pBuf, pEntry->ulSize, TRUE, pOut );     break;
+        case DEV_BIN_DATA: PrettyBytes( pBuf, pEntry->ulSize, pOut );         break;
+    }
+    return ( pOut && pOut->fError ) ? ERROR_NOT_ENOUGH_MEMORY : NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * RenderPakDevice                                                           *
+ *                                                                           *
+ * Load the named printer's data from a device PAK file and format it in     *
+ * the requested manner.                                                     *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID     pHeap      : Heap for temporary memory (or NULL)              *
+ *   PPAKARENA pArena     : Scratch arena, reset before use (or NULL)        *
+ *   PSZ       pszPakFile : Name of the PAK file                             *
+ *   PSZ       pszDeviceName: Printer name, or NULL for the first printer    *
+ *   USHORT    fsMode     : Output format (one of the DEV_*_DATA values)     *
+ *   POUTBUF   pOut       : Output buffer, or NULL for STDOUT                *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_PAK_NO_DEVICE if the printer was not found, or an   *
+ *   OS/2 error code                                                         *
+ * ------------------------------------------------------------------------- */
+ULONG RenderPakDevice( PVOID pHeap, PPAKARENA pArena, PSZ pszPakFile,
+                       PSZ pszDeviceName, USHORT fsMode, POUTBUF pOut )
+{
+    PBYTE             pDir,
+                      pBuf;
+    PPAK_DEV_DIRENTRY pEntry;
+    PAKARENA          arLocal = {0};
+    PAKSIGNATURE      pak_sig;
+    APIRET            rc;
+
+    // V2 files have their own reader, which can use the pre-decompressed strings
+    if (( PakReadSignature( pszPakFile, &pak_sig ) == NO_ERROR ) &&
+        ( strcmp( pak_sig.szName, PAK2SIGNATURE_DEVPACK ) == 0 ))
+        return RenderPak2Device( pHeap, pArena, pszPakFile, pszDeviceName, fsMode, pOut );
+
+    // Scratch memory comes from the caller's arena (reset for each entry),
+    // or from a temporary one using the same heap as everything else
+    if ( pArena )
+        ArenaReset( pArena, 0 );
+    else {
+        arLocal.pHeap = pHeap;
+        pArena = &arLocal;
+    }
+
+    rc = PakLoadDirectory( pHeap, pszPakFile, PAKSIGNATURE_DEVPACK_V1,
+                           sizeof( PAK_DEV_DIRENTRY ), &pDir );
+    if ( rc ) return rc;
+
+    if (( pEntry = GetDeviceDirEntry( pszDeviceName, pDir )) == NULL ) {
+        rc = ERROR_PAK_NO_DEVICE;
+        goto cleanup;
+    }
+    rc = PakLoadSegment( pHeap, pszPakFile, pEntry->ulOffset, pEntry->ulSize, &pBuf );
+    if ( rc ) goto cleanup;
+
+    // OK, we have the data... now output it in the manner requested.
+    rc = FormatPakDevice( pEntry, pBuf, fsMode, pArena, pOut );
+    PakFree( pHeap, pBuf );
+
+cleanup:
+    PakFree( pHeap, pDir );
+    if ( pArena == &arLocal ) ArenaFree( &arLocal );
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakFindDevice                                                             *
+ *                                                                           *
+ * Find the named printer in a device PAK file (V1 or V2) without loading    *
+ * its segment.                                                              *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID             pHeap        : Heap to allocate from (or NULL)        *
+ *   PSZ               pszPakFile   : Name of the PAK file                   *
+ *   PSZ               pszDeviceName: Printer name, or NULL for the first    *
+ *   PPAK_DEV_DIRENTRY pEntry       : Receives the directory entry (with the *
+ *                                    file offset of the segment)            *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_PAK_NO_DEVICE if the printer was not found, or an   *
+ *   OS/2 error code                                                         *
+ * ------------------------------------------------------------------------- */
+ULONG PakFindDevice( PVOID pHeap, PSZ pszPakFile, PSZ pszDeviceName,
+                     PPAK_DEV_DIRENTRY pEntry )
+{
+    PAKSIGNATURE      pak_sig;
+    PAK2_ENTRY        entry2;
+    PPAK_DEV_DIRENTRY pFound;
+    PBYTE             pDir;
+    APIRET            rc;
+
+    if (( PakReadSignature( pszPakFile, &pak_sig ) == NO_ERROR ) &&
+        ( strcmp( pak_sig.szName, PAK2SIGNATURE_DEVPACK ) == 0 ))
+    {
+        if (( rc = Pak2Lookup( pHeap, pszPakFile, pszDeviceName, &entry2 )) != NO_ERROR )
+            return rc;
+        memcpy( pEntry, &(entry2.devV1), sizeof( PAK_DEV_DIRENTRY ));
+        pEntry->ulOffset = entry2.ulOffset;
+        return NO_ERROR;
+    }
+    rc = PakLoadDirectory( pHeap, pszPakFile, PAKSIGNATURE_DEVPACK_V1,
+                           sizeof( PAK_DEV_DIRENTRY ), &pDir );
+    if ( rc ) return rc;
+    if (( pFound = GetDeviceDirEntry( pszDeviceName, pDir )) != NULL )
+        memcpy( pEntry, pFound, sizeof( PAK_DEV_DIRENTRY ));
+    PakFree( pHeap, pDir );
+    return pFound ? NO_ERROR : ERROR_PAK_NO_DEVICE;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakLoadDevice                                                             *
+ *                                                                           *
+ * Find the named printer in a device PAK file (V1 or V2) and load its       *
+ * segment.                                                                  *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID             pHeap        : Heap to allocate from (or NULL)        *
+ *   PSZ               pszPakFile   : Name of the PAK file                   *
+ *   PSZ               pszDeviceName: Printer name, or NULL for the first    *
+ *   PPAK_DEV_DIRENTRY pEntry       : Receives the directory entry (with the *
+ *                                    file offset of the segment)            *
+ *   PBYTE            *ppSegment    : Receives the segment (free with        *
+ *                                    PakFree)                               *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_PAK_NO_DEVICE if the printer was not found, or an   *
+ *   OS/2 error code                                                         *
+ * ------------------------------------------------------------------------- */
+ULONG PakLoadDevice( PVOID pHeap, PSZ pszPakFile, PSZ pszDeviceName,
+                     PPAK_DEV_DIRENTRY pEntry, PBYTE *ppSegment )
+{
+    APIRET rc;
+
+    *ppSegment = NULL;
+    if (( rc = PakFindDevice( pHeap, pszPakFile, pszDeviceName, pEntry )) != NO_ERROR )
+        return rc;
+    return PakLoadSegment( pHeap, pszPakFile, pEntry->ulOffset, pEntry->ulSize, ppSegment );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * OutReserve                                                                *
+ *                                                                           *
+ * Make sure a memory output buffer has room for (at least) the given number *
+ * of additional bytes plus a terminating null.                              *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   POUTBUF pOut: Output buffer (must not be NULL)                          *
+ *   ULONG   cb  : Number of bytes about to be written                       *
+ *                                                                           *
+ * RETURNS: BOOL                                                             *
+ *   TRUE if the space is available, FALSE if allocation failed              *
+ * ------------------------------------------------------------------------- */
+static BOOL OutReserve( POUTBUF pOut, ULONG cb )
+{
+    PBYTE pbNew;
+    ULONG cbNew;
+
+    if ( pOut->fError ) return FALSE;
+    if ( pOut->cbData + cb < pOut->cbAlloc ) return TRUE;
+
+    cbNew = pOut->cbAlloc ? pOut->cbAlloc : OUTBUF_CHUNK;
+    while ( cbNew <= pOut->cbData + cb ) cbNew *= 2;
+    if ( !pOut->pHeap )
+        pbNew = (PBYTE) realloc( pOut->pbData, cbNew );
+    else if (( pbNew = (PBYTE) PakAlloc( pOut->pHeap, cbNew )) != NULL && pOut->pbData ) {
+        memcpy( pbNew, pOut->pbData, pOut->cbData + 1 );
+        PakFree( pOut->pHeap, pOut->pbData );
+    }
+    if ( !pbNew ) {
+        pOut->fError = TRUE;
+        return FALSE;
+    }
+    pOut->pbData  = pbNew;
+    pOut->cbAlloc = cbNew;
+    return TRUE;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * OutPrintf                                                                 *
+ *                                                                           *
+ * printf() replacement used by all of the formatting functions.  Output is  *
+ * written to STDOUT if pOut is NULL, otherwise it is appended to pOut.      *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   POUTBUF pOut     : Output buffer, or NULL for STDOUT                    *
+ *   PSZ     pszFormat: printf()-style format string, followed by arguments  *
+ *                                                                           *
+ * RETURNS: N/A                                                              *
+ * ------------------------------------------------------------------------- */
+void OutPrintf( POUTBUF pOut, PSZ pszFormat, ... )
+{
+    va_list args;
+    ULONG   cbFree;
+    int     cb;
+
+    va_start( args, pszFormat );
+    if ( !pOut ) {
+        vprintf( pszFormat, args );
+        va_end( args );
+        return;
+    }
+    if ( !OutReserve( pOut, 0 )) {
+        va_end( args );
+        return;
+    }
+    cbFree = pOut->cbAlloc - pOut->cbData;
+    cb = vsnprintf( pOut->pbData + pOut->cbData, cbFree, pszFormat, args );
+    va_end( args );
+    if ( cb < 0 ) return;
+
+    // Didn't fit: grow the buffer and format it again
+    if ( (ULONG) cb >= cbFree ) {
+        if ( !OutReserve( pOut, cb )) return;
+        va_start( args, pszFormat );
+        vsnprintf( pOut->pbData + pOut->cbData, cb + 1, pszFormat, args );
+        va_end( args );
+    }
+    pOut->cbData += cb;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * OutWrite                                                                  *
+ *                                                                           *
+ * Write a block of (possibly binary) data to the output.                    *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   POUTBUF pOut: Output buffer, or NULL for STDOUT                         *
+ *   PBYTE   pb  : Data to write                                             *
+ *   ULONG   cb  : Number of bytes to write                                  *
+ *                                                                           *
+ * RETURNS: N/A                                                              *
+ * ------------------------------------------------------------------------- */
+void OutWrite( POUTBUF pOut, PBYTE pb, ULONG cb )
+{
+    if ( !pOut ) {
+        fwrite( pb, 1, cb, stdout );
+        return;
+    }
+    if ( !OutReserve( pOut, cb )) return;
+    memcpy( pOut->pbData + pOut->cbData, pb, cb );
+    pOut->cbData += cb;
+    pOut->pbData[ pOut->cbData ] = 0;
+}
+
+
+/* ------------------------------------------------------------------------- */
+void OutFree( POUTBUF pOut )
+{
+    PakFree( pOut->pHeap, pOut->pbData );
+    memset( pOut, 0, sizeof( OUTBUF ));
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * DumpBytes                                                                 *
+ *                                                                           *
+ * Dump the contents of a buffer to STDOUT as either raw or hex byte values. *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PBYTE pBuf: Pointer to the data being dumped                            *
+ *   ULONG cb  : Number of bytes to dump                                     *
+ *   BOOL  fHex: Output as hex values instead of literal bytes?              *
+ *                                                                           *
+ * RETURNS: N/A                                                              *
+ * ------------------------------------------------------------------------- */
+void DumpBytes( PBYTE pBuf, ULONG cb, BOOL fHex, POUTBUF pOut )
+{
+    SHORT sCol = 0;
+
+    DumpBytesFrom( pBuf, cb, fHex, &sCol, pOut );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * DumpBytesFrom                                                             *
+ *                                                                           *
+ * As DumpBytes, but continuing a hex dump from the output column *psCol     *
+ * (which is updated), so that a buffer may be dumped in several pieces.     *
+ * ------------------------------------------------------------------------- */
+void DumpBytesFrom( PBYTE pBuf, ULONG cb, BOOL fHex, PSHORT psCol, POUTBUF pOut )
+{
+    ULONG i;
+    SHORT sCol = *psCol;
+
+    if ( !fHex ) {
+        OutWrite( pOut, pBuf, cb );
+        return;
+    }
+    for ( i = 0; i < cb; i++ ) {
+        OutPrintf( pOut, "%02X", *(pBuf+i) );
+        sCol += 3;
+        if ( sCol > 75 ) {
+            OutPrintf( pOut, "\n");
+            sCol = 0;
+        } else
+            OutPrintf( pOut, " ");
+    }
+    *psCol = sCol;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PrettyBytes                                                               *
+ *                                                                           *
+ * Dump the contents of a buffer to STDOUT in a nice-looking table with both *
+ * hexadecimal and literal (character) values displayed side-by-side.        *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PBYTE pBuf: Pointer to the data being dumped                            *
+ *   ULONG cb  : Number of bytes to dump                                     *
+ *                                                                           *
+ * RETURNS: N/A                                                              *
+ * ------------------------------------------------------------------------- */
+void PrettyBytes( PBYTE pBuf, ULONG cb, POUTBUF pOut )
+{
+    ULONG i, j, k;
+    USHORT count = 0;
+
+    OutPrintf( pOut, "     +------------------------------------------------+----------------+\n");
+    OutPrintf( pOut, "     |+0 +1 +2 +3 +4 +5 +6 +7 +8 +9 +A +B +C +D +E +F |0123456789ABCDEF|\n");
+    OutPrintf( pOut, "+----+------------------------------------------------+----------------+\n");
+    OutPrintf( pOut, "|0000|");
+    for ( i = 0, j = 0; i < cb; i++ ) {
+        OutPrintf( pOut, "%02X", *(pBuf+i) );
+        count++;
+        if ( count > 15 ) {
+            OutPrintf( pOut, " |");
+            for ( ; j <= i; j++ ) OutPrintf( pOut, "%c", DISPLAYABLE_CHAR( *(pBuf+j) ));
+            OutPrintf( pOut, "|\n|%04X|", i+1 );
+            count = 0;
+        } else
+            OutPrintf( pOut, " ");
+    }
+    if ( j < i ) {
+        for ( k = (i%16); k < 16; k++ ) OutPrintf( pOut, "   ");
+        OutPrintf( pOut, "|");
+        for ( ; j <= i; j++ ) OutPrintf( pOut, "%c", DISPLAYABLE_CHAR( *(pBuf+j) ));
+        for ( k = (j%16); k < 16; k++ ) OutPrintf( pOut, " ");
+        OutPrintf( pOut, "|\n");
+    }
+    OutPrintf( pOut, "+----+------------------------------------------------+----------------+\n");
+    OutPrintf( pOut, "     |+0 +1 +2 +3 +4 +5 +6 +7 +8 +9 +A +B +C +D +E +F |0123456789ABCDEF|\n");
+    OutPrintf( pOut, "     +------------------------------------------------+----------------+\n");
+}
+
+
+// Titles of the DESPPD members shown in boxes by ShowDeviceData(), in order
+static PSZ apszDesGroups[] = { "desItems (PPD1)", "desPage (PPD2)", "desInpbins (PPD3)",
+                               "desOutbins (PPD4)", "desFonts (PPD5)", "desForms (PPD6)" };
+
+static CHAR achDashes[] = "------------------------------------------------------------------------------";
+
+
+/* ------------------------------------------------------------------------- *
+ * FieldGroupSize                                                            *
+ *                                                                           *
+ * Count the fields, starting with the given one, whose names have the same  *
+ * member prefix (e.g. "desItems.") and return the length of the prefix.     *
+ * ------------------------------------------------------------------------- */
+static ULONG FieldGroupSize( PPAKFIELD pField, PULONG pcchPrefix )
+{
+    PSZ   pszDot = strchr( pField->pszName, '.');
+    ULONG cch = pszDot ? ( pszDot - pField->pszName ) + 1 : 0,
+          c;
+
+    for ( c = 1; cch && pField[ c ].pszName && !strncmp( pField[ c ].pszName, pField->pszName, cch ); c++ );
+    *pcchPrefix = cch;
+    return c;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * print_fieldval                                                            *
+ *                                                                           *
+ * Print the value of a field in nine columns: offsets as by OFFSET_FORMAT,  *
+ * anything else in decimal.                                                 *
+ * ------------------------------------------------------------------------- */
+static void print_fieldval( PPAKFIELD pField, PVOID pStruct, POUTBUF pOut )
+{
+    LONG lValue = PakFieldValue( pField, pStruct );
+
+    if ( pField->fs & ( PF_STRING | PF_TABLE ))
+        OutPrintf( pOut, OFFSET_FORMAT((SHORT) lValue), (SHORT) lValue );
+    else if ( pField->fs & PF_SIGNED )
+        OutPrintf( pOut, "%9ld", lValue );
+    else
+        OutPrintf( pOut, "%9lu", (ULONG) lValue );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * print_fieldbox                                                            *
+ *                                                                           *
+ * Print a group of fields in a titled box, in two columns (filled down the  *
+ * left column first) if there are more than three of them.                  *
+ * ------------------------------------------------------------------------- */
+static void print_fieldbox( PSZ pszTitle, PPAKFIELD pField, ULONG cFields, ULONG cchPrefix,
+                            PVOID pStruct, POUTBUF pOut )
+{
+    ULONG cRows = ( cFields > 3 ) ? ( cFields + 1 ) / 2 : cFields,
+          cch   = strlen( pszTitle ),
+          i, j;
+
+    OutPrintf( pOut, "+%.*s+\n| %s |\n", cch + 2, achDashes, pszTitle );
+    OutPrintf( pOut, "+%.*s+%.*s+", cch + 2, achDashes, 35 - cch, achDashes );
+    if ( cRows < cFields ) OutPrintf( pOut, "%.38s+", achDashes );
+    OutPrintf( pOut, "\n");
+    for ( i = 0; i < cRows; i++ ) {
+        OutPrintf( pOut, "|");
+        for ( j = i; j < cFields; j += cRows ) {
+            OutPrintf( pOut, " %-24s = ", pField[ j ].pszName + cchPrefix );
+            print_fieldval( pField + j, pStruct, pOut );
+            OutPrintf( pOut, " |");
+        }
+        if (( cRows < cFields ) && ( i + cRows >= cFields )) OutPrintf( pOut, "%38s|", "");
+        OutPrintf( pOut, "\n");
+    }
+    OutPrintf( pOut, "+%.38s+", achDashes );
+    if ( cRows < cFields ) OutPrintf( pOut, "%.38s+", achDashes );
+    OutPrintf( pOut, "\n\n");
+}
+
+
+/* ------------------------------------------------------------------------- */
+void ShowDeviceData( PAK_DEV_DIRENTRY pdd, PBYTE pBuf, PPAKARENA pArena, POUTBUF pOut )
+{
+    DESPPD     desPPD = {0};
+    PBYTE      pInfoSeg;
+    PUI_BLOCK  puib;
+    PUIC_BLOCK puicb;
+    ULONG      ulCB,
+               cbDS,
+               cbIS;
+    PPAKFIELD  pField,
+               pf;
+    ULONG      cFields,
+               cchPrefix;
+    USHORT     i, j;
+    PAKARENA   arLocal;
+    ULONG      ulMark;
+
+
+    cbDS = sizeof( DESPPD );
+    memcpy( (PBYTE) &desPPD, pBuf, cbDS );
+    pInfoSeg = pBuf + cbDS;
+
+    // Allocate and copy the dynamic data items in DESPPD
+    pArena = ArenaForSegment( pArena, &arLocal, &desPPD );
+    ulMark = ArenaMark( pArena );
+    ulCB = desPPD.stUIList.usBlockListSize;
+    desPPD.stUIList.pBlockList = (PUI_BLOCK) ArenaAlloc( pArena, ulCB );
+    if ( !desPPD.stUIList.pBlockList ) goto cleanup;
+    memcpy( desPPD.stUIList.pBlockList, (PUI_BLOCK) pInfoSeg, ulCB );
+    pInfoSeg += ulCB;
+    cbDS += ulCB;
+
+    ulCB = desPPD.stUICList.usNumOfUICs * sizeof( UIC_BLOCK );
+    desPPD.stUICList.puicBlockList = (PUIC_BLOCK) ArenaAlloc( pArena, ulCB );
+    if ( !desPPD.stUICList.puicBlockList ) goto cleanup;
+    memcpy( desPPD.stUICList.puicBlockList, (PUIC_BLOCK) pInfoSeg, ulCB );
+    pInfoSeg += ulCB;
+    cbDS += ulCB;
+    cbIS = pdd.ulSize - cbDS;
+    desPPD.pPSStringBuff = pInfoSeg;
+
+    // Print header
+    OutPrintf( pOut, "/=============================================================================\\\n");
+    OutPrintf( pOut, "| PRINTER PAK ENTRY                                                           |\n");
+    OutPrintf( pOut, "| %-75s |\n", pdd.szDeviceName );
+    OutPrintf( pOut, "+-----------------------------------------------------------------------------+\n");
+    OutPrintf( pOut, "| %5u bytes total                                                           |\n", pdd.ulSize );
+    OutPrintf( pOut, "|  - %5u bytes in descriptor segment                                        |\n", cbDS );
+    OutPrintf( pOut, "|  - %5u bytes in information segment                                       |\n", cbIS );
+    OutPrintf( pOut, "\\=============================================================================/\n\n");
+
+    OutPrintf( pOut, "\n-------------------------------------------------------------------------------");
+    OutPrintf( pOut, "\n                         DESCRIPTOR SEGMENT (DESPPD)                           ");
+    OutPrintf( pOut, "\n-------------------------------------------------------------------------------\n");
+
+    // Print the structured data from DESPPD, as described by its field table
+    pField = PakFieldTable( PAKFT_DESPPD );
+    for ( i = 0; i < sizeof( apszDesGroups ) / sizeof( PSZ ) && pField->pszName; i++ ) {
+        cFields = FieldGroupSize( pField, &cchPrefix );
+        print_fieldbox( apszDesGroups[ i ], pField, cFields, cchPrefix, &desPPD, pOut );
+        pField += cFields;
+    }
+
+    // UI_LIST
+    OutPrintf( pOut, "+--------------------+\n");
+    OutPrintf( pOut, "| stUIList (UI_LIST) |\n");
+    OutPrintf( pOut, "+--------------------+--------------------------------------------------------+\n");
+    for ( cFields = FieldGroupSize( pField, &cchPrefix ); cFields; cFields--, pField++ ) {
+        if ( pField->fs & PF_POINTER ) continue;
+        OutPrintf( pOut, "| %-19s = ", pField->pszName + cchPrefix );
+        print_fieldval( pField, &desPPD, pOut );
+        OutPrintf( pOut, "%45s|\n", "");
+    }
+    puib = desPPD.stUIList.pBlockList;
+    for ( i = 0; puib && desPPD.stUIList.usBlockListSize && i < desPPD.stUIList.usNumOfBlocks; i++ ) {
+        OutPrintf( pOut, "+-----------------------------------------------------------------------------+\n");
+        OutPrintf( pOut, "| pBlockList[ %2d ]:                                                           |\n", i );
+        for ( pf = PakFieldTable( PAKFT_UI_BLOCK ); pf->pszName; pf++ ) {
+            OutPrintf( pOut, "|    %-16s = ", pf->pszName );
+            print_fieldval( pf, puib, pOut );
+            OutPrintf( pOut, "%45s|\n", "");
+        }
+        OutPrintf( pOut, "|    uiEntry[]................................................................|\n");
+        for ( j = 0; j < puib->usNumOfEntries; j++ ) {
+            OutPrintf( pOut, "|    : %2d:", j );
+            for ( pf = PakFieldTable( PAKFT_UI_ENTRY ); pf->pszName; pf++ )
+                OutPrintf( pOut, "%s%s = %#6lx", ( pf->usOffset ) ? "   " : "  ", pf->pszName,
+                           (ULONG) PakFieldValue( pf, puib->uiEntry + j ) & 0xFFFF );
+            OutPrintf( pOut, " :|\n");
+        }
+        OutPrintf( pOut, "|    .........................................................................|\n");
+        INCREMENT_BLOCK_PTR( puib );
+    }
+    OutPrintf( pOut, "+-----------------------------------------------------------------------------+\n\n");
+
+    // UIC_LIST
+    OutPrintf( pOut, "+----------------------+\n");
+    OutPrintf( pOut, "| stUICList (UIC_LIST) |\n");
+    OutPrintf( pOut, "+----------------------+------------------------------------------------------+\n");
+    for ( cFields = FieldGroupSize( pField, &cchPrefix ); cFields; cFields--, pField++ ) {
+        if ( pField->fs & PF_POINTER ) continue;
+        OutPrintf( pOut, "| %-23s = ", pField->pszName + cchPrefix );
+        print_fieldval( pField, &desPPD, pOut );
+        OutPrintf( pOut, "%41s|\n", "");
+    }
+    puicb = desPPD.stUICList.puicBlockList;
+    for ( i = 0; puicb && i < desPPD.stUICList.usNumOfUICs; i++ ) {
+        OutPrintf( pOut, "+-----------------------------------------------------------------------------+\n");
+        OutPrintf( pOut, "| puicBlockList[ %2d ]:                                                        |\n", i );
+        for ( pf = PakFieldTable( PAKFT_UIC_BLOCK ); pf->pszName; pf++ ) {
+            OutPrintf( pOut, "|    %-20s =", pf->pszName );
+            if ( pf->fs & PF_HEX )
+                OutPrintf( pOut, "%#10lx", (ULONG) PakFieldValue( pf, puicb ));
+            else {
+                OutPrintf( pOut, " ");
+                print_fieldval( pf, puicb, pOut );
+            }
+            OutPrintf( pOut, "%41s|\n", "");
+        }
+        puicb++;
+    }
+    OutPrintf( pOut, "+-----------------------------------------------------------------------------+\n\n");
+
+    OutPrintf( pOut, "\n-------------------------------------------------------------------------------");
+    OutPrintf( pOut, "\n                            INFORMATION SEGMENT                                ");
+    OutPrintf( pOut, "\n-------------------------------------------------------------------------------\n");
+    PrettyBytes( pInfoSeg, cbIS, pOut );
+    OutPrintf( pOut, "\n");
+
+cleanup:
+    ArenaRelease( pArena, ulMark );
+    if ( pArena == &arLocal ) ArenaFree( &arLocal );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * OffsetToCommand                                                           *
+ *                                                                           *
+ * Given an offset into the data buffer, convert the compressed command      *
+ * string at that address into a normal, readable string.  Any newline chars *
+ * will be stripped out in order to improve readability.  The string will be *
+ * enclosed in quotes.                                                       *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   SHORT sOff: Offset into the data buffer pIn                             *
+ *   PBYTE pIn : Pointer to the input data buffer                            *
+ *   PBYTE pOut: Pointer to a buffer into which the output string will be    *
+ *               written (the buffer is assumed to be large enough)          *
+ *   PPAKARENA pArena: Arena for work space (NULL to use the C heap)         *
+ *                                                                           *
+ * RETURNS: PSZ                                                              *
+ *   Modified string (same as pOut)                                          *
+ * ------------------------------------------------------------------------- */
+PSZ OffsetToCommand( SHORT sOff, PBYTE pIn, PBYTE pOut, PPAKARENA pArena )
+{
+    PSZ    pszTmp;
+    USHORT usRC;
+    ULONG  ulMark = 0;
+
+    if ( !pIn || !pOut || sOff < 1 )
+        strcpy( pOut, "(none)");
+    else {
+        usRC = ExpandString( pArena, OFFSET_TO_PSZ( sOff, pIn ), pOut );
+        if ( usRC ) {
+            if ( pArena ) {
+                ulMark = ArenaMark( pArena );
+                pszTmp = (PSZ) ArenaAlloc( pArena, usRC + 3 );
+            }
+            else
+                pszTmp = (PSZ) calloc( usRC + 3, sizeof( char ));
+            if ( pszTmp ) {
+                USHORT i, j;
+
+                sprintf( pszTmp, "\"%s\"", (PSZ) pOut );
+                usRC = strlen( pszTmp );
+                for ( i = 0, j = 0; i < usRC; i++ ) {
+                    if ( pszTmp[ i ] != '\r' && pszTmp[ i ] != '\n')
+                        pOut[ j++ ] = pszTmp[ i ];
+                }
+                pOut[ j ] = 0;
+                if ( pArena )
+                    ArenaRelease( pArena, ulMark );
+                else
+                    free( pszTmp );
+            }
+        }
+        else if ( *((PSZ) pIn + sOff ))
+            strcpy( pOut, (PSZ) pIn + sOff );
+        else
+            strcpy( pOut, "(none)");
+    }
+    return ( pOut );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * OffsetToProperCommand                                                     *
+ *                                                                           *
+ * Given an offset into the data buffer, convert the compressed command      *
+ * string at that address into a normal, readable string.  Any non-ASCII     *
+ * characters will be replaced with hex strings.  The string is not quoted.  *
+ * Basically, this function is used for the *JCL command strings, which may  *
+ * contain odd byte values which won't be handled normally.  It also doesn't *
+ * check that the offset is > 0, because for the first three JCL commands,   *
+ * the correct offset could well BE 0 (as they appear, if they exist at all, *
+ * right at the start of the data segment).                                  *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   SHORT sOff: Offset into the data buffer pIn                             *
+ *   PBYTE pIn : Pointer to the input data buffer                            *
+ *   PBYTE pOut: Pointer to a buffer into which the output string will be    *
+ *               written (the buffer is assumed to be large enough)          *
+ *   PPAKARENA pArena: Arena for work space (NULL to use the C heap)         *
+ *                                                                           *
+ * RETURNS: PSZ                                                              *
+ *   Modified string (same as pOut)                                          *
+ * ------------------------------------------------------------------------- */
+PSZ OffsetToProperCommand( SHORT sOff, PBYTE pIn, PBYTE pOut, PPAKARENA pArena )
+{
+    PSZ    pszTmp;
+    USHORT usRC;
+    ULONG  ulMark = 0;
+
+    if ( !pIn || !pOut || sOff < 0 )
+        strcpy( pOut, "");
+    else {
+        usRC = ExpandString( pArena, (PSZ) pIn+sOff, pOut );
+        if ( usRC ) {
+            if ( pArena ) {
+                ulMark = ArenaMark( pArena );
+                pszTmp = (PSZ) ArenaAlloc( pArena, 4 * usRC + 1 );
+            }
+            else
+                pszTmp = (PSZ) calloc( 4 * usRC + 1, sizeof( char ));
+            if ( pszTmp ) {
+                USHORT i, j;
+
+                strcpy( pszTmp, (PSZ) pOut );
+                usRC = strlen( pszTmp );
+                for ( i = 0, j = 0; i < usRC; i++ ) {
+                    if ( pszTmp[ i ] < 32 || pszTmp[ i ] > 127 ) {
+                        sprintf( (PSZ) pOut+j, "<%02X>", pszTmp[ i ] );
+                        j+= 4;
+                    }
+                    else pOut[ j++ ] = pszTmp[ i ];
+                }
+                pOut[ j ] = 0;
+                if ( pArena )
+                    ArenaRelease( pArena, ulMark );
+                else
+                    free( pszTmp );
+            }
+        }
+        else if ( *((PSZ) pIn + sOff ))
+            strcpy( pOut, (PSZ) pIn + sOff );
+        else
+            strcpy( pOut, "");
+    }
+    return ( pOut );
+}
+
+
+/* ------------------------------------------------------------------------- */
+void ShowReadableData( PAK_DEV_DIRENTRY pdd, PBYTE pBuf, PPAKARENA pArena, POUTBUF pOut )
+{
+    DESPPD     desPPD = {0};
+    PBYTE      pInfoSeg,
+               pScratch;
+    PUI_BLOCK  puib;
+    PUIC_BLOCK puicb;
+    ULONG      ulCB;
+    USHORT     i, j;
+    PSHORT     psVal;
+    PLONG      plVal;
+    SHORT      sIdx, sPDX, sPDY;
+    PSZ        psz;
+    PAKARENA   arLocal;
+    ULONG      ulMark;
+
+
+    ulCB = sizeof( DESPPD );
+    memcpy( (PBYTE) &desPPD, pBuf, ulCB );
+    pInfoSeg = pBuf + ulCB;
+
+    // Allocate and copy the dynamic data items in DESPPD
+    pArena = ArenaForSegment( pArena, &arLocal, &desPPD );
+    ulMark = ArenaMark( pArena );
+    ulCB = desPPD.stUIList.usBlockListSize;
+    desPPD.stUIList.pBlockList = (PUI_BLOCK) ArenaAlloc( pArena, ulCB );
+    if ( !desPPD.stUIList.pBlockList ) goto cleanup;
+    memcpy( desPPD.stUIList.pBlockList, (PUI_BLOCK) pInfoSeg, ulCB );
+    pInfoSeg += ulCB;
+
+    ulCB = desPPD.stUICList.usNumOfUICs * sizeof( UIC_BLOCK );
+    desPPD.stUICList.puicBlockList = (PUIC_BLOCK) ArenaAlloc( pArena, ulCB );
+    if ( !desPPD.stUICList.puicBlockList ) goto cleanup;
+    memcpy( desPPD.stUICList.puicBlockList, (PUIC_BLOCK) pInfoSeg, ulCB );
+    pInfoSeg += ulCB;
+    desPPD.pPSStringBuff = pInfoSeg;
+
+    // Create a scratch buffer for decompressing strings
+    pScratch = (PBYTE) ArenaAlloc( pArena, desPPD.desItems.iSizeBuffer );
+    if ( !pScratch ) goto cleanup;
+
+    // Print header
+    OutPrintf( pOut, "==============================================================================\n");
+    OutPrintf( pOut, "PRINTER PAK ENTRY  -  \"%s\"\n", pdd.szDeviceName );
+    OutPrintf( pOut, "==============================================================================\n");
+
+    OutPrintf( pOut, "\nBasic Data\n----------\n");
+    OutPrintf( pOut, "Language level:                      %d\n", desPPD.desItems.usLanguageLevel );
+    OutPrintf( pOut, "Password:                            %s\n", OFFSET_TO_PSZ( desPPD.desItems.ofsPswrd, pInfoSeg ));
+    OutPrintf( pOut, "PPM:                                 %d\n", desPPD.desItems.iPpm );
+    OutPrintf( pOut, "FreeVM:                              %d\n", desPPD.desItems.lFreeVM );
+    // AFAIK desPPD.desItems.ofsPrType is not used, but show it anyway
+    OutPrintf( pOut, "Printer type:                        %s\n", OFFSET_TO_PSZ( desPPD.desItems.ofsPrType, pInfoSeg ));
+    OutPrintf( pOut, "Printer name:                        %s\n", (PSZ)( pInfoSeg + desPPD.desItems.ofsPrName ));
+    OutPrintf( pOut, "ColorDevice:                         %d\n", desPPD.desItems.fIsColorDevice );
+    OutPrintf( pOut, "FileSystem:                          %d\n", desPPD.desItems.fIsFileSystem );
+    OutPrintf( pOut, "PC Filename:                         %s\n", (desPPD.desItems.ofsPCFileName >= 0) ?
+                                                        (PSZ)( pInfoSeg + desPPD.desItems.ofsPCFileName ) :
+                                                        "(none)");
+    OutPrintf( pOut, "Default DPI:                         %d\n", desPPD.desItems.iResDpi );
+#if PSDRIVER == 1
+    OutPrintf( pOut, "TrueType font support:               %d\n", desPPD.desItems.fTTSupport );
+#endif
+
+    // I don't think the following are actually used; the available resolutions
+    // are apparently defined only as UIOption items.
+    if ( desPPD.desItems.ResList.uNumOfRes ) {
+        if ( desPPD.desItems.ResList.bIsJCLResolution )
+            OutPrintf( pOut, "Defined JCL resolutions (%d)\n", desPPD.desItems.ResList.uNumOfRes );
+        else
+            OutPrintf( pOut, "Defined resolutions (%d)\n", desPPD.desItems.ResList.uNumOfRes );
+        if ( desPPD.desItems.ResList.uResOffset > 0 ) {
+            psVal = (PSHORT)((PBYTE)(pInfoSeg + desPPD.desItems.ResList.uResOffset));
+            for ( i = 0; i < desPPD.desItems.ResList.uNumOfRes; i++ ) {
+                OutPrintf( pOut, " - %d\n", *psVal );
+                psVal++;
+            }
+        }
+    }
+
+    OutPrintf( pOut, "ScreenAngle:                         %d\n", desPPD.desItems.iScreenAngle );
+    OutPrintf( pOut, "ScreenFreq:                          %d\n", desPPD.desItems.lScrFreq );
+    OutPrintf( pOut, "Reset command:                       %s\n", OFFSET_TO_PSZ( desPPD.desItems.ofsReset, pInfoSeg ));
+    OutPrintf( pOut, "ExitServer command:                  %s\n", OffsetToCommand( desPPD.desItems.ofsExitserver, pInfoSeg, pScratch, pArena ));
+    OutPrintf( pOut, "Transfer Normalized command:         %s\n", OffsetToCommand( desPPD.desItems.ofsTransferNor, pInfoSeg, pScratch, pArena ));
+    OutPrintf( pOut, "Transfer Normalized.Inverse command: %s\n", OffsetToCommand( desPPD.desItems.ofsTransferInv, pInfoSeg, pScratch, pArena ));
+    psz = OffsetToProperCommand( desPPD.desItems.ofsInitString, pInfoSeg, pScratch, pArena );
+    OutPrintf( pOut, "JCLBegin/InitPostScriptMode command: %s\n", strlen(psz)? psz: "(none)");
+    psz = OffsetToProperCommand( desPPD.desItems.ofsJCLToPS, pInfoSeg, pScratch, pArena );
+    OutPrintf( pOut, "JCLToPSInterpreter command:          %s\n", strlen(psz)? psz: "(none)");
+    psz = OffsetToProperCommand( desPPD.desItems.ofsTermString, pInfoSeg, pScratch, pArena );
+    OutPrintf( pOut, "JCLEnd/TermPostScriptMode command:   %s\n", strlen(psz)? psz: "(none)");
+
+    OutPrintf( pOut, "\nPage Properties\n---------------\n");
+    // Several of these appear to be deprecated in favour of UI items and are
+    // unused:
+    //   desPage.iCmpgpairs
+    //   desPage.ofsLspgCmnds
+    //   OutPrintf( pOut, "Default page size:                   %s\n", OFFSET_TO_PSZ( desPPD.desPage.ofsDfpgsz, pInfoSeg ));
+    //   OutPrintf( pOut, "Default imageable area:              %s\n", OFFSET_TO_PSZ( desPPD.desPage.ofsDefimagearea, pInfoSeg ));
+    //   OutPrintf( pOut, "Default paper dimensions:            %s\n", OFFSET_TO_PSZ( desPPD.desPage.ofsDefpaperdim, pInfoSeg ));
+    OutPrintf( pOut, "Variable paper:                      %d\n", desPPD.desPage.fIsVariablePaper );
+    OutPrintf( pOut, "Paper dimension pairs:               %d\n", desPPD.desPage.iDmpgpairs );
+    psVal = (PSHORT)( pInfoSeg + desPPD.desPage.ofsDimxyPgsz );
+    for ( i = 0; i < desPPD.desPage.iDmpgpairs; i++ ) {
+        sIdx = (SHORT) *psVal;
+        psVal++;
+        sPDX = (SHORT) *psVal;
+        psVal++;
+        sPDY = (SHORT) *psVal;
+        psVal++;
+        OutPrintf( pOut, "  %2d - %4d %4d\n", sIdx, sPDX, sPDY );
+    }
+    OutPrintf( pOut, "Imageable coordinate pairs: %d\n", desPPD.desPage.iImgpgpairs );
+    psVal = (PSHORT)( pInfoSeg + desPPD.desPage.ofsImgblPgsz );
+    for ( i = 0; i < desPPD.desPage.iImgpgpairs; i++ ) {
+        sIdx = (SHORT) *psVal;
+        psVal++;
+        sPDX = (SHORT) *psVal;
+        psVal++;
+        sPDY = (SHORT) *psVal;
+        psVal++;
+        OutPrintf( pOut, "  %2d - %4d %4d ", sIdx, sPDX, sPDY );
+        sPDX = (SHORT) *psVal;
+        psVal++;
+        sPDY = (SHORT) *psVal;
+        psVal++;
+        psz = (PSZ) psVal;
+        OutPrintf( pOut, "%4d %4d  (%s)\n", sPDX, sPDY, Cp850String( pArena, psz ));
+        psVal = (PSHORT) ((PSZ)( psz + strlen( psz ) + 1 ));
+    }
+    OutPrintf( pOut, "Custom Page Size command:            %s\n", OffsetToCommand( desPPD.desPage.ofsCustomPageSize, pInfoSeg, pScratch, pArena ));
+    OutPrintf( pOut, "Custom Page min width:               %d\n", desPPD.desPage.iCustomPageSizeMinWidth );
+    OutPrintf( pOut, "Custom Page max width:               %d\n", desPPD.desPage.iCustomPageSizeMaxWidth );
+    OutPrintf( pOut, "Custom Page min height:              %d\n", desPPD.desPage.iCustomPageSizeMinHeight );
+    OutPrintf( pOut, "Custom Page max height:              %d\n", desPPD.desPage.iCustomPageSizeMaxHeight );
+
+    OutPrintf( pOut, "\nInput Trays\n-----------\n");
+    // None of these items actually seem to be used or set anywhere; they
+    // are presumably deprecated, as input slots are defined as UI items
+    // (under desPPD.stUIList) in practice.
+    OutPrintf( pOut, "Manual Feed:                         %d\n", desPPD.desInpbins.iManualfeed );
+    OutPrintf( pOut, "Manual Feed set command:             %s\n", OffsetToCommand( desPPD.desInpbins.ofsManualtrue, pInfoSeg, pScratch, pArena ));
+    OutPrintf( pOut, "Manual Feed unset disable:           %s\n", OffsetToCommand( desPPD.desInpbins.ofsManualfalse, pInfoSeg, pScratch, pArena ));
+    OutPrintf( pOut, "Default input tray:                  %s\n", OFFSET_TO_PSZ( desPPD.desInpbins.ofsDefinputslot, pInfoSeg ));
+    OutPrintf( pOut, "Input tray pairs:                    %d\n", desPPD.desInpbins.iInpbinpairs );
+    OutPrintf( pOut, "Input tray paper sizes:              %d\n", desPPD.desInpbins.iNumOfPageSizes );
+    // No need to even try to handle desPPD.desInpbins.ofsCmInpbins or
+    // desPPD.desInpbins.ofsPageSizes -- they are deprecated and no longer used
+
+    OutPrintf( pOut, "\nOutput Trays\n------------\n");
+    OutPrintf( pOut, "Default output order:                %s\n", ( desPPD.desOutbins.fIsDefoutorder? "Reverse": "Normal" ));
+    OutPrintf( pOut, "Normal Output command:               %s\n", OffsetToCommand( desPPD.desOutbins.ofsOrdernormal, pInfoSeg, pScratch, pArena ));
+    OutPrintf( pOut, "Reverse Output command:              %s\n", OffsetToCommand( desPPD.desOutbins.ofsOrderreverse, pInfoSeg, pScratch, pArena ));
+    OutPrintf( pOut, "Default output tray:                 %s\n", OFFSET_TO_PSZ( desPPD.desOutbins.ofsDefoutputbin, pInfoSeg )); // not used?
+    OutPrintf( pOut, "Output tray pairs:                   %d\n", desPPD.desOutbins.iOutbinpairs );
+    // desPPD.desOutbins.ofsCmOutbins is not used or set anywhere, so ignore it
+
+    OutPrintf( pOut, "\nFonts\n-----\n");
+    OutPrintf( pOut, "Default font:                        %s\n", OFFSET_TO_PSZ( desPPD.desFonts.ofsDeffont, pInfoSeg ));
+    OutPrintf( pOut, "Supported hardware fonts:            %d\n", desPPD.desFonts.iFonts );
+    psz = OFFSET_TO_PSZ( desPPD.desFonts.ofsFontnames, pInfoSeg );
+    for ( i = 0; (i < desPPD.desFonts.iFonts) && *psz; i++ ) {
+        OutPrintf( pOut, "  - %s\n", psz );
+        psz += strlen( psz ) + 1;
+    }
+
+    OutPrintf( pOut, "\nForms\n-----\n");
+    // Not entirely sure these are used at all either
+    OutPrintf( pOut, "Number of forms:                     %d\n", desPPD.desForms.usFormCount );
+    if ( desPPD.desForms.usFormCount ) {
+        plVal = (PLONG)(pInfoSeg + desPPD.desForms.ofsFormIndex);
+        for ( i = 0; (i < desPPD.desForms.usFormCount) && *psz; i++ ) {
+            OutPrintf( pOut, "  - %s\n", OffsetToCommand( (SHORT) *plVal, pInfoSeg, pScratch, pArena ));
+            plVal++;
+        }
+    }
+
+    OutPrintf( pOut, "\n\nUser Interface Items\n--------------------\n");
+    OutPrintf( pOut, "Total size of UI list:               %d\n", desPPD.stUIList.usBlockListSize );
+    OutPrintf( pOut, "Number of UI items:                  %d\n", desPPD.stUIList.usNumOfBlocks );
+    puib = desPPD.stUIList.pBlockList;
+    for ( i = 0; puib && desPPD.stUIList.usBlockListSize && i < desPPD.stUIList.usNumOfBlocks; i++ ) {
+        OutPrintf( pOut, "\n* \"%s\"  (%d)\n", OFFSET_TO_PSZ( puib->ofsUIName, pInfoSeg ), i );
+        OutPrintf( pOut, "   Translation string:               \"%s\"\n", Cp850String( pArena, OFFSET_TO_PSZ( puib->ofsUITransString, pInfoSeg )));
+        OutPrintf( pOut, "   Order index value:                %d\n", puib->usOrderDep );
+        OutPrintf( pOut, "   Display order:                    %d\n", puib->usDisplayOrder );
+        OutPrintf( pOut, "   Location:                         ");
+        switch( puib->usUILocation ) {
+            case UI_ORDER_ANYSETUP   : OutPrintf( pOut, "Any\n");        break;
+            case UI_ORDER_JCLSETUP   : OutPrintf( pOut, "JCL\n");        break;
+            case UI_ORDER_PAGESETUP  : OutPrintf( pOut, "Page\n");       break;
+            case UI_ORDER_DOCSETUP   : OutPrintf( pOut, "Document\n");   break;
+            case UI_ORDER_PROLOGSETUP: OutPrintf( pOut, "Prolog\n");     break;
+            case UI_ORDER_EXITSERVER : OutPrintf( pOut, "ExitServer\n"); break;
+            default                  : OutPrintf( pOut, "Unknown\n");    break;
+        }
+        OutPrintf( pOut, "   UI selection type:                ");
+        switch( puib->usSelectType ) {
+            case UI_SELECT_BOOLEAN : OutPrintf( pOut, "Boolean\n");  break;
+            case UI_SELECT_PICKMANY: OutPrintf( pOut, "PickMany\n"); break;
+            case UI_SELECT_PICKONE : OutPrintf( pOut, "PickOne\n");  break;
+            default                : OutPrintf( pOut, "Unknown\n");  break;
+        }
+        OutPrintf( pOut, "   Scope:                            %s\n",
+                ( puib->ucGroupType == UIGT_INSTALLABLEOPTION ) ? "Printer property": "Job property");
+        OutPrintf( pOut, "   Panel ID:                         ");
+        switch ( puib->ucPanelID ) {
+            case UIP_OS2_FEATURE   : OutPrintf( pOut, "IBM\n");  break;
+            case UIP_OEM_FEATURE   : OutPrintf( pOut, "OEM\n");  break;
+            case UIP_PREDEF_FEATURE: OutPrintf( pOut, "Predefined\n");  break;
+            default                : OutPrintf( pOut, "Unknown\n");  break;
+        }
+        OutPrintf( pOut, "   Default value:                    %d\n", puib->usDefaultEntry );
+        OutPrintf( pOut, "   Number of values:                 %d\n", puib->usNumOfEntries );
+        if ( puib->usNumOfEntries ) {
+            for ( j = 0; j < puib->usNumOfEntries; j++ ) {
+                OutPrintf( pOut, "   - Name:                           \"%s\"  (%d)\n", OFFSET_TO_PSZ( puib->uiEntry[j].ofsOption, pInfoSeg ), j );
+                OutPrintf( pOut, "     Translation:                    \"%s\"\n", Cp850String( pArena, OFFSET_TO_PSZ( puib->uiEntry[j].ofsTransString, pInfoSeg )));
+                OutPrintf( pOut, "     Value:                          %s\n", OffsetToCommand( puib->uiEntry[j].ofsValue, pInfoSeg, pScratch, pArena ));
+            }
+        }
+        INCREMENT_BLOCK_PTR( puib );
+    }
+
+    OutPrintf( pOut, "\n\nUser Interface Constraints\n--------------------------\n");
+    OutPrintf( pOut, "Number of mutually exlusive item sets: %d\n", desPPD.stUICList.usNumOfUICs );
+    puicb = desPPD.stUICList.puicBlockList;
+    for ( i = 0; puicb && i < desPPD.stUICList.usNumOfUICs; i++ ) {
+
+        /*
+        ** Despite the name, the "ofsUIBlock" values are not pointer offsets;
+        ** rather, they are the index of the corresponding UI_LIST item in
+        ** "stUIList.pBlockList".  "bOption" is a bitmap flagging the affected
+        ** values (that is, items in the item's uiEntry[] array).  e.g.
+        **      ofsUIBlock = 2
+        **      bOption    = 13  (binary 1101)
+        ** indicates the 1st, 3rd, and 4th values of the third UI item.
+        */
+        puib = desPPD.stUIList.pBlockList;
+        for ( j = 0; j < puicb->uicEntry1.ofsUIBlock; j++ )
+            INCREMENT_BLOCK_PTR( puib );
+        OutPrintf( pOut, " - (%s", OFFSET_TO_PSZ( puib->ofsUIName, pInfoSeg ));
+        if ( puicb->uicEntry1.bOption ) {
+            OutPrintf( pOut, " ==");
+            for ( j = 0; j < 32 && j < puib->usNumOfEntries; j++ ) {
+                if (( puicb->uicEntry1.bOption >> j ) & 1 )
+                    OutPrintf( pOut, " %s", OFFSET_TO_PSZ( puib->uiEntry[j].ofsOption, pInfoSeg ));
+            }
+        }
+        OutPrintf( pOut, ") with ");
+
+        puib = desPPD.stUIList.pBlockList;
+        for ( j = 0; j < puicb->uicEntry2.ofsUIBlock; j++ )
+            INCREMENT_BLOCK_PTR( puib );
+        OutPrintf( pOut, "(%s", OFFSET_TO_PSZ( puib->ofsUIName, pInfoSeg ));
+        if ( puicb->uicEntry2.bOption ) {
+            OutPrintf( pOut, " ==");
+            for ( j = 0; j < 32 && j < puib->usNumOfEntries; j++ ) {
+                if (( puicb->uicEntry2.bOption >> j ) & 1 )
+                    OutPrintf( pOut, " %s", OFFSET_TO_PSZ( puib->uiEntry[j].ofsOption, pInfoSeg ));
+            }
+        }
+        OutPrintf( pOut, ")\n");
+
+        puicb++;
+    }
+
+cleanup:
+    ArenaRelease( pArena, ulMark );
+    if ( pArena == &arLocal ) ArenaFree( &arLocal );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PrintToPPD                                                                *
+ *                                                                           *
+ * Print a parameter/string value pair, formatted for PPD output.            *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ pszName   : Name of the parameter as it will appear in the PPD      *
+ *                   (must start with * and include a trailing colon)        *
+ *   SHORT usOffset: Offset of the string value within the buffer            *
+ *   PBYTE pBuf    : Data buffer from the PAK file                           *
+ *   PSZ pszDefault: Default value in case there is no value defined in the  *
+ *                   buffer; specify NULL to omit the parameter entirely in  *
+ *                   such a case                                             *
+ *                                                                           *
+ * RETURNS: N/A                                                              *
+ * ------------------------------------------------------------------------- */
+void PrintToPPD( PSZ pszName, SHORT usOffset, PBYTE pBuf, PSZ pszDefault, POUTBUF pOut )
+{
+    if ( usOffset < 1 ) {
+        if ( pszDefault ) OutPrintf( pOut, "%-23s \"%s\"\n", pszName, pszDefault );
+    }
+    else
+        OutPrintf( pOut, "%-23s \"%s\"\n", pszName, OFFSET_TO_PSZ( usOffset, pBuf ));
+
+    return;
+}
+
+
+/* ------------------------------------------------------------------------- */
+void GeneratePPD( PBYTE pBuf, PPAKARENA pArena, POUTBUF pOut )
+{
+    DESPPD     desPPD = {0};        // structure of main descriptor segment
+    PBYTE      pInfoSeg,            // pointer to free-form information segment
+               pScratch;            // work buffer, mostly for decompressing commands
+    PUI_BLOCK  puib,                // pointer to a UI block
+               puiPaper;            // pointer to the PageSize UI block
+    PUIC_BLOCK puicb;               // pointer to a UI constraints block
+    ULONG      ulCB;
+    USHORT     usRC,
+               i, j, k;
+    PSHORT     psVal;
+    PLONG      plVal;
+    SHORT      sIdx,                // form index cross-reference
+               sX1, sY1, sX2, sY2;  // area coordinates
+    PSZ        psz,                 // general-purpose string pointer
+               pszName,             // current UI item or form name
+               pszXlate,            // current UI item or form translation name
+               pszDefault,          // current UI item default
+               pszDefPage;          // name of default PageSize
+    BOOL       fInstallable = FALSE; // in the InstallableOptions group
+    PAKARENA   arLocal;             // scratch arena, if none supplied
+    ULONG      ulMark;              // arena level on entry
+
+
+    // Copy the buffer contents into our data structure
+    ulCB = sizeof( DESPPD );
+    memcpy( (PBYTE) &desPPD, pBuf, ulCB );
+    pInfoSeg = pBuf + ulCB;
+
+    // Allocate and copy the dynamic data items in DESPPD
+    pArena = ArenaForSegment( pArena, &arLocal, &desPPD );
+    ulMark = ArenaMark( pArena );
+    ulCB = desPPD.stUIList.usBlockListSize;
+    desPPD.stUIList.pBlockList = (PUI_BLOCK) ArenaAlloc( pArena, ulCB );
+    if ( !desPPD.stUIList.pBlockList ) goto cleanup;
+    memcpy( desPPD.stUIList.pBlockList, (PUI_BLOCK) pInfoSeg, ulCB );
+    pInfoSeg += ulCB;
+
+    ulCB = desPPD.stUICList.usNumOfUICs * sizeof( UIC_BLOCK );
+    desPPD.stUICList.puicBlockList = (PUIC_BLOCK) ArenaAlloc( pArena, ulCB );
+    if ( !desPPD.stUICList.puicBlockList ) goto cleanup;
+    memcpy( desPPD.stUICList.puicBlockList, (PUIC_BLOCK) pInfoSeg, ulCB );
+    pInfoSeg += ulCB;
+    desPPD.pPSStringBuff = pInfoSeg;
+
+    // Create a scratch buffer for decompressing strings
+    pScratch = (PBYTE) ArenaAlloc( pArena, desPPD.desItems.iSizeBuffer );
+    if ( !pScratch ) goto cleanup;
+
+    //
+    // Required headers
+    //
+    OutPrintf( pOut, "*PPD-Adobe:             \"4.3\"\n");
+    OutPrintf( pOut, "*FormatVersion:         \"4.3\"\n");
+    OutPrintf( pOut, "*FileVersion:           \"1.0\"\n");
+    OutPrintf( pOut, "*LanguageVersion:       English\n");
+    // Translation strings are converted to UTF-8 (see Cp850String), so PIN,
+    // which reads code page 850, needs the file converted back before import
+    OutPrintf( pOut, "*LanguageEncoding:      UTF-8\n");
+    OutPrintf( pOut, "*Manufacturer:          \"Autogenerated by pakfile utility\"\n");
+
+    //
+    // Identification & version parameters
+    //
+    OutPrintf( pOut, "*Product:               \"(%s)\"\n", (PSZ)( pInfoSeg + desPPD.desItems.ofsPrName ));
+    OutPrintf( pOut, "*ModelName:             \"%s\"\n",   (PSZ)( pInfoSeg + desPPD.desItems.ofsPrName ));
+    OutPrintf( pOut, "*ShortNickName:         \"%s\"\n",   (PSZ)( pInfoSeg + desPPD.desItems.ofsPrName ));
+    OutPrintf( pOut, "*NickName:              \"%s\"\n",   (PSZ)( pInfoSeg + desPPD.desItems.ofsPrName ));
+    OutPrintf( pOut, "*PCFileName:            \"%s\"\n", (desPPD.desItems.ofsPCFileName >= 0) ?
+                                               (PSZ)( pInfoSeg + desPPD.desItems.ofsPCFileName ) :
+                                               "PRINTER.PPD");
+    OutPrintf( pOut, "*PSVersion:             \"(%d) 001\"\n", ((desPPD.desItems.usLanguageLevel < 2) ? 0 :
+                                                      (desPPD.desItems.usLanguageLevel * 1000)) + 10 );
+    OutPrintf( pOut, "*LanguageLevel:         \"%d\"\n", desPPD.desItems.usLanguageLevel );
+
+    //
+    // Basic capabilities
+    //
+    OutPrintf( pOut, "*ColorDevice:           %s\n", (desPPD.desItems.fIsColorDevice == 1) ? "True": "False");
+    OutPrintf( pOut, "*FileSystem:            %s\n", (desPPD.desItems.fIsFileSystem == 1)  ? "True": "False");
+#if PSDRIVER == 1
+    if ( desPPD.desItems.fTTSupport == 1 )
+        OutPrintf( pOut, "*TTRasterizer:          Type42\n");
+#endif
+    if ( desPPD.desItems.iPpm > 0 )
+        OutPrintf( pOut, "*Throughput:            \"%d\"\n", desPPD.desItems.iPpm );
+    // Sizes of 2 GB and more have wrapped round, so treat this as unsigned
+    if ( desPPD.desItems.lFreeVM != 0 )
+        OutPrintf( pOut, "*FreeVM:                \"%lu\"\n", (ULONG) desPPD.desItems.lFreeVM );
+
+    PrintToPPD("*Password:", desPPD.desItems.ofsPswrd, pInfoSeg, NULL, pOut );
+    if (( desPPD.desItems.ofsReset > 0 ) &&
+        ( ExpandString( pArena, OFFSET_TO_PSZ( desPPD.desItems.ofsReset, pInfoSeg ), pScratch ) > 0 ))
+    {
+        OutPrintf( pOut, "*Reset:                 \"%s\"\n", pScratch );
+    }
+    if (( desPPD.desItems.ofsExitserver > 0 ) &&
+        ( ExpandString( pArena, OFFSET_TO_PSZ( desPPD.desItems.ofsExitserver, pInfoSeg), pScratch ) > 0 ))
+    {
+        OutPrintf( pOut, "*ExitServer:            \"%s\"\n", pScratch );
+    }
+    if ( desPPD.desItems.ofsInitString >= 0 )
+        OutPrintf( pOut, "*JCLBegin:              \"%s\"\n",
+                OffsetToProperCommand( desPPD.desItems.ofsInitString, pInfoSeg, pScratch, pArena ));
+    if ( desPPD.desItems.ofsJCLToPS >= 0 )
+        OutPrintf( pOut, "*JCLToPSInterpreter:    \"%s\"\n",
+                OffsetToProperCommand( desPPD.desItems.ofsJCLToPS, pInfoSeg, pScratch, pArena ));
+    if ( desPPD.desItems.ofsTermString >= 0 )
+        OutPrintf( pOut, "*JCLEnd:                \"%s\"\n",
+                OffsetToProperCommand( desPPD.desItems.ofsTermString, pInfoSeg, pScratch, pArena ));
+
+    //
+    // Halftone options
+    //
+    if ( desPPD.desItems.iScreenAngle > 0 )
+        OutPrintf( pOut, "*ScreenAngle:           \"%.2f\"\n", desPPD.desItems.iScreenAngle / 100.0 );
+    if ( desPPD.desItems.lScrFreq > 0 )
+        OutPrintf( pOut, "*ScreenFreq:            \"%.2f\"\n", desPPD.desItems.lScrFreq / 100.0 );
+    if (( desPPD.desItems.ofsTransferNor > 0 ) &&
+        ( ExpandString( pArena, OFFSET_TO_PSZ( desPPD.desItems.ofsTransferNor, pInfoSeg ), pScratch ) > 0 ))
+    {
+        OutPrintf( pOut, "*Transfer Normalized:   \"%s\"\n", pScratch );
+    }
+    if (( desPPD.desItems.ofsTransferInv > 0 ) &&
+        ( ExpandString( pArena, OFFSET_TO_PSZ( desPPD.desItems.ofsTransferInv, pInfoSeg ), pScratch ) > 0 ))
+    {
+        OutPrintf( pOut, "*Transfer Normalized.Inverse: \"%s\"\n", pScratch );
+    }
+    OutPrintf( pOut, "\n");
+
+    //
+    // Page & media handling
+    //
+
+    /*
+    ** Find the PageSize UI block (every valid PPD should have one) and save a
+    ** pointer to it.  We'll need it at various points from here on down.
+    */
+    puiPaper = NULL;
+    puib = desPPD.stUIList.pBlockList;
+    for ( i = 0; !puiPaper && i < desPPD.stUIList.usBlockListSize; i++ ) {
+        psz = OFFSET_TO_PSZ( puib->ofsUIName, pInfoSeg );
+        if ( !strcmp( psz, "PageSize"))
+            puiPaper = puib;
+        INCREMENT_BLOCK_PTR( puib );
+    }
+    // Make note of the default value; this indicates the default paper size
+    if ( puiPaper && ( puiPaper->usNumOfEntries > puiPaper->usDefaultEntry ))
+        pszDefPage = OFFSET_TO_PSZ( puiPaper->uiEntry[puiPaper->usDefaultEntry].ofsOption, pInfoSeg );
+    else
+        pszDefPage = "Letter";
+
+    OutPrintf( pOut, "*VariablePaperSize:     %s\n", (desPPD.desPage.fIsVariablePaper == 1) ? "True" : "False");
+
+    /*
+    ** The paper commands from desPage, plus everything in desInpbins, are
+    ** basically deprecated; these are all defined as UI items these days.
+    ** So we don't need to handle them (PIN doesn't write any of it into the
+    ** PAK file anyway).
+    ** The same goes for almost everything in desOutbins, but the following
+    ** do appear to be used to some extent.
+    */
+    OutPrintf( pOut, "*DefaultOutputOrder:    %s\n", (desPPD.desOutbins.fIsDefoutorder == REVERSE)? "Reverse": "Normal");
+    if (( desPPD.desOutbins.ofsOrdernormal > 0 ) &&
+        ( ExpandString( pArena, OFFSET_TO_PSZ( desPPD.desOutbins.ofsOrdernormal, pInfoSeg ), pScratch ) > 0 ))
+    {
+        OutPrintf( pOut, "*OutputOrder Normal:  \"%s\"\n", pScratch );
+    }
+    if (( desPPD.desOutbins.ofsOrderreverse > 0 ) &&
+        ( ExpandString( pArena, OFFSET_TO_PSZ( desPPD.desOutbins.ofsOrderreverse, pInfoSeg ), pScratch ) > 0 ))
+    {
+        OutPrintf( pOut, "*OutputOrder Reverse: \"%s\"\n", pScratch );
+    }
+    // It's somewhat less clear, but desForms also seems to be unused nowadays.
+    OutPrintf( pOut, "\n");
+
+    // desPage.ofsDefimagearea is unused; use pszDefPage instead
+    OutPrintf( pOut, "*DefaultImageableArea: %s\n", pszDefPage );
+    psVal = (PSHORT)( pInfoSeg + desPPD.desPage.ofsImgblPgsz );
+    for ( i = 0; i < desPPD.desPage.iImgpgpairs; i++ ) {
+        pszName = NULL;
+        sIdx = (SHORT) *psVal;
+        psVal++;
+        sX1 = (SHORT) *psVal;       // lower left X
+        psVal++;
+        sY1 = (SHORT) *psVal;       // lower left Y
+        psVal++;
+        sX2 = (SHORT) *psVal;       // upper right X
+        psVal++;
+        sY2 = (SHORT) *psVal;       // upper right Y
+        psVal++;
+        pszXlate = (PSZ) psVal;     // translation string (if any)
+
+        // Get the actual form name from the *PageSize UI list
+        if ( puiPaper && ( puiPaper->usNumOfEntries > puiPaper->usDefaultEntry ) &&
+             ( sIdx >= 0 ) && ( sIdx < puiPaper->usNumOfEntries ))
+        {
+            pszName = OFFSET_TO_PSZ( puiPaper->uiEntry[sIdx].ofsOption, pInfoSeg );
+            OutPrintf( pOut, "*ImageableArea %s/%s: \"%d %d %d %d\"\n", pszName,
+                    Cp850String( pArena, *pszXlate? pszXlate: pszName ), sX1, sY1, sX2, sY2 );
+        }
+        psVal = (PSHORT) ((PSZ)( pszXlate + strlen( pszXlate ) + 1 ));
+    }
+    OutPrintf( pOut, "\n");
+
+    // desPage.ofsDefpaperdim is also unused; again, use pszDefPage
+    OutPrintf( pOut, "*DefaultPaperDimension: %s\n", pszDefPage );
+    psVal = (PSHORT)( pInfoSeg + desPPD.desPage.ofsDimxyPgsz );
+    for ( i = 0; i < desPPD.desPage.iDmpgpairs; i++ ) {
+        pszName = NULL;
+        sIdx = (SHORT) *psVal;
+        psVal++;
+        sX1 = (SHORT) *psVal;
+        psVal++;
+        sY1 = (SHORT) *psVal;
+        psVal++;
+
+        // Get the form name from the *PageSize UI list
+        if ( puiPaper && ( puiPaper->usNumOfEntries > puiPaper->usDefaultEntry ) &&
+             ( sIdx >= 0 ) && ( sIdx < puiPaper->usNumOfEntries ))
+        {
+            pszName = OFFSET_TO_PSZ( puiPaper->uiEntry[sIdx].ofsOption, pInfoSeg );
+            pszXlate = ( puiPaper->uiEntry[sIdx].ofsTransString > 0 ) ?
+                         OFFSET_TO_PSZ( puiPaper->uiEntry[sIdx].ofsTransString, pInfoSeg ) :
+                         pszName;
+            OutPrintf( pOut, "*PaperDimension %s/%s: \"%d %d\"\n", pszName,
+                    Cp850String( pArena, pszXlate ), sX1, sY1 );
+        }
+    }
+    OutPrintf( pOut, "\n");
+
+    if (( desPPD.desPage.ofsCustomPageSize > 0 ) &&
+        ( ExpandString( pArena, OFFSET_TO_PSZ( desPPD.desPage.ofsCustomPageSize, pInfoSeg ), pScratch ) > 0 ))
+    {
+        OutPrintf( pOut, "*CustomPageSize True: \"%s\"\n", pScratch );
+        /*
+        ** We have to hardcode the order because the PAK file doesn't contain
+        ** that information.  It's missing a couple of supposedly-required
+        ** parameters as well, but there's nothing we can do about that either.
+        ** Anyway, if they're not in the PAK file, the PS driver obviously
+        ** doesn't need/use them in any case.
+        */
+        OutPrintf( pOut, "*ParamCustomPageSize Width: 1 points %d %d\n",
+                desPPD.desPage.iCustomPageSizeMinWidth,
+                desPPD.desPage.iCustomPageSizeMaxWidth );
+        OutPrintf( pOut, "*ParamCustomPageSize Height: 2 points %d %d\n",
+                desPPD.desPage.iCustomPageSizeMinHeight,
+                desPPD.desPage.iCustomPageSizeMaxHeight );
+        OutPrintf( pOut, "\n");
+    }
+
+    //
+    // Write out the UI constraints, if any
+    //
+    puicb = desPPD.stUICList.puicBlockList;
+    for ( i = 0; puicb && i < desPPD.stUICList.usNumOfUICs; i++ ) {
+        PSZ pszName1, pszName2,
+            pszVal1, pszVal2;
+        PUI_BLOCK puib2;
+
+        puib = desPPD.stUIList.pBlockList;
+        for ( j = 0; j < puicb->uicEntry1.ofsUIBlock; j++ )
+            INCREMENT_BLOCK_PTR( puib );
+        pszName1 = OFFSET_TO_PSZ( puib->ofsUIName, pInfoSeg );
+        if ( puicb->uicEntry1.bOption ) {
+            for ( j = 0; j < 32 && j < puib->usNumOfEntries; j++ ) {
+                if (( puicb->uicEntry1.bOption >> j ) & 1 ) {
+                    pszVal1 = OFFSET_TO_PSZ( puib->uiEntry[j].ofsOption, pInfoSeg );
+                    puib2 = desPPD.stUIList.pBlockList;
+                    for ( k = 0; k < puicb->uicEntry2.ofsUIBlock; k++ )
+                        INCREMENT_BLOCK_PTR( puib2 );
+                    pszName2 = OFFSET_TO_PSZ( puib2->ofsUIName, pInfoSeg );
+                    if ( puicb->uicEntry2.bOption ) {
+                        for ( k = 0; k < 32 && k < puib2->usNumOfEntries; k++ ) {
+                            if (( puicb->uicEntry2.bOption >> k ) & 1 ) {
+                                pszVal2 = OFFSET_TO_PSZ( puib2->uiEntry[k].ofsOption, pInfoSeg );
+                                OutPrintf( pOut, "*UIConstraints: *%s %s *%s %s\n",
+                                        pszName1, pszVal1, pszName2, pszVal2 );
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        puicb++;
+    }
+    OutPrintf( pOut, "\n");
+
+    //
+    // OK, now do the UI items
+    //
+    puib = desPPD.stUIList.pBlockList;
+    for ( i = 0; puib && desPPD.stUIList.usBlockListSize && i < desPPD.stUIList.usNumOfBlocks; i++ ) {
+        psz = OFFSET_TO_PSZ( puib->ofsUIName, pInfoSeg );
+
+        // Installable options are grouped so that they can be told apart
+        if (( puib->ucGroupType == UIGT_INSTALLABLEOPTION ) != fInstallable ) {
+            fInstallable = !fInstallable;
+            if ( fInstallable )
+                OutPrintf( pOut, "*OpenGroup: InstallableOptions/Installable Options\n\n");
+            else
+                OutPrintf( pOut, "*CloseGroup: InstallableOptions\n\n");
+        }
+
+        OutPrintf( pOut, "*OpenUI *%s/%s: ", psz,
+                ( (SHORT) puib->ofsUITransString > 0 ) ?
+                    Cp850String( pArena, OFFSET_TO_PSZ( puib->ofsUITransString, pInfoSeg )) : psz );
+        switch( puib->usSelectType ) {
+            case UI_SELECT_BOOLEAN : OutPrintf( pOut, "Boolean\n");  break;
+            case UI_SELECT_PICKMANY: OutPrintf( pOut, "PickMany\n"); break;
+            case UI_SELECT_PICKONE :
+            default                : OutPrintf( pOut, "PickOne\n");  break;
+        }
+
+        // Write the order dependency line
+        OutPrintf( pOut, "*OrderDependency: %d ", puib->usOrderDep + 1 );
+        switch( puib->usUILocation ) {
+            default:
+            case UI_ORDER_ANYSETUP   : OutPrintf( pOut, "AnySetup ");      break;
+            case UI_ORDER_JCLSETUP   : OutPrintf( pOut, "JCLSetup ");      break;
+            case UI_ORDER_PAGESETUP  : OutPrintf( pOut, "PageSetup ");     break;
+            case UI_ORDER_DOCSETUP   : OutPrintf( pOut, "DocumentSetup "); break;
+            case UI_ORDER_PROLOGSETUP: OutPrintf( pOut, "Prolog ");        break;
+            case UI_ORDER_EXITSERVER : OutPrintf( pOut, "ExitServer ");    break;
+        }
+        OutPrintf( pOut, "*%s\n", psz );
+
+        if ( strcmp( psz, "PageSize") == 0 ) {
+            // We already saved the default, no need to jump through hoops now
+            pszDefault = pszDefPage;
+        }
+        else if ( strcmp( psz, "Resolution") == 0 ) {
+            // Try a few different ways to determine the default resolution
+            if ( puib->usNumOfEntries > puib->usDefaultEntry )
+                pszDefault = OFFSET_TO_PSZ( puib->uiEntry[puib->usDefaultEntry].ofsOption, pInfoSeg );
+            else if ( desPPD.desItems.iResDpi > 0 ) {
+                sprintf( pScratch, "%ddpi", desPPD.desItems.iResDpi );
+                pszDefault = pScratch;
+            }
+            else if ( puib->usNumOfEntries )
+                pszDefault = OFFSET_TO_PSZ( puib->uiEntry[0].ofsOption, pInfoSeg );
+            else
+                pszDefault = "300dpi";
+        }
+        else {
+            // Find the default; if there's no default, just use the first item
+            if ( puib->usNumOfEntries > puib->usDefaultEntry )
+                pszDefault = OFFSET_TO_PSZ( puib->uiEntry[puib->usDefaultEntry].ofsOption, pInfoSeg );
+            else if ( puib->usNumOfEntries )
+                pszDefault = OFFSET_TO_PSZ( puib->uiEntry[0].ofsOption, pInfoSeg );
+            else
+                pszDefault = "Unknown";     // hopefully shouldn't happen
+        }
+        OutPrintf( pOut, "*Default%s: %s\n", psz, pszDefault );
+
+        // Now write the list of actual values
+        for ( j = 0; j < puib->usNumOfEntries; j++ ) {
+            pszName = OFFSET_TO_PSZ( puib->uiEntry[j].ofsOption, pInfoSeg );
+            pszXlate = ( puib->uiEntry[j].ofsTransString > 0 ) ?
+                       OFFSET_TO_PSZ( puib->uiEntry[j].ofsTransString, pInfoSeg ) :
+                       pszName;
+            OutPrintf( pOut, "*%s %s/%s: ", psz, pszName, Cp850String( pArena, pszXlate ));
+            if (( puib->uiEntry[j].ofsValue > 0 ) &&
+                ( ExpandString( pArena, OFFSET_TO_PSZ( puib->uiEntry[j].ofsValue, pInfoSeg ), pScratch ) > 0 ))
+            {
+                OutPrintf( pOut, "\"%s\"\n", pScratch );
+            } else
+                OutPrintf( pOut, "\"\"\n");
+        }
+
+        OutPrintf( pOut, "*CloseUI: *%s\n", psz );
+        OutPrintf( pOut, "\n");
+        INCREMENT_BLOCK_PTR( puib );
+    }
+    if ( fInstallable )
+        OutPrintf( pOut, "*CloseGroup: InstallableOptions\n\n");
+
+    //
+    // Lastly, the supported hardware fonts
+    //
+    if ( desPPD.desFonts.ofsDeffont > 0 )
+        OutPrintf( pOut, "*DefaultFont: %s\n", OFFSET_TO_PSZ( desPPD.desFonts.ofsDeffont, pInfoSeg ));
+    psz = OFFSET_TO_PSZ( desPPD.desFonts.ofsFontnames, pInfoSeg );
+    for ( i = 0; (i < desPPD.desFonts.iFonts) && *psz; i++ ) {
+        // Just use some common values for the encoding/version/status; PIN
+        // doesn't use or care about them anyway.
+        OutPrintf( pOut, "*Font %s: Standard \"(001.006S)\" Standard ROM\n", psz );
+        psz += strlen( psz ) + 1;
+    }
+    OutPrintf( pOut, "\n");
+
+    // And we're done!
+
+    // Clean up
+cleanup:
+    ArenaRelease( pArena, ulMark );
+    if ( pArena == &arLocal ) ArenaFree( &arLocal );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * FindTable                                                                 *
+ *                                                                           *
+ * Find the initializer of an array definition (e.g. "name[] = ...") in the  *
+ * text of a C header file.                                                  *
+ *                                                                           *
+ * RETURNS: PSZ                                                              *
+ *   Pointer to the character after the "=", or NULL if not found            *
+ * ------------------------------------------------------------------------- */
+static PSZ FindTable( PSZ pszText, PSZ pszName )
+{
+    PSZ    psz;
+    USHORT cch = strlen( pszName );
+
+    for ( psz = strstr( pszText, pszName ); psz; psz = strstr( psz + 1, pszName )) {
+        if (( psz > pszText ) && ( isalnum( psz[-1] ) || psz[-1] == '_')) continue;
+        psz += cch;
+        while ( isspace( *psz )) psz++;
+        if ( *psz != '[') continue;
+        while ( *psz && *psz != ']' && *psz != ';') psz++;
+        if ( *psz++ != ']') continue;
+        while ( isspace( *psz )) psz++;
+        if ( *psz == '=') return psz + 1;
+    }
+    return NULL;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * FindDefine                                                                *
+ *                                                                           *
+ * Find the value of a macro defined as a number ("#define name 127") in the *
+ * text of a C header file.                                                  *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ    pszText: Text of the file                                        *
+ *   PSZ    pszName: Name of the macro (need not be null-terminated)         *
+ *   ULONG  cchName: Length of the name                                      *
+ *   PLONG  plVal  : Receives the value                                      *
+ *                                                                           *
+ * RETURNS: BOOL                                                             *
+ *   TRUE if the macro was found                                             *
+ * ------------------------------------------------------------------------- */
+static BOOL FindDefine( PSZ pszText, PSZ pszName, ULONG cchName, PLONG plVal )
+{
+    PSZ   psz;
+    char *pszEnd;
+
+    for ( psz = strstr( pszText, "#define"); psz; psz = strstr( psz + 1, "#define")) {
+        for ( psz += 7; *psz == ' ' || *psz == '\t'; psz++ );
+        if ( strncmp( psz, pszName, cchName ) || isalnum( psz[ cchName ] ) || psz[ cchName ] == '_')
+            continue;
+        *plVal = strtol( (char *)( psz + cchName ), &pszEnd, 0 );
+        if ( (PSZ) pszEnd != psz + cchName ) return TRUE;
+    }
+    return FALSE;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ParseNumbers                                                              *
+ *                                                                           *
+ * Parse a C array initializer consisting of integer constants, such as      *
+ * "{127,254,254,2};".  A constant may also be the name of a macro defined   *
+ * as a number in the same file (as DICT writes the list sizes).             *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ    pszText: Text of the whole file, for macro names                 *
+ *   PSZ    psz    : Start of the initializer                                *
+ *   PLONG  alVal  : Receives the values (may be NULL, to count them)        *
+ *   ULONG  cMax   : Maximum number of values to store                       *
+ *                                                                           *
+ * RETURNS: LONG                                                             *
+ *   Number of values found, or -1 if the initializer is not valid           *
+ * ------------------------------------------------------------------------- */
+static LONG ParseNumbers( PSZ pszText, PSZ psz, PLONG alVal, ULONG cMax )
+{
+    LONG  cVal = 0,
+          lVal;
+    char *pszEnd;
+
+    while ( isspace( *psz )) psz++;
+    if ( *psz++ != '{') return -1;
+    for (;;) {
+        while ( isspace( *psz )) psz++;
+        if ( *psz == '}') break;
+        if ( isalpha( *psz ) || *psz == '_') {
+            for ( pszEnd = (char *) psz; isalnum( *pszEnd ) || *pszEnd == '_'; pszEnd++ );
+            if ( !FindDefine( pszText, psz, (PSZ) pszEnd - psz, &lVal )) return -1;
+        }
+        else lVal = strtol( (char *) psz, &pszEnd, 0 );
+        if ( (PSZ) pszEnd == psz ) return -1;
+        if ( alVal ) {
+            if ( (ULONG) cVal >= cMax ) return -1;
+            alVal[ cVal ] = lVal;
+        }
+        cVal++;
+        for ( psz = (PSZ) pszEnd; isspace( *psz ); psz++ );
+        if ( *psz == ',') psz++;
+        else if ( *psz != '}') return -1;
+    }
+    return cVal;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ParseStrings                                                              *
+ *                                                                           *
+ * Parse a C array initializer consisting of string literals (which are      *
+ * concatenated), up to the closing ";".  Comments between the literals are  *
+ * skipped.                                                                  *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ   psz  : Start of the initializer                                   *
+ *   PCHAR pchOut: Receives the characters (may be NULL, to count them)      *
+ *                                                                           *
+ * RETURNS: LONG                                                             *
+ *   Number of characters, or -1 if the initializer is not valid             *
+ * ------------------------------------------------------------------------- */
+static LONG ParseStrings( PSZ psz, PCHAR pchOut )
+{
+    LONG  cch = 0;
+    ULONG ulVal,
+          i;
+    CHAR  ch;
+
+    for (;;) {
+        while ( isspace( *psz )) psz++;
+        if ( psz[0] == '/' && psz[1] == '/') {
+            while ( *psz && *psz != '\n') psz++;
+            continue;
+        }
+        if ( psz[0] == '/' && psz[1] == '*') {
+            if (( psz = strstr( psz + 2, "*/")) == NULL ) return -1;
+            psz += 2;
+            continue;
+        }
+        if ( *psz == ';') return cch;
+        if ( *psz++ != '"') return -1;
+
+        while ( *psz != '"') {
+            if ( !*psz || *psz == '\n') return -1;
+            ch = *psz++;
+            if ( ch == '\\') {
+                ch = *psz++;
+                if ( ch >= '0' && ch <= '7') {
+                    for ( ulVal = ch - '0', i = 1; i < 3 && *psz >= '0' && *psz <= '7'; i++ )
+                        ulVal = ulVal * 8 + ( *psz++ - '0');
+                    ch = (CHAR) ulVal;
+                }
+                else switch ( ch ) {
+                    case 'n': ch = '\n'; break;
+                    case 'r': ch = '\r'; break;
+                    case 't': ch = '\t'; break;
+                    case '\\':
+                    case '\'':
+                    case '"': break;
+                    default:  return -1;
+                }
+            }
+            if ( pchOut ) pchOut[ cch ] = ch;
+            cch++;
+        }
+        psz++;
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakLoadDictionary                                                         *
+ *                                                                           *
+ * Load a keyword dictionary from a C header file in the same format as      *
+ * ppdtable.h (such as those written by PAKTOOL's DICT action).  Only the    *
+ * initializers of sListSize, achPSKeyWords and sPSKeyWordOffset are read    *
+ * (with the macros naming the list sizes, if any);                          *
+ * the tables must be consistent with each other and with the encoding       *
+ * described in paklib.h.                                                    *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID     pHeap  : Heap to allocate the dictionary from (or NULL)       *
+ *   PSZ       pszFile: Name of the header file                              *
+ *   PPAKDICT *ppDict : Receives the dictionary, which must be released      *
+ *                      with PakFreeDictionary()                             *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_INVALID_DATA if the file does not contain a valid   *
+ *   dictionary, otherwise an OS/2 error code                                *
+ * ------------------------------------------------------------------------- */
+ULONG PakLoadDictionary( PVOID pHeap, PSZ pszFile, PPAKDICT *ppDict )
+{
+    FILESTATUS3 fs3;
+    PBYTE       pbFile,
+                pbText;
+    PSZ         pszSizes,
+                pszWords,
+                pszOffsets;
+    LONG        alSizes[ PAKDICT_MAX_LISTS ],
+                cLists,
+                cWords,
+                cbWords,
+                lOffset,
+                i;
+    PLONG       alOffsets = NULL;
+    PPAKDICT    pDict = NULL;
+    APIRET      rc;
+
+    *ppDict = NULL;
+    rc = DosQueryPathInfo( pszFile, FIL_STANDARD, &fs3, sizeof( fs3 ));
+    if ( !rc ) rc = PakLoadSegment( pHeap, pszFile, 0, fs3.cbFile, &pbFile );
+    if ( rc ) return rc;
+
+    // The parsing functions need a null-terminated copy
+    pbText = (PBYTE) PakAlloc( pHeap, fs3.cbFile + 1 );
+    if ( pbText ) {
+        memcpy( pbText, pbFile, fs3.cbFile );
+        pbText[ fs3.cbFile ] = 0;
+    }
+    PakFree( pHeap, pbFile );
+    if ( !pbText ) return ERROR_NOT_ENOUGH_MEMORY;
+
+    rc = ERROR_INVALID_DATA;
+    if ((( pszSizes   = FindTable( pbText, "sListSize")) == NULL ) ||
+        (( pszWords   = FindTable( pbText, "achPSKeyWords")) == NULL ) ||
+        (( pszOffsets = FindTable( pbText, "sPSKeyWordOffset")) == NULL ))
+        goto cleanup;
+
+    // List sizes: all lists but the last must be full, as the encoding requires
+    cLists = ParseNumbers( pbText, pszSizes, alSizes, PAKDICT_MAX_LISTS );
+    if ( cLists < 1 ) goto cleanup;
+    for ( i = 0, cWords = 0; i < cLists; i++ ) {
+        if (( alSizes[ i ] < 0 ) || ( alSizes[ i ] > ( i ? 254 : 127 )) ||
+            (( i < cLists - 1 ) && ( alSizes[ i ] != ( i ? 254 : 127 ))))
+            goto cleanup;
+        cWords += alSizes[ i ];
+    }
+    if ( ParseNumbers( pbText, pszOffsets, NULL, 0 ) != cWords ) goto cleanup;
+    cbWords = ParseStrings( pszWords, NULL );
+    if (( cbWords < 1 ) || ( cbWords > 0x7FFF )) goto cleanup;
+
+    // The dictionary is allocated as a single block
+    alOffsets = (PLONG) PakAlloc( pHeap, ( cWords + 1 ) * sizeof( LONG ));
+    pDict = (PPAKDICT) PakAlloc( pHeap, sizeof( PAKDICT ) + cWords * sizeof( SHORT ) + cbWords + 1 );
+    if ( !alOffsets || !pDict ) {
+        rc = ERROR_NOT_ENOUGH_MEMORY;
+        goto cleanup;
+    }
+    pDict->cWords    = cWords;
+    pDict->psOffsets = (PSHORT)( pDict + 1 );
+    pDict->pchWords  = (PCHAR)( pDict->psOffsets + cWords );
+    pDict->cbWords   = cbWords;
+    ParseNumbers( pbText, pszOffsets, alOffsets, cWords );
+    ParseStrings( pszWords, pDict->pchWords );
+    pDict->pchWords[ cbWords ] = 0;
+
+    // Each offset must be the start of a keyword of acceptable length
+    for ( i = 0; i < cWords; i++ ) {
+        lOffset = alOffsets[ i ];
+        if (( lOffset < 0 ) || ( lOffset >= cbWords ) ||
+            (( lOffset > 0 ) && pDict->pchWords[ lOffset - 1 ]) ||
+            ( strlen( pDict->pchWords + lOffset ) > PAKDICT_MAX_WORD ))
+            goto cleanup;
+        pDict->psOffsets[ i ] = (SHORT) lOffset;
+    }
+
+    *ppDict = pDict;
+    pDict = NULL;
+    rc = NO_ERROR;
+
+cleanup:
+    PakFree( pHeap, pDict );
+    PakFree( pHeap, alOffsets );
+    PakFree( pHeap, pbText );
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- */
+VOID PakFreeDictionary( PVOID pHeap, PPAKDICT pDict )
+{
+    PakFree( pHeap, pDict );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * DecompressedLength                                                        *
+ *                                                                           *
+ * Check that a compressed string can be safely passed to                    *
+ * DecompressStringDict() with the given dictionary (i.e. that it only       *
+ * refers to valid keywords, and that all hex strings are closed before the  *
+ * terminating null), and return its decompressed length.                    *
+ * Used to decompress strings ahead of time, which - unlike decompressing    *
+ * strings referred to by a device's data - may be applied to arbitrary      *
+ * bytes.                                                                    *
+ *                                                                           *
+ * RETURNS: LONG                                                             *
+ *   Length of the decompressed string, or -1 if it cannot be decompressed   *
+ * ------------------------------------------------------------------------- */
+LONG DecompressedLength( PPAKDICT pDict, PSZ pszBuffIn )
+{
+    PBYTE  pb = (PBYTE) pszBuffIn;
+    LONG   lLen = 0;
+    SHORT  sAdjust;
+    ULONG  ulIndex,
+           cch;
+    PSHORT psOffsets = pDict ? pDict->psOffsets : sPSKeyWordOffset;
+    PCHAR  pchWords  = pDict ? pDict->pchWords  : achPSKeyWords;
+    ULONG  cWords    = pDict ? pDict->cWords    : sizeof( sPSKeyWordOffset ) / sizeof( SHORT );
+
+    while ( *pb ) {
+        if ( *pb == '<' ) {
+            if ( pb[1] == '<') {
+                lLen += 2;
+                pb++;
+            }
+            else if ( pb[1] == ' ' || pb[1] == '\n' || pb[1] == '\r' || pb[1] == '\t')
+                lLen++;
+            else {
+                // Hex string: every two digits make one byte, up to the closing >
+                for ( pb++, cch = 0; *pb && *pb != '>'; pb++ ) cch++;
+                if ( *pb != '>') return -1;
+                lLen += ( cch + 1 ) / 2;
+            }
+        }
+        else if ( *pb < 128 )
+            lLen++;
+        else {
+            sAdjust = -128;
+            while ( *pb == 255 ) {
+                pb++;
+                sAdjust += 254;
+            }
+            if ( !*pb ) return -1;
+            ulIndex = (ULONG)( *pb + sAdjust );
+            if ( ulIndex >= cWords ) return -1;
+            lLen += strlen( &(pchWords[ psOffsets[ ulIndex ]]));
+        }
+        pb++;
+    }
+    return lLen;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ExpandString                                                              *
+ *                                                                           *
+ * Decompress a string from the information segment currently being          *
+ * formatted.  If the arena carries a string map for the segment (as when    *
+ * reading a V2 PAK file) and the string is in it, the already-decompressed  *
+ * copy is used; otherwise the string is decompressed using the arena's      *
+ * dictionary.                                                               *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAKARENA pArena    : Current arena (may be NULL)                       *
+ *   PSZ       pszBuffIn : Compressed string                                 *
+ *   PSZ       pszBuffOut: Output buffer (assumed to be large enough)        *
+ *                                                                           *
+ * RETURNS: USHORT                                                           *
+ *   Length of the output string                                             *
+ * ------------------------------------------------------------------------- */
+USHORT ExpandString( PPAKARENA pArena, PSZ pszBuffIn, PSZ pszBuffOut )
+{
+    PPAKSTRMAP pMap;
+    ULONG      ulOffset,
+               ulLow, ulHigh, ulMid;
+    PBYTE      pbRec;
+    USHORT     cb;
+
+    if ( !pArena || ( pMap = pArena->pStrMap ) == NULL ||
+         (PBYTE) pszBuffIn < pMap->pbSegment ||
+         (PBYTE) pszBuffIn >= pMap->pbSegment + pMap->cbSegment )
+        return DecompressStringDict( pArena ? pArena->pDict : NULL, pszBuffIn, pszBuffOut );
+
+    ulOffset = (PBYTE) pszBuffIn - pMap->pbSegment;
+    ulLow    = 0;
+    ulHigh   = pMap->cRefs;
+    while ( ulLow < ulHigh ) {
+        ulMid = ( ulLow + ulHigh ) / 2;
+        if ( pMap->pRefs[ ulMid ].ulSegOffset < ulOffset )
+            ulLow = ulMid + 1;
+        else
+            ulHigh = ulMid;
+    }
+    if ( ulLow >= pMap->cRefs || pMap->pRefs[ ulLow ].ulSegOffset != ulOffset )
+        return DecompressStringDict( pArena->pDict, pszBuffIn, pszBuffOut );
+
+    pbRec = pMap->pbPool + pMap->pRefs[ ulLow ].ulPoolOffset;
+    cb = *((PUSHORT) pbRec );
+    memcpy( pszBuffOut, pbRec + sizeof( USHORT ), cb + 1 );
+    return cb;
+}
+
+
+//
+// THESE FUNCTIONS STOLEN FROM UTLCHNL.C (USED FOR DECOMPRESSING STRINGS):
+//
+
+//*****************************************************************************
+//
+// FUNCTION: CharToHex
+//
+// DESCRIPTION: Converts an character to its hex rep
+//
+// Returns -1 if fails
+//
+//*****************************************************************************
+
+BYTE CharToHex( CHAR c )
+{
+  if ( c >= '0' && c <= '9' )
+  {
+    return c - '0';
+  }
+  else
+  if ( c >= 'a' && c <= 'f' )
+  {
+    return c - 'a' + 10;
+  }
+  if ( c >= 'A' && c <= 'F' )
+  {
+    return c - 'A' + 10;
+  }
+
+  return -1;
+}
+
+//*****************************************************************************
+//
+// FUNCTION: ProcessHexString
+//
+// DESCRIPTION: Will take a WELL FORMED hex string that is one that starts
+// with less than char, is all hex digits - no white space, and even amount
+// ending with greater than char
+// Note - since function will adjust the callers in and out buffers the addr
+// of the callers buufers are passesd hence the PSZ * type
+//
+// Defect 203803 some strings are not up to standards eg HP 1200C where they are
+// in form <a><b> ....
+// So we have to take that in account (Real World - you know)
+//
+// RETURNS:
+// Returns the number of hex bytes - esentially the number of ASCII chars/2 -
+// 2 for the <>
+//
+//*****************************************************************************
+
+SHORT ProcessHexString( PSZ *ppszBuffIn,  // Ptr 2 Ptr of input buffer
+                        PSZ *ppszBuffOut) // Ptr 2 Ptr of output buffer
+{
+  PSZ pIn  = *ppszBuffIn;
+  PSZ pOut = *ppszBuffOut;
+  INT iCount = 0;
+
+  // Hop over initial < of hex string
+  *pIn++;
+
+  while ( *pIn != '>' )
+  {
+    *pOut = CharToHex( *pIn );
+    pIn++;
+    //-------------------- Georgs P.         203803
+    if ( *pIn != '>' )
+    {
+      *pOut = (*pOut << 4) | CharToHex( *pIn );
+      pIn++;
+    }
+    pOut++;
+    iCount++;
+  }
+
+  // Adjust pointers
+  *ppszBuffIn = pIn;
+  *ppszBuffOut = pOut;
+
+  return iCount;
+}
+
+
+/*****************************************************************************\
+**
+** FUNCTION NAME = DecompressString
+**
+** DESCRIPTION   = Decompress a string from ppd files that was
+**                 compressed by the PPD compiler.
+**
+**
+** INPUT         = pszBuffIn                - pointer to input buffer
+**                 pszBuffOut               - pointer to output buffer
+**
+** OUTPUT        = returns length of output buffer
+**
+** RETURN-NORMAL = NONE
+** RETURN-ERROR  = NONE
+**
+\*****************************************************************************/
+
+USHORT DecompressString(PSZ pszBuffIn, PSZ pszBuffOut)
+{
+  return DecompressStringDict( NULL, pszBuffIn, pszBuffOut );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * DecompressStringDict                                                      *
+ *                                                                           *
+ * DecompressString() using the given keyword dictionary (NULL for the       *
+ * built-in one).  Keyword numbers beyond the end of the dictionary are      *
+ * ignored.                                                                  *
+ * ------------------------------------------------------------------------- */
+USHORT DecompressStringDict( PPAKDICT pDict, PSZ pszBuffIn, PSZ pszBuffOut )
+{
+  SHORT  sAdjust;
+  USHORT usIndex;
+  SHORT  usOutSize;                     /* size of the output buffer    */
+  USHORT usStringLen;
+  USHORT usOffSet;
+  PSHORT psOffsets = pDict ? pDict->psOffsets : sPSKeyWordOffset;
+  PCHAR  pchWords  = pDict ? pDict->pchWords  : achPSKeyWords;
+  ULONG  cWords    = pDict ? pDict->cWords    : sizeof( sPSKeyWordOffset ) / sizeof( SHORT );
+
+  usOutSize = 0;
+
+  /*
+  ** For each char in source
+  */
+  while ( *pszBuffIn )
+  {
+
+    // Ahh - must be either a hex string or dict entry
+    if ( *pszBuffIn == '<' )
+    {
+      // Another < - must be dict entry
+      // Add them to output line
+      if ( *(pszBuffIn+1) == '<' )
+      {
+        *pszBuffOut++ = *pszBuffIn++;
+        *pszBuffOut++ = *pszBuffIn;
+        usOutSize += 2;
+      }
+      else
+      {
+        /*        ** "cng55p2.ppd" [UIsection=Halftone]; "601ps95.ppd [UIsection=Collate]"
+        */
+        if ( *(pszBuffIn+1) == ' '  || *(pszBuffIn+1) == '\n' ||
+             *(pszBuffIn+1) == '\r' || *(pszBuffIn+1) == '\t' )
+        {
+           *pszBuffOut++ = *pszBuffIn;
+           usOutSize++;
+        }
+        else
+        {
+          usOutSize += ProcessHexString( &pszBuffIn, &pszBuffOut );
+        }
+      }
+    }
+    else
+    if (*pszBuffIn < 128)  //If regular character copy it over
+    {
+      *pszBuffOut = *pszBuffIn;
+      usOutSize++;
+      pszBuffOut++;
+    }
+    else          //Its a compressed char
+    {
+      sAdjust = -128;
+      while (*pszBuffIn == 255) //Pass over flag bytes
+      {
+        pszBuffIn++;
+        sAdjust += 254;         //This is the offset adjust
+      }
+      usIndex = (USHORT)*pszBuffIn + sAdjust; //This is the postion of offset
+      if ( usIndex < cWords )
+      {
+        usOffSet = psOffsets[usIndex];          //Actual offset into words buffer
+        strcpy(pszBuffOut,&(pchWords[usOffSet]));  //Copy word to target
+        usStringLen = strlen (&(pchWords[usOffSet]));
+        usOutSize += usStringLen;  //Adjust pointers
+        pszBuffOut += usStringLen;
+      }
+    }
+    pszBuffIn++;
+  }
+  *pszBuffOut = '\0';   //End with null byte
+  return(usOutSize);
+}
+
+
+
@@ -0,0 +1,702 @@
+/*
+ * paklib.h
+ *
+ * PAKTOOL library interface.  The library contains all of PAKTOOL's logic
+ * for reading PostScript driver PAK files and formatting their contents; the
+ * PAKTOOL program itself is a thin command-line wrapper around it.
+ *
+ * All functions are reentrant: the library keeps no global state, and any
+ * memory handed back to the caller comes from the heap supplied with the
+ * call.  Formatted output is written to an OUTBUF, which is either a memory
+ * buffer or (if NULL) STDOUT.
+ *
+ * Include this after <os2.h>, pt_struct.h and package.h.  Note that the
+ * library must be built with the same PSDRIVER setting as its users.
+ */
+
+#ifndef paklib_h_
+#define paklib_h_
+
+// Overrides signature definition in package.h
+#if PSDRIVER == 1
+#define PAKSIGNATURE_DEVPACK_V1   "IBM DDPAK V1.2"  // ALT_CUPS
+#else
+#define PAKSIGNATURE_DEVPACK_V1   "IBM DDPAK V1.0"  // ALT_CUPS
+#endif
+
+// Convert an offset into the data buffer into a pointer to string.  Note:
+// i is the offset value; p is the pointer to the information segment buffer.
+#define OFFSET_TO_PSZ(i, p)    ((i > 0)? (PSZ)(p+i): "(none)")
+
+// Values for the data-format flag passed to RenderPakDevice()
+#define DEV_FMT_DATA 1      // formatted (structured) data
+#define DEV_RAW_DATA 2      // raw data dump
+#define DEV_HEX_DATA 3      // hex data dump
+#define DEV_BIN_DATA 4      // combined binary (raw/hex) data dump
+#define DEV_TXT_DATA 5      // readable text
+#define DEV_PPD_DATA 6      // PPD output
+#define DEV_JSON_DATA 7     // JSON object
+
+// Returned by RenderPakDevice() if the requested printer is not in the PAK
+#define ERROR_PAK_NO_DEVICE  0xF001
+
+// Returned by PakUicSelect() if the UI keyword or option is not defined
+#define ERROR_PAK_NO_KEYWORD 0xF002
+#define ERROR_PAK_NO_OPTION  0xF003
+
+// Returned by PakApplyPatch() if the file to patch is not the one it was made from
+#define ERROR_PAK_WRONG_SOURCE 0xF005
+
+// Returned by PakStreamDevices() if entries share a segment larger than the window
+#define ERROR_PAK_SHARED_SEGMENT 0xF006
+
+
+/*
+ * Caller-supplied heap.  Wherever the library takes a "pHeap" argument
+ * (including those declared in package.h), it expects either a pointer to
+ * one of these, or NULL to use the C runtime heap.
+ */
+typedef struct _PAKHEAP
+{
+    PVOID pUser;                                        // passed to callbacks
+    PVOID ( APIENTRY *pfnAlloc )( PVOID pUser, ULONG cb );
+    VOID  ( APIENTRY *pfnFree )( PVOID pUser, PVOID p );
+} PAKHEAP, *PPAKHEAP;
+
+PVOID  PakAlloc( PVOID pHeap, ULONG cb );
+VOID   PakFree( PVOID pHeap, PVOID p );
+
+
+/*
+ * Pre-decompressed strings for one device segment (see pakv2.h).  Each
+ * reference gives the offset of a compressed string within the segment, and
+ * the offset in the string pool of its decompressed form.  A pool record
+ * consists of a USHORT length, the string itself, and a terminating null.
+ */
+typedef struct _PAKSTRREF
+{
+    ULONG ulSegOffset;      // offset of compressed string within segment
+    ULONG ulPoolOffset;     // offset of pool record
+} PAKSTRREF, *PPAKSTRREF;
+
+typedef struct _PAKSTRMAP
+{
+    PBYTE      pbSegment;   // segment the references apply to
+    ULONG      cbSegment;   // size of segment
+    PPAKSTRREF pRefs;       // references, sorted by ulSegOffset
+    ULONG      cRefs;       // number of references
+    PBYTE      pbPool;      // string pool
+} PAKSTRMAP, *PPAKSTRMAP;
+
+
+/*
+ * Keyword dictionary for compressed strings.  Bytes 128-254 of a compressed
+ * string stand for the first 127 keywords; each 255 byte before such a byte
+ * moves on by 254 keywords (so that the keywords form lists of 127, 254, 254,
+ * ... entries).  The built-in dictionary is that of ppdtable.h, which is what
+ * the driver's PPD compiler uses; PAK files compiled with a different table
+ * need a matching dictionary, which PakLoadDictionary() reads from a header
+ * file in the same format.  Wherever a function takes a PPAKDICT, NULL
+ * selects the built-in dictionary.
+ */
+#define PAKDICT_MAX_WORD   31       // maximum length of a keyword
+#define PAKDICT_MAX_LISTS  16       // maximum number of keyword lists
+
+typedef struct _PAKDICT
+{
+    ULONG  cWords;          // number of keywords
+    PSHORT psOffsets;       // offset of each keyword in pchWords
+    PCHAR  pchWords;        // keywords, each null-terminated
+    ULONG  cbWords;         // size of pchWords
+} PAKDICT, *PPAKDICT;
+
+ULONG  PakLoadDictionary( PVOID pHeap, PSZ pszFile, PPAKDICT *ppDict );
+VOID   PakFreeDictionary( PVOID pHeap, PPAKDICT pDict );
+
+
+/*
+ * Scratch-memory arena used while parsing and formatting a device segment.
+ * Memory is handed out from one block by advancing a pointer, and is all
+ * released at once by ArenaReset().  Requests which do not fit are met from
+ * overflow blocks; the next ArenaReset() then enlarges the main block to
+ * cover them, so that a program which reuses one arena for many entries soon
+ * needs no further allocations.  Initialize with all fields zero.  Wherever a
+ * function takes a PPAKARENA, NULL may be passed to have it use (and free)
+ * an arena of its own.
+ */
+typedef struct _PAKARENA
+{
+    PVOID pHeap;            // heap to allocate from (NULL for C runtime)
+    PBYTE pbBlock;          // main block
+    ULONG cbBlock;          // size of main block
+    ULONG cbUsed;           // number of bytes in use in main block
+    PVOID pOverflow;        // chain of overflow blocks
+    ULONG cbOverflow;       // total size of overflow blocks
+    PPAKSTRMAP pStrMap;     // decompressed strings for the segment being
+                            //   formatted, or NULL to decompress as needed
+    PPAKDICT   pDict;       // keyword dictionary (NULL for built-in)
+} PAKARENA, *PPAKARENA;
+
+PVOID  ArenaAlloc( PPAKARENA pArena, ULONG cb );
+ULONG  ArenaMark( PPAKARENA pArena );
+VOID   ArenaRelease( PPAKARENA pArena, ULONG ulMark );
+BOOL   ArenaReset( PPAKARENA pArena, ULONG cbHint );
+VOID   ArenaFree( PPAKARENA pArena );
+
+
+/*
+ * Output sink used by the formatting functions.  Passing a NULL POUTBUF
+ * writes straight to STDOUT; otherwise the output is accumulated in a
+ * growable memory buffer (always kept null-terminated), which the caller
+ * must release with OutFree().  Set pHeap before the first write to have
+ * the buffer allocated from a caller-supplied heap.
+ */
+typedef struct _OUTBUF
+{
+    PBYTE pbData;           // buffer contents (NULL until first write)
+    ULONG cbData;           // number of bytes written
+    ULONG cbAlloc;          // number of bytes allocated
+    BOOL  fError;           // TRUE if an allocation has failed
+    PVOID pHeap;            // heap to allocate from (NULL for C runtime)
+} OUTBUF, *POUTBUF;
+
+void   OutPrintf( POUTBUF pOut, PSZ pszFormat, ... );
+void   OutWrite( POUTBUF pOut, PBYTE pb, ULONG cb );
+void   OutFree( POUTBUF pOut );
+
+
+// PAK file access (the functions declared in package.h are also provided)
+ULONG  PakReadSignature( PSZ pszPakFile, PPAKSIGNATURE pSig );
+ULONG  PakLoadDirectory( PVOID pHeap, PSZ pszPakFile, PSZ pszExpectedSignature,
+                         ULONG ulSegmentSize, PBYTE *ppDirectoryMem );
+ULONG  PakLoadSegment( PVOID pHeap, PSZ pszPakFile, ULONG ulOffset, ULONG ulSize,
+                       PBYTE *ppSegment );
+ULONG  RenderPakDevice( PVOID pHeap, PPAKARENA pArena, PSZ pszPakFile,
+                        PSZ pszDeviceName, USHORT fsMode, POUTBUF pOut );
+ULONG  FormatPakDevice( PPAK_DEV_DIRENTRY pEntry, PBYTE pBuf, USHORT fsMode,
+                        PPAKARENA pArena, POUTBUF pOut );
+ULONG  PakFindDevice( PVOID pHeap, PSZ pszPakFile, PSZ pszDeviceName,
+                      PPAK_DEV_DIRENTRY pEntry );
+ULONG  PakLoadDevice( PVOID pHeap, PSZ pszPakFile, PSZ pszDeviceName,
+                      PPAK_DEV_DIRENTRY pEntry, PBYTE *ppSegment );
+
+
+/*
+ * Streaming access to device PAK files, for input which cannot be seeked
+ * (e.g. a pipe) or which holds several PAK files one after another.  Each
+ * PAK's signature and directory are read, and then its segments are passed
+ * to the callback in file-offset order, in pieces no larger than the window
+ * size.  Entries sharing a segment are each passed the segment in turn; it
+ * is read once, and so must fit in the window.  Peak memory use is the
+ * window plus one directory (whose size is limited by the format to 32767
+ * entries).
+ *
+ * The callback is called at least once per directory entry, with all of an
+ * entry's pieces passed one after another: ulPos is the position of the
+ * piece within the segment, so that the first piece has ulPos == 0 and the
+ * last has ulPos + cb == pEntry->ulSize.  Any bytes after a PAK which do not
+ * begin another are skipped up to the next signature (or the end of the
+ * input), and the callback is then called with pEntry and pb NULL and cb the
+ * number of bytes skipped.  A non-zero return value stops the stream, and is
+ * returned by PakStreamDevices().
+ */
+#define PAKSTREAM_WINDOW   0x8000   // default window size
+
+typedef ULONG ( APIENTRY PFNPAKSTREAM )( PVOID pUser, PPAKSIGNATURE pSig,
+                                         PPAK_DEV_DIRENTRY pEntry, ULONG ulPos,
+                                         PBYTE pb, ULONG cb );
+typedef PFNPAKSTREAM *PPFNPAKSTREAM;
+
+ULONG  PakStreamDevices( PVOID pHeap, HFILE hf, ULONG cbWindow,
+                         PPFNPAKSTREAM pfnVisit, PVOID pUser );
+
+// Structural validation of a single device segment (pakcheck.c)
+ULONG  PakCheckDevice( PPAK_DEV_DIRENTRY pEntry, PBYTE pBuf, PPAKARENA pArena, POUTBUF pOut );
+
+
+/*
+ * UI constraint engine (pakuic.c).  The UI constraints of a device segment
+ * are expanded into a conflict matrix with one row per option (UI entry) and,
+ * in each row, one UI_SEL mask per UI block giving the options of that block
+ * which conflict with it.  The matrix is symmetric, and constraints listed
+ * more than once (as PPD files usually list them, in both directions) are
+ * merged.  As in the driver, only the first 32 entries of a block can be
+ * selected or constrained.
+ *
+ * A selection is a vector of UI_SEL values, one per UI block, each bit of
+ * which selects the corresponding UI entry.  The engine refers to the segment
+ * it was built from (for names), which must stay in memory while it is used;
+ * it is not changed by any of the functions below, so one engine may be used
+ * by several threads at once.
+ */
+typedef struct _PAKUIC
+{
+    ULONG      cBlocks;             // number of UI blocks
+    ULONG      cOptions;            // number of options (matrix rows)
+    ULONG      cPairs;              // number of distinct conflicting pairs
+    PBYTE      pInfoSeg;            // information segment (for names)
+    ULONG      cbInfo;              // size of information segment
+    PUI_BLOCK *apBlocks;            // each UI block, within the segment
+    PULONG     pulFirstRow;         // row of each block's first option
+    PUI_SEL    pAny;                // options of each block with any conflict
+    PUI_SEL    pMatrix;             // cOptions rows of cBlocks masks
+} PAKUIC, *PPAKUIC;
+
+// A violated constraint reported by PakUicCheck()
+typedef struct _PAKUICPAIR
+{
+    USHORT usBlock1, usEntry1;      // first option (the lower-numbered)
+    USHORT usBlock2, usEntry2;      // option it conflicts with
+} PAKUICPAIR, *PPAKUICPAIR;
+
+ULONG  PakUicBuild( PVOID pHeap, PBYTE pBuf, ULONG cbBuf, PPAKUIC *ppUic );
+VOID   PakUicFree( PVOID pHeap, PPAKUIC pUic );
+VOID   PakUicDefaults( PPAKUIC pUic, PUI_SEL pSel );
+ULONG  PakUicCheck( PPAKUIC pUic, PUI_SEL pSel, PPAKUICPAIR pPairs, ULONG cMax );
+ULONG  PakUicResolve( PPAKUIC pUic, PUI_SEL pSel, PUI_SEL pPrefer );
+BOOL   PakUicFindOption( PPAKUIC pUic, PSZ pszKeyword, PSZ pszOption,
+                         PULONG pulBlock, PULONG pulEntry );
+ULONG  PakUicSelect( PPAKUIC pUic, PSZ pszChoice, PUI_SEL pSel, PUI_SEL pPrefer );
+PSZ    PakUicKeyword( PPAKUIC pUic, ULONG ulBlock );
+PSZ    PakUicOption( PPAKUIC pUic, ULONG ulBlock, ULONG ulEntry );
+
+
+/*
+ * Job ticket templates (pakjob.c).  A template holds the decompressed code of
+ * every UI option of a printer, and its JCL strings, with the UI blocks
+ * already sorted into the order in which the driver sends them: by location
+ * (JCLSetup, ExitServer, Prolog, DocumentSetup and AnySetup, PageSetup) and
+ * then by OrderDependency.  Rendering a selection is then just a matter of
+ * copying strings, so a template should be kept for each printer in use.
+ * Like the constraint engine it contains, a template refers to the device
+ * segment it was built from, and is not changed by PakJobRender().
+ */
+#define PAKJOB_GROUPS      5        // number of location groups
+
+typedef struct _PAKJOB
+{
+    PPAKUIC pUic;                   // constraint engine (names and lookup)
+    PUI_SEL pDefaults;              // default selection
+    PULONG  pulOrder;               // UI blocks in the order they are sent
+    ULONG   aulGroup[ PAKJOB_GROUPS + 1 ];  // start of each group in pulOrder
+    PULONG  pulCode;                // pool offset of the code of each option
+                                    //   (by matrix row), then of JCLBegin,
+                                    //   JCLToPSInterpreter, JCLEnd and the end
+    OUTBUF  pool;                   // decompressed strings
+} PAKJOB, *PPAKJOB;
+
+ULONG  PakJobBuild( PVOID pHeap, PPAKARENA pArena, PBYTE pBuf, ULONG cbBuf, PPAKJOB *ppJob );
+VOID   PakJobFree( PVOID pHeap, PPAKJOB pJob );
+VOID   PakJobRender( PPAKJOB pJob, PUI_SEL pSel, POUTBUF pOut );
+
+
+/*
+ * Paper size tables (pakpaper.c).  The PaperDimension and ImageableArea
+ * tables of a printer are decoded into one array of papers, sorted by short
+ * edge and then long edge, so that the paper nearest to a given size can be
+ * found by binary search.  The form commands (desForms) are decompressed and
+ * sorted as well.  The option names point into the device segment, which
+ * must stay in memory while the tables are used.
+ */
+#define PAKPAPER_FIXED     0x0001   // do not match papers turned sideways
+
+typedef struct _PAKPAPER
+{
+    PSZ    pszName;                 // PageSize option name
+    PSZ    pszXlate;                // its translation string (or the name)
+    SHORT  sEntry;                  // entry number in the PageSize block
+    SHORT  cx, cy;                  // PaperDimension (points)
+    BOOL   fImageable;              // TRUE if an ImageableArea is given:
+    SHORT  xLeft, yBottom,          //   lower left corner (points)
+           xRight, yTop;            //   upper right corner (points)
+} PAKPAPER, *PPAKPAPER;
+
+typedef struct _PAKPAPERS
+{
+    ULONG     cPapers;              // number of papers
+    PPAKPAPER aPapers;              // papers, sorted by size
+    ULONG     cForms;               // number of form commands
+    PSZ      *apszForms;            // form commands, sorted
+} PAKPAPERS, *PPAKPAPERS;
+
+ULONG  PakPaperBuild( PVOID pHeap, PPAKARENA pArena, PBYTE pBuf, ULONG cbBuf, PPAKPAPERS *ppPapers );
+VOID   PakPaperFree( PVOID pHeap, PPAKPAPERS pPapers );
+PPAKPAPER PakPaperNearest( PPAKPAPERS pPapers, LONG cx, LONG cy, LONG lTolerance,
+                           ULONG flOptions, PBOOL pfRotated );
+
+
+/*
+ * Font index (pakfidx.c).  The resident fonts (desFonts) of every printer in
+ * a PAK file are numbered in order of name, and each printer's fonts kept as
+ * a bitset over those numbers, so that the printers having a font, or the
+ * fonts common to (or found in any of) a group of printers, can be found
+ * without decoding the printers again.  The names point into the PAK file
+ * image, which must stay in memory while the index is used.
+ */
+typedef struct _PAKFONTIDX
+{
+    ULONG             cPrinters;    // number of printers (directory entries)
+    PPAK_DEV_DIRENTRY pEntries;     // the directory
+    ULONG             cFonts;       // number of distinct fonts
+    PSZ              *apszFonts;    // font names, sorted
+    ULONG             cWords;       // ULONGs in each printer's bitset
+    PULONG            pulBits;      // bitsets, one per printer
+} PAKFONTIDX, *PPAKFONTIDX;
+
+// The font bitset of a printer, and whether it includes a given font
+#define PAKFONTIDX_ROW( p, i )      ( (p)->pulBits + (i) * (p)->cWords )
+#define PAKFONTIDX_HAS( p, i, f )   ( PAKFONTIDX_ROW( p, i )[ (f) / 32 ] & ( 1UL << ( (f) % 32 )))
+
+ULONG  PakFontIndexBuild( PVOID pHeap, PBYTE pbFile, ULONG cbFile, PPAK_DEV_DIRENTRY pEntries,
+                          ULONG cEntries, PPAKFONTIDX *ppIndex );
+VOID   PakFontIndexFree( PVOID pHeap, PPAKFONTIDX pIndex );
+LONG   PakFontIndexFind( PPAKFONTIDX pIndex, PSZ pszFont );
+LONG   PakFontIndexPrinter( PPAKFONTIDX pIndex, PSZ pszPrinter );
+ULONG  PakFontIndexCombine( PPAKFONTIDX pIndex, PULONG pulPrinters, ULONG cPrinters,
+                            BOOL fUnion, PULONG pulSet );
+
+
+/*
+ * Font PAK files (pakfont.c).  A font PAK is read into memory whole, and its
+ * directory indexed by both PostScript name and full name; each font's data
+ * is then used in place in the file image rather than read separately.
+ */
+#define PAKFONT_NAME_SIZE  40       // size of the directory name fields
+
+typedef struct _PAKFONTPAK
+{
+    PBYTE              pbFile;      // file image
+    ULONG              cbFile;      // size of the file
+    ULONG              cEntries;    // number of fonts
+    PPAK_FONT_DIRENTRY pEntries;    // directory (within the image)
+    ULONG              cSlots;      // size of each hash table (power of 2)
+    PULONG             pulByName;   // hash tables, holding entry numbers + 1:
+    PULONG             pulByFull;   //   by PostScript name, by full name
+} PAKFONTPAK, *PPAKFONTPAK;
+
+ULONG  PakFontPakOpen( PVOID pHeap, PSZ pszPakFile, PPAKFONTPAK *ppPak );
+VOID   PakFontPakClose( PVOID pHeap, PPAKFONTPAK pPak );
+PPAK_FONT_DIRENTRY PakFontPakFind( PPAKFONTPAK pPak, PSZ pszName, BOOL fFullName );
+PBYTE  PakFontPakData( PPAKFONTPAK pPak, PPAK_FONT_DIRENTRY pEntry );
+
+
+/*
+ * Printer fields and filter expressions (pakcol.c).  The scalar fields of
+ * every printer in a PAK file (flags, counts and measurements such as colour
+ * support, language level, resolution and free VM) are gathered into one
+ * column per field, and printers selected by evaluating a filter expression,
+ * such as "color && level >= 3", one column at a time.
+ */
+typedef struct _PAKCOLS
+{
+    ULONG             cRows;        // number of printers (directory entries)
+    PPAK_DEV_DIRENTRY pEntries;     // the directory
+    ULONG             cFields;      // number of fields (see PakColsField)
+    PLONG             plColumns;    // cFields columns of cRows values each
+    PULONG            pulValid;     // bitset of printers with valid data
+} PAKCOLS, *PPAKCOLS;
+
+typedef struct _PAKCOLOP
+{
+    USHORT usOp;                    // operation
+    LONG   lArg;                    // field number or constant
+} PAKCOLOP;
+
+typedef struct _PAKCOLEXPR
+{
+    ULONG    cOps;                  // number of operations
+    ULONG    cDepth;                // greatest stack depth reached
+    PAKCOLOP aOps[ 1 ];             // postfix program
+} PAKCOLEXPR, *PPAKCOLEXPR;
+
+PSZ    PakColsField( ULONG ulField, PSZ *ppszDesc );
+ULONG  PakColsBuild( PVOID pHeap, PBYTE pbFile, ULONG cbFile, PPAK_DEV_DIRENTRY pEntries,
+                     ULONG cEntries, PPAKCOLS *ppCols );
+VOID   PakColsFree( PVOID pHeap, PPAKCOLS pCols );
+ULONG  PakColsCompile( PVOID pHeap, PSZ pszExpr, PPAKCOLEXPR *ppExpr, PULONG pulErrPos );
+ULONG  PakColsSelect( PVOID pHeap, PPAKCOLS pCols, PPAKCOLEXPR pExpr, PULONG pulMatch,
+                      PULONG pcMatch );
+
+
+/*
+ * Near-duplicate printers (pakdup.c).  A MinHash signature is computed for
+ * each printer over its UI blocks, options and values, and printers which
+ * agree over any band of their signatures are compared and, if similar
+ * enough, joined into a cluster.  The UI blocks are also recorded, so that
+ * the blocks in which two printers differ can be listed.
+ */
+#define PAKDUP_HASHES      64       // values in each signature
+#define PAKDUP_BANDS       16       // bands into which they are divided
+
+typedef struct _PAKDUPBLOCK
+{
+    PSZ    pszName;                 // UI block name (in the PAK file image)
+    ULONG  ulName;                  // hash of the name
+    ULONG  ulContent;               // hash of the options, values and default
+} PAKDUPBLOCK, *PPAKDUPBLOCK;
+
+typedef struct _PAKDUPS
+{
+    ULONG             cRows;        // number of printers (directory entries)
+    PPAK_DEV_DIRENTRY pEntries;     // the directory
+    PULONG            pulSigs;      // PAKDUP_HASHES values for each printer
+    PULONG            pulCluster;   // first printer of each printer's cluster
+    PULONG            pulFirst;     // first block of each printer (cRows + 1)
+    PPAKDUPBLOCK      pBlocks;      // blocks of each printer, by name hash
+    ULONG             cClusters;    // clusters of more than one printer
+    ULONG             cDuplicates;  // printers not first in their cluster
+} PAKDUPS, *PPAKDUPS;
+
+ULONG  PakDupBuild( PVOID pHeap, PBYTE pbFile, ULONG cbFile, PPAK_DEV_DIRENTRY pEntries,
+                    ULONG cEntries, ULONG ulPercent, PPAKDUPS *ppDups );
+VOID   PakDupFree( PVOID pHeap, PPAKDUPS pDups );
+ULONG  PakDupSimilarity( PPAKDUPS pDups, ULONG ulRow1, ULONG ulRow2 );
+ULONG  PakDupDiffer( PPAKDUPS pDups, ULONG ulRow1, ULONG ulRow2, POUTBUF pOut );
+
+/*
+ * Use of the information segment (pakinfo.c).  Every offset into a printer's
+ * information segment is followed, to find which of its bytes are referenced
+ * (and how many repeat a string referenced elsewhere), and the segment can be
+ * rebuilt with only those bytes, each distinct string stored once.
+ */
+typedef struct _PAKINFOMAP
+{
+    ULONG  cbInfo;                  // size of the information segment
+    ULONG  cbUsed;                  // bytes referenced
+    ULONG  cbDuplicate;             // ...which repeat a string found elsewhere
+    ULONG  cbTail;                  // bytes of the segment after it
+    ULONG  cUnknown;                // references which could not be followed
+    PULONG pulUsed;                 // bitmap of the bytes referenced
+} PAKINFOMAP, *PPAKINFOMAP;
+
+ULONG  PakInfoMap( PVOID pHeap, PPAK_DEV_DIRENTRY pEntry, PBYTE pBuf, PPAKINFOMAP pMap );
+VOID   PakInfoMapFree( PVOID pHeap, PPAKINFOMAP pMap );
+ULONG  PakInfoCompact( PVOID pHeap, PPAK_DEV_DIRENTRY pEntry, PBYTE pBuf, PBYTE *ppNew,
+                       PULONG pcbNew );
+ULONG  PakCompactImage( PVOID pHeap, PBYTE pbFile, ULONG cbFile, PBYTE *ppbOut, PULONG pcbOut,
+                        PULONG pcCompacted );
+
+/*
+ * Annotated dump of part of a device segment (pakdump.c).  Only the region
+ * asked for is read (plus what is needed to locate it), and each row is
+ * labelled with the DESPPD, UI_BLOCK, UI_ENTRY or UIC_BLOCK fields it holds
+ * or, in the information segment, with the fields pointing into it.
+ */
+ULONG  PakDumpRegion( PVOID pHeap, PSZ pszPakFile, PSZ pszDeviceName, PSZ pszRegion,
+                      POUTBUF pOut );
+
+/*
+ * PPD round trip (pakppd.c, pakcmp.c).  PakCompilePPD() builds a device
+ * segment from the PPD text which GeneratePPD() writes, and
+ * PakCompareDevices() compares two segments field by field, ignoring where
+ * in the information segment each string is stored.
+ */
+ULONG  PakCompilePPD( PVOID pHeap, PCHAR pchText, ULONG cbText, PBYTE *ppSegment,
+                      PULONG pcbSegment );
+ULONG  PakCompareDevices( PPAK_DEV_DIRENTRY pEntry, PBYTE pBuf1, PBYTE pBuf2, PPAKARENA pArena,
+                          POUTBUF pOut, PULONG pflDropped );
+PSZ    PakCompareDropped( ULONG ulGroup );
+
+/*
+ * Field tables of the structures in a device segment (pakfld.c).  Each table
+ * lists a structure's fields in storage order, for the PSDRIVER layout being
+ * built, and ends with an entry whose pszName is NULL.  Field names are as
+ * in pt_struct.h, qualified by the member of the containing structure.
+ */
+#define PAKFT_DESPPD     0          // DESPPD
+#define PAKFT_UI_BLOCK   1          // UI_BLOCK, without its uiEntry[] array
+#define PAKFT_UI_ENTRY   2          // UI_ENTRY
+#define PAKFT_UIC_BLOCK  3          // UIC_BLOCK
+
+#define PF_SIGNED        0x0001     // signed value
+#define PF_HEX           0x0002     // bit mask, best shown in hex
+#define PF_STRING        0x0004     // offset of a string in the information segment
+#define PF_ZERO_OK       0x0008     // ...for which 0 is a valid offset
+#define PF_REQUIRED      0x0010     // ...which is always used, so may not be absent
+#define PF_COMMAND       0x0020     // ...which is a (compressed) PostScript command
+#define PF_TABLE         0x0040     // offset of a table in the information segment
+#define PF_UNKNOWN       0x0080     // ...whose length cannot be determined
+#define PF_POINTER       0x0100     // run-time pointer (meaningless when stored)
+#define PF_NO_PPD        0x0200     // not carried by a PPD file
+#define PF_COUNT         0x0400     // size or number of entries of other data
+
+typedef struct _PAKFIELD
+{
+    PSZ    pszName;                 // field name (NULL at the end of a table)
+    USHORT usOffset;                // offset in the structure
+    USHORT cb;                      // size (1, 2 or 4 bytes)
+    USHORT fs;                      // PF_* flags
+} PAKFIELD, *PPAKFIELD;
+
+PPAKFIELD PakFieldTable( ULONG ulTable );
+LONG   PakFieldValue( PPAKFIELD pField, PVOID pStruct );
+
+
+/*
+ * Field queries (paklazy.c).  PakLazyOpen() reads only a printer's DESPPD;
+ * PakLazyField() then reads the UI list, and the pages of the information
+ * segment, only as the field asked for needs them.  The file handle stays
+ * open across printers, so that a query over a whole PAK file reads only a
+ * small part of it.
+ */
+#define PAKLAZY_PAGE     256        // unit in which the information segment is read
+
+typedef struct _PAKLAZY
+{
+    HFILE  hf;                      // PAK file (from PakLazyOpenFile)
+    ULONG  ulOffset;                // file offset of the segment
+    ULONG  ulSize;                  // size of the segment
+    DESPPD desPPD;                  // the segment's DESPPD
+    PBYTE  pbUIList;                // UI list, once read (else NULL)
+    ULONG  ulInfo;                  // segment offset of the information segment
+    ULONG  cbInfo;                  // usable size of the information segment
+    PBYTE  pbInfo;                  // information segment, as far as read (else NULL)
+    ULONG  aulPages[ 32768 / PAKLAZY_PAGE / 32 ];  // pages of it which have been read
+    ULONG  cbRead;                  // total bytes read from the file
+    PVOID  pHeap;                   // heap for pbUIList and pbInfo
+} PAKLAZY, *PPAKLAZY;
+
+ULONG  PakLazyOpenFile( PSZ pszPakFile, PHFILE phf );
+ULONG  PakLazyOpen( PVOID pHeap, HFILE hf, PPAK_DEV_DIRENTRY pEntry, PPAKLAZY pLazy );
+PSZ    PakLazyString( PPAKLAZY pLazy, LONG lOff );
+ULONG  PakLazyField( PPAKLAZY pLazy, PSZ pszKeyword, PPAKDICT pDict, POUTBUF pOut );
+VOID   PakLazyClose( PPAKLAZY pLazy );
+
+
+/*
+ * Size statistics (pakstat.c).  PakDeviceStats() gives a fixed set of
+ * figures for one device segment, indexed by PAKSTAT_*; PakStatName()
+ * describes each.  Command bytes are those of the PostScript command strings
+ * (PF_COMMAND fields), counted once per reference.
+ */
+#define PAKSTAT_SEGMENT     0       // segment bytes
+#define PAKSTAT_DESCRIPTOR  1       // DESPPD, UI list and UIC list bytes
+#define PAKSTAT_INFO        2       // information segment bytes
+#define PAKSTAT_BLOCKS      3       // UI blocks
+#define PAKSTAT_OPTIONS     4       // UI entries, over all blocks
+#define PAKSTAT_UICS        5       // UI constraints
+#define PAKSTAT_PACKED      6       // command string bytes, as stored
+#define PAKSTAT_EXPANDED    7       // command string bytes, decompressed
+#define PAKSTAT_FONTS       8       // resident fonts
+#define PAKSTAT_PAPERS      9       // papers in the paper tables
+#define PAKSTAT_FORMS       10      // form commands
+#define PAKSTAT_COUNT       11
+
+ULONG  PakDeviceStats( PPAK_DEV_DIRENTRY pEntry, PBYTE pBuf, PPAKARENA pArena, PULONG aulStats );
+PSZ    PakStatName( ULONG ulStat );
+
+
+/*
+ * Code page conversion (pakcp.c).  The strings in a PAK file are in code
+ * page 850; the formatting functions write translation strings as UTF-8.
+ */
+ULONG  Cp850ToUtf8( PBYTE pb, ULONG cb, PBYTE pbOut );
+PSZ    Cp850String( PPAKARENA pArena, PSZ psz );
+void   OutCp850( POUTBUF pOut, PBYTE pb, ULONG cb );
+ULONG  Utf8ToCp850( PSZ psz );
+
+
+/*
+ * Binary patches (pakdelta.c).  PakMakePatch() encodes the differences
+ * between two PAK files, region by region, as runs copied from the old file
+ * or carried in the patch; PakApplyPatch() rebuilds the new file exactly,
+ * checking the size and checksums of both files which are recorded in the
+ * PAKPATCHHDR.  Each region of a patch is one of the PATCH_* kinds.
+ */
+#define PAKPATCH_SIGNATURE  "PAKTOOL PATCH"
+#define PAKPATCH_VERSION    1
+
+#define PATCH_HEADER     0          // signature and directory (to the first segment)
+#define PATCH_SAME       1          // segment of a printer which has not changed
+#define PATCH_CHANGED    2          // segment of a printer which has changed
+#define PATCH_ADDED      3          // segment of a printer not in the old file
+#define PATCH_REMOVED    4          // printer only in the old file (no bytes)
+#define PATCH_OTHER      5          // bytes between or after the segments
+
+typedef struct _PAKPATCHHDR
+{
+    CHAR   szName[ 16 ];            // PAKPATCH_SIGNATURE
+    ULONG  ulVersion;               // PAKPATCH_VERSION
+    ULONG  cbSource;                // size of the old file
+    ULONG  ulSourceHash;            // Pak2HashData() of the old file
+    ULONG  ulSourceCheck;           // Adler-32 checksum of the old file
+    ULONG  cbTarget;                // size of the new file
+    ULONG  ulTargetHash;            // Pak2HashData() of the new file
+    ULONG  ulTargetCheck;           // Adler-32 checksum of the new file
+    ULONG  cRegions;                // regions which follow
+} PAKPATCHHDR, *PPAKPATCHHDR;
+
+typedef struct _PAKPATCHSTATS
+{
+    ULONG  cSame;                   // printers (or, applied, segments) unchanged
+    ULONG  cChanged;                // ...changed
+    ULONG  cAdded;                  // ...added
+    ULONG  cRemoved;                // printers removed
+    ULONG  cRegions;                // regions in the patch
+    ULONG  cbCopied;                // bytes of the new file copied from the old
+    ULONG  cbLiteral;               // bytes of the new file carried in the patch
+    ULONG  cbPatch;                 // size of the patch
+    ULONG  cbTarget;                // size of the new file
+} PAKPATCHSTATS, *PPAKPATCHSTATS;
+
+ULONG  PakMakePatch( PVOID pHeap, PBYTE pbOld, ULONG cbOld, PPAK_DEV_DIRENTRY pOldDir, ULONG cOld,
+                     PBYTE pbNew, ULONG cbNew, PPAK_DEV_DIRENTRY pNewDir, ULONG cNew,
+                     POUTBUF pPatch, PPAKPATCHSTATS pStats );
+ULONG  PakApplyPatch( PVOID pHeap, PBYTE pbOld, ULONG cbOld, PBYTE pbPatch, ULONG cbPatch,
+                      PBYTE *ppbNew, PULONG pcbNew, PPAKPATCHSTATS pStats );
+ULONG  PakPatchList( PBYTE pbPatch, ULONG cbPatch, POUTBUF pOut );
+
+
+/*
+ * Printer names (pakname.c).  PakNameIndex() indexes every suffix of every
+ * normalized printer name (upper case, each run of spaces, hyphens and
+ * underscores taken as one space); PakNameFind() then selects printers by
+ * an exact or abbreviated name, a part of one, or a glob pattern, and
+ * PakNameSuggest() ranks the names nearest to one which was not found.
+ */
+#define PAKNAME_NONE        0       // nothing selected
+#define PAKNAME_EXACT       1       // the (normalized) name itself
+#define PAKNAME_GLOB        2       // names matching a pattern with "*" or "?"
+#define PAKNAME_PREFIX      3       // names beginning with the string given
+#define PAKNAME_SUBSTRING   4       // names containing it
+
+#define PAKNAME_MAX_PATTERN 127     // longest name or pattern which can match
+#define PAKNAME_MAX_SUGGEST 16      // most names PakNameSuggest() gives
+
+typedef struct _PAKNAMES
+{
+    ULONG  cNames;                  // directory entries indexed
+    PSZ    pszText;                 // normalized names, each ending in a null
+    PULONG pulStart;                // offset in pszText of each name
+    PSZ   *ppszSuffix;              // every suffix of every name not starting
+                                    //   with a space, in sorted order
+    ULONG  cSuffixes;               // number of suffixes
+} PAKNAMES, *PPAKNAMES;
+
+ULONG  PakNameNormalize( PCHAR pchIn, ULONG cchMax, PSZ pszOut );
+ULONG  PakNameIndex( PVOID pHeap, PPAK_DEV_DIRENTRY pDir, ULONG cEntries, PPAKNAMES *ppNames );
+VOID   PakNameFree( PVOID pHeap, PPAKNAMES pNames );
+ULONG  PakNameFind( PPAKNAMES pNames, PSZ pszPattern, PULONG pulEntries, ULONG cMax,
+                    PULONG pcFound );
+ULONG  PakNameSuggest( PPAKNAMES pNames, PSZ pszName, PULONG pulEntries, ULONG cMax );
+BOOL   PakNameGlob( PSZ pszPattern, PCHAR pchName );
+
+
+// Formatting of a single device segment
+void   ShowDeviceData( PAK_DEV_DIRENTRY pdd, PBYTE pBuf, PPAKARENA pArena, POUTBUF pOut );
+void   ShowReadableData( PAK_DEV_DIRENTRY pdd, PBYTE pBuf, PPAKARENA pArena, POUTBUF pOut );
+void   GeneratePPD( PBYTE pBuf, PPAKARENA pArena, POUTBUF pOut );
+void   ShowJsonData( PAK_DEV_DIRENTRY pdd, PBYTE pBuf, PPAKARENA pArena, POUTBUF pOut );
+void   DumpBytes( PBYTE pBuf, ULONG cb, BOOL fHex, POUTBUF pOut );
+void   DumpBytesFrom( PBYTE pBuf, ULONG cb, BOOL fHex, PSHORT psCol, POUTBUF pOut );
+void   PrettyBytes( PBYTE pBuf, ULONG cb, POUTBUF pOut );
+
+// String helpers
+PSZ    OffsetToCommand( SHORT sOff, PBYTE pIn, PBYTE pOut, PPAKARENA pArena );
+PSZ    OffsetToProperCommand( SHORT sOff, PBYTE pIn, PBYTE pOut, PPAKARENA pArena );
+USHORT DecompressString(PSZ pszBuffIn, PSZ pszBuffOut);
+USHORT DecompressStringDict( PPAKDICT pDict, PSZ pszBuffIn, PSZ pszBuffOut );
+USHORT ExpandString( PPAKARENA pArena, PSZ pszBuffIn, PSZ pszBuffOut );
+LONG   DecompressedLength( PPAKDICT pDict, PSZ pszBuffIn );
+
+#endif
@@ -0,0 +1,470 @@
+/*
+ * pakname.c
+ *
+ * PAKTOOL library: finding printers by an abbreviated or approximate name.
+ * PakNameIndex() normalizes the name of every directory entry (upper case,
+ * with each run of spaces, hyphens and underscores taken as one space) and
+ * sorts every suffix of every name, so that the names beginning with, equal
+ * to or containing a given string are found by binary search over the
+ * suffixes.  PakNameFind() takes an exact (normalized) name first, then the
+ * names a glob pattern matches, or the names beginning with the string
+ * given, or failing those the names containing it.  PakNameSuggest() ranks
+ * the names nearest to one which was not found, by the edit distance of the
+ * string given from the start of each name or of any word in it.
+ */
+
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+
+#define MAX_EDIT            40      // longest string compared by edit distance
+
+// Size of a printer name (not necessarily null-terminated)
+#define CCH_DEVICE_NAME     sizeof( ((PPAK_DEV_DIRENTRY) 0)->szDeviceName )
+
+
+/* ------------------------------------------------------------------------- *
+ * PakNameNormalize                                                          *
+ *                                                                           *
+ * Copy a name (or pattern) in the normalized form which the name index      *
+ * uses: upper case, without leading or trailing separators, and with each   *
+ * run of separators (space, tab, hyphen or underscore) replaced by one      *
+ * space.                                                                    *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PCHAR pchIn : The name (null-terminated if shorter than cchMax)         *
+ *   ULONG cchMax: Most characters of it to use                              *
+ *   PSZ   pszOut: Receives the normalized name (cchMax + 1 bytes)           *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   The length of the normalized name                                       *
+ * ------------------------------------------------------------------------- */
+ULONG PakNameNormalize( PCHAR pchIn, ULONG cchMax, PSZ pszOut )
+{
+    ULONG cch = 0,
+          i;
+    BOOL  fSeparator = FALSE;
+
+    for ( i = 0; ( i < cchMax ) && pchIn[ i ]; i++ ) {
+        if ( strchr(" \t-_", pchIn[ i ] )) {
+            fSeparator = ( cch > 0 );
+            continue;
+        }
+        if ( fSeparator ) {
+            if ( cch >= cchMax - 1 ) break;
+            pszOut[ cch++ ] = ' ';
+            fSeparator = FALSE;
+        }
+        pszOut[ cch++ ] = (CHAR) toupper( (UCHAR) pchIn[ i ] );
+    }
+    pszOut[ cch ] = 0;
+    return cch;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CompareSuffixes                                                           *
+ *                                                                           *
+ * qsort() comparison of two suffixes.                                       *
+ * ------------------------------------------------------------------------- */
+static int CompareSuffixes( const void *p1, const void *p2 )
+{
+    return strcmp( *((PSZ *) p1 ), *((PSZ *) p2 ));
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakNameIndex                                                              *
+ *                                                                           *
+ * Build the name index of a directory.                                      *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID             pHeap   : Heap to allocate from (or NULL)             *
+ *   PPAK_DEV_DIRENTRY pDir    : The directory entries                       *
+ *   ULONG             cEntries: Number of entries                           *
+ *   PPAKNAMES        *ppNames : Receives the index (free with PakNameFree)  *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, or ERROR_NOT_ENOUGH_MEMORY                                *
+ * ------------------------------------------------------------------------- */
+ULONG PakNameIndex( PVOID pHeap, PPAK_DEV_DIRENTRY pDir, ULONG cEntries, PPAKNAMES *ppNames )
+{
+    PPAKNAMES pNames;
+    ULONG     ulPos,
+              cch,
+              i, j;
+
+    *ppNames = NULL;
+    if (( pNames = (PPAKNAMES) PakAlloc( pHeap, sizeof( PAKNAMES ))) == NULL )
+        return ERROR_NOT_ENOUGH_MEMORY;
+    memset( pNames, 0, sizeof( PAKNAMES ));
+    pNames->cNames     = cEntries;
+    pNames->pszText    = (PSZ) PakAlloc( pHeap, cEntries * ( CCH_DEVICE_NAME + 1 ) + 1 );
+    pNames->pulStart   = (PULONG) PakAlloc( pHeap, cEntries * sizeof( ULONG ) + 1 );
+    pNames->ppszSuffix = (PSZ *) PakAlloc( pHeap, cEntries * CCH_DEVICE_NAME * sizeof( PSZ ) + 1 );
+    if ( !pNames->pszText || !pNames->pulStart || !pNames->ppszSuffix ) {
+        PakNameFree( pHeap, pNames );
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    // No query begins with a space, so neither need any suffix
+    for ( i = 0, ulPos = 0; i < cEntries; i++ ) {
+        pNames->pulStart[ i ] = ulPos;
+        cch = PakNameNormalize( pDir[ i ].szDeviceName, CCH_DEVICE_NAME, pNames->pszText + ulPos );
+        for ( j = 0; j < cch; j++ )
+            if ( pNames->pszText[ ulPos + j ] != ' ')
+                pNames->ppszSuffix[ pNames->cSuffixes++ ] = pNames->pszText + ulPos + j;
+        ulPos += cch + 1;
+    }
+    qsort( pNames->ppszSuffix, pNames->cSuffixes, sizeof( PSZ ), CompareSuffixes );
+
+    *ppNames = pNames;
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- */
+VOID PakNameFree( PVOID pHeap, PPAKNAMES pNames )
+{
+    if ( !pNames ) return;
+    PakFree( pHeap, pNames->pszText );
+    PakFree( pHeap, pNames->pulStart );
+    PakFree( pHeap, pNames->ppszSuffix );
+    PakFree( pHeap, pNames );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * NameOwner                                                                 *
+ *                                                                           *
+ * Return the entry whose normalized name holds the given suffix.            *
+ * ------------------------------------------------------------------------- */
+static ULONG NameOwner( PPAKNAMES pNames, PSZ pszSuffix )
+{
+    ULONG ulOff = pszSuffix - pNames->pszText,
+          ulLow = 0,
+          ulHigh = pNames->cNames,
+          ulMid;
+
+    // The last name starting at or before the suffix
+    while ( ulHigh - ulLow > 1 ) {
+        ulMid = ( ulLow + ulHigh ) / 2;
+        if ( pNames->pulStart[ ulMid ] <= ulOff ) ulLow = ulMid;
+        else ulHigh = ulMid;
+    }
+    return ulLow;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * SuffixRange                                                               *
+ *                                                                           *
+ * Find the range [*pulFirst, *pulEnd) of the sorted suffixes which begin    *
+ * with the given string.                                                    *
+ * ------------------------------------------------------------------------- */
+static void SuffixRange( PPAKNAMES pNames, PSZ psz, ULONG cch, PULONG pulFirst, PULONG pulEnd )
+{
+    ULONG ulLow,
+          ulHigh,
+          ulMid;
+
+    for ( ulLow = 0, ulHigh = pNames->cSuffixes; ulLow < ulHigh; ) {
+        ulMid = ( ulLow + ulHigh ) / 2;
+        if ( strncmp( pNames->ppszSuffix[ ulMid ], psz, cch ) < 0 ) ulLow = ulMid + 1;
+        else ulHigh = ulMid;
+    }
+    *pulFirst = ulLow;
+    for ( ulHigh = pNames->cSuffixes; ulLow < ulHigh; ) {
+        ulMid = ( ulLow + ulHigh ) / 2;
+        if ( strncmp( pNames->ppszSuffix[ ulMid ], psz, cch ) <= 0 ) ulLow = ulMid + 1;
+        else ulHigh = ulMid;
+    }
+    *pulEnd = ulLow;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CompareEntries                                                            *
+ *                                                                           *
+ * qsort() comparison of two directory indexes.                              *
+ * ------------------------------------------------------------------------- */
+static int CompareEntries( const void *p1, const void *p2 )
+{
+    ULONG ul1 = *((PULONG) p1 ),
+          ul2 = *((PULONG) p2 );
+
+    return ( ul1 < ul2 ) ? -1 : ( ul1 > ul2 );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * GlobMatch                                                                 *
+ *                                                                           *
+ * Whether a (normalized) name matches a (normalized) pattern, in which "*"  *
+ * stands for any run of characters and "?" for any one character.           *
+ * ------------------------------------------------------------------------- */
+static BOOL GlobMatch( PSZ pszPattern, PSZ pszName )
+{
+    PSZ pszStar = NULL,             // just after the last "*" seen
+        pszRetry = NULL;            // where in the name that "*" is to resume
+
+    while ( *pszName ) {
+        if ( *pszPattern == '*') {
+            pszStar  = ++pszPattern;
+            pszRetry = pszName;
+        }
+        else if (( *pszPattern == '?') || ( *pszPattern == *pszName )) {
+            pszPattern++;
+            pszName++;
+        }
+        else if ( pszStar ) {
+            pszPattern = pszStar;
+            pszName    = ++pszRetry;
+        }
+        else return FALSE;
+    }
+    while ( *pszPattern == '*') pszPattern++;
+    return !*pszPattern;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakNameGlob                                                               *
+ *                                                                           *
+ * Test one printer name against a glob pattern ("*" for any run of          *
+ * characters, "?" for any one), both being normalized as by PakNameIndex(). *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ   pszPattern: The pattern                                           *
+ *   PCHAR pchName   : The printer name (as in a PAK_DEV_DIRENTRY)           *
+ *                                                                           *
+ * RETURNS: BOOL                                                             *
+ *   TRUE if the name matches                                                *
+ * ------------------------------------------------------------------------- */
+BOOL PakNameGlob( PSZ pszPattern, PCHAR pchName )
+{
+    CHAR szPattern[ PAKNAME_MAX_PATTERN + 1 ],
+         szName[ CCH_DEVICE_NAME + 1 ];
+
+    if ( strlen( pszPattern ) > PAKNAME_MAX_PATTERN ) return FALSE;
+    PakNameNormalize( pszPattern, PAKNAME_MAX_PATTERN, szPattern );
+    PakNameNormalize( pchName, CCH_DEVICE_NAME, szName );
+    return GlobMatch( szPattern, szName );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakNameFind                                                               *
+ *                                                                           *
+ * Find the printers which a name or pattern selects.  The first of these    *
+ * which selects anything is used:                                           *
+ *   PAKNAME_EXACT     - names equal to it (once both are normalized)        *
+ *   PAKNAME_GLOB      - if it holds "*" or "?", names matching it as a glob *
+ *   PAKNAME_PREFIX    - names beginning with it                             *
+ *   PAKNAME_SUBSTRING - names containing it                                 *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAKNAMES pNames    : The name index                                    *
+ *   PSZ       pszPattern: The name or pattern                               *
+ *   PULONG    pulEntries: Receives the directory indexes of (up to cMax of) *
+ *                         the printers selected, in directory order         *
+ *   ULONG     cMax      : Size of pulEntries                                *
+ *   PULONG    pcFound   : Receives the number of printers selected, which   *
+ *                         may be more than cMax                             *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   PAKNAME_* for how the printers were selected, or PAKNAME_NONE           *
+ * ------------------------------------------------------------------------- */
+ULONG PakNameFind( PPAKNAMES pNames, PSZ pszPattern, PULONG pulEntries, ULONG cMax,
+                   PULONG pcFound )
+{
+    CHAR  szQuery[ PAKNAME_MAX_PATTERN + 1 ],
+          szLiteral[ PAKNAME_MAX_PATTERN + 1 ];
+    PSZ   psz,
+          pszName;
+    ULONG ulHow = PAKNAME_NONE,
+          ulFirst,
+          ulEnd,
+          ulOwner,
+          cchQuery,
+          cchLiteral = 0,
+          cch,
+          c = 0,
+          i, k;
+
+    *pcFound = 0;
+    if ( strlen( pszPattern ) > PAKNAME_MAX_PATTERN ) return PAKNAME_NONE;
+    if (( cchQuery = PakNameNormalize( pszPattern, PAKNAME_MAX_PATTERN, szQuery )) == 0 )
+        return PAKNAME_NONE;
+
+    if ( !strpbrk( szQuery, "*?")) {
+        SuffixRange( pNames, szQuery, cchQuery, &ulFirst, &ulEnd );
+
+        // The same range holds the exact matches, the prefixes and the substrings
+        for ( ulHow = PAKNAME_EXACT; ulHow <= PAKNAME_SUBSTRING; ulHow++ ) {
+            if ( ulHow == PAKNAME_GLOB ) continue;
+            for ( k = ulFirst; k < ulEnd; k++ ) {
+                psz     = pNames->ppszSuffix[ k ];
+                ulOwner = NameOwner( pNames, psz );
+                pszName = pNames->pszText + pNames->pulStart[ ulOwner ];
+                if ( ulHow == PAKNAME_SUBSTRING ) {
+                    if ( (PSZ) strstr( pszName, szQuery ) != psz ) continue;  // counted already
+                }
+                else if (( psz != pszName ) || (( ulHow == PAKNAME_EXACT ) && psz[ cchQuery ] ))
+                    continue;
+                if ( c < cMax ) pulEntries[ c ] = ulOwner;
+                c++;
+            }
+            if ( c ) break;
+        }
+    }
+    else {
+        // The longest run of plain characters narrows the names to be tried
+        for ( psz = szQuery; *psz; psz += cch ) {
+            cch = strcspn( psz, "*?");
+            if ( cch > cchLiteral ) {
+                memcpy( szLiteral, psz, cch );
+                szLiteral[ cch ] = 0;
+                cchLiteral = cch;
+            }
+            if ( !cch ) cch = 1;
+        }
+        ulHow = PAKNAME_GLOB;
+        if ( !cchLiteral ) {
+            for ( i = 0; i < pNames->cNames; i++ ) {
+                if ( !GlobMatch( szQuery, pNames->pszText + pNames->pulStart[ i ] )) continue;
+                if ( c < cMax ) pulEntries[ c ] = i;
+                c++;
+            }
+        }
+        else {
+            SuffixRange( pNames, szLiteral, cchLiteral, &ulFirst, &ulEnd );
+            for ( k = ulFirst; k < ulEnd; k++ ) {
+                psz     = pNames->ppszSuffix[ k ];
+                ulOwner = NameOwner( pNames, psz );
+                pszName = pNames->pszText + pNames->pulStart[ ulOwner ];
+                if ( (PSZ) strstr( pszName, szLiteral ) != psz ) continue;
+                if ( !GlobMatch( szQuery, pszName )) continue;
+                if ( c < cMax ) pulEntries[ c ] = ulOwner;
+                c++;
+            }
+        }
+    }
+
+    qsort( pulEntries, ( c < cMax ) ? c : cMax, sizeof( ULONG ), CompareEntries );
+    *pcFound = c;
+    return c ? ulHow : PAKNAME_NONE;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakNameSuggest                                                            *
+ *                                                                           *
+ * Rank the printer names nearest to one which was not found.  Each name is  *
+ * scored by the edit distance (counting insertions, deletions,              *
+ * substitutions and transpositions of adjacent characters) of the string    *
+ * given from the nearest prefix of the name, or of its text from the start  *
+ * of any word; names within a third of the string's length (at least one)   *
+ * are kept, the closest first, and between equals a match at the start of   *
+ * the name, then the shorter name, is preferred.                            *
+ *                                                                           *
+ * The suffixes starting words are taken in sorted order, as the paths of a  *
+ * trie would be, so that the rows of the distance table for the characters  *
+ * a suffix shares with the one before it are kept rather than recomputed;   *
+ * a suffix is abandoned at the first row with no value within the limit.    *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAKNAMES pNames    : The name index                                    *
+ *   PSZ       pszName   : The name which was not found                      *
+ *   PULONG    pulEntries: Receives the directory indexes of the names       *
+ *                         suggested, best first                             *
+ *   ULONG     cMax      : Most names to suggest (up to PAKNAME_MAX_SUGGEST) *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   The number of names suggested                                           *
+ * ------------------------------------------------------------------------- */
+ULONG PakNameSuggest( PPAKNAMES pNames, PSZ pszName, PULONG pulEntries, ULONG cMax )
+{
+    CHAR   szQuery[ MAX_EDIT + 1 ];
+    PSZ    psz,
+           pszPrev = NULL,
+           pszText;
+    ULONG  aulTable[ MAX_EDIT + 1 ][ MAX_EDIT + 1 ],  // [ name row ][ query column ]
+           aulBest[ MAX_EDIT + 1 ],     // least distance of any prefix up to each row
+           aulRowMin[ MAX_EDIT + 1 ],   // least value in each row
+           aulScores[ PAKNAME_MAX_SUGGEST ],
+           cchQuery,
+           cRows = 0,
+           ulLimit,
+           ulOwner,
+           ulScore,
+           ul,
+           i, j, k, r;
+    PULONG pulRow,
+           pulUp;
+
+    if ( cMax > PAKNAME_MAX_SUGGEST ) cMax = PAKNAME_MAX_SUGGEST;
+    if ( !cMax || (( cchQuery = PakNameNormalize( pszName, MAX_EDIT, szQuery )) == 0 )) return 0;
+    ulLimit = ( cchQuery < 6 ) ? 1 : cchQuery / 3;
+
+    // Row 0 is the distance from each prefix of the string to an empty name
+    for ( j = 0; j <= cchQuery; j++ ) aulTable[ 0 ][ j ] = j;
+    aulBest[ 0 ]   = cchQuery;
+    aulRowMin[ 0 ] = 0;
+
+    for ( k = 0, i = 0; k < pNames->cSuffixes; k++ ) {
+        psz = pNames->ppszSuffix[ k ];
+        if (( psz != pNames->pszText ) && psz[ -1 ] && ( psz[ -1 ] != ' ')) continue;
+
+        // Keep the rows for the characters shared with the previous suffix
+        for ( r = 0; ( r < cRows ) && psz[ r ] && ( psz[ r ] == pszPrev[ r ] ); r++ );
+        pszPrev = psz;
+        for ( ; psz[ r ] && ( r < MAX_EDIT ) && ( aulRowMin[ r ] <= ulLimit ); r++ ) {
+            pulUp  = aulTable[ r ];
+            pulRow = aulTable[ r + 1 ];
+            pulRow[ 0 ] = aulRowMin[ r + 1 ] = r + 1;
+            for ( j = 1; j <= cchQuery; j++ ) {
+                ul = pulUp[ j - 1 ] + (( psz[ r ] == szQuery[ j - 1 ] ) ? 0 : 1 );
+                if ( pulUp[ j ] + 1 < ul ) ul = pulUp[ j ] + 1;
+                if ( pulRow[ j - 1 ] + 1 < ul ) ul = pulRow[ j - 1 ] + 1;
+                if (( r > 0 ) && ( j > 1 ) && ( psz[ r ] == szQuery[ j - 2 ] ) &&
+                    ( psz[ r - 1 ] == szQuery[ j - 1 ] ) && ( aulTable[ r - 1 ][ j - 2 ] + 1 < ul ))
+                    ul = aulTable[ r - 1 ][ j - 2 ] + 1;
+                pulRow[ j ] = ul;
+                if ( ul < aulRowMin[ r + 1 ] ) aulRowMin[ r + 1 ] = ul;
+            }
+            aulBest[ r + 1 ] = ( pulRow[ cchQuery ] < aulBest[ r ] ) ? pulRow[ cchQuery ] : aulBest[ r ];
+        }
+        cRows = r;
+        if ( aulBest[ r ] > ulLimit ) continue;
+
+        ulOwner = NameOwner( pNames, psz );
+        pszText = pNames->pszText + pNames->pulStart[ ulOwner ];
+        ulScore = ( aulBest[ r ] << 16 ) | (( psz != pszText ) ? 0x8000 : 0 ) | strlen( pszText );
+
+        // Insert it among the best so far, replacing any worse score for the same name
+        for ( j = 0; ( j < i ) && ( pulEntries[ j ] != ulOwner ); j++ );
+        if ( j < i ) {
+            if ( ulScore >= aulScores[ j ] ) continue;
+            for ( ; j + 1 < i; j++ ) {
+                aulScores[ j ]  = aulScores[ j + 1 ];
+                pulEntries[ j ] = pulEntries[ j + 1 ];
+            }
+            i--;
+        }
+        if (( i == cMax ) && ( ulScore >= aulScores[ i - 1 ] )) continue;
+        for ( j = ( i < cMax ) ? i++ : i - 1; j > 0 && aulScores[ j - 1 ] > ulScore; j-- ) {
+            aulScores[ j ]  = aulScores[ j - 1 ];
+            pulEntries[ j ] = pulEntries[ j - 1 ];
+        }
+        aulScores[ j ]  = ulScore;
+        pulEntries[ j ] = ulOwner;
+    }
+    return i;
+}
@@ -0,0 +1,304 @@
+/*
+ * pakpaper.c
+ *
+ * PAKTOOL library: paper size tables.  See paklib.h for an overview.
+ *
+ * The PaperDimension table (desPage.ofsDimxyPgsz) is a list of fixed records
+ * of three SHORTs (PageSize entry, width, height); the ImageableArea table
+ * (desPage.ofsImgblPgsz) is a list of five SHORTs (PageSize entry, then the
+ * lower left and upper right corners) each followed by a translation string.
+ * Both are decoded here, as GeneratePPD() does, but with every offset and
+ * entry number checked, so that damaged records are simply skipped.
+ */
+
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+
+#define DIM_RECORD_SIZE     ( 3 * sizeof( SHORT ))  // PaperDimension record
+#define IMG_RECORD_SIZE     ( 5 * sizeof( SHORT ))  // ImageableArea record
+                                                    //   (before its string)
+
+#define SHORT_EDGE( p )     (( (p)->cx < (p)->cy ) ? (p)->cx : (p)->cy )
+#define LONG_EDGE( p )      (( (p)->cx < (p)->cy ) ? (p)->cy : (p)->cx )
+
+
+/* ------------------------------------------------------------------------- *
+ * InfoString                                                                *
+ *                                                                           *
+ * Return the string at an offset into the information segment, or NULL if   *
+ * the offset is not that of a valid string.                                 *
+ * ------------------------------------------------------------------------- */
+static PSZ InfoString( PBYTE pInfoSeg, ULONG cbInfo, LONG lOff )
+{
+    if (( lOff <= 0 ) || ( (ULONG) lOff >= cbInfo ) ||
+        !memchr( pInfoSeg + lOff, 0, cbInfo - lOff ))
+        return NULL;
+    return (PSZ)( pInfoSeg + lOff );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ComparePapers                                                             *
+ *                                                                           *
+ * qsort() comparison of papers by short edge, then long edge, then entry.   *
+ * ------------------------------------------------------------------------- */
+static int ComparePapers( const void *p1, const void *p2 )
+{
+    PPAKPAPER pp1 = (PPAKPAPER) p1,
+              pp2 = (PPAKPAPER) p2;
+
+    if ( SHORT_EDGE( pp1 ) != SHORT_EDGE( pp2 )) return SHORT_EDGE( pp1 ) - SHORT_EDGE( pp2 );
+    if ( LONG_EDGE( pp1 ) != LONG_EDGE( pp2 ))   return LONG_EDGE( pp1 ) - LONG_EDGE( pp2 );
+    return pp1->sEntry - pp2->sEntry;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CompareForms                                                              *
+ * ------------------------------------------------------------------------- */
+static int CompareForms( const void *p1, const void *p2 )
+{
+    return strcmp( *((PSZ *) p1 ), *((PSZ *) p2 ));
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * FindPageSize                                                              *
+ *                                                                           *
+ * Find the PageSize UI block, whose entries the paper tables refer to.      *
+ * ------------------------------------------------------------------------- */
+static PUI_BLOCK FindPageSize( PBYTE pBuf, PDESPPD pdesPPD, PBYTE pInfoSeg, ULONG cbInfo )
+{
+    PUI_BLOCK puib;
+    PBYTE     pb = pBuf + sizeof( DESPPD );
+    ULONG     cbLeft = pdesPPD->stUIList.usBlockListSize,
+              cb, i;
+    PSZ       psz;
+
+    for ( i = 0; i < pdesPPD->stUIList.usNumOfBlocks; i++ ) {
+        puib = (PUI_BLOCK) pb;
+        if (( cbLeft < UI_BLOCK_FIXED ) ||
+            (( cb = UI_BLOCK_FIXED + puib->usNumOfEntries * sizeof( UI_ENTRY )) > cbLeft ))
+            break;
+        if ((( psz = InfoString( pInfoSeg, cbInfo, puib->ofsUIName )) != NULL ) &&
+            ( strcmp( psz, "PageSize") == 0 ))
+            return puib;
+        pb     += cb;
+        cbLeft -= cb;
+    }
+    return NULL;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakPaperBuild                                                             *
+ *                                                                           *
+ * Decode the paper tables and forms list of a device segment.               *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID       pHeap    : Heap to allocate from (or NULL)                  *
+ *   PPAKARENA   pArena   : Arena giving the dictionary and string map to    *
+ *                          use for the form commands (or NULL)              *
+ *   PBYTE       pBuf     : Device segment (must stay in memory while the    *
+ *                          tables are used)                                 *
+ *   ULONG       cbBuf    : Size of the segment                              *
+ *   PPAKPAPERS *ppPapers : Receives the tables (free with PakPaperFree)     *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_INVALID_DATA if the segment is too small, or        *
+ *   ERROR_NOT_ENOUGH_MEMORY                                                 *
+ * ------------------------------------------------------------------------- */
+ULONG PakPaperBuild( PVOID pHeap, PPAKARENA pArena, PBYTE pBuf, ULONG cbBuf, PPAKPAPERS *ppPapers )
+{
+    DESPPD     desPPD;
+    PPAKPAPERS pPapers;
+    PPAKPAPER  pPaper;
+    PUI_BLOCK  puiPaper;
+    PBYTE      pInfoSeg,
+               pbPool;
+    PSHORT     psVal;
+    PLONG      plVal;
+    PSZ        psz;
+    ULONG      cbLists,
+               cbInfo,
+               cDims,
+               cForms,
+               cbPool,
+               cb, ulOff, i, j;
+    LONG       lLen;
+    SHORT      sEntry;
+
+    *ppPapers = NULL;
+    if ( cbBuf < sizeof( DESPPD )) return ERROR_INVALID_DATA;
+    memcpy( &desPPD, pBuf, sizeof( DESPPD ));
+    cbLists = desPPD.stUIList.usBlockListSize + desPPD.stUICList.usNumOfUICs * sizeof( UIC_BLOCK );
+    if ( cbLists > cbBuf - sizeof( DESPPD )) return ERROR_INVALID_DATA;
+    pInfoSeg = pBuf + sizeof( DESPPD ) + cbLists;
+    cbInfo   = cbBuf - sizeof( DESPPD ) - cbLists;
+    if (( desPPD.desItems.iSizeBuffer >= 0 ) && ( (ULONG) desPPD.desItems.iSizeBuffer < cbInfo ))
+        cbInfo = desPPD.desItems.iSizeBuffer;
+    puiPaper = FindPageSize( pBuf, &desPPD, pInfoSeg, cbInfo );
+
+    // Count what will be kept: the dimension records which fit the segment,
+    // and the form commands (measuring their decompressed size)
+    cDims = 0;
+    if (( desPPD.desPage.iDmpgpairs > 0 ) && ( desPPD.desPage.ofsDimxyPgsz > 0 ) &&
+        ( (ULONG) desPPD.desPage.ofsDimxyPgsz < cbInfo ))
+    {
+        cDims = ( cbInfo - desPPD.desPage.ofsDimxyPgsz ) / DIM_RECORD_SIZE;
+        if ( cDims > (ULONG) desPPD.desPage.iDmpgpairs ) cDims = desPPD.desPage.iDmpgpairs;
+    }
+    cForms = 0;
+    cbPool = 0;
+    if (( desPPD.desForms.usFormCount ) && ( desPPD.desForms.ofsFormIndex > 0 ) &&
+        ( (ULONG) desPPD.desForms.ofsFormIndex < cbInfo ))
+    {
+        cForms = ( cbInfo - desPPD.desForms.ofsFormIndex ) / sizeof( LONG );
+        if ( cForms > desPPD.desForms.usFormCount ) cForms = desPPD.desForms.usFormCount;
+        plVal = (PLONG)( pInfoSeg + desPPD.desForms.ofsFormIndex );
+        for ( i = 0; i < cForms; i++ ) {
+            if (( psz = InfoString( pInfoSeg, cbInfo, (SHORT) plVal[ i ] )) != NULL &&
+                ( lLen = DecompressedLength( pArena ? pArena->pDict : NULL, psz )) >= 0 )
+                cbPool += lLen + 1;
+        }
+    }
+
+    cb = sizeof( PAKPAPERS ) + cDims * sizeof( PAKPAPER ) + cForms * sizeof( PSZ ) + cbPool;
+    if (( pPapers = (PPAKPAPERS) PakAlloc( pHeap, cb )) == NULL )
+        return ERROR_NOT_ENOUGH_MEMORY;
+    memset( pPapers, 0, cb );
+    pPapers->aPapers   = (PPAKPAPER)( pPapers + 1 );
+    pPapers->apszForms = (PSZ *)( pPapers->aPapers + cDims );
+    pbPool             = (PBYTE)( pPapers->apszForms + cForms );
+
+    // Paper dimensions, named after the PageSize entries they refer to
+    psVal = (PSHORT)( pInfoSeg + desPPD.desPage.ofsDimxyPgsz );
+    for ( i = 0; i < cDims; i++, psVal += 3 ) {
+        sEntry = psVal[ 0 ];
+        if ( !puiPaper || sEntry < 0 || sEntry >= puiPaper->usNumOfEntries ) continue;
+        pPaper = pPapers->aPapers + pPapers->cPapers++;
+        pPaper->sEntry   = sEntry;
+        pPaper->cx       = psVal[ 1 ];
+        pPaper->cy       = psVal[ 2 ];
+        pPaper->pszName  = InfoString( pInfoSeg, cbInfo, puiPaper->uiEntry[ sEntry ].ofsOption );
+        if ( !pPaper->pszName ) pPaper->pszName = "(none)";
+        pPaper->pszXlate = InfoString( pInfoSeg, cbInfo, puiPaper->uiEntry[ sEntry ].ofsTransString );
+        if ( !pPaper->pszXlate ) pPaper->pszXlate = pPaper->pszName;
+    }
+
+    // Imageable areas, which are matched to the papers by entry number
+    ulOff = desPPD.desPage.ofsImgblPgsz;
+    for ( i = 0; ( desPPD.desPage.ofsImgblPgsz > 0 ) && ( i < (ULONG) desPPD.desPage.iImgpgpairs ); i++ ) {
+        if (( ulOff >= cbInfo ) || ( cbInfo - ulOff < IMG_RECORD_SIZE + 1 ) ||
+            !memchr( pInfoSeg + ulOff + IMG_RECORD_SIZE, 0, cbInfo - ulOff - IMG_RECORD_SIZE ))
+            break;
+        psVal = (PSHORT)( pInfoSeg + ulOff );
+        psz   = (PSZ)( pInfoSeg + ulOff + IMG_RECORD_SIZE );
+        for ( j = 0; j < pPapers->cPapers; j++ ) {
+            pPaper = pPapers->aPapers + j;
+            if ( pPaper->sEntry != psVal[ 0 ] ) continue;
+            pPaper->fImageable = TRUE;
+            pPaper->xLeft      = psVal[ 1 ];
+            pPaper->yBottom    = psVal[ 2 ];
+            pPaper->xRight     = psVal[ 3 ];
+            pPaper->yTop       = psVal[ 4 ];
+            if ( *psz && ( pPaper->pszXlate == pPaper->pszName )) pPaper->pszXlate = psz;
+        }
+        ulOff += IMG_RECORD_SIZE + strlen( psz ) + 1;
+    }
+    qsort( pPapers->aPapers, pPapers->cPapers, sizeof( PAKPAPER ), ComparePapers );
+
+    // Form commands
+    plVal = (PLONG)( pInfoSeg + desPPD.desForms.ofsFormIndex );
+    for ( i = 0; i < cForms; i++ ) {
+        if (( psz = InfoString( pInfoSeg, cbInfo, (SHORT) plVal[ i ] )) == NULL ||
+            ( lLen = DecompressedLength( pArena ? pArena->pDict : NULL, psz )) < 0 )
+            continue;
+        pPapers->apszForms[ pPapers->cForms++ ] = (PSZ) pbPool;
+        ExpandString( pArena, psz, (PSZ) pbPool );
+        pbPool[ lLen ] = 0;
+        pbPool += lLen + 1;
+    }
+    qsort( pPapers->apszForms, pPapers->cForms, sizeof( PSZ ), CompareForms );
+
+    *ppPapers = pPapers;
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- */
+VOID PakPaperFree( PVOID pHeap, PPAKPAPERS pPapers )
+{
+    PakFree( pHeap, pPapers );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakPaperNearest                                                           *
+ *                                                                           *
+ * Find the paper closest in size to a document.  A paper matches if both of *
+ * its edges are within the tolerance of the document's; the closest is the  *
+ * one whose worse edge is nearest.  Unless PAKPAPER_FIXED is given, papers  *
+ * may match in either orientation, but one which matches the right way      *
+ * round is preferred to an equally close one which must be turned.          *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAKPAPERS pPapers   : Paper tables                                     *
+ *   LONG       cx, cy    : Document width and height (points)               *
+ *   LONG       lTolerance: Largest difference allowed in either edge        *
+ *   ULONG      flOptions : PAKPAPER_FIXED to match the orientation given    *
+ *   PBOOL      pfRotated : Receives TRUE if the paper must be turned to     *
+ *                          match (may be NULL)                              *
+ *                                                                           *
+ * RETURNS: PPAKPAPER                                                        *
+ *   Closest paper, or NULL if none is within the tolerance                  *
+ * ------------------------------------------------------------------------- */
+PPAKPAPER PakPaperNearest( PPAKPAPERS pPapers, LONG cx, LONG cy, LONG lTolerance,
+                           ULONG flOptions, PBOOL pfRotated )
+{
+    PPAKPAPER pPaper,
+              pBest = NULL;
+    LONG      lShort = ( cx < cy ) ? cx : cy,
+              lLong  = ( cx < cy ) ? cy : cx,
+              lDist, lBest = 0;
+    ULONG     ulLow, ulHigh, ulMid;
+    BOOL      fRotated, fBestRotated = FALSE;
+
+    if ( lTolerance < 0 ) lTolerance = 0;
+
+    // Binary search for the first paper whose short edge is close enough
+    ulLow  = 0;
+    ulHigh = pPapers->cPapers;
+    while ( ulLow < ulHigh ) {
+        ulMid = ( ulLow + ulHigh ) / 2;
+        if ( SHORT_EDGE( pPapers->aPapers + ulMid ) < lShort - lTolerance )
+            ulLow = ulMid + 1;
+        else
+            ulHigh = ulMid;
+    }
+
+    for ( ; ulLow < pPapers->cPapers; ulLow++ ) {
+        pPaper = pPapers->aPapers + ulLow;
+        if ( SHORT_EDGE( pPaper ) > lShort + lTolerance ) break;
+        lDist = labs( LONG_EDGE( pPaper ) - lLong );
+        if ( lDist > lTolerance ) continue;
+        if ( labs( SHORT_EDGE( pPaper ) - lShort ) > lDist )
+            lDist = labs( SHORT_EDGE( pPaper ) - lShort );
+        fRotated = ( pPaper->cx != pPaper->cy ) && ( cx != cy ) &&
+                   (( pPaper->cx < pPaper->cy ) != ( cx < cy ));
+        if ( fRotated && ( flOptions & PAKPAPER_FIXED )) continue;
+        if ( !pBest || ( lDist < lBest ) || (( lDist == lBest ) && fBestRotated && !fRotated )) {
+            pBest        = pPaper;
+            lBest        = lDist;
+            fBestRotated = fRotated;
+        }
+    }
+    if ( pfRotated ) *pfRotated = fBestRotated;
+    return pBest;
+}
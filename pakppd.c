@@ -0,0 +1,727 @@
+/*
+ * pakppd.c
+ *
+ * PAKTOOL library: PPD compiler.  PakCompilePPD() builds a device segment
+ * (DESPPD, UI list, UI constraints and information segment) from the text of
+ * a PPD file, so that the PPD written by GeneratePPD() can be compiled again
+ * and compared with the entry it came from (see PakCompareDevices()).
+ *
+ * The text is read as statements of the form
+ *
+ *    *Keyword Option/Translation: Value
+ *
+ * where a quoted value may run over several lines.  Only the keywords which
+ * GeneratePPD() writes are used; those for which the segment has no field
+ * (and comments, queries and the like) are skipped.  Quoted values are stored
+ * as they are written, hex substrings included, since that is how the
+ * driver's PPD compiler stores them (ExpandString() decodes them), except
+ * that bytes above 127 in command strings are written as hex so that they are
+ * not taken for keyword numbers.  Strings are not compressed.
+ *
+ * The information segment starts with an empty string, so that no string is
+ * stored at offset 0 (which most fields take to mean "none").
+ *
+ * If the PPD's *LanguageEncoding is UTF-8 (as GeneratePPD() writes), the
+ * translation strings are converted to code page 850 before they are stored.
+ * PIN does no such conversion, so a PPD file written by GeneratePPD() must be
+ * converted to code page 850 (e.g. with iconv) before PIN can import it.
+ */
+
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+
+// Paper index records: dimension (idx, x, y); imageable (idx, x1, y1, x2, y2)
+#define DIM_RECORD_SIZE     ( 3 * sizeof( SHORT ))
+#define IMG_RECORD_SIZE     ( 5 * sizeof( SHORT ))
+
+#define INFO_MAX_SIZE       0x7FFF  // largest segment a SHORT offset can reach
+
+#define MEMBER_SIZE( t, f ) sizeof( ((t *) 0)->f )
+
+// Nearest whole number to a double
+#define ROUND( d )          ((LONG)(( d ) < 0 ? ( d ) - 0.5 : ( d ) + 0.5 ))
+
+// How a keyword's value is stored
+#define KEY_TEXT            1       // string, as written
+#define KEY_COMMAND         2       // command string (high bytes as hex)
+#define KEY_NUMBER          3       // integer
+#define KEY_HUNDREDTHS      4       // number, multiplied by 100
+#define KEY_BOOLEAN         5       // 1 if the value is pszTrue, otherwise 0
+
+
+// A statement of the PPD text
+typedef struct _PPDSTMT
+{
+    PSZ    pszKeyword;              // main keyword (without the *)
+    PSZ    pszOption;               // option keyword, or NULL
+    PSZ    pszXlate;                // translation string, or NULL
+    PSZ    pszValue;                // value (without quotes)
+} PPDSTMT, *PPPDSTMT;
+
+// A UI block (*OpenUI to *CloseUI)
+typedef struct _PPDBLOCK
+{
+    PSZ    pszName;                 // block keyword (without the *)
+    PSZ    pszXlate;                // translation string, or NULL
+    PSZ    pszDefault;              // default option, or NULL
+    USHORT usSelectType;            // UI_SELECT_* value
+    USHORT usUILocation;            // UI_ORDER_* value
+    USHORT usOrderDep;              // OrderDependency - 1
+    UCHAR  ucGroupType;             // UIGT_* value
+    ULONG  iFirst;                  // first entry (in PPDBUILD.apEntries)
+    ULONG  cEntries;                // number of entries
+} PPDBLOCK, *PPPDBLOCK;
+
+// Compilation state
+typedef struct _PPDBUILD
+{
+    DESPPD    des;                  // descriptor being built
+    PBYTE     pbInfo;               // information segment being built
+    ULONG     cbInfo;               // bytes used in it
+    BOOL      fOverflow;            // TRUE if it has outgrown SHORT offsets
+    PPPDSTMT  aStmts;               // statements, in order
+    ULONG     cStmts;
+    PPPDBLOCK aBlocks;              // UI blocks, in order
+    ULONG     cBlocks;
+    PPPDSTMT *apEntries;            // UI entry statements, block by block
+    ULONG     cEntries;
+} PPDBUILD, *PPPDBUILD;
+
+// A keyword stored in a DESPPD field
+typedef struct _PPDKEY
+{
+    PSZ    pszKeyword;              // main keyword
+    PSZ    pszOption;               // option keyword (NULL for any)
+    USHORT usType;                  // KEY_* value
+    ULONG  ulOffset;                // offset of the field within DESPPD
+    ULONG  cb;                      // size of the field
+    PSZ    pszTrue;                 // value meaning 1 (KEY_BOOLEAN)
+} PPDKEY;
+
+#define DESKEY( k, o, t, f, s )     { k, o, t, offsetof( DESPPD, f ), MEMBER_SIZE( DESPPD, f ), s }
+
+static PPDKEY aKeys[] = {
+    DESKEY("ModelName",          NULL,     KEY_TEXT,       desItems.ofsPrName,          NULL ),
+    DESKEY("PCFileName",         NULL,     KEY_TEXT,       desItems.ofsPCFileName,      NULL ),
+    DESKEY("LanguageLevel",      NULL,     KEY_NUMBER,     desItems.usLanguageLevel,    NULL ),
+    DESKEY("ColorDevice",        NULL,     KEY_BOOLEAN,    desItems.fIsColorDevice,     "True"),
+    DESKEY("FileSystem",         NULL,     KEY_BOOLEAN,    desItems.fIsFileSystem,      "True"),
+#if PSDRIVER == 1
+    DESKEY("TTRasterizer",       NULL,     KEY_BOOLEAN,    desItems.fTTSupport,         "Type42"),
+#endif
+    DESKEY("Throughput",         NULL,     KEY_NUMBER,     desItems.iPpm,               NULL ),
+    DESKEY("FreeVM",             NULL,     KEY_NUMBER,     desItems.lFreeVM,            NULL ),
+    DESKEY("Password",           NULL,     KEY_TEXT,       desItems.ofsPswrd,           NULL ),
+    DESKEY("Reset",              NULL,     KEY_COMMAND,    desItems.ofsReset,           NULL ),
+    DESKEY("ExitServer",         NULL,     KEY_COMMAND,    desItems.ofsExitserver,      NULL ),
+    DESKEY("JCLBegin",           NULL,     KEY_COMMAND,    desItems.ofsInitString,      NULL ),
+    DESKEY("JCLToPSInterpreter", NULL,     KEY_COMMAND,    desItems.ofsJCLToPS,         NULL ),
+    DESKEY("JCLEnd",             NULL,     KEY_COMMAND,    desItems.ofsTermString,      NULL ),
+    DESKEY("ScreenAngle",        NULL,     KEY_HUNDREDTHS, desItems.iScreenAngle,       NULL ),
+    DESKEY("ScreenFreq",         NULL,     KEY_HUNDREDTHS, desItems.lScrFreq,           NULL ),
+    DESKEY("Transfer", "Normalized",       KEY_COMMAND,    desItems.ofsTransferNor,     NULL ),
+    DESKEY("Transfer", "Normalized.Inverse", KEY_COMMAND,  desItems.ofsTransferInv,     NULL ),
+    DESKEY("VariablePaperSize",  NULL,     KEY_BOOLEAN,    desPage.fIsVariablePaper,    "True"),
+    DESKEY("CustomPageSize",     "True",   KEY_COMMAND,    desPage.ofsCustomPageSize,   NULL ),
+    DESKEY("DefaultOutputOrder", NULL,     KEY_BOOLEAN,    desOutbins.fIsDefoutorder,   "Reverse"),
+    DESKEY("OutputOrder",        "Normal", KEY_COMMAND,    desOutbins.ofsOrdernormal,   NULL ),
+    DESKEY("OutputOrder",        "Reverse", KEY_COMMAND,   desOutbins.ofsOrderreverse,  NULL ),
+    DESKEY("DefaultFont",        NULL,     KEY_TEXT,       desFonts.ofsDeffont,         NULL ),
+    { NULL, NULL, 0, 0, 0, NULL }
+};
+
+// A name for a UI_ORDER_* or UI_SELECT_* value
+typedef struct _PPDNAME
+{
+    PSZ    pszName;
+    USHORT usValue;
+} PPDNAME;
+
+static PPDNAME aSections[] = {
+    { "AnySetup",      UI_ORDER_ANYSETUP },
+    { "JCLSetup",      UI_ORDER_JCLSETUP },
+    { "PageSetup",     UI_ORDER_PAGESETUP },
+    { "DocumentSetup", UI_ORDER_DOCSETUP },
+    { "Prolog",        UI_ORDER_PROLOGSETUP },
+    { "ExitServer",    UI_ORDER_EXITSERVER },
+    { NULL,            UI_ORDER_ANYSETUP }
+};
+
+static PPDNAME aSelectTypes[] = {
+    { "PickOne",       UI_SELECT_PICKONE },
+    { "PickMany",      UI_SELECT_PICKMANY },
+    { "Boolean",       UI_SELECT_BOOLEAN },
+    { NULL,            UI_SELECT_PICKONE }
+};
+
+
+/* ------------------------------------------------------------------------- *
+ * ParseStatements                                                           *
+ *                                                                           *
+ * Split the PPD text (a private, writable copy) into statements, ending     *
+ * each part of a statement with a null in place.  Lines which do not start  *
+ * with a keyword, comments (*%) and statements without a colon are skipped. *
+ * ------------------------------------------------------------------------- */
+static void ParseStatements( PPPDBUILD pb, PSZ pszText )
+{
+    PSZ      p = pszText,
+             pszEnd;
+    PPPDSTMT pStmt;
+
+    while ( *p ) {
+        if ( *p != '*' || p[ 1 ] == '%' || strchr(" \t\r\n", p[ 1 ] )) {
+            p += strcspn( p, "\n");
+            if ( *p ) p++;
+            continue;
+        }
+        pStmt = pb->aStmts + pb->cStmts;
+        memset( pStmt, 0, sizeof( PPDSTMT ));
+        pStmt->pszKeyword = ++p;
+        p += strcspn( p, " \t:\r\n");
+        if ( *p == ' ' || *p == '\t') {
+            *p++ = 0;
+            p += strspn( p, " \t");
+            if ( *p && !strchr(":\r\n", *p )) {
+                pStmt->pszOption = p;
+                p += strcspn( p, "/:\r\n");
+                if ( *p == '/') {
+                    *p++ = 0;
+                    pStmt->pszXlate = p;
+                    p += strcspn( p, ":\r\n");
+                }
+            }
+        }
+        if ( *p != ':') {
+            // No value: not a statement we can use
+            if ( *p ) *p++ = 0;
+            continue;
+        }
+        *p++ = 0;
+        p += strspn( p, " \t");
+        if ( *p == '"') {
+            pStmt->pszValue = ++p;
+            p += strcspn( p, "\"");
+            if ( *p ) *p++ = 0;
+        }
+        else {
+            pStmt->pszValue = p;
+            p += strcspn( p, "\r\n");
+            for ( pszEnd = p; pszEnd > pStmt->pszValue && strchr(" \t", pszEnd[ -1 ] ); pszEnd-- );
+            if ( *p ) p++;
+            *pszEnd = 0;
+            pb->cStmts++;
+            continue;
+        }
+        pb->cStmts++;
+        p += strcspn( p, "\n");
+        if ( *p ) p++;
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * AddBytes                                                                  *
+ *                                                                           *
+ * Append bytes to the information segment, returning their offset (or 0,    *
+ * with fOverflow set, if they do not fit).                                  *
+ * ------------------------------------------------------------------------- */
+static SHORT AddBytes( PPPDBUILD pb, PVOID pv, ULONG cb )
+{
+    ULONG ulOff = pb->cbInfo;
+
+    if ( cb > INFO_MAX_SIZE - ulOff ) {
+        pb->fOverflow = TRUE;
+        return 0;
+    }
+    memcpy( pb->pbInfo + ulOff, pv, cb );
+    pb->cbInfo += cb;
+    return (SHORT) ulOff;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * AddString                                                                 *
+ *                                                                           *
+ * Append a string to the information segment, writing bytes above 127 of a  *
+ * command string as hex.                                                    *
+ *                                                                           *
+ * RETURNS: SHORT                                                            *
+ *   Offset of the string, or 0 if it does not fit                           *
+ * ------------------------------------------------------------------------- */
+static SHORT AddString( PPPDBUILD pb, PSZ psz, BOOL fCommand )
+{
+    ULONG ulOff = pb->cbInfo;
+    CHAR  szHex[ 5 ];
+
+    for ( ; *psz && !pb->fOverflow; psz++ ) {
+        if ( fCommand && (UCHAR) *psz > 127 ) {
+            sprintf( szHex, "<%02X>", (UCHAR) *psz );
+            AddBytes( pb, szHex, 4 );
+        }
+        else AddBytes( pb, psz, 1 );
+    }
+    AddBytes( pb, "", 1 );
+    return pb->fOverflow ? 0 : (SHORT) ulOff;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * SetField                                                                  *
+ *                                                                           *
+ * Store a value in a DESPPD field of the given size.                        *
+ * ------------------------------------------------------------------------- */
+static void SetField( PPPDBUILD pb, ULONG ulOffset, ULONG cb, LONG lValue )
+{
+    PBYTE pField = (PBYTE) &(pb->des) + ulOffset;
+
+    if ( cb == sizeof( LONG )) *((PLONG) pField ) = lValue;
+    else if ( cb == sizeof( SHORT )) *((PSHORT) pField ) = (SHORT) lValue;
+    else *pField = (BYTE) lValue;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * NextWord                                                                  *
+ *                                                                           *
+ * Return the next blank-separated word of a value, ending it with a null    *
+ * in place, or NULL if there are no more.                                   *
+ * ------------------------------------------------------------------------- */
+static PSZ NextWord( PSZ *ppsz )
+{
+    PSZ psz = *ppsz + strspn( *ppsz, " \t\r\n");
+
+    if ( !*psz ) return NULL;
+    *ppsz = psz + strcspn( psz, " \t\r\n");
+    if ( **ppsz ) *(*ppsz)++ = 0;
+    return psz;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ParseNumbers                                                              *
+ *                                                                           *
+ * Read up to cMax numbers from a value, rounding each to the nearest whole  *
+ * number.  Returns the number read.                                         *
+ * ------------------------------------------------------------------------- */
+static ULONG ParseNumbers( PSZ psz, PLONG alValues, ULONG cMax )
+{
+    PSZ    pszEnd;
+    double d;
+    ULONG  c;
+
+    for ( c = 0; c < cMax; c++, psz = pszEnd ) {
+        d = strtod( psz, (char **) &pszEnd );
+        if ( pszEnd == psz ) break;
+        alValues[ c ] = ROUND( d );
+    }
+    return c;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * FindBlock / FindOption                                                    *
+ *                                                                           *
+ * Find a UI block by keyword (with or without its *), or an option within   *
+ * a block; -1 if not found.                                                 *
+ * ------------------------------------------------------------------------- */
+static LONG FindBlock( PPPDBUILD pb, PSZ pszName )
+{
+    ULONG i;
+
+    if ( *pszName == '*') pszName++;
+    for ( i = 0; i < pb->cBlocks; i++ )
+        if ( !strcmp( pb->aBlocks[ i ].pszName, pszName )) return i;
+    return -1;
+}
+
+static LONG FindOption( PPPDBUILD pb, LONG lBlock, PSZ pszOption )
+{
+    PPPDBLOCK pBlock = pb->aBlocks + lBlock;
+    ULONG     i;
+
+    for ( i = 0; i < pBlock->cEntries; i++ )
+        if ( !strcmp( pb->apEntries[ pBlock->iFirst + i ]->pszOption, pszOption )) return i;
+    return -1;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * FindName                                                                  *
+ *                                                                           *
+ * Look up the first word of a value in a table of names, returning the      *
+ * value of the table's last (unnamed) entry if it is not found.             *
+ * ------------------------------------------------------------------------- */
+static USHORT FindName( PPDNAME *pNames, PSZ psz )
+{
+    ULONG cch = psz ? strcspn( psz, " \t") : 0;
+
+    for ( ; pNames->pszName; pNames++ )
+        if ( strlen( pNames->pszName ) == cch && !strncmp( psz, pNames->pszName, cch )) break;
+    return pNames->usValue;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ReadStatements                                                            *
+ *                                                                           *
+ * Make one pass over the statements, storing the DESPPD keywords and        *
+ * collecting the UI blocks and their entries.  OrderDependency and default  *
+ * statements are applied afterwards, as they may come before or after the   *
+ * block they refer to.                                                      *
+ * ------------------------------------------------------------------------- */
+static void ReadStatements( PPPDBUILD pb )
+{
+    PPPDSTMT  pStmt;
+    PPPDBLOCK pBlock = NULL;
+    PPDKEY   *pKey;
+    BOOL      fInstallable = FALSE;
+    LONG      lValue,
+              lBlock;
+    ULONG     i;
+
+    for ( i = 0, pStmt = pb->aStmts; i < pb->cStmts; i++, pStmt++ ) {
+        if ( pBlock && pStmt->pszOption && !strcmp( pStmt->pszKeyword, pBlock->pszName )) {
+            pb->apEntries[ pb->cEntries++ ] = pStmt;
+            pBlock->cEntries++;
+            continue;
+        }
+        if ( !strcmp( pStmt->pszKeyword, "OpenUI") && pStmt->pszOption ) {
+            pBlock = pb->aBlocks + pb->cBlocks++;
+            memset( pBlock, 0, sizeof( PPDBLOCK ));
+            pBlock->pszName      = pStmt->pszOption + ( *pStmt->pszOption == '*');
+            pBlock->pszXlate     = pStmt->pszXlate;
+            pBlock->usSelectType = FindName( aSelectTypes, pStmt->pszValue );
+            pBlock->ucGroupType  = fInstallable ? UIGT_INSTALLABLEOPTION : UIGT_DEFAULTOPTION;
+            pBlock->iFirst       = pb->cEntries;
+            continue;
+        }
+        if ( !strcmp( pStmt->pszKeyword, "CloseUI")) {
+            pBlock = NULL;
+            continue;
+        }
+        if ( !strcmp( pStmt->pszKeyword, "OpenGroup")) {
+            fInstallable = !strncmp( pStmt->pszValue, "InstallableOptions", 18 ) &&
+                           strchr("/", pStmt->pszValue[ 18 ] );
+            continue;
+        }
+        if ( !strcmp( pStmt->pszKeyword, "CloseGroup")) {
+            fInstallable = FALSE;
+            continue;
+        }
+        for ( pKey = aKeys; pKey->pszKeyword; pKey++ ) {
+            if ( strcmp( pKey->pszKeyword, pStmt->pszKeyword )) continue;
+            if ( pKey->pszOption &&
+                 ( !pStmt->pszOption || strcmp( pKey->pszOption, pStmt->pszOption ))) continue;
+            switch ( pKey->usType ) {
+                case KEY_TEXT:
+                case KEY_COMMAND:
+                    lValue = AddString( pb, pStmt->pszValue, pKey->usType == KEY_COMMAND );
+                    break;
+                case KEY_NUMBER:
+                    // FreeVM may be written unsigned (see GeneratePPD)
+                    lValue = (LONG) strtoul( pStmt->pszValue, NULL, 10 );
+                    break;
+                case KEY_HUNDREDTHS:
+                    lValue = ROUND( strtod( pStmt->pszValue, NULL ) * 100 );
+                    break;
+                default:
+                    lValue = !strcmp( pStmt->pszValue, pKey->pszTrue );
+                    break;
+            }
+            SetField( pb, pKey->ulOffset, pKey->cb, lValue );
+            break;
+        }
+    }
+
+    // Order dependencies ("<order> <section> *<keyword>") and defaults
+    for ( i = 0, pStmt = pb->aStmts; i < pb->cStmts; i++, pStmt++ ) {
+        if ( !strcmp( pStmt->pszKeyword, "OrderDependency")) {
+            PSZ psz = pStmt->pszValue,
+                pszOrder, pszSection, pszBlock;
+
+            pszOrder   = NextWord( &psz );
+            pszSection = NextWord( &psz );
+            pszBlock   = NextWord( &psz );
+            if ( !pszBlock || ( lBlock = FindBlock( pb, pszBlock )) < 0 ) continue;
+            lValue = 0;
+            ParseNumbers( pszOrder, &lValue, 1 );
+            pb->aBlocks[ lBlock ].usOrderDep   = (USHORT)( lValue - 1 );
+            pb->aBlocks[ lBlock ].usUILocation = FindName( aSections, pszSection );
+        }
+        else if ( !strncmp( pStmt->pszKeyword, "Default", 7 ) &&
+                  ( lBlock = FindBlock( pb, pStmt->pszKeyword + 7 )) >= 0 &&
+                  !pb->aBlocks[ lBlock ].pszDefault )
+        {
+            pb->aBlocks[ lBlock ].pszDefault = pStmt->pszValue;
+            if ( !strcmp( pb->aBlocks[ lBlock ].pszName, "Resolution"))
+                pb->des.desItems.iResDpi = (SHORT) atoi( pStmt->pszValue );
+        }
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * BuildPaperTables                                                          *
+ *                                                                           *
+ * Build the ImageableArea and PaperDimension records, which refer to the    *
+ * PageSize entries by number, the custom page size limits and the font      *
+ * list.                                                                     *
+ * ------------------------------------------------------------------------- */
+static void BuildPaperTables( PPPDBUILD pb )
+{
+    PPPDSTMT pStmt;
+    SHORT    asRecord[ 5 ],
+             sOff;
+    PSZ      psz;
+    LONG     alValues[ 4 ],
+             lPaper,
+             lEntry;
+    ULONG    i;
+
+    lPaper = FindBlock( pb, "PageSize");
+    for ( i = 0, pStmt = pb->aStmts; i < pb->cStmts; i++, pStmt++ ) {
+        if ( !pStmt->pszOption ) continue;
+        if ( !strcmp( pStmt->pszKeyword, "ImageableArea") || !strcmp( pStmt->pszKeyword, "PaperDimension")) {
+            BOOL fImageable = ( pStmt->pszKeyword[ 0 ] == 'I');
+
+            if ( lPaper < 0 || ( lEntry = FindOption( pb, lPaper, pStmt->pszOption )) < 0 ||
+                 ParseNumbers( pStmt->pszValue, alValues, 4 ) < ( fImageable ? 4 : 2 ))
+                continue;
+            asRecord[ 0 ] = (SHORT) lEntry;
+            asRecord[ 1 ] = (SHORT) alValues[ 0 ];
+            asRecord[ 2 ] = (SHORT) alValues[ 1 ];
+            if ( fImageable ) {
+                asRecord[ 3 ] = (SHORT) alValues[ 2 ];
+                asRecord[ 4 ] = (SHORT) alValues[ 3 ];
+                sOff = AddBytes( pb, asRecord, IMG_RECORD_SIZE );
+                AddString( pb, ( pStmt->pszXlate && strcmp( pStmt->pszXlate, pStmt->pszOption )) ?
+                               pStmt->pszXlate : "", FALSE );
+                if ( !pb->des.desPage.iImgpgpairs++ ) pb->des.desPage.ofsImgblPgsz = sOff;
+            }
+            else {
+                sOff = AddBytes( pb, asRecord, DIM_RECORD_SIZE );
+                if ( !pb->des.desPage.iDmpgpairs++ ) pb->des.desPage.ofsDimxyPgsz = sOff;
+            }
+        }
+        else if ( !strcmp( pStmt->pszKeyword, "ParamCustomPageSize")) {
+            // "<order> <type> <minimum> <maximum>"
+            psz = pStmt->pszValue;
+            NextWord( &psz );
+            NextWord( &psz );
+            if ( ParseNumbers( psz, alValues, 2 ) < 2 ) continue;
+            if ( !strcmp( pStmt->pszOption, "Width")) {
+                pb->des.desPage.iCustomPageSizeMinWidth = (SHORT) alValues[ 0 ];
+                pb->des.desPage.iCustomPageSizeMaxWidth = (SHORT) alValues[ 1 ];
+            }
+            else if ( !strcmp( pStmt->pszOption, "Height")) {
+                pb->des.desPage.iCustomPageSizeMinHeight = (SHORT) alValues[ 0 ];
+                pb->des.desPage.iCustomPageSizeMaxHeight = (SHORT) alValues[ 1 ];
+            }
+        }
+    }
+
+    // The font list is a run of consecutive names
+    for ( i = 0, pStmt = pb->aStmts; i < pb->cStmts; i++, pStmt++ ) {
+        if ( !pStmt->pszOption || strcmp( pStmt->pszKeyword, "Font")) continue;
+        sOff = AddString( pb, pStmt->pszOption, FALSE );
+        if ( !pb->des.desFonts.iFonts++ ) pb->des.desFonts.ofsFontnames = sOff;
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ConstraintMask                                                            *
+ *                                                                           *
+ * Return the UI_SEL mask for the option of a UIConstraints statement: the   *
+ * option itself or, if none is given, every option except None and False.   *
+ * ------------------------------------------------------------------------- */
+static UI_SEL ConstraintMask( PPPDBUILD pb, LONG lBlock, PSZ pszOption )
+{
+    PPPDBLOCK pBlock = pb->aBlocks + lBlock;
+    UI_SEL    sel = 0;
+    LONG      lEntry;
+    ULONG     i;
+    PSZ       psz;
+
+    if ( pszOption ) {
+        lEntry = FindOption( pb, lBlock, pszOption );
+        return ( lEntry >= 0 && lEntry < 32 ) ? 1UL << lEntry : 0;
+    }
+    for ( i = 0; i < pBlock->cEntries && i < 32; i++ ) {
+        psz = pb->apEntries[ pBlock->iFirst + i ]->pszOption;
+        if ( strcmp( psz, "None") && strcmp( psz, "False")) sel |= 1UL << i;
+    }
+    return sel;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakCompilePPD                                                             *
+ *                                                                           *
+ * Compile the text of a PPD file into a device segment.                     *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID  pHeap     : Heap for the segment and working memory (or NULL)    *
+ *   PCHAR  pchText   : PPD text (need not be null-terminated)               *
+ *   ULONG  cbText    : Length of the text                                   *
+ *   PBYTE *ppSegment : Receives the segment (free with PakFree)             *
+ *   PULONG pcbSegment: Receives its size                                    *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success; ERROR_BUFFER_OVERFLOW if the information segment or UI    *
+ *   list would be too large; or ERROR_NOT_ENOUGH_MEMORY                     *
+ * ------------------------------------------------------------------------- */
+ULONG PakCompilePPD( PVOID pHeap, PCHAR pchText, ULONG cbText, PBYTE *ppSegment,
+                     PULONG pcbSegment )
+{
+    PPDBUILD   build;
+    PPPDBLOCK  pBlock;
+    PPPDSTMT   pStmt;
+    PUI_BLOCK  puib;
+    PUIC_BLOCK puicb;
+    PBYTE      pbSeg;
+    PSZ        pszText = NULL,
+               psz, pszK1, pszO1, pszK2, pszO2;
+    LONG       lBlock1, lBlock2;
+    ULONG      cbUI = 0,
+               cUICs = 0,
+               cMax, i, j;
+    APIRET     rc = ERROR_NOT_ENOUGH_MEMORY;
+
+    *ppSegment  = NULL;
+    *pcbSegment = 0;
+    memset( &build, 0, sizeof( build ));
+
+    // Every statement starts with a *, which bounds the number of everything
+    for ( i = 0, cMax = 1; i < cbText; i++ ) if ( pchText[ i ] == '*') cMax++;
+    pszText         = (PSZ) PakAlloc( pHeap, cbText + 1 );
+    build.pbInfo    = (PBYTE) PakAlloc( pHeap, INFO_MAX_SIZE + 1 );
+    build.aStmts    = (PPPDSTMT) PakAlloc( pHeap, cMax * sizeof( PPDSTMT ));
+    build.aBlocks   = (PPPDBLOCK) PakAlloc( pHeap, cMax * sizeof( PPDBLOCK ));
+    build.apEntries = (PPPDSTMT *) PakAlloc( pHeap, cMax * sizeof( PPPDSTMT ));
+    if ( !pszText || !build.pbInfo || !build.aStmts || !build.aBlocks || !build.apEntries )
+        goto cleanup;
+    memcpy( pszText, pchText, cbText );
+    pszText[ cbText ] = 0;
+
+    // Fields for which offset 0 is a string use -1 for "none"
+    build.des.desItems.ofsInitString = -1;
+    build.des.desItems.ofsJCLToPS    = -1;
+    build.des.desItems.ofsTermString = -1;
+    build.des.desItems.ofsPCFileName = -1;
+    AddBytes( &build, "", 1 );
+
+    ParseStatements( &build, pszText );
+
+    // Translation strings are stored in code page 850, as the driver's PPD
+    // compiler would store them from a PPD file written in it
+    for ( i = 0, pStmt = build.aStmts; i < build.cStmts; i++, pStmt++ ) {
+        if ( strcmp( pStmt->pszKeyword, "LanguageEncoding") == 0 ) {
+            if ( stricmp( pStmt->pszValue, "UTF-8") == 0 )
+                for ( j = 0; j < build.cStmts; j++ )
+                    if ( build.aStmts[ j ].pszXlate ) Utf8ToCp850( build.aStmts[ j ].pszXlate );
+            break;
+        }
+    }
+    ReadStatements( &build );
+
+    // UI constraints: "*<keyword> [<option>] *<keyword> [<option>]"
+    puicb = (PUIC_BLOCK) PakAlloc( pHeap, cMax * sizeof( UIC_BLOCK ));
+    if ( !puicb ) goto cleanup;
+    build.des.stUICList.puicBlockList = puicb;
+    for ( i = 0, pStmt = build.aStmts; i < build.cStmts; i++, pStmt++ ) {
+        if ( strcmp( pStmt->pszKeyword, "UIConstraints")) continue;
+        psz   = pStmt->pszValue;
+        pszK1 = NextWord( &psz );
+        pszO1 = NextWord( &psz );
+        if ( pszO1 && *pszO1 == '*') {
+            pszK2 = pszO1;
+            pszO1 = NULL;
+        }
+        else pszK2 = NextWord( &psz );
+        pszO2 = NextWord( &psz );
+        if ( !pszK1 || !pszK2 || *pszK1 != '*' || *pszK2 != '*' ||
+             ( lBlock1 = FindBlock( &build, pszK1 )) < 0 || ( lBlock2 = FindBlock( &build, pszK2 )) < 0 )
+            continue;
+        puicb[ cUICs ].uicEntry1.ofsUIBlock = (USHORT) lBlock1;
+        puicb[ cUICs ].uicEntry1.bOption    = ConstraintMask( &build, lBlock1, pszO1 );
+        puicb[ cUICs ].uicEntry2.ofsUIBlock = (USHORT) lBlock2;
+        puicb[ cUICs ].uicEntry2.bOption    = ConstraintMask( &build, lBlock2, pszO2 );
+        if ( puicb[ cUICs ].uicEntry1.bOption && puicb[ cUICs ].uicEntry2.bOption ) cUICs++;
+    }
+
+    // UI blocks, with their strings
+    for ( i = 0; i < build.cBlocks; i++ )
+        cbUI += UI_BLOCK_FIXED + build.aBlocks[ i ].cEntries * sizeof( UI_ENTRY );
+    if ( cbUI > 0xFFFF ) {
+        rc = ERROR_BUFFER_OVERFLOW;
+        goto cleanup;
+    }
+    build.des.stUIList.pBlockList = (PUI_BLOCK) PakAlloc( pHeap, cbUI + 1 );
+    if ( !build.des.stUIList.pBlockList ) goto cleanup;
+    puib = build.des.stUIList.pBlockList;
+    for ( i = 0, pBlock = build.aBlocks; i < build.cBlocks; i++, pBlock++ ) {
+        memset( puib, 0, UI_BLOCK_FIXED );
+        puib->ofsUIName = AddString( &build, pBlock->pszName, FALSE );
+        if ( pBlock->pszXlate && strcmp( pBlock->pszXlate, pBlock->pszName ))
+            puib->ofsUITransString = AddString( &build, pBlock->pszXlate, FALSE );
+        puib->usOrderDep     = pBlock->usOrderDep;
+        puib->usUILocation   = pBlock->usUILocation;
+        puib->usSelectType   = pBlock->usSelectType;
+        puib->ucGroupType    = pBlock->ucGroupType;
+        puib->usNumOfEntries = (USHORT) pBlock->cEntries;
+        if ( pBlock->pszDefault && FindOption( &build, i, pBlock->pszDefault ) >= 0 )
+            puib->usDefaultEntry = (USHORT) FindOption( &build, i, pBlock->pszDefault );
+        for ( j = 0; j < pBlock->cEntries; j++ ) {
+            pStmt = build.apEntries[ pBlock->iFirst + j ];
+            puib->uiEntry[ j ].ofsOption = AddString( &build, pStmt->pszOption, FALSE );
+            puib->uiEntry[ j ].ofsTransString =
+                ( pStmt->pszXlate && strcmp( pStmt->pszXlate, pStmt->pszOption )) ?
+                AddString( &build, pStmt->pszXlate, FALSE ) : 0;
+            puib->uiEntry[ j ].ofsValue = *pStmt->pszValue ? AddString( &build, pStmt->pszValue, TRUE ) : 0;
+        }
+        puib = (PUI_BLOCK)( (PBYTE) puib + UI_BLOCK_FIXED + pBlock->cEntries * sizeof( UI_ENTRY ));
+    }
+    BuildPaperTables( &build );
+    if ( build.fOverflow ) {
+        rc = ERROR_BUFFER_OVERFLOW;
+        goto cleanup;
+    }
+
+    // Descriptor segment, then information segment
+    build.des.desItems.iSizeBuffer    = (SHORT) build.cbInfo;
+    build.des.stUIList.usNumOfBlocks  = (USHORT) build.cBlocks;
+    build.des.stUIList.usBlockListSize = (USHORT) cbUI;
+    build.des.stUICList.usNumOfUICs   = (USHORT) cUICs;
+    *pcbSegment = sizeof( DESPPD ) + cbUI + cUICs * sizeof( UIC_BLOCK ) + build.cbInfo;
+    if (( pbSeg = (PBYTE) PakAlloc( pHeap, *pcbSegment )) == NULL ) {
+        *pcbSegment = 0;
+        goto cleanup;
+    }
+    memcpy( pbSeg, &build.des, sizeof( DESPPD ));
+    ((PDESPPD) pbSeg )->stUIList.pBlockList     = NULL;
+    ((PDESPPD) pbSeg )->stUICList.puicBlockList = NULL;
+    memcpy( pbSeg + sizeof( DESPPD ), build.des.stUIList.pBlockList, cbUI );
+    memcpy( pbSeg + sizeof( DESPPD ) + cbUI, puicb, cUICs * sizeof( UIC_BLOCK ));
+    memcpy( pbSeg + *pcbSegment - build.cbInfo, build.pbInfo, build.cbInfo );
+    *ppSegment = pbSeg;
+    rc = NO_ERROR;
+
+cleanup:
+    PakFree( pHeap, build.des.stUIList.pBlockList );
+    PakFree( pHeap, build.des.stUICList.puicBlockList );
+    PakFree( pHeap, build.apEntries );
+    PakFree( pHeap, build.aBlocks );
+    PakFree( pHeap, build.aStmts );
+    PakFree( pHeap, build.pbInfo );
+    PakFree( pHeap, pszText );
+    return rc;
+}
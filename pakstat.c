@@ -0,0 +1,164 @@
+/*
+ * pakstat.c
+ *
+ * PAKTOOL library: size statistics of a device segment.  PakDeviceStats()
+ * measures one segment - the sizes of its parts, the number of UI blocks,
+ * options and constraints, the bytes taken by its PostScript commands before
+ * and after decompression, and the sizes of its font and paper tables - so
+ * that a program can gather the distributions over a whole PAK file without
+ * formatting each printer.  The command strings are found through the field
+ * tables (see PakFieldTable()), and counted once for each field which refers
+ * to them.
+ */
+
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+
+static PSZ apszStatNames[ PAKSTAT_COUNT ] = {
+    "Segment bytes",
+    "Descriptor bytes",
+    "Information bytes",
+    "UI blocks",
+    "UI options",
+    "UI constraints",
+    "Commands (packed)",
+    "Commands (expanded)",
+    "Resident fonts",
+    "Paper sizes",
+    "Form commands"
+};
+
+
+/* ------------------------------------------------------------------------- *
+ * CountCommands                                                             *
+ *                                                                           *
+ * Add the packed and expanded sizes of the command strings referred to by   *
+ * one structure to the statistics.                                          *
+ * ------------------------------------------------------------------------- */
+static void CountCommands( PPAKFIELD pField, PVOID pStruct, PBYTE pInfoSeg, ULONG cbInfo,
+                           PPAKDICT pDict, PULONG aulStats )
+{
+    LONG lOff,
+         lLen;
+
+    for ( ; pField->pszName; pField++ ) {
+        if ( !( pField->fs & PF_COMMAND )) continue;
+        lOff = PakFieldValue( pField, pStruct );
+        if (( lOff <= 0 ) || ( (ULONG) lOff >= cbInfo ) ||
+            !memchr( pInfoSeg + lOff, 0, cbInfo - lOff ))
+            continue;
+        if (( lLen = DecompressedLength( pDict, (PSZ)( pInfoSeg + lOff ))) < 0 ) continue;
+        aulStats[ PAKSTAT_PACKED ]   += strlen( (PSZ)( pInfoSeg + lOff ));
+        aulStats[ PAKSTAT_EXPANDED ] += lLen;
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakDeviceStats                                                            *
+ *                                                                           *
+ * Measure one device segment.  The UI list is walked only as far as it lies *
+ * within the segment, so a damaged segment gives smaller figures rather     *
+ * than undefined ones; check the segment with PakCheckDevice() first if     *
+ * the figures are to be relied on.                                          *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAK_DEV_DIRENTRY pEntry  : Directory entry of the segment              *
+ *   PBYTE             pBuf    : The segment                                 *
+ *   PPAKARENA         pArena  : Arena giving the dictionary for commands    *
+ *                               and forms (or NULL)                         *
+ *   PULONG            aulStats: Receives PAKSTAT_COUNT figures, indexed by  *
+ *                               PAKSTAT_*                                   *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_INVALID_DATA if the segment is too small to hold a  *
+ *   DESPPD, or ERROR_NOT_ENOUGH_MEMORY                                      *
+ * ------------------------------------------------------------------------- */
+ULONG PakDeviceStats( PPAK_DEV_DIRENTRY pEntry, PBYTE pBuf, PPAKARENA pArena, PULONG aulStats )
+{
+    DESPPD     desPPD;
+    PUI_BLOCK  puib;
+    PUIC_BLOCK puicb;
+    PPAKPAPERS pPapers;
+    PPAKDICT   pDict = pArena ? pArena->pDict : NULL;
+    PBYTE      pb,
+               pInfoSeg;
+    ULONG      cbList,
+               cbUICs,
+               cbInfo,
+               cb,
+               i, j;
+    APIRET     rc;
+
+    memset( aulStats, 0, PAKSTAT_COUNT * sizeof( ULONG ));
+    if ( pEntry->ulSize < sizeof( DESPPD )) return ERROR_INVALID_DATA;
+
+    // Locate the lists and the information segment, within the segment
+    memcpy( &desPPD, pBuf, sizeof( DESPPD ));
+    cb     = pEntry->ulSize - sizeof( DESPPD );
+    cbList = ( desPPD.stUIList.usBlockListSize <= cb ) ? desPPD.stUIList.usBlockListSize : cb;
+    cb    -= cbList;
+    cbUICs = desPPD.stUICList.usNumOfUICs * sizeof( UIC_BLOCK );
+    if ( cbUICs > cb ) cbUICs = cb - cb % sizeof( UIC_BLOCK );
+    cbInfo = cb - cbUICs;
+    if (( desPPD.desItems.iSizeBuffer >= 0 ) && ( (ULONG) desPPD.desItems.iSizeBuffer < cbInfo ))
+        cbInfo = desPPD.desItems.iSizeBuffer;
+    pInfoSeg = pBuf + sizeof( DESPPD ) + cbList + cbUICs;
+
+    aulStats[ PAKSTAT_SEGMENT ]    = pEntry->ulSize;
+    aulStats[ PAKSTAT_DESCRIPTOR ] = sizeof( DESPPD ) + cbList + cbUICs;
+    aulStats[ PAKSTAT_INFO ]       = cbInfo;
+    aulStats[ PAKSTAT_UICS ]       = cbUICs / sizeof( UIC_BLOCK );
+    aulStats[ PAKSTAT_FONTS ]      = ( desPPD.desFonts.iFonts > 0 ) ? desPPD.desFonts.iFonts : 0;
+    CountCommands( PakFieldTable( PAKFT_DESPPD ), &desPPD, pInfoSeg, cbInfo, pDict, aulStats );
+
+    pb = pBuf + sizeof( DESPPD );
+    for ( i = 0; i < desPPD.stUIList.usNumOfBlocks; i++ ) {
+        puib = (PUI_BLOCK) pb;
+        if (( cbList < UI_BLOCK_FIXED ) ||
+            (( cb = UI_BLOCK_FIXED + puib->usNumOfEntries * sizeof( UI_ENTRY )) > cbList ))
+            break;
+        aulStats[ PAKSTAT_BLOCKS ]++;
+        aulStats[ PAKSTAT_OPTIONS ] += puib->usNumOfEntries;
+        CountCommands( PakFieldTable( PAKFT_UI_BLOCK ), puib, pInfoSeg, cbInfo, pDict, aulStats );
+        for ( j = 0; j < puib->usNumOfEntries; j++ )
+            CountCommands( PakFieldTable( PAKFT_UI_ENTRY ), puib->uiEntry + j, pInfoSeg, cbInfo,
+                           pDict, aulStats );
+        pb     += cb;
+        cbList -= cb;
+    }
+    puicb = (PUIC_BLOCK)( pBuf + sizeof( DESPPD ) + desPPD.stUIList.usBlockListSize );
+    for ( i = 0; i < cbUICs / sizeof( UIC_BLOCK ); i++, puicb++ )
+        CountCommands( PakFieldTable( PAKFT_UIC_BLOCK ), puicb, pInfoSeg, cbInfo, pDict, aulStats );
+
+    rc = PakPaperBuild( NULL, pArena, pBuf, pEntry->ulSize, &pPapers );
+    if ( rc == NO_ERROR ) {
+        aulStats[ PAKSTAT_PAPERS ] = pPapers->cPapers;
+        aulStats[ PAKSTAT_FORMS ]  = pPapers->cForms;
+        PakPaperFree( NULL, pPapers );
+    }
+    return ( rc == ERROR_NOT_ENOUGH_MEMORY ) ? rc : NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakStatName                                                               *
+ *                                                                           *
+ * Get the description of one of the figures given by PakDeviceStats().      *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   ULONG ulStat: PAKSTAT_* index                                           *
+ *                                                                           *
+ * RETURNS: PSZ                                                              *
+ *   The description, or NULL if ulStat is not less than PAKSTAT_COUNT       *
+ * ------------------------------------------------------------------------- */
+PSZ PakStatName( ULONG ulStat )
+{
+    return ( ulStat < PAKSTAT_COUNT ) ? apszStatNames[ ulStat ] : NULL;
+}
@@ -1,4 +1,4 @@
-/* PAKT.CMD  Build PAKTOOL executable */
+/* PAKT.CMD  Build PAKTOOL executable and library */
 ARG dr_type
 
 SELECT
@@ -25,6 +25,17 @@ SELECT
     END
 END
 
-'icc /Sp1 /Ss /DPSDRIVER='level' /Fe'exename' paktool.c'
+libname = 'paklib'level
+
+/* Static library and DLL versions of the PAKTOOL library (see paklib.h) */
+'icc /C /Sp1 /Ss /Gm+ /DPSDRIVER='level' paklib.c pakv2.c pakcheck.c pakuic.c pakjob.c pakpaper.c pakfidx.c pakfont.c pakcol.c pakdup.c pakinfo.c pakdump.c pakppd.c pakcmp.c pakfld.c paklazy.c pakstat.c pakcp.c pakdelta.c pakname.c'
+IF rc <> 0 THEN RETURN rc
+'@del 'libname'.lib 2>nul'
+'ilib /NOE /NOLOGO 'libname'.lib +paklib.obj +pakv2.obj +pakcheck.obj +pakuic.obj +pakjob.obj +pakpaper.obj +pakfidx.obj +pakfont.obj +pakcol.obj +pakdup.obj +pakinfo.obj +pakdump.obj +pakppd.obj +pakcmp.obj +pakfld.obj +paklazy.obj +pakstat.obj +pakcp.obj +pakdelta.obj +pakname.obj;'
+IF rc <> 0 THEN RETURN rc
+'icc /Sp1 /Ss /Gm+ /Ge- /DPSDRIVER='level' /Fe'libname'.dll paklib.c pakv2.c pakcheck.c pakuic.c pakjob.c pakpaper.c pakfidx.c pakfont.c pakcol.c pakdup.c pakinfo.c pakdump.c pakppd.c pakcmp.c pakfld.c paklazy.c pakstat.c pakcp.c pakdelta.c pakname.c paklib.def'
+IF rc <> 0 THEN RETURN rc
+
+'icc /Sp1 /Ss /Gm+ /DPSDRIVER='level' /Fe'exename' paktool.c pt_serve.c pt_dict.c pt_check.c pt_uic.c pt_job.c pt_paper.c pt_font.c pt_fpak.c pt_sel.c pt_dup.c pt_info.c pt_vrfy.c pt_fqry.c pt_stat.c pt_pipe.c pt_cache.c pt_diff.c 'libname'.lib'
 
 RETURN rc
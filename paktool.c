@@ -2,13 +2,75 @@
  * Syntax: ppaktool <pakfile> [<action>]
  *
  * Possible values for <action>:
- *    l              List printers defined in <pakfile>
+ *    l              List printers (or fonts) defined in <pakfile>
  *    v "<printer>"  View data for <printer>, formatted by structure
  *    r "<printer>"  View data for <printer>, formatted for readability
- *    p "<printer>"  Generate a PIN-compatible PPD file for <printer> (to stdout)
+ *    p "<printer>"  Generate a PPD file for <printer> (to stdout), with UTF-8
+ *                   translation strings; convert it to code page 850 before
+ *                   importing it with PIN (see paktool.txt)
  *    d "<printer>"  Dump the raw (binary) data for <printer> (to stdout)
  *    x "<printer>"  Dump the hexadecimal (binary) data for <printer>
  *    b "<printer>"  Dump the (binary) data for <printer> in prettified hex/raw comparison
+ *    json "<printer>"
+ *                   View data for <printer> as a JSON object, one member per field
+ *    field "<printer>"|* <field> ...
+ *                   Show the given fields of <printer>, reading only those
+ *    annotate "<printer>" [<region>]
+ *                   Dump (part of) the data for <printer> with field names
+ *    serve [<pipe> [<pakfile> ...]]
+ *                   Serve queries on <pakfile> (and others) over a named pipe
+ *    query <request>
+ *                   Send <request> to the server listening on pipe <pakfile>
+ *    stream [d|x]   List (or dump) all printers in <pakfile> in a single pass;
+ *                   <pakfile> may be "-" to read PAK file(s) from STDIN
+ *    convert <outfile>
+ *                   Convert <pakfile> from V1 to V2 format, or vice versa
+ *    dict <header>  Generate a keyword dictionary from the PPD files <pakfile>
+ *    check          Validate the structure of every printer in <pakfile>
+ *    stats          Show the distributions of sizes and counts over all printers
+ *    constrain "<printer>" [<keyword>=<option> ...]
+ *                   List the UI constraints of <printer>, or check a selection
+ *    job "<printer>" [<keyword>=<option> ...]
+ *                   Write the setup code for the default (or given) options
+ *    paper "<printer>"|* [<width> <height> [<tolerance>] [fixed]]
+ *                   List the paper sizes of <printer>, or find the nearest one
+ *    fonts [has <font> ... | common <printer> ... | any <printer> ...]
+ *                   List the resident fonts of all printers, or query them
+ *    select ["<expression>" [<pakfile> ...]]
+ *                   List the printers in <pakfile> (and others) matching an
+ *                   expression such as "color && level >= 3"
+ *    similar [<percent>]
+ *                   List the clusters of near-duplicate printers in <pakfile>
+ *    slack ["<printer>"]
+ *                   Show how much of each printer's information segment is used
+ *    compact <outfile>
+ *                   Write a copy of <pakfile> without unused information bytes
+ *    diff <newfile> [<patch>]
+ *                   List the printers which differ in <newfile>, and write a
+ *                   patch which turns <pakfile> into <newfile>
+ *    apply <patch> <outfile>
+ *                   Rebuild the newer PAK file from <pakfile> and a patch
+ *    verify ["<printer>"]
+ *                   Check that each printer survives conversion to PPD and back
+ *    extract <dir> [<font> ...]
+ *                   Write the data of each font in a font PAK to <dir>
+ *
+ * The p, r, v, json, d, x and b actions take "*" for all printers, which are
+ * formatted in parallel and written in directory order.
+ *
+ * A printer may be named by the start of its name, or by any part of it, in
+ * either case and with spaces, hyphens and underscores alike; the actions
+ * above, and field, paper, slack and verify, also take a pattern such as
+ * "hp*4?00*", or a part name matching several printers, to show them all.
+ * If no printer matches, the nearest names are suggested.
+ *
+ * The l, d, x and b actions also accept a font PAK file, taking the name (or
+ * full name) of a font instead of a printer.
+ *
+ * If the environment variable PAKTOOL_DICT names a dictionary header, it is
+ * used instead of the built-in keyword table to decompress strings.  If
+ * PAKTOOL_CACHE names a directory, the p, r and json output of single
+ * printers is cached there (see pt_cache.c).
  */
 
 #define INCL_DOSFILEMGR
@@ -16,18 +78,15 @@
 #include <os2.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdarg.h>
+#include <ctype.h>
 #include <string.h>
 
 #include "pt_struct.h"
 #include "package.h"
-#include "ppdtable.h"
-
-// Overrides signature definition in package.h
-#if PSDRIVER == 1
-#define PAKSIGNATURE_DEVPACK_V1   "IBM DDPAK V1.2"  // ALT_CUPS
-#else
-#define PAKSIGNATURE_DEVPACK_V1   "IBM DDPAK V1.0"  // ALT_CUPS
-#endif
+#include "paklib.h"
+#include "pakv2.h"
+#include "paktool.h"
 
 // These correspond to the program execution modes (according to cmd-line)
 #define ACTION_LIST  1      // list printers
@@ -37,43 +96,89 @@
 #define ACTION_BOTH  5      // dump both hex & raw data
 #define ACTION_READ  6      // show readable data
 #define ACTION_PPD   7      // generate PPD file
-
-// Values for the data-format flag passed to ShowPrinterData()
-#define DEV_FMT_DATA 1      // formatted (structured) data
-#define DEV_RAW_DATA 2      // raw data dump
-#define DEV_HEX_DATA 3      // hex data dump
-#define DEV_BIN_DATA 4      // combined binary (raw/hex) data dump
-#define DEV_TXT_DATA 5      // readable text
-#define DEV_PPD_DATA 6      // PPD output
-
-// Convert an offset into the data buffer into a pointer to string.  Note:
-// i is the offset value; p is the pointer to the information segment buffer.
-#define OFFSET_TO_PSZ(i, p)    ((i > 0)? (PSZ)(p+i): "(none)")
-
-// Some useful macros for formatted output of offset values
-#define OFFSET_FORMAT( i )     ((i <= 0)? "  %7d": "%#9x")
-
-// Replace certain undisplayable raw-byte values
-#define DISPLAYABLE_CHAR( c )  ( c == 0 ? ' ' : ( c < 32 ? 127: c ))
+#define ACTION_SERVE 8      // run as query server
+#define ACTION_QUERY 9      // send a request to the query server
+#define ACTION_STREAM 10    // list or dump PAK file(s) in a single pass
+#define ACTION_CONVERT 11   // convert between V1 and V2 PAK formats
+#define ACTION_DICT  12     // generate a keyword dictionary
+#define ACTION_CHECK 13     // validate all printers
+#define ACTION_CONSTRAIN 14 // list or check UI constraints
+#define ACTION_JOB   15     // render job setup code
+#define ACTION_PAPER 16     // list or match paper sizes
+#define ACTION_FONTS 17     // query resident fonts across printers
+#define ACTION_EXTRACT 18   // extract fonts from a font PAK
+#define ACTION_SELECT 19    // select printers by their fields
+#define ACTION_SIMILAR 20   // cluster near-duplicate printers
+#define ACTION_ANNOTATE 21  // annotated dump of part of a printer
+#define ACTION_SLACK 22     // show unused information segment bytes
+#define ACTION_COMPACT 23   // remove unused information segment bytes
+#define ACTION_VERIFY 24    // verify the PPD round trip
+#define ACTION_JSON  25     // show fields as JSON
+#define ACTION_FIELD 26     // query fields, reading only what they need
+#define ACTION_STATS 27     // size statistics of all printers
+#define ACTION_DIFF  28     // list differences and write a patch
+#define ACTION_APPLY 29     // apply a patch
+
+// Maximum length of a request line assembled for the query action
+#define QUERY_MAX_REQUEST 512
+
+
+// Actions which are selected by full name rather than by initial letter
+typedef struct _ACTIONNAME
+{
+    PSZ    pszName;
+    USHORT usAction;
+} ACTIONNAME;
+
+static ACTIONNAME aActionNames[] = {
+    { "SERVE", ACTION_SERVE },
+    { "QUERY", ACTION_QUERY },
+    { "STREAM", ACTION_STREAM },
+    { "CONVERT", ACTION_CONVERT },
+    { "DICT",  ACTION_DICT },
+    { "CHECK", ACTION_CHECK },
+    { "CONSTRAIN", ACTION_CONSTRAIN },
+    { "JOB",   ACTION_JOB },
+    { "PAPER", ACTION_PAPER },
+    { "FONTS", ACTION_FONTS },
+    { "EXTRACT", ACTION_EXTRACT },
+    { "SELECT", ACTION_SELECT },
+    { "SIMILAR", ACTION_SIMILAR },
+    { "ANNOTATE", ACTION_ANNOTATE },
+    { "SLACK", ACTION_SLACK },
+    { "COMPACT", ACTION_COMPACT },
+    { "VERIFY", ACTION_VERIFY },
+    { "JSON",  ACTION_JSON },
+    { "FIELD", ACTION_FIELD },
+    { "STATS", ACTION_STATS },
+    { "DIFF",  ACTION_DIFF },
+    { "APPLY", ACTION_APPLY },
+    { NULL,    0 }
+};
 
 
 ULONG  ListPrinters( PSZ pszPakFile );
-ULONG  ShowPrinterData( PSZ pszPakFile, PSZ pszPrinter, USHORT fsMode );
-void   ShowDeviceData( PAK_DEV_DIRENTRY pdd, PBYTE pBuf );
-void   ShowReadableData( PAK_DEV_DIRENTRY pdd, PBYTE pBuf );
-void   GeneratePPD( PBYTE pBuf );
-void   DumpBytes( PBYTE pBuf, ULONG cb, BOOL fHex );
-void   PrettyBytes( PBYTE pBuf, ULONG cb );
-PSZ    OffsetToCommand( SHORT sOff, PBYTE pIn, PBYTE pOut );
-USHORT DecompressString(PSZ pszBuffIn, PSZ pszBuffOut);
+ULONG  ShowPrinterData( PSZ pszPakFile, PSZ pszPrinter, USHORT fsMode, PPAKDICT pDict );
+ULONG  AnnotatePrinter( PSZ pszPakFile, PSZ pszPrinter, PSZ pszRegion );
+ULONG  StreamPrinters( PSZ pszPakFile, PSZ pszMode );
+ULONG  ConvertPakFile( PSZ pszPakFile, PSZ pszOutFile, PPAKDICT pDict );
 
 
 /* ------------------------------------------------------------------------- */
 int main( int argc, char *argv[] )
 {
     PSZ    pszPakFile = PAKNAME_AUXDEV_PACK,
-           pszArg     = NULL;
+           pszArg     = NULL,
+           pszDict;
+    PPAKDICT pDict    = NULL;
     USHORT usAction   = ACTION_LIST;
+    PAKSIGNATURE sig;
+    BOOL   fFontPak   = FALSE;
+    CHAR   szRequest[ QUERY_MAX_REQUEST ],
+           szPrinter[ RESOLVE_BUFFER ];
+    PSZ    apszPaks[ SERVE_MAX_PAKS ];
+    ULONG  cb;
+    int    i;
     APIRET rc = 0;
 
     if ( argc > 1 ) {
@@ -81,7 +186,13 @@ int main( int argc, char *argv[] )
         if ( argc > 2 ) {
             strupr( argv[2] );
             if ( *argv[2] == '/' || *argv[2] == '-') argv[2]++;
-            switch ( *argv[2] ) {
+            for ( i = 0; aActionNames[ i ].pszName; i++ ) {
+                if ( strcmp( argv[2], aActionNames[ i ].pszName ) == 0 ) {
+                    usAction = aActionNames[ i ].usAction;
+                    break;
+                }
+            }
+            if ( !aActionNames[ i ].pszName ) switch ( *argv[2] ) {
                 case 'L':  usAction = ACTION_LIST; break;
                 case 'V':  usAction = ACTION_VIEW; break;
                 case 'R':  usAction = ACTION_READ; break;
@@ -94,1471 +205,854 @@ int main( int argc, char *argv[] )
         }
     }
     else {
-        printf("PostScript PAK Utility version 0.2\n");
+        printf("PostScript PAK Utility version " PAKTOOL_VERSION "\n");
         printf("Syntax: ppaktool <pakfile> [<action>]\n\n");
         printf("Supported actions:\n\n");
         printf(" L              List printers in driver PAK file <pakfile> (default)\n\n");
-        printf(" P \"<printer>\"  Generate a PIN-compatible PPD listing for <printer>\n");
+        printf(" P \"<printer>\"  Generate a PPD listing for <printer>, with UTF-8 translation\n");
+        printf("                strings; to import it with PIN, convert it to code page 850\n");
+        printf("                first, e.g. with iconv -f UTF-8 -t IBM850\n");
         printf(" R \"<printer>\"  View data for <printer> in a form optimized for readability\n");
-        printf(" V \"<printer>\"  View data for <printer>, formatted by its internal structure\n\n");
+        printf(" V \"<printer>\"  View data for <printer>, formatted by its internal structure\n");
+        printf(" JSON \"<printer>\"\n");
+        printf("                View data for <printer> as a JSON object, with a member for\n");
+        printf("                each field of its internal structures\n");
+        printf(" FIELD \"<printer>\"|* <field> [<field> ...]\n");
+        printf("                Show the given fields of <printer> (or of every printer), e.g.\n");
+        printf("                ModelName, DefaultResolution or desItems.iResDpi, reading only\n");
+        printf("                the parts of <pakfile> which they need\n\n");
         printf(" B \"<printer>\"  Dump binary data for <printer> in combined (raw/hex) format\n");
         printf(" D \"<printer>\"  Dump binary data for <printer> as raw bytes\n");
-        printf(" X \"<printer>\"  Dump binary data for <printer> as hexadecimal bytes\n\n");
-        printf("All output is to STDOUT.\n");
+        printf(" X \"<printer>\"  Dump binary data for <printer> as hexadecimal bytes\n");
+        printf(" ANNOTATE \"<printer>\" [<region>]\n");
+        printf("                Dump binary data for <printer> with the names of the fields\n");
+        printf("                on each row; <region> may be DESPPD, UILIST, UICLIST, INFO,\n");
+        printf("                *<keyword> or #<n> for one UI block, <start>-<end> or\n");
+        printf("                <start>+<length>\n\n");
+        printf(" SERVE [<pipe> [<pakfile> ...]]\n");
+        printf("                Serve queries on <pakfile> (plus any others listed) over the\n");
+        printf("                named pipe <pipe> (default %s)\n", SERVE_DEFAULT_PIPE );
+        printf(" QUERY <request>\n");
+        printf("                Send <request> to the server listening on pipe <pakfile>\n");
+        printf(" STREAM [D|X]   List all printers in <pakfile> with checksums (or dump their\n");
+        printf("                data as with D or X) in a single pass; use - for <pakfile>\n");
+        printf("                to read one or more PAK files from STDIN\n");
+        printf(" CONVERT <file> Convert <pakfile> from V1 to V2 (indexed) format, or from V2\n");
+        printf("                back to V1, writing the result to <file>\n");
+        printf(" DICT <header>  Generate a keyword dictionary from the PPD files in directory\n");
+        printf("                (or matching wildcard) <pakfile>, writing it to <header>\n");
+        printf(" CHECK          Validate the structure of every printer in <pakfile>; the\n");
+        printf("                exit code is non-zero if any problems are found\n");
+        printf(" STATS          Show the distribution over all printers in <pakfile> of their\n");
+        printf("                sizes, UI options, constraints, commands, fonts and papers,\n");
+        printf("                with percentiles and outlying printers\n");
+        printf(" CONSTRAIN \"<printer>\" [<keyword>=<option> ...]\n");
+        printf("                List the UI constraints of <printer>; or check the given\n");
+        printf("                options (plus defaults) and suggest the nearest valid ones\n");
+        printf(" JOB \"<printer>\" [<keyword>=<option> ...]\n");
+        printf("                Write the JCL and PostScript setup code which the driver\n");
+        printf("                sends for the default (or given) options of <printer>\n");
+        printf(" PAPER \"<printer>\"|* [<width> <height> [<tolerance>] [FIXED]]\n");
+        printf("                List the paper sizes of <printer> (or of every printer), or\n");
+        printf("                find the one nearest the given size in points\n");
+        printf(" FONTS [HAS <font> ... | COMMON <printer> ... | ANY <printer> ...]\n");
+        printf("                List the resident fonts of all printers in <pakfile>; or the\n");
+        printf("                printers having all the given fonts; or the fonts common to\n");
+        printf("                (or found in any of) the given printers (* for all)\n");
+        printf(" SELECT [\"<expression>\" [<pakfile> ...]]\n");
+        printf("                List the printers in <pakfile> (plus any others listed) for\n");
+        printf("                which <expression> is true, e.g. \"color && dpi >= 600\"; with\n");
+        printf("                no expression, list the fields which may be used\n");
+        printf(" SIMILAR [<percent>]\n");
+        printf("                List the groups of printers in <pakfile> whose UI options are\n");
+        printf("                at least <percent> (default 80) similar, and how they differ\n");
+        printf(" SLACK [\"<printer>\"]\n");
+        printf("                Show how many bytes of each printer's information segment\n");
+        printf("                are referenced, repeated or unused (and list the unused\n");
+        printf("                ranges of <printer>)\n");
+        printf(" COMPACT <file> Write a copy of V1 <pakfile> to <file> with each information\n");
+        printf("                segment rebuilt from only the bytes referenced\n");
+        printf(" DIFF <newfile> [<patch>]\n");
+        printf("                List the printers added, removed or changed in <newfile>\n");
+        printf("                relative to <pakfile>, and write to <patch> the differences\n");
+        printf("                from which APPLY can rebuild <newfile>\n");
+        printf(" APPLY <patch> <file>\n");
+        printf("                Rebuild the newer PAK file from <pakfile> and <patch>, writing\n");
+        printf("                it to <file> only if it is exactly the file DIFF was given\n");
+        printf(" VERIFY [\"<printer>\"]\n");
+        printf("                Convert each printer (or <printer>) to a PPD file and back,\n");
+        printf("                and report any field that does not survive the round trip\n");
+        printf(" EXTRACT <dir> [<font> ...]\n");
+        printf("                Write each font (or those given) in font PAK <pakfile> to a\n");
+        printf("                file in <dir>\n\n");
+        printf("P, R, V, JSON, D, X and B accept * for <printer> to show every printer, in\n");
+        printf("directory order.\n");
+        printf("<printer> may be the start of a name or any part of it, in any case; these\n");
+        printf("actions and FIELD, PAPER, SLACK and VERIFY also accept a pattern using * and\n");
+        printf("?, or a part name matching several printers, to show each printer matched.\n");
+        printf("L, D, X and B also accept a font PAK file, with a font name (or full name)\n");
+        printf("instead of <printer>.\n");
+        printf("All output is to STDOUT.  Set %s=<header> to decompress strings\n", DICT_ENV_VAR );
+        printf("using a generated dictionary instead of the built-in one.  Set %s=<dir>\n", CACHE_ENV_VAR );
+        printf("to keep P, R and JSON output for single printers in <dir>, limited to\n");
+        printf("%s KB (default %u).\n", CACHE_SIZE_ENV_VAR, CACHE_DEFAULT_KB );
         return 0;
     }
 
-    switch ( usAction ) {
-        case ACTION_LIST : rc = ListPrinters( pszPakFile );                          break;
-        case ACTION_VIEW : rc = ShowPrinterData( pszPakFile, pszArg, DEV_FMT_DATA ); break;
-        case ACTION_READ : rc = ShowPrinterData( pszPakFile, pszArg, DEV_TXT_DATA ); break;
-        case ACTION_PPD  : rc = ShowPrinterData( pszPakFile, pszArg, DEV_PPD_DATA ); break;
-        case ACTION_DUMP : rc = ShowPrinterData( pszPakFile, pszArg, DEV_RAW_DATA ); break;
-        case ACTION_HEX  : rc = ShowPrinterData( pszPakFile, pszArg, DEV_HEX_DATA ); break;
-        case ACTION_BOTH : rc = ShowPrinterData( pszPakFile, pszArg, DEV_BIN_DATA ); break;
-    }
-
-    if ( rc ) printf("Error reading file (error %u)\n", rc );
-    return rc;
-}
-
-
-/* ------------------------------------------------------------------------- */
-ULONG ListPrinters( PSZ pszPakFile )
-{
-    HFILE            hf;
-    ULONG            ulResult;
-    SHORT            i;
-    PAKSIGNATURE     pak_sig;
-    PAK_DEV_DIRENTRY pak_dev;
-    APIRET           rc;
-
-    if (( rc = DosOpen( pszPakFile, &hf, &ulResult, 0, 0,
-                        OPEN_ACTION_FAIL_IF_NEW | OPEN_ACTION_OPEN_IF_EXISTS,
-                        OPEN_FLAGS_FAIL_ON_ERROR | OPEN_FLAGS_SEQUENTIAL |
-                        OPEN_SHARE_DENYNONE | OPEN_ACCESS_READONLY, NULL )) > 0 )
-    {
-        switch ( rc ) {
-            case 2: printf("The file \"pszPakFile\" was not found.\n");
-                    break;
-            case 3: printf("The specified path was not found.\n");
-                    break;
-            case 5: printf("Access denied.\n");
-                    break;
+    // An alternative keyword dictionary may be named in the environment
+    pszDict = getenv( DICT_ENV_VAR );
+    if ( pszDict && *pszDict && usAction != ACTION_DICT && usAction != ACTION_QUERY ) {
+        if (( rc = PakLoadDictionary( NULL, pszDict, &pDict )) != NO_ERROR ) {
+            printf("Unable to load keyword dictionary %s (error %u)\n", pszDict, rc );
+            return rc;
         }
-        return rc;
     }
 
-    rc = DosRead( hf, &pak_sig, sizeof( PAKSIGNATURE ), &ulResult );
-    if ( rc ) goto cleanup;
-    if (( ulResult < sizeof( PAKSIGNATURE )) ||
-        ( strcmp( pak_sig.szName, PAKSIGNATURE_DEVPACK_V1 ) != 0 ))
+    // Font PAK files support only the list, dump and extract actions
+    if ( usAction == ACTION_LIST || usAction == ACTION_DUMP || usAction == ACTION_HEX ||
+         usAction == ACTION_BOTH || usAction == ACTION_EXTRACT )
     {
-        printf("Invalid PAK file signature!\n");
-        if ( ! strncmp( pak_sig.szName, PAKSIGNATURE_DEVPACK_V1, 9 )) {
-            printf(" - Expected signature: %s\n", PAKSIGNATURE_DEVPACK_V1 );
-            printf(" - Found signature:    %s\n", pak_sig.szName );
-            printf("This PAK file seems to have been created for a different printer driver.\n");
-        }
-        rc = ERROR_INVALID_DATA;
-        goto cleanup;
+        fFontPak = ( PakReadSignature( pszPakFile, &sig ) == NO_ERROR ) &&
+                   ( strncmp( sig.szName, PAKSIGNATURE_FONTPACK_V1, sizeof( sig.szName )) == 0 );
     }
 
-    printf("%s\n==============\n", pak_sig.szName );
-    printf("%d printers defined:\n", pak_sig.iEntries );
-
-    for ( i = 0; i < pak_sig.iEntries; i++ ) {
-        rc = DosRead( hf, &pak_dev, sizeof( PAK_DEV_DIRENTRY ), &ulResult );
-        if ( rc || ulResult < sizeof( PAK_DEV_DIRENTRY )) goto cleanup;
-        printf(" - %s (offset 0x%X, %u bytes, flags=0x%X)\n",
-                pak_dev.szDeviceName, pak_dev.ulOffset, pak_dev.ulSize, pak_dev.ulFlags );
+    // Printers may also be given by part of their name, or by a pattern
+    if ( !fFontPak ) switch ( usAction ) {
+        case ACTION_VIEW: case ACTION_READ: case ACTION_PPD:  case ACTION_DUMP:
+        case ACTION_HEX:  case ACTION_BOTH: case ACTION_JSON: case ACTION_FIELD:
+        case ACTION_PAPER: case ACTION_SLACK: case ACTION_VERIFY:
+            rc = ResolvePrinter( pszPakFile, &pszArg, TRUE, szPrinter );
+            break;
+        case ACTION_ANNOTATE: case ACTION_CONSTRAIN: case ACTION_JOB:
+            rc = ResolvePrinter( pszPakFile, &pszArg, FALSE, szPrinter );
+            break;
     }
 
-cleanup:
-    DosClose( hf );
-    return rc;
-}
-
-
-/* ------------------------------------------------------------------------- */
-ULONG ShowPrinterData( PSZ pszPakFile, PSZ pszPrinter, USHORT fsMode )
-{
-    HFILE            hf;
-    ULONG            ulResult;
-    SHORT            i;
-    BOOL             fFound = FALSE;
-    PAKSIGNATURE     pak_sig;
-    PAK_DEV_DIRENTRY pak_dev;
-    PBYTE            pBuf;
-    APIRET           rc;
-
-    if (( rc = DosOpen( pszPakFile, &hf, &ulResult, 0, 0,
-                        OPEN_ACTION_FAIL_IF_NEW | OPEN_ACTION_OPEN_IF_EXISTS,
-                        OPEN_FLAGS_FAIL_ON_ERROR | OPEN_FLAGS_SEQUENTIAL |
-                        OPEN_SHARE_DENYNONE | OPEN_ACCESS_READONLY, NULL )) > 0 )
-    {
-        switch ( rc ) {
-            case 2: printf("The file \"pszPakFile\" was not found.\n");
-                    break;
-            case 3: printf("The specified path was not found.\n");
-                    break;
-            case 5: printf("Access denied.\n");
-                    break;
-        }
-        return rc;
+    if ( rc ) {
+        // As with ShowPrinterData(), a missing printer is not a read error
+        if ( usAction < ACTION_CHECK ) rc = NO_ERROR;
     }
-
-    rc = DosRead( hf, &pak_sig, sizeof( PAKSIGNATURE ), &ulResult );
-    if ( rc ) goto cleanup;
-    if (( ulResult < sizeof( PAKSIGNATURE )) ||
-        ( strcmp( pak_sig.szName, PAKSIGNATURE_DEVPACK_V1 ) != 0 ))
-    {
-        printf("Invalid PAK file signature!\n");
-        rc = ERROR_INVALID_DATA;
-        goto cleanup;
+    else if ( fFontPak ) switch ( usAction ) {
+        case ACTION_LIST : rc = ListFontPak( pszPakFile );                      break;
+        case ACTION_DUMP : rc = DumpFontPak( pszPakFile, pszArg, DEV_RAW_DATA ); break;
+        case ACTION_HEX  : rc = DumpFontPak( pszPakFile, pszArg, DEV_HEX_DATA ); break;
+        case ACTION_BOTH : rc = DumpFontPak( pszPakFile, pszArg, DEV_BIN_DATA ); break;
+        case ACTION_EXTRACT:
+            rc = ExtractFontPak( pszPakFile, pszArg, (PSZ *)( argv + 4 ), ( argc > 4 ) ? argc - 4 : 0 );
+            break;
     }
+    else switch ( usAction ) {
+        case ACTION_LIST : rc = ListPrinters( pszPakFile );                                 break;
+        case ACTION_VIEW : rc = ShowPrinterData( pszPakFile, pszArg, DEV_FMT_DATA, pDict ); break;
+        case ACTION_READ : rc = ShowPrinterData( pszPakFile, pszArg, DEV_TXT_DATA, pDict ); break;
+        case ACTION_PPD  : rc = ShowPrinterData( pszPakFile, pszArg, DEV_PPD_DATA, pDict ); break;
+        case ACTION_DUMP : rc = ShowPrinterData( pszPakFile, pszArg, DEV_RAW_DATA, pDict ); break;
+        case ACTION_HEX  : rc = ShowPrinterData( pszPakFile, pszArg, DEV_HEX_DATA, pDict ); break;
+        case ACTION_BOTH : rc = ShowPrinterData( pszPakFile, pszArg, DEV_BIN_DATA, pDict ); break;
+        case ACTION_JSON : rc = ShowPrinterData( pszPakFile, pszArg, DEV_JSON_DATA, pDict ); break;
+        case ACTION_ANNOTATE:
+            rc = AnnotatePrinter( pszPakFile, pszArg, ( argc > 4 ) ? argv[ 4 ] : NULL );
+            break;
 
-    // If no printer name was requested, just grab the first one
-    if ( !pszPrinter ) {
-        rc = DosRead( hf, &pak_dev, sizeof( PAK_DEV_DIRENTRY ), &ulResult );
-        if ( rc || ulResult < sizeof( PAK_DEV_DIRENTRY )) goto cleanup;
-        fFound = TRUE;
-    }
-    // Otherwise, search the directory for the specified printer
-    else for ( i = 0; i < pak_sig.iEntries; i++ ) {
-        rc = DosRead( hf, &pak_dev, sizeof( PAK_DEV_DIRENTRY ), &ulResult );
-        if ( rc || ulResult < sizeof( PAK_DEV_DIRENTRY )) goto cleanup;
-        if ( stricmp( pak_dev.szDeviceName, pszPrinter ) == 0 ) {
-            fFound = TRUE;
+        case ACTION_STREAM: rc = StreamPrinters( pszPakFile, pszArg );              break;
+        case ACTION_CONVERT: rc = ConvertPakFile( pszPakFile, pszArg, pDict );      break;
+        case ACTION_DICT : rc = BuildDictionary( pszPakFile, pszArg );              break;
+        case ACTION_CHECK: rc = CheckPakFile( pszPakFile, pDict );                  break;
+        case ACTION_STATS: rc = ShowStats( pszPakFile, pDict );                     break;
+        case ACTION_CONSTRAIN:
+            rc = ShowConstraints( pszPakFile, pszArg, (PSZ *)( argv + 4 ), ( argc > 4 ) ? argc - 4 : 0 );
+            break;
+        case ACTION_JOB:
+            rc = RenderJob( pszPakFile, pszArg, (PSZ *)( argv + 4 ), ( argc > 4 ) ? argc - 4 : 0, pDict );
+            break;
+        case ACTION_PAPER:
+            rc = ShowPapers( pszPakFile, pszArg, (PSZ *)( argv + 4 ), ( argc > 4 ) ? argc - 4 : 0, pDict );
+            break;
+        case ACTION_FONTS:
+            rc = ShowFonts( pszPakFile, (PSZ *)( argv + 3 ), ( argc > 3 ) ? argc - 3 : 0 );
+            break;
+        case ACTION_SELECT:
+            // The PAK file given first is searched along with any listed after the expression
+            if ( argc - 3 > SERVE_MAX_PAKS ) {
+                printf("At most %u PAK files may be searched at once.\n", SERVE_MAX_PAKS );
+                rc = ERROR_INVALID_PARAMETER;
+                break;
+            }
+            apszPaks[ 0 ] = pszPakFile;
+            for ( i = 4, cb = 1; i < argc; i++ )
+                apszPaks[ cb++ ] = argv[ i ];
+            rc = SelectPrinters( pszArg, apszPaks, cb );
+            break;
+        case ACTION_SIMILAR: rc = FindSimilar( pszPakFile, pszArg );                break;
+        case ACTION_SLACK: rc = ShowSlack( pszPakFile, pszArg );                    break;
+        case ACTION_COMPACT: rc = CompactPakFile( pszPakFile, pszArg );             break;
+        case ACTION_DIFF:
+            rc = DiffPakFiles( pszPakFile, pszArg, ( argc > 4 ) ? argv[ 4 ] : NULL );
+            break;
+        case ACTION_APPLY:
+            rc = ApplyPakPatch( pszPakFile, pszArg, ( argc > 4 ) ? argv[ 4 ] : NULL );
+            break;
+        case ACTION_VERIFY: rc = VerifyPakFile( pszPakFile, pszArg, pDict );        break;
+        case ACTION_FIELD:
+            rc = QueryPakFields( pszPakFile, pszArg, (PSZ *)( argv + 4 ), ( argc > 4 ) ? argc - 4 : 0, pDict );
+            break;
+        case ACTION_EXTRACT:
+            printf("EXTRACT applies only to font PAK files\n");
+            rc = ERROR_INVALID_PARAMETER;
             break;
-        }
-    }
-    if ( !fFound ) {
-        printf("The requested printer was not found\n");
-        goto cleanup;
-    }
 
-    // Seek to the indicated offset for this printer's data
-    rc = DosSetFilePtr( hf, pak_dev.ulOffset, FILE_BEGIN, &ulResult );
-    if ( rc || ulResult != pak_dev.ulOffset ) goto cleanup;
+        case ACTION_SERVE:
+            // The PAK file given first is served along with any listed after the pipe name
+            if ( argc - 3 > SERVE_MAX_PAKS ) {
+                printf("At most %u PAK files may be served at once.\n", SERVE_MAX_PAKS );
+                rc = ERROR_INVALID_PARAMETER;
+                break;
+            }
+            apszPaks[ 0 ] = pszPakFile;
+            for ( i = 4, cb = 1; i < argc; i++ )
+                apszPaks[ cb++ ] = argv[ i ];
+            rc = ServePakFiles( apszPaks, cb, pszArg ? pszArg : SERVE_DEFAULT_PIPE, pDict );
+            break;
 
-    // Read the data into a simple buffer
-    if (( pBuf = (PBYTE) malloc( pak_dev.ulSize )) == NULL ) {
-        printf("malloc() failed - out of memory?\n");
-        goto cleanup;
-    }
-    rc = DosRead( hf, pBuf, pak_dev.ulSize, &ulResult );
-    if ( rc || ulResult < pak_dev.ulSize ) {
-        printf("Error reading device data.\n");
-        free( pBuf );
-        goto cleanup;
+        case ACTION_QUERY:
+            // Rebuild the request line, quoting any arguments containing spaces
+            for ( i = 3, cb = 0, szRequest[ 0 ] = 0; i < argc; i++ ) {
+                if ( cb + strlen( argv[ i ] ) + 4 > sizeof( szRequest )) break;
+                cb += sprintf( szRequest + cb, strchr( argv[ i ], ' ') ? "%s\"%s\"" : "%s%s",
+                               cb ? " " : "", argv[ i ] );
+            }
+            rc = QueryServer( pszPakFile, szRequest );
+            break;
     }
 
-    // OK, we have the data... now output it in the manner requested.
-    switch ( fsMode ) {
-        case DEV_FMT_DATA: ShowDeviceData( pak_dev, pBuf );          break;
-        case DEV_TXT_DATA: ShowReadableData( pak_dev, pBuf );        break;
-        case DEV_PPD_DATA: GeneratePPD( pBuf );                      break;
-        case DEV_RAW_DATA: DumpBytes( pBuf, pak_dev.ulSize, FALSE ); break;
-        case DEV_HEX_DATA: DumpBytes( pBuf, pak_dev.ulSize, TRUE );  break;
-        case DEV_BIN_DATA: PrettyBytes( pBuf, pak_dev.ulSize );      break;
-    }
+    // CHECK and the actions numbered after it (and the font PAK actions)
+    // report their own errors
+    if ( rc && usAction < ACTION_CHECK && !fFontPak )
+        printf("Error reading file (error %u)\n", rc );
+    PakFreeDictionary( NULL, pDict );
+    return rc;
+}
 
-    free( pBuf );
 
-cleanup:
-    DosClose( hf );
-    return rc;
+/* ------------------------------------------------------------------------- */
+void ReportOpenError( APIRET rc )
+{
+    switch ( rc ) {
+        case 2: printf("The file \"pszPakFile\" was not found.\n");
+                break;
+        case 3: printf("The specified path was not found.\n");
+                break;
+        case 5: printf("Access denied.\n");
+                break;
+    }
 }
 
 
 /* ------------------------------------------------------------------------- *
- * DumpBytes                                                                 *
+ * LoadPrinter                                                               *
  *                                                                           *
- * Dump the contents of a buffer to STDOUT as either raw or hex byte values. *
+ * Load the data of one printer from a PAK file (V1 or V2), reporting any    *
+ * error.                                                                    *
  *                                                                           *
  * PARAMETERS:                                                               *
- *   PBYTE pBuf: Pointer to the data being dumped                            *
- *   ULONG cb  : Number of bytes to dump                                     *
- *   BOOL  fHex: Output as hex values instead of literal bytes?              *
+ *   PSZ               pszPakFile: Name of the PAK file                      *
+ *   PSZ               pszPrinter: Printer name, or NULL for the first       *
+ *   PPAK_DEV_DIRENTRY pEntry    : Receives the printer's directory entry    *
+ *   PBYTE            *ppSegment : Receives its segment (free with PakFree)  *
  *                                                                           *
- * RETURNS: N/A                                                              *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, otherwise an error code                                   *
  * ------------------------------------------------------------------------- */
-void DumpBytes( PBYTE pBuf, ULONG cb, BOOL fHex )
+ULONG LoadPrinter( PSZ pszPakFile, PSZ pszPrinter, PPAK_DEV_DIRENTRY pEntry, PBYTE *ppSegment )
 {
-    ULONG i;
-    SHORT sCol = 0;
-
-    for ( i = 0; i < cb; i++ ) {
-        if ( fHex ) {
-            printf("%02X", *(pBuf+i) );
-            sCol += 3;
-            if ( sCol > 75 ) {
-                printf("\n");
-                sCol = 0;
-            } else
-                printf(" ");
-        }
-        else printf("%c", *(pBuf+i) );
+    APIRET rc;
+
+    rc = PakLoadDevice( NULL, pszPakFile, pszPrinter, pEntry, ppSegment );
+    switch ( rc ) {
+        case NO_ERROR:
+            break;
+        case ERROR_PAK_NO_DEVICE:
+            printf("The requested printer was not found\n");
+            break;
+        case ERROR_INVALID_DATA:
+            printf("Invalid PAK file signature!\n");
+            break;
+        case ERROR_NOT_ENOUGH_MEMORY:
+            printf("malloc() failed - out of memory?\n");
+            break;
+        case ERROR_HANDLE_EOF:
+            printf("Error reading device data.\n");
+            break;
+        default:
+            ReportOpenError( rc );
+            break;
     }
+    return rc;
 }
 
 
 /* ------------------------------------------------------------------------- *
- * PrettyBytes                                                               *
+ * ReadPakImage                                                              *
  *                                                                           *
- * Dump the contents of a buffer to STDOUT in a nice-looking table with both *
- * hexadecimal and literal (character) values displayed side-by-side.        *
+ * Read an entire file into memory.                                          *
  *                                                                           *
  * PARAMETERS:                                                               *
- *   PBYTE pBuf: Pointer to the data being dumped                            *
- *   ULONG cb  : Number of bytes to dump                                     *
+ *   PSZ    pszFile : Name of the file                                       *
+ *   PBYTE *ppbFile : Receives the file contents (free with free())          *
+ *   PULONG pcbFile : Receives the file size                                 *
  *                                                                           *
- * RETURNS: N/A                                                              *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, otherwise an OS/2 error code                              *
  * ------------------------------------------------------------------------- */
-void PrettyBytes( PBYTE pBuf, ULONG cb )
+ULONG ReadPakImage( PSZ pszFile, PBYTE *ppbFile, PULONG pcbFile )
 {
-    ULONG i, j, k;
-    USHORT count = 0;
-
-    printf("     +------------------------------------------------+----------------+\n");
-    printf("     |+0 +1 +2 +3 +4 +5 +6 +7 +8 +9 +A +B +C +D +E +F |0123456789ABCDEF|\n");
-    printf("+----+------------------------------------------------+----------------+\n");
-    printf("|0000|");
-    for ( i = 0, j = 0; i < cb; i++ ) {
-        printf("%02X", *(pBuf+i) );
-        count++;
-        if ( count > 15 ) {
-            printf(" |");
-            for ( ; j <= i; j++ ) printf("%c", DISPLAYABLE_CHAR( *(pBuf+j) ));
-            printf("|\n|%04X|", i+1 );
-            count = 0;
-        } else
-            printf(" ");
-    }
-    if ( j < i ) {
-        for ( k = (i%16); k < 16; k++ ) printf("   ");
-        printf("|");
-        for ( ; j <= i; j++ ) printf("%c", DISPLAYABLE_CHAR( *(pBuf+j) ));
-        for ( k = (j%16); k < 16; k++ ) printf(" ");
-        printf("|\n");
+    HFILE       hf;
+    ULONG       ulResult;
+    FILESTATUS3 fs3;
+    PBYTE       pbFile = NULL;
+    APIRET      rc;
+
+    rc = DosOpen( pszFile, &hf, &ulResult, 0, 0,
+                  OPEN_ACTION_FAIL_IF_NEW | OPEN_ACTION_OPEN_IF_EXISTS,
+                  OPEN_FLAGS_FAIL_ON_ERROR | OPEN_FLAGS_SEQUENTIAL |
+                  OPEN_SHARE_DENYWRITE | OPEN_ACCESS_READONLY, NULL );
+    if ( rc ) return rc;
+
+    rc = DosQueryFileInfo( hf, FIL_STANDARD, &fs3, sizeof( fs3 ));
+    if ( !rc && fs3.cbFile < sizeof( PAKSIGNATURE )) rc = ERROR_INVALID_DATA;
+    if ( !rc && ( pbFile = (PBYTE) malloc( fs3.cbFile )) == NULL ) rc = ERROR_NOT_ENOUGH_MEMORY;
+    if ( !rc ) rc = DosRead( hf, pbFile, fs3.cbFile, &ulResult );
+    if ( !rc && ulResult < fs3.cbFile ) rc = ERROR_HANDLE_EOF;
+    DosClose( hf );
+
+    if ( rc ) {
+        free( pbFile );
+        return rc;
     }
-    printf("+----+------------------------------------------------+----------------+\n");
-    printf("     |+0 +1 +2 +3 +4 +5 +6 +7 +8 +9 +A +B +C +D +E +F |0123456789ABCDEF|\n");
-    printf("     +------------------------------------------------+----------------+\n");
+    *ppbFile = pbFile;
+    *pcbFile = fs3.cbFile;
+    return NO_ERROR;
 }
 
 
-/* ------------------------------------------------------------------------- */
-void print_offcell( PSZ pszName, SHORT sValue, BOOL fNL )
+/* ------------------------------------------------------------------------- *
+ * LoadPakImage                                                              *
+ *                                                                           *
+ * Read a whole device PAK file (V1 or V2) into memory and list its entries, *
+ * reporting any error.  The segments are not checked against the file size. *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ                pszPakFile: Name of the PAK file                     *
+ *   PBYTE             *ppbFile   : Receives the file contents               *
+ *   PULONG             pcbFile   : Receives the file size                   *
+ *   PPAK_DEV_DIRENTRY *ppEntries : Receives the directory, in V1 form, with *
+ *                                  the offset of each segment in the file   *
+ *   PULONG            *ppulHashes: Receives the content hash of each entry  *
+ *                                  of a V2 file, or NULL for a V1 file      *
+ *   PULONG             pcEntries : Receives the number of entries           *
+ *                                                                           *
+ * All three arrays are to be freed with free().                             *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, otherwise an error code                                   *
+ * ------------------------------------------------------------------------- */
+ULONG LoadPakImage( PSZ pszPakFile, PBYTE *ppbFile, PULONG pcbFile,
+                    PPAK_DEV_DIRENTRY *ppEntries, PULONG *ppulHashes, PULONG pcEntries )
 {
-    printf("%-24s = ", pszName);
-    printf( OFFSET_FORMAT(sValue), sValue );
-    if ( fNL )
-        printf(" |\n| ");
-    else
-        printf(" | ");
-}
-
+    PBYTE             pbFile;
+    ULONG             cbFile,
+                      cEntries,
+                      i;
+    PPAKSIGNATURE     pSig;
+    PPAK_DEV_DIRENTRY pEntries;
+    PULONG            pulHashes = NULL;
+    PAK2VIEW          view;
+    BOOL              fV2;
+    APIRET            rc;
+
+    if (( rc = ReadPakImage( pszPakFile, &pbFile, &cbFile )) != NO_ERROR ) {
+        if ( rc == ERROR_INVALID_DATA ) printf("Invalid PAK file signature!\n");
+        else ReportOpenError( rc );
+        return rc;
+    }
 
-/* ------------------------------------------------------------------------- */
-void ShowDeviceData( PAK_DEV_DIRENTRY pdd, PBYTE pBuf )
-{
-    DESPPD     desPPD = {0};
-    PBYTE      pInfoSeg;
-    PUI_BLOCK  puib;
-    PUIC_BLOCK puicb;
-    ULONG      ulCB,
-               cbDS,
-               cbIS;
-    USHORT     i, j;
-    PSHORT     psRes;
-
-
-    cbDS = sizeof( DESPPD );
-    memcpy( (PBYTE) &desPPD, pBuf, cbDS );
-    pInfoSeg = pBuf + cbDS;
-
-    // Allocate and copy the dynamic data items in DESPPD
-    ulCB = desPPD.stUIList.usBlockListSize;
-    desPPD.stUIList.pBlockList = (PUI_BLOCK) malloc( ulCB );
-    memcpy( desPPD.stUIList.pBlockList, (PUI_BLOCK) pInfoSeg, ulCB );
-    pInfoSeg += ulCB;
-    cbDS += ulCB;
-
-    ulCB = desPPD.stUICList.usNumOfUICs * sizeof( UIC_BLOCK );
-    desPPD.stUICList.puicBlockList = (PUIC_BLOCK) malloc( ulCB );
-    memcpy( desPPD.stUICList.puicBlockList, (PUIC_BLOCK) pInfoSeg, ulCB );
-    pInfoSeg += ulCB;
-    cbDS += ulCB;
-    cbIS = pdd.ulSize - cbDS;
-    desPPD.pPSStringBuff = pInfoSeg;
-
-    // Print header
-    printf("/=============================================================================\\\n");
-    printf("| PRINTER PAK ENTRY                                                           |\n");
-    printf("| %-75s |\n", pdd.szDeviceName );
-    printf("+-----------------------------------------------------------------------------+\n");
-    printf("| %5u bytes total                                                           |\n", pdd.ulSize );
-    printf("|  - %5u bytes in descriptor segment                                        |\n", cbDS );
-    printf("|  - %5u bytes in information segment                                       |\n", cbIS );
-    printf("\\=============================================================================/\n\n");
-
-    printf("\n-------------------------------------------------------------------------------");
-    printf("\n                         DESCRIPTOR SEGMENT (DESPPD)                           ");
-    printf("\n-------------------------------------------------------------------------------\n");
-
-    // Print the structured data from DESPPD
-    // PPD1
-    printf("+-----------------+\n");
-    printf("| desItems (PPD1) |\n");
-    printf("+-----------------+--------------------+--------------------------------------+\n| ");
-    printf("iSizeBuffer              =   %7d | ", desPPD.desItems.iSizeBuffer );
-    print_offcell("ofsExitserver",  desPPD.desItems.ofsExitserver, TRUE );
-    print_offcell("ofsPswrd",       desPPD.desItems.ofsPswrd, FALSE );
-    printf("iScreenAngle             =   %7d |\n| ", desPPD.desItems.iScreenAngle );
-    printf("iPpm                     =   %7d | ", desPPD.desItems.iPpm );
-    printf("usLanguageLevel          =   %7d |\n| ", desPPD.desItems.usLanguageLevel );
-    printf("lFreeVM                  = %9d | ", desPPD.desItems.lFreeVM );
-    print_offcell("ofsTransferNor", desPPD.desItems.ofsTransferNor, TRUE );
-    print_offcell("ofsPrType",      desPPD.desItems.ofsPrType, FALSE );
-    print_offcell("ofsTransferInv", desPPD.desItems.ofsTransferInv, TRUE );
-    print_offcell("ofsPrName",      desPPD.desItems.ofsPrName, FALSE );
-    print_offcell("ofsInitString",  desPPD.desItems.ofsInitString, TRUE );
-    printf("iResDpi                  =   %7d | ", desPPD.desItems.iResDpi );
-    print_offcell("ofsJCLToPS",     desPPD.desItems.ofsJCLToPS, TRUE );
-    printf("ResList.uNumOfRes        =   %7d | ", desPPD.desItems.ResList.uNumOfRes );
-    print_offcell("ofsTermString",  desPPD.desItems.ofsTermString, TRUE );
-    printf("ResList.uResOffset       =   %7d | ", desPPD.desItems.ResList.uResOffset );
-    printf("sDefaultDuplex           =   %7d |\n| ", desPPD.desItems.sDefaultDuplex );
-    printf("ResList.bIsJCLResolution =   %7d | ", desPPD.desItems.ResList.bIsJCLResolution );
-    // Note: the duplex options appear to be unused and will thus be 0 (not -1)
-    printf("ofsDuplexFalse           =   %7d |\n| ", desPPD.desItems.ofsDuplexFalse );
-    printf("lScrFreq                 =   %7d | ", desPPD.desItems.lScrFreq );
-    printf("ofsDuplexNoTumble        =   %7d |\n| ", desPPD.desItems.ofsDuplexNoTumble );
-    printf("fIsColorDevice           =   %7d | ", desPPD.desItems.fIsColorDevice );
-    printf("ofsDuplexTumble          =   %7d |\n| ", desPPD.desItems.ofsDuplexTumble );
-    printf("fIsFileSystem            =   %7d | ", desPPD.desItems.fIsFileSystem );
-    print_offcell("ofsPCFileName",  desPPD.desItems.ofsPCFileName, TRUE );
-    print_offcell("ofsReset",       desPPD.desItems.ofsReset, FALSE );
-#if PSDRIVER == 1
-    printf("fTTSupport               =   %7d |\n", desPPD.desItems.fTTSupport );
-#else
-    printf("                                     |\n");
-#endif
-    printf("+--------------------------------------+--------------------------------------+\n\n");
-
-    // PPD2
-    printf("+----------------+\n");
-    printf("| desPage (PPD2) |\n");
-    printf("+----------------+---------------------+--------------------------------------+\n| ");
-#if PSDRIVER > 2
-    printf("                                     | ");
-#else
-    print_offcell("ofsDfpgsz",       desPPD.desPage.ofsDfpgsz, FALSE );
-#endif
-    printf("iImgpgpairs              =   %7d |\n| ", desPPD.desPage.iImgpgpairs );
-    printf("fIsVariablePaper         =   %7d | ", desPPD.desPage.fIsVariablePaper );
-    print_offcell("ofsImgblPgsz",    desPPD.desPage.ofsImgblPgsz, TRUE );
-#if PSDRIVER > 2
-    printf("                                     | ");
-#else
-    print_offcell("ofsDefimagearea", desPPD.desPage.ofsDefimagearea, FALSE );
-#endif
-    print_offcell("ofsCustomPageSize", desPPD.desPage.ofsCustomPageSize, TRUE );
-#if PSDRIVER > 2
-    printf("                                     | ");
-#else
-    print_offcell("ofsDefpaperdim",  desPPD.desPage.ofsDefpaperdim, FALSE );
-#endif
-    printf("iCustomPageSizeMinWidth  =   %7d |\n| ", desPPD.desPage.iCustomPageSizeMinWidth );
-#if PSDRIVER > 2
-    printf("                                     | ");
-#else
-    printf("iCmpgpairs               =   %7d | ", desPPD.desPage.iCmpgpairs );
-#endif
-    printf("iCustomPageSizeMaxWidth  =   %7d |\n| ", desPPD.desPage.iCustomPageSizeMaxWidth );
-#if PSDRIVER > 2
-    printf("                                     | ");
-#else
-    print_offcell("ofsLspgCmnds",    desPPD.desPage.ofsLspgCmnds, FALSE );
-#endif
-    printf("iCustomPageSizeMinHeight =   %7d |\n| ", desPPD.desPage.iCustomPageSizeMinHeight );
-    printf("iDmpgpairs               =   %7d | ", desPPD.desPage.iDmpgpairs );
-    printf("iCustomPageSizeMaxHeight =   %7d |\n| ", desPPD.desPage.iCustomPageSizeMaxHeight );
-    print_offcell("ofsDimxyPgsz",    desPPD.desPage.ofsDimxyPgsz, FALSE );
-#if PSDRIVER > 2
-    printf("sReserved1               =   %7d |\n| ", desPPD.desPage.sReserved1 );
-    printf("                                     | ");
-    printf("sReserved2               =   %7d |\n", desPPD.desPage.sReserved2 );
-#else
-    printf("                                     |\n");
-#endif
-    printf("+--------------------------------------+--------------------------------------+\n\n");
-
-    // PPD3
-    printf("+-------------------+\n");
-    printf("| desInpbins (PPD3) |\n");
-    printf("+-------------------+------------------+--------------------------------------+\n| ");
-    printf("iManualfeed              =   %7d | ", desPPD.desInpbins.iManualfeed );
-    printf("iInpbinpairs             =   %7d |\n| ", desPPD.desInpbins.iInpbinpairs );
-    print_offcell("ofsManualtrue",   desPPD.desInpbins.ofsManualtrue, FALSE );
-    print_offcell("ofsCmInpbins",    desPPD.desInpbins.ofsCmInpbins, TRUE );
-    print_offcell("ofsManualfalse",  desPPD.desInpbins.ofsManualfalse, FALSE );
-    printf("iNumOfPageSizes          =   %7d |\n| ", desPPD.desInpbins.iNumOfPageSizes );
-    print_offcell("ofsDefinputslot", desPPD.desInpbins.ofsDefinputslot, FALSE );
-    print_offcell("ofsPageSizes",    desPPD.desInpbins.ofsPageSizes, FALSE );
-    printf("\n+--------------------------------------+--------------------------------------+\n\n");
-
-    // PPD4
-    printf("+-------------------+\n");
-    printf("| desOutbins (PPD4) |\n");
-    printf("+-------------------+------------------+--------------------------------------+\n| ");
-    printf("fIsDefoutorder           =   %7d | ", desPPD.desOutbins.fIsDefoutorder );
-    print_offcell("ofsDefoutputbin", desPPD.desOutbins.ofsDefoutputbin, TRUE );
-    print_offcell("ofsOrdernormal",  desPPD.desOutbins.ofsOrdernormal, FALSE );
-    printf("iOutbinpairs             =   %7d |\n| ", desPPD.desOutbins.iOutbinpairs );
-    print_offcell("ofsOrderreverse", desPPD.desOutbins.ofsOrderreverse, FALSE );
-    print_offcell("ofsCmOutbins",    desPPD.desOutbins.ofsCmOutbins, FALSE );
-    printf("\n+--------------------------------------+--------------------------------------+\n\n");
-
-    // PPD5
-    printf("+-----------------+\n");
-    printf("| desFonts (PPD5) |\n");
-    printf("+-----------------+--------------------+\n| ");
-    print_offcell("ofsDeffont", desPPD.desFonts.ofsDeffont, TRUE );
-    printf("iFonts                   =   %7d |\n| ", desPPD.desFonts.iFonts );
-    print_offcell("ofsFontnames", desPPD.desFonts.ofsFontnames, FALSE );
-    printf("\n+--------------------------------------+\n\n");
-
-    // PPD6
-    printf("+-----------------+\n");
-    printf("| desForms (PPD6) |\n");
-    printf("+-----------------+--------------------+\n| ");
-    printf("usFormCount              =   %7d |\n| ", desPPD.desForms.usFormCount );
-    print_offcell("ofsFormTable", desPPD.desForms.ofsFormTable, TRUE );
-    print_offcell("ofsFormIndex", desPPD.desForms.ofsFormIndex, FALSE );
-    printf("\n+--------------------------------------+\n\n");
-
-    // UI_LIST
-    printf("+--------------------+\n");
-    printf("| stUIList (UI_LIST) |\n");
-    printf("+--------------------+--------------------------------------------------------+\n");
-    printf("| usNumOfBlocks       =   %7d                                             |\n", desPPD.stUIList.usNumOfBlocks );
-    printf("| usBlockListSize     =   %7d                                             |\n", desPPD.stUIList.usBlockListSize );
-    puib = desPPD.stUIList.pBlockList;
-    for ( i = 0; puib && desPPD.stUIList.usBlockListSize && i < desPPD.stUIList.usNumOfBlocks; i++ ) {
-        printf("+-----------------------------------------------------------------------------+\n");
-        printf("| pBlockList[ %2d ]:                                                           |\n", i );
-//                OFFSET_TO_PSZ(puib->ofsUITransString, pInfoSeg) );
-//                OFFSET_TO_PSZ(puib->ofsUIName, pInfoSeg) );
-        printf("|    ofsUIName        = ");
-        printf( OFFSET_FORMAT((SHORT)(puib->ofsUIName)), puib->ofsUIName );
-        printf("                                             |\n");
-        printf("|    ofsUITransString = ");
-        printf( OFFSET_FORMAT((SHORT)(puib->ofsUITransString)), puib->ofsUITransString );
-        printf("                                             |\n");
-        printf("|    usOrderDep       =   %7d                                             |\n", puib->usOrderDep );
-        printf("|    usDisplayOrder   =   %7d                                             |\n", puib->usDisplayOrder );
-        printf("|    usUILocation     =   %7d                                             |\n", puib->usUILocation );
-        printf("|    usSelectType     =   %7d                                             |\n", puib->usSelectType );
-        printf("|    ucGroupType      =   %7d                                             |\n", puib->ucGroupType );
-        printf("|    ucPanelID        =   %7d                                             |\n", puib->ucPanelID    );
-        printf("|    usDefaultEntry   =   %7d                                             |\n", puib->usDefaultEntry );
-        printf("|    usNumOfEntries   =   %7d                                             |\n", puib->usNumOfEntries );
-        printf("|    uiEntry[]................................................................|\n");
-        for ( j = 0; j < puib->usNumOfEntries; j++ ) {
-            printf("|    : %2d:  ofsOption = %#6x   ofsTransString = %#6x   ofsValue = %#6x :|\n",
-                    j, puib->uiEntry[j].ofsOption, puib->uiEntry[j].ofsTransString, puib->uiEntry[j].ofsValue );
-            // OFFSET_TO_PSZ(puib->uiEntry[j].ofsOption, pInfoSeg) );
-            // OFFSET_TO_PSZ(puib->uiEntry[j].ofsTransString, pInfoSeg) );
+    pSig = (PPAKSIGNATURE) pbFile;
+    fV2  = ( strcmp( pSig->szName, PAK2SIGNATURE_DEVPACK ) == 0 );
+    if ( fV2 ) {
+        if ( Pak2Attach( pbFile, cbFile, &view ) != NO_ERROR ) {
+            printf("Invalid V2 PAK file header or index!\n");
+            free( pbFile );
+            return ERROR_INVALID_DATA;
         }
-        printf("|    .........................................................................|\n");
-        INCREMENT_BLOCK_PTR( puib );
+        cEntries = view.pHdr->cEntries;
     }
-    printf("+-----------------------------------------------------------------------------+\n\n");
-
-    // UIC_LIST
-    printf("+----------------------+\n");
-    printf("| stUICList (UIC_LIST) |\n");
-    printf("+----------------------+------------------------------------------------------+\n");
-    printf("| usNumOfUICs             =   %7d                                         |\n", desPPD.stUICList.usNumOfUICs );
-    puicb = desPPD.stUICList.puicBlockList;
-    for ( i = 0; puicb && i < desPPD.stUICList.usNumOfUICs; i++ ) {
-        printf("+-----------------------------------------------------------------------------+\n");
-        printf("| puicBlockList[ %2d ]:                                                        |\n", i );
-        printf("|    uicEntry1.ofsUIBlock =   %7d                                         |\n", puicb->uicEntry1.ofsUIBlock );
-        printf("|    uicEntry1.bOption    =%#10x                                         |\n", puicb->uicEntry1.bOption );
-        printf("|    uicEntry2.ofsUIBlock =   %7d                                         |\n", puicb->uicEntry2.ofsUIBlock );
-        printf("|    uicEntry2.bOption    =%#10x                                         |\n", puicb->uicEntry2.bOption );
-        puicb++;
+    else {
+        if (( strncmp( pSig->szName, PAKSIGNATURE_DEVPACK_V1, sizeof( pSig->szName )) != 0 ) ||
+            ( pSig->iEntries < 0 ) ||
+            ( sizeof( PAKSIGNATURE ) + pSig->iEntries * sizeof( PAK_DEV_DIRENTRY ) > cbFile ))
+        {
+            printf("Invalid PAK file signature or directory!\n");
+            free( pbFile );
+            return ERROR_INVALID_DATA;
+        }
+        cEntries = pSig->iEntries;
     }
-    printf("+-----------------------------------------------------------------------------+\n\n");
-
-    printf("\n-------------------------------------------------------------------------------");
-    printf("\n                            INFORMATION SEGMENT                                ");
-    printf("\n-------------------------------------------------------------------------------\n");
-    PrettyBytes( pInfoSeg, cbIS );
-    printf("\n");
 
-    free( desPPD.stUIList.pBlockList );
-    free( desPPD.stUICList.puicBlockList );
+    pEntries = (PPAK_DEV_DIRENTRY) malloc( cEntries * sizeof( PAK_DEV_DIRENTRY ) + 1 );
+    if ( fV2 ) pulHashes = (PULONG) malloc( cEntries * sizeof( ULONG ) + 1 );
+    if ( !pEntries || ( fV2 && !pulHashes )) {
+        printf("malloc() failed - out of memory?\n");
+        free( pEntries );
+        free( pulHashes );
+        free( pbFile );
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+    if ( fV2 ) {
+        for ( i = 0; i < cEntries; i++ ) {
+            memcpy( pEntries + i, &(view.pIndex[ i ].devV1), sizeof( PAK_DEV_DIRENTRY ));
+            pEntries[ i ].ulOffset = view.pIndex[ i ].ulOffset;
+            pulHashes[ i ]         = view.pIndex[ i ].ulContentHash;
+        }
+    }
+    else
+        memcpy( pEntries, pbFile + sizeof( PAKSIGNATURE ), cEntries * sizeof( PAK_DEV_DIRENTRY ));
+
+    *ppbFile    = pbFile;
+    *pcbFile    = cbFile;
+    *ppEntries  = pEntries;
+    *ppulHashes = pulHashes;
+    *pcEntries  = cEntries;
+    return NO_ERROR;
 }
 
 
 /* ------------------------------------------------------------------------- *
- * OffsetToCommand                                                           *
+ * SuggestPrinters                                                           *
  *                                                                           *
- * Given an offset into the data buffer, convert the compressed command      *
- * string at that address into a normal, readable string.  Any newline chars *
- * will be stripped out in order to improve readability.  The string will be *
- * enclosed in quotes.                                                       *
+ * Follow "printer not found" with the names nearest to the one given.       *
  *                                                                           *
  * PARAMETERS:                                                               *
- *   SHORT sOff: Offset into the data buffer pIn                             *
- *   PBYTE pIn : Pointer to the input data buffer                            *
- *   PBYTE pOut: Pointer to a buffer into which the output string will be    *
- *               written (the buffer is assumed to be large enough)          *
- *                                                                           *
- * RETURNS: PSZ                                                              *
- *   Modified string (same as pOut)                                          *
+ *   PPAKNAMES         pNames  : Name index of the directory                 *
+ *   PPAK_DEV_DIRENTRY pEntries: The directory entries                       *
+ *   PSZ               pszName : The name which was not found                *
  * ------------------------------------------------------------------------- */
-PSZ OffsetToCommand( SHORT sOff, PBYTE pIn, PBYTE pOut )
+void SuggestPrinters( PPAKNAMES pNames, PPAK_DEV_DIRENTRY pEntries, PSZ pszName )
 {
-    PSZ    pszTmp;
-    USHORT usRC;
-
-    if ( !pIn || !pOut || sOff < 1 )
-        strcpy( pOut, "(none)");
-    else {
-        usRC = DecompressString( OFFSET_TO_PSZ( sOff, pIn ), pOut );
-        if ( usRC ) {
-            pszTmp = (PSZ) calloc( usRC + 3, sizeof( char ));
-            if ( pszTmp ) {
-                USHORT i, j;
-
-                sprintf( pszTmp, "\"%s\"", (PSZ) pOut );
-                usRC = strlen( pszTmp );
-                for ( i = 0, j = 0; i < usRC; i++ ) {
-                    if ( pszTmp[ i ] != '\r' && pszTmp[ i ] != '\n')
-                        pOut[ j++ ] = pszTmp[ i ];
-                }
-                pOut[ j ] = 0;
-                free( pszTmp );
-            }
-        }
-        else if ( *((PSZ) pIn + sOff ))
-            strcpy( pOut, (PSZ) pIn + sOff );
-        else
-            strcpy( pOut, "(none)");
-    }
-    return ( pOut );
+    ULONG aulEntries[ NAME_MAX_SUGGEST ],
+          c,
+          i;
+
+    if (( c = PakNameSuggest( pNames, pszName, aulEntries, NAME_MAX_SUGGEST )) == 0 ) return;
+    printf("Did you mean:\n");
+    for ( i = 0; i < c; i++ )
+        printf("  %.40s\n", pEntries[ aulEntries[ i ]].szDeviceName );
 }
 
 
 /* ------------------------------------------------------------------------- *
- * OffsetToProperCommand                                                     *
+ * ResolvePrinter                                                            *
  *                                                                           *
- * Given an offset into the data buffer, convert the compressed command      *
- * string at that address into a normal, readable string.  Any non-ASCII     *
- * characters will be replaced with hex strings.  The string is not quoted.  *
- * Basically, this function is used for the *JCL command strings, which may  *
- * contain odd byte values which won't be handled normally.  It also doesn't *
- * check that the offset is > 0, because for the first three JCL commands,   *
- * the correct offset could well BE 0 (as they appear, if they exist at all, *
- * right at the start of the data segment).                                  *
+ * Turn the printer argument of an action into a printer name (or, for an    *
+ * action which can show many printers, a pattern) which it can use.  A name *
+ * not matching any printer exactly is looked up by PakNameFind(): a unique  *
+ * match is replaced by the full name, and several matches by a pattern      *
+ * selecting them all, or listed if only one printer may be given.  If none  *
+ * match, the nearest names are suggested.  Patterns are checked likewise,   *
+ * but left for the action to match.                                         *
  *                                                                           *
  * PARAMETERS:                                                               *
- *   SHORT sOff: Offset into the data buffer pIn                             *
- *   PBYTE pIn : Pointer to the input data buffer                            *
- *   PBYTE pOut: Pointer to a buffer into which the output string will be    *
- *               written (the buffer is assumed to be large enough)          *
+ *   PSZ   pszPakFile : Name of the PAK file                                 *
+ *   PSZ  *ppszPrinter: The printer argument (may be NULL), replaced by the  *
+ *                      name or pattern to use                               *
+ *   BOOL  fMany      : TRUE if the action accepts a pattern                 *
+ *   PSZ   pszBuffer  : Buffer of RESOLVE_BUFFER bytes for the new argument  *
  *                                                                           *
- * RETURNS: PSZ                                                              *
- *   Modified string (same as pOut)                                          *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, or ERROR_PAK_NO_DEVICE (having reported it) if the        *
+ *   argument selects no printer, or more than one when fMany is FALSE.      *
+ *   Errors reading the file are left to the action to report.               *
  * ------------------------------------------------------------------------- */
-PSZ OffsetToProperCommand( SHORT sOff, PBYTE pIn, PBYTE pOut )
+ULONG ResolvePrinter( PSZ pszPakFile, PSZ *ppszPrinter, BOOL fMany, PSZ pszBuffer )
 {
-    PSZ    pszTmp;
-    USHORT usRC;
-
-    if ( !pIn || !pOut || sOff < 0 )
-        strcpy( pOut, "");
+    PAKSIGNATURE      pak_sig;
+    PPAK_DEV_DIRENTRY pEntries;
+    PPAKNAMES         pNames = NULL;
+    PBYTE             pDir = NULL;
+    PSZ               pszPrinter = *ppszPrinter;
+    CHAR              szQuery[ PAKNAME_MAX_PATTERN + 1 ];
+    ULONG             aulEntries[ NAME_MAX_LIST ],
+                      ulHow,
+                      cFound,
+                      i;
+    APIRET            rc = NO_ERROR;
+
+    if ( !pszPrinter || ( fMany && strcmp( pszPrinter, "*") == 0 )) return NO_ERROR;
+    if ( PakLoadDirectory( NULL, pszPakFile, PAKSIGNATURE_DEVPACK_V1,
+                           sizeof( PAK_DEV_DIRENTRY ), &pDir ) != NO_ERROR )
+        return NO_ERROR;
+    memcpy( &pak_sig, pDir, sizeof( PAKSIGNATURE ));
+    pEntries = (PPAK_DEV_DIRENTRY)( pDir + sizeof( PAKSIGNATURE ));
+    for ( i = 0; i < (ULONG) pak_sig.iEntries; i++ )
+        if ( !strnicmp( pEntries[ i ].szDeviceName, pszPrinter,
+                        sizeof( pEntries[ i ].szDeviceName ))) goto done;
+    if ( PakNameIndex( NULL, pEntries, pak_sig.iEntries, &pNames ) != NO_ERROR ) goto done;
+
+    ulHow = PakNameFind( pNames, pszPrinter, aulEntries, NAME_MAX_LIST, &cFound );
+    if ( ulHow == PAKNAME_NONE ) {
+        printf("The requested printer was not found\n");
+        if ( !strpbrk( pszPrinter, "*?")) SuggestPrinters( pNames, pEntries, pszPrinter );
+        rc = ERROR_PAK_NO_DEVICE;
+    }
+    else if (( ulHow == PAKNAME_EXACT ) || ( cFound == 1 )) {
+        sprintf( pszBuffer, "%.40s", pEntries[ aulEntries[ 0 ]].szDeviceName );
+        *ppszPrinter = pszBuffer;
+    }
+    else if ( fMany ) {
+        // The pattern must select what PakNameFind() did, so it is built from
+        // the query as normalized there (PakNameFind() rejected a longer one)
+        PakNameNormalize( pszPrinter, PAKNAME_MAX_PATTERN, szQuery );
+        if ( ulHow == PAKNAME_PREFIX ) sprintf( pszBuffer, "%s*", szQuery );
+        else if ( ulHow == PAKNAME_SUBSTRING ) sprintf( pszBuffer, "*%s*", szQuery );
+        else strcpy( pszBuffer, szQuery );
+        *ppszPrinter = pszBuffer;
+    }
     else {
-        usRC = DecompressString( (PSZ) pIn+sOff, pOut );
-        if ( usRC ) {
-            pszTmp = (PSZ) calloc( 4 * usRC + 1, sizeof( char ));
-            if ( pszTmp ) {
-                USHORT i, j;
-
-                strcpy( pszTmp, (PSZ) pOut );
-                usRC = strlen( pszTmp );
-                for ( i = 0, j = 0; i < usRC; i++ ) {
-                    if ( pszTmp[ i ] < 32 || pszTmp[ i ] > 127 ) {
-                        sprintf( (PSZ) pOut+j, "<%02X>", pszTmp[ i ] );
-                        j+= 4;
-                    }
-                    else pOut[ j++ ] = pszTmp[ i ];
-                }
-                pOut[ j ] = 0;
-                free( pszTmp );
-            }
-        }
-        else if ( *((PSZ) pIn + sOff ))
-            strcpy( pOut, (PSZ) pIn + sOff );
-        else
-            strcpy( pOut, "");
+        printf("\"%s\" matches %lu printers:\n", pszPrinter, cFound );
+        for ( i = 0; i < cFound && i < NAME_MAX_LIST; i++ )
+            printf("  %.40s\n", pEntries[ aulEntries[ i ]].szDeviceName );
+        if ( cFound > NAME_MAX_LIST ) printf("  ...\n");
+        rc = ERROR_PAK_NO_DEVICE;
     }
-    return ( pOut );
+
+done:
+    PakNameFree( NULL, pNames );
+    PakFree( NULL, pDir );
+    return rc;
 }
 
 
 /* ------------------------------------------------------------------------- */
-void ShowReadableData( PAK_DEV_DIRENTRY pdd, PBYTE pBuf )
+ULONG ListPrinters( PSZ pszPakFile )
 {
-    DESPPD     desPPD = {0};
-    PBYTE      pInfoSeg,
-               pScratch;
-    PUI_BLOCK  puib;
-    PUIC_BLOCK puicb;
-    ULONG      ulCB;
-    USHORT     i, j;
-    PSHORT     psVal;
-    PLONG      plVal;
-    SHORT      sIdx, sPDX, sPDY;
-    PSZ        psz;
-
-
-    ulCB = sizeof( DESPPD );
-    memcpy( (PBYTE) &desPPD, pBuf, ulCB );
-    pInfoSeg = pBuf + ulCB;
-
-    // Allocate and copy the dynamic data items in DESPPD
-    ulCB = desPPD.stUIList.usBlockListSize;
-    desPPD.stUIList.pBlockList = (PUI_BLOCK) malloc( ulCB );
-    memcpy( desPPD.stUIList.pBlockList, (PUI_BLOCK) pInfoSeg, ulCB );
-    pInfoSeg += ulCB;
-
-    ulCB = desPPD.stUICList.usNumOfUICs * sizeof( UIC_BLOCK );
-    desPPD.stUICList.puicBlockList = (PUIC_BLOCK) malloc( ulCB );
-    memcpy( desPPD.stUICList.puicBlockList, (PUIC_BLOCK) pInfoSeg, ulCB );
-    pInfoSeg += ulCB;
-    desPPD.pPSStringBuff = pInfoSeg;
-
-    // Create a scratch buffer for decompressing strings
-    pScratch = (PBYTE) calloc( desPPD.desItems.iSizeBuffer, 1 );
-
-    // Print header
-    printf("==============================================================================\n");
-    printf("PRINTER PAK ENTRY  -  \"%s\"\n", pdd.szDeviceName );
-    printf("==============================================================================\n");
-
-    printf("\nBasic Data\n----------\n");
-    printf("Language level:                      %d\n", desPPD.desItems.usLanguageLevel );
-    printf("Password:                            %s\n", OFFSET_TO_PSZ( desPPD.desItems.ofsPswrd, pInfoSeg ));
-    printf("PPM:                                 %d\n", desPPD.desItems.iPpm );
-    printf("FreeVM:                              %d\n", desPPD.desItems.lFreeVM );
-    // AFAIK desPPD.desItems.ofsPrType is not used, but show it anyway
-    printf("Printer type:                        %s\n", OFFSET_TO_PSZ( desPPD.desItems.ofsPrType, pInfoSeg ));
-    printf("Printer name:                        %s\n", (PSZ)( pInfoSeg + desPPD.desItems.ofsPrName ));
-    printf("ColorDevice:                         %d\n", desPPD.desItems.fIsColorDevice );
-    printf("FileSystem:                          %d\n", desPPD.desItems.fIsFileSystem );
-    printf("PC Filename:                         %s\n", (desPPD.desItems.ofsPCFileName >= 0) ?
-                                                        (PSZ)( pInfoSeg + desPPD.desItems.ofsPCFileName ) :
-                                                        "(none)");
-    printf("Default DPI:                         %d\n", desPPD.desItems.iResDpi );
-#if PSDRIVER == 1
-    printf("TrueType font support:               %d\n", desPPD.desItems.fTTSupport );
-#endif
-
-    // I don't think the following are actually used; the available resolutions
-    // are apparently defined only as UIOption items.
-    if ( desPPD.desItems.ResList.uNumOfRes ) {
-        if ( desPPD.desItems.ResList.bIsJCLResolution )
-            printf("Defined JCL resolutions (%d)\n", desPPD.desItems.ResList.uNumOfRes );
-        else
-            printf("Defined resolutions (%d)\n", desPPD.desItems.ResList.uNumOfRes );
-        if ( desPPD.desItems.ResList.uResOffset > 0 ) {
-            psVal = (PSHORT)((PBYTE)(pInfoSeg + desPPD.desItems.ResList.uResOffset));
-            for ( i = 0; i < desPPD.desItems.ResList.uNumOfRes; i++ ) {
-                printf(" - %d\n", *psVal );
-                psVal++;
-            }
-        }
-    }
-
-    printf("ScreenAngle:                         %d\n", desPPD.desItems.iScreenAngle );
-    printf("ScreenFreq:                          %d\n", desPPD.desItems.lScrFreq );
-    printf("Reset command:                       %s\n", OFFSET_TO_PSZ( desPPD.desItems.ofsReset, pInfoSeg ));
-    printf("ExitServer command:                  %s\n", OffsetToCommand( desPPD.desItems.ofsExitserver, pInfoSeg, pScratch ));
-    printf("Transfer Normalized command:         %s\n", OffsetToCommand( desPPD.desItems.ofsTransferNor, pInfoSeg, pScratch ));
-    printf("Transfer Normalized.Inverse command: %s\n", OffsetToCommand( desPPD.desItems.ofsTransferInv, pInfoSeg, pScratch ));
-    psz = OffsetToProperCommand( desPPD.desItems.ofsInitString, pInfoSeg, pScratch );
-    printf("JCLBegin/InitPostScriptMode command: %s\n", strlen(psz)? psz: "(none)");
-    psz = OffsetToProperCommand( desPPD.desItems.ofsJCLToPS, pInfoSeg, pScratch );
-    printf("JCLToPSInterpreter command:          %s\n", strlen(psz)? psz: "(none)");
-    psz = OffsetToProperCommand( desPPD.desItems.ofsTermString, pInfoSeg, pScratch );
-    printf("JCLEnd/TermPostScriptMode command:   %s\n", strlen(psz)? psz: "(none)");
-
-    printf("\nPage Properties\n---------------\n");
-    // Several of these appear to be deprecated in favour of UI items and are
-    // unused:
-    //   desPage.iCmpgpairs
-    //   desPage.ofsLspgCmnds
-    //   printf("Default page size:                   %s\n", OFFSET_TO_PSZ( desPPD.desPage.ofsDfpgsz, pInfoSeg ));
-    //   printf("Default imageable area:              %s\n", OFFSET_TO_PSZ( desPPD.desPage.ofsDefimagearea, pInfoSeg ));
-    //   printf("Default paper dimensions:            %s\n", OFFSET_TO_PSZ( desPPD.desPage.ofsDefpaperdim, pInfoSeg ));
-    printf("Variable paper:                      %d\n", desPPD.desPage.fIsVariablePaper );
-    printf("Paper dimension pairs:               %d\n", desPPD.desPage.iDmpgpairs );
-    psVal = (PSHORT)( pInfoSeg + desPPD.desPage.ofsDimxyPgsz );
-    for ( i = 0; i < desPPD.desPage.iDmpgpairs; i++ ) {
-        sIdx = (SHORT) *psVal;
-        psVal++;
-        sPDX = (SHORT) *psVal;
-        psVal++;
-        sPDY = (SHORT) *psVal;
-        psVal++;
-        printf("  %2d - %4d %4d\n", sIdx, sPDX, sPDY );
-    }
-    printf("Imageable coordinate pairs: %d\n", desPPD.desPage.iImgpgpairs );
-    psVal = (PSHORT)( pInfoSeg + desPPD.desPage.ofsImgblPgsz );
-    for ( i = 0; i < desPPD.desPage.iImgpgpairs; i++ ) {
-        sIdx = (SHORT) *psVal;
-        psVal++;
-        sPDX = (SHORT) *psVal;
-        psVal++;
-        sPDY = (SHORT) *psVal;
-        psVal++;
-        printf("  %2d - %4d %4d ", sIdx, sPDX, sPDY );
-        sPDX = (SHORT) *psVal;
-        psVal++;
-        sPDY = (SHORT) *psVal;
-        psVal++;
-        psz = (PSZ) psVal;
-        printf("%4d %4d  (%s)\n", sPDX, sPDY, psz );
-        psVal = (PSHORT) ((PSZ)( psz + strlen( psz ) + 1 ));
-    }
-    printf("Custom Page Size command:            %s\n", OffsetToCommand( desPPD.desPage.ofsCustomPageSize, pInfoSeg, pScratch ));
-    printf("Custom Page min width:               %d\n", desPPD.desPage.iCustomPageSizeMinWidth );
-    printf("Custom Page max width:               %d\n", desPPD.desPage.iCustomPageSizeMaxWidth );
-    printf("Custom Page min height:              %d\n", desPPD.desPage.iCustomPageSizeMinHeight );
-    printf("Custom Page max height:              %d\n", desPPD.desPage.iCustomPageSizeMaxHeight );
-
-    printf("\nInput Trays\n-----------\n");
-    // None of these items actually seem to be used or set anywhere; they
-    // are presumably deprecated, as input slots are defined as UI items
-    // (under desPPD.stUIList) in practice.
-    printf("Manual Feed:                         %d\n", desPPD.desInpbins.iManualfeed );
-    printf("Manual Feed set command:             %s\n", OffsetToCommand( desPPD.desInpbins.ofsManualtrue, pInfoSeg, pScratch ));
-    printf("Manual Feed unset disable:           %s\n", OffsetToCommand( desPPD.desInpbins.ofsManualfalse, pInfoSeg, pScratch ));
-    printf("Default input tray:                  %s\n", OFFSET_TO_PSZ( desPPD.desInpbins.ofsDefinputslot, pInfoSeg ));
-    printf("Input tray pairs:                    %d\n", desPPD.desInpbins.iInpbinpairs );
-    printf("Input tray paper sizes:              %d\n", desPPD.desInpbins.iNumOfPageSizes );
-    // No need to even try to handle desPPD.desInpbins.ofsCmInpbins or
-    // desPPD.desInpbins.ofsPageSizes -- they are deprecated and no longer used
-
-    printf("\nOutput Trays\n------------\n");
-    printf("Default output order:                %s\n", ( desPPD.desOutbins.fIsDefoutorder? "Reverse": "Normal" ));
-    printf("Normal Output command:               %s\n", OffsetToCommand( desPPD.desOutbins.ofsOrdernormal, pInfoSeg, pScratch ));
-    printf("Reverse Output command:              %s\n", OffsetToCommand( desPPD.desOutbins.ofsOrderreverse, pInfoSeg, pScratch ));
-    printf("Default output tray:                 %s\n", OFFSET_TO_PSZ( desPPD.desOutbins.ofsDefoutputbin, pInfoSeg )); // not used?
-    printf("Output tray pairs:                   %d\n", desPPD.desOutbins.iOutbinpairs );
-    // desPPD.desOutbins.ofsCmOutbins is not used or set anywhere, so ignore it
-
-    printf("\nFonts\n-----\n");
-    printf("Default font:                        %s\n", OFFSET_TO_PSZ( desPPD.desFonts.ofsDeffont, pInfoSeg ));
-    printf("Supported hardware fonts:            %d\n", desPPD.desFonts.iFonts );
-    psz = OFFSET_TO_PSZ( desPPD.desFonts.ofsFontnames, pInfoSeg );
-    for ( i = 0; (i < desPPD.desFonts.iFonts) && *psz; i++ ) {
-        printf("  - %s\n", psz );
-        psz += strlen( psz ) + 1;
-    }
-
-    printf("\nForms\n-----\n");
-    // Not entirely sure these are used at all either
-    printf("Number of forms:                     %d\n", desPPD.desForms.usFormCount );
-    if ( desPPD.desForms.usFormCount ) {
-        plVal = (PLONG)(pInfoSeg + desPPD.desForms.ofsFormIndex);
-        for ( i = 0; (i < desPPD.desForms.usFormCount) && *psz; i++ ) {
-            printf("  - %s\n", OffsetToCommand( (SHORT) *plVal, pInfoSeg, pScratch ));
-            plVal++;
+    SHORT             i;
+    PAKSIGNATURE      pak_sig;
+    PPAK_DEV_DIRENTRY pak_dev;
+    PBYTE             pDir;
+    APIRET            rc;
+
+    rc = PakLoadDirectory( NULL, pszPakFile, PAKSIGNATURE_DEVPACK_V1,
+                           sizeof( PAK_DEV_DIRENTRY ), &pDir );
+    if ( rc == ERROR_INVALID_DATA ) {
+        printf("Invalid PAK file signature!\n");
+        if ( !PakReadSignature( pszPakFile, &pak_sig ) &&
+             !strncmp( pak_sig.szName, PAKSIGNATURE_DEVPACK_V1, 9 ))
+        {
+            printf(" - Expected signature: %s\n", PAKSIGNATURE_DEVPACK_V1 );
+            printf(" - Found signature:    %s\n", pak_sig.szName );
+            printf("This PAK file seems to have been created for a different printer driver.\n");
         }
+        return rc;
     }
-
-    printf("\n\nUser Interface Items\n--------------------\n");
-    printf("Total size of UI list:               %d\n", desPPD.stUIList.usBlockListSize );
-    printf("Number of UI items:                  %d\n", desPPD.stUIList.usNumOfBlocks );
-    puib = desPPD.stUIList.pBlockList;
-    for ( i = 0; puib && desPPD.stUIList.usBlockListSize && i < desPPD.stUIList.usNumOfBlocks; i++ ) {
-        printf("\n* \"%s\"  (%d)\n", OFFSET_TO_PSZ( puib->ofsUIName, pInfoSeg ), i );
-        printf("   Translation string:               \"%s\"\n", OFFSET_TO_PSZ( puib->ofsUITransString, pInfoSeg ));
-        printf("   Order index value:                %d\n", puib->usOrderDep );
-        printf("   Display order:                    %d\n", puib->usDisplayOrder );
-        printf("   Location:                         ");
-        switch( puib->usUILocation ) {
-            case UI_ORDER_ANYSETUP   : printf("Any\n");        break;
-            case UI_ORDER_JCLSETUP   : printf("JCL\n");        break;
-            case UI_ORDER_PAGESETUP  : printf("Page\n");       break;
-            case UI_ORDER_DOCSETUP   : printf("Document\n");   break;
-            case UI_ORDER_PROLOGSETUP: printf("Prolog\n");     break;
-            case UI_ORDER_EXITSERVER : printf("ExitServer\n"); break;
-            default                  : printf("Unknown\n");    break;
-        }
-        printf("   UI selection type:                ");
-        switch( puib->usSelectType ) {
-            case UI_SELECT_BOOLEAN : printf("Boolean\n");  break;
-            case UI_SELECT_PICKMANY: printf("PickMany\n"); break;
-            case UI_SELECT_PICKONE : printf("PickOne\n");  break;
-            default                : printf("Unknown\n");  break;
-        }
-        printf("   Scope:                            %s\n",
-                ( puib->ucGroupType == UIGT_INSTALLABLEOPTION ) ? "Printer property": "Job property");
-        printf("   Panel ID:                         ");
-        switch ( puib->ucPanelID ) {
-            case UIP_OS2_FEATURE   : printf("IBM\n");  break;
-            case UIP_OEM_FEATURE   : printf("OEM\n");  break;
-            case UIP_PREDEF_FEATURE: printf("Predefined\n");  break;
-            default                : printf("Unknown\n");  break;
-        }
-        printf("   Default value:                    %d\n", puib->usDefaultEntry );
-        printf("   Number of values:                 %d\n", puib->usNumOfEntries );
-        if ( puib->usNumOfEntries ) {
-            for ( j = 0; j < puib->usNumOfEntries; j++ ) {
-                printf("   - Name:                           \"%s\"  (%d)\n", OFFSET_TO_PSZ( puib->uiEntry[j].ofsOption, pInfoSeg ), j );
-                printf("     Translation:                    \"%s\"\n", OFFSET_TO_PSZ( puib->uiEntry[j].ofsTransString, pInfoSeg ));
-                printf("     Value:                          %s\n", OffsetToCommand( puib->uiEntry[j].ofsValue, pInfoSeg, pScratch ));
-            }
-        }
-        INCREMENT_BLOCK_PTR( puib );
+    else if ( rc == ERROR_HANDLE_EOF ) return NO_ERROR;
+    else if ( rc ) {
+        ReportOpenError( rc );
+        return rc;
     }
 
-    printf("\n\nUser Interface Constraints\n--------------------------\n");
-    printf("Number of mutually exlusive item sets: %d\n", desPPD.stUICList.usNumOfUICs );
-    puicb = desPPD.stUICList.puicBlockList;
-    for ( i = 0; puicb && i < desPPD.stUICList.usNumOfUICs; i++ ) {
-
-        /*
-        ** Despite the name, the "ofsUIBlock" values are not pointer offsets;
-        ** rather, they are the index of the corresponding UI_LIST item in
-        ** "stUIList.pBlockList".  "bOption" is a bitmap flagging the affected
-        ** values (that is, items in the item's uiEntry[] array).  e.g.
-        **      ofsUIBlock = 2
-        **      bOption    = 13  (binary 1101)
-        ** indicates the 1st, 3rd, and 4th values of the third UI item.
-        */
-        puib = desPPD.stUIList.pBlockList;
-        for ( j = 0; j < puicb->uicEntry1.ofsUIBlock; j++ )
-            INCREMENT_BLOCK_PTR( puib );
-        printf(" - (%s", OFFSET_TO_PSZ( puib->ofsUIName, pInfoSeg ));
-        if ( puicb->uicEntry1.bOption ) {
-            printf(" ==");
-            for ( j = 0; j < 32 && j < puib->usNumOfEntries; j++ ) {
-                if (( puicb->uicEntry1.bOption >> j ) & 1 )
-                    printf(" %s", OFFSET_TO_PSZ( puib->uiEntry[j].ofsOption, pInfoSeg ));
-            }
-        }
-        printf(") with ");
-
-        puib = desPPD.stUIList.pBlockList;
-        for ( j = 0; j < puicb->uicEntry2.ofsUIBlock; j++ )
-            INCREMENT_BLOCK_PTR( puib );
-        printf("(%s", OFFSET_TO_PSZ( puib->ofsUIName, pInfoSeg ));
-        if ( puicb->uicEntry2.bOption ) {
-            printf(" ==");
-            for ( j = 0; j < 32 && j < puib->usNumOfEntries; j++ ) {
-                if (( puicb->uicEntry2.bOption >> j ) & 1 )
-                    printf(" %s", OFFSET_TO_PSZ( puib->uiEntry[j].ofsOption, pInfoSeg ));
-            }
-        }
-        printf(")\n");
+    memcpy( &pak_sig, pDir, sizeof( PAKSIGNATURE ));
+    printf("%s\n==============\n", pak_sig.szName );
+    printf("%d printers defined:\n", pak_sig.iEntries );
 
-        puicb++;
+    pak_dev = (PPAK_DEV_DIRENTRY)( pDir + sizeof( PAKSIGNATURE ));
+    for ( i = 0; i < pak_sig.iEntries; i++, pak_dev++ ) {
+        printf(" - %s (offset 0x%X, %u bytes, flags=0x%X)\n",
+                pak_dev->szDeviceName, pak_dev->ulOffset, pak_dev->ulSize, pak_dev->ulFlags );
     }
 
-    free( desPPD.stUIList.pBlockList );
-    free( desPPD.stUICList.puicBlockList );
-    free( pScratch );
+    PakFree( NULL, pDir );
+    return rc;
 }
 
 
 /* ------------------------------------------------------------------------- *
- * PrintToPPD                                                                *
- *                                                                           *
- * Print a parameter/string value pair, formatted for PPD output.            *
- *                                                                           *
- * PARAMETERS:                                                               *
- *   PSZ pszName   : Name of the parameter as it will appear in the PPD      *
- *                   (must start with * and include a trailing colon)        *
- *   SHORT usOffset: Offset of the string value within the buffer            *
- *   PBYTE pBuf    : Data buffer from the PAK file                           *
- *   PSZ pszDefault: Default value in case there is no value defined in the  *
- *                   buffer; specify NULL to omit the parameter entirely in  *
- *                   such a case                                             *
+ * FormatEntry                                                               *
  *                                                                           *
- * RETURNS: N/A                                                              *
+ * Pipeline format function for ShowPrinterData( "*" ).  The formatted views *
+ * are given only segments which pass PakCheckDevice(); the dumps are given  *
+ * any segment.  Returns 1 for a damaged printer, otherwise 0.               *
  * ------------------------------------------------------------------------- */
-void PrintToPPD( PSZ pszName, SHORT usOffset, PBYTE pBuf, PSZ pszDefault )
+static ULONG FormatEntry( PVOID pUser, PPAK_DEV_DIRENTRY pEntry, PBYTE pbSegment,
+                          PPAKARENA pArena, POUTBUF pOut )
 {
-    if ( usOffset < 1 ) {
-        if ( pszDefault ) printf("%-23s \"%s\"\n", pszName, pszDefault );
-    }
-    else
-        printf("%-23s \"%s\"\n", pszName, OFFSET_TO_PSZ( usOffset, pBuf ));
+    USHORT fsMode = *((PUSHORT) pUser );
 
-    return;
+    if ( !pbSegment ) {
+        OutPrintf( pOut, "%.40s: (segment lies outside the file)\n", pEntry->szDeviceName );
+        return 1;
+    }
+    if (( fsMode == DEV_FMT_DATA || fsMode == DEV_TXT_DATA || fsMode == DEV_PPD_DATA ) &&
+        PakCheckDevice( pEntry, pbSegment, pArena, pOut ))
+    {
+        // Replace the problem report with a note
+        pOut->cbData = 0;
+        OutPrintf( pOut, "%.40s: (damaged; use CHECK for details)\n", pEntry->szDeviceName );
+        return 1;
+    }
+    pOut->cbData = 0;
+    ArenaReset( pArena, 0 );
+    FormatPakDevice( pEntry, pbSegment, fsMode, pArena, pOut );
+    return 0;
 }
 
 
 /* ------------------------------------------------------------------------- */
-void GeneratePPD( PBYTE pBuf )
+ULONG ShowPrinterData( PSZ pszPakFile, PSZ pszPrinter, USHORT fsMode, PPAKDICT pDict )
 {
-    DESPPD     desPPD = {0};        // structure of main descriptor segment
-    PBYTE      pInfoSeg,            // pointer to free-form information segment
-               pScratch;            // work buffer, mostly for decompressing commands
-    PUI_BLOCK  puib,                // pointer to a UI block
-               puiPaper;            // pointer to the PageSize UI block
-    PUIC_BLOCK puicb;               // pointer to a UI constraints block
-    ULONG      ulCB;
-    USHORT     usRC,
-               i, j, k;
-    PSHORT     psVal;
-    PLONG      plVal;
-    SHORT      sIdx,                // form index cross-reference
-               sX1, sY1, sX2, sY2;  // area coordinates
-    PSZ        psz,                 // general-purpose string pointer
-               pszName,             // current UI item or form name
-               pszXlate,            // current UI item or form translation name
-               pszDefault,          // current UI item default
-               pszDefPage;          // name of default PageSize
-
-
-    // Copy the buffer contents into our data structure
-    ulCB = sizeof( DESPPD );
-    memcpy( (PBYTE) &desPPD, pBuf, ulCB );
-    pInfoSeg = pBuf + ulCB;
-
-    // Allocate and copy the dynamic data items in DESPPD
-    ulCB = desPPD.stUIList.usBlockListSize;
-    desPPD.stUIList.pBlockList = (PUI_BLOCK) malloc( ulCB );
-    memcpy( desPPD.stUIList.pBlockList, (PUI_BLOCK) pInfoSeg, ulCB );
-    pInfoSeg += ulCB;
-
-    ulCB = desPPD.stUICList.usNumOfUICs * sizeof( UIC_BLOCK );
-    desPPD.stUICList.puicBlockList = (PUIC_BLOCK) malloc( ulCB );
-    memcpy( desPPD.stUICList.puicBlockList, (PUIC_BLOCK) pInfoSeg, ulCB );
-    pInfoSeg += ulCB;
-    desPPD.pPSStringBuff = pInfoSeg;
-
-    // Create a scratch buffer for decompressing strings
-    pScratch = (PBYTE) calloc( desPPD.desItems.iSizeBuffer, 1 );
-
-    //
-    // Required headers
-    //
-    printf("*PPD-Adobe:             \"4.3\"\n");
-    printf("*FormatVersion:         \"4.3\"\n");
-    printf("*FileVersion:           \"1.0\"\n");
-    printf("*LanguageVersion:       English\n");
-    printf("*LanguageEncoding:      OS2-850\n");
-    printf("*Manufacturer:          \"Autogenerated by pakfile utility\"\n");
-
-    //
-    // Identification & version parameters
-    //
-    printf("*Product:               \"(%s)\"\n", (PSZ)( pInfoSeg + desPPD.desItems.ofsPrName ));
-    printf("*ModelName:             \"%s\"\n",   (PSZ)( pInfoSeg + desPPD.desItems.ofsPrName ));
-    printf("*ShortNickName:         \"%s\"\n",   (PSZ)( pInfoSeg + desPPD.desItems.ofsPrName ));
-    printf("*NickName:              \"%s\"\n",   (PSZ)( pInfoSeg + desPPD.desItems.ofsPrName ));
-    printf("*PCFileName:            \"%s\"\n", (desPPD.desItems.ofsPCFileName >= 0) ?
-                                               (PSZ)( pInfoSeg + desPPD.desItems.ofsPCFileName ) :
-                                               "PRINTER.PPD");
-    printf("*PSVersion:             \"(%d) 001\"\n", ((desPPD.desItems.usLanguageLevel < 2) ? 0 :
-                                                      (desPPD.desItems.usLanguageLevel * 1000)) + 10 );
-    printf("*Languagelevel:         \"%d\"\n", desPPD.desItems.usLanguageLevel );
-
-    //
-    // Basic capabilities
-    //
-    printf("*ColorDevice:           %s\n", (desPPD.desItems.fIsColorDevice == 1) ? "True": "False");
-    printf("*FileSystem:            %s\n", (desPPD.desItems.fIsFileSystem == 1)  ? "True": "False");
-#if PSDRIVER == 1
-    if ( desPPD.desItems.fTTSupport == 1 )
-        printf("*TTRasterizer:          Type42\n");
-#endif
-    if ( desPPD.desItems.iPpm > 0 )
-        printf("*Throughput:            \"%d\"\n", desPPD.desItems.iPpm );
-    if ( desPPD.desItems.lFreeVM > 0 )
-        printf("*FreeVM:                \"%d\"\n", desPPD.desItems.lFreeVM );
-
-    PrintToPPD("*Password:", desPPD.desItems.ofsPswrd, pInfoSeg, NULL );
-    if (( desPPD.desItems.ofsReset > 0 ) &&
-        ( DecompressString( OFFSET_TO_PSZ( desPPD.desItems.ofsReset, pInfoSeg ), pScratch ) > 0 ))
-    {
-        printf("*Reset:                 \"%s\"\n", pScratch );
-    }
-    if (( desPPD.desItems.ofsExitserver > 0 ) &&
-        ( DecompressString( OFFSET_TO_PSZ( desPPD.desItems.ofsExitserver, pInfoSeg), pScratch ) > 0 ))
-    {
-        printf("*ExitServer:            \"%s\"\n", pScratch );
+    PAKARENA arena = {0};
+    PSZ      pszCache,
+             pszLimit;
+    ULONG    cDamaged,
+             ulLimit;
+    APIRET   rc;
+
+    // Many printers go through the pipeline, so as to come out in directory order
+    if ( pszPrinter && strpbrk( pszPrinter, "*?")) {
+        rc = RunPipeline( pszPakFile, strcmp( pszPrinter, "*") ? pszPrinter : NULL, pDict,
+                          FormatEntry, &fsMode, &cDamaged, NULL, NULL );
+        return ( !rc && cDamaged ) ? ERROR_INVALID_DATA : rc;
     }
-    if ( desPPD.desItems.ofsInitString >= 0 )
-        printf("*JCLBegin:              \"%s\"\n",
-                OffsetToProperCommand( desPPD.desItems.ofsInitString, pInfoSeg, pScratch ));
-    if ( desPPD.desItems.ofsJCLToPS >= 0 )
-        printf("*JCLToPSInterpreter:    \"%s\"\n",
-                OffsetToProperCommand( desPPD.desItems.ofsJCLToPS, pInfoSeg, pScratch ));
-    if ( desPPD.desItems.ofsTermString >= 0 )
-        printf("*JCLEnd:                \"%s\"\n",
-                OffsetToProperCommand( desPPD.desItems.ofsTermString, pInfoSeg, pScratch ));
-
-    //
-    // Halftone options
-    //
-    if ( desPPD.desItems.iScreenAngle > 0 )
-        printf("*ScreenAngle:           \"%.2f\"\n", desPPD.desItems.iScreenAngle / 100.0 );
-    if ( desPPD.desItems.lScrFreq > 0 )
-        printf("*ScreenFreq:            \"%.2f\"\n", desPPD.desItems.lScrFreq / 100.0 );
-    if (( desPPD.desItems.ofsTransferNor > 0 ) &&
-        ( DecompressString( OFFSET_TO_PSZ( desPPD.desItems.ofsTransferNor, pInfoSeg ), pScratch ) > 0 ))
-    {
-        printf("*Transfer Normalized:   \"%s\"\n", pScratch );
-    }
-    if (( desPPD.desItems.ofsTransferInv > 0 ) &&
-        ( DecompressString( OFFSET_TO_PSZ( desPPD.desItems.ofsTransferInv, pInfoSeg ), pScratch ) > 0 ))
-    {
-        printf("*Transfer Normalized.Inverse: \"%s\"\n", pScratch );
-    }
-    printf("\n");
-
-    //
-    // Page & media handling
-    //
-
-    /*
-    ** Find the PageSize UI block (every valid PPD should have one) and save a
-    ** pointer to it.  We'll need it at various points from here on down.
-    */
-    puiPaper = NULL;
-    puib = desPPD.stUIList.pBlockList;
-    for ( i = 0; !puiPaper && i < desPPD.stUIList.usBlockListSize; i++ ) {
-        psz = OFFSET_TO_PSZ( puib->ofsUIName, pInfoSeg );
-        if ( !strcmp( psz, "PageSize"))
-            puiPaper = puib;
-        INCREMENT_BLOCK_PTR( puib );
-    }
-    // Make note of the default value; this indicates the default paper size
-    if ( puiPaper && ( puiPaper->usNumOfEntries > puiPaper->usDefaultEntry ))
-        pszDefPage = OFFSET_TO_PSZ( puiPaper->uiEntry[puiPaper->usDefaultEntry].ofsOption, pInfoSeg );
-    else
-        pszDefPage = "Letter";
-
-    printf("*VariablePaperSize:     %s\n", (desPPD.desPage.fIsVariablePaper == 1) ? "True" : "False");
-
-    /*
-    ** The paper commands from desPage, plus everything in desInpbins, are
-    ** basically deprecated; these are all defined as UI items these days.
-    ** So we don't need to handle them (PIN doesn't write any of it into the
-    ** PAK file anyway).
-    ** The same goes for almost everything in desOutbins, but the following
-    ** do appear to be used to some extent.
-    */
-    printf("*DefaultOutputOrder:    %s\n", (desPPD.desOutbins.fIsDefoutorder == REVERSE)? "Reverse": "Normal");
-    if (( desPPD.desOutbins.ofsOrdernormal > 0 ) &&
-        ( DecompressString( OFFSET_TO_PSZ( desPPD.desOutbins.ofsOrdernormal, pInfoSeg ), pScratch ) > 0 ))
-    {
-        printf("*OutputOrder Normal:  \"%s\"\n", pScratch );
-    }
-    if (( desPPD.desOutbins.ofsOrderreverse > 0 ) &&
-        ( DecompressString( OFFSET_TO_PSZ( desPPD.desOutbins.ofsOrderreverse, pInfoSeg ), pScratch ) > 0 ))
+
+    // PPD, readable and JSON output may come from the render cache, unless
+    // a dictionary other than the built-in one would change it
+    pszCache = getenv( CACHE_ENV_VAR );
+    if ( pszCache && *pszCache && !pDict &&
+         ( fsMode == DEV_PPD_DATA || fsMode == DEV_TXT_DATA || fsMode == DEV_JSON_DATA ))
     {
-        printf("*OutputOrder Reverse: \"%s\"\n", pScratch );
+        pszLimit = getenv( CACHE_SIZE_ENV_VAR );
+        ulLimit  = ( pszLimit && *pszLimit ) ? strtoul( pszLimit, NULL, 10 ) : CACHE_DEFAULT_KB;
+        rc = CachedPrinterData( pszCache, ulLimit * 1024, pszPakFile, pszPrinter, fsMode );
     }
-    // It's somewhat less clear, but desForms also seems to be unused nowadays.
-    printf("\n");
-
-    // desPage.ofsDefimagearea is unused; use pszDefPage instead
-    printf("*DefaultImageableArea: %s\n", pszDefPage );
-    psVal = (PSHORT)( pInfoSeg + desPPD.desPage.ofsImgblPgsz );
-    for ( i = 0; i < desPPD.desPage.iImgpgpairs; i++ ) {
-        pszName = NULL;
-        sIdx = (SHORT) *psVal;
-        psVal++;
-        sX1 = (SHORT) *psVal;       // lower left X
-        psVal++;
-        sY1 = (SHORT) *psVal;       // lower left Y
-        psVal++;
-        sX2 = (SHORT) *psVal;       // upper right X
-        psVal++;
-        sY2 = (SHORT) *psVal;       // upper right Y
-        psVal++;
-        pszXlate = (PSZ) psVal;     // translation string (if any)
-
-        // Get the actual form name from the *PageSize UI list
-        if ( puiPaper && ( puiPaper->usNumOfEntries > puiPaper->usDefaultEntry )) {
-            pszName = OFFSET_TO_PSZ( puiPaper->uiEntry[sIdx].ofsOption, pInfoSeg );
-            printf("*ImageableArea %s/%s: \"%d %d %d %d\"\n", pszName,
-                    (*pszXlate? pszXlate: pszName), sX1, sY1, sX2, sY2 );
-        }
-        psVal = (PSHORT) ((PSZ)( pszXlate + strlen( pszXlate ) + 1 ));
+    else {
+        arena.pDict = pDict;
+        rc = RenderPakDevice( NULL, &arena, pszPakFile, pszPrinter, fsMode, NULL );
+        ArenaFree( &arena );
     }
-    printf("\n");
-
-    // desPage.ofsDefpaperdim is also unused; again, use pszDefPage
-    printf("*DefaultPaperDimension: %s\n", pszDefPage );
-    psVal = (PSHORT)( pInfoSeg + desPPD.desPage.ofsDimxyPgsz );
-    for ( i = 0; i < desPPD.desPage.iDmpgpairs; i++ ) {
-        pszName = NULL;
-        sIdx = (SHORT) *psVal;
-        psVal++;
-        sX1 = (SHORT) *psVal;
-        psVal++;
-        sY1 = (SHORT) *psVal;
-        psVal++;
-
-        // Get the form name from the *PageSize UI list
-        if ( puiPaper && ( puiPaper->usNumOfEntries > puiPaper->usDefaultEntry )) {
-            pszName = OFFSET_TO_PSZ( puiPaper->uiEntry[sIdx].ofsOption, pInfoSeg );
-            pszXlate = ( puiPaper->uiEntry[sIdx].ofsTransString > 0 ) ?
-                         OFFSET_TO_PSZ( puiPaper->uiEntry[sIdx].ofsTransString, pInfoSeg ) :
-                         pszName;
-            printf("*PaperDimension %s/%s: \"%d %d\"\n", pszName, pszXlate, sX1, sY1 );
-        }
+    switch ( rc ) {
+        case NO_ERROR:
+            break;
+        case ERROR_PAK_NO_DEVICE:
+            printf("The requested printer was not found\n");
+            rc = NO_ERROR;
+            break;
+        case ERROR_INVALID_DATA:
+            printf("Invalid PAK file signature!\n");
+            break;
+        case ERROR_NOT_ENOUGH_MEMORY:
+            printf("malloc() failed - out of memory?\n");
+            rc = NO_ERROR;
+            break;
+        case ERROR_HANDLE_EOF:
+            printf("Error reading device data.\n");
+            rc = NO_ERROR;
+            break;
+        default:
+            ReportOpenError( rc );
+            break;
     }
-    printf("\n");
+    return rc;
+}
 
-    if (( desPPD.desPage.ofsCustomPageSize > 0 ) &&
-        ( DecompressString( OFFSET_TO_PSZ( desPPD.desPage.ofsCustomPageSize, pInfoSeg ), pScratch ) > 0 ))
-    {
-        printf("*CustomPageSize True: \"%s\"\n", pScratch );
-        /*
-        ** We have to hardcode the order because the PAK file doesn't contain
-        ** that information.  It's missing a couple of supposedly-required
-        ** parameters as well, but there's nothing we can do about that either.
-        ** Anyway, if they're not in the PAK file, the PS driver obviously
-        ** doesn't need/use them in any case.
-        */
-        printf("*ParamCustomPageSize Width: 1 points %d %d\n",
-                desPPD.desPage.iCustomPageSizeMinWidth,
-                desPPD.desPage.iCustomPageSizeMaxWidth );
-        printf("*ParamCustomPageSize Height: 2 points %d %d\n",
-                desPPD.desPage.iCustomPageSizeMinHeight,
-                desPPD.desPage.iCustomPageSizeMaxHeight );
-        printf("\n");
-    }
 
-    //
-    // Write out the UI constraints, if any
-    //
-    puicb = desPPD.stUICList.puicBlockList;
-    for ( i = 0; puicb && i < desPPD.stUICList.usNumOfUICs; i++ ) {
-        PSZ pszName1, pszName2,
-            pszVal1, pszVal2;
-        PUI_BLOCK puib2;
-
-        puib = desPPD.stUIList.pBlockList;
-        for ( j = 0; j < puicb->uicEntry1.ofsUIBlock; j++ )
-            INCREMENT_BLOCK_PTR( puib );
-        pszName1 = OFFSET_TO_PSZ( puib->ofsUIName, pInfoSeg );
-        if ( puicb->uicEntry1.bOption ) {
-            for ( j = 0; j < 32 && j < puib->usNumOfEntries; j++ ) {
-                if (( puicb->uicEntry1.bOption >> j ) & 1 ) {
-                    pszVal1 = OFFSET_TO_PSZ( puib->uiEntry[j].ofsOption, pInfoSeg );
-                    puib2 = desPPD.stUIList.pBlockList;
-                    for ( k = 0; k < puicb->uicEntry2.ofsUIBlock; k++ )
-                        INCREMENT_BLOCK_PTR( puib2 );
-                    pszName2 = OFFSET_TO_PSZ( puib2->ofsUIName, pInfoSeg );
-                    if ( puicb->uicEntry2.bOption ) {
-                        for ( k = 0; k < 32 && k < puib2->usNumOfEntries; k++ ) {
-                            if (( puicb->uicEntry2.bOption >> k ) & 1 ) {
-                                pszVal2 = OFFSET_TO_PSZ( puib2->uiEntry[k].ofsOption, pInfoSeg );
-                                printf("*UIConstraints: *%s %s *%s %s\n",
-                                        pszName1, pszVal1, pszName2, pszVal2 );
-                            }
-                        }
-                    }
-                }
-            }
-        }
-        puicb++;
+/* ------------------------------------------------------------------------- */
+ULONG AnnotatePrinter( PSZ pszPakFile, PSZ pszPrinter, PSZ pszRegion )
+{
+    APIRET rc;
+
+    rc = PakDumpRegion( NULL, pszPakFile, pszPrinter, pszRegion, NULL );
+    switch ( rc ) {
+        case NO_ERROR:
+            break;
+        case ERROR_PAK_NO_DEVICE:
+            printf("The requested printer was not found\n");
+            break;
+        case ERROR_PAK_NO_KEYWORD:
+            printf("This printer has no UI block %s\n", pszRegion );
+            break;
+        case ERROR_INVALID_PARAMETER:
+            printf("Not a valid region: %s\n", pszRegion );
+            break;
+        case ERROR_INVALID_DATA:
+            printf("Invalid PAK file signature!\n");
+            break;
+        case ERROR_NOT_ENOUGH_MEMORY:
+            printf("malloc() failed - out of memory?\n");
+            break;
+        case ERROR_HANDLE_EOF:
+            printf("Error reading device data.\n");
+            break;
+        default:
+            ReportOpenError( rc );
+            break;
     }
-    printf("\n");
-
-    //
-    // OK, now do the UI items
-    //
-    puib = desPPD.stUIList.pBlockList;
-    for ( i = 0; puib && desPPD.stUIList.usBlockListSize && i < desPPD.stUIList.usNumOfBlocks; i++ ) {
-        psz = OFFSET_TO_PSZ( puib->ofsUIName, pInfoSeg );
-
-        printf("*OpenUI *%s/%s: ", psz,
-                OFFSET_TO_PSZ( puib->ofsUITransString, pInfoSeg ));
-        switch( puib->usSelectType ) {
-            case UI_SELECT_BOOLEAN : printf("Boolean\n");  break;
-            case UI_SELECT_PICKMANY: printf("PickMany\n"); break;
-            case UI_SELECT_PICKONE :
-            default                : printf("PickOne\n");  break;
-        }
+    return rc;
+}
 
-        // Write the order dependency line
-        printf("*OrderDependency: %d ", puib->usOrderDep + 1 );
-        switch( puib->usUILocation ) {
-            default:
-            case UI_ORDER_ANYSETUP   : printf("AnySetup ");      break;
-            case UI_ORDER_JCLSETUP   : printf("JCLSetup ");      break;
-            case UI_ORDER_PAGESETUP  : printf("PageSetup ");     break;
-            case UI_ORDER_DOCSETUP   : printf("DocumentSetup "); break;
-            case UI_ORDER_PROLOGSETUP: printf("Prolog ");        break;
-            case UI_ORDER_EXITSERVER : printf("ExitServer ");    break;
-        }
-        printf("*%s\n", psz );
 
-        if ( strcmp( psz, "PageSize") == 0 ) {
-            // We already saved the default, no need to jump through hoops now
-            pszDefault = pszDefPage;
-        }
-        else if ( strcmp( psz, "Resolution") == 0 ) {
-            // Try a few different ways to determine the default resolution
-            if ( puib->usNumOfEntries > puib->usDefaultEntry )
-                pszDefault = OFFSET_TO_PSZ( puib->uiEntry[puib->usDefaultEntry].ofsOption, pInfoSeg );
-            else if ( desPPD.desItems.iResDpi > 0 ) {
-                sprintf( pScratch, "%ddpi", desPPD.desItems.iResDpi );
-                pszDefault = pScratch;
-            }
-            else if ( puib->usNumOfEntries )
-                pszDefault = OFFSET_TO_PSZ( puib->uiEntry[0].ofsOption, pInfoSeg );
-            else
-                pszDefault = "300dpi";
-        }
-        else {
-            // Find the default; if there's no default, just use the first item
-            if ( puib->usNumOfEntries > puib->usDefaultEntry )
-                pszDefault = OFFSET_TO_PSZ( puib->uiEntry[puib->usDefaultEntry].ofsOption, pInfoSeg );
-            else if ( puib->usNumOfEntries )
-                pszDefault = OFFSET_TO_PSZ( puib->uiEntry[0].ofsOption, pInfoSeg );
-            else
-                pszDefault = "Unknown";     // hopefully shouldn't happen
-        }
-        printf("*Default%s: %s\n", psz, pszDefault );
-
-        // Now write the list of actual values
-        for ( j = 0; j < puib->usNumOfEntries; j++ ) {
-            pszName = OFFSET_TO_PSZ( puib->uiEntry[j].ofsOption, pInfoSeg );
-            pszXlate = ( puib->uiEntry[j].ofsTransString > 0 ) ?
-                       OFFSET_TO_PSZ( puib->uiEntry[j].ofsTransString, pInfoSeg ) :
-                       pszName;
-            printf("*%s %s/%s: ", psz, pszName, pszXlate );
-            if (( puib->uiEntry[j].ofsValue > 0 ) &&
-                ( DecompressString( OFFSET_TO_PSZ( puib->uiEntry[j].ofsValue, pInfoSeg ), pScratch ) > 0 ))
-            {
-                printf("\"%s\"\n", pScratch );
-            } else
-                printf("\"\"\n");
-        }
+/* ------------------------------------------------------------------------- *
+ * Context for StreamVisit()                                                 *
+ * ------------------------------------------------------------------------- */
+typedef struct _STREAMCTX
+{
+    USHORT fsMode;          // DEV_FMT_DATA (list), DEV_RAW_DATA or DEV_HEX_DATA
+    SHORT  iLeft;           // entries remaining in the current PAK
+    SHORT  sCol;            // current column of hex dump
+    ULONG  ulSum1,          // Adler-32 checksum of current segment
+           ulSum2,
+           cbSkipped;       // bytes skipped which were not part of a PAK
+} STREAMCTX, *PSTREAMCTX;
 
-        // Do we need to do anything with this?
-        // puib->ucGroupType
 
-        printf("*CloseUI: *%s\n", psz );
-        printf("\n");
-        INCREMENT_BLOCK_PTR( puib );
-    }
+/* ------------------------------------------------------------------------- *
+ * StreamVisit                                                               *
+ *                                                                           *
+ * PakStreamDevices() callback for StreamPrinters.                           *
+ * ------------------------------------------------------------------------- */
+ULONG APIENTRY StreamVisit( PVOID pUser, PPAKSIGNATURE pSig, PPAK_DEV_DIRENTRY pEntry,
+                            ULONG ulPos, PBYTE pb, ULONG cb )
+{
+    PSTREAMCTX pCtx = (PSTREAMCTX) pUser;
+    ULONG      i;
 
-    //
-    // Lastly, the supported hardware fonts
-    //
-    if ( desPPD.desFonts.ofsDeffont > 0 )
-        printf("*DefaultFont: %s\n", OFFSET_TO_PSZ( desPPD.desFonts.ofsDeffont, pInfoSeg ));
-    psz = OFFSET_TO_PSZ( desPPD.desFonts.ofsFontnames, pInfoSeg );
-    for ( i = 0; (i < desPPD.desFonts.iFonts) && *psz; i++ ) {
-        // Just use some common values for the encoding/version/status; PIN
-        // doesn't use or care about them anyway.
-        printf("*Font %s: Standard \"(001.006S)\" Standard ROM\n", psz );
-        psz += strlen( psz ) + 1;
+    if ( !pEntry ) {
+        printf("%u bytes after the end of a PAK file are not part of one; skipped.\n", cb );
+        pCtx->cbSkipped += cb;
+        return NO_ERROR;
+    }
+    if ( ulPos == 0 ) {
+        if ( pCtx->iLeft <= 0 ) {
+            pCtx->iLeft = pSig->iEntries;
+            if ( pCtx->fsMode == DEV_FMT_DATA ) {
+                printf("%s\n==============\n", pSig->szName );
+                printf("%d printers defined:\n", pSig->iEntries );
+            }
+        }
+        if ( pCtx->fsMode == DEV_HEX_DATA )
+            printf("%.40s:\n", pEntry->szDeviceName );
+        pCtx->sCol   = 0;
+        pCtx->ulSum1 = 1;
+        pCtx->ulSum2 = 0;
     }
-    printf("\n");
-
-    // And we're done!
 
-    // Clean up
-    free( desPPD.stUIList.pBlockList );
-    free( desPPD.stUICList.puicBlockList );
-    free( pScratch );
+    if ( pCtx->fsMode == DEV_FMT_DATA ) {
+        for ( i = 0; i < cb; i++ ) {
+            pCtx->ulSum1 = ( pCtx->ulSum1 + pb[ i ] ) % 65521;
+            pCtx->ulSum2 = ( pCtx->ulSum2 + pCtx->ulSum1 ) % 65521;
+        }
+    }
+    else DumpBytesFrom( pb, cb, ( pCtx->fsMode == DEV_HEX_DATA ), &(pCtx->sCol), NULL );
+
+    if ( ulPos + cb >= pEntry->ulSize ) {
+        pCtx->iLeft--;
+        if ( pCtx->fsMode == DEV_FMT_DATA )
+            printf(" - %.40s (offset 0x%X, %u bytes, flags=0x%X, adler32=%08X)\n",
+                   pEntry->szDeviceName, pEntry->ulOffset, pEntry->ulSize, pEntry->ulFlags,
+                   ( pCtx->ulSum2 << 16 ) | pCtx->ulSum1 );
+        else if ( pCtx->fsMode == DEV_HEX_DATA )
+            printf("\n\n");
+    }
+    return NO_ERROR;
 }
 
 
-//
-// THESE FUNCTIONS STOLEN FROM UTLCHNL.C (USED FOR DECOMPRESSING STRINGS):
-//
-
-//*****************************************************************************
-//
-// FUNCTION: CharToHex
-//
-// DESCRIPTION: Converts an character to its hex rep
-//
-// Returns -1 if fails
-//
-//*****************************************************************************
-
-BYTE CharToHex( CHAR c )
+/* ------------------------------------------------------------------------- *
+ * StreamPrinters                                                            *
+ *                                                                           *
+ * List (with checksums) or dump every printer in a PAK file, reading it     *
+ * once from start to end with a fixed amount of memory.  If the file name   *
+ * is "-", one or more concatenated PAK files are read from STDIN.           *
+ * ------------------------------------------------------------------------- */
+ULONG StreamPrinters( PSZ pszPakFile, PSZ pszMode )
 {
-  if ( c >= '0' && c <= '9' )
-  {
-    return c - '0';
-  }
-  else
-  if ( c >= 'a' && c <= 'f' )
-  {
-    return c - 'a' + 10;
-  }
-  if ( c >= 'A' && c <= 'F' )
-  {
-    return c - 'A' + 10;
-  }
-
-  return -1;
-}
+    STREAMCTX ctx = {0};
+    HFILE     hf;
+    ULONG     ulAction;
+    APIRET    rc;
+
+    ctx.fsMode = DEV_FMT_DATA;
+    if ( pszMode ) switch ( toupper( *pszMode )) {
+        case 'D': ctx.fsMode = DEV_RAW_DATA; break;
+        case 'X': ctx.fsMode = DEV_HEX_DATA; break;
+    }
 
-//*****************************************************************************
-//
-// FUNCTION: ProcessHexString
-//
-// DESCRIPTION: Will take a WELL FORMED hex string that is one that starts
-// with less than char, is all hex digits - no white space, and even amount
-// ending with greater than char
-// Note - since function will adjust the callers in and out buffers the addr
-// of the callers buufers are passesd hence the PSZ * type
-//
-// Defect 203803 some strings are not up to standards eg HP 1200C where they are
-// in form <a><b> ....
-// So we have to take that in account (Real World - you know)
-//
-// RETURNS:
-// Returns the number of hex bytes - esentially the number of ASCII chars/2 -
-// 2 for the <>
-//
-//*****************************************************************************
-
-SHORT ProcessHexString( PSZ *ppszBuffIn,  // Ptr 2 Ptr of input buffer
-                        PSZ *ppszBuffOut) // Ptr 2 Ptr of output buffer
-{
-  PSZ pIn  = *ppszBuffIn;
-  PSZ pOut = *ppszBuffOut;
-  INT iCount = 0;
-
-  // Hop over initial < of hex string
-  *pIn++;
-
-  while ( *pIn != '>' )
-  {
-    *pOut = CharToHex( *pIn );
-    pIn++;
-    //-------------------- Georgs P.         203803
-    if ( *pIn != '>' )
+    if ( strcmp( pszPakFile, "-") == 0 )
+        hf = HF_STDIN;
+    else if (( rc = DosOpen( pszPakFile, &hf, &ulAction, 0, 0,
+                             OPEN_ACTION_FAIL_IF_NEW | OPEN_ACTION_OPEN_IF_EXISTS,
+                             OPEN_FLAGS_FAIL_ON_ERROR | OPEN_FLAGS_SEQUENTIAL |
+                             OPEN_SHARE_DENYNONE | OPEN_ACCESS_READONLY, NULL )) != NO_ERROR )
     {
-      *pOut = (*pOut << 4) | CharToHex( *pIn );
-      pIn++;
+        ReportOpenError( rc );
+        return rc;
     }
-    pOut++;
-    iCount++;
-  }
 
-  // Adjust pointers
-  *ppszBuffIn = pIn;
-  *ppszBuffOut = pOut;
+    rc = PakStreamDevices( NULL, hf, 0, StreamVisit, &ctx );
+    switch ( rc ) {
+        case ERROR_INVALID_DATA:  printf("Invalid PAK file signature!\n");                  break;
+        case ERROR_NEGATIVE_SEEK: printf("Segments overlap; this file cannot be streamed.\n"); break;
+        case ERROR_HANDLE_EOF:    printf("Error reading device data.\n");                   break;
+        case ERROR_PAK_SHARED_SEGMENT:
+            printf("Printers sharing a segment larger than %u bytes cannot be streamed.\n",
+                   PAKSTREAM_WINDOW );
+            break;
+    }
+    // Data which is not part of any PAK has been reported, but is still an error
+    if ( !rc && ctx.cbSkipped ) rc = ERROR_INVALID_DATA;
 
-  return iCount;
+    if ( hf != HF_STDIN ) DosClose( hf );
+    return rc;
 }
 
 
-/*****************************************************************************\
-**
-** FUNCTION NAME = DecompressString
-**
-** DESCRIPTION   = Decompress a string from ppd files that was
-**                 compressed by the PPD compiler.
-**
-**
-** INPUT         = pszBuffIn                - pointer to input buffer
-**                 pszBuffOut               - pointer to output buffer
-**
-** OUTPUT        = returns length of output buffer
-**
-** RETURN-NORMAL = NONE
-** RETURN-ERROR  = NONE
-**
-\*****************************************************************************/
-
-USHORT DecompressString(PSZ pszBuffIn, PSZ pszBuffOut)
+/* ------------------------------------------------------------------------- *
+ * ConvertPakFile                                                            *
+ *                                                                           *
+ * Convert a device PAK file from V1 to V2 format, or from V2 to V1,         *
+ * depending on its current format.                                          *
+ * ------------------------------------------------------------------------- */
+ULONG ConvertPakFile( PSZ pszPakFile, PSZ pszOutFile, PPAKDICT pDict )
 {
-  SHORT  sAdjust;
-  USHORT usIndex;
-  SHORT  usOutSize;                     /* size of the output buffer    */
-  USHORT usStringLen;
-  USHORT usOffSet;
-
-  usOutSize = 0;
-
-  /*
-  ** For each char in source
-  */
-  while ( *pszBuffIn )
-  {
-
-    // Ahh - must be either a hex string or dict entry
-    if ( *pszBuffIn == '<' )
-    {
-      // Another < - must be dict entry
-      // Add them to output line
-      if ( *(pszBuffIn+1) == '<' )
-      {
-        *pszBuffOut++ = *pszBuffIn++;
-        *pszBuffOut++ = *pszBuffIn;
-        usOutSize += 2;
-      }
-      else
-      {
-        /*        ** "cng55p2.ppd" [UIsection=Halftone]; "601ps95.ppd [UIsection=Collate]"
-        */
-        if ( *(pszBuffIn+1) == ' '  || *(pszBuffIn+1) == '\n' ||
-             *(pszBuffIn+1) == '\r' || *(pszBuffIn+1) == '\t' )
-        {
-           *pszBuffOut++ = *pszBuffIn;
-           usOutSize++;
-        }
+    PAKSIGNATURE pak_sig;
+    BOOL         fToV1;
+    APIRET       rc;
+
+    if ( !pszOutFile ) {
+        printf("No output file was specified.\n");
+        return ERROR_INVALID_PARAMETER;
+    }
+    if (( rc = PakReadSignature( pszPakFile, &pak_sig )) != NO_ERROR ) {
+        if ( rc == ERROR_INVALID_DATA )
+            printf("Invalid PAK file signature!\n");
         else
-        {
-          usOutSize += ProcessHexString( &pszBuffIn, &pszBuffOut );
-        }
-      }
+            ReportOpenError( rc );
+        return rc;
     }
+
+    fToV1 = ( strcmp( pak_sig.szName, PAK2SIGNATURE_DEVPACK ) == 0 );
+    if ( fToV1 )
+        rc = PakConvertToV1( NULL, pszPakFile, pszOutFile );
     else
-    if (*pszBuffIn < 128)  //If regular character copy it over
-    {
-      *pszBuffOut = *pszBuffIn;
-      usOutSize++;
-      pszBuffOut++;
-    }
-    else          //Its a compressed char
-    {
-      sAdjust = -128;
-      while (*pszBuffIn == 255) //Pass over flag bytes
-      {
-        pszBuffIn++;
-        sAdjust += 254;         //This is the offset adjust
-      }
-      usIndex = (USHORT)*pszBuffIn + sAdjust; //This is the postion of offset
-      usOffSet = sPSKeyWordOffset[usIndex];   //Actual offset into words buffer
-      strcpy(pszBuffOut,&(achPSKeyWords[usOffSet]));  //Copy word to target
-      usStringLen = strlen (&(achPSKeyWords[usOffSet]));
-      usOutSize += usStringLen;  //Adjust pointers
-      pszBuffOut += usStringLen;
+        rc = PakConvertToV2( NULL, pDict, pszPakFile, pszOutFile );
+
+    switch ( rc ) {
+        case NO_ERROR:
+            printf("Converted %s to %s (%s format).\n", pszPakFile, pszOutFile, fToV1 ? "V1" : "V2");
+            break;
+        case ERROR_INVALID_DATA:
+            printf("Invalid PAK file signature!\n");
+            break;
+        case ERROR_CRC:
+            printf("Device data does not match its checksum; the file is damaged.\n");
+            break;
     }
-    pszBuffIn++;
-  }
-  *pszBuffOut = '\0';   //End with null byte
-  return(usOutSize);
+    return rc;
 }
-
-
-
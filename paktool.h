@@ -0,0 +1,109 @@
+/*
+ * paktool.h
+ *
+ * Definitions shared between the PAKTOOL program modules.  Include this after
+ * <os2.h>, pt_struct.h, package.h and paklib.h.
+ */
+
+#ifndef paktool_h_
+#define paktool_h_
+
+#define PAKTOOL_VERSION     "0.4"
+
+// Shared helpers (paktool.c)
+void   ReportOpenError( APIRET rc );
+ULONG  ReadPakImage( PSZ pszFile, PBYTE *ppbFile, PULONG pcbFile );
+ULONG  LoadPrinter( PSZ pszPakFile, PSZ pszPrinter, PPAK_DEV_DIRENTRY pEntry, PBYTE *ppSegment );
+ULONG  LoadPakImage( PSZ pszPakFile, PBYTE *ppbFile, PULONG pcbFile,
+                     PPAK_DEV_DIRENTRY *ppEntries, PULONG *ppulHashes, PULONG pcEntries );
+
+#define NAME_MAX_SUGGEST    5       // names offered for one not found
+#define NAME_MAX_LIST       20      // printers listed for an ambiguous name
+#define RESOLVE_BUFFER      ( PAKNAME_MAX_PATTERN + 3 )
+
+void   SuggestPrinters( PPAKNAMES pNames, PPAK_DEV_DIRENTRY pEntries, PSZ pszName );
+ULONG  ResolvePrinter( PSZ pszPakFile, PSZ *ppszPrinter, BOOL fMany, PSZ pszBuffer );
+
+// Ordered output of many printers (pt_pipe.c)
+#define PIPE_WINDOW         32      // entries between reading and writing
+
+typedef ULONG ( PIPEFORMAT )( PVOID pUser, PPAK_DEV_DIRENTRY pEntry, PBYTE pbSegment,
+                              PPAKARENA pArena, POUTBUF pOut );
+typedef PIPEFORMAT *PPIPEFORMAT;
+
+ULONG  LoadPipeDirectory( PSZ pszPakFile, PBYTE *ppDir, PULONG *ppulHashes );
+ULONG  RunPipelineEntries( PSZ pszPakFile, PPAK_DEV_DIRENTRY pEntries, ULONG cEntries,
+                           PPAKDICT pDict, PPIPEFORMAT pfnFormat, PVOID pUser,
+                           PULONG pulTotal, PULONG pcThreads );
+ULONG  RunPipeline( PSZ pszPakFile, PSZ pszPrinter, PPAKDICT pDict, PPIPEFORMAT pfnFormat,
+                    PVOID pUser, PULONG pulTotal, PULONG pcEntries, PULONG pcThreads );
+
+// Query server (pt_serve.c)
+#define SERVE_DEFAULT_PIPE  "\\PIPE\\PAKTOOL"
+#define SERVE_MAX_PAKS      16      // maximum number of PAK files served at once
+
+ULONG  ServePakFiles( PSZ *ppszPakFiles, ULONG cPakFiles, PSZ pszPipe, PPAKDICT pDict );
+ULONG  QueryServer( PSZ pszPipe, PSZ pszRequest );
+
+// Keyword dictionary generator (pt_dict.c)
+#define DICT_ENV_VAR        "PAKTOOL_DICT"  // names a dictionary to use instead
+                                            //   of the built-in one
+ULONG  BuildDictionary( PSZ pszPPDFiles, PSZ pszOutFile );
+
+// Render cache (pt_cache.c)
+#define CACHE_ENV_VAR       "PAKTOOL_CACHE"     // names the cache directory
+#define CACHE_SIZE_ENV_VAR  "PAKTOOL_CACHESIZE" // its size limit in KB
+#define CACHE_DEFAULT_KB    8192
+
+ULONG  CachedPrinterData( PSZ pszCacheDir, ULONG cbLimit, PSZ pszPakFile, PSZ pszPrinter,
+                          USHORT fsMode );
+
+// Structural check (pt_check.c)
+ULONG  CheckPakFile( PSZ pszPakFile, PPAKDICT pDict );
+
+// Size statistics (pt_stat.c)
+ULONG  ShowStats( PSZ pszPakFile, PPAKDICT pDict );
+
+// UI constraints (pt_uic.c)
+ULONG  ShowConstraints( PSZ pszPakFile, PSZ pszPrinter, PSZ *ppszOptions, ULONG cOptions );
+BOOL   ApplyOptions( PPAKUIC pUic, PSZ *ppszOptions, ULONG cOptions,
+                     PUI_SEL pSel, PUI_SEL pPrefer );
+
+// Job ticket rendering (pt_job.c)
+ULONG  RenderJob( PSZ pszPakFile, PSZ pszPrinter, PSZ *ppszOptions, ULONG cOptions,
+                  PPAKDICT pDict );
+
+// Paper sizes (pt_paper.c)
+#define ERROR_PAK_NO_PAPER  0xF004  // no paper within the tolerance
+
+ULONG  ShowPapers( PSZ pszPakFile, PSZ pszPrinter, PSZ *ppszArgs, ULONG cArgs, PPAKDICT pDict );
+
+// Font index (pt_font.c)
+ULONG  ShowFonts( PSZ pszPakFile, PSZ *ppszArgs, ULONG cArgs );
+
+// Font PAK files (pt_fpak.c)
+ULONG  ListFontPak( PSZ pszPakFile );
+ULONG  DumpFontPak( PSZ pszPakFile, PSZ pszFont, USHORT fsMode );
+ULONG  ExtractFontPak( PSZ pszPakFile, PSZ pszDir, PSZ *ppszFonts, ULONG cFonts );
+
+// Printer selection (pt_sel.c)
+ULONG  SelectPrinters( PSZ pszExpr, PSZ *ppszPakFiles, ULONG cPakFiles );
+
+// Near-duplicate printers (pt_dup.c)
+ULONG  FindSimilar( PSZ pszPakFile, PSZ pszPercent );
+
+// Information segment use (pt_info.c)
+ULONG  ShowSlack( PSZ pszPakFile, PSZ pszPrinter );
+ULONG  CompactPakFile( PSZ pszPakFile, PSZ pszOutFile );
+
+// Binary patches (pt_diff.c)
+ULONG  DiffPakFiles( PSZ pszOldFile, PSZ pszNewFile, PSZ pszPatchFile );
+ULONG  ApplyPakPatch( PSZ pszOldFile, PSZ pszPatchFile, PSZ pszOutFile );
+
+// PPD round-trip verification (pt_vrfy.c)
+ULONG  VerifyPakFile( PSZ pszPakFile, PSZ pszPrinter, PPAKDICT pDict );
+
+// Field queries (pt_fqry.c)
+ULONG  QueryPakFields( PSZ pszPakFile, PSZ pszPrinter, PSZ *ppszFields, ULONG cFields, PPAKDICT pDict );
+
+#endif
@@ -0,0 +1,463 @@
+/*
+ * pakuic.c
+ *
+ * PAKTOOL library: UI constraint engine.  See paklib.h for an overview.
+ *
+ * Each constraint (UIC_BLOCK) names two UI blocks and a mask of options in
+ * each; every option in the first mask conflicts with every option in the
+ * second.  These are expanded once, when the engine is built, into a matrix
+ * row for each option holding a UI_SEL mask for each block, so that checking
+ * a selection costs one AND per block for each selected option which has any
+ * conflicts at all.
+ */
+
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+
+// Number of selectable options in a block, and the mask covering them
+#define BLOCK_OPTIONS( p )  (( (p)->usNumOfEntries < 32 ) ? (p)->usNumOfEntries : 32 )
+#define BLOCK_MASK( p )     (( (p)->usNumOfEntries < 32 ) ?                     \
+                             (( 1UL << (p)->usNumOfEntries ) - 1 ) : 0xFFFFFFFFUL )
+
+// Mask of the options after option e of a block
+#define LATER_OPTIONS( e )  (( (e) >= 31 ) ? 0 : ( 0xFFFFFFFFUL << ( (e) + 1 )))
+
+// Matrix row of option e of block b
+#define UIC_ROW( p, b, e )  ( (p)->pMatrix + ( (p)->pulFirstRow[ b ] + (e) ) * (p)->cBlocks )
+
+
+/* ------------------------------------------------------------------------- *
+ * LowBit                                                                    *
+ *                                                                           *
+ * Return the number of the lowest bit set in a (non-zero) mask.             *
+ * ------------------------------------------------------------------------- */
+static ULONG LowBit( UI_SEL m )
+{
+    static const BYTE abDeBruijn[ 32 ] = {
+         0,  1, 28,  2, 29, 14, 24,  3, 30, 22, 20, 15, 25, 17,  4,  8,
+        31, 27, 13, 23, 21, 19, 16,  7, 26, 12, 18,  6, 11,  5, 10,  9
+    };
+
+    return abDeBruijn[ (( m & ( ~m + 1 )) * 0x077CB531UL & 0xFFFFFFFFUL ) >> 27 ];
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CountBits                                                                 *
+ * ------------------------------------------------------------------------- */
+static ULONG CountBits( UI_SEL m )
+{
+    ULONG c;
+
+    for ( c = 0; m; m &= m - 1 ) c++;
+    return c;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * InfoString                                                                *
+ *                                                                           *
+ * Return the string at an offset into the information segment, or "(none)"  *
+ * if the offset is not that of a valid string.                              *
+ * ------------------------------------------------------------------------- */
+static PSZ InfoString( PPAKUIC pUic, ULONG ulOff )
+{
+    if ( !ulOff || ulOff >= pUic->cbInfo ||
+         !memchr( pUic->pInfoSeg + ulOff, 0, pUic->cbInfo - ulOff ))
+        return "(none)";
+    return (PSZ)( pUic->pInfoSeg + ulOff );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakUicBuild                                                               *
+ *                                                                           *
+ * Build the constraint engine for a device segment.  Constraints which      *
+ * refer to a non-existent block are ignored (CHECK reports them).           *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID    pHeap : Heap to allocate from (or NULL)                        *
+ *   PBYTE    pBuf  : Device segment (must stay in memory while the engine   *
+ *                    is used)                                               *
+ *   ULONG    cbBuf : Size of the segment                                    *
+ *   PPAKUIC *ppUic : Receives the engine (free with PakUicFree)             *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_INVALID_DATA if the UI lists do not fit the         *
+ *   segment, or ERROR_NOT_ENOUGH_MEMORY                                     *
+ * ------------------------------------------------------------------------- */
+ULONG PakUicBuild( PVOID pHeap, PBYTE pBuf, ULONG cbBuf, PPAKUIC *ppUic )
+{
+    DESPPD     desPPD;
+    PPAKUIC    pUic;
+    PBYTE      pb;
+    PUI_BLOCK  puib;
+    PUIC_BLOCK puicb;
+    PUI_SEL    pRow;
+    UI_SEL     m1, m2, m;
+    ULONG      cbLists,
+               cbLeft,
+               cb,
+               cBlocks,
+               cOptions,
+               i, b, c, e;
+
+    *ppUic = NULL;
+    if ( cbBuf < sizeof( DESPPD )) return ERROR_INVALID_DATA;
+    memcpy( &desPPD, pBuf, sizeof( DESPPD ));
+    cbLists = desPPD.stUIList.usBlockListSize + desPPD.stUICList.usNumOfUICs * sizeof( UIC_BLOCK );
+    if ( cbLists > cbBuf - sizeof( DESPPD )) return ERROR_INVALID_DATA;
+
+    // Count the options, making sure that the block chain fits its list
+    cBlocks  = desPPD.stUIList.usNumOfBlocks;
+    cOptions = 0;
+    pb       = pBuf + sizeof( DESPPD );
+    cbLeft   = desPPD.stUIList.usBlockListSize;
+    for ( b = 0; b < cBlocks; b++ ) {
+        puib = (PUI_BLOCK) pb;
+        if (( cbLeft < UI_BLOCK_FIXED ) ||
+            (( cb = UI_BLOCK_FIXED + puib->usNumOfEntries * sizeof( UI_ENTRY )) > cbLeft ))
+            return ERROR_INVALID_DATA;
+        cOptions += BLOCK_OPTIONS( puib );
+        pb       += cb;
+        cbLeft   -= cb;
+    }
+
+    if ( cOptions && cBlocks > ( 0x7FFFFFFFUL / sizeof( UI_SEL )) / cOptions )
+        return ERROR_NOT_ENOUGH_MEMORY;
+    cb = sizeof( PAKUIC ) + cBlocks * ( sizeof( PUI_BLOCK ) + sizeof( ULONG ) + sizeof( UI_SEL )) +
+         cOptions * cBlocks * sizeof( UI_SEL );
+    if (( pUic = (PPAKUIC) PakAlloc( pHeap, cb )) == NULL )
+        return ERROR_NOT_ENOUGH_MEMORY;
+    memset( pUic, 0, cb );
+    pUic->cBlocks     = cBlocks;
+    pUic->cOptions    = cOptions;
+    pUic->apBlocks    = (PUI_BLOCK *)( pUic + 1 );
+    pUic->pulFirstRow = (PULONG)( pUic->apBlocks + cBlocks );
+    pUic->pAny        = (PUI_SEL)( pUic->pulFirstRow + cBlocks );
+    pUic->pMatrix     = pUic->pAny + cBlocks;
+    pUic->pInfoSeg    = pBuf + sizeof( DESPPD ) + cbLists;
+    pUic->cbInfo      = cbBuf - sizeof( DESPPD ) - cbLists;
+    if (( desPPD.desItems.iSizeBuffer >= 0 ) && ( (ULONG) desPPD.desItems.iSizeBuffer < pUic->cbInfo ))
+        pUic->cbInfo = desPPD.desItems.iSizeBuffer;
+
+    pb = pBuf + sizeof( DESPPD );
+    for ( b = 0, cOptions = 0; b < cBlocks; b++ ) {
+        puib = (PUI_BLOCK) pb;
+        pUic->apBlocks[ b ]    = puib;
+        pUic->pulFirstRow[ b ] = cOptions;
+        cOptions += BLOCK_OPTIONS( puib );
+        INCREMENT_BLOCK_PTR( puib );
+        pb = (PBYTE) puib;
+    }
+
+    // Expand each constraint into both directions of every pair of options
+    puicb = (PUIC_BLOCK)( pBuf + sizeof( DESPPD ) + desPPD.stUIList.usBlockListSize );
+    for ( i = 0; i < desPPD.stUICList.usNumOfUICs; i++, puicb++ ) {
+        b = puicb->uicEntry1.ofsUIBlock;
+        c = puicb->uicEntry2.ofsUIBlock;
+        if ( b >= cBlocks || c >= cBlocks ) continue;
+        m1 = puicb->uicEntry1.bOption & BLOCK_MASK( pUic->apBlocks[ b ] );
+        m2 = puicb->uicEntry2.bOption & BLOCK_MASK( pUic->apBlocks[ c ] );
+        for ( m = m1; m; m &= m - 1 )
+            UIC_ROW( pUic, b, LowBit( m ))[ c ] |= m2;
+        for ( m = m2; m; m &= m - 1 )
+            UIC_ROW( pUic, c, LowBit( m ))[ b ] |= m1;
+    }
+
+    // Drop any option's conflict with itself, and count the distinct pairs
+    for ( b = 0; b < cBlocks; b++ ) {
+        for ( e = 0; e < BLOCK_OPTIONS( pUic->apBlocks[ b ] ); e++ ) {
+            pRow = UIC_ROW( pUic, b, e );
+            pRow[ b ] &= ~( 1UL << e );
+            for ( c = 0; c < cBlocks; c++ ) {
+                if ( !pRow[ c ] ) continue;
+                pUic->pAny[ b ] |= 1UL << e;
+                if ( c > b )
+                    pUic->cPairs += CountBits( pRow[ c ] );
+                else if ( c == b )
+                    pUic->cPairs += CountBits( pRow[ c ] & LATER_OPTIONS( e ));
+            }
+        }
+    }
+
+    *ppUic = pUic;
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- */
+VOID PakUicFree( PVOID pHeap, PPAKUIC pUic )
+{
+    PakFree( pHeap, pUic );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakUicDefaults                                                            *
+ *                                                                           *
+ * Fill in a selection vector with the default option of each block (or the  *
+ * first option, if the default is not a valid entry).                       *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAKUIC pUic: Constraint engine                                         *
+ *   PUI_SEL pSel: Selection vector (pUic->cBlocks values)                   *
+ *                                                                           *
+ * RETURNS: N/A                                                              *
+ * ------------------------------------------------------------------------- */
+VOID PakUicDefaults( PPAKUIC pUic, PUI_SEL pSel )
+{
+    PUI_BLOCK puib;
+    ULONG     b;
+
+    for ( b = 0; b < pUic->cBlocks; b++ ) {
+        puib = pUic->apBlocks[ b ];
+        if ( !puib->usNumOfEntries )
+            pSel[ b ] = 0;
+        else if ( puib->usDefaultEntry < BLOCK_OPTIONS( puib ))
+            pSel[ b ] = 1UL << puib->usDefaultEntry;
+        else
+            pSel[ b ] = 1;
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakUicCheck                                                               *
+ *                                                                           *
+ * Find the constraints violated by a selection.  Each conflicting pair of   *
+ * selected options is reported once.                                        *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAKUIC     pUic  : Constraint engine                                   *
+ *   PUI_SEL     pSel  : Selection vector (pUic->cBlocks values)             *
+ *   PPAKUICPAIR pPairs: Receives the first cMax conflicting pairs (may be   *
+ *                       NULL if cMax is 0)                                  *
+ *   ULONG       cMax  : Size of pPairs                                      *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   Total number of conflicting pairs (0 if the selection is valid)         *
+ * ------------------------------------------------------------------------- */
+ULONG PakUicCheck( PPAKUIC pUic, PUI_SEL pSel, PPAKUICPAIR pPairs, ULONG cMax )
+{
+    PUI_SEL pRow;
+    UI_SEL  m, mHits;
+    ULONG   cFound = 0,
+            b, c, e;
+
+    for ( b = 0; b < pUic->cBlocks; b++ ) {
+        for ( m = pSel[ b ] & pUic->pAny[ b ]; m; m &= m - 1 ) {
+            e    = LowBit( m );
+            pRow = UIC_ROW( pUic, b, e );
+            // Conflicts with earlier blocks were found from the other side
+            for ( c = b; c < pUic->cBlocks; c++ ) {
+                mHits = pRow[ c ] & pSel[ c ];
+                if ( c == b ) mHits &= LATER_OPTIONS( e );
+                for ( ; mHits; mHits &= mHits - 1 ) {
+                    if ( cFound < cMax ) {
+                        pPairs[ cFound ].usBlock1 = (USHORT) b;
+                        pPairs[ cFound ].usEntry1 = (USHORT) e;
+                        pPairs[ cFound ].usBlock2 = (USHORT) c;
+                        pPairs[ cFound ].usEntry2 = (USHORT) LowBit( mHits );
+                    }
+                    cFound++;
+                }
+            }
+        }
+    }
+    return cFound;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * Conflicts                                                                 *
+ *                                                                           *
+ * Determine whether option e of block b conflicts with any option already   *
+ * settled by PakUicResolve(), or with those kept so far in its own block.   *
+ * ------------------------------------------------------------------------- */
+static BOOL Conflicts( PPAKUIC pUic, PUI_SEL pSel, PUI_SEL pPrefer,
+                       ULONG b, ULONG e, UI_SEL mKeep )
+{
+    PUI_SEL pRow;
+    BOOL    fPreferred,
+            fSettled;
+    ULONG   c;
+
+    if ( !( pUic->pAny[ b ] & ( 1UL << e ))) return FALSE;
+    pRow = UIC_ROW( pUic, b, e );
+    if ( pRow[ b ] & mKeep ) return TRUE;
+
+    fPreferred = ( pPrefer && pPrefer[ b ] );
+    for ( c = 0; c < pUic->cBlocks; c++ ) {
+        if ( c == b || !( pRow[ c ] & pSel[ c ] )) continue;
+        fSettled = ( pPrefer && pPrefer[ c ] ) ? ( !fPreferred || c < b ) : ( !fPreferred && c < b );
+        if ( fSettled ) return TRUE;
+    }
+    return FALSE;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakUicResolve                                                             *
+ *                                                                           *
+ * Change a selection as little as possible to make it valid.  The blocks    *
+ * are settled one at a time: first those with preferred options (usually    *
+ * the ones chosen explicitly), then the rest, each in block order.  Options *
+ * which conflict with those already settled are dropped; if that leaves a   *
+ * PickOne or Boolean block with nothing selected, the first option which    *
+ * does fit (trying the block's default first) is selected instead.  The     *
+ * result always satisfies every constraint; a block is left empty only if   *
+ * none of its options fits.                                                 *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAKUIC pUic   : Constraint engine                                      *
+ *   PUI_SEL pSel   : Selection vector, updated in place                     *
+ *   PUI_SEL pPrefer: Non-zero for each block to be settled first (may be    *
+ *                    NULL)                                                  *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   Number of blocks whose selection was changed                            *
+ * ------------------------------------------------------------------------- */
+ULONG PakUicResolve( PPAKUIC pUic, PUI_SEL pSel, PUI_SEL pPrefer )
+{
+    PUI_BLOCK puib;
+    UI_SEL    m, mWant, mKeep;
+    ULONG     cChanged = 0,
+              ulPass,
+              b, e, i, n;
+    BOOL      fPreferred;
+
+    for ( ulPass = 0; ulPass < 2; ulPass++ ) {
+        for ( b = 0; b < pUic->cBlocks; b++ ) {
+            fPreferred = ( pPrefer && pPrefer[ b ] );
+            if ( fPreferred != ( ulPass == 0 )) continue;
+
+            puib  = pUic->apBlocks[ b ];
+            mWant = pSel[ b ] & BLOCK_MASK( puib );
+            mKeep = 0;
+            for ( m = mWant; m; m &= m - 1 ) {
+                e = LowBit( m );
+                if ( !Conflicts( pUic, pSel, pPrefer, b, e, mKeep ))
+                    mKeep |= 1UL << e;
+            }
+            if ( mWant && !mKeep && puib->usSelectType != UI_SELECT_PICKMANY ) {
+                n = BLOCK_OPTIONS( puib );
+                for ( i = 0; i <= n && !mKeep; i++ ) {
+                    e = i ? i - 1 : puib->usDefaultEntry;
+                    if ( e < n && !Conflicts( pUic, pSel, pPrefer, b, e, 0 ))
+                        mKeep = 1UL << e;
+                }
+            }
+            if ( mKeep != pSel[ b ] ) {
+                pSel[ b ] = mKeep;
+                cChanged++;
+            }
+        }
+    }
+    return cChanged;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakUicFindOption                                                          *
+ *                                                                           *
+ * Look up a UI block by its keyword and, optionally, one of its options by  *
+ * name.                                                                     *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAKUIC pUic      : Constraint engine                                   *
+ *   PSZ     pszKeyword: Block keyword, with or without the leading '*'      *
+ *   PSZ     pszOption : Option name (or NULL to find just the block)        *
+ *   PULONG  pulBlock  : Receives the block number                           *
+ *   PULONG  pulEntry  : Receives the entry number (if pszOption is given)   *
+ *                                                                           *
+ * RETURNS: BOOL                                                             *
+ *   TRUE if found                                                           *
+ * ------------------------------------------------------------------------- */
+BOOL PakUicFindOption( PPAKUIC pUic, PSZ pszKeyword, PSZ pszOption,
+                       PULONG pulBlock, PULONG pulEntry )
+{
+    ULONG b, e;
+
+    if ( *pszKeyword == '*') pszKeyword++;
+    for ( b = 0; b < pUic->cBlocks; b++ ) {
+        if ( strcmp( PakUicKeyword( pUic, b ), pszKeyword ) != 0 ) continue;
+        *pulBlock = b;
+        if ( !pszOption ) return TRUE;
+        for ( e = 0; e < BLOCK_OPTIONS( pUic->apBlocks[ b ] ); e++ ) {
+            if ( strcmp( PakUicOption( pUic, b, e ), pszOption ) == 0 ) {
+                *pulEntry = e;
+                return TRUE;
+            }
+        }
+        return FALSE;
+    }
+    return FALSE;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakUicSelect                                                              *
+ *                                                                           *
+ * Apply a choice of the form "Keyword=Option" to a selection.  The option   *
+ * replaces the selection of a PickOne or Boolean block.  The first option   *
+ * chosen for a PickMany block replaces its selection, and later ones are    *
+ * added to it; if pPrefer is NULL, all are added to it.                     *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAKUIC pUic     : Constraint engine                                    *
+ *   PSZ     pszChoice: Choice, e.g. "Duplex=DuplexNoTumble"                 *
+ *   PUI_SEL pSel     : Selection vector, updated in place                   *
+ *   PUI_SEL pPrefer  : Options chosen so far in each block (updated), for   *
+ *                      passing to PakUicResolve(); may be NULL              *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_INVALID_PARAMETER if the choice has no '=',         *
+ *   ERROR_PAK_NO_KEYWORD or ERROR_PAK_NO_OPTION                             *
+ * ------------------------------------------------------------------------- */
+ULONG PakUicSelect( PPAKUIC pUic, PSZ pszChoice, PUI_SEL pSel, PUI_SEL pPrefer )
+{
+    CHAR  szKeyword[ 256 ];
+    PSZ   pszOption;
+    ULONG b, e, cb;
+
+    if (( pszOption = strchr( pszChoice, '=')) == NULL )
+        return ERROR_INVALID_PARAMETER;
+    cb = pszOption - pszChoice;
+    if ( cb >= sizeof( szKeyword )) cb = sizeof( szKeyword ) - 1;
+    memcpy( szKeyword, pszChoice, cb );
+    szKeyword[ cb ] = 0;
+    pszOption++;
+
+    if ( !PakUicFindOption( pUic, szKeyword, NULL, &b, &e ))
+        return ERROR_PAK_NO_KEYWORD;
+    if ( !PakUicFindOption( pUic, szKeyword, pszOption, &b, &e ))
+        return ERROR_PAK_NO_OPTION;
+
+    if (( pUic->apBlocks[ b ]->usSelectType == UI_SELECT_PICKMANY ) && ( !pPrefer || pPrefer[ b ] ))
+        pSel[ b ] |= 1UL << e;
+    else
+        pSel[ b ] = 1UL << e;
+    if ( pPrefer ) pPrefer[ b ] |= 1UL << e;
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- */
+PSZ PakUicKeyword( PPAKUIC pUic, ULONG ulBlock )
+{
+    return InfoString( pUic, pUic->apBlocks[ ulBlock ]->ofsUIName );
+}
+
+
+/* ------------------------------------------------------------------------- */
+PSZ PakUicOption( PPAKUIC pUic, ULONG ulBlock, ULONG ulEntry )
+{
+    return InfoString( pUic, pUic->apBlocks[ ulBlock ]->uiEntry[ ulEntry ].ofsOption );
+}
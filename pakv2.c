@@ -0,0 +1,949 @@
+/*
+ * pakv2.c
+ *
+ * PAKTOOL library: reading of V2 device PAK files, and conversion between
+ * the V1 and V2 formats.  See pakv2.h for a description of the format.
+ */
+
+#define INCL_DOSFILEMGR
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+#include "pakv2.h"
+
+// FNV-1a hash parameters
+#define FNV_OFFSET_BASIS    0x811C9DC5UL
+#define FNV_PRIME           0x01000193UL
+
+// Round a file offset up to the segment alignment
+#define PAK2_ALIGNED( ul )  ((( ul ) + PAK2_ALIGN - 1 ) & ~( PAK2_ALIGN - 1UL ))
+
+// Initial number of slots in the string pool hash table (a power of 2)
+#define POOL_SLOTS          1024
+
+
+// String pool under construction
+typedef struct _POOLBUILD
+{
+    OUTBUF out;             // pool records
+    PULONG aulSlots;        // hash table of (record offset + 1), 0 if unused
+    ULONG  cSlots;          // size of hash table
+    ULONG  cUsed;           // number of slots in use
+} POOLBUILD, *PPOOLBUILD;
+
+// Directory entry position in V1 segment order, used by the converter
+typedef struct _SEGORDER
+{
+    ULONG  ulV1Offset;      // segment offset in the V1 file
+    ULONG  ulEntry;         // index of directory entry
+} SEGORDER, *PSEGORDER;
+
+
+/* ------------------------------------------------------------------------- *
+ * Pak2HashName                                                              *
+ *                                                                           *
+ * Hash a device name for the V2 index.  Names are compared without regard   *
+ * to case, so the hash is of the upper-cased name.                          *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ   pszName: Device name                                              *
+ *   ULONG cchMax : Maximum length of the name (if not null-terminated)      *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   32-bit FNV-1a hash                                                      *
+ * ------------------------------------------------------------------------- */
+ULONG Pak2HashName( PSZ pszName, ULONG cchMax )
+{
+    ULONG ulHash = FNV_OFFSET_BASIS;
+
+    while ( cchMax-- && *pszName ) {
+        ulHash ^= (UCHAR) toupper( *pszName++ );
+        ulHash *= FNV_PRIME;
+    }
+    return ulHash;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * Pak2HashData                                                              *
+ *                                                                           *
+ * Hash a block of data (used for the segment content hashes).               *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   32-bit FNV-1a hash                                                      *
+ * ------------------------------------------------------------------------- */
+ULONG Pak2HashData( PBYTE pb, ULONG cb )
+{
+    ULONG ulHash = FNV_OFFSET_BASIS;
+
+    while ( cb-- ) {
+        ulHash ^= *pb++;
+        ulHash *= FNV_PRIME;
+    }
+    return ulHash;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CheckHeader                                                               *
+ *                                                                           *
+ * Check the signature of a V2 PAK file header, and that the areas it        *
+ * describes follow one another in the expected order.                       *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 if the header is valid, otherwise ERROR_INVALID_DATA                  *
+ * ------------------------------------------------------------------------- */
+static ULONG CheckHeader( PPAK2HEADER pHdr )
+{
+    if (( strcmp( pHdr->szName, PAK2SIGNATURE_DEVPACK ) != 0 ) ||
+        (( pHdr->ulVersion & 0xFFFF0000UL ) != ( PAK2_VERSION & 0xFFFF0000UL )) ||
+        ( pHdr->ulHeaderSize < sizeof( PAK2HEADER )) ||
+        ( pHdr->cEntries > 0x7FFF ) || ( pHdr->cStrRefs > 0x0FFFFFFF ) ||
+        ( pHdr->ulHashOffset < pHdr->ulHeaderSize ) ||
+        ( pHdr->ulIndexOffset < pHdr->ulHashOffset + pHdr->cEntries * sizeof( PAK2_HASH )) ||
+        ( pHdr->ulStrRefOffset < pHdr->ulIndexOffset + pHdr->cEntries * sizeof( PAK2_ENTRY )) ||
+        ( pHdr->ulPoolOffset < pHdr->ulStrRefOffset + pHdr->cStrRefs * sizeof( PAKSTRREF )) ||
+        ( pHdr->ulResidueOffset < pHdr->ulPoolOffset ) ||
+        ( pHdr->ulResidueOffset - pHdr->ulPoolOffset < pHdr->cbPool ) ||
+        ( pHdr->ulResidueOffset + pHdr->cbResidue < pHdr->ulResidueOffset ))
+        return ERROR_INVALID_DATA;
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * Pak2Attach                                                                *
+ *                                                                           *
+ * Set up a view of a V2 PAK file from memory holding (at least) all of its  *
+ * metadata, and check that the metadata is consistent.                      *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PBYTE     pbImage: File contents, starting with the PAK2HEADER          *
+ *   ULONG     cbImage: Number of bytes at pbImage                           *
+ *   PPAK2VIEW pView  : Receives the view                                    *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, or ERROR_INVALID_DATA                                     *
+ * ------------------------------------------------------------------------- */
+ULONG Pak2Attach( PBYTE pbImage, ULONG cbImage, PPAK2VIEW pView )
+{
+    PPAK2HEADER pHdr = (PPAK2HEADER) pbImage;
+    PPAK2_ENTRY pEntry;
+    PBYTE       pbRec;
+    ULONG       i;
+
+    memset( pView, 0, sizeof( PAK2VIEW ));
+    if (( cbImage < sizeof( PAK2HEADER )) || ( CheckHeader( pHdr ) != NO_ERROR ) ||
+        ( pHdr->ulResidueOffset + pHdr->cbResidue > cbImage ))
+        return ERROR_INVALID_DATA;
+
+    pView->pHdr      = pHdr;
+    pView->pHashes   = (PPAK2_HASH)( pbImage + pHdr->ulHashOffset );
+    pView->pIndex    = (PPAK2_ENTRY)( pbImage + pHdr->ulIndexOffset );
+    pView->pStrRefs  = (PPAKSTRREF)( pbImage + pHdr->ulStrRefOffset );
+    pView->pbPool    = pbImage + pHdr->ulPoolOffset;
+    pView->pbResidue = pbImage + pHdr->ulResidueOffset;
+
+    for ( i = 0; i < pHdr->cEntries; i++ ) {
+        pEntry = pView->pIndex + i;
+        if (( pView->pHashes[ i ].ulEntry >= pHdr->cEntries ) ||
+            ( pEntry->ulFirstStr > pHdr->cStrRefs ) ||
+            ( pEntry->cStrs > pHdr->cStrRefs - pEntry->ulFirstStr ))
+            return ERROR_INVALID_DATA;
+    }
+    // ExpandString() copies pool records without checking them, so do it here
+    for ( i = 0; i < pHdr->cStrRefs; i++ ) {
+        if (( pHdr->cbPool < sizeof( USHORT ) + 1 ) ||
+            ( pView->pStrRefs[ i ].ulPoolOffset > pHdr->cbPool - sizeof( USHORT ) - 1 ))
+            return ERROR_INVALID_DATA;
+        pbRec = pView->pbPool + pView->pStrRefs[ i ].ulPoolOffset;
+        if ( *((PUSHORT) pbRec ) > pHdr->cbPool - pView->pStrRefs[ i ].ulPoolOffset - sizeof( USHORT ) - 1 )
+            return ERROR_INVALID_DATA;
+    }
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * Pak2Open                                                                  *
+ *                                                                           *
+ * Open a V2 PAK file by reading its metadata (everything except the         *
+ * segments) into memory.                                                    *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID     pHeap     : Heap for the metadata (or NULL)                   *
+ *   PSZ       pszPakFile: Name of the PAK file                              *
+ *   PPAK2VIEW pView     : Receives the view; close it with Pak2Close()      *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_INVALID_DATA if this is not a valid V2 PAK file,    *
+ *   otherwise an OS/2 error code                                            *
+ * ------------------------------------------------------------------------- */
+ULONG Pak2Open( PVOID pHeap, PSZ pszPakFile, PPAK2VIEW pView )
+{
+    HFILE      hf;
+    ULONG      ulResult,
+               cbMeta;
+    PAK2HEADER hdr;
+    PBYTE      pbMeta;
+    APIRET     rc;
+
+    memset( pView, 0, sizeof( PAK2VIEW ));
+    rc = DosOpen( pszPakFile, &hf, &ulResult, 0, 0,
+                  OPEN_ACTION_FAIL_IF_NEW | OPEN_ACTION_OPEN_IF_EXISTS,
+                  OPEN_FLAGS_FAIL_ON_ERROR | OPEN_FLAGS_SEQUENTIAL |
+                  OPEN_SHARE_DENYNONE | OPEN_ACCESS_READONLY, NULL );
+    if ( rc ) return rc;
+
+    rc = DosRead( hf, &hdr, sizeof( PAK2HEADER ), &ulResult );
+    if ( rc ) goto cleanup;
+    if (( ulResult < sizeof( PAK2HEADER )) || ( CheckHeader( &hdr ) != NO_ERROR )) {
+        rc = ERROR_INVALID_DATA;
+        goto cleanup;
+    }
+
+    // The residue is the last part of the metadata
+    cbMeta = hdr.ulResidueOffset + hdr.cbResidue;
+    if (( pbMeta = (PBYTE) PakAlloc( pHeap, cbMeta )) == NULL ) {
+        rc = ERROR_NOT_ENOUGH_MEMORY;
+        goto cleanup;
+    }
+    memcpy( pbMeta, &hdr, sizeof( PAK2HEADER ));
+    rc = DosRead( hf, pbMeta + sizeof( PAK2HEADER ), cbMeta - sizeof( PAK2HEADER ), &ulResult );
+    if ( !rc && ulResult < cbMeta - sizeof( PAK2HEADER )) rc = ERROR_HANDLE_EOF;
+    if ( !rc ) rc = Pak2Attach( pbMeta, cbMeta, pView );
+    if ( rc )
+        PakFree( pHeap, pbMeta );
+    else
+        pView->pbMeta = pbMeta;
+
+cleanup:
+    DosClose( hf );
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- */
+VOID Pak2Close( PVOID pHeap, PPAK2VIEW pView )
+{
+    PakFree( pHeap, pView->pbMeta );
+    memset( pView, 0, sizeof( PAK2VIEW ));
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * FindHash                                                                  *
+ *                                                                           *
+ * Binary search a V2 hash table for the first entry with the given hash.    *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   Position of the first entry with a hash not less than ulHash            *
+ * ------------------------------------------------------------------------- */
+static ULONG FindHash( PPAK2_HASH pHashes, ULONG cEntries, ULONG ulHash )
+{
+    ULONG ulLow  = 0,
+          ulHigh = cEntries,
+          ulMid;
+
+    while ( ulLow < ulHigh ) {
+        ulMid = ( ulLow + ulHigh ) / 2;
+        if ( pHashes[ ulMid ].ulNameHash < ulHash )
+            ulLow = ulMid + 1;
+        else
+            ulHigh = ulMid;
+    }
+    return ulLow;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * Pak2FindEntry                                                             *
+ *                                                                           *
+ * Find a printer in an open V2 PAK file by its name, which is not           *
+ * case-sensitive.  If no name is given, the first printer is returned.      *
+ *                                                                           *
+ * RETURNS: PPAK2_ENTRY                                                      *
+ *   Pointer to the directory entry, or NULL if not found                    *
+ * ------------------------------------------------------------------------- */
+PPAK2_ENTRY Pak2FindEntry( PPAK2VIEW pView, PSZ pszDeviceName )
+{
+    PPAK2_ENTRY pEntry;
+    ULONG       cEntries = pView->pHdr->cEntries,
+                ulHash,
+                i;
+
+    if ( !pszDeviceName ) return cEntries ? pView->pIndex : NULL;
+
+    ulHash = Pak2HashName( pszDeviceName, sizeof( pEntry->devV1.szDeviceName ));
+    for ( i = FindHash( pView->pHashes, cEntries, ulHash );
+          i < cEntries && pView->pHashes[ i ].ulNameHash == ulHash; i++ )
+    {
+        pEntry = pView->pIndex + pView->pHashes[ i ].ulEntry;
+        if ( strnicmp( pEntry->devV1.szDeviceName, pszDeviceName,
+                       sizeof( pEntry->devV1.szDeviceName )) == 0 )
+            return pEntry;
+    }
+    return NULL;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * Pak2Lookup                                                                *
+ *                                                                           *
+ * Find a printer in a V2 PAK file without loading all of its metadata:      *
+ * only the header, the hash table and the matching directory entry are      *
+ * read.  If no name is given, the first printer is returned.                *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID       pHeap        : Heap for temporary memory (or NULL)          *
+ *   PSZ         pszPakFile   : Name of the PAK file                         *
+ *   PSZ         pszDeviceName: Printer name (or NULL)                       *
+ *   PPAK2_ENTRY pEntry       : Receives the directory entry                 *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_PAK_NO_DEVICE if the printer was not found,         *
+ *   ERROR_INVALID_DATA if this is not a valid V2 PAK file, otherwise an     *
+ *   OS/2 error code                                                         *
+ * ------------------------------------------------------------------------- */
+ULONG Pak2Lookup( PVOID pHeap, PSZ pszPakFile, PSZ pszDeviceName, PPAK2_ENTRY pEntry )
+{
+    HFILE       hf;
+    ULONG       ulResult,
+                ulHash,
+                ulPos,
+                cb,
+                i;
+    PBYTE       pbMem = NULL;
+    PPAK2HEADER pHdr;
+    PPAK2_HASH  pHashes;
+    APIRET      rc;
+
+    rc = DosOpen( pszPakFile, &hf, &ulResult, 0, 0,
+                  OPEN_ACTION_FAIL_IF_NEW | OPEN_ACTION_OPEN_IF_EXISTS,
+                  OPEN_FLAGS_FAIL_ON_ERROR | OPEN_FLAGS_RANDOM |
+                  OPEN_SHARE_DENYNONE | OPEN_ACCESS_READONLY, NULL );
+    if ( rc ) return rc;
+
+    // Header and hash table are read together (they are normally adjacent)
+    if (( pbMem = (PBYTE) PakAlloc( pHeap, sizeof( PAK2HEADER ))) == NULL ) {
+        rc = ERROR_NOT_ENOUGH_MEMORY;
+        goto cleanup;
+    }
+    rc = DosRead( hf, pbMem, sizeof( PAK2HEADER ), &ulResult );
+    if ( !rc && (( ulResult < sizeof( PAK2HEADER )) ||
+                 ( CheckHeader( (PPAK2HEADER) pbMem ) != NO_ERROR )))
+        rc = ERROR_INVALID_DATA;
+    if ( rc ) goto cleanup;
+
+    pHdr = (PPAK2HEADER) pbMem;
+    ulPos = 0;
+    if ( pszDeviceName ) {
+        cb = pHdr->ulHashOffset + pHdr->cEntries * sizeof( PAK2_HASH );
+        ulHash = Pak2HashName( pszDeviceName, sizeof( pEntry->devV1.szDeviceName ));
+        PakFree( pHeap, pbMem );
+        if (( pbMem = (PBYTE) PakAlloc( pHeap, cb )) == NULL ) {
+            rc = ERROR_NOT_ENOUGH_MEMORY;
+            goto cleanup;
+        }
+        rc = DosSetFilePtr( hf, 0, FILE_BEGIN, &ulResult );
+        if ( !rc ) rc = DosRead( hf, pbMem, cb, &ulResult );
+        if ( !rc && ulResult < cb ) rc = ERROR_HANDLE_EOF;
+        if ( rc ) goto cleanup;
+        pHdr    = (PPAK2HEADER) pbMem;
+        pHashes = (PPAK2_HASH)( pbMem + pHdr->ulHashOffset );
+        i = FindHash( pHashes, pHdr->cEntries, ulHash );
+    }
+    else i = 0;
+
+    // Check each directory entry whose name has the same hash
+    rc = ERROR_PAK_NO_DEVICE;
+    while ( i < pHdr->cEntries ) {
+        if ( pszDeviceName ) {
+            if ( pHashes[ i ].ulNameHash != ulHash ) break;
+            ulPos = pHashes[ i ].ulEntry;
+        }
+        if ( ulPos >= pHdr->cEntries ) {
+            rc = ERROR_INVALID_DATA;
+            break;
+        }
+        ulPos = pHdr->ulIndexOffset + ulPos * sizeof( PAK2_ENTRY );
+        rc = DosSetFilePtr( hf, ulPos, FILE_BEGIN, &ulResult );
+        if ( !rc ) rc = DosRead( hf, pEntry, sizeof( PAK2_ENTRY ), &ulResult );
+        if ( !rc && ulResult < sizeof( PAK2_ENTRY )) rc = ERROR_HANDLE_EOF;
+        if ( rc ) break;
+        if ( !pszDeviceName ||
+             strnicmp( pEntry->devV1.szDeviceName, pszDeviceName,
+                       sizeof( pEntry->devV1.szDeviceName )) == 0 )
+            break;
+        rc = ERROR_PAK_NO_DEVICE;
+        i++;
+    }
+
+cleanup:
+    PakFree( pHeap, pbMem );
+    DosClose( hf );
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * Pak2StringMap                                                             *
+ *                                                                           *
+ * Describe the pre-decompressed strings of a printer's segment, for use as  *
+ * PAKARENA.pStrMap while formatting it.                                     *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAK2VIEW   pView    : V2 PAK file                                      *
+ *   PPAK2_ENTRY pEntry   : Index entry of the printer                       *
+ *   PBYTE       pbSegment: The printer's segment, in memory                 *
+ *   PPAKSTRMAP  pMap     : Receives the string map                          *
+ * ------------------------------------------------------------------------- */
+VOID Pak2StringMap( PPAK2VIEW pView, PPAK2_ENTRY pEntry, PBYTE pbSegment,
+                    PPAKSTRMAP pMap )
+{
+    pMap->pbSegment = pbSegment;
+    pMap->cbSegment = pEntry->devV1.ulSize;
+    pMap->pRefs     = pView->pStrRefs + pEntry->ulFirstStr;
+    pMap->cRefs     = pEntry->cStrs;
+    pMap->pbPool    = pView->pbPool;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * Pak2BuildV1Directory                                                      *
+ *                                                                           *
+ * Create a V1-style directory (as returned by PakLoadDirectory) for a V2    *
+ * PAK file.  The entries are in their original order, but their offsets     *
+ * are those of the segments within the V2 file.                             *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, otherwise an OS/2 error code                              *
+ * ------------------------------------------------------------------------- */
+ULONG Pak2BuildV1Directory( PVOID pHeap, PPAK2VIEW pView, PBYTE *ppDirectoryMem )
+{
+    PPAK_DEV_DIRENTRY pDir;
+    PPAK2_ENTRY       pEntry;
+    PBYTE             pMem;
+    ULONG             i;
+
+    pMem = (PBYTE) PakAlloc( pHeap, sizeof( PAKSIGNATURE ) +
+                             pView->pHdr->cEntries * sizeof( PAK_DEV_DIRENTRY ));
+    if (( *ppDirectoryMem = pMem ) == NULL ) return ERROR_NOT_ENOUGH_MEMORY;
+
+    memcpy( pMem, &(pView->pHdr->sigV1), sizeof( PAKSIGNATURE ));
+    ((PPAKSIGNATURE) pMem )->iEntries = (SHORT) pView->pHdr->cEntries;
+    pDir = (PPAK_DEV_DIRENTRY)( pMem + sizeof( PAKSIGNATURE ));
+    for ( i = 0, pEntry = pView->pIndex; i < pView->pHdr->cEntries; i++, pEntry++ ) {
+        pDir[ i ] = pEntry->devV1;
+        pDir[ i ].ulOffset = pEntry->ulOffset;
+    }
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- */
+ULONG Pak2LoadV1Directory( PVOID pHeap, PSZ pszPakFile, PBYTE *ppDirectoryMem )
+{
+    PAK2VIEW view;
+    APIRET   rc;
+
+    *ppDirectoryMem = NULL;
+    if (( rc = Pak2Open( pHeap, pszPakFile, &view )) != NO_ERROR ) return rc;
+    rc = Pak2BuildV1Directory( pHeap, &view, ppDirectoryMem );
+    Pak2Close( pHeap, &view );
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * RenderPak2Device                                                          *
+ *                                                                           *
+ * RenderPakDevice() for V2 PAK files, using a hashed lookup of the printer. *
+ * (The string pool is not read for a single printer; it is only worth       *
+ * using when the metadata has been loaded with Pak2Open() for many.)        *
+ * ------------------------------------------------------------------------- */
+ULONG RenderPak2Device( PVOID pHeap, PPAKARENA pArena, PSZ pszPakFile,
+                        PSZ pszDeviceName, USHORT fsMode, POUTBUF pOut )
+{
+    PAK2_ENTRY entry;
+    PBYTE      pBuf;
+    APIRET     rc;
+
+    rc = Pak2Lookup( pHeap, pszPakFile, pszDeviceName, &entry );
+    if ( !rc ) rc = PakLoadSegment( pHeap, pszPakFile, entry.ulOffset, entry.devV1.ulSize, &pBuf );
+    if ( rc ) return rc;
+
+    if ( pArena ) ArenaReset( pArena, 0 );
+    rc = FormatPakDevice( &(entry.devV1), pBuf, fsMode, pArena, pOut );
+    PakFree( pHeap, pBuf );
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ReadWholeFile                                                             *
+ *                                                                           *
+ * Read an entire file into memory.                                          *
+ * ------------------------------------------------------------------------- */
+static ULONG ReadWholeFile( PVOID pHeap, PSZ pszFile, PBYTE *ppb, PULONG pcb )
+{
+    FILESTATUS3 fs3;
+    APIRET      rc;
+
+    *ppb = NULL;
+    rc = DosQueryPathInfo( pszFile, FIL_STANDARD, &fs3, sizeof( fs3 ));
+    if ( rc ) return rc;
+    *pcb = fs3.cbFile;
+    return PakLoadSegment( pHeap, pszFile, 0, fs3.cbFile, ppb );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * WriteBlock                                                                *
+ *                                                                           *
+ * Write a block of data (or, if pb is NULL, cb zero bytes) to a file.       *
+ * ------------------------------------------------------------------------- */
+static ULONG WriteBlock( HFILE hf, PVOID pb, ULONG cb )
+{
+    static BYTE abZero[ PAK2_ALIGN ];
+    ULONG  ulChunk,
+           ulResult;
+    APIRET rc;
+
+    if ( pb ) {
+        rc = DosWrite( hf, pb, cb, &ulResult );
+        return ( !rc && ulResult < cb ) ? ERROR_WRITE_FAULT : rc;
+    }
+    while ( cb ) {
+        ulChunk = ( cb < sizeof( abZero )) ? cb : sizeof( abZero );
+        rc = DosWrite( hf, abZero, ulChunk, &ulResult );
+        if ( !rc && ulResult < ulChunk ) rc = ERROR_WRITE_FAULT;
+        if ( rc ) return rc;
+        cb -= ulChunk;
+    }
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- */
+static ULONG CreateOutputFile( PSZ pszFile, PHFILE phf )
+{
+    ULONG ulAction;
+
+    return DosOpen( pszFile, phf, &ulAction, 0, FILE_NORMAL,
+                    OPEN_ACTION_CREATE_IF_NEW | OPEN_ACTION_REPLACE_IF_EXISTS,
+                    OPEN_FLAGS_FAIL_ON_ERROR | OPEN_FLAGS_SEQUENTIAL |
+                    OPEN_SHARE_DENYREADWRITE | OPEN_ACCESS_WRITEONLY, NULL );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PoolIntern                                                                *
+ *                                                                           *
+ * Add a string to the pool being built, unless it is already there.         *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   Offset of the string's pool record, or 0xFFFFFFFF if out of memory      *
+ * ------------------------------------------------------------------------- */
+static ULONG PoolIntern( PPOOLBUILD pPool, PBYTE pb, USHORT cb )
+{
+    PULONG aulNew;
+    PBYTE  pbRec;
+    ULONG  ulHash,
+           ulSlot,
+           ulOffset,
+           cNew,
+           i;
+
+    // Keep the hash table no more than half full
+    if (( pPool->cUsed + 1 ) * 2 > pPool->cSlots ) {
+        cNew = pPool->cSlots ? pPool->cSlots * 2 : POOL_SLOTS;
+        if (( aulNew = (PULONG) PakAlloc( pPool->out.pHeap, cNew * sizeof( ULONG ))) == NULL )
+            return 0xFFFFFFFFUL;
+        memset( aulNew, 0, cNew * sizeof( ULONG ));
+        for ( i = 0; i < pPool->cSlots; i++ ) {
+            if ( !pPool->aulSlots[ i ] ) continue;
+            pbRec  = pPool->out.pbData + pPool->aulSlots[ i ] - 1;
+            ulSlot = Pak2HashData( pbRec + sizeof( USHORT ), *((PUSHORT) pbRec )) & ( cNew - 1 );
+            while ( aulNew[ ulSlot ] ) ulSlot = ( ulSlot + 1 ) & ( cNew - 1 );
+            aulNew[ ulSlot ] = pPool->aulSlots[ i ];
+        }
+        PakFree( pPool->out.pHeap, pPool->aulSlots );
+        pPool->aulSlots = aulNew;
+        pPool->cSlots   = cNew;
+    }
+
+    ulHash = Pak2HashData( pb, cb );
+    for ( ulSlot = ulHash & ( pPool->cSlots - 1 ); pPool->aulSlots[ ulSlot ];
+          ulSlot = ( ulSlot + 1 ) & ( pPool->cSlots - 1 ))
+    {
+        pbRec = pPool->out.pbData + pPool->aulSlots[ ulSlot ] - 1;
+        if (( *((PUSHORT) pbRec ) == cb ) && ( memcmp( pbRec + sizeof( USHORT ), pb, cb ) == 0 ))
+            return pPool->aulSlots[ ulSlot ] - 1;
+    }
+
+    // New string: append a record (length, string, null)
+    ulOffset = pPool->out.cbData;
+    OutWrite( &(pPool->out), (PBYTE) &cb, sizeof( USHORT ));
+    OutWrite( &(pPool->out), pb, cb );
+    OutWrite( &(pPool->out), "", 1 );
+    if ( pPool->out.fError ) return 0xFFFFFFFFUL;
+    pPool->aulSlots[ ulSlot ] = ulOffset + 1;
+    pPool->cUsed++;
+    return ulOffset;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * MapSegmentStrings                                                         *
+ *                                                                           *
+ * Decompress every compressed string in a device segment's information      *
+ * segment into the pool, and add a reference for each to pRefs.  (Not all   *
+ * of the information segment is strings, but any reference made is still    *
+ * correct: it is to an offset which follows a null, so it is decompressed   *
+ * exactly as DecompressStringDict() would do it.)                           *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, or ERROR_NOT_ENOUGH_MEMORY                                *
+ * ------------------------------------------------------------------------- */
+static ULONG MapSegmentStrings( PPOOLBUILD pPool, POUTBUF pRefs, PPAKDICT pDict,
+                                PBYTE pbSeg, ULONG cbSeg, PULONG pcStrs )
+{
+    DESPPD    desPPD;
+    PAKSTRREF ref;
+    PBYTE     pbEnd,
+              pbScratch;
+    ULONG     ulPos,
+              ulPool,
+              i;
+    LONG      lLen;
+    BOOL      fCompressed;
+
+    *pcStrs = 0;
+    if ( cbSeg < sizeof( DESPPD )) return NO_ERROR;
+    memcpy( &desPPD, pbSeg, sizeof( DESPPD ));
+    ulPos = sizeof( DESPPD ) + desPPD.stUIList.usBlockListSize +
+            desPPD.stUICList.usNumOfUICs * sizeof( UIC_BLOCK );
+
+    while ( ulPos < cbSeg ) {
+        if (( pbEnd = memchr( pbSeg + ulPos, 0, cbSeg - ulPos )) == NULL ) break;
+
+        for ( i = ulPos, fCompressed = FALSE; !fCompressed && pbSeg + i < pbEnd; i++ )
+            if ( pbSeg[ i ] >= 128 || pbSeg[ i ] == '<') fCompressed = TRUE;
+
+        if ( fCompressed && ( lLen = DecompressedLength( pDict, pbSeg + ulPos )) >= 0 && lLen < 0xFFFF ) {
+            if (( pbScratch = (PBYTE) PakAlloc( pPool->out.pHeap, lLen + 1 )) == NULL )
+                return ERROR_NOT_ENOUGH_MEMORY;
+            DecompressStringDict( pDict, pbSeg + ulPos, pbScratch );
+            ulPool = PoolIntern( pPool, pbScratch, (USHORT) lLen );
+            PakFree( pPool->out.pHeap, pbScratch );
+            if ( ulPool == 0xFFFFFFFFUL ) return ERROR_NOT_ENOUGH_MEMORY;
+
+            ref.ulSegOffset  = ulPos;
+            ref.ulPoolOffset = ulPool;
+            OutWrite( pRefs, (PBYTE) &ref, sizeof( PAKSTRREF ));
+            if ( pRefs->fError ) return ERROR_NOT_ENOUGH_MEMORY;
+            (*pcStrs)++;
+        }
+        ulPos = ( pbEnd - pbSeg ) + 1;
+    }
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- */
+static int CompareHashes( const void *p1, const void *p2 )
+{
+    PPAK2_HASH ph1 = (PPAK2_HASH) p1,
+               ph2 = (PPAK2_HASH) p2;
+
+    if ( ph1->ulNameHash != ph2->ulNameHash )
+        return ( ph1->ulNameHash < ph2->ulNameHash ) ? -1 : 1;
+    return ( ph1->ulEntry < ph2->ulEntry ) ? -1 : (( ph1->ulEntry > ph2->ulEntry ) ? 1 : 0 );
+}
+
+
+/* ------------------------------------------------------------------------- */
+static int CompareV1Offsets( const void *p1, const void *p2 )
+{
+    PSEGORDER po1 = (PSEGORDER) p1,
+              po2 = (PSEGORDER) p2;
+
+    if ( po1->ulV1Offset != po2->ulV1Offset )
+        return ( po1->ulV1Offset < po2->ulV1Offset ) ? -1 : 1;
+    return ( po1->ulEntry < po2->ulEntry ) ? -1 : (( po1->ulEntry > po2->ulEntry ) ? 1 : 0 );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakConvertToV2                                                            *
+ *                                                                           *
+ * Convert a V1 device PAK file to the V2 format.                            *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID    pHeap    : Heap for working memory (or NULL)                   *
+ *   PPAKDICT pDict    : Dictionary the V1 file was compiled with (or NULL)  *
+ *   PSZ      pszV1File: Name of the V1 PAK file to read                     *
+ *   PSZ      pszV2File: Name of the V2 PAK file to create                   *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_INVALID_DATA if the V1 file is not valid,           *
+ *   otherwise an OS/2 error code                                            *
+ * ------------------------------------------------------------------------- */
+ULONG PakConvertToV2( PVOID pHeap, PPAKDICT pDict, PSZ pszV1File, PSZ pszV2File )
+{
+    PBYTE             pbV1 = NULL;
+    ULONG             cbV1,
+                      ulPos,
+                      ulEnd,
+                      cEntries,
+                      i, j;
+    PPAKSIGNATURE     pSig;
+    PPAK_DEV_DIRENTRY pDir;
+    PPAK2_ENTRY       pIndex = NULL,
+                      pEntry,
+                      pPrev;
+    PPAK2_HASH        pHashes = NULL;
+    PSEGORDER         pOrder = NULL;
+    PAK2HEADER        hdr;
+    PAK2_RESIDUE      res;
+    POOLBUILD         pool = {0};
+    OUTBUF            refs = {0},
+                      residue = {0};
+    HFILE             hf = NULLHANDLE;
+    APIRET            rc;
+
+    pool.out.pHeap = refs.pHeap = residue.pHeap = pHeap;
+    if (( rc = ReadWholeFile( pHeap, pszV1File, &pbV1, &cbV1 )) != NO_ERROR ) return rc;
+
+    // Check the V1 header and directory
+    pSig = (PPAKSIGNATURE) pbV1;
+    pDir = (PPAK_DEV_DIRENTRY)( pbV1 + sizeof( PAKSIGNATURE ));
+    if (( cbV1 < sizeof( PAKSIGNATURE )) ||
+        ( strcmp( pSig->szName, PAKSIGNATURE_DEVPACK_V1 ) != 0 ) || ( pSig->iEntries < 0 ) ||
+        ( sizeof( PAKSIGNATURE ) + pSig->iEntries * sizeof( PAK_DEV_DIRENTRY ) > cbV1 ))
+    {
+        rc = ERROR_INVALID_DATA;
+        goto cleanup;
+    }
+    cEntries = pSig->iEntries;
+    for ( i = 0; i < cEntries; i++ ) {
+        if (( pDir[ i ].ulOffset > cbV1 ) || ( pDir[ i ].ulSize > cbV1 - pDir[ i ].ulOffset )) {
+            rc = ERROR_INVALID_DATA;
+            goto cleanup;
+        }
+    }
+
+    pIndex  = (PPAK2_ENTRY) PakAlloc( pHeap, ( cEntries + 1 ) * sizeof( PAK2_ENTRY ));
+    pHashes = (PPAK2_HASH) PakAlloc( pHeap, ( cEntries + 1 ) * sizeof( PAK2_HASH ));
+    pOrder  = (PSEGORDER) PakAlloc( pHeap, ( cEntries + 1 ) * sizeof( SEGORDER ));
+    if ( !pIndex || !pHashes || !pOrder ) {
+        rc = ERROR_NOT_ENOUGH_MEMORY;
+        goto cleanup;
+    }
+
+    // Directory (in V1 order) with each entry's strings decompressed in turn
+    memset( pIndex, 0, cEntries * sizeof( PAK2_ENTRY ));
+    for ( i = 0, pEntry = pIndex; i < cEntries; i++, pEntry++ ) {
+        pEntry->devV1         = pDir[ i ];
+        pEntry->ulContentHash = Pak2HashData( pbV1 + pDir[ i ].ulOffset, pDir[ i ].ulSize );
+        pEntry->ulFirstStr    = refs.cbData / sizeof( PAKSTRREF );
+        rc = MapSegmentStrings( &pool, &refs, pDict, pbV1 + pDir[ i ].ulOffset,
+                                pDir[ i ].ulSize, &(pEntry->cStrs) );
+        if ( rc ) goto cleanup;
+
+        pHashes[ i ].ulNameHash = Pak2HashName( pDir[ i ].szDeviceName, sizeof( pDir[ i ].szDeviceName ));
+        pHashes[ i ].ulEntry    = i;
+        pOrder[ i ].ulV1Offset  = pDir[ i ].ulOffset;
+        pOrder[ i ].ulEntry     = i;
+    }
+    qsort( pHashes, cEntries, sizeof( PAK2_HASH ), CompareHashes );
+    qsort( pOrder, cEntries, sizeof( SEGORDER ), CompareV1Offsets );
+
+    // Collect any V1 bytes not part of the header, directory or a segment
+    ulPos = sizeof( PAKSIGNATURE ) + cEntries * sizeof( PAK_DEV_DIRENTRY );
+    for ( i = 0; i <= cEntries; i++ ) {
+        pEntry = ( i < cEntries ) ? pIndex + pOrder[ i ].ulEntry : NULL;
+        ulEnd  = pEntry ? pEntry->devV1.ulOffset : cbV1;
+        if ( ulEnd > ulPos ) {
+            for ( j = ulPos; j < ulEnd && !pbV1[ j ]; j++ );
+            if ( j < ulEnd ) {
+                res.ulV1Offset = ulPos;
+                res.cb         = ulEnd - ulPos;
+                OutWrite( &residue, (PBYTE) &res, sizeof( PAK2_RESIDUE ));
+                OutWrite( &residue, pbV1 + ulPos, res.cb );
+            }
+        }
+        if ( pEntry && pEntry->devV1.ulOffset + pEntry->devV1.ulSize > ulPos )
+            ulPos = pEntry->devV1.ulOffset + pEntry->devV1.ulSize;
+    }
+    if ( residue.fError ) {
+        rc = ERROR_NOT_ENOUGH_MEMORY;
+        goto cleanup;
+    }
+
+    // Lay out the file: metadata first, then the segments in their V1 order
+    memset( &hdr, 0, sizeof( PAK2HEADER ));
+    strcpy( hdr.szName, PAK2SIGNATURE_DEVPACK );
+    hdr.ulVersion       = PAK2_VERSION;
+    hdr.ulHeaderSize    = sizeof( PAK2HEADER );
+    hdr.cEntries        = cEntries;
+    hdr.ulHashOffset    = sizeof( PAK2HEADER );
+    hdr.ulIndexOffset   = hdr.ulHashOffset + cEntries * sizeof( PAK2_HASH );
+    hdr.ulStrRefOffset  = hdr.ulIndexOffset + cEntries * sizeof( PAK2_ENTRY );
+    hdr.cStrRefs        = refs.cbData / sizeof( PAKSTRREF );
+    hdr.ulPoolOffset    = hdr.ulStrRefOffset + refs.cbData;
+    hdr.cbPool          = pool.out.cbData;
+    hdr.ulResidueOffset = hdr.ulPoolOffset + pool.out.cbData;
+    hdr.cbResidue       = residue.cbData;
+    hdr.ulV1Size        = cbV1;
+    hdr.ulAlign         = PAK2_ALIGN;
+    hdr.sigV1           = *pSig;
+
+    ulPos = PAK2_ALIGNED( hdr.ulResidueOffset + hdr.cbResidue );
+    for ( i = 0; i < cEntries; i++ ) {
+        pEntry = pIndex + pOrder[ i ].ulEntry;
+        // Segments with identical contents are stored only once
+        for ( j = 0; j < i; j++ ) {
+            pPrev = pIndex + pOrder[ j ].ulEntry;
+            if (( pPrev->ulContentHash == pEntry->ulContentHash ) &&
+                ( pPrev->devV1.ulSize == pEntry->devV1.ulSize ) &&
+                ( memcmp( pbV1 + pPrev->devV1.ulOffset, pbV1 + pEntry->devV1.ulOffset,
+                          pEntry->devV1.ulSize ) == 0 ))
+                break;
+        }
+        if ( j < i )
+            pEntry->ulOffset = pPrev->ulOffset;
+        else {
+            pEntry->ulOffset = ulPos;
+            ulPos = PAK2_ALIGNED( ulPos + pEntry->devV1.ulSize );
+        }
+    }
+
+    // Write it all out
+    if (( rc = CreateOutputFile( pszV2File, &hf )) != NO_ERROR ) goto cleanup;
+    rc = WriteBlock( hf, &hdr, sizeof( PAK2HEADER ));
+    if ( !rc ) rc = WriteBlock( hf, pHashes, cEntries * sizeof( PAK2_HASH ));
+    if ( !rc ) rc = WriteBlock( hf, pIndex, cEntries * sizeof( PAK2_ENTRY ));
+    if ( !rc && refs.cbData )     rc = WriteBlock( hf, refs.pbData, refs.cbData );
+    if ( !rc && pool.out.cbData ) rc = WriteBlock( hf, pool.out.pbData, pool.out.cbData );
+    if ( !rc && residue.cbData )  rc = WriteBlock( hf, residue.pbData, residue.cbData );
+    ulPos = hdr.ulResidueOffset + hdr.cbResidue;
+    for ( i = 0; !rc && i < cEntries; i++ ) {
+        pEntry = pIndex + pOrder[ i ].ulEntry;
+        if ( pEntry->ulOffset < ulPos ) continue;          // shared segment
+        rc = WriteBlock( hf, NULL, pEntry->ulOffset - ulPos );
+        if ( !rc ) rc = WriteBlock( hf, pbV1 + pEntry->devV1.ulOffset, pEntry->devV1.ulSize );
+        ulPos = pEntry->ulOffset + pEntry->devV1.ulSize;
+    }
+    DosClose( hf );
+    if ( rc ) DosDelete( pszV2File );
+
+cleanup:
+    OutFree( &refs );
+    OutFree( &residue );
+    OutFree( &(pool.out) );
+    PakFree( pHeap, pool.aulSlots );
+    PakFree( pHeap, pOrder );
+    PakFree( pHeap, pHashes );
+    PakFree( pHeap, pIndex );
+    PakFree( pHeap, pbV1 );
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PakConvertToV1                                                            *
+ *                                                                           *
+ * Convert a V2 device PAK file back to the V1 format.  The result is        *
+ * identical to the V1 file from which the V2 file was made.                 *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PVOID pHeap    : Heap for working memory (or NULL)                      *
+ *   PSZ   pszV2File: Name of the V2 PAK file to read                        *
+ *   PSZ   pszV1File: Name of the V1 PAK file to create                      *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_INVALID_DATA if the V2 file is not valid,           *
+ *   ERROR_CRC if a segment does not match its content hash, otherwise an    *
+ *   OS/2 error code                                                         *
+ * ------------------------------------------------------------------------- */
+ULONG PakConvertToV1( PVOID pHeap, PSZ pszV2File, PSZ pszV1File )
+{
+    PAK2VIEW          view;
+    PPAK2_ENTRY       pEntry;
+    PPAK_DEV_DIRENTRY pDir;
+    PPAK2_RESIDUE     pRes;
+    PBYTE             pbV1 = NULL,
+                      pbSeg;
+    ULONG             cbV1,
+                      ulPos,
+                      i;
+    HFILE             hf;
+    APIRET            rc;
+
+    if (( rc = Pak2Open( pHeap, pszV2File, &view )) != NO_ERROR ) return rc;
+
+    cbV1 = view.pHdr->ulV1Size;
+    if ( cbV1 < sizeof( PAKSIGNATURE ) + view.pHdr->cEntries * sizeof( PAK_DEV_DIRENTRY )) {
+        rc = ERROR_INVALID_DATA;
+        goto cleanup;
+    }
+    if (( pbV1 = (PBYTE) PakAlloc( pHeap, cbV1 )) == NULL ) {
+        rc = ERROR_NOT_ENOUGH_MEMORY;
+        goto cleanup;
+    }
+    memset( pbV1, 0, cbV1 );
+
+    // Header and directory exactly as they were
+    memcpy( pbV1, &(view.pHdr->sigV1), sizeof( PAKSIGNATURE ));
+    pDir = (PPAK_DEV_DIRENTRY)( pbV1 + sizeof( PAKSIGNATURE ));
+    for ( i = 0, pEntry = view.pIndex; i < view.pHdr->cEntries; i++, pEntry++ )
+        pDir[ i ] = pEntry->devV1;
+
+    // Segments at their original offsets
+    for ( i = 0, pEntry = view.pIndex; i < view.pHdr->cEntries; i++, pEntry++ ) {
+        if (( pEntry->devV1.ulOffset > cbV1 ) || ( pEntry->devV1.ulSize > cbV1 - pEntry->devV1.ulOffset )) {
+            rc = ERROR_INVALID_DATA;
+            goto cleanup;
+        }
+        rc = PakLoadSegment( pHeap, pszV2File, pEntry->ulOffset, pEntry->devV1.ulSize, &pbSeg );
+        if ( rc ) goto cleanup;
+        if ( Pak2HashData( pbSeg, pEntry->devV1.ulSize ) != pEntry->ulContentHash )
+            rc = ERROR_CRC;
+        else
+            memcpy( pbV1 + pEntry->devV1.ulOffset, pbSeg, pEntry->devV1.ulSize );
+        PakFree( pHeap, pbSeg );
+        if ( rc ) goto cleanup;
+    }
+
+    // Anything else that was in the V1 file
+    for ( ulPos = 0; ulPos + sizeof( PAK2_RESIDUE ) <= view.pHdr->cbResidue; ulPos += pRes->cb ) {
+        pRes = (PPAK2_RESIDUE)( view.pbResidue + ulPos );
+        ulPos += sizeof( PAK2_RESIDUE );
+        if (( pRes->cb > view.pHdr->cbResidue - ulPos ) ||
+            ( pRes->ulV1Offset > cbV1 ) || ( pRes->cb > cbV1 - pRes->ulV1Offset ))
+        {
+            rc = ERROR_INVALID_DATA;
+            goto cleanup;
+        }
+        memcpy( pbV1 + pRes->ulV1Offset, view.pbResidue + ulPos, pRes->cb );
+    }
+
+    if (( rc = CreateOutputFile( pszV1File, &hf )) != NO_ERROR ) goto cleanup;
+    rc = WriteBlock( hf, pbV1, cbV1 );
+    DosClose( hf );
+    if ( rc ) DosDelete( pszV1File );
+
+cleanup:
+    PakFree( pHeap, pbV1 );
+    Pak2Close( pHeap, &view );
+    return rc;
+}
@@ -0,0 +1,123 @@
+/*
+ * pakv2.h
+ *
+ * Version 2 container format for device PAK files, with functions to read
+ * it and to convert between it and the original (V1) format.
+ *
+ * A V1 PAK file consists of a PAKSIGNATURE, an unsorted array of
+ * PAK_DEV_DIRENTRY, and the device segments; finding a printer means reading
+ * the whole directory and comparing names, and formatting one means
+ * decompressing each string of its information segment.  A V2 file is laid
+ * out as follows:
+ *
+ *   PAK2HEADER
+ *   PAK2_HASH[ cEntries ]    name hashes of the entries, in sorted order
+ *   PAK2_ENTRY[ cEntries ]   directory, in the original (V1) order
+ *   PAKSTRREF[ cStrRefs ]    string references for each entry in turn
+ *   string pool              decompressed strings, each stored only once
+ *   residue                  any bytes of the V1 file not covered by its
+ *                            header, directory or segments
+ *   segments                 device segments, unchanged, each starting on a
+ *                            PAK2_ALIGN boundary
+ *
+ * Finding one printer takes a read of the header and hash table (8 bytes per
+ * entry), a binary search, and a read of the matching directory entry.  For
+ * batch work, everything before the segments (the "metadata") is contiguous
+ * and may be read at once; the same structures can also be used directly on
+ * a whole-file image in memory.  The string pool then saves decompressing
+ * each string as it is formatted.  The V1 header and directory entries are
+ * kept, so that converting back to V1 gives a file identical to the
+ * original.
+ *
+ * Include this after <os2.h>, pt_struct.h, package.h and paklib.h.
+ */
+
+#ifndef pakv2_h_
+#define pakv2_h_
+
+#define PAK2SIGNATURE_DEVPACK   "PAKTOOL DDPAK V2.0"
+#define PAK2_VERSION            0x00020000
+#define PAK2_ALIGN              16          // segment alignment
+
+
+typedef struct _PAK2HEADER
+{
+    CHAR         szName[40];        // PAK2SIGNATURE_DEVPACK
+    ULONG        ulVersion;         // PAK2_VERSION
+    ULONG        ulHeaderSize;      // sizeof( PAK2HEADER )
+    ULONG        cEntries;          // number of directory entries
+    ULONG        ulHashOffset;      // file offset of hash table
+    ULONG        ulIndexOffset;     // file offset of directory
+    ULONG        ulStrRefOffset;    // file offset of string references
+    ULONG        cStrRefs;          // total number of string references
+    ULONG        ulPoolOffset;      // file offset of string pool
+    ULONG        cbPool;            // size of string pool
+    ULONG        ulResidueOffset;   // file offset of residue records
+    ULONG        cbResidue;         // size of residue records
+    ULONG        ulV1Size;          // size of the original V1 file
+    ULONG        ulAlign;           // segment alignment used
+    PAKSIGNATURE sigV1;             // original V1 header
+    CHAR         free[12];
+} PAK2HEADER, *PPAK2HEADER;
+
+typedef struct _PAK2_HASH
+{
+    ULONG        ulNameHash;        // Pak2HashName() of device name
+    ULONG        ulEntry;           // index of directory entry
+} PAK2_HASH, *PPAK2_HASH;
+
+typedef struct _PAK2_ENTRY
+{
+    PAK_DEV_DIRENTRY devV1;         // original V1 directory entry
+    ULONG        ulOffset;          // file offset of segment (size is devV1.ulSize)
+    ULONG        ulContentHash;     // Pak2HashData() of segment
+    ULONG        ulFirstStr;        // index of first string reference
+    ULONG        cStrs;             // number of string references
+    CHAR         free[12];
+} PAK2_ENTRY, *PPAK2_ENTRY;
+
+// Residue records (in the residue area) are a PAK2_RESIDUE followed by cb bytes
+typedef struct _PAK2_RESIDUE
+{
+    ULONG        ulV1Offset;        // offset of the bytes in the V1 file
+    ULONG        cb;                // number of bytes
+} PAK2_RESIDUE, *PPAK2_RESIDUE;
+
+
+/*
+ * An open V2 PAK file (or whole-file image).  All pointers refer to the
+ * metadata, which is either read by Pak2Open() or part of the image given
+ * to Pak2Attach().
+ */
+typedef struct _PAK2VIEW
+{
+    PPAK2HEADER  pHdr;
+    PPAK2_HASH   pHashes;
+    PPAK2_ENTRY  pIndex;
+    PPAKSTRREF   pStrRefs;
+    PBYTE        pbPool;
+    PBYTE        pbResidue;
+    PBYTE        pbMeta;            // metadata memory to free (NULL if attached)
+} PAK2VIEW, *PPAK2VIEW;
+
+
+ULONG       Pak2HashName( PSZ pszName, ULONG cchMax );
+ULONG       Pak2HashData( PBYTE pb, ULONG cb );
+
+ULONG       Pak2Lookup( PVOID pHeap, PSZ pszPakFile, PSZ pszDeviceName,
+                        PPAK2_ENTRY pEntry );
+ULONG       Pak2Open( PVOID pHeap, PSZ pszPakFile, PPAK2VIEW pView );
+ULONG       Pak2Attach( PBYTE pbImage, ULONG cbImage, PPAK2VIEW pView );
+VOID        Pak2Close( PVOID pHeap, PPAK2VIEW pView );
+PPAK2_ENTRY Pak2FindEntry( PPAK2VIEW pView, PSZ pszDeviceName );
+VOID        Pak2StringMap( PPAK2VIEW pView, PPAK2_ENTRY pEntry, PBYTE pbSegment,
+                           PPAKSTRMAP pMap );
+ULONG       Pak2BuildV1Directory( PVOID pHeap, PPAK2VIEW pView, PBYTE *ppDirectoryMem );
+ULONG       Pak2LoadV1Directory( PVOID pHeap, PSZ pszPakFile, PBYTE *ppDirectoryMem );
+ULONG       RenderPak2Device( PVOID pHeap, PPAKARENA pArena, PSZ pszPakFile,
+                              PSZ pszDeviceName, USHORT fsMode, POUTBUF pOut );
+
+ULONG       PakConvertToV2( PVOID pHeap, PPAKDICT pDict, PSZ pszV1File, PSZ pszV2File );
+ULONG       PakConvertToV1( PVOID pHeap, PSZ pszV2File, PSZ pszV1File );
+
+#endif
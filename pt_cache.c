@@ -0,0 +1,326 @@
+/*
+ * pt_cache.c
+ *
+ * PAKTOOL render cache.  When PAKTOOL_CACHE names a directory, the output of
+ * P, R and JSON for a single printer is kept there in a file named after a
+ * hash of the printer's segment, so that asking again for the same printer
+ * (or for an identical one in another PAK file) costs a hash and a file read
+ * rather than decompressing and formatting the whole segment.
+ *
+ * Each file begins with a header giving its full key: the FNV-1a hash,
+ * Adler-32 checksum, size and printer name of the segment, the output
+ * format, the PSDRIVER layout and the PAKTOOL version.  The key is compared
+ * on every read, and a file whose key differs is treated as missing (and is
+ * replaced).  Files are written under a temporary name and then renamed, so
+ * that another PAKTOOL sharing the directory never sees a partial file.
+ *
+ * Every hit rewrites the hit count in the header, which brings the file's
+ * last-write time up to date.  When the files in the directory come to more
+ * than PAKTOOL_CACHESIZE KB, those written or used least recently are
+ * deleted until they take up no more than CACHE_TRIM_PERCENT of it.
+ */
+
+#define INCL_DOSFILEMGR
+#define INCL_DOSMISC
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+#include "pakv2.h"
+#include "paktool.h"
+
+#define CACHE_MAGIC         "PTCACHE"
+#define CACHE_TRIM_PERCENT  90      // trimmed size, as a percentage of the limit
+#define CACHE_TEMP_TRIES    16      // temporary names tried before giving up
+
+// Header of a cache file; the key is everything before cHits
+typedef struct _CACHEHDR
+{
+    CHAR   achMagic[ 8 ];           // CACHE_MAGIC
+    CHAR   achVersion[ 8 ];         // PAKTOOL_VERSION
+    USHORT usDriver;                // PSDRIVER
+    USHORT fsMode;                  // DEV_PPD_DATA, DEV_TXT_DATA or DEV_JSON_DATA
+    ULONG  ulHash;                  // FNV-1a hash of the segment
+    ULONG  ulCheck;                 // Adler-32 checksum of the segment
+    ULONG  ulSize;                  // size of the segment
+    CHAR   szDeviceName[ 40 ];      // printer name (which appears in the output)
+    ULONG  cHits;                   // number of times read
+    ULONG  cbText;                  // size of the output which follows
+} CACHEHDR, *PCACHEHDR;
+
+#define CACHE_KEY_SIZE      offsetof( CACHEHDR, cHits )
+
+// One file found when trimming the cache
+typedef struct _CACHEFILE
+{
+    ULONG ulStamp;                  // last-write date and time (see FileStamp)
+    ULONG cbFile;                   // size in bytes
+    CHAR  szName[ 13 ];             // 8.3 file name
+} CACHEFILE, *PCACHEFILE;
+
+
+/* ------------------------------------------------------------------------- *
+ * CacheKey                                                                  *
+ *                                                                           *
+ * Fill in the key of a printer's cache file, and give its file name.        *
+ * ------------------------------------------------------------------------- */
+static void CacheKey( PPAK_DEV_DIRENTRY pEntry, PBYTE pbSegment, USHORT fsMode,
+                      PCACHEHDR pHdr, PSZ pszName )
+{
+    ULONG ulSum1 = 1,
+          ulSum2 = 0,
+          i;
+
+    memset( pHdr, 0, sizeof( CACHEHDR ));
+    strcpy( pHdr->achMagic, CACHE_MAGIC );
+    strncpy( pHdr->achVersion, PAKTOOL_VERSION, sizeof( pHdr->achVersion ));
+    pHdr->usDriver = PSDRIVER;
+    pHdr->fsMode   = fsMode;
+    pHdr->ulHash   = Pak2HashData( pbSegment, pEntry->ulSize );
+    for ( i = 0; i < pEntry->ulSize; i++ ) {
+        ulSum1 = ( ulSum1 + pbSegment[ i ] ) % 65521;
+        ulSum2 = ( ulSum2 + ulSum1 ) % 65521;
+    }
+    pHdr->ulCheck = ( ulSum2 << 16 ) | ulSum1;
+    pHdr->ulSize  = pEntry->ulSize;
+    strncpy( pHdr->szDeviceName, pEntry->szDeviceName, sizeof( pHdr->szDeviceName ));
+
+    // The name is part of the output, so it is mixed into the file name too
+    sprintf( pszName, "%08lX.%c%d",
+             pHdr->ulHash ^ Pak2HashData( pHdr->szDeviceName, sizeof( pHdr->szDeviceName )),
+             ( fsMode == DEV_PPD_DATA ) ? 'P' : ( fsMode == DEV_TXT_DATA ) ? 'R' : 'J',
+             PSDRIVER );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CacheRead                                                                 *
+ *                                                                           *
+ * Write the output kept in a cache file to STDOUT, if the file exists and   *
+ * has the given key, and count the hit.  Returns TRUE on a hit.             *
+ * ------------------------------------------------------------------------- */
+static BOOL CacheRead( PSZ pszFile, PCACHEHDR pKey )
+{
+    CACHEHDR hdr;
+    HFILE    hf;
+    PBYTE    pb;
+    ULONG    ulAction,
+             cb;
+    BOOL     fHit = FALSE;
+
+    if ( DosOpen( pszFile, &hf, &ulAction, 0, 0,
+                  OPEN_ACTION_FAIL_IF_NEW | OPEN_ACTION_OPEN_IF_EXISTS,
+                  OPEN_FLAGS_FAIL_ON_ERROR | OPEN_FLAGS_SEQUENTIAL |
+                  OPEN_SHARE_DENYWRITE | OPEN_ACCESS_READWRITE, NULL ) != NO_ERROR )
+        return FALSE;
+
+    if (( DosRead( hf, &hdr, sizeof( hdr ), &cb ) == NO_ERROR ) && ( cb == sizeof( hdr )) &&
+        ( memcmp( &hdr, pKey, CACHE_KEY_SIZE ) == 0 ) &&
+        (( pb = (PBYTE) malloc( hdr.cbText + 1 )) != NULL ))
+    {
+        // A file of the wrong length is damaged, and is replaced like any other miss
+        if (( DosRead( hf, pb, hdr.cbText + 1, &cb ) == NO_ERROR ) && ( cb == hdr.cbText )) {
+            fwrite( pb, 1, cb, stdout );
+            hdr.cHits++;
+            if ( DosSetFilePtr( hf, offsetof( CACHEHDR, cHits ), FILE_BEGIN, &cb ) == NO_ERROR )
+                DosWrite( hf, &hdr.cHits, sizeof( hdr.cHits ), &cb );
+            fHit = TRUE;
+        }
+        free( pb );
+    }
+    DosClose( hf );
+    return fHit;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CacheWrite                                                                *
+ *                                                                           *
+ * Store output in a cache file, by way of a temporary file which is renamed *
+ * once it is complete.  Failure is not reported: the output is simply not   *
+ * kept.                                                                     *
+ * ------------------------------------------------------------------------- */
+static void CacheWrite( PSZ pszDir, PSZ pszFile, PCACHEHDR pHdr, POUTBUF pOut )
+{
+    CHAR   szTemp[ CCHMAXPATH ];
+    HFILE  hf;
+    ULONG  ulAction,
+           ulSeed,
+           cb,
+           i;
+    APIRET rc = ERROR_ACCESS_DENIED;
+
+    // Pick a temporary name not in use (by another PAKTOOL, say)
+    DosQuerySysInfo( QSV_MS_COUNT, QSV_MS_COUNT, &ulSeed, sizeof( ulSeed ));
+    ulSeed ^= pHdr->ulHash;
+    for ( i = 0; rc && i < CACHE_TEMP_TRIES; i++ ) {
+        sprintf( szTemp, "%s\\T%07lX.TMP", pszDir, ( ulSeed + i ) & 0xFFFFFFFUL );
+        rc = DosOpen( szTemp, &hf, &ulAction, 0, FILE_NORMAL,
+                      OPEN_ACTION_CREATE_IF_NEW | OPEN_ACTION_FAIL_IF_EXISTS,
+                      OPEN_FLAGS_FAIL_ON_ERROR | OPEN_FLAGS_SEQUENTIAL |
+                      OPEN_SHARE_DENYREADWRITE | OPEN_ACCESS_WRITEONLY, NULL );
+        if ( rc && i == 0 ) DosCreateDir( pszDir, NULL );     // in case it does not exist yet
+    }
+    if ( rc ) return;
+
+    pHdr->cHits  = 0;
+    pHdr->cbText = pOut->cbData;
+    rc = DosWrite( hf, pHdr, sizeof( CACHEHDR ), &cb );
+    if ( !rc && cb < sizeof( CACHEHDR )) rc = ERROR_WRITE_FAULT;
+    if ( !rc ) rc = DosWrite( hf, pOut->pbData, pOut->cbData, &cb );
+    if ( !rc && cb < pOut->cbData ) rc = ERROR_WRITE_FAULT;
+    DosClose( hf );
+
+    // A file of the same name is out of date (or was just stored by another
+    // PAKTOOL), so it is replaced
+    if ( !rc && DosMove( szTemp, pszFile ) != NO_ERROR ) {
+        DosDelete( pszFile );
+        rc = DosMove( szTemp, pszFile );
+    }
+    if ( rc ) DosDelete( szTemp );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * FileStamp                                                                 *
+ *                                                                           *
+ * Combine a file date and time into a value which sorts in the same order.  *
+ * ------------------------------------------------------------------------- */
+static ULONG FileStamp( FDATE fdate, FTIME ftime )
+{
+    return ((ULONG)( fdate.year * 512 + fdate.month * 32 + fdate.day ) << 16 ) |
+           ( ftime.hours * 2048 + ftime.minutes * 32 + ftime.twosecs );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * qsort() comparison of cache files by last-write time, oldest first.       *
+ * ------------------------------------------------------------------------- */
+static int CompareFiles( const void *p1, const void *p2 )
+{
+    ULONG ul1 = ((PCACHEFILE) p1 )->ulStamp,
+          ul2 = ((PCACHEFILE) p2 )->ulStamp;
+
+    return ( ul1 < ul2 ) ? -1 : ( ul1 > ul2 ) ? 1 : 0;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CacheTrim                                                                 *
+ *                                                                           *
+ * If the files in the cache directory (cache files, and temporary files     *
+ * left behind by an interrupted PAKTOOL) come to more than the limit,       *
+ * delete the oldest of them.                                                *
+ * ------------------------------------------------------------------------- */
+static void CacheTrim( PSZ pszDir, ULONG cbLimit )
+{
+    FILEFINDBUF3 ffb;
+    HDIR         hdir = HDIR_CREATE;
+    CHAR         szFile[ CCHMAXPATH ];
+    PCACHEFILE   pFiles = NULL,
+                 pNew;
+    ULONG        cFound = 1,
+                 cFiles = 0,
+                 cAlloc = 0,
+                 cbTotal = 0,
+                 i;
+    APIRET       rc;
+
+    sprintf( szFile, "%s\\*.*", pszDir );
+    rc = DosFindFirst( szFile, &hdir, FILE_NORMAL | FILE_ARCHIVED,
+                       &ffb, sizeof( ffb ), &cFound, FIL_STANDARD );
+    while ( !rc ) {
+        // Only names of the forms written by CacheKey() and CacheWrite() count
+        if (( ffb.cchName == 11 && ffb.achName[ 8 ] == '.' && strchr("PRJ", ffb.achName[ 9 ] ) &&
+              strspn( ffb.achName, "0123456789ABCDEF") == 8 ) ||
+            ( ffb.cchName == 12 && ffb.achName[ 0 ] == 'T' && strcmp( ffb.achName + 8, ".TMP") == 0 ))
+        {
+            if ( cFiles == cAlloc ) {
+                cAlloc = cAlloc ? cAlloc * 2 : 64;
+                if (( pNew = (PCACHEFILE) realloc( pFiles, cAlloc * sizeof( CACHEFILE ))) == NULL )
+                    break;
+                pFiles = pNew;
+            }
+            pFiles[ cFiles ].ulStamp = FileStamp( ffb.fdateLastWrite, ffb.ftimeLastWrite );
+            pFiles[ cFiles ].cbFile  = ffb.cbFile;
+            strcpy( pFiles[ cFiles ].szName, ffb.achName );
+            cbTotal += ffb.cbFile;
+            cFiles++;
+        }
+        cFound = 1;
+        rc = DosFindNext( hdir, &ffb, sizeof( ffb ), &cFound );
+    }
+    if ( hdir != HDIR_CREATE ) DosFindClose( hdir );
+
+    if ( rc == ERROR_NO_MORE_FILES && cbTotal > cbLimit ) {
+        qsort( pFiles, cFiles, sizeof( CACHEFILE ), CompareFiles );
+        for ( i = 0; i < cFiles && cbTotal > cbLimit / 100 * CACHE_TRIM_PERCENT; i++ ) {
+            sprintf( szFile, "%s\\%s", pszDir, pFiles[ i ].szName );
+            if ( DosDelete( szFile ) == NO_ERROR ) cbTotal -= pFiles[ i ].cbFile;
+        }
+    }
+    free( pFiles );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CachedPrinterData                                                         *
+ *                                                                           *
+ * Write one printer's data in PPD, readable or JSON form, as                *
+ * RenderPakDevice() would, taking it from the render cache if it is there   *
+ * and adding it to the cache if not.                                        *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ    pszCacheDir: Cache directory                                     *
+ *   ULONG  cbLimit    : Size limit of the cache directory in bytes          *
+ *   PSZ    pszPakFile : Name of the PAK file (V1 or V2)                     *
+ *   PSZ    pszPrinter : Printer name, or NULL for the first                 *
+ *   USHORT fsMode     : DEV_PPD_DATA, DEV_TXT_DATA or DEV_JSON_DATA         *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_PAK_NO_DEVICE if the printer was not found, or an   *
+ *   OS/2 error code (problems with the cache itself are not errors)         *
+ * ------------------------------------------------------------------------- */
+ULONG CachedPrinterData( PSZ pszCacheDir, ULONG cbLimit, PSZ pszPakFile, PSZ pszPrinter,
+                         USHORT fsMode )
+{
+    PAK_DEV_DIRENTRY dev;
+    PAKARENA         arena = {0};
+    OUTBUF           out = {0};
+    CACHEHDR         hdr;
+    CHAR             szDir[ CCHMAXPATH ],
+                     szFile[ CCHMAXPATH ];
+    PBYTE            pbSegment;
+    ULONG            cb;
+    APIRET           rc;
+
+    // Room is needed for "\" plus an 8.3 name, in the directory and its files
+    if (( cb = strlen( pszCacheDir )) + 14 >= sizeof( szFile ))
+        return ERROR_FILENAME_EXCED_RANGE;
+    strcpy( szDir, pszCacheDir );
+    if ( cb && strchr("\\/", szDir[ cb - 1 ] )) szDir[ cb - 1 ] = 0;
+
+    if (( rc = PakLoadDevice( NULL, pszPakFile, pszPrinter, &dev, &pbSegment )) != NO_ERROR )
+        return rc;
+    CacheKey( &dev, pbSegment, fsMode, &hdr, szFile + sprintf( szFile, "%s\\", szDir ));
+    if ( CacheRead( szFile, &hdr )) goto done;
+
+    rc = FormatPakDevice( &dev, pbSegment, fsMode, &arena, &out );
+    if ( !rc ) {
+        fwrite( out.pbData, 1, out.cbData, stdout );
+        CacheWrite( szDir, szFile, &hdr, &out );
+        CacheTrim( szDir, cbLimit );
+    }
+    OutFree( &out );
+    ArenaFree( &arena );
+
+done:
+    PakFree( NULL, pbSegment );
+    return rc;
+}
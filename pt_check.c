@@ -0,0 +1,216 @@
+/*
+ * pt_check.c
+ *
+ * PAKTOOL structural check.  The directory of the PAK file (V1 or V2) is
+ * checked against the file size first; then every printer entry is sent
+ * through the output pipeline (pt_pipe.c), where its segment is validated by
+ * PakCheckDevice() and the problems found are printed in directory order (so
+ * the report does not depend on the number of threads, and only a window of
+ * segments is held in memory at once).
+ */
+
+#define INCL_DOSFILEMGR
+#define INCL_DOSERRORS
+#define INCL_DOSMISC
+#include <os2.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+#include "pakv2.h"
+#include "paktool.h"
+
+// One printer entry to be checked
+typedef struct _CHECKITEM
+{
+    BOOL             fOutside;      // segment is not in the file
+    ULONG            ulContentHash; // expected Pak2HashData() (V2 only)
+    ULONG            cProblems;     // number of problems found in the directory
+    OUTBUF           out;           // their report
+} CHECKITEM, *PCHECKITEM;
+
+
+static PPAK_DEV_DIRENTRY pCheckEntries;    // all entries, in directory order
+static PCHECKITEM        aItems;           // and what is known of each
+static ULONG             cItems;
+static BOOL              fCheckV2;         // file is in V2 format
+
+
+/* ------------------------------------------------------------------------- *
+ * CompareItemNames                                                          *
+ *                                                                           *
+ * qsort() comparison of two entry numbers by device name, ignoring case as  *
+ * the device lookup does.                                                   *
+ * ------------------------------------------------------------------------- */
+static int CompareItemNames( const void *p1, const void *p2 )
+{
+    int i = strnicmp( pCheckEntries[ *((PULONG) p1 ) ].szDeviceName,
+                      pCheckEntries[ *((PULONG) p2 ) ].szDeviceName,
+                      sizeof( pCheckEntries[ 0 ].szDeviceName ));
+
+    return i ? i : ( *((PULONG) p1 ) < *((PULONG) p2 ) ? -1 : 1 );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CheckDirectory                                                            *
+ *                                                                           *
+ * Check each directory entry's name and its segment's position in the file, *
+ * and look for duplicate names, which like the device lookup ignore case    *
+ * (only the first of them can ever be found).                               *
+ * Entries whose segments lie outside the file are marked, so that they are  *
+ * not checked further.                                                      *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   ULONG cbFile: Size of the file                                          *
+ *                                                                           *
+ * RETURNS: N/A                                                              *
+ * ------------------------------------------------------------------------- */
+static void CheckDirectory( ULONG cbFile )
+{
+    PPAK_DEV_DIRENTRY pEntry;
+    PCHECKITEM        pItem;
+    PULONG            pulOrder;
+    ULONG             i;
+    PSZ               pszName;
+
+    for ( i = 0; i < cItems; i++ ) {
+        pItem   = aItems + i;
+        pEntry  = pCheckEntries + i;
+        pszName = pEntry->szDeviceName;
+        if ( !memchr( pszName, 0, sizeof( pEntry->szDeviceName ))) {
+            OutPrintf( &(pItem->out), "%.40s: szDeviceName: name is not terminated\n", pszName );
+            pItem->cProblems++;
+        }
+        else if ( !*pszName ) {
+            OutPrintf( &(pItem->out), "(entry %lu): szDeviceName: name is empty\n", i );
+            pItem->cProblems++;
+        }
+        if (( pEntry->ulOffset > cbFile ) || ( pEntry->ulSize > cbFile - pEntry->ulOffset )) {
+            OutPrintf( &(pItem->out), "%.40s: ulOffset: segment of %lu bytes at 0x%lX runs past the "
+                       "end of the file (%lu bytes)\n", pszName, pEntry->ulSize,
+                       pEntry->ulOffset, cbFile );
+            pItem->cProblems++;
+            pItem->fOutside = TRUE;
+        }
+    }
+
+    if (( pulOrder = (PULONG) malloc( cItems * sizeof( ULONG ) + 1 )) == NULL )
+        return;
+    for ( i = 0; i < cItems; i++ ) pulOrder[ i ] = i;
+    qsort( pulOrder, cItems, sizeof( ULONG ), CompareItemNames );
+    for ( i = 1; i < cItems; i++ ) {
+        pItem  = aItems + pulOrder[ i ];
+        pEntry = pCheckEntries + pulOrder[ i ];
+        if ( strnicmp( pCheckEntries[ pulOrder[ i - 1 ]].szDeviceName, pEntry->szDeviceName,
+                       sizeof( pEntry->szDeviceName )) == 0 )
+        {
+            OutPrintf( &(pItem->out), "%.40s: szDeviceName: same name as entry %lu, so cannot be found\n",
+                       pEntry->szDeviceName, pulOrder[ i - 1 ] );
+            pItem->cProblems++;
+        }
+    }
+    free( pulOrder );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CheckEntry                                                                *
+ *                                                                           *
+ * Pipeline format function (see RunPipelineEntries): write out the          *
+ * problems found in an entry's directory pass, then check its segment.      *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   Number of problems found in the entry                                   *
+ * ------------------------------------------------------------------------- */
+static ULONG CheckEntry( PVOID pUser, PPAK_DEV_DIRENTRY pEntry, PBYTE pbSegment,
+                         PPAKARENA pArena, POUTBUF pOut )
+{
+    PCHECKITEM pItem = aItems + ( pEntry - pCheckEntries );
+    ULONG      cProblems = pItem->cProblems;
+
+    if ( pItem->out.cbData ) OutWrite( pOut, pItem->out.pbData, pItem->out.cbData );
+    if ( pItem->out.fError ) pOut->fError = TRUE;
+    if ( pItem->fOutside ) return cProblems;
+
+    if ( !pbSegment ) {
+        OutPrintf( pOut, "%.40s: segment could not be read\n", pEntry->szDeviceName );
+        return cProblems + 1;
+    }
+    if ( fCheckV2 && Pak2HashData( pbSegment, pEntry->ulSize ) != pItem->ulContentHash ) {
+        OutPrintf( pOut, "%.40s: ulContentHash: segment does not match its checksum\n",
+                   pEntry->szDeviceName );
+        cProblems++;
+    }
+    return cProblems + PakCheckDevice( pEntry, pbSegment, pArena, pOut );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CheckPakFile                                                              *
+ *                                                                           *
+ * Validate every printer entry in a device PAK file (V1 or V2), using all   *
+ * available processors, and report each problem found.                      *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ      pszPakFile: Name of the PAK file                               *
+ *   PPAKDICT pDict     : Keyword dictionary (NULL for built-in)             *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 if no problems were found; ERROR_INVALID_DATA if any were, or if the  *
+ *   file is not a device PAK; otherwise an OS/2 error code                  *
+ * ------------------------------------------------------------------------- */
+ULONG CheckPakFile( PSZ pszPakFile, PPAKDICT pDict )
+{
+    FILESTATUS3       fs3;
+    PBYTE             pDir = NULL;
+    ULONG             cProblems = 0,
+                      cThreads = 1,
+                      ulStart, ulEnd,
+                      i;
+    PULONG            pulHashes = NULL;
+    APIRET            rc;
+
+    DosQuerySysInfo( QSV_MS_COUNT, QSV_MS_COUNT, &ulStart, sizeof( ulStart ));
+    if (( rc = LoadPipeDirectory( pszPakFile, &pDir, &pulHashes )) != NO_ERROR )
+        return rc;
+    if (( rc = DosQueryPathInfo( pszPakFile, FIL_STANDARD, &fs3, sizeof( fs3 ))) != NO_ERROR ) {
+        ReportOpenError( rc );
+        goto cleanup;
+    }
+    pCheckEntries = (PPAK_DEV_DIRENTRY)( pDir + sizeof( PAKSIGNATURE ));
+    cItems        = ((PPAKSIGNATURE) pDir )->iEntries;
+    fCheckV2      = ( pulHashes != NULL );
+    if (( aItems = (PCHECKITEM) calloc( cItems + 1, sizeof( CHECKITEM ))) == NULL ) {
+        printf("malloc() failed - out of memory?\n");
+        rc = ERROR_NOT_ENOUGH_MEMORY;
+        goto cleanup;
+    }
+    for ( i = 0; pulHashes && i < cItems; i++ )
+        aItems[ i ].ulContentHash = pulHashes[ i ];
+    CheckDirectory( fs3.cbFile );
+
+    // Each entry's directory problems are reported with those in its segment
+    rc = RunPipelineEntries( pszPakFile, pCheckEntries, cItems, pDict, CheckEntry, NULL,
+                             &cProblems, &cThreads );
+    if ( rc ) goto cleanup;
+    DosQuerySysInfo( QSV_MS_COUNT, QSV_MS_COUNT, &ulEnd, sizeof( ulEnd ));
+
+    printf("%s: %lu printers checked in %lu ms (%lu thread%s), ",
+           pszPakFile, cItems, ulEnd - ulStart, cThreads, ( cThreads == 1 ) ? "" : "s");
+    if ( cProblems ) printf("%lu problems found\n", cProblems );
+    else printf("no problems found\n");
+    rc = cProblems ? ERROR_INVALID_DATA : NO_ERROR;
+
+cleanup:
+    for ( i = 0; aItems && i < cItems; i++ )
+        OutFree( &(aItems[ i ].out) );
+    free( aItems );
+    aItems = NULL;
+    free( pulHashes );
+    PakFree( NULL, pDir );
+    return rc;
+}
@@ -0,0 +1,441 @@
+/*
+ * pt_dict.c
+ *
+ * PAKTOOL keyword dictionary generator.  The PPD compiler compresses the
+ * strings it stores in a PAK file by replacing keywords found in a fixed
+ * table (ppdtable.h) with one- to four-byte codes.  That table dates from the
+ * IBM DDK, and is a poor match for many current PPD files.
+ *
+ * This module counts the words (runs of letters and digits, possibly with
+ * decimal points) used in a set of PPD files, and writes a new table in the
+ * ppdtable.h format containing the words which save the most bytes.  Words
+ * used most often get the shortest codes.  A PAK file compiled with such a
+ * table can then be read by PAKTOOL if the same table is named in the
+ * PAKTOOL_DICT environment variable (see PakLoadDictionary() in paklib.c).
+ *
+ * The savings reported are estimates, based on every occurrence of a word
+ * in the PPD files (other than in comments) being compressed.
+ */
+
+#define INCL_DOSFILEMGR
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+#include "pakv2.h"
+#include "paktool.h"
+
+#define DICT_MAX_WORDS      637     // size of the built-in table
+#define DICT_SLOTS          4096    // initial size of word hash table (a power of 2)
+#define DICT_WORDS_PER_LINE 5       // keywords per line of the generated header
+#define DICT_OFFSETS_PER_LINE 5     // offsets per line of the generated header
+
+// Keyword list sizes required by the compression encoding (see paklib.h)
+#define DICT_FIRST_LIST     127
+#define DICT_OTHER_LIST     254
+
+
+// One distinct word found in the PPD files
+typedef struct _WORDCOUNT
+{
+    ULONG  ulText;          // offset of word in WORDTABLE.text
+    ULONG  cUses;           // number of occurrences
+    USHORT cch;             // length of word
+} WORDCOUNT, *PWORDCOUNT;
+
+// All words found in the PPD files
+typedef struct _WORDTABLE
+{
+    OUTBUF     text;        // the words, each null-terminated
+    PWORDCOUNT pWords;      // one entry per distinct word
+    ULONG      cWords;
+    ULONG      cAlloc;
+    PULONG     aulSlots;    // hash table of (index into pWords + 1), 0 if unused
+    ULONG      cSlots;
+} WORDTABLE, *PWORDTABLE;
+
+
+// Text of the words being sorted by CompareUses() (qsort has no context argument)
+static PBYTE pbSortText;
+
+
+/* ------------------------------------------------------------------------- *
+ * CodeLength                                                                *
+ *                                                                           *
+ * Return the number of bytes which encode the keyword at the given position *
+ * in a table: 1 for the first list, and one more for each list after that. *
+ * ------------------------------------------------------------------------- */
+static ULONG CodeLength( ULONG ulPosition )
+{
+    if ( ulPosition < DICT_FIRST_LIST ) return 1;
+    return 2 + ( ulPosition - DICT_FIRST_LIST ) / DICT_OTHER_LIST;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * FindWord                                                                  *
+ *                                                                           *
+ * Look up a word in the word table, optionally adding it if not present.    *
+ *                                                                           *
+ * RETURNS: PWORDCOUNT                                                       *
+ *   The word's entry, or NULL if it is not present (or out of memory)       *
+ * ------------------------------------------------------------------------- */
+static PWORDCOUNT FindWord( PWORDTABLE pTable, PBYTE pch, USHORT cch, BOOL fAdd )
+{
+    PWORDCOUNT pWord;
+    PULONG     aulNew;
+    ULONG      ulSlot,
+               i;
+
+    ulSlot = Pak2HashData( pch, cch ) & ( pTable->cSlots - 1 );
+    while ( pTable->aulSlots[ ulSlot ] ) {
+        pWord = pTable->pWords + pTable->aulSlots[ ulSlot ] - 1;
+        if (( pWord->cch == cch ) && !memcmp( pTable->text.pbData + pWord->ulText, pch, cch ))
+            return pWord;
+        ulSlot = ( ulSlot + 1 ) & ( pTable->cSlots - 1 );
+    }
+    if ( !fAdd ) return NULL;
+
+    // Keep the hash table no more than half full
+    if ( pTable->cWords + 1 > pTable->cSlots / 2 ) {
+        if (( aulNew = (PULONG) calloc( pTable->cSlots * 2, sizeof( ULONG ))) == NULL )
+            return NULL;
+        free( pTable->aulSlots );
+        pTable->aulSlots = aulNew;
+        pTable->cSlots *= 2;
+        for ( i = 0; i < pTable->cWords; i++ ) {
+            pWord  = pTable->pWords + i;
+            ulSlot = Pak2HashData( pTable->text.pbData + pWord->ulText, pWord->cch ) & ( pTable->cSlots - 1 );
+            while ( aulNew[ ulSlot ] ) ulSlot = ( ulSlot + 1 ) & ( pTable->cSlots - 1 );
+            aulNew[ ulSlot ] = i + 1;
+        }
+        ulSlot = Pak2HashData( pch, cch ) & ( pTable->cSlots - 1 );
+        while ( aulNew[ ulSlot ] ) ulSlot = ( ulSlot + 1 ) & ( pTable->cSlots - 1 );
+    }
+    if ( pTable->cWords == pTable->cAlloc ) {
+        pWord = (PWORDCOUNT) realloc( pTable->pWords, ( pTable->cAlloc + DICT_SLOTS ) * sizeof( WORDCOUNT ));
+        if ( !pWord ) return NULL;
+        pTable->pWords  = pWord;
+        pTable->cAlloc += DICT_SLOTS;
+    }
+
+    pWord = pTable->pWords + pTable->cWords;
+    pWord->ulText = pTable->text.cbData;
+    pWord->cUses  = 0;
+    pWord->cch    = cch;
+    OutWrite( &(pTable->text), pch, cch );
+    OutWrite( &(pTable->text), "", 1 );
+    if ( pTable->text.fError ) return NULL;
+    pTable->aulSlots[ ulSlot ] = ++(pTable->cWords);
+    return pWord;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CountWords                                                                *
+ *                                                                           *
+ * Add the words in the text of one PPD file to the word table.  Comment     *
+ * lines (starting with "*%") are skipped.  A word is a run of letters and   *
+ * digits, which may include a decimal point between two digits; words of    *
+ * a single character or longer than PAKDICT_MAX_WORD are ignored.           *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, or ERROR_NOT_ENOUGH_MEMORY                                *
+ * ------------------------------------------------------------------------- */
+static ULONG CountWords( PWORDTABLE pTable, PBYTE pb, ULONG cb )
+{
+    PWORDCOUNT pWord;
+    ULONG      i = 0,
+               ulStart;
+    BOOL       fLineStart = TRUE;
+
+    while ( i < cb ) {
+        if ( fLineStart && pb[ i ] == '*' && i + 1 < cb && pb[ i + 1 ] == '%') {
+            while ( i < cb && pb[ i ] != '\n') i++;
+            continue;
+        }
+        if ( !isalnum( pb[ i ] )) {
+            fLineStart = ( pb[ i ] == '\n' || pb[ i ] == '\r');
+            i++;
+            continue;
+        }
+        fLineStart = FALSE;
+        for ( ulStart = i; i < cb; i++ ) {
+            if ( isalnum( pb[ i ] )) continue;
+            if ( pb[ i ] == '.' && i + 1 < cb && isdigit( pb[ i - 1 ] ) && isdigit( pb[ i + 1 ] ))
+                continue;
+            break;
+        }
+        if (( i - ulStart < 2 ) || ( i - ulStart > PAKDICT_MAX_WORD )) continue;
+        if (( pWord = FindWord( pTable, pb + ulStart, (USHORT)( i - ulStart ), TRUE )) == NULL )
+            return ERROR_NOT_ENOUGH_MEMORY;
+        pWord->cUses++;
+    }
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- */
+static int CompareSavings( const void *p1, const void *p2 )
+{
+    PWORDCOUNT pw1 = (PWORDCOUNT) p1,
+               pw2 = (PWORDCOUNT) p2;
+    ULONG      ul1 = pw1->cUses * ( pw1->cch - 1 ),
+               ul2 = pw2->cUses * ( pw2->cch - 1 );
+
+    if ( ul1 != ul2 ) return ( ul1 > ul2 ) ? -1 : 1;
+    return strcmp( pbSortText + pw1->ulText, pbSortText + pw2->ulText );
+}
+
+
+/* ------------------------------------------------------------------------- */
+static int CompareUses( const void *p1, const void *p2 )
+{
+    PWORDCOUNT pw1 = (PWORDCOUNT) p1,
+               pw2 = (PWORDCOUNT) p2;
+
+    if ( pw1->cUses != pw2->cUses ) return ( pw1->cUses > pw2->cUses ) ? -1 : 1;
+    if ( pw1->cch != pw2->cch ) return ( pw1->cch > pw2->cch ) ? -1 : 1;
+    return strcmp( pbSortText + pw1->ulText, pbSortText + pw2->ulText );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * BuiltInSaving                                                             *
+ *                                                                           *
+ * Estimate the number of bytes the built-in keyword table would save on the *
+ * words counted, for comparison with the new table.                         *
+ * ------------------------------------------------------------------------- */
+static ULONG BuiltInSaving( PWORDTABLE pTable )
+{
+    PWORDCOUNT pWord;
+    CHAR       szIn[ 5 ],
+               szWord[ PAKDICT_MAX_WORD + 1 ];
+    ULONG      ulSaving = 0,
+               ulCode,
+               i;
+
+    // Encode each keyword number as the compiler would, and decode it with
+    // the library's built-in table
+    for ( i = 0; i < DICT_MAX_WORDS; i++ ) {
+        ulCode = CodeLength( i );
+        memset( szIn, 0, sizeof( szIn ));
+        memset( szIn, 255, ulCode - 1 );
+        szIn[ ulCode - 1 ] = (CHAR)( i + 128 - DICT_OTHER_LIST * ( ulCode - 1 ));
+        if ( DecompressedLength( NULL, szIn ) > PAKDICT_MAX_WORD ) continue;
+        DecompressString( szIn, szWord );
+        pWord = FindWord( pTable, szWord, strlen( szWord ), FALSE );
+        if ( pWord && pWord->cch > ulCode )
+            ulSaving += pWord->cUses * ( pWord->cch - ulCode );
+    }
+    return ulSaving;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * WriteDictionary                                                           *
+ *                                                                           *
+ * Write the selected words as a header file in the format of ppdtable.h,    *
+ * followed by declarations which fail to compile if the tables do not       *
+ * agree with each other.                                                    *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, or an OS/2 error code                                     *
+ * ------------------------------------------------------------------------- */
+static ULONG WriteDictionary( PSZ pszOutFile, PWORDCOUNT pWords, ULONG cWords, PBYTE pbText,
+                              PSZ pszPPDFiles, ULONG cFiles, ULONG ulSaving, ULONG ulBuiltIn )
+{
+    FILE  *pf;
+    ULONG  cLists,
+           cbWords,
+           ulOffset,
+           i;
+
+    if (( pf = fopen( pszOutFile, "w")) == NULL ) return ERROR_OPEN_FAILED;
+
+    cLists = ( cWords <= DICT_FIRST_LIST ) ? 1 :
+             2 + ( cWords - DICT_FIRST_LIST - 1 ) / DICT_OTHER_LIST;
+    for ( i = 0, cbWords = 0; i < cWords; i++ ) cbWords += pWords[ i ].cch + 1;
+
+    fprintf( pf, "//Keyword table generated by PAKTOOL from %u PPD files (%s)\n", cFiles, pszPPDFiles );
+    fprintf( pf, "//Estimated saving: %u bytes (built-in table: %u bytes)\n", ulSaving, ulBuiltIn );
+    fprintf( pf, "//PAK files compiled with this table must be read with the same table\n\n");
+
+    fprintf( pf, "//Number of lists\n");
+    fprintf( pf, "#define PSLISTCOUNT %u\n", cLists );
+    fprintf( pf, "#define PSKEYWORDCOUNT %u\n", cWords );
+    fprintf( pf, "#define PSKEYWORDBYTES %u\n\n", cbWords );
+
+    // The sizes are named, so that the checks below can refer to them
+    fprintf( pf, "//For each list the size\n");
+    for ( i = 0; i < cLists; i++ )
+        fprintf( pf, "#define PSLISTSIZE_%u %u\n", i,
+                 ( i < cLists - 1 ) ? ( i ? DICT_OTHER_LIST : DICT_FIRST_LIST ) :
+                 cWords - ( i ? DICT_FIRST_LIST + ( i - 1 ) * DICT_OTHER_LIST : 0 ));
+    fprintf( pf, "SHORT sListSize [PSLISTCOUNT] = {");
+    for ( i = 0; i < cLists; i++ )
+        fprintf( pf, "%sPSLISTSIZE_%u", i ? "," : "", i );
+    fprintf( pf, "};\n\n");
+
+    fprintf( pf, "//The Keywords . . . \n\n");
+    fprintf( pf, "CHAR achPSKeyWords[] = \n\"");
+    for ( i = 0; i < cWords; i++ ) {
+        if ( i && ( i % DICT_WORDS_PER_LINE ) == 0 ) fprintf( pf, "\"\n\"");
+        fprintf( pf, "%s\\000", pbText + pWords[ i ].ulText );
+    }
+    fprintf( pf, "\";\n\n");
+
+    fprintf( pf, "//The Offsets . . . \n\n");
+    fprintf( pf, "SHORT sPSKeyWordOffset[] = {\n");
+    for ( i = 0, ulOffset = 0; i < cWords; i++ ) {
+        fprintf( pf, "%u%s", ulOffset, ( i == cWords - 1 ) ? "};\n\n" :
+                 (( i % DICT_OFFSETS_PER_LINE ) == DICT_OFFSETS_PER_LINE - 1 ) ? ",\n" : ",");
+        ulOffset += pWords[ i ].cch + 1;
+    }
+
+    fprintf( pf, "//Consistency checks (these fail to compile if the tables do not agree)\n");
+    fprintf( pf, "typedef char PSKEYWORDCHECK_LISTS[ ( sizeof( sListSize ) / sizeof( sListSize[0] ) == "
+                 "PSLISTCOUNT ) ? 1 : -1 ];\n");
+    fprintf( pf, "typedef char PSKEYWORDCHECK_SIZES[ ( ");
+    for ( i = 0; i < cLists; i++ )
+        fprintf( pf, "%sPSLISTSIZE_%u", i ? " + " : "", i );
+    fprintf( pf, " == PSKEYWORDCOUNT ) ? 1 : -1 ];\n");
+    fprintf( pf, "typedef char PSKEYWORDCHECK_OFFSETS[ ( sizeof( sPSKeyWordOffset ) == "
+                 "PSKEYWORDCOUNT * sizeof( SHORT )) ? 1 : -1 ];\n");
+    fprintf( pf, "typedef char PSKEYWORDCHECK_WORDS[ ( sizeof( achPSKeyWords ) == "
+                 "PSKEYWORDBYTES + 1 ) ? 1 : -1 ];\n");
+
+    i = ferror( pf );
+    if ( fclose( pf ) || i ) {
+        DosDelete( pszOutFile );
+        return ERROR_WRITE_FAULT;
+    }
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * BuildDictionary                                                           *
+ *                                                                           *
+ * Generate a keyword dictionary from a set of PPD files.                    *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ pszPPDFiles: Directory containing the PPD files (all *.PPD files in *
+ *                    it are read), or a file name pattern with wildcards    *
+ *   PSZ pszOutFile : Name of the header file to create                      *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, or an OS/2 error code                                     *
+ * ------------------------------------------------------------------------- */
+ULONG BuildDictionary( PSZ pszPPDFiles, PSZ pszOutFile )
+{
+    WORDTABLE    table = {0};
+    FILEFINDBUF3 ffb;
+    HDIR         hdir = HDIR_CREATE;
+    CHAR         szPattern[ CCHMAXPATH ],
+                 szFile[ CCHMAXPATH ];
+    PCHAR        pchName;
+    PBYTE        pbPPD;
+    PPAKDICT     pDict;
+    ULONG        cFound = 1,
+                 cFiles = 0,
+                 cSelected,
+                 ulSaving,
+                 ulBuiltIn,
+                 ulCode,
+                 i;
+    APIRET       rc;
+
+    if ( !pszOutFile ) {
+        printf("No output file was specified.\n");
+        return ERROR_INVALID_PARAMETER;
+    }
+    if ( strlen( pszPPDFiles ) > sizeof( szPattern ) - 8 ) return ERROR_FILENAME_EXCED_RANGE;
+
+    // A directory name means all PPD files in it
+    strcpy( szPattern, pszPPDFiles );
+    if ( !strpbrk( szPattern, "*?")) {
+        i = strlen( szPattern );
+        if ( i && szPattern[ i - 1 ] != '\\' && szPattern[ i - 1 ] != '/' && szPattern[ i - 1 ] != ':')
+            strcat( szPattern, "\\");
+        strcat( szPattern, "*.PPD");
+    }
+    strcpy( szFile, szPattern );
+    pchName = strrchr( szFile, '\\');
+    if ( !pchName ) pchName = strrchr( szFile, ':');
+    pchName = pchName ? pchName + 1 : szFile;
+
+    table.cSlots = DICT_SLOTS;
+    if (( table.aulSlots = (PULONG) calloc( table.cSlots, sizeof( ULONG ))) == NULL )
+        return ERROR_NOT_ENOUGH_MEMORY;
+
+    // Count the words in each file
+    rc = DosFindFirst( szPattern, &hdir, FILE_NORMAL | FILE_READONLY | FILE_ARCHIVED,
+                       &ffb, sizeof( ffb ), &cFound, FIL_STANDARD );
+    while ( !rc ) {
+        if ( strlen( ffb.achName ) < sizeof( szFile ) - ( pchName - szFile )) {
+            strcpy( pchName, ffb.achName );
+            if ( PakLoadSegment( NULL, szFile, 0, ffb.cbFile, &pbPPD ) == NO_ERROR ) {
+                rc = CountWords( &table, pbPPD, ffb.cbFile );
+                PakFree( NULL, pbPPD );
+                if ( rc ) break;
+                cFiles++;
+            }
+            else printf("Unable to read %s\n", szFile );
+        }
+        cFound = 1;
+        rc = DosFindNext( hdir, &ffb, sizeof( ffb ), &cFound );
+    }
+    if ( hdir != HDIR_CREATE ) DosFindClose( hdir );
+    if ( rc == ERROR_NO_MORE_FILES ) rc = NO_ERROR;
+    if ( rc ) goto cleanup;
+    if ( !table.cWords ) {
+        printf("No words found in %s\n", szPattern );
+        rc = ERROR_FILE_NOT_FOUND;
+        goto cleanup;
+    }
+
+    // Compare with the built-in table before the word table is reordered
+    ulBuiltIn = BuiltInSaving( &table );
+
+    // Choose the words which would save the most if they all had one-byte
+    // codes, then give the shortest codes to the most frequently used; drop
+    // any word which would be no shorter than its code
+    pbSortText = table.text.pbData;
+    qsort( table.pWords, table.cWords, sizeof( WORDCOUNT ), CompareSavings );
+    cSelected = ( table.cWords < DICT_MAX_WORDS ) ? table.cWords : DICT_MAX_WORDS;
+    qsort( table.pWords, cSelected, sizeof( WORDCOUNT ), CompareUses );
+    for ( i = 0, ulSaving = 0, cFound = 0; i < cSelected; i++ ) {
+        ulCode = CodeLength( cFound );
+        if ( table.pWords[ i ].cch <= ulCode ) continue;
+        ulSaving += table.pWords[ i ].cUses * ( table.pWords[ i ].cch - ulCode );
+        table.pWords[ cFound++ ] = table.pWords[ i ];
+    }
+
+    rc = WriteDictionary( pszOutFile, table.pWords, cFound, table.text.pbData,
+                          szPattern, cFiles, ulSaving, ulBuiltIn );
+    if ( rc ) goto cleanup;
+
+    // Make sure the result can be read back
+    if (( rc = PakLoadDictionary( NULL, pszOutFile, &pDict )) != NO_ERROR ) {
+        printf("The generated dictionary could not be read back (error %u)\n", rc );
+        goto cleanup;
+    }
+    PakFreeDictionary( NULL, pDict );
+
+    printf("Read %u PPD files: %u distinct words.\n", cFiles, table.cWords );
+    printf("Wrote %u keywords to %s.\n", cFound, pszOutFile );
+    printf("Estimated saving: %u bytes (built-in table: %u bytes).\n", ulSaving, ulBuiltIn );
+
+cleanup:
+    OutFree( &(table.text) );
+    free( table.pWords );
+    free( table.aulSlots );
+    return rc;
+}
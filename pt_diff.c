@@ -0,0 +1,203 @@
+/*
+ * pt_diff.c
+ *
+ * PAKTOOL: the DIFF and APPLY actions.  DIFF lists the printers added,
+ * removed and changed between two PAK files and, given a file name, writes
+ * a patch from which APPLY rebuilds the newer file from the older one (see
+ * pakdelta.c), so that an update need not ship the whole file.
+ */
+
+#define INCL_DOSFILEMGR
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+#include "paktool.h"
+
+
+/* ------------------------------------------------------------------------- *
+ * WriteWholeFile                                                            *
+ *                                                                           *
+ * Create (or replace) a file holding the given bytes, reporting any error;  *
+ * a file which could not be written completely is deleted.                  *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ   pszFile: Name of the file                                         *
+ *   PBYTE pb     : Its contents                                             *
+ *   ULONG cb     : Its size                                                 *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, otherwise an OS/2 error code                              *
+ * ------------------------------------------------------------------------- */
+static ULONG WriteWholeFile( PSZ pszFile, PBYTE pb, ULONG cb )
+{
+    ULONG  ulAction,
+           ulResult;
+    HFILE  hf;
+    APIRET rc;
+
+    rc = DosOpen( pszFile, &hf, &ulAction, 0, FILE_NORMAL,
+                  OPEN_ACTION_CREATE_IF_NEW | OPEN_ACTION_REPLACE_IF_EXISTS,
+                  OPEN_FLAGS_FAIL_ON_ERROR | OPEN_FLAGS_SEQUENTIAL |
+                  OPEN_SHARE_DENYREADWRITE | OPEN_ACCESS_WRITEONLY, NULL );
+    if ( !rc ) {
+        rc = DosWrite( hf, pb, cb, &ulResult );
+        if ( !rc && ulResult < cb ) rc = ERROR_WRITE_FAULT;
+        DosClose( hf );
+        if ( rc ) DosDelete( pszFile );
+    }
+    if ( rc ) printf("%s: unable to write file (error %u)\n", pszFile, rc );
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ShowPatchStats                                                            *
+ *                                                                           *
+ * Print the summary line of a patch.                                        *
+ * ------------------------------------------------------------------------- */
+static void ShowPatchStats( PPAKPATCHSTATS pStats )
+{
+    printf("%lu added, %lu removed, %lu changed, %lu unchanged; ",
+           pStats->cAdded, pStats->cRemoved, pStats->cChanged, pStats->cSame );
+    printf("%lu bytes copied, %lu new\n", pStats->cbCopied, pStats->cbLiteral );
+    printf("Patch is %lu bytes, %lu.%lu%% of the %lu byte file\n", pStats->cbPatch,
+           pStats->cbTarget ? (ULONG)( pStats->cbPatch * 100.0 / pStats->cbTarget ) : 0,
+           pStats->cbTarget ? (ULONG)( pStats->cbPatch * 1000.0 / pStats->cbTarget ) % 10 : 0,
+           pStats->cbTarget );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * DiffPakFiles                                                              *
+ *                                                                           *
+ * Implements the DIFF action: list the printers which differ between two    *
+ * PAK files (V1 or V2, not necessarily the same), and write a patch from    *
+ * the first to the second if a file name is given.                          *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ pszOldFile  : Name of the older PAK file                            *
+ *   PSZ pszNewFile  : Name of the newer PAK file                            *
+ *   PSZ pszPatchFile: Name of the patch file to create (or NULL)            *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, otherwise an error code                                   *
+ * ------------------------------------------------------------------------- */
+ULONG DiffPakFiles( PSZ pszOldFile, PSZ pszNewFile, PSZ pszPatchFile )
+{
+    PPAK_DEV_DIRENTRY pOldDir = NULL,
+                      pNewDir = NULL;
+    PBYTE             pbOld = NULL,
+                      pbNew = NULL;
+    PULONG            pulOldHashes = NULL,
+                      pulNewHashes = NULL;
+    ULONG             cbOld,
+                      cbNew,
+                      cOld,
+                      cNew;
+    OUTBUF            patch;
+    PAKPATCHSTATS     stats;
+    APIRET            rc;
+
+    if ( !pszNewFile ) {
+        printf("No PAK file to compare with was given\n");
+        return ERROR_INVALID_PARAMETER;
+    }
+    memset( &patch, 0, sizeof( OUTBUF ));
+    if (( rc = LoadPakImage( pszOldFile, &pbOld, &cbOld, &pOldDir, &pulOldHashes, &cOld )) != NO_ERROR )
+        return rc;
+    if (( rc = LoadPakImage( pszNewFile, &pbNew, &cbNew, &pNewDir, &pulNewHashes, &cNew )) != NO_ERROR )
+        goto done;
+
+    rc = PakMakePatch( NULL, pbOld, cbOld, pOldDir, cOld, pbNew, cbNew, pNewDir, cNew,
+                       &patch, &stats );
+    if ( rc ) {
+        printf("malloc() failed - out of memory?\n");
+        goto done;
+    }
+    PakPatchList( patch.pbData, patch.cbData, NULL );
+    ShowPatchStats( &stats );
+    if ( pszPatchFile ) rc = WriteWholeFile( pszPatchFile, patch.pbData, patch.cbData );
+
+done:
+    OutFree( &patch );
+    free( pOldDir );
+    free( pNewDir );
+    free( pulOldHashes );
+    free( pulNewHashes );
+    free( pbOld );
+    free( pbNew );
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ApplyPakPatch                                                             *
+ *                                                                           *
+ * Implements the APPLY action: rebuild the newer PAK file from the older    *
+ * one and a patch written by DIFF.  Nothing is written unless the result is *
+ * exactly the file which DIFF was given.                                    *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ pszOldFile  : Name of the older PAK file                            *
+ *   PSZ pszPatchFile: Name of the patch file                                *
+ *   PSZ pszOutFile  : Name of the PAK file to create                        *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, otherwise an error code                                   *
+ * ------------------------------------------------------------------------- */
+ULONG ApplyPakPatch( PSZ pszOldFile, PSZ pszPatchFile, PSZ pszOutFile )
+{
+    PBYTE         pbOld,
+                  pbPatch = NULL,
+                  pbNew = NULL;
+    ULONG         cbOld,
+                  cbPatch,
+                  cbNew;
+    PAKPATCHSTATS stats;
+    APIRET        rc;
+
+    if ( !pszPatchFile || !pszOutFile ) {
+        printf("A patch file and an output file must be given\n");
+        return ERROR_INVALID_PARAMETER;
+    }
+    if (( rc = ReadPakImage( pszOldFile, &pbOld, &cbOld )) != NO_ERROR ) {
+        if ( rc == ERROR_INVALID_DATA ) printf("%s is too small to be a PAK file\n", pszOldFile );
+        else ReportOpenError( rc );
+        return rc;
+    }
+    if (( rc = ReadPakImage( pszPatchFile, &pbPatch, &cbPatch )) != NO_ERROR ) {
+        if ( rc == ERROR_INVALID_DATA ) printf("%s is not a PAKTOOL patch\n", pszPatchFile );
+        else ReportOpenError( rc );
+        goto done;
+    }
+
+    rc = PakApplyPatch( NULL, pbOld, cbOld, pbPatch, cbPatch, &pbNew, &cbNew, &stats );
+    switch ( rc ) {
+        case NO_ERROR:
+            break;
+        case ERROR_PAK_WRONG_SOURCE:
+            printf("%s is not the file which %s was made from\n", pszOldFile, pszPatchFile );
+            goto done;
+        case ERROR_INVALID_DATA:
+            printf("%s is not a PAKTOOL patch, or is damaged\n", pszPatchFile );
+            goto done;
+        default:
+            printf("malloc() failed - out of memory?\n");
+            goto done;
+    }
+    if (( rc = WriteWholeFile( pszOutFile, pbNew, cbNew )) != NO_ERROR ) goto done;
+    printf("%lu segments added, %lu changed, %lu unchanged, %lu printers removed; "
+           "%lu bytes written\n", stats.cAdded, stats.cChanged, stats.cSame, stats.cRemoved, cbNew );
+
+done:
+    PakFree( NULL, pbNew );
+    free( pbPatch );
+    free( pbOld );
+    return rc;
+}
@@ -0,0 +1,96 @@
+/*
+ * pt_dup.c
+ *
+ * PAKTOOL similarity action.  Finds the clusters of near-duplicate printers
+ * in a PAK file (see pakdup.c) and lists each one, with the similarity of
+ * each printer to the first of its cluster and the UI blocks in which they
+ * differ.
+ */
+
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+#include "paktool.h"
+
+#define DUP_DEFAULT_PERCENT 80      // default least similarity (percent)
+
+
+/* ------------------------------------------------------------------------- *
+ * FindSimilar                                                               *
+ *                                                                           *
+ * Implements the SIMILAR action.                                            *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ pszPakFile: Name of the PAK file                                    *
+ *   PSZ pszPercent: Least similarity (percent) for printers to be listed    *
+ *                   together, or NULL for the default                       *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, otherwise an error code                                   *
+ * ------------------------------------------------------------------------- */
+ULONG FindSimilar( PSZ pszPakFile, PSZ pszPercent )
+{
+    PPAK_DEV_DIRENTRY pEntries;
+    PPAKDUPS          pDups = NULL;
+    PBYTE             pbFile;
+    PULONG            pulHashes,
+                      pulNext = NULL;
+    ULONG             cbFile,
+                      cEntries,
+                      ulPercent = DUP_DEFAULT_PERCENT,
+                      cCluster,
+                      cMembers,
+                      i, j;
+    APIRET            rc;
+
+    if ( pszPercent && (( ulPercent = atol( pszPercent )) < 1 || ulPercent > 100 )) {
+        printf("The similarity must be given as a percentage from 1 to 100\n");
+        return ERROR_INVALID_PARAMETER;
+    }
+    if (( rc = LoadPakImage( pszPakFile, &pbFile, &cbFile, &pEntries, &pulHashes, &cEntries )) != NO_ERROR )
+        return rc;
+    if (( rc = PakDupBuild( NULL, pbFile, cbFile, pEntries, cEntries, ulPercent, &pDups )) != NO_ERROR ||
+        ( pulNext = (PULONG) malloc( cEntries * sizeof( ULONG ) + 1 )) == NULL )
+    {
+        printf("malloc() failed - out of memory?\n");
+        rc = ERROR_NOT_ENOUGH_MEMORY;
+        goto done;
+    }
+
+    // Chain the members of each cluster in file order
+    for ( i = 0; i < cEntries; i++ ) pulNext[ i ] = cEntries;
+    for ( i = cEntries; i-- > 0; ) {
+        if ( pDups->pulCluster[ i ] == i ) continue;
+        pulNext[ i ] = pulNext[ pDups->pulCluster[ i ]];
+        pulNext[ pDups->pulCluster[ i ]] = i;
+    }
+
+    printf("%lu printers, of which %lu are in %lu cluster%s of near-duplicates (at least\n"
+           "%lu%% similar); %lu could be replaced by the first of their cluster\n",
+           cEntries, pDups->cClusters + pDups->cDuplicates, pDups->cClusters,
+           ( pDups->cClusters == 1 ) ? "" : "s", ulPercent, pDups->cDuplicates );
+    for ( i = 0, cCluster = 0; i < cEntries; i++ ) {
+        if ( pDups->pulCluster[ i ] != i || pulNext[ i ] == cEntries ) continue;
+        for ( j = pulNext[ i ], cMembers = 1; j < cEntries; j = pulNext[ j ] ) cMembers++;
+        printf("\nCluster %lu (%lu printers):\n  %.40s\n", ++cCluster, cMembers, pEntries[ i ].szDeviceName );
+        for ( j = pulNext[ i ]; j < cEntries; j = pulNext[ j ] ) {
+            printf("  %-40.40s %3lu%%  ", pEntries[ j ].szDeviceName, PakDupSimilarity( pDups, i, j ));
+            if ( !PakDupDiffer( pDups, i, j, NULL )) printf("(identical UI)");
+            printf("\n");
+        }
+    }
+
+done:
+    free( pulNext );
+    PakDupFree( NULL, pDups );
+    free( pEntries );
+    free( pulHashes );
+    free( pbFile );
+    return rc;
+}
@@ -0,0 +1,197 @@
+/*
+ * pt_font.c
+ *
+ * PAKTOOL font action.  Builds the font index (pakfidx.c) of a PAK file and
+ * answers questions about the resident fonts of its printers: which printers
+ * have a font, and which fonts are common to (or found in any of) a group of
+ * printers.
+ */
+
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+#include "paktool.h"
+
+
+/* ------------------------------------------------------------------------- *
+ * ListFonts                                                                 *
+ *                                                                           *
+ * List every font in the index with the number of printers having it.       *
+ * ------------------------------------------------------------------------- */
+static void ListFonts( PPAKFONTIDX pIndex )
+{
+    ULONG f, i, c;
+
+    printf("%lu printers, %lu distinct fonts\n", pIndex->cPrinters, pIndex->cFonts );
+    for ( f = 0; f < pIndex->cFonts; f++ ) {
+        for ( i = 0, c = 0; i < pIndex->cPrinters; i++ )
+            if ( PAKFONTIDX_HAS( pIndex, i, f )) c++;
+        printf("  %-40s %5lu\n", pIndex->apszFonts[ f ], c );
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * FindPrinters                                                              *
+ *                                                                           *
+ * List the printers which have all of the given fonts.                      *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 if any printer has them, otherwise ERROR_PAK_NO_DEVICE                *
+ * ------------------------------------------------------------------------- */
+static ULONG FindPrinters( PPAKFONTIDX pIndex, PSZ *ppszFonts, ULONG cFonts, PLONG plFonts )
+{
+    ULONG i, j, c;
+
+    for ( j = 0; j < cFonts; j++ ) {
+        if (( plFonts[ j ] = PakFontIndexFind( pIndex, ppszFonts[ j ] )) < 0 ) {
+            printf("No printer has the font %s\n", ppszFonts[ j ] );
+            return ERROR_PAK_NO_DEVICE;
+        }
+    }
+    for ( i = 0, c = 0; i < pIndex->cPrinters; i++ ) {
+        for ( j = 0; j < cFonts && PAKFONTIDX_HAS( pIndex, i, plFonts[ j ] ); j++ );
+        if ( j < cFonts ) continue;
+        printf("%.40s\n", pIndex->pEntries[ i ].szDeviceName );
+        c++;
+    }
+    if ( !c ) printf("No printer has all of these fonts\n");
+    return c ? NO_ERROR : ERROR_PAK_NO_DEVICE;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CombineFonts                                                              *
+ *                                                                           *
+ * List the fonts which all (or any) of the given printers have.  A name     *
+ * which is not that of a printer stands for every printer it selects (see   *
+ * PakNameFind), such as all those whose names begin with it.                *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0, or ERROR_PAK_NO_DEVICE if a printer is not found                     *
+ * ------------------------------------------------------------------------- */
+static ULONG CombineFonts( PPAKFONTIDX pIndex, PSZ *ppszPrinters, ULONG cNames,
+                           BOOL fUnion, PULONG pulPrinters, PULONG pulSet )
+{
+    PPAKNAMES pNames = NULL;
+    PULONG    pulFound = NULL;
+    ULONG     cPrinters, cFound, c, f, i, j, k;
+    LONG      l;
+    APIRET    rc = NO_ERROR;
+
+    for ( i = 0, cPrinters = 0; i < cNames; i++ ) {
+        if ( strcmp( ppszPrinters[ i ], "*") == 0 ) {
+            for ( cPrinters = 0; cPrinters < pIndex->cPrinters; cPrinters++ )
+                pulPrinters[ cPrinters ] = cPrinters;
+            break;
+        }
+        if (( l = PakFontIndexPrinter( pIndex, ppszPrinters[ i ] )) >= 0 ) {
+            pulPrinters[ cPrinters++ ] = l;
+            continue;
+        }
+
+        if ( !pNames ) {
+            pulFound = (PULONG) malloc( pIndex->cPrinters * sizeof( ULONG ) + 1 );
+            if ( !pulFound || PakNameIndex( NULL, pIndex->pEntries, pIndex->cPrinters, &pNames )) {
+                printf("malloc() failed - out of memory?\n");
+                rc = ERROR_NOT_ENOUGH_MEMORY;
+                goto done;
+            }
+        }
+        if ( PakNameFind( pNames, ppszPrinters[ i ], pulFound, pIndex->cPrinters, &cFound )
+             == PAKNAME_NONE )
+        {
+            printf("Printer not found: %s\n", ppszPrinters[ i ] );
+            SuggestPrinters( pNames, pIndex->pEntries, ppszPrinters[ i ] );
+            rc = ERROR_PAK_NO_DEVICE;
+            goto done;
+        }
+
+        // Each printer is taken once, however many names select it
+        for ( j = 0; j < cFound; j++ ) {
+            for ( k = 0; k < cPrinters && pulPrinters[ k ] != pulFound[ j ]; k++ );
+            if ( k == cPrinters ) pulPrinters[ cPrinters++ ] = pulFound[ j ];
+        }
+    }
+
+    c = PakFontIndexCombine( pIndex, pulPrinters, cPrinters, fUnion, pulSet );
+    printf("%lu fonts %s %lu printer%s\n", c, fUnion ? "found in any of" : "common to",
+           cPrinters, ( cPrinters == 1 ) ? "" : "s");
+    for ( f = 0; f < pIndex->cFonts; f++ ) {
+        if ( pulSet[ f / 32 ] & ( 1UL << ( f % 32 )))
+            printf("  %s\n", pIndex->apszFonts[ f ] );
+    }
+
+done:
+    PakNameFree( NULL, pNames );
+    free( pulFound );
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ShowFonts                                                                 *
+ *                                                                           *
+ * Implements the FONTS action.                                              *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ   pszPakFile: Name of the PAK file                                  *
+ *   PSZ  *ppszArgs  : HAS <font> ..., COMMON <printer> ..., ANY <printer>   *
+ *                     ..., or none to list every font                       *
+ *   ULONG cArgs     : Number of arguments                                   *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, ERROR_PAK_NO_DEVICE if no printer matches (or a printer   *
+ *   named is not found), otherwise an error code                            *
+ * ------------------------------------------------------------------------- */
+ULONG ShowFonts( PSZ pszPakFile, PSZ *ppszArgs, ULONG cArgs )
+{
+    PPAKFONTIDX       pIndex = NULL;
+    PPAK_DEV_DIRENTRY pEntries;
+    PBYTE             pbFile;
+    PULONG            pulHashes,
+                      pulScratch = NULL;
+    ULONG             cbFile,
+                      cEntries;
+    APIRET            rc;
+
+    if ( cArgs && ( cArgs < 2 || ( stricmp( ppszArgs[ 0 ], "HAS") != 0 &&
+                                   stricmp( ppszArgs[ 0 ], "COMMON") != 0 &&
+                                   stricmp( ppszArgs[ 0 ], "ANY") != 0 )))
+    {
+        printf("Usage: FONTS [HAS <font> ... | COMMON <printer> ... | ANY <printer> ...]\n");
+        return ERROR_INVALID_PARAMETER;
+    }
+
+    if (( rc = LoadPakImage( pszPakFile, &pbFile, &cbFile, &pEntries, &pulHashes, &cEntries )) != NO_ERROR )
+        return rc;
+    if (( rc = PakFontIndexBuild( NULL, pbFile, cbFile, pEntries, cEntries, &pIndex )) != NO_ERROR ||
+        ( pulScratch = (PULONG) malloc(( cArgs + cEntries + pIndex->cWords + 1 ) * sizeof( ULONG ))) == NULL )
+    {
+        printf("malloc() failed - out of memory?\n");
+        rc = ERROR_NOT_ENOUGH_MEMORY;
+        goto done;
+    }
+
+    if ( !cArgs )
+        ListFonts( pIndex );
+    else if ( stricmp( ppszArgs[ 0 ], "HAS") == 0 )
+        rc = FindPrinters( pIndex, ppszArgs + 1, cArgs - 1, (PLONG) pulScratch );
+    else
+        rc = CombineFonts( pIndex, ppszArgs + 1, cArgs - 1, stricmp( ppszArgs[ 0 ], "ANY") == 0,
+                           pulScratch, pulScratch + cEntries + cArgs );
+
+done:
+    free( pulScratch );
+    PakFontIndexFree( NULL, pIndex );
+    free( pEntries );
+    free( pulHashes );
+    free( pbFile );
+    return rc;
+}
@@ -0,0 +1,212 @@
+/*
+ * pt_fpak.c
+ *
+ * PAKTOOL font PAK actions.  Lists, dumps and extracts the fonts in a font
+ * PAK file (font1.pak, auxfont.pak), using the indexed reader in pakfont.c.
+ * Fonts are written straight from the file image, which is read only once.
+ */
+
+#define INCL_DOSFILEMGR
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+#include "paktool.h"
+
+#define FONT_FILE_EXT       ".dat"  // extension of extracted font files
+
+
+/* ------------------------------------------------------------------------- *
+ * OpenFontPak                                                               *
+ *                                                                           *
+ * Open a font PAK file, reporting any error.                                *
+ * ------------------------------------------------------------------------- */
+static ULONG OpenFontPak( PSZ pszPakFile, PPAKFONTPAK *ppPak )
+{
+    APIRET rc;
+
+    rc = PakFontPakOpen( NULL, pszPakFile, ppPak );
+    switch ( rc ) {
+        case NO_ERROR:                                                          break;
+        case ERROR_INVALID_DATA:      printf("Invalid font PAK file directory!\n"); break;
+        case ERROR_NOT_ENOUGH_MEMORY: printf("malloc() failed - out of memory?\n"); break;
+        case ERROR_HANDLE_EOF:        printf("Error reading font data.\n");         break;
+        default:                      ReportOpenError( rc );                        break;
+    }
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * FindFont                                                                  *
+ *                                                                           *
+ * Find a font by PostScript name or, failing that, by full name.            *
+ * ------------------------------------------------------------------------- */
+static PPAK_FONT_DIRENTRY FindFont( PPAKFONTPAK pPak, PSZ pszFont )
+{
+    PPAK_FONT_DIRENTRY pEntry;
+
+    if ( !pszFont ) return pPak->cEntries ? pPak->pEntries : NULL;
+    if (( pEntry = PakFontPakFind( pPak, pszFont, FALSE )) == NULL )
+        pEntry = PakFontPakFind( pPak, pszFont, TRUE );
+    return pEntry;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ListFontPak                                                               *
+ *                                                                           *
+ * Implements the L action for a font PAK file.                              *
+ * ------------------------------------------------------------------------- */
+ULONG ListFontPak( PSZ pszPakFile )
+{
+    PPAKFONTPAK        pPak;
+    PPAK_FONT_DIRENTRY pEntry;
+    ULONG              i;
+    APIRET             rc;
+
+    if (( rc = OpenFontPak( pszPakFile, &pPak )) != NO_ERROR ) return rc;
+
+    printf("%s\n==============\n", ((PPAKSIGNATURE) pPak->pbFile )->szName );
+    printf("%lu fonts defined:\n", pPak->cEntries );
+    for ( i = 0, pEntry = pPak->pEntries; i < pPak->cEntries; i++, pEntry++ ) {
+        printf(" - %.40s \"%.40s\" (offset 0x%X, %u bytes, flags=0x%X)\n",
+               pEntry->szFontName, pEntry->szFontFullName,
+               pEntry->ulOffset, pEntry->ulSize, pEntry->ulFlags );
+    }
+    PakFontPakClose( NULL, pPak );
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * DumpFontPak                                                               *
+ *                                                                           *
+ * Implements the D, X and B actions for a font PAK file.                    *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ    pszPakFile: Name of the font PAK file                            *
+ *   PSZ    pszFont   : PostScript or full name of the font (or NULL for the *
+ *                      first)                                               *
+ *   USHORT fsMode    : DEV_RAW_DATA, DEV_HEX_DATA or DEV_BIN_DATA           *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, otherwise an error code                                   *
+ * ------------------------------------------------------------------------- */
+ULONG DumpFontPak( PSZ pszPakFile, PSZ pszFont, USHORT fsMode )
+{
+    PPAKFONTPAK        pPak;
+    PPAK_FONT_DIRENTRY pEntry;
+    PBYTE              pb;
+    APIRET             rc;
+
+    if (( rc = OpenFontPak( pszPakFile, &pPak )) != NO_ERROR ) return rc;
+
+    if (( pEntry = FindFont( pPak, pszFont )) == NULL )
+        printf("The requested font was not found\n");
+    else if (( pb = PakFontPakData( pPak, pEntry )) == NULL )
+        printf("Error reading font data.\n");
+    else switch ( fsMode ) {
+        case DEV_RAW_DATA: DumpBytes( pb, pEntry->ulSize, FALSE, NULL ); break;
+        case DEV_HEX_DATA: DumpBytes( pb, pEntry->ulSize, TRUE, NULL );  break;
+        case DEV_BIN_DATA: PrettyBytes( pb, pEntry->ulSize, NULL );      break;
+    }
+    PakFontPakClose( NULL, pPak );
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * WriteFont                                                                 *
+ *                                                                           *
+ * Write the data of one font to <pszDir>\<font name>.dat.                   *
+ * ------------------------------------------------------------------------- */
+static ULONG WriteFont( PPAKFONTPAK pPak, PPAK_FONT_DIRENTRY pEntry, PSZ pszDir )
+{
+    CHAR   szFile[ CCHMAXPATH ];
+    HFILE  hf;
+    PBYTE  pb;
+    ULONG  ulAction,
+           ulResult;
+    APIRET rc;
+
+    if (( pb = PakFontPakData( pPak, pEntry )) == NULL ) {
+        printf("%.40s: font data runs past the end of the file\n", pEntry->szFontName );
+        return ERROR_HANDLE_EOF;
+    }
+    if ( strlen( pszDir ) + PAKFONT_NAME_SIZE + sizeof( FONT_FILE_EXT ) + 1 >= sizeof( szFile ))
+        return ERROR_FILENAME_EXCED_RANGE;
+    sprintf( szFile, "%s%s%.40s" FONT_FILE_EXT, pszDir,
+             ( *pszDir && !strchr("\\/:", pszDir[ strlen( pszDir ) - 1 ] )) ? "\\" : "",
+             pEntry->szFontName );
+
+    rc = DosOpen( szFile, &hf, &ulAction, 0, FILE_NORMAL,
+                  OPEN_ACTION_CREATE_IF_NEW | OPEN_ACTION_REPLACE_IF_EXISTS,
+                  OPEN_FLAGS_FAIL_ON_ERROR | OPEN_FLAGS_SEQUENTIAL |
+                  OPEN_SHARE_DENYREADWRITE | OPEN_ACCESS_WRITEONLY, NULL );
+    if ( !rc ) {
+        rc = DosWrite( hf, pb, pEntry->ulSize, &ulResult );
+        if ( !rc && ulResult < pEntry->ulSize ) rc = ERROR_WRITE_FAULT;
+        DosClose( hf );
+    }
+    if ( rc ) printf("%s: unable to write file (error %u)\n", szFile, rc );
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ExtractFontPak                                                            *
+ *                                                                           *
+ * Implements the EXTRACT action: write the data of each font (or of those   *
+ * named) to a file of its own.                                              *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ    pszPakFile: Name of the font PAK file                            *
+ *   PSZ    pszDir    : Directory to write to                                *
+ *   PSZ   *ppszFonts : PostScript or full names of the fonts to extract     *
+ *   ULONG  cFonts    : Number of fonts named (0 to extract all)             *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 if every font was written, otherwise the last error code              *
+ * ------------------------------------------------------------------------- */
+ULONG ExtractFontPak( PSZ pszPakFile, PSZ pszDir, PSZ *ppszFonts, ULONG cFonts )
+{
+    PPAKFONTPAK        pPak;
+    PPAK_FONT_DIRENTRY pEntry;
+    ULONG              cWritten = 0,
+                       cbWritten = 0,
+                       i;
+    APIRET             rc,
+                       rcLast = NO_ERROR;
+
+    if ( !pszDir ) {
+        printf("The directory to extract to must be given\n");
+        return ERROR_INVALID_PARAMETER;
+    }
+    if (( rc = OpenFontPak( pszPakFile, &pPak )) != NO_ERROR ) return rc;
+
+    for ( i = 0; i < ( cFonts ? cFonts : pPak->cEntries ); i++ ) {
+        if ( !cFonts )
+            pEntry = pPak->pEntries + i;
+        else if (( pEntry = FindFont( pPak, ppszFonts[ i ] )) == NULL ) {
+            printf("%s: font not found\n", ppszFonts[ i ] );
+            rcLast = ERROR_FILE_NOT_FOUND;
+            continue;
+        }
+        if (( rc = WriteFont( pPak, pEntry, pszDir )) != NO_ERROR ) {
+            rcLast = rc;
+            continue;
+        }
+        cWritten++;
+        cbWritten += pEntry->ulSize;
+    }
+    printf("%lu fonts (%lu bytes) extracted\n", cWritten, cbWritten );
+
+    PakFontPakClose( NULL, pPak );
+    return rcLast;
+}
@@ -0,0 +1,142 @@
+/*
+ * pt_fqry.c
+ *
+ * PAKTOOL field queries.  FIELD writes the value of one or more fields (PPD
+ * main keywords, Default<keyword> for UI keywords, or DESPPD field names)
+ * for one printer or for every printer in a PAK file.  Only the parts of
+ * each segment which the fields need are read (see paklazy.c), so a query
+ * over a whole PAK file touches only a small fraction of it.
+ */
+
+#define INCL_DOSFILEMGR
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+#include "paktool.h"
+
+
+/* ------------------------------------------------------------------------- *
+ * QueryFields                                                               *
+ *                                                                           *
+ * Write one printer's line of field values.  Returns TRUE if the printer's  *
+ * data is damaged.                                                          *
+ * ------------------------------------------------------------------------- */
+static BOOL QueryFields( HFILE hf, PPAK_DEV_DIRENTRY pEntry, PSZ *ppszFields, ULONG cFields,
+                         PPAKDICT pDict, PULONG pcbRead )
+{
+    PAKLAZY lazy;
+    BOOL    fDamaged = FALSE;
+    ULONG   i;
+    APIRET  rc;
+
+    printf("%.40s:", pEntry->szDeviceName );
+    if ( PakLazyOpen( NULL, hf, pEntry, &lazy ) != NO_ERROR ) {
+        printf(" (damaged; use CHECK for details)\n");
+        fDamaged = TRUE;
+    }
+    else {
+        for ( i = 0; i < cFields; i++ ) {
+            printf( i ? " | " : " ");
+            rc = PakLazyField( &lazy, ppszFields[ i ], pDict, NULL );
+            if ( rc == ERROR_PAK_NO_KEYWORD )
+                printf("(none)");
+            else if ( rc ) {
+                printf("(damaged)");
+                fDamaged = TRUE;
+            }
+        }
+        printf("\n");
+    }
+    *pcbRead += lazy.cbRead;
+    PakLazyClose( &lazy );
+    return fDamaged;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * QueryPakFields                                                            *
+ *                                                                           *
+ * Implements the FIELD action.                                              *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ       pszPakFile: Name of the PAK file (V1 or V2)                   *
+ *   PSZ       pszPrinter: Printer name, NULL for the first, or a pattern    *
+ *                         such as "*" (see PakNameGlob)                     *
+ *   PSZ      *ppszFields: Fields to write (see PakLazyField)                *
+ *   ULONG     cFields   : Number of fields                                  *
+ *   PPAKDICT  pDict     : Keyword dictionary (NULL for built-in)            *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success; ERROR_INVALID_DATA if any printer's data is damaged;      *
+ *   ERROR_PAK_NO_DEVICE if the printer was not found; otherwise an error    *
+ *   code                                                                    *
+ * ------------------------------------------------------------------------- */
+ULONG QueryPakFields( PSZ pszPakFile, PSZ pszPrinter, PSZ *ppszFields, ULONG cFields, PPAKDICT pDict )
+{
+    PAK_DEV_DIRENTRY  dev;
+    PAKSIGNATURE      pak_sig;
+    PPAK_DEV_DIRENTRY pEntries;
+    PBYTE             pDir = NULL;
+    HFILE             hf;
+    ULONG             cbRead = 0,
+                      cbTotal = 0,
+                      cDamaged = 0,
+                      cShown = 0,
+                      i;
+    APIRET            rc;
+
+    if ( !cFields ) {
+        printf("At least one field must be given, e.g. ModelName or DefaultResolution\n");
+        return ERROR_INVALID_PARAMETER;
+    }
+
+    if ( !pszPrinter || !strpbrk( pszPrinter, "*?")) {
+        if (( rc = PakFindDevice( NULL, pszPakFile, pszPrinter, &dev )) == ERROR_PAK_NO_DEVICE ) {
+            printf("The requested printer was not found\n");
+            return rc;
+        }
+    }
+    else
+        rc = PakLoadDirectory( NULL, pszPakFile, PAKSIGNATURE_DEVPACK_V1,
+                               sizeof( PAK_DEV_DIRENTRY ), &pDir );
+    if ( rc == ERROR_INVALID_DATA ) {
+        printf("Invalid PAK file signature!\n");
+        return rc;
+    }
+    else if ( rc ) {
+        ReportOpenError( rc );
+        return rc;
+    }
+    if (( rc = PakLazyOpenFile( pszPakFile, &hf )) != NO_ERROR ) {
+        ReportOpenError( rc );
+        PakFree( NULL, pDir );
+        return rc;
+    }
+
+    if ( !pDir ) {
+        if ( QueryFields( hf, &dev, ppszFields, cFields, pDict, &cbRead )) cDamaged++;
+    }
+    else {
+        memcpy( &pak_sig, pDir, sizeof( PAKSIGNATURE ));
+        pEntries = (PPAK_DEV_DIRENTRY)( pDir + sizeof( PAKSIGNATURE ));
+        for ( i = 0; i < (ULONG) pak_sig.iEntries; i++ ) {
+            if ( !PakNameGlob( pszPrinter, pEntries[ i ].szDeviceName )) continue;
+            cShown++;
+            if ( QueryFields( hf, pEntries + i, ppszFields, cFields, pDict, &cbRead )) cDamaged++;
+            cbTotal += pEntries[ i ].ulSize;
+        }
+        printf("%s: %lu printers, %lu KB of %lu KB of printer data read (%lu%%)\n",
+               pszPakFile, cShown, ( cbRead + 1023 ) / 1024, ( cbTotal + 1023 ) / 1024,
+               cbTotal ? (ULONG)(( cbRead * 100.0 ) / cbTotal + 0.5 ) : 0 );
+        if ( cDamaged ) printf("%lu damaged printers; use CHECK for details\n", cDamaged );
+        PakFree( NULL, pDir );
+    }
+    DosClose( hf );
+    return cDamaged ? ERROR_INVALID_DATA : NO_ERROR;
+}
@@ -0,0 +1,226 @@
+/*
+ * pt_info.c
+ *
+ * PAKTOOL information segment actions.  SLACK reports how much of each
+ * printer's information segment is actually referenced (see pakinfo.c), and
+ * COMPACT writes a copy of a PAK file with every information segment rebuilt
+ * from just the bytes referenced.
+ */
+
+#define INCL_DOSFILEMGR
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+#include "paktool.h"
+
+
+/* ------------------------------------------------------------------------- *
+ * ShowUnused                                                                *
+ *                                                                           *
+ * List the ranges of an information segment which are not referenced.       *
+ * ------------------------------------------------------------------------- */
+static void ShowUnused( PPAKINFOMAP pMap )
+{
+    ULONG i, ulStart;
+    BOOL  fAny = FALSE;
+
+    for ( i = 0; i < pMap->cbInfo; ) {
+        if ( pMap->pulUsed[ i / 32 ] & ( 1UL << ( i % 32 ))) {
+            i++;
+            continue;
+        }
+        for ( ulStart = i; i < pMap->cbInfo && !( pMap->pulUsed[ i / 32 ] & ( 1UL << ( i % 32 ))); i++ );
+        printf("%s0x%lX-0x%lX", fAny ? ", " : "  Unreferenced: ", ulStart, i - 1 );
+        fAny = TRUE;
+    }
+    printf( fAny ? "\n" : "  Every byte is referenced.\n");
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ShowSlack                                                                 *
+ *                                                                           *
+ * Implements the SLACK action.                                              *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ pszPakFile: Name of the PAK file                                    *
+ *   PSZ pszPrinter: Printer whose unreferenced bytes are to be listed, a    *
+ *                   pattern selecting the printers to summarise (see        *
+ *                   PakNameGlob), or NULL to summarise every printer        *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, otherwise an error code                                   *
+ * ------------------------------------------------------------------------- */
+ULONG ShowSlack( PSZ pszPakFile, PSZ pszPrinter )
+{
+    PPAK_DEV_DIRENTRY pEntries,
+                      pEntry;
+    PAKINFOMAP        map;
+    PBYTE             pbFile,
+                      pbNew;
+    PULONG            pulHashes;
+    ULONG             cbFile,
+                      cEntries,
+                      cbNew,
+                      ulEnd,
+                      cbInSegments = 0,
+                      cbTotal[ 6 ] = {0},
+                      cShown = 0,
+                      i, j;
+    BOOL              fPattern = pszPrinter && strpbrk( pszPrinter, "*?");
+    APIRET            rc = NO_ERROR;
+
+    if (( rc = LoadPakImage( pszPakFile, &pbFile, &cbFile, &pEntries, &pulHashes, &cEntries )) != NO_ERROR )
+        return rc;
+
+    printf("%-40s %6s %6s %6s %6s %6s %9s\n", "Printer", "Info", "Used", "Unused",
+           "Repeat", "Tail", "Compacted");
+    for ( i = 0, pEntry = pEntries; i < cEntries; i++, pEntry++ ) {
+        if ( fPattern ? !PakNameGlob( pszPrinter, pEntry->szDeviceName ) :
+             ( pszPrinter && strnicmp( pEntry->szDeviceName, pszPrinter, sizeof( pEntry->szDeviceName ))))
+            continue;
+        cShown++;
+        if (( pEntry->ulOffset > cbFile ) || ( pEntry->ulSize > cbFile - pEntry->ulOffset ) ||
+            ( rc = PakInfoMap( NULL, pEntry, pbFile + pEntry->ulOffset, &map )) == ERROR_INVALID_DATA )
+        {
+            printf("%-40.40s (damaged; use CHECK for details)\n", pEntry->szDeviceName );
+            rc = NO_ERROR;
+            continue;
+        }
+        if ( rc ) {
+            printf("malloc() failed - out of memory?\n");
+            break;
+        }
+        printf("%-40.40s %6lu %6lu %6lu %6lu %6lu ", pEntry->szDeviceName, map.cbInfo, map.cbUsed,
+               map.cbInfo - map.cbUsed, map.cbDuplicate, map.cbTail );
+        if ( PakInfoCompact( NULL, pEntry, pbFile + pEntry->ulOffset, &pbNew, &cbNew ) == NO_ERROR &&
+             cbNew < pEntry->ulSize )
+        {
+            // Size of the information segment after compaction
+            cbNew -= pEntry->ulSize - map.cbInfo - map.cbTail;
+            printf("%9lu\n", cbNew );
+            cbTotal[ 5 ] += map.cbInfo + map.cbTail - cbNew;
+        }
+        else
+            printf("%9s\n", map.cUnknown ? "(unsafe)" : "-");
+        PakFree( NULL, pbNew );
+        cbTotal[ 0 ] += map.cbInfo;
+        cbTotal[ 1 ] += map.cbUsed;
+        cbTotal[ 2 ] += map.cbInfo - map.cbUsed;
+        cbTotal[ 3 ] += map.cbDuplicate;
+        cbTotal[ 4 ] += map.cbTail;
+        if ( pszPrinter && !fPattern ) ShowUnused( &map );
+        PakInfoMapFree( NULL, &map );
+    }
+
+    if ( pszPrinter && !cShown ) {
+        printf("The requested printer was not found\n");
+        rc = ERROR_PAK_NO_DEVICE;
+    }
+    else if ( !rc && ( !pszPrinter || fPattern )) {
+        printf("%-40s %6lu %6lu %6lu %6lu %6lu\n", "Total", cbTotal[ 0 ], cbTotal[ 1 ],
+               cbTotal[ 2 ], cbTotal[ 3 ], cbTotal[ 4 ] );
+        printf("\nCompaction would save %lu bytes", cbTotal[ 5 ] );
+
+        // Bytes of a V1 file outside the header and every segment (shared ones once)
+        if ( !pulHashes && !pszPrinter ) {
+            for ( i = 0, ulEnd = cbFile; i < cEntries; i++ )
+                if ( pEntries[ i ].ulOffset < ulEnd ) ulEnd = pEntries[ i ].ulOffset;
+            cbInSegments = cEntries ? ulEnd : cbFile;
+            for ( i = 0, ulEnd = 0; i < cEntries; i++ ) {
+                for ( j = 0; j < i; j++ )
+                    if ( pEntries[ j ].ulOffset == pEntries[ i ].ulOffset ) break;
+                if ( j == i ) cbInSegments += pEntries[ i ].ulSize;
+            }
+            if ( cbInSegments < cbFile )
+                printf(", plus %lu bytes which are outside any segment", cbFile - cbInSegments );
+        }
+        printf(".\n");
+    }
+
+    free( pEntries );
+    free( pulHashes );
+    free( pbFile );
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CompactPakFile                                                            *
+ *                                                                           *
+ * Implements the COMPACT action.                                            *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ pszPakFile: Name of the (V1) PAK file                               *
+ *   PSZ pszOutFile: Name of the compacted PAK file to create                *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, otherwise an error code                                   *
+ * ------------------------------------------------------------------------- */
+ULONG CompactPakFile( PSZ pszPakFile, PSZ pszOutFile )
+{
+    PPAK_DEV_DIRENTRY pEntries;
+    PBYTE             pbFile,
+                      pbOut = NULL;
+    PULONG            pulHashes;
+    ULONG             cbFile,
+                      cbOut,
+                      cEntries,
+                      cCompacted,
+                      ulAction,
+                      ulResult;
+    HFILE             hf;
+    APIRET            rc;
+
+    if ( !pszOutFile ) {
+        printf("No output file was given\n");
+        return ERROR_INVALID_PARAMETER;
+    }
+    if (( rc = LoadPakImage( pszPakFile, &pbFile, &cbFile, &pEntries, &pulHashes, &cEntries )) != NO_ERROR )
+        return rc;
+    if ( pulHashes ) {
+        printf("Only V1 PAK files can be compacted; use CONVERT first\n");
+        rc = ERROR_INVALID_PARAMETER;
+        goto done;
+    }
+
+    rc = PakCompactImage( NULL, pbFile, cbFile, &pbOut, &cbOut, &cCompacted );
+    if ( rc == ERROR_INVALID_DATA ) {
+        printf("The PAK file directory is damaged; use CHECK for details.\n");
+        goto done;
+    }
+    if ( rc ) {
+        printf("malloc() failed - out of memory?\n");
+        goto done;
+    }
+
+    rc = DosOpen( pszOutFile, &hf, &ulAction, 0, FILE_NORMAL,
+                  OPEN_ACTION_CREATE_IF_NEW | OPEN_ACTION_REPLACE_IF_EXISTS,
+                  OPEN_FLAGS_FAIL_ON_ERROR | OPEN_FLAGS_SEQUENTIAL |
+                  OPEN_SHARE_DENYREADWRITE | OPEN_ACCESS_WRITEONLY, NULL );
+    if ( !rc ) {
+        rc = DosWrite( hf, pbOut, cbOut, &ulResult );
+        if ( !rc && ulResult < cbOut ) rc = ERROR_WRITE_FAULT;
+        DosClose( hf );
+        if ( rc ) DosDelete( pszOutFile );
+    }
+    if ( rc ) {
+        printf("%s: unable to write file (error %u)\n", pszOutFile, rc );
+        goto done;
+    }
+    printf("%lu of %lu printers compacted; %lu bytes written (%lu fewer than %s)\n",
+           cCompacted, cEntries, cbOut, cbFile - cbOut, pszPakFile );
+
+done:
+    PakFree( NULL, pbOut );
+    free( pEntries );
+    free( pulHashes );
+    free( pbFile );
+    return rc;
+}
@@ -0,0 +1,80 @@
+/*
+ * pt_job.c
+ *
+ * PAKTOOL job ticket action.  Loads one printer, builds its job ticket
+ * template (pakjob.c), and writes the setup code for its default options, or
+ * for the options given on the command line, to STDOUT.
+ */
+
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+#include "paktool.h"
+
+
+/* ------------------------------------------------------------------------- *
+ * RenderJob                                                                 *
+ *                                                                           *
+ * Implements the JOB action.                                                *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ      pszPakFile : Name of the PAK file                              *
+ *   PSZ      pszPrinter : Printer name (or NULL for the first)              *
+ *   PSZ     *ppszOptions: Options to select, as "Keyword=Option"            *
+ *   ULONG    cOptions   : Number of options (0 for the defaults)            *
+ *   PPAKDICT pDict      : Keyword dictionary (NULL for built-in)            *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, otherwise an error code                                   *
+ * ------------------------------------------------------------------------- */
+ULONG RenderJob( PSZ pszPakFile, PSZ pszPrinter, PSZ *ppszOptions, ULONG cOptions,
+                 PPAKDICT pDict )
+{
+    PAK_DEV_DIRENTRY dev;
+    PAKARENA         arena = {0};
+    PPAKJOB          pJob = NULL;
+    PBYTE            pSegment;
+    PUI_SEL          pSel = NULL;
+    ULONG            cBlocks;
+    APIRET           rc;
+
+    if (( rc = LoadPrinter( pszPakFile, pszPrinter, &dev, &pSegment )) != NO_ERROR )
+        return rc;
+
+    arena.pDict = pDict;
+    if (( rc = PakJobBuild( NULL, &arena, pSegment, dev.ulSize, &pJob )) != NO_ERROR ) {
+        if ( rc == ERROR_INVALID_DATA )
+            printf("The UI data of %.40s is damaged; use CHECK for details.\n", dev.szDeviceName );
+        else
+            printf("malloc() failed - out of memory?\n");
+        goto done;
+    }
+
+    if ( cOptions ) {
+        cBlocks = pJob->pUic->cBlocks;
+        if (( pSel = (PUI_SEL) calloc( 2 * cBlocks + 1, sizeof( UI_SEL ))) == NULL ) {
+            printf("malloc() failed - out of memory?\n");
+            rc = ERROR_NOT_ENOUGH_MEMORY;
+            goto done;
+        }
+        memcpy( pSel, pJob->pDefaults, cBlocks * sizeof( UI_SEL ));
+        if ( !ApplyOptions( pJob->pUic, ppszOptions, cOptions, pSel, pSel + cBlocks )) {
+            rc = ERROR_INVALID_PARAMETER;
+            goto done;
+        }
+    }
+    PakJobRender( pJob, pSel, NULL );
+
+done:
+    free( pSel );
+    PakJobFree( NULL, pJob );
+    ArenaFree( &arena );
+    PakFree( NULL, pSegment );
+    return rc;
+}
@@ -0,0 +1,156 @@
+/*
+ * pt_paper.c
+ *
+ * PAKTOOL paper action.  Lists the decoded paper tables of a printer, or
+ * finds the PageSize nearest to a given document size, on one printer or on
+ * every printer in the PAK file.
+ */
+
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+#include "paktool.h"
+
+#define PAPER_TOLERANCE     2       // default tolerance (points)
+
+
+/* ------------------------------------------------------------------------- *
+ * ShowPaper                                                                 *
+ *                                                                           *
+ * Show the paper tables of one printer, or the paper nearest the given      *
+ * size.                                                                     *
+ *                                                                           *
+ * RETURNS: BOOL                                                             *
+ *   TRUE if a paper was found (or the tables were listed)                   *
+ * ------------------------------------------------------------------------- */
+static BOOL ShowPaper( PPAK_DEV_DIRENTRY pEntry, PBYTE pSegment, PPAKARENA pArena,
+                       LONG cx, LONG cy, LONG lTolerance, ULONG flOptions )
+{
+    PPAKPAPERS pPapers;
+    PPAKPAPER  pPaper;
+    BOOL       fRotated;
+    ULONG      i;
+    APIRET     rc;
+
+    if (( rc = PakPaperBuild( NULL, pArena, pSegment, pEntry->ulSize, &pPapers )) != NO_ERROR ) {
+        printf("%.40s: %s\n", pEntry->szDeviceName, ( rc == ERROR_INVALID_DATA ) ?
+               "damaged data; use CHECK for details" : "out of memory");
+        return FALSE;
+    }
+
+    if ( !cx ) {
+        printf("%.40s: %lu papers, %lu forms\n", pEntry->szDeviceName,
+               pPapers->cPapers, pPapers->cForms );
+        for ( i = 0; i < pPapers->cPapers; i++ ) {
+            pPaper = pPapers->aPapers + i;
+            printf("  %-20s %5d x %-5d", pPaper->pszName, pPaper->cx, pPaper->cy );
+            if ( pPaper->fImageable )
+                printf("  imageable %d %d %d %d", pPaper->xLeft, pPaper->yBottom,
+                       pPaper->xRight, pPaper->yTop );
+            if ( strcmp( pPaper->pszXlate, pPaper->pszName ) != 0 )
+                printf("  \"%s\"", Cp850String( pArena, pPaper->pszXlate ));
+            printf("\n");
+        }
+        for ( i = 0; i < pPapers->cForms; i++ )
+            printf("  Form: %s\n", pPapers->apszForms[ i ] );
+        PakPaperFree( NULL, pPapers );
+        return TRUE;
+    }
+
+    pPaper = PakPaperNearest( pPapers, cx, cy, lTolerance, flOptions, &fRotated );
+    if ( !pPaper )
+        printf("%.40s: no paper within %ld points of %ld x %ld\n",
+               pEntry->szDeviceName, lTolerance, cx, cy );
+    else {
+        printf("%.40s: %s (%d x %d", pEntry->szDeviceName, pPaper->pszName, pPaper->cx, pPaper->cy );
+        if ( pPaper->fImageable )
+            printf("; imageable %d %d %d %d", pPaper->xLeft, pPaper->yBottom,
+                   pPaper->xRight, pPaper->yTop );
+        printf(")%s\n", fRotated ? " rotated" : "");
+    }
+    PakPaperFree( NULL, pPapers );
+    return ( pPaper != NULL );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ShowPapers                                                                *
+ *                                                                           *
+ * Implements the PAPER action.                                              *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ      pszPakFile: Name of the PAK file                               *
+ *   PSZ      pszPrinter: Printer name, NULL for the first, or a pattern     *
+ *                        such as "*" (see PakNameGlob)                      *
+ *   PSZ     *ppszArgs  : <width> <height> [<tolerance>] [FIXED], or none to *
+ *                        list the paper tables                              *
+ *   ULONG    cArgs     : Number of arguments                                *
+ *   PPAKDICT pDict     : Keyword dictionary (NULL for built-in)             *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 if a paper was found on at least one printer, ERROR_PAK_NO_PAPER if   *
+ *   not, otherwise an error code                                            *
+ * ------------------------------------------------------------------------- */
+ULONG ShowPapers( PSZ pszPakFile, PSZ pszPrinter, PSZ *ppszArgs, ULONG cArgs, PPAKDICT pDict )
+{
+    PAK_DEV_DIRENTRY  dev;
+    PAKARENA          arena = {0};
+    PPAK_DEV_DIRENTRY pEntries;
+    PBYTE             pbFile,
+                      pSegment;
+    PULONG            pulHashes;
+    ULONG             cbFile,
+                      cEntries,
+                      flOptions = 0,
+                      cFound = 0,
+                      i;
+    LONG              cx = 0,
+                      cy = 0,
+                      lTolerance = PAPER_TOLERANCE;
+    APIRET            rc;
+
+    if ( cArgs ) {
+        if ( cArgs < 2 || ( cx = atol( ppszArgs[ 0 ] )) <= 0 || ( cy = atol( ppszArgs[ 1 ] )) <= 0 ) {
+            printf("The paper size must be given as <width> <height> in points\n");
+            return ERROR_INVALID_PARAMETER;
+        }
+        for ( i = 2; i < cArgs; i++ ) {
+            if ( stricmp( ppszArgs[ i ], "FIXED") == 0 ) flOptions |= PAKPAPER_FIXED;
+            else lTolerance = atol( ppszArgs[ i ] );
+        }
+    }
+    arena.pDict = pDict;
+
+    if ( !pszPrinter || !strpbrk( pszPrinter, "*?")) {
+        if (( rc = LoadPrinter( pszPakFile, pszPrinter, &dev, &pSegment )) != NO_ERROR )
+            return rc;
+        cFound = ShowPaper( &dev, pSegment, &arena, cx, cy, lTolerance, flOptions );
+        PakFree( NULL, pSegment );
+    }
+    else {
+        if (( rc = LoadPakImage( pszPakFile, &pbFile, &cbFile, &pEntries, &pulHashes, &cEntries )) != NO_ERROR )
+            return rc;
+        for ( i = 0; i < cEntries; i++ ) {
+            if ( !PakNameGlob( pszPrinter, pEntries[ i ].szDeviceName )) continue;
+            if (( pEntries[ i ].ulOffset > cbFile ) || ( pEntries[ i ].ulSize > cbFile - pEntries[ i ].ulOffset )) {
+                printf("%.40s: segment runs past the end of the file\n", pEntries[ i ].szDeviceName );
+                continue;
+            }
+            ArenaReset( &arena, 0 );
+            if ( ShowPaper( pEntries + i, pbFile + pEntries[ i ].ulOffset, &arena,
+                            cx, cy, lTolerance, flOptions ))
+                cFound++;
+        }
+        free( pEntries );
+        free( pulHashes );
+        free( pbFile );
+    }
+    ArenaFree( &arena );
+    return cFound ? NO_ERROR : ERROR_PAK_NO_PAPER;
+}
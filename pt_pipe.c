@@ -0,0 +1,488 @@
+/*
+ * pt_pipe.c
+ *
+ * PAKTOOL output pipeline for actions which format many printers.  Three
+ * stages run at once:
+ *
+ *   - a reader thread reads segments from the PAK file, taking whichever of
+ *     the entries admitted to the window comes first in the file;
+ *   - formatting threads take the read entries, lowest entry first, and
+ *     format each into its own output buffer;
+ *   - the calling thread writes the buffers out strictly in directory order,
+ *     and is itself the first formatting thread: it formats entries whenever
+ *     the next one to be written is not yet ready.
+ *
+ * The window of PIPE_WINDOW entries between the reader and the writer is the
+ * reorder buffer: an entry is admitted only when the writer has finished with
+ * the entry PIPE_WINDOW places before it, so memory use is bounded by that
+ * many segments and output buffers however large the file is, and a slow
+ * writer holds back the reader.  The output is the same, byte for byte,
+ * whatever the number of threads or the order in which they finish.
+ */
+
+#define INCL_DOSFILEMGR
+#define INCL_DOSERRORS
+#define INCL_DOSPROCESS
+#define INCL_DOSMISC
+#define INCL_DOSSEMAPHORES
+#include <os2.h>
+#include <process.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+#include "pakv2.h"
+#include "paktool.h"
+
+#define PIPE_MAX_THREADS    16      // maximum number of formatting threads
+#define PIPE_STACK_SIZE     32768   // stack size for each thread
+
+// States of a window slot
+#define SLOT_EMPTY          0       // free for the next entry
+#define SLOT_WAITING        1       // entry admitted, to be read
+#define SLOT_READ           2       // segment read, to be formatted
+#define SLOT_BUSY           3       // being formatted
+#define SLOT_DONE           4       // formatted, to be written
+
+
+// One entry in the window
+typedef struct _PIPESLOT
+{
+    ULONG  iEntry;                  // directory index of the entry
+    USHORT usState;                 // SLOT_* value
+    PBYTE  pbSegment;               // segment, or NULL if it could not be read
+    ULONG  ulResult;                // value returned by the format function
+    OUTBUF out;                     // formatted output (kept for reuse)
+} PIPESLOT, *PPIPESLOT;
+
+// State shared by the stages
+typedef struct _PIPELINE
+{
+    PPAK_DEV_DIRENTRY pEntries;     // entries to format, in directory order
+    ULONG             cEntries;
+    HFILE             hf;           // the PAK file
+    ULONG             cbFile;       // its size
+    PPAKDICT          pDict;        // keyword dictionary (NULL for built-in)
+    PPIPEFORMAT       pfnFormat;    // format function
+    PVOID             pUser;        // its context
+    PIPESLOT          aSlots[ PIPE_WINDOW ];  // entry n is in slot n % PIPE_WINDOW
+    ULONG             iAdmit;       // next entry to be admitted to the window
+    ULONG             iWrite;       // next entry to be written
+    ULONG             cTaken;       // entries taken for formatting
+    HMTX              hmtx;         // protects everything from aSlots on
+    HEV               hevFree;      // posted when a slot is emptied (reader)
+    HEV               hevWork;      // posted when there is work (formatters)
+    HEV               hevDone;      // posted when a slot is read or done (writer)
+} PIPELINE, *PPIPELINE;
+
+
+/* ------------------------------------------------------------------------- *
+ * ReadThread                                                                *
+ *                                                                           *
+ * The first stage: read the segments of the entries in the window, earliest *
+ * in the file first, until all have been read.                              *
+ * ------------------------------------------------------------------------- */
+static void _Optlink ReadThread( PVOID pArg )
+{
+    PPIPELINE         pPipe = (PPIPELINE) pArg;
+    PPIPESLOT         pSlot;
+    PPAK_DEV_DIRENTRY pEntry;
+    PBYTE             pb;
+    ULONG             cRead = 0,
+                      ulResult,
+                      i;
+
+    while ( cRead < pPipe->cEntries ) {
+        DosRequestMutexSem( pPipe->hmtx, SEM_INDEFINITE_WAIT );
+        while (( pPipe->iAdmit < pPipe->cEntries ) && ( pPipe->iAdmit < pPipe->iWrite + PIPE_WINDOW )) {
+            pSlot = pPipe->aSlots + pPipe->iAdmit % PIPE_WINDOW;
+            pSlot->iEntry  = pPipe->iAdmit++;
+            pSlot->usState = SLOT_WAITING;
+        }
+        for ( i = 0, pSlot = NULL; i < PIPE_WINDOW; i++ ) {
+            if (( pPipe->aSlots[ i ].usState == SLOT_WAITING ) &&
+                ( !pSlot || pPipe->pEntries[ pPipe->aSlots[ i ].iEntry ].ulOffset <
+                            pPipe->pEntries[ pSlot->iEntry ].ulOffset ))
+                pSlot = pPipe->aSlots + i;
+        }
+        if ( !pSlot ) {
+            DosResetEventSem( pPipe->hevFree, &ulResult );
+            DosReleaseMutexSem( pPipe->hmtx );
+            DosWaitEventSem( pPipe->hevFree, SEM_INDEFINITE_WAIT );
+            continue;
+        }
+        pEntry = pPipe->pEntries + pSlot->iEntry;
+        DosReleaseMutexSem( pPipe->hmtx );
+
+        // Only this thread uses the file, and no other stage touches a waiting slot
+        pb = NULL;
+        if (( pEntry->ulOffset <= pPipe->cbFile ) && ( pEntry->ulSize <= pPipe->cbFile - pEntry->ulOffset ) &&
+            (( pb = (PBYTE) malloc( pEntry->ulSize + 1 )) != NULL ))
+        {
+            if ( DosSetFilePtr( pPipe->hf, pEntry->ulOffset, FILE_BEGIN, &ulResult ) ||
+                 DosRead( pPipe->hf, pb, pEntry->ulSize, &ulResult ) || ( ulResult < pEntry->ulSize ))
+            {
+                free( pb );
+                pb = NULL;
+            }
+        }
+
+        DosRequestMutexSem( pPipe->hmtx, SEM_INDEFINITE_WAIT );
+        pSlot->pbSegment = pb;
+        pSlot->usState   = SLOT_READ;
+        DosPostEventSem( pPipe->hevWork );
+        DosPostEventSem( pPipe->hevDone );
+        DosReleaseMutexSem( pPipe->hmtx );
+        cRead++;
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * TakeWork                                                                  *
+ *                                                                           *
+ * Take the lowest read entry for formatting.  Call with the mutex held.     *
+ * Returns NULL if there is none.                                            *
+ * ------------------------------------------------------------------------- */
+static PPIPESLOT TakeWork( PPIPELINE pPipe )
+{
+    PPIPESLOT pSlot;
+    ULONG     i;
+
+    for ( i = 0, pSlot = NULL; i < PIPE_WINDOW; i++ ) {
+        if (( pPipe->aSlots[ i ].usState == SLOT_READ ) &&
+            ( !pSlot || pPipe->aSlots[ i ].iEntry < pSlot->iEntry ))
+            pSlot = pPipe->aSlots + i;
+    }
+    if ( pSlot ) {
+        pSlot->usState = SLOT_BUSY;
+        // Once every entry has been taken, let the idle formatters finish
+        if ( ++pPipe->cTaken == pPipe->cEntries ) DosPostEventSem( pPipe->hevWork );
+    }
+    return pSlot;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * FormatSlot                                                                *
+ *                                                                           *
+ * The second stage, for one entry taken by TakeWork().                      *
+ * ------------------------------------------------------------------------- */
+static void FormatSlot( PPIPELINE pPipe, PPIPESLOT pSlot, PPAKARENA pArena )
+{
+    pSlot->out.cbData = 0;
+    pSlot->out.fError = FALSE;
+    ArenaReset( pArena, 0 );
+    pSlot->ulResult = pPipe->pfnFormat( pPipe->pUser, pPipe->pEntries + pSlot->iEntry,
+                                        pSlot->pbSegment, pArena, &(pSlot->out) );
+
+    DosRequestMutexSem( pPipe->hmtx, SEM_INDEFINITE_WAIT );
+    free( pSlot->pbSegment );
+    pSlot->pbSegment = NULL;
+    pSlot->usState   = SLOT_DONE;
+    DosPostEventSem( pPipe->hevDone );
+    DosReleaseMutexSem( pPipe->hmtx );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * FormatThread                                                              *
+ *                                                                           *
+ * The second stage: format read entries until all have been taken.          *
+ * ------------------------------------------------------------------------- */
+static void _Optlink FormatThread( PVOID pArg )
+{
+    PPIPELINE pPipe = (PPIPELINE) pArg;
+    PPIPESLOT pSlot;
+    PAKARENA  arena = {0};
+    ULONG     ulCount;
+
+    arena.pDict = pPipe->pDict;
+    for ( ;; ) {
+        DosRequestMutexSem( pPipe->hmtx, SEM_INDEFINITE_WAIT );
+        if ( pPipe->cTaken >= pPipe->cEntries ) {
+            DosReleaseMutexSem( pPipe->hmtx );
+            break;
+        }
+        if (( pSlot = TakeWork( pPipe )) == NULL ) {
+            DosResetEventSem( pPipe->hevWork, &ulCount );
+            DosReleaseMutexSem( pPipe->hmtx );
+            DosWaitEventSem( pPipe->hevWork, SEM_INDEFINITE_WAIT );
+            continue;
+        }
+        DosReleaseMutexSem( pPipe->hmtx );
+        FormatSlot( pPipe, pSlot, &arena );
+    }
+    ArenaFree( &arena );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * LoadPipeDirectory                                                         *
+ *                                                                           *
+ * Read the directory of a device PAK file (V1 or V2) for RunPipeline() or   *
+ * RunPipelineEntries(), reporting any error.                                *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ     pszPakFile: Name of the PAK file                                *
+ *   PBYTE  *ppDir     : Receives the directory memory, in the V1 form       *
+ *                       returned by PakLoadDirectory(); free it with        *
+ *                       PakFree()                                           *
+ *   PULONG *ppulHashes: Receives the content hash of each entry of a V2     *
+ *                       file, or NULL for a V1 file; free it with free()    *
+ *                       (may be NULL if the hashes are not wanted)          *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success; ERROR_INVALID_DATA if the file is not a device PAK;       *
+ *   otherwise an OS/2 error code                                            *
+ * ------------------------------------------------------------------------- */
+ULONG LoadPipeDirectory( PSZ pszPakFile, PBYTE *ppDir, PULONG *ppulHashes )
+{
+    PAK2VIEW view;
+    ULONG    i;
+    APIRET   rc;
+
+    *ppDir = NULL;
+    if ( ppulHashes ) *ppulHashes = NULL;
+    if ( ppulHashes && ( Pak2Open( NULL, pszPakFile, &view ) == NO_ERROR )) {
+        rc = Pak2BuildV1Directory( NULL, &view, ppDir );
+        if ( !rc && (( *ppulHashes = (PULONG) malloc( view.pHdr->cEntries * sizeof( ULONG ) + 1 )) == NULL ))
+            rc = ERROR_NOT_ENOUGH_MEMORY;
+        for ( i = 0; !rc && i < view.pHdr->cEntries; i++ )
+            (*ppulHashes)[ i ] = view.pIndex[ i ].ulContentHash;
+        Pak2Close( NULL, &view );
+    }
+    else
+        rc = PakLoadDirectory( NULL, pszPakFile, PAKSIGNATURE_DEVPACK_V1,
+                               sizeof( PAK_DEV_DIRENTRY ), ppDir );
+
+    if ( rc == ERROR_INVALID_DATA )
+        printf("Invalid PAK file signature!\n");
+    else if ( rc == ERROR_NOT_ENOUGH_MEMORY )
+        printf("malloc() failed - out of memory?\n");
+    else if ( rc )
+        ReportOpenError( rc );
+    if ( rc ) {
+        PakFree( NULL, *ppDir );
+        *ppDir = NULL;
+        if ( ppulHashes ) {
+            free( *ppulHashes );
+            *ppulHashes = NULL;
+        }
+    }
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * RunPipelineEntries                                                        *
+ *                                                                           *
+ * Format the given entries of a device PAK file, writing the output to      *
+ * STDOUT in their order.  The format function is called from several        *
+ * threads at once, each with its own arena (reset for each entry), and must *
+ * write only to the output buffer it is given; its return values are added  *
+ * up.  It is passed a pointer into pEntries, so it can tell which entry it  *
+ * has been given, and a NULL segment for an entry whose segment lies        *
+ * outside the file or could not be read.                                    *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ               pszPakFile: Name of the PAK file (V1 or V2)           *
+ *   PPAK_DEV_DIRENTRY pEntries  : Entries to format, with the offsets of    *
+ *                                 their segments in the file                *
+ *   ULONG             cEntries  : Number of entries                         *
+ *   PPAKDICT          pDict     : Keyword dictionary (NULL for built-in)    *
+ *   PPIPEFORMAT       pfnFormat : Format function                           *
+ *   PVOID             pUser     : Context passed to the format function     *
+ *   PULONG            pulTotal  : Receives the sum of its return values (or *
+ *                                 NULL)                                     *
+ *   PULONG            pcThreads : Receives the number of threads which      *
+ *                                 formatted entries, counting the caller    *
+ *                                 (or NULL)                                 *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, otherwise an OS/2 error code (after reporting the error)  *
+ * ------------------------------------------------------------------------- */
+ULONG RunPipelineEntries( PSZ pszPakFile, PPAK_DEV_DIRENTRY pEntries, ULONG cEntries,
+                          PPAKDICT pDict, PPIPEFORMAT pfnFormat, PVOID pUser,
+                          PULONG pulTotal, PULONG pcThreads )
+{
+    PPIPELINE    pPipe = NULL;
+    PPIPESLOT    pSlot;
+    PAKARENA     arena = {0};
+    ULONG        ulAction,
+                 ulCount,
+                 ulTotal = 0,
+                 cThreads = 0,
+                 i;
+    TID          tidRead,
+                 atid[ PIPE_MAX_THREADS ];
+    APIRET       rc;
+
+    if (( pPipe = (PPIPELINE) calloc( 1, sizeof( PIPELINE ))) == NULL ) {
+        printf("malloc() failed - out of memory?\n");
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+    pPipe->pEntries  = pEntries;
+    pPipe->cEntries  = cEntries;
+    pPipe->pDict     = pDict;
+    pPipe->pfnFormat = pfnFormat;
+    pPipe->pUser     = pUser;
+
+    rc = DosOpen( pszPakFile, &(pPipe->hf), &ulAction, 0, 0,
+                  OPEN_ACTION_FAIL_IF_NEW | OPEN_ACTION_OPEN_IF_EXISTS,
+                  OPEN_FLAGS_FAIL_ON_ERROR | OPEN_FLAGS_SEQUENTIAL |
+                  OPEN_SHARE_DENYWRITE | OPEN_ACCESS_READONLY, NULL );
+    if ( !rc ) rc = DosSetFilePtr( pPipe->hf, 0, FILE_END, &(pPipe->cbFile) );
+    if ( rc ) {
+        ReportOpenError( rc );
+        goto cleanup;
+    }
+    if (( rc = DosCreateMutexSem( NULL, &(pPipe->hmtx), 0, FALSE )) != NO_ERROR ||
+        ( rc = DosCreateEventSem( NULL, &(pPipe->hevFree), 0, FALSE )) != NO_ERROR ||
+        ( rc = DosCreateEventSem( NULL, &(pPipe->hevWork), 0, FALSE )) != NO_ERROR ||
+        ( rc = DosCreateEventSem( NULL, &(pPipe->hevDone), 0, FALSE )) != NO_ERROR )
+        goto cleanup;
+
+    // The reader, then one formatter per processor, the writer being the first
+    if (( tidRead = _beginthread( ReadThread, NULL, PIPE_STACK_SIZE, pPipe )) == -1 ) {
+        printf("Failed to start reading thread.\n");
+        rc = ERROR_NOT_ENOUGH_MEMORY;
+        goto cleanup;
+    }
+    if ( DosQuerySysInfo( QSV_NUMPROCESSORS, QSV_NUMPROCESSORS, &cThreads, sizeof( cThreads )) ||
+         !cThreads )
+        cThreads = 1;
+    if ( cThreads > PIPE_MAX_THREADS ) cThreads = PIPE_MAX_THREADS;
+    if ( cThreads > pPipe->cEntries ) cThreads = pPipe->cEntries;
+    for ( i = 1; i < cThreads; i++ ) {
+        if (( atid[ i ] = _beginthread( FormatThread, NULL, PIPE_STACK_SIZE, pPipe )) == -1 )
+            break;
+    }
+    cThreads = i ? i : 1;
+
+    // The writer: each entry in turn, as soon as it is done
+    arena.pDict = pDict;
+    for ( ;; ) {
+        DosRequestMutexSem( pPipe->hmtx, SEM_INDEFINITE_WAIT );
+        if ( pPipe->iWrite >= pPipe->cEntries ) {
+            DosReleaseMutexSem( pPipe->hmtx );
+            break;
+        }
+        pSlot = pPipe->aSlots + pPipe->iWrite % PIPE_WINDOW;
+        if ( pSlot->usState == SLOT_DONE ) {
+            DosReleaseMutexSem( pPipe->hmtx );
+            if ( pSlot->out.fError )
+                printf("%.40s: (out of memory; output incomplete)\n",
+                       pPipe->pEntries[ pSlot->iEntry ].szDeviceName );
+            else if ( pSlot->out.cbData )
+                fwrite( pSlot->out.pbData, 1, pSlot->out.cbData, stdout );
+            ulTotal += pSlot->ulResult;
+
+            DosRequestMutexSem( pPipe->hmtx, SEM_INDEFINITE_WAIT );
+            pSlot->usState = SLOT_EMPTY;
+            pPipe->iWrite++;
+            DosPostEventSem( pPipe->hevFree );
+            DosReleaseMutexSem( pPipe->hmtx );
+        }
+        else if (( pSlot = TakeWork( pPipe )) != NULL ) {
+            DosReleaseMutexSem( pPipe->hmtx );
+            FormatSlot( pPipe, pSlot, &arena );
+        }
+        else {
+            DosResetEventSem( pPipe->hevDone, &ulCount );
+            DosReleaseMutexSem( pPipe->hmtx );
+            DosWaitEventSem( pPipe->hevDone, SEM_INDEFINITE_WAIT );
+        }
+    }
+    DosWaitThread( &tidRead, DCWW_WAIT );
+    for ( i = 1; i < cThreads; i++ )
+        DosWaitThread( &atid[ i ], DCWW_WAIT );
+    fflush( stdout );
+
+    if ( pulTotal )  *pulTotal  = ulTotal;
+    if ( pcThreads ) *pcThreads = cThreads;
+
+cleanup:
+    if ( pPipe ) {
+        if ( pPipe->hevDone ) DosCloseEventSem( pPipe->hevDone );
+        if ( pPipe->hevWork ) DosCloseEventSem( pPipe->hevWork );
+        if ( pPipe->hevFree ) DosCloseEventSem( pPipe->hevFree );
+        if ( pPipe->hmtx )    DosCloseMutexSem( pPipe->hmtx );
+        if ( pPipe->hf )      DosClose( pPipe->hf );
+        for ( i = 0; i < PIPE_WINDOW; i++ )
+            OutFree( &(pPipe->aSlots[ i ].out) );
+        free( pPipe );
+    }
+    ArenaFree( &arena );
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * RunPipeline                                                               *
+ *                                                                           *
+ * Format every printer in a device PAK file (or one of them), writing the   *
+ * output to STDOUT in directory order (see RunPipelineEntries).             *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ         pszPakFile: Name of the PAK file (V1 or V2)                 *
+ *   PSZ         pszPrinter: Printer to format, a pattern selecting printers *
+ *                           (see PakNameGlob), or NULL for all printers     *
+ *   PPAKDICT    pDict     : Keyword dictionary (NULL for built-in)          *
+ *   PPIPEFORMAT pfnFormat : Format function                                 *
+ *   PVOID       pUser     : Context passed to the format function           *
+ *   PULONG      pulTotal  : Receives the sum of its return values (or NULL) *
+ *   PULONG      pcEntries : Receives the number of entries formatted (or    *
+ *                           NULL)                                           *
+ *   PULONG      pcThreads : Receives the number of threads which formatted  *
+ *                           entries, counting the caller (or NULL)          *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success; ERROR_PAK_NO_DEVICE if no printer was found;              *
+ *   ERROR_INVALID_DATA if the file is not a device PAK; otherwise an OS/2   *
+ *   error code (in each case after reporting the error)                     *
+ * ------------------------------------------------------------------------- */
+ULONG RunPipeline( PSZ pszPakFile, PSZ pszPrinter, PPAKDICT pDict, PPIPEFORMAT pfnFormat,
+                   PVOID pUser, PULONG pulTotal, PULONG pcEntries, PULONG pcThreads )
+{
+    PPAK_DEV_DIRENTRY pEntries;
+    PBYTE             pDir;
+    ULONG             cEntries,
+                      ulCount,
+                      i;
+    APIRET            rc;
+
+    if (( rc = LoadPipeDirectory( pszPakFile, &pDir, NULL )) != NO_ERROR )
+        return rc;
+    pEntries = (PPAK_DEV_DIRENTRY)( pDir + sizeof( PAKSIGNATURE ));
+    cEntries = ((PPAKSIGNATURE) pDir )->iEntries;
+    if ( pszPrinter && strpbrk( pszPrinter, "*?")) {
+        // The matching entries are moved up in place, keeping their order
+        for ( i = 0, ulCount = 0; i < cEntries; i++ )
+            if ( PakNameGlob( pszPrinter, pEntries[ i ].szDeviceName ))
+                pEntries[ ulCount++ ] = pEntries[ i ];
+        cEntries = ulCount;
+    }
+    else if ( pszPrinter ) {
+        for ( i = 0; i < cEntries; i++ )
+            if ( !strnicmp( pEntries[ i ].szDeviceName, pszPrinter,
+                            sizeof( pEntries[ i ].szDeviceName ))) break;
+        pEntries += i;
+        cEntries  = ( i < cEntries ) ? 1 : 0;
+    }
+    if ( pszPrinter && !cEntries ) {
+        printf("The requested printer was not found\n");
+        rc = ERROR_PAK_NO_DEVICE;
+    }
+    else {
+        rc = RunPipelineEntries( pszPakFile, pEntries, cEntries, pDict, pfnFormat, pUser,
+                                 pulTotal, pcThreads );
+        if ( pcEntries ) *pcEntries = cEntries;
+    }
+
+    PakFree( NULL, pDir );
+    return rc;
+}
@@ -0,0 +1,117 @@
+/*
+ * pt_sel.c
+ *
+ * PAKTOOL select action.  Lists the printers, in one or more PAK files, whose
+ * scalar fields satisfy a filter expression (see pakcol.c).
+ */
+
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+#include "paktool.h"
+
+
+/* ------------------------------------------------------------------------- *
+ * SelectFrom                                                                *
+ *                                                                           *
+ * Select the matching printers from one PAK file.                           *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, otherwise an error code                                   *
+ * ------------------------------------------------------------------------- */
+static ULONG SelectFrom( PSZ pszPakFile, PPAKCOLEXPR pExpr, BOOL fShowFile, PULONG pcMatch )
+{
+    PPAK_DEV_DIRENTRY pEntries;
+    PPAKCOLS          pCols = NULL;
+    PBYTE             pbFile;
+    PULONG            pulHashes,
+                      pulMatch = NULL;
+    ULONG             cbFile,
+                      cEntries,
+                      cMatch,
+                      i;
+    APIRET            rc;
+
+    if (( rc = LoadPakImage( pszPakFile, &pbFile, &cbFile, &pEntries, &pulHashes, &cEntries )) != NO_ERROR )
+        return rc;
+    if (( rc = PakColsBuild( NULL, pbFile, cbFile, pEntries, cEntries, &pCols )) == NO_ERROR &&
+        ( pulMatch = (PULONG) malloc((( cEntries + 31 ) / 32 + 1 ) * sizeof( ULONG ))) == NULL )
+        rc = ERROR_NOT_ENOUGH_MEMORY;
+    if ( !rc ) rc = PakColsSelect( NULL, pCols, pExpr, pulMatch, &cMatch );
+    if ( rc ) {
+        printf("malloc() failed - out of memory?\n");
+        goto done;
+    }
+
+    for ( i = 0; i < cEntries; i++ ) {
+        if ( !( pulMatch[ i / 32 ] & ( 1UL << ( i % 32 )))) continue;
+        if ( fShowFile ) printf("%s: ", pszPakFile );
+        printf("%.40s\n", pEntries[ i ].szDeviceName );
+    }
+    *pcMatch += cMatch;
+
+done:
+    free( pulMatch );
+    PakColsFree( NULL, pCols );
+    free( pEntries );
+    free( pulHashes );
+    free( pbFile );
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * SelectPrinters                                                            *
+ *                                                                           *
+ * Implements the SELECT action.                                             *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ    pszExpr      : Filter expression (or NULL to list the fields)    *
+ *   PSZ   *ppszPakFiles : PAK files to search                               *
+ *   ULONG  cPakFiles    : Number of PAK files                               *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 if any printers match, ERROR_PAK_NO_DEVICE if none do, otherwise an   *
+ *   error code                                                              *
+ * ------------------------------------------------------------------------- */
+ULONG SelectPrinters( PSZ pszExpr, PSZ *ppszPakFiles, ULONG cPakFiles )
+{
+    PPAKCOLEXPR pExpr;
+    PSZ         pszName,
+                pszDesc;
+    ULONG       ulErrPos,
+                cMatch = 0,
+                i;
+    APIRET      rc = NO_ERROR;
+
+    if ( !pszExpr ) {
+        printf("Fields which may be used in SELECT expressions:\n");
+        for ( i = 0; ( pszName = PakColsField( i, &pszDesc )) != NULL; i++ )
+            printf("  %-12s %s\n", pszName, pszDesc );
+        return NO_ERROR;
+    }
+
+    switch ( PakColsCompile( NULL, pszExpr, &pExpr, &ulErrPos )) {
+        case NO_ERROR:
+            break;
+        case ERROR_INVALID_PARAMETER:
+            printf("Invalid expression:\n  %s\n  %*s^\n", pszExpr, (int) ulErrPos, "");
+            return ERROR_INVALID_PARAMETER;
+        default:
+            printf("malloc() failed - out of memory?\n");
+            return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    for ( i = 0; i < cPakFiles && !rc; i++ )
+        rc = SelectFrom( ppszPakFiles[ i ], pExpr, ( cPakFiles > 1 ), &cMatch );
+
+    PakFree( NULL, pExpr );
+    if ( !rc && !cMatch ) rc = ERROR_PAK_NO_DEVICE;
+    return rc;
+}
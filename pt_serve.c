@@ -0,0 +1,823 @@
+/*
+ * pt_serve.c
+ *
+ * PAKTOOL query server.  In this mode PAKTOOL keeps one or more PAK files
+ * loaded in memory and answers requests from other processes (typically a
+ * print server) over a local named pipe, so that the PAK does not have to be
+ * re-opened and re-parsed for every job.
+ *
+ * Each request is a single line of the form
+ *
+ *    <verb> <pakfile> ["<printer>"] [<arguments>]
+ *
+ * where arguments containing spaces are enclosed in double quotes, and
+ * <pakfile> is the name of one of the served PAK files (with or without its
+ * path).  The supported verbs are:
+ *
+ *    LIST  <pakfile>                          Names of all printers
+ *    PPD   <pakfile> "<printer>"              PPD listing for <printer>
+ *    READ  <pakfile> "<printer>"              Readable data for <printer>
+ *    FIELD <pakfile> "<printer>" <keyword>    Value of a single PPD keyword
+ *    VALUE <pakfile> "<printer>" <keyword> <option>
+ *                                             Invocation string of an option
+ *    JOB   <pakfile> "<printer>" [<keyword>=<option> ...]
+ *                                             Setup code for the default (or
+ *                                             given) options
+ *
+ * The reply starts with a status line, either "+OK <bytes>" followed by
+ * that many bytes of data, or "-ERR <code> <message>".  The server then
+ * closes the connection.
+ *
+ * Requests are served concurrently by a fixed number of pipe instances, each
+ * with its own thread.  Every PAK file is checked for modification on each
+ * request and reloaded if it has changed; requests already in progress keep
+ * using the previous copy until they finish.  PPD renderings and job ticket
+ * templates are cached per printer for the lifetime of the loaded copy, so
+ * that a JOB request for a printer already used costs little more than
+ * copying its strings.
+ */
+
+#define INCL_DOSFILEMGR
+#define INCL_DOSERRORS
+#define INCL_DOSNMPIPES
+#define INCL_DOSSEMAPHORES
+#define INCL_DOSPROCESS
+#include <os2.h>
+#include <process.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+#include "paktool.h"
+
+#define SERVE_INSTANCES     4       // number of pipe instances (and threads)
+#define SERVE_STACK_SIZE    65536   // stack size for each server thread
+#define SERVE_PIPE_BUFFER   4096    // pipe buffer size in each direction
+#define SERVE_MAX_REQUEST   512     // maximum length of a request line
+#define SERVE_MAX_ARGS      32      // maximum number of words in a request
+#define SERVE_WAIT_TIMEOUT  5000    // client wait for a free instance (ms)
+
+
+// One loaded copy of a PAK file
+typedef struct _PAKIMAGE
+{
+    ULONG             cRefs;        // references held (slot + requests)
+    PBYTE             pbFile;       // complete file contents
+    ULONG             cbFile;       // size of file contents
+    PPAKSIGNATURE     pSig;         // file header (points into pbFile)
+    PPAK_DEV_DIRENTRY pDir;         // directory (points into pbFile)
+    POUTBUF           aPPD;         // cached PPD renderings, one per entry
+    PPAKJOB          *apJob;        // cached job ticket templates, one per entry
+    PPAKNAMES         pNames;       // name index of the directory
+    PBYTE             afDamaged;    // TRUE for each entry failing PakCheckDevice()
+} PAKIMAGE, *PPAKIMAGE;
+
+// A PAK file being served
+typedef struct _PAKSLOT
+{
+    PSZ         pszFile;            // file name as given on the command line
+    FILESTATUS3 fs3;                // file status when last loaded
+    PPAKIMAGE   pImage;             // current loaded copy
+} PAKSLOT, *PPAKSLOT;
+
+
+static PAKSLOT aSlots[ SERVE_MAX_PAKS ];
+static ULONG   cSlots;
+static HMTX    hmtxServe;           // protects slots, image references & caches
+static PPAKDICT pServeDict;         // keyword dictionary (NULL for built-in)
+
+
+/* ------------------------------------------------------------------------- *
+ * LoadImage                                                                 *
+ *                                                                           *
+ * Read an entire device PAK file into memory, verify that its directory is  *
+ * consistent with the file size, and check every segment with               *
+ * PakCheckDevice() so that damaged entries are never rendered.              *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ        pszFile : Name of the PAK file                               *
+ *   PPAKIMAGE *ppImage : Receives the new image (reference count 1)         *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, otherwise an OS/2 error code                              *
+ * ------------------------------------------------------------------------- */
+static ULONG LoadImage( PSZ pszFile, PPAKIMAGE *ppImage )
+{
+    HFILE       hf;
+    ULONG       ulResult;
+    FILESTATUS3 fs3;
+    PPAKIMAGE   pImage = NULL;
+    PAKARENA    arena = {0};
+    OUTBUF      report = {0};
+    SHORT       i;
+    APIRET      rc;
+
+    rc = DosOpen( pszFile, &hf, &ulResult, 0, 0,
+                  OPEN_ACTION_FAIL_IF_NEW | OPEN_ACTION_OPEN_IF_EXISTS,
+                  OPEN_FLAGS_FAIL_ON_ERROR | OPEN_FLAGS_SEQUENTIAL |
+                  OPEN_SHARE_DENYWRITE | OPEN_ACCESS_READONLY, NULL );
+    if ( rc ) return rc;
+
+    if (( pImage = (PPAKIMAGE) calloc( 1, sizeof( PAKIMAGE ))) == NULL ) {
+        rc = ERROR_NOT_ENOUGH_MEMORY;
+        goto cleanup;
+    }
+    rc = DosQueryFileInfo( hf, FIL_STANDARD, &fs3, sizeof( fs3 ));
+    if ( rc ) goto cleanup;
+    if ( fs3.cbFile < sizeof( PAKSIGNATURE )) {
+        rc = ERROR_INVALID_DATA;
+        goto cleanup;
+    }
+    pImage->cbFile = fs3.cbFile;
+    if (( pImage->pbFile = (PBYTE) malloc( pImage->cbFile )) == NULL ) {
+        rc = ERROR_NOT_ENOUGH_MEMORY;
+        goto cleanup;
+    }
+    rc = DosRead( hf, pImage->pbFile, pImage->cbFile, &ulResult );
+    if ( !rc && ulResult < pImage->cbFile ) rc = ERROR_HANDLE_EOF;
+    if ( rc ) goto cleanup;
+
+    pImage->pSig = (PPAKSIGNATURE) pImage->pbFile;
+    pImage->pDir = (PPAK_DEV_DIRENTRY)( pImage->pbFile + sizeof( PAKSIGNATURE ));
+    if (( strncmp( pImage->pSig->szName, PAKSIGNATURE_DEVPACK_V1,
+                   sizeof( pImage->pSig->szName )) != 0 ) ||
+        ( pImage->pSig->iEntries < 0 ) ||
+        ( sizeof( PAKSIGNATURE ) + pImage->pSig->iEntries * sizeof( PAK_DEV_DIRENTRY ) > pImage->cbFile ))
+    {
+        rc = ERROR_INVALID_DATA;
+        goto cleanup;
+    }
+    for ( i = 0; i < pImage->pSig->iEntries; i++ ) {
+        if (( pImage->pDir[ i ].ulSize < sizeof( DESPPD )) ||
+            ( pImage->pDir[ i ].ulOffset > pImage->cbFile ) ||
+            ( pImage->pDir[ i ].ulSize > pImage->cbFile - pImage->pDir[ i ].ulOffset ))
+        {
+            rc = ERROR_INVALID_DATA;
+            goto cleanup;
+        }
+    }
+
+    pImage->aPPD  = (POUTBUF) calloc( pImage->pSig->iEntries + 1, sizeof( OUTBUF ));
+    pImage->apJob = (PPAKJOB *) calloc( pImage->pSig->iEntries + 1, sizeof( PPAKJOB ));
+    pImage->afDamaged = (PBYTE) calloc( pImage->pSig->iEntries + 1, 1 );
+    if ( !pImage->aPPD || !pImage->apJob || !pImage->afDamaged ) {
+        rc = ERROR_NOT_ENOUGH_MEMORY;
+        goto cleanup;
+    }
+
+    // The problem reports themselves are not needed
+    arena.pDict = pServeDict;
+    for ( i = 0; i < pImage->pSig->iEntries; i++ ) {
+        report.cbData = 0;
+        ArenaReset( &arena, 0 );
+        if ( PakCheckDevice( pImage->pDir + i, pImage->pbFile + pImage->pDir[ i ].ulOffset,
+                             &arena, &report ))
+            pImage->afDamaged[ i ] = TRUE;
+    }
+    if ( report.fError ) {
+        rc = ERROR_NOT_ENOUGH_MEMORY;
+        goto cleanup;
+    }
+    if (( rc = PakNameIndex( NULL, pImage->pDir, pImage->pSig->iEntries, &pImage->pNames )) != NO_ERROR )
+        goto cleanup;
+    pImage->cRefs = 1;
+    *ppImage = pImage;
+
+cleanup:
+    DosClose( hf );
+    OutFree( &report );
+    ArenaFree( &arena );
+    if ( rc && pImage ) {
+        if ( pImage->aPPD ) free( pImage->aPPD );
+        if ( pImage->apJob ) free( pImage->apJob );
+        if ( pImage->afDamaged ) free( pImage->afDamaged );
+        if ( pImage->pbFile ) free( pImage->pbFile );
+        PakNameFree( NULL, pImage->pNames );
+        free( pImage );
+    }
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ReleaseImage                                                              *
+ *                                                                           *
+ * Drop a reference to a loaded PAK image, freeing it (along with all its    *
+ * cached renderings) once the last reference is gone.                       *
+ * ------------------------------------------------------------------------- */
+static void ReleaseImage( PPAKIMAGE pImage )
+{
+    ULONG cRefs;
+    SHORT i;
+
+    DosRequestMutexSem( hmtxServe, SEM_INDEFINITE_WAIT );
+    cRefs = --pImage->cRefs;
+    DosReleaseMutexSem( hmtxServe );
+    if ( cRefs ) return;
+
+    for ( i = 0; i < pImage->pSig->iEntries; i++ ) {
+        OutFree( pImage->aPPD + i );
+        PakJobFree( NULL, pImage->apJob[ i ] );
+    }
+    free( pImage->aPPD );
+    free( pImage->apJob );
+    free( pImage->afDamaged );
+    free( pImage->pbFile );
+    PakNameFree( NULL, pImage->pNames );
+    free( pImage );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * FileChanged                                                               *
+ *                                                                           *
+ * Tell whether a PAK file needs (re)loading: it has never been loaded, or   *
+ * its size or last-write time differs from the copy in memory.  The caller  *
+ * must hold hmtxServe.                                                      *
+ * ------------------------------------------------------------------------- */
+static BOOL FileChanged( PFILESTATUS3 pfs3, PPAKSLOT pSlot )
+{
+    return ( memcmp( &pfs3->fdateLastWrite, &pSlot->fs3.fdateLastWrite, sizeof( FDATE )) != 0 ) ||
+           ( memcmp( &pfs3->ftimeLastWrite, &pSlot->fs3.ftimeLastWrite, sizeof( FTIME )) != 0 ) ||
+           ( pfs3->cbFile != pSlot->fs3.cbFile ) || !pSlot->pImage;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * AcquireImage                                                              *
+ *                                                                           *
+ * Look up a served PAK file by name and return a reference to its current   *
+ * image, reloading the file first if it has been modified since it was      *
+ * last loaded.  If the reload fails, the previous image continues to be     *
+ * used.  The file is read and checked without holding the server lock,      *
+ * which is taken only to swap in the new image, so that a reload does not   *
+ * hold up requests on this or any other PAK file; if two threads reload the *
+ * same change at once, the second copy is discarded.  The caller must call  *
+ * ReleaseImage() when done.                                                 *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ        pszName: PAK file name, with or without its path             *
+ *   PPAKIMAGE *ppImage: Receives the image                                  *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, otherwise an OS/2 error code                              *
+ * ------------------------------------------------------------------------- */
+static ULONG AcquireImage( PSZ pszName, PPAKIMAGE *ppImage )
+{
+    PPAKSLOT    pSlot = NULL;
+    FILESTATUS3 fs3;
+    PPAKIMAGE   pNew = NULL,
+                pOld = NULL;
+    PSZ         psz;
+    BOOL        fReload;
+    ULONG       i;
+    APIRET      rc = 0;
+
+    for ( i = 0; !pSlot && i < cSlots; i++ ) {
+        psz = strrchr( aSlots[ i ].pszFile, '\\');
+        if ( !psz ) psz = strrchr( aSlots[ i ].pszFile, ':');
+        psz = psz ? psz + 1 : aSlots[ i ].pszFile;
+        if (( stricmp( aSlots[ i ].pszFile, pszName ) == 0 ) ||
+            ( stricmp( psz, pszName ) == 0 ))
+            pSlot = aSlots + i;
+    }
+    if ( !pSlot ) return ERROR_FILE_NOT_FOUND;
+
+    // A file changed since it was loaded (or never loaded) is read afresh
+    fReload = FALSE;
+    if ( DosQueryPathInfo( pSlot->pszFile, FIL_STANDARD, &fs3, sizeof( fs3 )) == NO_ERROR ) {
+        DosRequestMutexSem( hmtxServe, SEM_INDEFINITE_WAIT );
+        fReload = FileChanged( &fs3, pSlot );
+        DosReleaseMutexSem( hmtxServe );
+    }
+    if ( fReload ) rc = LoadImage( pSlot->pszFile, &pNew );
+
+    DosRequestMutexSem( hmtxServe, SEM_INDEFINITE_WAIT );
+    if ( pNew ) {
+        // Requests still using the old copy keep it alive until they finish
+        if ( FileChanged( &fs3, pSlot )) {
+            pOld = pSlot->pImage;
+            pSlot->pImage = pNew;
+            pSlot->fs3    = fs3;
+        }
+        else pOld = pNew;
+    }
+    else if ( rc && pSlot->pImage )
+        printf("Failed to reload %s (error %u); using previous copy.\n",
+               pSlot->pszFile, rc );
+    if ( pSlot->pImage ) {
+        pSlot->pImage->cRefs++;
+        *ppImage = pSlot->pImage;
+        rc = NO_ERROR;
+    }
+    else if ( !rc ) rc = ERROR_FILE_NOT_FOUND;
+    DosReleaseMutexSem( hmtxServe );
+
+    if ( pOld ) ReleaseImage( pOld );
+
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * FindEntry                                                                 *
+ *                                                                           *
+ * Return the directory index of the named printer in a PAK image, -1 if it  *
+ * is not found, or -2 if the name is not exact and selects more than one    *
+ * printer (see PakNameFind).  If no name is given, the first printer is     *
+ * used.                                                                     *
+ * ------------------------------------------------------------------------- */
+static SHORT FindEntry( PPAKIMAGE pImage, PSZ pszPrinter )
+{
+    ULONG ulEntry,
+          ulHow,
+          cFound;
+    SHORT i;
+
+    if ( !pszPrinter ) return pImage->pSig->iEntries ? 0 : -1;
+    for ( i = 0; i < pImage->pSig->iEntries; i++ ) {
+        if ( strnicmp( pImage->pDir[ i ].szDeviceName, pszPrinter,
+                       sizeof( pImage->pDir[ i ].szDeviceName )) == 0 )
+            return i;
+    }
+    ulHow = PakNameFind( pImage->pNames, pszPrinter, &ulEntry, 1, &cFound );
+    if ( ulHow == PAKNAME_NONE ) return -1;
+    return (( ulHow == PAKNAME_EXACT ) || ( cFound == 1 )) ? (SHORT) ulEntry : -2;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * GetCachedPPD                                                              *
+ *                                                                           *
+ * Return the PPD rendering for a printer, generating and caching it first   *
+ * if necessary.  The rendering is done without holding the server lock; if  *
+ * two threads race to render the same printer, the loser's copy is simply   *
+ * discarded.  The returned buffer remains valid for as long as the caller   *
+ * holds its reference to the image.                                         *
+ * ------------------------------------------------------------------------- */
+static ULONG GetCachedPPD( PPAKIMAGE pImage, SHORT sIdx, PPAKARENA pArena, POUTBUF *ppOut )
+{
+    OUTBUF out = {0};
+
+    DosRequestMutexSem( hmtxServe, SEM_INDEFINITE_WAIT );
+    *ppOut = pImage->aPPD + sIdx;
+    if ( (*ppOut)->pbData ) {
+        DosReleaseMutexSem( hmtxServe );
+        return NO_ERROR;
+    }
+    DosReleaseMutexSem( hmtxServe );
+
+    GeneratePPD( pImage->pbFile + pImage->pDir[ sIdx ].ulOffset, pArena, &out );
+    if ( out.fError || !out.pbData ) {
+        OutFree( &out );
+        return ERROR_NOT_ENOUGH_MEMORY;
+    }
+
+    DosRequestMutexSem( hmtxServe, SEM_INDEFINITE_WAIT );
+    if ( (*ppOut)->pbData )
+        OutFree( &out );
+    else
+        **ppOut = out;
+    DosReleaseMutexSem( hmtxServe );
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * GetCachedJob                                                              *
+ *                                                                           *
+ * Return the job ticket template for a printer, building and caching it     *
+ * first if necessary (in the same way as GetCachedPPD).                     *
+ * ------------------------------------------------------------------------- */
+static ULONG GetCachedJob( PPAKIMAGE pImage, SHORT sIdx, PPAKARENA pArena, PPAKJOB *ppJob )
+{
+    PPAKJOB pJob;
+    APIRET  rc;
+
+    DosRequestMutexSem( hmtxServe, SEM_INDEFINITE_WAIT );
+    *ppJob = pImage->apJob[ sIdx ];
+    DosReleaseMutexSem( hmtxServe );
+    if ( *ppJob ) return NO_ERROR;
+
+    rc = PakJobBuild( NULL, pArena, pImage->pbFile + pImage->pDir[ sIdx ].ulOffset,
+                      pImage->pDir[ sIdx ].ulSize, &pJob );
+    if ( rc ) return rc;
+
+    DosRequestMutexSem( hmtxServe, SEM_INDEFINITE_WAIT );
+    if ( pImage->apJob[ sIdx ] )
+        PakJobFree( NULL, pJob );
+    else
+        pImage->apJob[ sIdx ] = pJob;
+    *ppJob = pImage->apJob[ sIdx ];
+    DosReleaseMutexSem( hmtxServe );
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * RenderJobRequest                                                          *
+ *                                                                           *
+ * Write the setup code for the printer's defaults, changed by the options   *
+ * given as "Keyword=Option".                                                *
+ * ------------------------------------------------------------------------- */
+static ULONG RenderJobRequest( PPAKJOB pJob, PSZ *apszOptions, ULONG cOptions,
+                               PPAKARENA pArena, POUTBUF pOut, PSZ *ppszError )
+{
+    PUI_SEL pSel = NULL;
+    ULONG   cBlocks = pJob->pUic->cBlocks,
+            i;
+    APIRET  rc;
+
+    if ( cOptions ) {
+        pSel = (PUI_SEL) ArenaAlloc( pArena, ( 2 * cBlocks + 1 ) * sizeof( UI_SEL ));
+        if ( !pSel ) return ERROR_NOT_ENOUGH_MEMORY;
+        memcpy( pSel, pJob->pDefaults, cBlocks * sizeof( UI_SEL ));
+        memset( pSel + cBlocks, 0, ( cBlocks + 1 ) * sizeof( UI_SEL ));
+        for ( i = 0; i < cOptions; i++ ) {
+            if (( rc = PakUicSelect( pJob->pUic, apszOptions[ i ], pSel, pSel + cBlocks )) != NO_ERROR ) {
+                *ppszError = ( rc == ERROR_PAK_NO_KEYWORD ) ? "Keyword not found" :
+                             ( rc == ERROR_PAK_NO_OPTION )  ? "Option not found" :
+                                                              "Options must be <keyword>=<option>";
+                return ERROR_INVALID_PARAMETER;
+            }
+        }
+    }
+    PakJobRender( pJob, pSel, pOut );
+    return NO_ERROR;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * FindField                                                                 *
+ *                                                                           *
+ * Extract the value of a main keyword (e.g. "ModelName") from a PPD         *
+ * rendering.  Surrounding quotes are removed from the value.                *
+ * ------------------------------------------------------------------------- */
+static ULONG FindField( POUTBUF pPPD, PSZ pszKeyword, POUTBUF pOut )
+{
+    PSZ   psz, pszEnd;
+    ULONG cb;
+
+    if ( *pszKeyword == '*') pszKeyword++;
+    cb = strlen( pszKeyword );
+    for ( psz = pPPD->pbData; psz && *psz; psz = strchr( psz, '\n')) {
+        if ( *psz == '\n') psz++;
+        if (( *psz == '*') && ( strncmp( psz + 1, pszKeyword, cb ) == 0 ) &&
+            ( psz[ cb + 1 ] == ':'))
+        {
+            psz += cb + 2;
+            while ( *psz == ' ') psz++;
+            if ( *psz == '"') {
+                psz++;
+                pszEnd = strchr( psz, '"');
+            }
+            else pszEnd = strchr( psz, '\n');
+            if ( !pszEnd ) pszEnd = psz + strlen( psz );
+            OutWrite( pOut, psz, pszEnd - psz );
+            OutWrite( pOut, "\n", 1 );
+            return NO_ERROR;
+        }
+    }
+    return ERROR_INVALID_DATA;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * FindOptionValue                                                           *
+ *                                                                           *
+ * Write the (decompressed) invocation string of a UI option to the output.  *
+ * ------------------------------------------------------------------------- */
+static ULONG FindOptionValue( PBYTE pBuf, PSZ pszKeyword, PSZ pszOption, PPAKARENA pArena, POUTBUF pOut )
+{
+    DESPPD    desPPD;
+    PBYTE     pInfoSeg,
+              pScratch;
+    PUI_BLOCK puib;
+    USHORT    i, j, usLen;
+
+    if ( *pszKeyword == '*') pszKeyword++;
+    memcpy( (PBYTE) &desPPD, pBuf, sizeof( DESPPD ));
+    puib = (PUI_BLOCK)( pBuf + sizeof( DESPPD ));
+    pInfoSeg = pBuf + sizeof( DESPPD ) + desPPD.stUIList.usBlockListSize +
+               desPPD.stUICList.usNumOfUICs * sizeof( UIC_BLOCK );
+
+    for ( i = 0; desPPD.stUIList.usBlockListSize && i < desPPD.stUIList.usNumOfBlocks; i++ ) {
+        if ( strcmp( OFFSET_TO_PSZ( puib->ofsUIName, pInfoSeg ), pszKeyword ) == 0 ) {
+            for ( j = 0; j < puib->usNumOfEntries; j++ ) {
+                if ( strcmp( OFFSET_TO_PSZ( puib->uiEntry[j].ofsOption, pInfoSeg ), pszOption ) != 0 )
+                    continue;
+                if ( puib->uiEntry[j].ofsValue > 0 ) {
+                    if (( pScratch = (PBYTE) ArenaAlloc( pArena, desPPD.desItems.iSizeBuffer )) == NULL )
+                        return ERROR_NOT_ENOUGH_MEMORY;
+                    usLen = ExpandString( pArena, OFFSET_TO_PSZ( puib->uiEntry[j].ofsValue, pInfoSeg ), pScratch );
+                    OutWrite( pOut, pScratch, usLen );
+                }
+                OutWrite( pOut, "\n", 1 );
+                return NO_ERROR;
+            }
+            return ERROR_INVALID_DATA;
+        }
+        INCREMENT_BLOCK_PTR( puib );
+    }
+    return ERROR_INVALID_DATA;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ParseRequest                                                              *
+ *                                                                           *
+ * Split a request line into words (in place).  Words may be enclosed in     *
+ * double quotes in order to include spaces.                                 *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   Number of words found                                                   *
+ * ------------------------------------------------------------------------- */
+static ULONG ParseRequest( PSZ pszLine, PSZ *apszArgs, ULONG cMax )
+{
+    ULONG cArgs = 0;
+    PSZ   psz = pszLine;
+
+    while ( cArgs < cMax ) {
+        while ( *psz == ' ' || *psz == '\t') psz++;
+        if ( !*psz || *psz == '\r' || *psz == '\n') break;
+        if ( *psz == '"') {
+            apszArgs[ cArgs++ ] = ++psz;
+            while ( *psz && *psz != '"') psz++;
+        }
+        else {
+            apszArgs[ cArgs++ ] = psz;
+            while ( *psz && *psz != ' ' && *psz != '\t' && *psz != '\r' && *psz != '\n') psz++;
+        }
+        if ( !*psz ) break;
+        *psz++ = 0;
+    }
+    return cArgs;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * HandleRequest                                                             *
+ *                                                                           *
+ * Carry out a single (parsed) request, writing the reply data into pOut.    *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, otherwise an OS/2 error code; pszError is set to a short  *
+ *   description of the problem.                                             *
+ * ------------------------------------------------------------------------- */
+static ULONG HandleRequest( PSZ *apszArgs, ULONG cArgs, PPAKARENA pArena, POUTBUF pOut, PSZ *ppszError )
+{
+    PPAKIMAGE pImage;
+    POUTBUF   pPPD;
+    PPAKJOB   pJob;
+    PSZ       pszVerb;
+    SHORT     i;
+    APIRET    rc;
+
+    if ( cArgs < 2 ) {
+        *ppszError = "Incomplete request";
+        return ERROR_INVALID_PARAMETER;
+    }
+    pszVerb = strupr( apszArgs[ 0 ] );
+    if (( rc = AcquireImage( apszArgs[ 1 ], &pImage )) != NO_ERROR ) {
+        *ppszError = "PAK file not available";
+        return rc;
+    }
+
+    if ( strcmp( pszVerb, "LIST") == 0 ) {
+        for ( i = 0; i < pImage->pSig->iEntries; i++ )
+            OutPrintf( pOut, "%.40s\n", pImage->pDir[ i ].szDeviceName );
+        goto done;
+    }
+
+    if (( i = FindEntry( pImage, ( cArgs > 2 ) ? apszArgs[ 2 ] : NULL )) < 0 ) {
+        *ppszError = ( i == -2 ) ? "The printer name is ambiguous" :
+                                   "The requested printer was not found";
+        rc = ERROR_FILE_NOT_FOUND;
+        goto done;
+    }
+    if ( pImage->afDamaged[ i ] ) {
+        *ppszError = "Printer data is damaged";
+        rc = ERROR_INVALID_DATA;
+        goto done;
+    }
+
+    if ( strcmp( pszVerb, "PPD") == 0 ) {
+        if (( rc = GetCachedPPD( pImage, i, pArena, &pPPD )) == NO_ERROR )
+            OutWrite( pOut, pPPD->pbData, pPPD->cbData );
+    }
+    else if ( strcmp( pszVerb, "READ") == 0 )
+        ShowReadableData( pImage->pDir[ i ], pImage->pbFile + pImage->pDir[ i ].ulOffset, pArena, pOut );
+    else if ( strcmp( pszVerb, "JSON") == 0 )
+        ShowJsonData( pImage->pDir[ i ], pImage->pbFile + pImage->pDir[ i ].ulOffset, pArena, pOut );
+    else if (( strcmp( pszVerb, "FIELD") == 0 ) && ( cArgs > 3 )) {
+        if (( rc = GetCachedPPD( pImage, i, pArena, &pPPD )) == NO_ERROR )
+            rc = FindField( pPPD, apszArgs[ 3 ], pOut );
+        if ( rc == ERROR_INVALID_DATA ) *ppszError = "Keyword not found";
+    }
+    else if (( strcmp( pszVerb, "VALUE") == 0 ) && ( cArgs > 4 )) {
+        rc = FindOptionValue( pImage->pbFile + pImage->pDir[ i ].ulOffset,
+                              apszArgs[ 3 ], apszArgs[ 4 ], pArena, pOut );
+        if ( rc == ERROR_INVALID_DATA ) *ppszError = "Option not found";
+    }
+    else if ( strcmp( pszVerb, "JOB") == 0 ) {
+        if (( rc = GetCachedJob( pImage, i, pArena, &pJob )) == NO_ERROR )
+            rc = RenderJobRequest( pJob, apszArgs + 3, ( cArgs > 3 ) ? cArgs - 3 : 0,
+                                   pArena, pOut, ppszError );
+        else if ( rc == ERROR_INVALID_DATA ) *ppszError = "Printer data is damaged";
+    }
+    else {
+        *ppszError = "Unknown or incomplete request";
+        rc = ERROR_INVALID_PARAMETER;
+    }
+    if ( !rc && pOut->fError ) rc = ERROR_NOT_ENOUGH_MEMORY;
+    if ( rc == ERROR_NOT_ENOUGH_MEMORY ) *ppszError = "Out of memory";
+
+done:
+    ReleaseImage( pImage );
+    return rc;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ServeThread                                                               *
+ *                                                                           *
+ * Create one instance of the server pipe and answer requests on it, one     *
+ * client at a time, forever.                                                *
+ * ------------------------------------------------------------------------- */
+static void _Optlink ServeThread( PVOID pArg )
+{
+    PSZ     pszPipe = (PSZ) pArg;
+    HPIPE   hp;
+    CHAR    szLine[ SERVE_MAX_REQUEST ],
+            szStatus[ 80 ];
+    PSZ     apszArgs[ SERVE_MAX_ARGS ],
+            pszError;
+    OUTBUF  out;
+    PAKARENA arena = {0};   // per-thread scratch memory, reused for each request
+    ULONG   cbLine, cb, cArgs;
+    APIRET  rc;
+
+    arena.pDict = pServeDict;
+    rc = DosCreateNPipe( pszPipe, &hp, NP_ACCESS_DUPLEX | NP_NOINHERIT,
+                         NP_WAIT | NP_TYPE_BYTE | NP_READMODE_BYTE | SERVE_INSTANCES,
+                         SERVE_PIPE_BUFFER, SERVE_PIPE_BUFFER, 0 );
+    if ( rc ) {
+        printf("Failed to create pipe %s (error %u)\n", pszPipe, rc );
+        return;
+    }
+
+    for ( ;; ) {
+        if ( DosConnectNPipe( hp ) != NO_ERROR ) {
+            DosDisConnectNPipe( hp );
+            continue;
+        }
+
+        // Read the request line
+        cbLine = 0;
+        while ( cbLine < sizeof( szLine ) - 1 ) {
+            rc = DosRead( hp, szLine + cbLine, sizeof( szLine ) - 1 - cbLine, &cb );
+            if ( rc || !cb ) break;
+            cbLine += cb;
+            if ( memchr( szLine, '\n', cbLine )) break;
+        }
+        szLine[ cbLine ] = 0;
+
+        memset( &out, 0, sizeof( out ));
+        ArenaReset( &arena, 0 );
+        pszError = "Request failed";
+        cArgs = ParseRequest( szLine, apszArgs, SERVE_MAX_ARGS );
+        rc = HandleRequest( apszArgs, cArgs, &arena, &out, &pszError );
+        if ( rc )
+            sprintf( szStatus, "-ERR %u %s\n", rc, pszError );
+        else
+            sprintf( szStatus, "+OK %u\n", out.cbData );
+        DosWrite( hp, szStatus, strlen( szStatus ), &cb );
+        if ( !rc && out.cbData )
+            DosWrite( hp, out.pbData, out.cbData, &cb );
+        OutFree( &out );
+
+        DosResetBuffer( hp );
+        DosDisConnectNPipe( hp );
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ServePakFiles                                                             *
+ *                                                                           *
+ * Run the query server.  All of the listed PAK files are loaded up front    *
+ * (so that errors are reported immediately); this function does not return  *
+ * unless startup fails.                                                     *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ     *ppszPakFiles: Array of PAK file names to serve                 *
+ *   ULONG    cPakFiles   : Number of PAK files                              *
+ *   PSZ      pszPipe     : Name of the pipe to listen on                    *
+ *   PPAKDICT pDict       : Keyword dictionary (NULL for built-in)           *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   OS/2 error code                                                         *
+ * ------------------------------------------------------------------------- */
+ULONG ServePakFiles( PSZ *ppszPakFiles, ULONG cPakFiles, PSZ pszPipe, PPAKDICT pDict )
+{
+    PPAKIMAGE pImage;
+    ULONG     cDamaged;
+    ULONG     i;
+    SHORT     j;
+    APIRET    rc;
+
+    pServeDict = pDict;
+    if (( rc = DosCreateMutexSem( NULL, &hmtxServe, 0, FALSE )) != NO_ERROR )
+        return rc;
+
+    if ( cPakFiles > SERVE_MAX_PAKS ) {
+        printf("At most %u PAK files may be served at once.\n", SERVE_MAX_PAKS );
+        return ERROR_INVALID_PARAMETER;
+    }
+    for ( i = 0; i < cPakFiles; i++ ) {
+        aSlots[ i ].pszFile = ppszPakFiles[ i ];
+        cSlots++;
+        if (( rc = AcquireImage( ppszPakFiles[ i ], &pImage )) != NO_ERROR ) {
+            printf("Unable to load %s\n", ppszPakFiles[ i ] );
+            return rc;
+        }
+        printf("Serving %s (%d printers)\n", ppszPakFiles[ i ], pImage->pSig->iEntries );
+        for ( cDamaged = 0, j = 0; j < pImage->pSig->iEntries; j++ )
+            if ( pImage->afDamaged[ j ] ) cDamaged++;
+        if ( cDamaged )
+            printf("  %u damaged printer(s) will not be served; run CHECK for details.\n", cDamaged );
+        ReleaseImage( pImage );
+    }
+
+    for ( i = 1; i < SERVE_INSTANCES; i++ ) {
+        if ( _beginthread( ServeThread, NULL, SERVE_STACK_SIZE, pszPipe ) == -1 ) {
+            printf("Failed to start server thread.\n");
+            return ERROR_NOT_ENOUGH_MEMORY;
+        }
+    }
+    printf("Listening on %s\n", pszPipe );
+    fflush( stdout );
+    ServeThread( pszPipe );
+
+    return ERROR_OPEN_FAILED;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * QueryServer                                                               *
+ *                                                                           *
+ * Send a request to a running query server and copy the reply to STDOUT.    *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ pszPipe   : Name of the server's pipe                               *
+ *   PSZ pszRequest: Request line (without the terminating newline)          *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success, otherwise an OS/2 error code (or the server's error code) *
+ * ------------------------------------------------------------------------- */
+ULONG QueryServer( PSZ pszPipe, PSZ pszRequest )
+{
+    HPIPE  hp;
+    CHAR   szStatus[ 80 ],
+           achBuf[ SERVE_PIPE_BUFFER ];
+    ULONG  ulAction, cb, i;
+    APIRET rc;
+
+    rc = DosOpen( pszPipe, &hp, &ulAction, 0, FILE_NORMAL,
+                  OPEN_ACTION_OPEN_IF_EXISTS,
+                  OPEN_FLAGS_FAIL_ON_ERROR | OPEN_SHARE_DENYNONE | OPEN_ACCESS_READWRITE,
+                  NULL );
+    if ( rc == ERROR_PIPE_BUSY &&
+         DosWaitNPipe( pszPipe, SERVE_WAIT_TIMEOUT ) == NO_ERROR )
+    {
+        rc = DosOpen( pszPipe, &hp, &ulAction, 0, FILE_NORMAL,
+                      OPEN_ACTION_OPEN_IF_EXISTS,
+                      OPEN_FLAGS_FAIL_ON_ERROR | OPEN_SHARE_DENYNONE | OPEN_ACCESS_READWRITE,
+                      NULL );
+    }
+    if ( rc ) {
+        printf("Unable to connect to server on %s\n", pszPipe );
+        return rc;
+    }
+
+    DosWrite( hp, pszRequest, strlen( pszRequest ), &cb );
+    DosWrite( hp, "\n", 1, &cb );
+
+    // Read the status line one byte at a time, then copy the rest
+    for ( i = 0; i < sizeof( szStatus ) - 1; i++ ) {
+        if ( DosRead( hp, szStatus + i, 1, &cb ) || !cb || szStatus[ i ] == '\n') break;
+    }
+    szStatus[ i ] = 0;
+    if ( strncmp( szStatus, "+OK", 3 ) != 0 ) {
+        printf("Server error: %s\n", ( strlen( szStatus ) > 5 ) ? szStatus + 5 : "(no reply)");
+        rc = ( strlen( szStatus ) > 5 ) ? atol( szStatus + 5 ) : ERROR_BROKEN_PIPE;
+    }
+    else while ( DosRead( hp, achBuf, sizeof( achBuf ), &cb ) == NO_ERROR && cb )
+        fwrite( achBuf, 1, cb, stdout );
+
+    DosClose( hp );
+    return rc;
+}
@@ -0,0 +1,229 @@
+/*
+ * pt_stat.c
+ *
+ * PAKTOOL size statistics.  Each printer entry in the PAK file (V1 or V2) is
+ * sent through the output pipeline (pt_pipe.c), as for CHECK, where it is
+ * checked by PakCheckDevice() and then measured by PakDeviceStats(), writing
+ * nothing.  The figures are then sorted to give the distribution of each
+ * over all printers, with the printers lying far outside it.
+ */
+
+#define INCL_DOSFILEMGR
+#define INCL_DOSERRORS
+#define INCL_DOSMISC
+#include <os2.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+#include "paktool.h"
+
+#define STAT_FENCE          3       // outliers lie this many interquartile
+                                    //   ranges above the upper quartile
+#define STAT_MAX_NAMED      3       // outliers named for each figure
+#define STAT_NO_FENCE       0xFFFFFFFFUL  // no outliers for a figure
+
+
+// One printer entry to be measured
+typedef struct _STATITEM
+{
+    BOOL             fDamaged;      // segment is unreadable or failed
+                                    //   PakCheckDevice()
+    ULONG            aulStats[ PAKSTAT_COUNT ];
+} STATITEM, *PSTATITEM;
+
+
+static PPAK_DEV_DIRENTRY pStatsEntries;    // entries to measure, in directory order
+static PSTATITEM         aItems;           // and their figures
+static ULONG             cItems;
+
+
+/* ------------------------------------------------------------------------- *
+ * StatsEntry                                                                *
+ *                                                                           *
+ * Pipeline format function (see RunPipelineEntries): measure an entry,      *
+ * writing nothing.  The check's report is only used to see whether the      *
+ * entry is damaged, and is then thrown away.                                *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   1 if the entry was measured, 0 if it is damaged                         *
+ * ------------------------------------------------------------------------- */
+static ULONG StatsEntry( PVOID pUser, PPAK_DEV_DIRENTRY pEntry, PBYTE pbSegment,
+                         PPAKARENA pArena, POUTBUF pOut )
+{
+    PSTATITEM pItem = aItems + ( pEntry - pStatsEntries );
+
+    if ( !pbSegment ||
+         PakCheckDevice( pEntry, pbSegment, pArena, pOut ) ||
+         PakDeviceStats( pEntry, pbSegment, pArena, pItem->aulStats ))
+        pItem->fDamaged = TRUE;
+    pOut->cbData = 0;
+    pOut->fError = FALSE;
+    return pItem->fDamaged ? 0 : 1;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * CompareValues                                                             *
+ *                                                                           *
+ * qsort() comparison of two ULONG values.                                   *
+ * ------------------------------------------------------------------------- */
+static int CompareValues( const void *p1, const void *p2 )
+{
+    ULONG ul1 = *((PULONG) p1 ),
+          ul2 = *((PULONG) p2 );
+
+    return ( ul1 < ul2 ) ? -1 : ( ul1 > ul2 );
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * Percentile                                                                *
+ *                                                                           *
+ * Get a percentile (by nearest rank) of a sorted, non-empty array.          *
+ * ------------------------------------------------------------------------- */
+static ULONG Percentile( PULONG pulSorted, ULONG c, ULONG ulPercent )
+{
+    ULONG ulRank = ( ulPercent * c + 99 ) / 100;
+
+    return pulSorted[ ulRank ? ulRank - 1 : 0 ];
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ShowOutliers                                                              *
+ *                                                                           *
+ * List the printers whose figure lies above the fence, largest first.       *
+ * Returns TRUE if there were any.                                           *
+ * ------------------------------------------------------------------------- */
+static BOOL ShowOutliers( ULONG ulStat, ULONG ulFence )
+{
+    ULONG aiNamed[ STAT_MAX_NAMED ],
+          cNamed = 0,
+          cOutliers = 0,
+          ulValue,
+          i, j;
+
+    for ( i = 0; i < cItems; i++ ) {
+        if ( aItems[ i ].fDamaged || ( ulValue = aItems[ i ].aulStats[ ulStat ] ) <= ulFence )
+            continue;
+        cOutliers++;
+        // Keep the largest few, in descending order (the first found of equals)
+        for ( j = cNamed; j > 0 && aItems[ aiNamed[ j - 1 ]].aulStats[ ulStat ] < ulValue; j-- )
+            if ( j < STAT_MAX_NAMED ) aiNamed[ j ] = aiNamed[ j - 1 ];
+        if ( j < STAT_MAX_NAMED ) {
+            aiNamed[ j ] = i;
+            if ( cNamed < STAT_MAX_NAMED ) cNamed++;
+        }
+    }
+    if ( !cOutliers ) return FALSE;
+
+    printf("  %s above %lu (%lu printer%s): ", PakStatName( ulStat ), ulFence,
+           cOutliers, ( cOutliers == 1 ) ? "" : "s");
+    for ( j = 0; j < cNamed; j++ )
+        printf("%s%.40s (%lu)", j ? ", " : "", pStatsEntries[ aiNamed[ j ]].szDeviceName,
+               aItems[ aiNamed[ j ]].aulStats[ ulStat ] );
+    printf(( cOutliers > cNamed ) ? ", ...\n" : "\n");
+    return TRUE;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ShowStats                                                                 *
+ *                                                                           *
+ * Implements the STATS action: measure every printer, and show the          *
+ * distribution of each figure over them.                                    *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ      pszPakFile: Name of the PAK file (V1 or V2)                    *
+ *   PPAKDICT pDict     : Keyword dictionary (NULL for built-in)             *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 on success (even if some printers were damaged), otherwise an error   *
+ *   code                                                                    *
+ * ------------------------------------------------------------------------- */
+ULONG ShowStats( PSZ pszPakFile, PPAKDICT pDict )
+{
+    PBYTE             pDir = NULL;
+    ULONG             cThreads = 1,
+                      cMeasured = 0,
+                      aulTotals[ PAKSTAT_COUNT ] = {0},
+                      aulFences[ PAKSTAT_COUNT ],
+                      ulQ1, ulQ3,
+                      ulStart, ulEnd,
+                      i, j;
+    PULONG            pulValues = NULL;
+    BOOL              fAny;
+    APIRET            rc;
+
+    DosQuerySysInfo( QSV_MS_COUNT, QSV_MS_COUNT, &ulStart, sizeof( ulStart ));
+    if (( rc = LoadPipeDirectory( pszPakFile, &pDir, NULL )) != NO_ERROR )
+        return rc;
+    pStatsEntries = (PPAK_DEV_DIRENTRY)( pDir + sizeof( PAKSIGNATURE ));
+    cItems        = ((PPAKSIGNATURE) pDir )->iEntries;
+    if ((( aItems = (PSTATITEM) calloc( cItems + 1, sizeof( STATITEM ))) == NULL ) ||
+        (( pulValues = (PULONG) malloc(( cItems + 1 ) * sizeof( ULONG ))) == NULL ))
+    {
+        printf("malloc() failed - out of memory?\n");
+        rc = ERROR_NOT_ENOUGH_MEMORY;
+        goto cleanup;
+    }
+
+    rc = RunPipelineEntries( pszPakFile, pStatsEntries, cItems, pDict, StatsEntry, NULL,
+                             &cMeasured, &cThreads );
+    if ( rc ) goto cleanup;
+    for ( i = 0; i < cItems; i++ ) {
+        if ( aItems[ i ].fDamaged ) continue;
+        for ( j = 0; j < PAKSTAT_COUNT; j++ )
+            aulTotals[ j ] += aItems[ i ].aulStats[ j ];
+    }
+    DosQuerySysInfo( QSV_MS_COUNT, QSV_MS_COUNT, &ulEnd, sizeof( ulEnd ));
+
+    printf("%s: %lu printers measured in %lu ms (%lu thread%s)", pszPakFile, cMeasured,
+           ulEnd - ulStart, cThreads, ( cThreads == 1 ) ? "" : "s");
+    if ( cItems > cMeasured )
+        printf(", %lu damaged printers skipped (use CHECK for details)", cItems - cMeasured );
+    printf("\n");
+    if ( !cMeasured ) goto cleanup;
+
+    printf("\n%-20s %7s %7s %7s %7s %7s %7s %10s\n",
+           "", "min", "p50", "p90", "p99", "max", "mean", "total");
+    for ( j = 0; j < PAKSTAT_COUNT; j++ ) {
+        for ( i = cMeasured = 0; i < cItems; i++ )
+            if ( !aItems[ i ].fDamaged ) pulValues[ cMeasured++ ] = aItems[ i ].aulStats[ j ];
+        qsort( pulValues, cMeasured, sizeof( ULONG ), CompareValues );
+        printf("%-20s %7lu %7lu %7lu %7lu %7lu %7lu %10lu\n", PakStatName( j ),
+               pulValues[ 0 ], Percentile( pulValues, cMeasured, 50 ),
+               Percentile( pulValues, cMeasured, 90 ), Percentile( pulValues, cMeasured, 99 ),
+               pulValues[ cMeasured - 1 ], ( aulTotals[ j ] + cMeasured / 2 ) / cMeasured,
+               aulTotals[ j ] );
+
+        // Outliers lie beyond the upper quartile by several interquartile ranges
+        ulQ1 = Percentile( pulValues, cMeasured, 25 );
+        ulQ3 = Percentile( pulValues, cMeasured, 75 );
+        aulFences[ j ] = ulQ3 + STAT_FENCE * ( ulQ3 - ulQ1 );
+        if ( aulFences[ j ] >= pulValues[ cMeasured - 1 ] ) aulFences[ j ] = STAT_NO_FENCE;
+    }
+    if ( aulTotals[ PAKSTAT_EXPANDED ] )
+        printf("\nCommands are stored in %lu%% of their expanded size.\n",
+               (ULONG)(( aulTotals[ PAKSTAT_PACKED ] * 100.0 ) / aulTotals[ PAKSTAT_EXPANDED ] + 0.5 ));
+
+    for ( j = 0, fAny = FALSE; j < PAKSTAT_COUNT; j++ ) {
+        if ( aulFences[ j ] == STAT_NO_FENCE ) continue;
+        if ( !fAny ) printf("\nOutliers (more than %d interquartile ranges above the upper quartile):\n",
+                            STAT_FENCE );
+        fAny |= ShowOutliers( j, aulFences[ j ] );
+    }
+    if ( !fAny ) printf("\nNo outliers (more than %d interquartile ranges above the upper quartile).\n",
+                        STAT_FENCE );
+
+cleanup:
+    free( pulValues );
+    free( aItems );
+    aItems = NULL;
+    PakFree( NULL, pDir );
+    return rc;
+}
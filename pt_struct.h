@@ -125,6 +125,11 @@ typedef struct _UI_BLOCK
 #define INCREMENT_BLOCK_PTR( p )    p = (PUI_BLOCK) ((PCHAR) p + \
                                                      QUERY_BLOCK_SIZE( p ))
 
+/*
+** Size of a UI_BLOCK without its uiEntry[] array.
+*/
+#define UI_BLOCK_FIXED              (sizeof( UI_BLOCK ) - sizeof( UI_ENTRY ))
+
 
 /*
 ** The UI list makes up of all *OpenUI / *CloseUI blocks in the PPD.  This
@@ -0,0 +1,198 @@
+/*
+ * pt_uic.c
+ *
+ * PAKTOOL constraint action.  Loads one printer, builds its UI constraint
+ * engine (pakuic.c), and either lists every conflicting pair of options or
+ * checks a selection given on the command line, suggesting the nearest valid
+ * selection if it breaks any constraints.
+ */
+
+#define INCL_DOSERRORS
+#include <os2.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+#include "paktool.h"
+
+#define UIC_MAX_REPORT      64      // maximum number of conflicts listed
+
+
+/* ------------------------------------------------------------------------- *
+ * PrintSelection                                                            *
+ *                                                                           *
+ * Print the names of the options selected in a block, separated by commas.  *
+ * ------------------------------------------------------------------------- */
+static void PrintSelection( PPAKUIC pUic, ULONG ulBlock, UI_SEL sel )
+{
+    ULONG e;
+    BOOL  fFirst = TRUE;
+
+    if ( !sel ) printf("(none)");
+    for ( e = 0; e < 32 && sel; e++, sel >>= 1 ) {
+        if ( !( sel & 1 )) continue;
+        printf("%s%s", fFirst ? "" : ",", PakUicOption( pUic, ulBlock, e ));
+        fFirst = FALSE;
+    }
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * PrintPair                                                                 *
+ * ------------------------------------------------------------------------- */
+static void PrintPair( PPAKUIC pUic, ULONG b1, ULONG e1, ULONG b2, ULONG e2 )
+{
+    printf("  *%s %s  <->  *%s %s\n",
+           PakUicKeyword( pUic, b1 ), PakUicOption( pUic, b1, e1 ),
+           PakUicKeyword( pUic, b2 ), PakUicOption( pUic, b2, e2 ));
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ApplyOptions                                                              *
+ *                                                                           *
+ * Apply the options given on the command line (as "Keyword=Option") to a    *
+ * selection, reporting any which are not valid.                             *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PPAKUIC pUic       : Constraint engine                                  *
+ *   PSZ    *ppszOptions: Options to apply                                   *
+ *   ULONG   cOptions   : Number of options                                  *
+ *   PUI_SEL pSel       : Selection, updated in place                        *
+ *   PUI_SEL pPrefer    : Receives the options given for each block (or      *
+ *                        NULL)                                              *
+ *                                                                           *
+ * RETURNS: BOOL                                                             *
+ *   TRUE if all the options were found                                      *
+ * ------------------------------------------------------------------------- */
+BOOL ApplyOptions( PPAKUIC pUic, PSZ *ppszOptions, ULONG cOptions,
+                   PUI_SEL pSel, PUI_SEL pPrefer )
+{
+    ULONG i;
+
+    for ( i = 0; i < cOptions; i++ ) {
+        switch ( PakUicSelect( pUic, ppszOptions[ i ], pSel, pPrefer )) {
+            case NO_ERROR:
+                continue;
+            case ERROR_PAK_NO_KEYWORD:
+                printf("This printer has no UI keyword \"%.*s\"\n",
+                       (int)( (PSZ) strchr( ppszOptions[ i ], '=') - ppszOptions[ i ] ), ppszOptions[ i ] );
+                break;
+            case ERROR_PAK_NO_OPTION:
+                printf("This printer has no option %s\n", ppszOptions[ i ] );
+                break;
+            default:
+                printf("Options must be given as <keyword>=<option>: %s\n", ppszOptions[ i ] );
+                break;
+        }
+        return FALSE;
+    }
+    return TRUE;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * ShowConstraints                                                           *
+ *                                                                           *
+ * Implements the CONSTRAIN action.                                          *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ   pszPakFile : Name of the PAK file                                 *
+ *   PSZ   pszPrinter : Printer name (or NULL for the first)                 *
+ *   PSZ  *ppszOptions: Options to check, as "Keyword=Option"                *
+ *   ULONG cOptions   : Number of options (0 to list all constraints)        *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 if the selection is valid, ERROR_INVALID_DATA if it is not (or the    *
+ *   printer's UI data is damaged), otherwise an error code                  *
+ * ------------------------------------------------------------------------- */
+ULONG ShowConstraints( PSZ pszPakFile, PSZ pszPrinter, PSZ *ppszOptions, ULONG cOptions )
+{
+    PAK_DEV_DIRENTRY dev;
+    PAKUICPAIR       aPairs[ UIC_MAX_REPORT ];
+    PPAKUIC          pUic = NULL;
+    PBYTE            pSegment;
+    PUI_SEL          pSel = NULL,
+                     pPrefer,
+                     pOrig;
+    PUI_SEL          pRow;
+    UI_SEL           m;
+    ULONG            cPairs, b, c, e, e2;
+    APIRET           rc;
+
+    if (( rc = LoadPrinter( pszPakFile, pszPrinter, &dev, &pSegment )) != NO_ERROR )
+        return rc;
+
+    if (( rc = PakUicBuild( NULL, pSegment, dev.ulSize, &pUic )) != NO_ERROR ) {
+        if ( rc == ERROR_INVALID_DATA )
+            printf("The UI data of %.40s is damaged; use CHECK for details.\n", dev.szDeviceName );
+        else
+            printf("malloc() failed - out of memory?\n");
+        goto done;
+    }
+    printf("%.40s: %lu UI blocks, %lu options, %lu conflicting pairs\n",
+           dev.szDeviceName, pUic->cBlocks, pUic->cOptions, pUic->cPairs );
+
+    // With no options given, list every conflicting pair once
+    if ( !cOptions ) {
+        for ( b = 0; b < pUic->cBlocks; b++ ) {
+            for ( m = pUic->pAny[ b ]; m; m &= m - 1 ) {
+                for ( e = 0; !( m & ( 1UL << e )); e++ );
+                pRow = pUic->pMatrix + ( pUic->pulFirstRow[ b ] + e ) * pUic->cBlocks;
+                for ( c = b; c < pUic->cBlocks; c++ ) {
+                    for ( e2 = ( c == b ) ? e + 1 : 0; e2 < 32; e2++ ) {
+                        if ( pRow[ c ] & ( 1UL << e2 ))
+                            PrintPair( pUic, b, e, c, e2 );
+                    }
+                }
+            }
+        }
+        goto done;
+    }
+
+    if (( pSel = (PUI_SEL) calloc( 3 * pUic->cBlocks + 1, sizeof( UI_SEL ))) == NULL ) {
+        printf("malloc() failed - out of memory?\n");
+        rc = ERROR_NOT_ENOUGH_MEMORY;
+        goto done;
+    }
+    pPrefer = pSel + pUic->cBlocks;
+    pOrig   = pPrefer + pUic->cBlocks;
+    PakUicDefaults( pUic, pSel );
+    if ( !ApplyOptions( pUic, ppszOptions, cOptions, pSel, pPrefer )) {
+        rc = ERROR_INVALID_PARAMETER;
+        goto done;
+    }
+
+    cPairs = PakUicCheck( pUic, pSel, aPairs, UIC_MAX_REPORT );
+    if ( !cPairs ) {
+        printf("The selection is valid.\n");
+        goto done;
+    }
+    printf("The selection breaks %lu constraint%s:\n", cPairs, ( cPairs == 1 ) ? "" : "s");
+    for ( c = 0; c < cPairs && c < UIC_MAX_REPORT; c++ )
+        PrintPair( pUic, aPairs[ c ].usBlock1, aPairs[ c ].usEntry1,
+                   aPairs[ c ].usBlock2, aPairs[ c ].usEntry2 );
+    if ( cPairs > UIC_MAX_REPORT ) printf("  ...\n");
+
+    memcpy( pOrig, pSel, pUic->cBlocks * sizeof( UI_SEL ));
+    PakUicResolve( pUic, pSel, pPrefer );
+    printf("Nearest valid selection:\n");
+    for ( b = 0; b < pUic->cBlocks; b++ ) {
+        if ( pSel[ b ] == pOrig[ b ] ) continue;
+        printf("  *%s: ", PakUicKeyword( pUic, b ));
+        PrintSelection( pUic, b, pOrig[ b ] );
+        printf(" -> ");
+        PrintSelection( pUic, b, pSel[ b ] );
+        printf("\n");
+    }
+    rc = ERROR_INVALID_DATA;
+
+done:
+    free( pSel );
+    PakUicFree( NULL, pUic );
+    PakFree( NULL, pSegment );
+    return rc;
+}
@@ -0,0 +1,152 @@
+/*
+ * pt_vrfy.c
+ *
+ * PAKTOOL round-trip verification.  Each printer entry is written out as a
+ * PPD file (as by the P action), the PPD text is compiled back into a device
+ * segment (see pakppd.c), and the two segments are compared field by field
+ * (see pakcmp.c); anything the PPD text lost or changed is reported.  The
+ * printers go through the output pipeline (see pt_pipe.c), so they are
+ * verified in parallel and the differences printed in directory order.
+ */
+
+#define INCL_DOSFILEMGR
+#define INCL_DOSERRORS
+#define INCL_DOSMISC
+#define INCL_DOSSEMAPHORES
+#include <os2.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "pt_struct.h"
+#include "package.h"
+#include "paklib.h"
+#include "paktool.h"
+
+#define VRFY_MAX_GROUPS     32      // bits in a PakCompareDevices() flag set
+
+
+// Totals over the printers verified
+typedef struct _VRFYTOTALS
+{
+    HMTX  hmtx;                     // protects the rest
+    ULONG cDamaged;                 // printers which failed PakCheckDevice()
+    ULONG cbText;                   // total size of the PPD text
+    ULONG acDropped[ VRFY_MAX_GROUPS ];  // printers using each of the fields
+                                         //   which the PPD could not carry
+} VRFYTOTALS, *PVRFYTOTALS;
+
+
+/* ------------------------------------------------------------------------- *
+ * VerifyEntry                                                               *
+ *                                                                           *
+ * Pipeline format function: verify one printer, reporting the differences   *
+ * in the output buffer.  Returns the number of differences found.           *
+ * ------------------------------------------------------------------------- */
+static ULONG VerifyEntry( PVOID pUser, PPAK_DEV_DIRENTRY pEntry, PBYTE pbSegment,
+                          PPAKARENA pArena, POUTBUF pOut )
+{
+    PVRFYTOTALS pTotals = (PVRFYTOTALS) pUser;
+    OUTBUF      text = {0};
+    PBYTE       pbNew = NULL;
+    ULONG       cbNew,
+                cDiffs = 0,
+                flDropped = 0,
+                j;
+    APIRET      rc;
+
+    // The check's report is not wanted, only whether there was one
+    if ( !pbSegment || PakCheckDevice( pEntry, pbSegment, pArena, pOut )) {
+        pOut->cbData = 0;
+        OutPrintf( pOut, "%.40s: (damaged; use CHECK for details)\n", pEntry->szDeviceName );
+        DosRequestMutexSem( pTotals->hmtx, SEM_INDEFINITE_WAIT );
+        pTotals->cDamaged++;
+        DosReleaseMutexSem( pTotals->hmtx );
+        return 0;
+    }
+    pOut->cbData = 0;
+
+    ArenaReset( pArena, 0 );
+    if ( FormatPakDevice( pEntry, pbSegment, DEV_PPD_DATA, pArena, &text )) {
+        OutPrintf( pOut, "%.40s: (out of memory; not verified)\n", pEntry->szDeviceName );
+        OutFree( &text );
+        return 1;
+    }
+    rc = PakCompilePPD( NULL, (PCHAR) text.pbData, text.cbData, &pbNew, &cbNew );
+    if ( rc ) {
+        OutPrintf( pOut, "%.40s: %s\n", pEntry->szDeviceName,
+                   ( rc == ERROR_BUFFER_OVERFLOW ) ?
+                       "PPD text does not fit in an information segment" :
+                       "(out of memory; not verified)");
+        cDiffs = 1;
+    }
+    else {
+        ArenaReset( pArena, 0 );
+        cDiffs = PakCompareDevices( pEntry, pbSegment, pbNew, pArena, pOut, &flDropped );
+        PakFree( NULL, pbNew );
+    }
+
+    DosRequestMutexSem( pTotals->hmtx, SEM_INDEFINITE_WAIT );
+    pTotals->cbText += text.cbData;
+    for ( j = 0; j < VRFY_MAX_GROUPS; j++ )
+        if ( flDropped & ( 1UL << j )) pTotals->acDropped[ j ]++;
+    DosReleaseMutexSem( pTotals->hmtx );
+    OutFree( &text );
+    return cDiffs;
+}
+
+
+/* ------------------------------------------------------------------------- *
+ * VerifyPakFile                                                             *
+ *                                                                           *
+ * Implements the VERIFY action: check that every printer (or the one given) *
+ * survives conversion to a PPD file and back.                               *
+ *                                                                           *
+ * PARAMETERS:                                                               *
+ *   PSZ      pszPakFile: Name of the PAK file (V1 or V2)                    *
+ *   PSZ      pszPrinter: Printer to verify, or NULL for all printers        *
+ *   PPAKDICT pDict     : Keyword dictionary (NULL for built-in)             *
+ *                                                                           *
+ * RETURNS: ULONG                                                            *
+ *   0 if no differences were found; ERROR_INVALID_DATA if any were;         *
+ *   ERROR_PAK_NO_DEVICE if the printer was not found; otherwise an error    *
+ *   code                                                                    *
+ * ------------------------------------------------------------------------- */
+ULONG VerifyPakFile( PSZ pszPakFile, PSZ pszPrinter, PPAKDICT pDict )
+{
+    VRFYTOTALS totals = {0};
+    ULONG      cItems = 0,
+               cThreads = 0,
+               cDiffs = 0,
+               ulStart, ulEnd,
+               j;
+    PSZ        pszGroup;
+    BOOL       fAny;
+    APIRET     rc;
+
+    if (( rc = DosCreateMutexSem( NULL, &(totals.hmtx), 0, FALSE )) != NO_ERROR )
+        return rc;
+    DosQuerySysInfo( QSV_MS_COUNT, QSV_MS_COUNT, &ulStart, sizeof( ulStart ));
+    rc = RunPipeline( pszPakFile, pszPrinter, pDict, VerifyEntry, &totals, &cDiffs, &cItems, &cThreads );
+    DosQuerySysInfo( QSV_MS_COUNT, QSV_MS_COUNT, &ulEnd, sizeof( ulEnd ));
+    DosCloseMutexSem( totals.hmtx );
+    if ( rc ) return rc;
+
+    printf("%s: %lu printers verified in %lu ms (%lu thread%s), %lu KB of PPD text",
+           pszPakFile, cItems - totals.cDamaged, ulEnd - ulStart, cThreads, ( cThreads == 1 ) ? "" : "s",
+           ( totals.cbText + 1023 ) / 1024 );
+    if ( cItems > totals.cDamaged )
+        printf(", %lu us per printer", (( ulEnd - ulStart ) * 1000 ) / ( cItems - totals.cDamaged ));
+    if ( totals.cDamaged ) printf(", %lu damaged printers skipped", totals.cDamaged );
+    if ( cDiffs ) printf(", %lu differences found\n", cDiffs );
+    else printf(", no differences found\n");
+
+    for ( j = 0, fAny = FALSE; j < VRFY_MAX_GROUPS && ( pszGroup = PakCompareDropped( j )) != NULL; j++ ) {
+        if ( !totals.acDropped[ j ] ) continue;
+        printf("%s%s (%lu printer%s)", fAny ? ", " : "Not carried by the PPD text: ", pszGroup,
+               totals.acDropped[ j ], ( totals.acDropped[ j ] == 1 ) ? "" : "s");
+        fAny = TRUE;
+    }
+    if ( fAny ) printf("\n");
+    return cDiffs ? ERROR_INVALID_DATA : NO_ERROR;
+}